@@ -148,7 +148,7 @@ const char *KnownInactiveFunctionsStartingWith[] = {
 
 const char *KnownInactiveFunctionsContains[] = {
     "__enzyme_float", "__enzyme_double", "__enzyme_integer",
-    "__enzyme_pointer"};
+    "__enzyme_pointer", "__enzyme_truncate"};
 
 const std::set<std::string> InactiveGlobals = {
     "ompi_request_null", "ompi_mpi_double", "ompi_mpi_comm_world", "stderr",
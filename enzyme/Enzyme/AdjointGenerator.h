@@ -405,7 +405,8 @@ public:
           };
 
           Value *idiff = diffe(orig_op1, Builder2);
-          Value *dif1 = applyChainRule(inst.getType(), Builder2, rule, idiff);
+          Value *dif1 =
+              applyVectorChainRule(inst.getType(), Builder2, rule, idiff);
 
           setDiffe(FPMO, dif1, Builder2);
           break;
@@ -1727,29 +1728,46 @@ public:
       size_t l1 =
           cast<VectorType>(SVI.getOperand(0)->getType())->getNumElements();
 #endif
-      uint64_t instidx = 0;
-
-      for (size_t idx : SVI.getShuffleMask()) {
-        auto opnum = (idx < l1) ? 0 : 1;
-        auto opidx = (idx < l1) ? idx : (idx - l1);
-        Value *sv[] = {
-            ConstantInt::get(Type::getInt32Ty(SVI.getContext()), opidx)};
-
-        if (!gutils->isConstantValue(SVI.getOperand(opnum))) {
-          size_t size = 1;
-          if (SVI.getOperand(opnum)->getType()->isSized())
-            size = (gutils->newFunc->getParent()
-                        ->getDataLayout()
-                        .getTypeSizeInBits(SVI.getOperand(opnum)->getType()) +
-                    7) /
-                   8;
-          ((DiffeGradientUtils *)gutils)
-              ->addToDiffe(SVI.getOperand(opnum),
-                           Builder2.CreateExtractElement(loaded, instidx),
-                           Builder2, TR.addingType(size, SVI.getOperand(opnum)),
-                           sv);
+      // Rather than extracting every lane, the adjoint of each operand is a
+      // shuffle of the result derivative (padded with a zero vector) which
+      // gathers back the result lanes an operand lane was copied into. Lanes
+      // copied several times need one such shuffle per copy.
+      SmallVector<int, 16> mask;
+      SVI.getShuffleMask(mask);
+      Value *zero = Constant::getNullValue(SVI.getType());
+      for (int opnum = 0; opnum < 2; opnum++) {
+        Value *orig_op = SVI.getOperand(opnum);
+        if (gutils->isConstantValue(orig_op))
+          continue;
+        SmallVector<SmallVector<int, 1>, 16> copies(l1);
+        size_t rounds = 0;
+        for (size_t instidx = 0; instidx < mask.size(); instidx++) {
+          int idx = mask[instidx];
+          if (idx < 0 || (size_t)idx / l1 != (size_t)opnum)
+            continue;
+          copies[idx % l1].push_back(instidx);
+          rounds = std::max(rounds, copies[idx % l1].size());
+        }
+        size_t size = 1;
+        if (orig_op->getType()->isSized())
+          size =
+              (gutils->newFunc->getParent()->getDataLayout().getTypeSizeInBits(
+                   orig_op->getType()) +
+               7) /
+              8;
+        for (size_t r = 0; r < rounds; r++) {
+          SmallVector<Constant *, 16> gather;
+          for (auto &C : copies)
+            gather.push_back(
+                Builder2.getInt32(C.size() > r ? C[r] : mask.size()));
+          auto rule = [&](Value *loaded) {
+            return Builder2.CreateShuffleVector(loaded, zero,
+                                                ConstantVector::get(gather));
+          };
+          Value *dif =
+              applyChainRule(orig_op->getType(), Builder2, rule, loaded);
+          addToDiffe(orig_op, dif, Builder2, TR.addingType(size, orig_op));
         }
-        ++instidx;
       }
       setDiffe(&SVI,
                Constant::getNullValue(gutils->getShadowType(SVI.getType())),
@@ -1990,6 +2008,15 @@ public:
         ->applyChainRule(diffType, Builder, rule, args...);
   }
 
+  /// Applies rule to all lanes of a vector derivative at once where the
+  /// tangents can be represented as LLVM vectors.
+  template <typename Func, typename... Args>
+  Value *applyVectorChainRule(Type *diffType, IRBuilder<> &Builder, Func rule,
+                              Args... args) {
+    return ((GradientUtils *)gutils)
+        ->applyVectorChainRule(diffType, Builder, rule, args...);
+  }
+
   /// Unwraps a vector derivative from its internal representation and applies a
   /// function f to each element.
   template <typename Func, typename... Args>
@@ -2069,23 +2096,30 @@ public:
 
     Type *addingType = BO.getType();
 
+    // Primal value v, looked up in the reverse pass, broadcast to the type of
+    // the adjoint it scales.
+    auto primal = [&](Value *v, Value *idiff) {
+      return gutils->splatLike(
+          Builder2, lookup(gutils->getNewFromOriginal(v), Builder2), idiff);
+    };
+
     switch (BO.getOpcode()) {
     case Instruction::FMul: {
       if (!constantval0) {
-        Value *op0 = lookup(gutils->getNewFromOriginal(orig_op1), Builder2);
         auto rule = [&](Value *idiff) {
-          return Builder2.CreateFMul(idiff, op0,
+          return Builder2.CreateFMul(idiff, primal(orig_op1, idiff),
                                      "m0diffe" + orig_op0->getName());
         };
-        dif0 = applyChainRule(orig_op0->getType(), Builder2, rule, idiff);
+        dif0 =
+            applyVectorChainRule(orig_op0->getType(), Builder2, rule, idiff);
       }
       if (!constantval1) {
         auto rule = [&](Value *idiff) {
-          return Builder2.CreateFMul(
-              idiff, lookup(gutils->getNewFromOriginal(orig_op0), Builder2),
-              "m1diffe" + orig_op1->getName());
+          return Builder2.CreateFMul(idiff, primal(orig_op0, idiff),
+                                     "m1diffe" + orig_op1->getName());
         };
-        dif1 = applyChainRule(orig_op1->getType(), Builder2, rule, idiff);
+        dif1 =
+            applyVectorChainRule(orig_op1->getType(), Builder2, rule, idiff);
       }
       break;
     }
@@ -2101,7 +2135,8 @@ public:
         dif0 = idiff;
       if (!constantval1) {
         auto rule = [&](Value *idiff) { return Builder2.CreateFNeg(idiff); };
-        dif1 = applyChainRule(orig_op1->getType(), Builder2, rule, idiff);
+        dif1 =
+            applyVectorChainRule(orig_op1->getType(), Builder2, rule, idiff);
       }
       break;
     }
@@ -2176,22 +2211,21 @@ public:
         }
       }
       if (!constantval0) {
-        Value *op1 = lookup(gutils->getNewFromOriginal(orig_op1), Builder2);
         auto rule = [&](Value *idiff) {
-          return Builder2.CreateFDiv(idiff, op1,
+          return Builder2.CreateFDiv(idiff, primal(orig_op1, idiff),
                                      "d0diffe" + orig_op0->getName());
         };
-        dif0 = applyChainRule(orig_op0->getType(), Builder2, rule, idiff);
+        dif0 =
+            applyVectorChainRule(orig_op0->getType(), Builder2, rule, idiff);
       }
       if (!constantval1) {
-        Value *lop1 = lookup(gutils->getNewFromOriginal(orig_op1), Builder2);
-        Value *lastdiv = lookup(gutils->getNewFromOriginal(&BO), Builder2);
-
         auto rule = [&](Value *idiff) {
-          return Builder2.CreateFNeg(
-              Builder2.CreateFMul(lastdiv, Builder2.CreateFDiv(idiff, lop1)));
+          return Builder2.CreateFNeg(Builder2.CreateFMul(
+              primal(&BO, idiff),
+              Builder2.CreateFDiv(idiff, primal(orig_op1, idiff))));
         };
-        dif1 = applyChainRule(orig_op1->getType(), Builder2, rule, idiff);
+        dif1 =
+            applyVectorChainRule(orig_op1->getType(), Builder2, rule, idiff);
       }
       break;
     }
@@ -2577,32 +2611,36 @@ public:
     Value *dif[2] = {constantval0 ? nullptr : diffe(orig_op0, Builder2),
                      constantval1 ? nullptr : diffe(orig_op1, Builder2)};
 
+    // Primal operand i broadcast to the type of the tangent it scales.
+    auto op = [&](int i, Value *dif) {
+      return gutils->splatLike(
+          Builder2, gutils->getNewFromOriginal(BO.getOperand(i)), dif);
+    };
+
     switch (BO.getOpcode()) {
     case Instruction::FMul: {
       if (!constantval0 && !constantval1) {
         auto rule = [&](Value *dif0, Value *dif1) {
-          Value *idiff0 =
-              Builder2.CreateFMul(dif0, gutils->getNewFromOriginal(orig_op1));
-          Value *idiff1 =
-              Builder2.CreateFMul(dif1, gutils->getNewFromOriginal(orig_op0));
+          Value *idiff0 = Builder2.CreateFMul(dif0, op(1, dif0));
+          Value *idiff1 = Builder2.CreateFMul(dif1, op(0, dif1));
           return Builder2.CreateFAdd(idiff0, idiff1);
         };
         Value *diff =
-            applyChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
         setDiffe(&BO, diff, Builder2);
       } else if (!constantval0) {
         auto rule = [&](Value *dif0) {
-          return Builder2.CreateFMul(dif0,
-                                     gutils->getNewFromOriginal(orig_op1));
+          return Builder2.CreateFMul(dif0, op(1, dif0));
         };
-        Value *idiff0 = applyChainRule(BO.getType(), Builder2, rule, dif[0]);
+        Value *idiff0 =
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[0]);
         setDiffe(&BO, idiff0, Builder2);
       } else if (!constantval1) {
         auto rule = [&](Value *dif1) {
-          return Builder2.CreateFMul(dif1,
-                                     gutils->getNewFromOriginal(orig_op0));
+          return Builder2.CreateFMul(dif1, op(0, dif1));
         };
-        Value *idiff1 = applyChainRule(BO.getType(), Builder2, rule, dif[1]);
+        Value *idiff1 =
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[1]);
         setDiffe(&BO, idiff1, Builder2);
       }
       break;
@@ -2613,7 +2651,7 @@ public:
           return Builder2.CreateFAdd(dif0, dif1);
         };
         Value *diff =
-            applyChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
         setDiffe(&BO, diff, Builder2);
       } else if (!constantval0) {
         setDiffe(&BO, dif[0], Builder2);
@@ -2628,13 +2666,14 @@ public:
           return Builder2.CreateFAdd(dif0, Builder2.CreateFNeg(dif1));
         };
         Value *diff =
-            applyChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
         setDiffe(&BO, diff, Builder2);
       } else if (!constantval0) {
         setDiffe(&BO, dif[0], Builder2);
       } else if (!constantval1) {
         auto rule = [&](Value *dif1) { return Builder2.CreateFNeg(dif1); };
-        Value *diff = applyChainRule(BO.getType(), Builder2, rule, dif[1]);
+        Value *diff =
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[1]);
         setDiffe(&BO, diff, Builder2);
       }
       break;
@@ -2643,35 +2682,34 @@ public:
       Value *idiff3 = nullptr;
       if (!constantval0 && !constantval1) {
         auto rule = [&](Value *dif0, Value *dif1) {
-          Value *idiff1 =
-              Builder2.CreateFMul(dif0, gutils->getNewFromOriginal(orig_op1));
-          Value *idiff2 =
-              Builder2.CreateFMul(gutils->getNewFromOriginal(orig_op0), dif1);
+          Value *idiff1 = Builder2.CreateFMul(dif0, op(1, dif0));
+          Value *idiff2 = Builder2.CreateFMul(op(0, dif1), dif1);
           return Builder2.CreateFSub(idiff1, idiff2);
         };
-        idiff3 = applyChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
+        idiff3 =
+            applyVectorChainRule(BO.getType(), Builder2, rule, dif[0], dif[1]);
       } else if (!constantval0) {
         auto rule = [&](Value *dif0) {
-          return Builder2.CreateFMul(dif0,
-                                     gutils->getNewFromOriginal(orig_op1));
+          return Builder2.CreateFMul(dif0, op(1, dif0));
         };
-        idiff3 = applyChainRule(BO.getType(), Builder2, rule, dif[0]);
+        idiff3 = applyVectorChainRule(BO.getType(), Builder2, rule, dif[0]);
       } else if (!constantval1) {
         auto rule = [&](Value *dif1) {
-          return Builder2.CreateFNeg(
-              Builder2.CreateFMul(gutils->getNewFromOriginal(orig_op0), dif1));
+          return Builder2.CreateFNeg(Builder2.CreateFMul(op(0, dif1), dif1));
         };
-        idiff3 = applyChainRule(BO.getType(), Builder2, rule, dif[1]);
+        idiff3 = applyVectorChainRule(BO.getType(), Builder2, rule, dif[1]);
       }
 
       Value *idiff4 = Builder2.CreateFMul(gutils->getNewFromOriginal(orig_op1),
                                           gutils->getNewFromOriginal(orig_op1));
 
       auto rule = [&](Value *idiff3) {
-        return Builder2.CreateFDiv(idiff3, idiff4);
+        return Builder2.CreateFDiv(idiff3,
+                                   gutils->splatLike(Builder2, idiff4, idiff3));
       };
 
-      Value *idiff5 = applyChainRule(BO.getType(), Builder2, rule, idiff3);
+      Value *idiff5 =
+          applyVectorChainRule(BO.getType(), Builder2, rule, idiff3);
       setDiffe(&BO, idiff5, Builder2);
 
       break;
@@ -2698,20 +2736,24 @@ public:
 
       if (!constantval0 && !constantval1) {
         auto rule = [&](Value *dif0, Value *dif1) {
-          return Builder2.CreateFAdd(dif0, Builder2.CreateFMul(dif1, round));
+          return Builder2.CreateFAdd(
+              dif0, Builder2.CreateFMul(
+                        dif1, gutils->splatLike(Builder2, round, dif1)));
         };
-        setDiffe(
-            &BO,
-            applyChainRule(orig_op1->getType(), Builder2, rule, dif[0], dif[1]),
-            Builder2);
+        setDiffe(&BO,
+                 applyVectorChainRule(orig_op1->getType(), Builder2, rule,
+                                      dif[0], dif[1]),
+                 Builder2);
       } else if (!constantval0) {
         setDiffe(&BO, dif[0], Builder2);
       } else if (!constantval1) {
         auto rule = [&](Value *dif1) {
-          return Builder2.CreateFMul(dif1, round);
+          return Builder2.CreateFMul(dif1,
+                                     gutils->splatLike(Builder2, round, dif1));
         };
         setDiffe(&BO,
-                 applyChainRule(orig_op1->getType(), Builder2, rule, dif[1]),
+                 applyVectorChainRule(orig_op1->getType(), Builder2, rule,
+                                      dif[1]),
                  Builder2);
       }
       break;
@@ -3703,6 +3745,404 @@ public:
     eraseIfUnused(II);
   }
 
+  /// Differentiate a gather of the vector of pointers orig_ptrs under the new
+  /// mask, whose disabled lanes take orig_passthru if it is non-null. The
+  /// adjoint of the result is scatter-added to the shadows of the pointers.
+  void handleGather(llvm::Instruction &I, Value *orig_ptrs, Value *mask,
+                    Value *orig_passthru, unsigned align) {
+    Module *M = I.getParent()->getParent()->getParent();
+
+    if (Mode == DerivativeMode::ForwardMode ||
+        Mode == DerivativeMode::ForwardModeSplit) {
+      if (gutils->isConstantValue(&I))
+        return;
+      auto found = gutils->invertedPointers.find(&I);
+      assert(found != gutils->invertedPointers.end());
+      Instruction *placeholder = cast<Instruction>(&*found->second);
+      gutils->invertedPointers.erase(found);
+
+      IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&I));
+      Value *newip = gutils->invertPointerM(&I, BuilderZ);
+      assert(newip->getType() == placeholder->getType());
+      placeholder->replaceAllUsesWith(newip);
+      gutils->erase(placeholder);
+      gutils->invertedPointers.insert(std::make_pair(
+          (const Value *)&I, InvertedPointerVH(gutils, newip)));
+      return;
+    }
+
+    if (Mode == DerivativeMode::ReverseModePrimal)
+      return;
+
+    Type *FT = TR.query(&I)[{-1}].isFloat();
+    if (!FT || gutils->isConstantInstruction(&I))
+      return;
+
+    IRBuilder<> Builder2(I.getParent());
+    getReverseBuilder(Builder2);
+
+    Value *dif = diffe(&I, Builder2);
+    setDiffe(&I, Constant::getNullValue(gutils->getShadowType(I.getType())),
+             Builder2);
+    mask = lookup(mask, Builder2);
+
+    if (orig_passthru && !gutils->isConstantValue(orig_passthru))
+      addToDiffe(orig_passthru, dif, Builder2, FT, Builder2.CreateNot(mask));
+
+    if (gutils->isConstantValue(orig_ptrs))
+      return;
+
+    if (gutils->AtomicAdd) {
+      llvm::errs() << "unhandled atomic scatter-add for " << I << "\n";
+      llvm_unreachable("unhandled atomic scatter-add");
+    }
+
+    Type *tys[] = {I.getType(), orig_ptrs->getType()};
+    auto gather = Intrinsic::getDeclaration(M, Intrinsic::masked_gather, tys);
+    auto scatter = Intrinsic::getDeclaration(M, Intrinsic::masked_scatter, tys);
+    Value *alignv = Builder2.getInt32(align);
+    Value *zero = Constant::getNullValue(I.getType());
+
+    // Duplicate addresses are summed first, since the scatter would otherwise
+    // keep only the last of their updates.
+    auto rule = [&](Value *sptrs, Value *dif) {
+      Value *sum = sumDuplicateLanes(Builder2, sptrs, mask, dif);
+      Value *gargs[] = {sptrs, alignv, mask, zero};
+      Value *prev = Builder2.CreateCall(gather, gargs);
+      Value *sargs[] = {Builder2.CreateFAdd(prev, sum), sptrs, alignv, mask};
+      Builder2.CreateCall(scatter, sargs);
+    };
+    applyChainRule(
+        Builder2, rule,
+        lookup(gutils->invertPointerM(orig_ptrs, Builder2), Builder2), dif);
+  }
+
+  /// Differentiate a scatter of orig_val to the vector of pointers orig_ptrs
+  /// under the new mask. The adjoint of each stored lane is gathered from the
+  /// shadows of the pointers, which are then zeroed.
+  void handleScatter(llvm::Instruction &I, Value *orig_val, Value *orig_ptrs,
+                     Value *mask, unsigned align) {
+    Module *M = I.getParent()->getParent()->getParent();
+    if (gutils->isConstantValue(orig_ptrs))
+      return;
+
+    Type *VT = orig_val->getType();
+    Type *tys[] = {VT, orig_ptrs->getType()};
+    auto gather = Intrinsic::getDeclaration(M, Intrinsic::masked_gather, tys);
+    auto scatter = Intrinsic::getDeclaration(M, Intrinsic::masked_scatter, tys);
+    bool constantval = gutils->isConstantValue(orig_val);
+
+    //! Storing a floating point value
+    if (Type *FT = TR.query(orig_val)[{-1}].isFloat()) {
+      switch (Mode) {
+      case DerivativeMode::ReverseModePrimal:
+        return;
+      case DerivativeMode::ForwardModeSplit:
+      case DerivativeMode::ForwardMode: {
+        IRBuilder<> Builder2(&I);
+        getForwardBuilder(Builder2);
+        Value *alignv = Builder2.getInt32(align);
+        Value *dif = constantval
+                         ? Constant::getNullValue(gutils->getShadowType(VT))
+                         : diffe(orig_val, Builder2);
+        auto rule = [&](Value *sptrs, Value *dif) {
+          Value *args[] = {dif, sptrs, alignv, mask};
+          Builder2.CreateCall(scatter, args);
+        };
+        applyChainRule(Builder2, rule,
+                       gutils->invertPointerM(orig_ptrs, Builder2), dif);
+        return;
+      }
+      case DerivativeMode::ReverseModeGradient:
+      case DerivativeMode::ReverseModeCombined: {
+        IRBuilder<> Builder2(I.getParent());
+        getReverseBuilder(Builder2);
+        Value *alignv = Builder2.getInt32(align);
+        Value *zero = Constant::getNullValue(VT);
+        mask = lookup(mask, Builder2);
+        Value *sptrs =
+            lookup(gutils->invertPointerM(orig_ptrs, Builder2), Builder2);
+
+        // Only the last lane storing to an address receives its adjoint.
+        if (!constantval) {
+          auto rule = [&](Value *sptrs) {
+            Value *last = lastWriterLanes(Builder2, sptrs, mask);
+            Value *args[] = {sptrs, alignv, last, zero};
+            return Builder2.CreateCall(gather, args);
+          };
+          Value *dif = applyChainRule(VT, Builder2, rule, sptrs);
+          addToDiffe(orig_val, dif, Builder2, FT);
+        }
+        auto rule = [&](Value *sptrs) {
+          Value *args[] = {zero, sptrs, alignv, mask};
+          Builder2.CreateCall(scatter, args);
+        };
+        applyChainRule(Builder2, rule, sptrs);
+        return;
+      }
+      }
+      return;
+    }
+
+    //! Storing an integer or pointer only needs to update the forward pass
+    if (Mode == DerivativeMode::ReverseModeGradient ||
+        Mode == DerivativeMode::ForwardModeSplit)
+      return;
+    IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&I));
+    Value *alignv = BuilderZ.getInt32(align);
+    Value *valueop;
+    if (constantval) {
+      Value *val = gutils->getNewFromOriginal(orig_val);
+      valueop = val;
+      if (gutils->getWidth() > 1) {
+        valueop = UndefValue::get(gutils->getShadowType(VT));
+        for (unsigned i = 0; i < gutils->getWidth(); ++i)
+          valueop = BuilderZ.CreateInsertValue(valueop, val, {i});
+      }
+    } else {
+      valueop = gutils->invertPointerM(orig_val, BuilderZ);
+    }
+    auto rule = [&](Value *sptrs, Value *valueop) {
+      Value *args[] = {valueop, sptrs, alignv, mask};
+      BuilderZ.CreateCall(scatter, args);
+    };
+    applyChainRule(BuilderZ, rule, gutils->invertPointerM(orig_ptrs, BuilderZ),
+                   valueop);
+  }
+
+#if LLVM_VERSION_MAJOR >= 14
+  /// The lanes of a vector-predicated intrinsic enabled by both its mask and
+  /// its explicit vector length
+  Value *getVPMask(IRBuilder<> &B, Value *mask, Value *evl) {
+    auto EC = cast<VectorType>(mask->getType())->getElementCount();
+    Value *lanes = B.CreateStepVector(VectorType::get(evl->getType(), EC));
+    return B.CreateAnd(
+        mask, B.CreateICmpULT(lanes, B.CreateVectorSplat(EC, evl)));
+  }
+
+  /// Differentiate the vector-predicated intrinsics, whose disabled lanes
+  /// neither read their operands nor receive an adjoint. Returns false for an
+  /// intrinsic it does not handle.
+  bool handleVPIntrinsic(llvm::VPIntrinsic &I) {
+    Module *M = I.getModule();
+    Intrinsic::ID ID = I.getIntrinsicID();
+    Value *orig_mask = I.getMaskParam();
+    Value *orig_evl = I.getVectorLengthParam();
+
+    switch (ID) {
+    // Memory accesses use their masked counterparts under the lanes enabled.
+    case Intrinsic::vp_load:
+    case Intrinsic::vp_store:
+    case Intrinsic::vp_gather:
+    case Intrinsic::vp_scatter: {
+      IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&I));
+      Value *mask = getVPMask(BuilderZ, gutils->getNewFromOriginal(orig_mask),
+                              gutils->getNewFromOriginal(orig_evl));
+      MaybeAlign align =
+          I.getParamAlign(*VPIntrinsic::getMemoryPointerParamPos(ID));
+      if (!align)
+        align = Align(1);
+      if (ID == Intrinsic::vp_load) {
+        auto &DL = gutils->newFunc->getParent()->getDataLayout();
+        bool constantval = parseTBAA(I, DL).Inner0().isIntegral();
+        visitLoadLike(I, align, constantval, mask,
+                      /*orig_maskInit*/ UndefValue::get(I.getType()));
+      } else if (ID == Intrinsic::vp_store) {
+        visitCommonStore(I, /*orig_ptr*/ I.getOperand(1),
+                         /*orig_val*/ I.getOperand(0), align,
+                         /*isVolatile*/ false, llvm::AtomicOrdering::NotAtomic,
+                         SyncScope::SingleThread, mask);
+      } else if (ID == Intrinsic::vp_gather) {
+        handleGather(I, I.getOperand(0), mask, /*orig_passthru*/ nullptr,
+                     align->value());
+      } else {
+        handleScatter(I, I.getOperand(0), I.getOperand(1), mask,
+                      align->value());
+      }
+      return true;
+    }
+    case Intrinsic::vp_fadd:
+    case Intrinsic::vp_fsub:
+    case Intrinsic::vp_fmul:
+    case Intrinsic::vp_fdiv:
+    case Intrinsic::vp_reduce_fadd:
+      break;
+    case Intrinsic::vp_reduce_fmax:
+    case Intrinsic::vp_reduce_fmin:
+      if (isa<ScalableVectorType>(I.getOperand(1)->getType()))
+        return false;
+      break;
+    default:
+      return false;
+    }
+
+    if (gutils->isConstantInstruction(&I) ||
+        Mode == DerivativeMode::ReverseModePrimal)
+      return true;
+
+    Value *orig_op0 = I.getOperand(0);
+    Value *orig_op1 = I.getOperand(1);
+    Type *VT = orig_op1->getType();
+    auto EC = cast<VectorType>(VT)->getElementCount();
+    Type *FT = VT->getScalarType();
+    bool reduction = ID == Intrinsic::vp_reduce_fadd ||
+                     ID == Intrinsic::vp_reduce_fmax ||
+                     ID == Intrinsic::vp_reduce_fmin;
+
+    if (Mode == DerivativeMode::ForwardMode ||
+        Mode == DerivativeMode::ForwardModeSplit) {
+      IRBuilder<> Builder2(&I);
+      getForwardBuilder(Builder2);
+      Value *a = gutils->getNewFromOriginal(orig_op0);
+      Value *b = gutils->getNewFromOriginal(orig_op1);
+      Value *mask = gutils->getNewFromOriginal(orig_mask);
+      Value *evl = gutils->getNewFromOriginal(orig_evl);
+
+      Value *da = gutils->isConstantValue(orig_op0)
+                      ? Constant::getNullValue(
+                            gutils->getShadowType(orig_op0->getType()))
+                      : diffe(orig_op0, Builder2);
+      Value *db = gutils->isConstantValue(orig_op1)
+                      ? Constant::getNullValue(gutils->getShadowType(VT))
+                      : diffe(orig_op1, Builder2);
+
+      auto vp = [&](Intrinsic::ID op, Value *x, Value *y) -> Value * {
+        Value *args[] = {x, y, mask, evl};
+        return Builder2.CreateCall(Intrinsic::getDeclaration(M, op, {VT}),
+                                   args);
+      };
+
+      // The derivative of a min/max reduction is that of the start value or
+      // of the first enabled lane attaining the extremum.
+      Value *startWins = nullptr, *first = nullptr;
+      if (ID == Intrinsic::vp_reduce_fmax || ID == Intrinsic::vp_reduce_fmin) {
+        Value *args[] = {a, b, mask, evl};
+        Value *res = Builder2.CreateCall(I.getCalledFunction(), args);
+        startWins = Builder2.CreateFCmpOEQ(a, res);
+        Value *attains =
+            Builder2.CreateFCmpOEQ(b, Builder2.CreateVectorSplat(EC, res));
+        first = firstActiveLane(
+            Builder2,
+            Builder2.CreateAnd(getVPMask(Builder2, mask, evl), attains));
+      }
+
+      auto rule = [&](Value *da, Value *db) -> Value * {
+        switch (ID) {
+        case Intrinsic::vp_fadd:
+        case Intrinsic::vp_fsub:
+          return vp(ID, da, db);
+        case Intrinsic::vp_fmul:
+          return vp(Intrinsic::vp_fadd, vp(Intrinsic::vp_fmul, da, b),
+                    vp(Intrinsic::vp_fmul, a, db));
+        case Intrinsic::vp_fdiv:
+          return vp(Intrinsic::vp_fdiv,
+                    vp(Intrinsic::vp_fsub, vp(Intrinsic::vp_fmul, da, b),
+                       vp(Intrinsic::vp_fmul, a, db)),
+                    vp(Intrinsic::vp_fmul, b, b));
+        case Intrinsic::vp_reduce_fadd:
+          return vp(ID, da, db);
+        default: {
+          Value *args[] = {
+              ConstantFP::getNegativeZero(FT),
+              Builder2.CreateSelect(first, db, Constant::getNullValue(VT))};
+          Value *lane = Builder2.CreateCall(
+              Intrinsic::getDeclaration(M, Intrinsic::vector_reduce_fadd,
+                                        {VT}),
+              args);
+          return Builder2.CreateSelect(startWins, da, lane);
+        }
+        }
+      };
+      setDiffe(&I, applyChainRule(I.getType(), Builder2, rule, da, db),
+               Builder2);
+      return true;
+    }
+
+    IRBuilder<> Builder2(I.getParent());
+    getReverseBuilder(Builder2);
+
+    Value *dif = diffe(&I, Builder2);
+    setDiffe(&I, Constant::getNullValue(gutils->getShadowType(I.getType())),
+             Builder2);
+    Value *mask = getVPMask(
+        Builder2, lookup(gutils->getNewFromOriginal(orig_mask), Builder2),
+        lookup(gutils->getNewFromOriginal(orig_evl), Builder2));
+    Value *zero = Constant::getNullValue(VT);
+
+    if (reduction) {
+      Value *startWins = nullptr, *first = mask;
+      if (ID != Intrinsic::vp_reduce_fadd) {
+        Value *a = lookup(gutils->getNewFromOriginal(orig_op0), Builder2);
+        Value *b = lookup(gutils->getNewFromOriginal(orig_op1), Builder2);
+        Value *args[] = {
+            a, b, lookup(gutils->getNewFromOriginal(orig_mask), Builder2),
+            lookup(gutils->getNewFromOriginal(orig_evl), Builder2)};
+        Value *res = Builder2.CreateCall(I.getCalledFunction(), args);
+        startWins = Builder2.CreateFCmpOEQ(a, res);
+        Value *attains =
+            Builder2.CreateFCmpOEQ(b, Builder2.CreateVectorSplat(EC, res));
+        first = Builder2.CreateSelect(
+            startWins, Constant::getNullValue(mask->getType()),
+            firstActiveLane(Builder2, Builder2.CreateAnd(mask, attains)));
+      }
+      if (!gutils->isConstantValue(orig_op0)) {
+        auto rule = [&](Value *dif) {
+          if (!startWins)
+            return dif;
+          return Builder2.CreateSelect(startWins, dif,
+                                       Constant::getNullValue(FT));
+        };
+        addToDiffe(orig_op0, applyChainRule(FT, Builder2, rule, dif),
+                   Builder2, FT);
+      }
+      if (!gutils->isConstantValue(orig_op1)) {
+        auto rule = [&](Value *dif) {
+          return Builder2.CreateSelect(
+              first, Builder2.CreateVectorSplat(EC, dif), zero);
+        };
+        addToDiffe(orig_op1, applyChainRule(VT, Builder2, rule, dif),
+                   Builder2, FT);
+      }
+      return true;
+    }
+
+    if (!gutils->isConstantValue(orig_op0)) {
+      auto rule = [&](Value *dif) {
+        Value *res = dif;
+        if (ID == Intrinsic::vp_fmul)
+          res = Builder2.CreateFMul(
+              dif, lookup(gutils->getNewFromOriginal(orig_op1), Builder2));
+        else if (ID == Intrinsic::vp_fdiv)
+          res = Builder2.CreateFDiv(
+              dif, lookup(gutils->getNewFromOriginal(orig_op1), Builder2));
+        return Builder2.CreateSelect(mask, res, zero);
+      };
+      addToDiffe(orig_op0, applyChainRule(VT, Builder2, rule, dif), Builder2,
+                 FT);
+    }
+    if (!gutils->isConstantValue(orig_op1)) {
+      auto rule = [&](Value *dif) {
+        Value *res = dif;
+        if (ID == Intrinsic::vp_fsub) {
+          res = Builder2.CreateFNeg(dif);
+        } else if (ID == Intrinsic::vp_fmul) {
+          res = Builder2.CreateFMul(
+              dif, lookup(gutils->getNewFromOriginal(orig_op0), Builder2));
+        } else if (ID == Intrinsic::vp_fdiv) {
+          Value *a = lookup(gutils->getNewFromOriginal(orig_op0), Builder2);
+          Value *b = lookup(gutils->getNewFromOriginal(orig_op1), Builder2);
+          res = Builder2.CreateFNeg(Builder2.CreateFDiv(
+              Builder2.CreateFMul(dif, a), Builder2.CreateFMul(b, b)));
+        }
+        return Builder2.CreateSelect(mask, res, zero);
+      };
+      addToDiffe(orig_op1, applyChainRule(VT, Builder2, rule, dif), Builder2,
+                 FT);
+    }
+    return true;
+  }
+#endif
+
   void handleAdjointForIntrinsic(Intrinsic::ID ID, llvm::Instruction &I,
                                  SmallVectorImpl<Value *> &orig_ops) {
 
@@ -3756,6 +4196,26 @@ public:
                     /*orig_maskInit*/ I.getOperand(3));
       return;
     }
+    if (ID == Intrinsic::masked_gather) {
+      auto align = cast<ConstantInt>(I.getOperand(1))->getZExtValue();
+      handleGather(I, /*orig_ptrs*/ I.getOperand(0),
+                   /*mask*/ gutils->getNewFromOriginal(I.getOperand(2)),
+                   /*orig_passthru*/ I.getOperand(3), align);
+      return;
+    }
+    if (ID == Intrinsic::masked_scatter) {
+      auto align = cast<ConstantInt>(I.getOperand(2))->getZExtValue();
+      handleScatter(I, /*orig_val*/ I.getOperand(0),
+                    /*orig_ptrs*/ I.getOperand(1),
+                    /*mask*/ gutils->getNewFromOriginal(I.getOperand(3)),
+                    align);
+      return;
+    }
+#if LLVM_VERSION_MAJOR >= 14
+    if (auto VPI = dyn_cast<VPIntrinsic>(&I))
+      if (handleVPIntrinsic(*VPI))
+        return;
+#endif
 
     switch (Mode) {
     case DerivativeMode::ReverseModePrimal: {
@@ -3782,12 +4242,22 @@ public:
       case Intrinsic::nvvm_fabs_f:
       case Intrinsic::nvvm_fabs_d:
       case Intrinsic::nvvm_fabs_ftz_f:
-#if LLVM_VERSION_MAJOR < 10
       case Intrinsic::x86_sse_max_ss:
       case Intrinsic::x86_sse_max_ps:
       case Intrinsic::x86_sse_min_ss:
       case Intrinsic::x86_sse_min_ps:
-#endif
+      case Intrinsic::x86_sse2_max_sd:
+      case Intrinsic::x86_sse2_max_pd:
+      case Intrinsic::x86_sse2_min_sd:
+      case Intrinsic::x86_sse2_min_pd:
+      case Intrinsic::x86_avx_max_ps_256:
+      case Intrinsic::x86_avx_max_pd_256:
+      case Intrinsic::x86_avx_min_ps_256:
+      case Intrinsic::x86_avx_min_pd_256:
+      case Intrinsic::x86_sse41_blendvps:
+      case Intrinsic::x86_sse41_blendvpd:
+      case Intrinsic::x86_avx_blendv_ps_256:
+      case Intrinsic::x86_avx_blendv_pd_256:
       case Intrinsic::nvvm_fmax_f:
       case Intrinsic::nvvm_fmax_d:
       case Intrinsic::nvvm_fmax_ftz_f:
@@ -3810,6 +4280,8 @@ public:
 #if LLVM_VERSION_MAJOR >= 12
       case Intrinsic::vector_reduce_fadd:
       case Intrinsic::vector_reduce_fmul:
+      case Intrinsic::vector_reduce_fmax:
+      case Intrinsic::vector_reduce_fmin:
 #elif LLVM_VERSION_MAJOR >= 9
       case Intrinsic::experimental_vector_reduce_v2_fadd:
       case Intrinsic::experimental_vector_reduce_v2_fmul:
@@ -3938,6 +4410,32 @@ public:
       }
 #endif
 
+#if LLVM_VERSION_MAJOR >= 12
+      case Intrinsic::vector_reduce_fmax:
+      case Intrinsic::vector_reduce_fmin: {
+        if (vdiff && !gutils->isConstantValue(orig_ops[0])) {
+          Type *VT = orig_ops[0]->getType();
+          auto EC = cast<VectorType>(VT)->getElementCount();
+          Value *vec =
+              lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2);
+          Value *res =
+              Builder2.CreateCall(cast<CallInst>(I).getCalledFunction(), vec);
+          // The adjoint flows to the first lane attaining the extremum.
+          Value *first = firstActiveLane(
+              Builder2, Builder2.CreateFCmpOEQ(
+                            vec, Builder2.CreateVectorSplat(EC, res)));
+          auto rule = [&](Value *vdiff) {
+            return Builder2.CreateSelect(first,
+                                         Builder2.CreateVectorSplat(EC, vdiff),
+                                         Constant::getNullValue(VT));
+          };
+          Value *dif0 = applyChainRule(VT, Builder2, rule, vdiff);
+          addToDiffe(orig_ops[0], dif0, Builder2, I.getType());
+        }
+        return;
+      }
+#endif
+
       case Intrinsic::lifetime_start: {
         if (gutils->isConstantInstruction(&I))
           return;
@@ -3956,22 +4454,9 @@ public:
       case Intrinsic::nvvm_sqrt_rn_d:
       case Intrinsic::sqrt: {
         if (vdiff && !gutils->isConstantValue(orig_ops[0])) {
-          SmallVector<Value *, 2> args = {
-              lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
-
-          auto &CI = cast<CallInst>(I);
-#if LLVM_VERSION_MAJOR >= 11
-          auto *SqrtF = CI.getCalledOperand();
-#else
-          auto *SqrtF = CI.getCalledValue();
-#endif
-          assert(SqrtF);
-          auto FT =
-              cast<FunctionType>(SqrtF->getType()->getPointerElementType());
-
-          auto cal = cast<CallInst>(Builder2.CreateCall(FT, SqrtF, args));
-          cal->setCallingConv(CI.getCallingConv());
-          cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+          // The derivative reuses the primal result, see
+          // derivativeReusesResult, which is zero exactly when the operand is.
+          Value *cal = lookup(gutils->getNewFromOriginal(&I), Builder2);
 
           auto rule = [&](Value *vdiff) {
             return Builder2.CreateFDiv(
@@ -3982,8 +4467,8 @@ public:
           Value *dif0 =
               applyChainRule(orig_ops[0]->getType(), Builder2, rule, vdiff);
           Value *cmp = Builder2.CreateFCmpOEQ(
-              args[0], Constant::getNullValue(
-                           gutils->getShadowType(orig_ops[0]->getType())));
+              cal, Constant::getNullValue(
+                       gutils->getShadowType(orig_ops[0]->getType())));
           dif0 = Builder2.CreateSelect(
               cmp,
               Constant::getNullValue(
@@ -4018,10 +4503,44 @@ public:
         return;
       }
 
-#if LLVM_VERSION_MAJOR < 10
       case Intrinsic::x86_sse_max_ss:
       case Intrinsic::x86_sse_max_ps:
-#endif
+      case Intrinsic::x86_sse_min_ss:
+      case Intrinsic::x86_sse_min_ps:
+      case Intrinsic::x86_sse2_max_sd:
+      case Intrinsic::x86_sse2_max_pd:
+      case Intrinsic::x86_sse2_min_sd:
+      case Intrinsic::x86_sse2_min_pd:
+      case Intrinsic::x86_avx_max_ps_256:
+      case Intrinsic::x86_avx_max_pd_256:
+      case Intrinsic::x86_avx_min_ps_256:
+      case Intrinsic::x86_avx_min_pd_256:
+      case Intrinsic::x86_sse41_blendvps:
+      case Intrinsic::x86_sse41_blendvpd:
+      case Intrinsic::x86_avx_blendv_ps_256:
+      case Intrinsic::x86_avx_blendv_pd_256:
+      {
+        if (!vdiff || (gutils->isConstantValue(orig_ops[0]) &&
+                       gutils->isConstantValue(orig_ops[1])))
+          return;
+        SmallVector<Value *, 3> args;
+        for (auto op : ArrayRef<Value *>(orig_ops).drop_back())
+          args.push_back(lookup(gutils->getNewFromOriginal(op), Builder2));
+        Value *sel = x86SelectsFirstOperand(Builder2, ID, args);
+        Value *zero = Constant::getNullValue(I.getType());
+        for (int i = 0; i < 2; i++) {
+          if (gutils->isConstantValue(orig_ops[i]))
+            continue;
+          auto rule = [&](Value *vdiff) {
+            return i == 0 ? Builder2.CreateSelect(sel, vdiff, zero)
+                          : Builder2.CreateSelect(sel, zero, vdiff);
+          };
+          Value *dif = applyChainRule(I.getType(), Builder2, rule, vdiff);
+          addToDiffe(orig_ops[i], dif, Builder2, I.getType());
+        }
+        return;
+      }
+
       case Intrinsic::nvvm_fmax_f:
       case Intrinsic::nvvm_fmax_d:
       case Intrinsic::nvvm_fmax_ftz_f:
@@ -4052,10 +4571,6 @@ public:
         return;
       }
 
-#if LLVM_VERSION_MAJOR < 10
-      case Intrinsic::x86_sse_min_ss:
-      case Intrinsic::x86_sse_min_ps:
-#endif
       case Intrinsic::nvvm_fmin_f:
       case Intrinsic::nvvm_fmin_d:
       case Intrinsic::nvvm_fmin_ftz_f:
@@ -4168,15 +4683,20 @@ public:
       case Intrinsic::nvvm_ex2_approx_f:
       case Intrinsic::nvvm_ex2_approx_d: {
         if (vdiff && !gutils->isConstantValue(orig_ops[0])) {
-          SmallVector<Value *, 2> args = {
-              lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
-          SmallVector<Type *, 1> tys;
-          if (ID == Intrinsic::exp || ID == Intrinsic::exp2)
-            tys.push_back(orig_ops[0]->getType());
-          auto ExpF = Intrinsic::getDeclaration(M, ID, tys);
-          auto cal = cast<CallInst>(Builder2.CreateCall(ExpF, args));
-          cal->setCallingConv(ExpF->getCallingConv());
-          cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+          Value *cal = nullptr;
+          if (ID == Intrinsic::exp || ID == Intrinsic::exp2) {
+            // The derivative reuses the primal result, see
+            // derivativeReusesResult.
+            cal = lookup(gutils->getNewFromOriginal(&I), Builder2);
+          } else {
+            SmallVector<Value *, 2> args = {
+                lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
+            auto ExpF = Intrinsic::getDeclaration(M, ID);
+            auto ExpC = cast<CallInst>(Builder2.CreateCall(ExpF, args));
+            ExpC->setCallingConv(ExpF->getCallingConv());
+            ExpC->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+            cal = ExpC;
+          }
 
           auto rule = [&](Value *vdiff) {
             Value *dif0 = Builder2.CreateFMul(vdiff, cal);
@@ -4252,12 +4772,18 @@ public:
           cal->setCallingConv(CI.getCallingConv());
 
           cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
-          Value *op1Lookup = lookup(op1, Builder2);
+          Value *cast = Builder2.CreateSIToFP(lookup(op1, Builder2),
+                                              op0->getType()->getScalarType());
+          // The exponent of a vector powi is a scalar, splat it to match the
+          // lanes so the derivative stays a single vector operation.
+          if (auto VT = dyn_cast<VectorType>(op0->getType()))
+#if LLVM_VERSION_MAJOR >= 12
+            cast = Builder2.CreateVectorSplat(VT->getElementCount(), cast);
+#else
+            cast = Builder2.CreateVectorSplat(VT->getNumElements(), cast);
+#endif
           auto rule = [&](Value *vdiff) {
-            return Builder2.CreateFMul(
-                Builder2.CreateFMul(vdiff, cal),
-                Builder2.CreateSIToFP(op1Lookup,
-                                      op0->getType()->getScalarType()));
+            return Builder2.CreateFMul(Builder2.CreateFMul(vdiff, cal), cast);
           };
           Value *dif0 =
               applyChainRule(orig_ops[0]->getType(), Builder2, rule, vdiff);
@@ -4343,11 +4869,16 @@ public:
       }
       case Intrinsic::sin: {
         if (vdiff && !gutils->isConstantValue(orig_ops[0])) {
-          Value *args[] = {
-              lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
-          Type *tys[] = {orig_ops[0]->getType()};
-          CallInst *cal = cast<CallInst>(Builder2.CreateCall(
-              Intrinsic::getDeclaration(M, Intrinsic::cos, tys), args));
+          Value *cal = nullptr;
+          if (auto companion = findDerivativeCompanion(&cast<CallInst>(I))) {
+            cal = lookup(gutils->getNewFromOriginal(companion), Builder2);
+          } else {
+            Value *args[] = {
+                lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
+            Type *tys[] = {orig_ops[0]->getType()};
+            cal = Builder2.CreateCall(
+                Intrinsic::getDeclaration(M, Intrinsic::cos, tys), args);
+          }
           auto rule = [&](Value *vdiff) {
             return Builder2.CreateFMul(vdiff, cal);
           };
@@ -4359,11 +4890,16 @@ public:
       }
       case Intrinsic::cos: {
         if (vdiff && !gutils->isConstantValue(orig_ops[0])) {
-          Value *args[] = {
-              lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
-          Type *tys[] = {orig_ops[0]->getType()};
-          CallInst *cal = cast<CallInst>(Builder2.CreateCall(
-              Intrinsic::getDeclaration(M, Intrinsic::sin, tys), args));
+          Value *cal = nullptr;
+          if (auto companion = findDerivativeCompanion(&cast<CallInst>(I))) {
+            cal = lookup(gutils->getNewFromOriginal(companion), Builder2);
+          } else {
+            Value *args[] = {
+                lookup(gutils->getNewFromOriginal(orig_ops[0]), Builder2)};
+            Type *tys[] = {orig_ops[0]->getType()};
+            cal = Builder2.CreateCall(
+                Intrinsic::getDeclaration(M, Intrinsic::sin, tys), args);
+          }
           auto rule = [&](Value *vdiff) {
             return Builder2.CreateFMul(vdiff, Builder2.CreateFNeg(cal));
           };
@@ -4453,6 +4989,38 @@ public:
         setDiffe(&I, dif, Builder2);
         return;
       }
+#endif
+#if LLVM_VERSION_MAJOR >= 12
+      case Intrinsic::vector_reduce_fmax:
+      case Intrinsic::vector_reduce_fmin: {
+        if (gutils->isConstantInstruction(&I))
+          return;
+
+        Type *VT = orig_ops[0]->getType();
+        auto EC = cast<VectorType>(VT)->getElementCount();
+        Value *vec = gutils->getNewFromOriginal(orig_ops[0]);
+        Value *res =
+            Builder2.CreateCall(cast<CallInst>(I).getCalledFunction(), vec);
+        Value *first = firstActiveLane(
+            Builder2,
+            Builder2.CreateFCmpOEQ(vec, Builder2.CreateVectorSplat(EC, res)));
+        Value *vecdif = diffe(orig_ops[0], Builder2);
+
+        auto vfra =
+            Intrinsic::getDeclaration(M, Intrinsic::vector_reduce_fadd, {VT});
+        auto rule = [&](Value *vecdif) {
+          Value *args[] = {
+              ConstantFP::getNegativeZero(I.getType()),
+              Builder2.CreateSelect(first, vecdif, Constant::getNullValue(VT))};
+          auto cal = Builder2.CreateCall(vfra, args);
+          cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+          return cal;
+        };
+
+        Value *dif = applyChainRule(I.getType(), Builder2, rule, vecdif);
+        setDiffe(&I, dif, Builder2);
+        return;
+      }
 #endif
       case Intrinsic::nvvm_sqrt_rn_d:
       case Intrinsic::sqrt: {
@@ -4461,33 +5029,20 @@ public:
 
         Value *op = diffe(orig_ops[0], Builder2);
         Type *opType = orig_ops[0]->getType();
-        Value *args[1] = {gutils->getNewFromOriginal(orig_ops[0])};
-        Type *tys[] = {orig_ops[0]->getType()};
-
-        auto &CI = cast<CallInst>(I);
-#if LLVM_VERSION_MAJOR >= 11
-        auto *SqrtF = CI.getCalledOperand();
-#else
-        auto *SqrtF = CI.getCalledValue();
-#endif
-        assert(SqrtF);
-        auto FT = cast<FunctionType>(SqrtF->getType()->getPointerElementType());
+        Value *cal = gutils->getNewFromOriginal(&I);
 
         auto rule = [&](Value *op) {
-          CallInst *cal = cast<CallInst>(Builder2.CreateCall(FT, SqrtF, args));
-          cal->setCallingConv(CI.getCallingConv());
-          cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
-
-          Value *half = ConstantFP::get(orig_ops[0]->getType(), 0.5);
-          Value *dif0 = Builder2.CreateFDiv(Builder2.CreateFMul(half, op), cal);
+          Value *half = ConstantFP::get(op->getType(), 0.5);
+          Value *res = gutils->splatLike(Builder2, cal, op);
+          Value *dif0 = Builder2.CreateFDiv(Builder2.CreateFMul(half, op), res);
 
           Value *cmp =
-              Builder2.CreateFCmpOEQ(args[0], Constant::getNullValue(tys[0]));
-          return Builder2.CreateSelect(cmp, Constant::getNullValue(opType),
-                                       dif0);
+              Builder2.CreateFCmpOEQ(cal, Constant::getNullValue(opType));
+          return Builder2.CreateSelect(
+              cmp, Constant::getNullValue(op->getType()), dif0);
         };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4517,15 +5072,53 @@ public:
         return;
       }
 
-#if LLVM_VERSION_MAJOR < 10
       case Intrinsic::x86_sse_max_ss:
       case Intrinsic::x86_sse_max_ps:
-#endif
-      case Intrinsic::nvvm_fmax_f:
-      case Intrinsic::nvvm_fmax_d:
-      case Intrinsic::nvvm_fmax_ftz_f:
-      case Intrinsic::maxnum: {
-        if (gutils->isConstantInstruction(&I))
+      case Intrinsic::x86_sse_min_ss:
+      case Intrinsic::x86_sse_min_ps:
+      case Intrinsic::x86_sse2_max_sd:
+      case Intrinsic::x86_sse2_max_pd:
+      case Intrinsic::x86_sse2_min_sd:
+      case Intrinsic::x86_sse2_min_pd:
+      case Intrinsic::x86_avx_max_ps_256:
+      case Intrinsic::x86_avx_max_pd_256:
+      case Intrinsic::x86_avx_min_ps_256:
+      case Intrinsic::x86_avx_min_pd_256:
+      case Intrinsic::x86_sse41_blendvps:
+      case Intrinsic::x86_sse41_blendvpd:
+      case Intrinsic::x86_avx_blendv_ps_256:
+      case Intrinsic::x86_avx_blendv_pd_256:
+      {
+        if (gutils->isConstantInstruction(&I))
+          return;
+        SmallVector<Value *, 3> args;
+        for (auto op : ArrayRef<Value *>(orig_ops).drop_back())
+          args.push_back(gutils->getNewFromOriginal(op));
+        Value *sel = x86SelectsFirstOperand(Builder2, ID, args);
+
+        Type *opType = gutils->getShadowType(I.getType());
+        Value *diffe0 = gutils->isConstantValue(orig_ops[0])
+                            ? Constant::getNullValue(opType)
+                            : diffe(orig_ops[0], Builder2);
+        Value *diffe1 = gutils->isConstantValue(orig_ops[1])
+                            ? Constant::getNullValue(opType)
+                            : diffe(orig_ops[1], Builder2);
+
+        auto rule = [&](Value *diffe0, Value *diffe1) {
+          return Builder2.CreateSelect(sel, diffe0, diffe1);
+        };
+
+        Value *dif =
+            applyChainRule(I.getType(), Builder2, rule, diffe0, diffe1);
+        setDiffe(&I, dif, Builder2);
+        return;
+      }
+
+      case Intrinsic::nvvm_fmax_f:
+      case Intrinsic::nvvm_fmax_d:
+      case Intrinsic::nvvm_fmax_ftz_f:
+      case Intrinsic::maxnum: {
+        if (gutils->isConstantInstruction(&I))
           return;
         Value *op0 = gutils->getNewFromOriginal(orig_ops[0]);
         Value *op1 = gutils->getNewFromOriginal(orig_ops[1]);
@@ -4551,10 +5144,6 @@ public:
         return;
       }
 
-#if LLVM_VERSION_MAJOR < 10
-      case Intrinsic::x86_sse_min_ss:
-      case Intrinsic::x86_sse_min_ps:
-#endif
       case Intrinsic::nvvm_fmin_f:
       case Intrinsic::nvvm_fmin_d:
       case Intrinsic::nvvm_fmin_ftz_f:
@@ -4632,9 +5221,12 @@ public:
         Value *op = diffe(orig_ops[0], Builder2);
         Value *origOp = gutils->getNewFromOriginal(orig_ops[0]);
 
-        auto rule = [&](Value *op) { return Builder2.CreateFDiv(op, origOp); };
+        auto rule = [&](Value *op) {
+          return Builder2.CreateFDiv(op,
+                                     gutils->splatLike(Builder2, origOp, op));
+        };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4648,9 +5240,11 @@ public:
         Value *origOp = gutils->getNewFromOriginal(orig_ops[0]);
         Value *mul = Builder2.CreateFMul(c, origOp);
 
-        auto rule = [&](Value *op) { return Builder2.CreateFDiv(op, mul); };
+        auto rule = [&](Value *op) {
+          return Builder2.CreateFDiv(op, gutils->splatLike(Builder2, mul, op));
+        };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4663,9 +5257,11 @@ public:
         Value *origOp = gutils->getNewFromOriginal(orig_ops[0]);
         Value *mul = Builder2.CreateFMul(c, origOp);
 
-        auto rule = [&](Value *op) { return Builder2.CreateFDiv(op, mul); };
+        auto rule = [&](Value *op) {
+          return Builder2.CreateFDiv(op, gutils->splatLike(Builder2, mul, op));
+        };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4679,25 +5275,30 @@ public:
           return;
 
         Value *op = diffe(orig_ops[0], Builder2);
-        Value *args[1] = {gutils->getNewFromOriginal(orig_ops[0])};
-        SmallVector<Type *, 1> tys;
-        if (ID == Intrinsic::exp || ID == Intrinsic::exp2)
-          tys.push_back(orig_ops[0]->getType());
-        auto ExpF = Intrinsic::getDeclaration(M, ID, tys);
-        CallInst *cal = Builder2.CreateCall(ExpF, args);
-        cal->setCallingConv(ExpF->getCallingConv());
-        cal->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+        Value *cal = nullptr;
+        if (ID == Intrinsic::exp || ID == Intrinsic::exp2) {
+          cal = gutils->getNewFromOriginal(&I);
+        } else {
+          Value *args[1] = {gutils->getNewFromOriginal(orig_ops[0])};
+          auto ExpF = Intrinsic::getDeclaration(M, ID);
+          CallInst *ExpC = Builder2.CreateCall(ExpF, args);
+          ExpC->setCallingConv(ExpF->getCallingConv());
+          ExpC->setDebugLoc(gutils->getNewFromOriginal(I.getDebugLoc()));
+          cal = ExpC;
+        }
 
         Value *c = ConstantFP::get(I.getType(), 0.6931471805599453);
 
         auto rule = [&](Value *op) {
-          Value *dif0 = Builder2.CreateFMul(op, cal);
+          Value *dif0 =
+              Builder2.CreateFMul(op, gutils->splatLike(Builder2, cal, op));
           if (ID != Intrinsic::exp)
-            dif0 = Builder2.CreateFMul(dif0, c);
+            dif0 = Builder2.CreateFMul(dif0,
+                                       gutils->splatLike(Builder2, c, op));
           return dif0;
         };
 
-        auto dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        auto dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4765,6 +5366,12 @@ public:
 
           Value *cast =
               Builder2.CreateSIToFP(op1, op0->getType()->getScalarType());
+          if (auto VT = dyn_cast<VectorType>(op0->getType()))
+#if LLVM_VERSION_MAJOR >= 12
+            cast = Builder2.CreateVectorSplat(VT->getElementCount(), cast);
+#else
+            cast = Builder2.CreateVectorSplat(VT->getNumElements(), cast);
+#endif
           Value *op = diffe(orig_ops[0], Builder2);
 
           Value *cmp = Builder2.CreateICmpEQ(
@@ -4885,9 +5492,11 @@ public:
             Intrinsic::getDeclaration(M, Intrinsic::cos, tys), args);
         Value *op = diffe(orig_ops[0], Builder2);
 
-        auto rule = [&](Value *op) { return Builder2.CreateFMul(op, cal); };
+        auto rule = [&](Value *op) {
+          return Builder2.CreateFMul(op, gutils->splatLike(Builder2, cal, op));
+        };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4902,9 +5511,11 @@ public:
         cal = Builder2.CreateFNeg(cal);
         Value *op = diffe(orig_ops[0], Builder2);
 
-        auto rule = [&](Value *op) { return Builder2.CreateFMul(op, cal); };
+        auto rule = [&](Value *op) {
+          return Builder2.CreateFMul(op, gutils->splatLike(Builder2, cal, op));
+        };
 
-        Value *dif0 = applyChainRule(I.getType(), Builder2, rule, op);
+        Value *dif0 = applyVectorChainRule(I.getType(), Builder2, rule, op);
         setDiffe(&I, dif0, Builder2);
         return;
       }
@@ -4943,19 +5554,588 @@ public:
     }
   }
 
+  /// Create a function with the signature of a parallel-for body whose
+  /// closure argument instead points to PackTy, the state needed by a
+  /// derivative body. Emit is called to produce the contents of the body given
+  /// the iteration index and the unpacked fields.
+  llvm::Function *createParallelForBody(
+      llvm::Function *body, llvm::StructType *PackTy, const llvm::Twine &Name,
+      llvm::function_ref<void(llvm::IRBuilder<> &, llvm::Value *,
+                              llvm::ArrayRef<llvm::Value *>)>
+          Emit) {
+    auto W = Function::Create(body->getFunctionType(),
+                              GlobalValue::InternalLinkage, Name,
+                              body->getParent());
+    W->addFnAttr(Attribute::AlwaysInline);
+    IRBuilder<> B(BasicBlock::Create(W->getContext(), "entry", W));
+    auto idx = W->arg_begin();
+    auto pack =
+        B.CreatePointerCast(idx + 1, PointerType::getUnqual(PackTy), "pack");
+    SmallVector<Value *, 4> fields;
+    for (unsigned i = 0; i < PackTy->getNumElements(); i++) {
+#if LLVM_VERSION_MAJOR > 7
+      fields.push_back(B.CreateLoad(PackTy->getElementType(i),
+                                    B.CreateStructGEP(PackTy, pack, i)));
+#else
+      fields.push_back(B.CreateLoad(B.CreateStructGEP(PackTy, pack, i)));
+#endif
+    }
+    Emit(B, idx, fields);
+    B.CreateRetVoid();
+    return W;
+  }
+
+  /// Differentiate a call to a parallel runtime registered through
+  /// __enzyme_register_parallel_for, which must have the form
+  ///   parallel_for(begin, end, void (*body)(index, closure), closure)
+  /// and call body(i, closure) for every i in [begin, end) in any order and
+  /// on any thread before returning. The body is differentiated once and the
+  /// derivative bodies are scheduled through the same runtime. Reverse
+  /// bodies accumulate into shared shadow memory atomically and find their
+  /// tape in a per-iteration slot written by the augmented forward bodies.
+  /// Split forward mode is not supported and is reported as an error.
+  void visitParallelForCall(llvm::CallInst &call) {
+    Value *bodyv = call.getArgOperand(2);
+    while (auto CE = dyn_cast<ConstantExpr>(bodyv)) {
+      if (!CE->isCast())
+        break;
+      bodyv = CE->getOperand(0);
+    }
+    Function *body = dyn_cast<Function>(bodyv);
+    if (!body || body->empty() || body->arg_size() != 2 ||
+        !body->getReturnType()->isVoidTy() ||
+        !body->getFunctionType()->getParamType(0)->isIntegerTy() ||
+        !body->getFunctionType()->getParamType(1)->isPointerTy()) {
+      llvm::errs() << "could not derive parallel body of: " << call << "\n";
+      llvm_unreachable("could not derive parallel body");
+    }
+
+    IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&call));
+    BuilderZ.setFastMathFlags(getFast());
+
+    auto &Ctx = call.getContext();
+    Type *IdxTy = body->getFunctionType()->getParamType(0);
+    Type *ClosureTy = body->getFunctionType()->getParamType(1);
+    Type *ShadowTy = gutils->getShadowType(ClosureTy);
+    Value *closure = call.getArgOperand(3);
+    DIFFE_TYPE closureType = gutils->getDiffeType(closure, false);
+    std::vector<DIFFE_TYPE> argsInverted = {DIFFE_TYPE::CONSTANT, closureType};
+    bool dup = closureType != DIFFE_TYPE::CONSTANT;
+
+    FnTypeInfo nextTypeInfo(body);
+    std::map<Argument *, bool> uncacheable_args;
+    {
+      Argument *idx = body->arg_begin();
+      Argument *arg = idx + 1;
+      TypeTree IntTree;
+      IntTree.insert({-1}, BaseType::Integer);
+      nextTypeInfo.Arguments.insert(
+          std::pair<Argument *, TypeTree>(idx, IntTree));
+      nextTypeInfo.KnownValues.insert(
+          std::pair<Argument *, std::set<int64_t>>(idx, {}));
+      nextTypeInfo.Arguments.insert(
+          std::pair<Argument *, TypeTree>(arg, TR.query(closure)));
+      nextTypeInfo.KnownValues.insert(
+          std::pair<Argument *, std::set<int64_t>>(arg, {}));
+      nextTypeInfo.Return = TypeTree();
+
+      bool closureUncacheable = true;
+      auto found = uncacheable_args_map.find(&call);
+      if (found != uncacheable_args_map.end())
+        for (auto &pair : found->second)
+          if (pair.first->getArgNo() == 3)
+            closureUncacheable = pair.second;
+      uncacheable_args[idx] = false;
+      uncacheable_args[arg] = closureUncacheable;
+    }
+
+    auto castShadow = [&](IRBuilder<> &B, Value *shadow) {
+      return gutils->applyChainRule(
+          ShadowTy, B,
+          [&](Value *v) { return B.CreatePointerCast(v, ClosureTy); }, shadow);
+    };
+    auto runtimeCall = [&](IRBuilder<> &B, Value *begin, Value *end,
+                           Function *W, Value *pack) {
+      auto FT = call.getFunctionType();
+      Value *args[] = {begin, end,
+                       B.CreatePointerCast(W, FT->getParamType(2)),
+                       B.CreatePointerCast(pack, FT->getParamType(3))};
+#if LLVM_VERSION_MAJOR >= 11
+      auto callval = call.getCalledOperand();
+#else
+      auto callval = call.getCalledValue();
+#endif
+      auto CI = B.CreateCall(FT, callval, args);
+      CI->setCallingConv(call.getCallingConv());
+      CI->setDebugLoc(gutils->getNewFromOriginal(call.getDebugLoc()));
+      return CI;
+    };
+
+    if (Mode == DerivativeMode::ForwardMode) {
+      auto newcalled = gutils->Logic.CreateForwardDiff(
+          body, DIFFE_TYPE::CONSTANT, argsInverted, TR.analyzer.interprocedural,
+          /*returnValue*/ false, Mode, /*freeMemory*/ true, gutils->getWidth(),
+          /*additionalArg*/ nullptr, nextTypeInfo, uncacheable_args,
+          /*augmented*/ nullptr);
+      SmallVector<Type *, 2> fields = {ClosureTy};
+      if (dup)
+        fields.push_back(ShadowTy);
+      auto PackTy = StructType::get(Ctx, fields);
+      auto W = createParallelForBody(
+          body, PackTy, newcalled->getName() + "_parallel",
+          [&](IRBuilder<> &B, Value *idx, ArrayRef<Value *> vals) {
+            SmallVector<Value *, 3> args = {idx};
+            args.append(vals.begin(), vals.end());
+            B.CreateCall(newcalled, args);
+          });
+
+      auto pack =
+          IRBuilder<>(gutils->inversionAllocs).CreateAlloca(PackTy, nullptr);
+      BuilderZ.CreateStore(
+          BuilderZ.CreatePointerCast(
+              gutils->getNewFromOriginal(closure), ClosureTy),
+          BuilderZ.CreateStructGEP(PackTy, pack, 0));
+      if (dup)
+        BuilderZ.CreateStore(
+            castShadow(BuilderZ, gutils->invertPointerM(closure, BuilderZ)),
+            BuilderZ.CreateStructGEP(PackTy, pack, 1));
+      runtimeCall(BuilderZ,
+                  gutils->getNewFromOriginal(call.getArgOperand(0)),
+                  gutils->getNewFromOriginal(call.getArgOperand(1)), W, pack);
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    if (Mode == DerivativeMode::ForwardModeSplit) {
+      EmitFailure("NoDerivative", call.getDebugLoc(), &call,
+                  "unsupported split forward mode parallel_for call: ", call);
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    assert(Mode == DerivativeMode::ReverseModePrimal ||
+           Mode == DerivativeMode::ReverseModeCombined ||
+           Mode == DerivativeMode::ReverseModeGradient);
+
+    auto i64 = Type::getInt64Ty(Ctx);
+    const AugmentedReturn *subdata = nullptr;
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      assert(augmentedReturn);
+      auto fd = augmentedReturn->subaugmentations.find(&call);
+      if (fd != augmentedReturn->subaugmentations.end())
+        subdata = fd->second;
+    } else {
+      subdata = &gutils->Logic.CreateAugmentedPrimal(
+          body, DIFFE_TYPE::CONSTANT, argsInverted,
+          TR.analyzer.interprocedural, /*returnUsed*/ false,
+          /*shadowReturnUsed*/ false, nextTypeInfo, uncacheable_args,
+          /*forceAnonymousTape*/ false, gutils->getWidth(),
+          /*AtomicAdd*/ true);
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        assert(augmentedReturn);
+        auto subaugmentations =
+            (std::map<const llvm::CallInst *, AugmentedReturn *> *)&augmentedReturn
+                ->subaugmentations;
+        insert_or_assign2<const llvm::CallInst *, AugmentedReturn *>(
+            *subaugmentations, &call, (AugmentedReturn *)subdata);
+      }
+    }
+    assert(subdata);
+
+    Optional<int> tapeIdx;
+    {
+      auto found = subdata->returns.find(AugmentedStruct::Tape);
+      if (found != subdata->returns.end())
+        tapeIdx = found->second;
+    }
+    Type *tapeTy = nullptr;
+    if (tapeIdx.hasValue()) {
+      auto RT = subdata->fn->getReturnType();
+      tapeTy = (tapeIdx.getValue() == -1)
+                   ? RT
+                   : cast<StructType>(RT)->getElementType(tapeIdx.getValue());
+    }
+
+    // The packed state of a derivative body is the closure, its shadow, the
+    // per-iteration tape slots and the first iteration index.
+    SmallVector<Type *, 4> fields = {ClosureTy};
+    if (dup)
+      fields.push_back(ShadowTy);
+    if (tapeTy) {
+      fields.push_back(PointerType::getUnqual(tapeTy));
+      fields.push_back(IdxTy);
+    }
+    auto PackTy = StructType::get(Ctx, fields);
+    auto tapeSlot = [&](IRBuilder<> &B, Value *idx, ArrayRef<Value *> vals) {
+      return B.CreateGEP(tapeTy, vals[vals.size() - 2],
+                         B.CreateSub(idx, vals[vals.size() - 1]));
+    };
+
+    Value *tapes = nullptr;
+    if (Mode == DerivativeMode::ReverseModePrimal ||
+        Mode == DerivativeMode::ReverseModeCombined) {
+      auto augcalled = subdata->fn;
+      auto W = createParallelForBody(
+          body, PackTy, augcalled->getName() + "_parallel",
+          [&](IRBuilder<> &B, Value *idx, ArrayRef<Value *> vals) {
+            SmallVector<Value *, 3> args = {idx, vals[0]};
+            if (dup)
+              args.push_back(vals[1]);
+            auto res = B.CreateCall(augcalled, args);
+            if (tapeTy) {
+              Value *tape =
+                  tapeIdx.getValue() == -1
+                      ? (Value *)res
+                      : B.CreateExtractValue(res,
+                                             {(unsigned)tapeIdx.getValue()});
+              B.CreateStore(tape, tapeSlot(B, idx, vals));
+            }
+          });
+
+      Value *begin = gutils->getNewFromOriginal(call.getArgOperand(0));
+      Value *end = gutils->getNewFromOriginal(call.getArgOperand(1));
+      auto pack =
+          IRBuilder<>(gutils->inversionAllocs).CreateAlloca(PackTy, nullptr);
+      BuilderZ.CreateStore(
+          BuilderZ.CreatePointerCast(gutils->getNewFromOriginal(closure),
+                                     ClosureTy),
+          BuilderZ.CreateStructGEP(PackTy, pack, 0));
+      if (dup)
+        BuilderZ.CreateStore(
+            castShadow(BuilderZ, gutils->invertPointerM(closure, BuilderZ)),
+            BuilderZ.CreateStructGEP(PackTy, pack, 1));
+      if (tapeTy) {
+        Value *count = BuilderZ.CreateSub(end, begin);
+        count = BuilderZ.CreateSelect(
+            BuilderZ.CreateICmpSLT(count, ConstantInt::get(IdxTy, 0)),
+            ConstantInt::get(IdxTy, 0), count);
+        tapes =
+            CreateAllocation(BuilderZ, tapeTy,
+                             BuilderZ.CreateZExtOrTrunc(count, i64), "tapes");
+        BuilderZ.CreateStore(tapes,
+                             BuilderZ.CreateStructGEP(PackTy, pack, dup + 1));
+        BuilderZ.CreateStore(begin,
+                             BuilderZ.CreateStructGEP(PackTy, pack, dup + 2));
+      }
+      runtimeCall(BuilderZ, begin, end, W, pack);
+      if (tapes)
+        tapes = gutils->cacheForReverse(BuilderZ, tapes,
+                                        getIndex(&call, CacheType::Tape));
+    }
+
+    if (Mode == DerivativeMode::ReverseModePrimal) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    if (Mode == DerivativeMode::ReverseModeGradient && tapeTy) {
+      tapes = BuilderZ.CreatePHI(PointerType::getUnqual(tapeTy), 0, "tapeArg");
+      tapes = gutils->cacheForReverse(BuilderZ, tapes,
+                                      getIndex(&call, CacheType::Tape));
+    }
+    eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+
+    IRBuilder<> Builder2(call.getParent());
+    getReverseBuilder(Builder2);
+
+    auto newcalled = gutils->Logic.CreatePrimalAndGradient(
+        (ReverseCacheKey){.todiff = body,
+                          .retType = DIFFE_TYPE::CONSTANT,
+                          .constant_args = argsInverted,
+                          .uncacheable_args = uncacheable_args,
+                          .returnUsed = false,
+                          .shadowReturnUsed = false,
+                          .mode = DerivativeMode::ReverseModeGradient,
+                          .width = gutils->getWidth(),
+                          .freeMemory = true,
+                          .AtomicAdd = true,
+                          .additionalType = tapeTy,
+                          .typeInfo = nextTypeInfo},
+        TR.analyzer.interprocedural, subdata);
+
+    auto W = createParallelForBody(
+        body, PackTy, newcalled->getName() + "_parallel",
+        [&](IRBuilder<> &B, Value *idx, ArrayRef<Value *> vals) {
+          SmallVector<Value *, 4> args = {idx, vals[0]};
+          if (dup)
+            args.push_back(vals[1]);
+          if (tapeTy)
+#if LLVM_VERSION_MAJOR > 7
+            args.push_back(B.CreateLoad(tapeTy, tapeSlot(B, idx, vals)));
+#else
+            args.push_back(B.CreateLoad(tapeSlot(B, idx, vals)));
+#endif
+          B.CreateCall(newcalled, args);
+        });
+
+    Value *begin =
+        lookup(gutils->getNewFromOriginal(call.getArgOperand(0)), Builder2);
+    Value *end =
+        lookup(gutils->getNewFromOriginal(call.getArgOperand(1)), Builder2);
+    auto pack =
+        IRBuilder<>(gutils->inversionAllocs).CreateAlloca(PackTy, nullptr);
+    Builder2.CreateStore(
+        Builder2.CreatePointerCast(
+            lookup(gutils->getNewFromOriginal(closure), Builder2), ClosureTy),
+        Builder2.CreateStructGEP(PackTy, pack, 0));
+    if (dup)
+      Builder2.CreateStore(
+          castShadow(Builder2,
+                     lookup(gutils->invertPointerM(closure, Builder2),
+                            Builder2)),
+          Builder2.CreateStructGEP(PackTy, pack, 1));
+    if (tapeTy) {
+      tapes = lookup(tapes, Builder2);
+      Builder2.CreateStore(tapes,
+                           Builder2.CreateStructGEP(PackTy, pack, dup + 1));
+      Builder2.CreateStore(begin,
+                           Builder2.CreateStructGEP(PackTy, pack, dup + 2));
+    }
+    runtimeCall(Builder2, begin, end, W, pack);
+    if (tapeTy)
+      CreateDealloc(Builder2, tapes);
+  }
+
+  /// Forward-mode derivative of an OpenMP parallel region. The outlined task
+  /// is differentiated in forward mode and the tangents are passed alongside
+  /// the primal arguments to a new __kmpc_fork_call, so that each thread
+  /// computes the tangent of its share of the work. Since fork_call arguments
+  /// are pointer-sized, vector shadows are passed one lane at a time and
+  /// reassembled in a wrapper around the derivative task. In split forward
+  /// mode the task derivative reads the values it needs from the tape that
+  /// the augmented task left behind, which is passed by reference as the
+  /// last argument like in the reverse pass.
+  void visitOMPForwardCall(llvm::CallInst &call, llvm::Function *task,
+                           const FnTypeInfo &nextTypeInfo,
+                           const std::map<Argument *, bool> &uncacheable_args) {
+    Function *kmpc = call.getCalledFunction();
+    IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&call));
+    BuilderZ.setFastMathFlags(getFast());
+    unsigned width = gutils->getWidth();
+
+    SmallVector<Value *, 8> pre_args = {0, 0, 0};
+    std::vector<DIFFE_TYPE> argsInverted = {DIFFE_TYPE::CONSTANT,
+                                            DIFFE_TYPE::CONSTANT};
+#if LLVM_VERSION_MAJOR >= 14
+    for (unsigned i = 3; i < call.arg_size(); ++i)
+#else
+    for (unsigned i = 3; i < call.getNumArgOperands(); ++i)
+#endif
+    {
+      pre_args.push_back(gutils->getNewFromOriginal(call.getArgOperand(i)));
+      auto argTy = gutils->getDiffeType(call.getArgOperand(i), false);
+      argsInverted.push_back(argTy);
+      if (argTy == DIFFE_TYPE::CONSTANT)
+        continue;
+      Value *shadow = gutils->invertPointerM(call.getArgOperand(i), BuilderZ);
+      if (width == 1)
+        pre_args.push_back(shadow);
+      else
+        for (unsigned j = 0; j < width; ++j)
+          pre_args.push_back(BuilderZ.CreateExtractValue(shadow, {j}));
+    }
+
+    const AugmentedReturn *subdata = nullptr;
+    Value *tape = nullptr;
+    if (Mode == DerivativeMode::ForwardModeSplit) {
+      assert(augmentedReturn);
+      auto fd = augmentedReturn->subaugmentations.find(&call);
+      if (fd != augmentedReturn->subaugmentations.end())
+        subdata = fd->second;
+      assert(subdata);
+      if (subdata->returns.find(AugmentedStruct::Tape) !=
+          subdata->returns.end()) {
+        tape = BuilderZ.CreatePHI(subdata->tapeType, 0, "tapeArg");
+        gutils->TapesToPreventRecomputation.insert(cast<Instruction>(tape));
+        tape = gutils->cacheForReverse(BuilderZ, tape,
+                                       getIndex(&call, CacheType::Tape));
+        auto alloc = IRBuilder<>(gutils->inversionAllocs)
+                         .CreateAlloca(tape->getType());
+        BuilderZ.CreateStore(tape, alloc);
+        pre_args.push_back(alloc);
+      }
+    }
+
+    Function *newcalled = gutils->Logic.CreateForwardDiff(
+        task, DIFFE_TYPE::CONSTANT, argsInverted, TR.analyzer.interprocedural,
+        /*returnValue*/ false, Mode, /*freeMemory*/ true, width,
+        /*additionalArg*/ tape ? PointerType::getUnqual(tape->getType())
+                               : nullptr,
+        nextTypeInfo, uncacheable_args, /*augmented*/ subdata,
+        /*omp*/ true);
+
+    if (width > 1) {
+      SmallVector<Type *, 8> types;
+      for (size_t i = 3; i < pre_args.size(); ++i)
+        types.push_back(pre_args[i]->getType());
+      types.insert(types.begin(), newcalled->getFunctionType()->param_begin(),
+                   newcalled->getFunctionType()->param_begin() + 2);
+      auto W = Function::Create(
+          FunctionType::get(Type::getVoidTy(call.getContext()), types, false),
+          GlobalValue::InternalLinkage, newcalled->getName() + "_omp",
+          newcalled->getParent());
+      W->addFnAttr(Attribute::AlwaysInline);
+      IRBuilder<> B(BasicBlock::Create(W->getContext(), "entry", W));
+      SmallVector<Value *, 8> args;
+      auto arg = W->arg_begin();
+      auto param = newcalled->getFunctionType()->param_begin();
+      for (auto argTy : argsInverted) {
+        args.push_back(arg++);
+        param++;
+        if (argTy == DIFFE_TYPE::CONSTANT)
+          continue;
+        Value *shadow = UndefValue::get(*param++);
+        for (unsigned j = 0; j < width; ++j)
+          shadow = B.CreateInsertValue(shadow, arg++, {j});
+        args.push_back(shadow);
+      }
+      if (tape)
+        args.push_back(arg++);
+      B.CreateCall(newcalled, args);
+      B.CreateRetVoid();
+      newcalled = W;
+    }
+
+    pre_args[0] = gutils->getNewFromOriginal(call.getArgOperand(0));
+    pre_args[1] =
+        ConstantInt::get(Type::getInt32Ty(call.getContext()), pre_args.size() - 3);
+    pre_args[2] = BuilderZ.CreatePointerCast(
+        newcalled, kmpc->getFunctionType()->getParamType(2));
+    auto fwdcall = BuilderZ.CreateCall(kmpc->getFunctionType(), kmpc, pre_args);
+    fwdcall->setCallingConv(call.getCallingConv());
+    fwdcall->setDebugLoc(gutils->getNewFromOriginal(call.getDebugLoc()));
+    if (tape && shouldFree())
+      for (auto idx : subdata->tapeIndiciesToFree)
+        CreateDealloc(BuilderZ, idx == -1
+                                    ? tape
+                                    : BuilderZ.CreateExtractValue(tape, idx));
+    eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+  }
+
+  /// Forward-mode derivative of __kmpc_reduce and __kmpc_reduce_nowait. The
+  /// runtime may combine the private copies of two threads by calling the
+  /// reduction function on their reduction lists, so the list is extended
+  /// with the shadow of each reduced variable and the reduction function is
+  /// replaced by a wrapper around its forward derivative that combines both.
+  /// The final combination into the shared variables is ordinary code
+  /// guarded by the result of the call and is differentiated as usual.
+  void visitOMPReduceForwardCall(llvm::CallInst &call) {
+    Value *red_list = call.getArgOperand(4);
+    if (gutils->isConstantValue(red_list))
+      return;
+
+    Value *redv = call.getArgOperand(5);
+    while (auto CE = dyn_cast<ConstantExpr>(redv)) {
+      if (!CE->isCast())
+        break;
+      redv = CE->getOperand(0);
+    }
+    auto red = dyn_cast<Function>(redv);
+    auto num = dyn_cast<ConstantInt>(call.getArgOperand(2));
+    if (!red || red->empty() || red->arg_size() != 2 || !num) {
+      llvm::errs() << "could not derive reduction of omp call: " << call
+                   << "\n";
+      llvm_unreachable("could not derive reduction of omp call");
+    }
+
+    IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&call));
+    BuilderZ.setFastMathFlags(getFast());
+    auto &Ctx = call.getContext();
+    unsigned width = gutils->getWidth();
+    unsigned n = num->getZExtValue();
+    auto i8p = Type::getInt8PtrTy(Ctx);
+    auto i8pp = PointerType::getUnqual(i8p);
+    auto &DL = gutils->newFunc->getParent()->getDataLayout();
+    auto ListTy = ArrayType::get(i8p, n * (1 + width));
+
+    // Layout the extended list as the primal list followed by one copy of it
+    // for each shadow.
+    auto ext = IRBuilder<>(gutils->inversionAllocs).CreateAlloca(ListTy);
+    auto copyList = [&](unsigned slot, Value *list) {
+      list = BuilderZ.CreatePointerCast(list, i8pp);
+      for (unsigned k = 0; k < n; ++k) {
+        Value *src = BuilderZ.CreateConstInBoundsGEP1_64(i8p, list, k);
+#if LLVM_VERSION_MAJOR > 7
+        Value *elem = BuilderZ.CreateLoad(i8p, src);
+#else
+        Value *elem = BuilderZ.CreateLoad(src);
+#endif
+        BuilderZ.CreateStore(
+            elem, BuilderZ.CreateConstInBoundsGEP2_32(ListTy, ext, 0,
+                                                      slot * n + k));
+      }
+    };
+    copyList(0, gutils->getNewFromOriginal(red_list));
+    Value *shadow = gutils->invertPointerM(red_list, BuilderZ);
+    for (unsigned j = 0; j < width; ++j)
+      copyList(1 + j, width == 1 ? shadow
+                                 : BuilderZ.CreateExtractValue(shadow, {j}));
+
+    FnTypeInfo nextTypeInfo(red);
+    for (auto &arg : red->args()) {
+      nextTypeInfo.Arguments.insert(
+          std::pair<Argument *, TypeTree>(&arg, TR.query(red_list)));
+      nextTypeInfo.KnownValues.insert(
+          std::pair<Argument *, std::set<int64_t>>(&arg, {}));
+    }
+    Function *fwd = gutils->Logic.CreateForwardDiff(
+        red, DIFFE_TYPE::CONSTANT, {DIFFE_TYPE::DUP_ARG, DIFFE_TYPE::DUP_ARG},
+        TR.analyzer.interprocedural, /*returnValue*/ false, Mode,
+        /*freeMemory*/ true, width, /*additionalArg*/ nullptr, nextTypeInfo,
+        {}, /*augmented*/ nullptr);
+
+    auto W = Function::Create(red->getFunctionType(),
+                              GlobalValue::InternalLinkage,
+                              fwd->getName() + "_omp", red->getParent());
+    W->addFnAttr(Attribute::AlwaysInline);
+    {
+      IRBuilder<> B(BasicBlock::Create(Ctx, "entry", W));
+      SmallVector<Value *, 4> args;
+      auto param = fwd->getFunctionType()->param_begin();
+      for (auto &arg : W->args()) {
+        args.push_back(&arg);
+        param++;
+        Value *list = B.CreatePointerCast(&arg, i8pp);
+        Value *dshadow = UndefValue::get(*param++);
+        for (unsigned j = 0; j < width; ++j) {
+          Value *sub = B.CreatePointerCast(
+              B.CreateConstInBoundsGEP1_64(i8p, list, (1 + j) * n),
+              arg.getType());
+          dshadow = width == 1 ? sub : B.CreateInsertValue(dshadow, sub, {j});
+        }
+        args.push_back(dshadow);
+      }
+      B.CreateCall(fwd, args);
+      B.CreateRetVoid();
+    }
+
+    auto newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    auto FT = call.getFunctionType();
+    newCall->setArgOperand(2, ConstantInt::get(num->getType(), n * (1 + width)));
+    newCall->setArgOperand(
+        3, ConstantInt::get(FT->getParamType(3),
+                            n * (1 + width) * DL.getTypeAllocSize(i8p)));
+    newCall->setArgOperand(4, BuilderZ.CreatePointerCast(ext, FT->getParamType(4)));
+    newCall->setArgOperand(5, ConstantExpr::getPointerCast(W, FT->getParamType(5)));
+  }
+
   void visitOMPCall(llvm::CallInst &call) {
     Function *kmpc = call.getCalledFunction();
 
-    if (uncacheable_args_map.find(&call) == uncacheable_args_map.end()) {
+    if (uncacheable_args_map.find(&call) == uncacheable_args_map.end() &&
+        Mode != DerivativeMode::ForwardMode) {
       llvm::errs() << " call: " << call << "\n";
       for (auto &pair : uncacheable_args_map) {
         llvm::errs() << " + " << *pair.first << "\n";
       }
     }
 
-    assert(uncacheable_args_map.find(&call) != uncacheable_args_map.end());
+    assert(uncacheable_args_map.find(&call) != uncacheable_args_map.end() ||
+           Mode == DerivativeMode::ForwardMode);
     const std::map<Argument *, bool> &uncacheable_args =
-        uncacheable_args_map.find(&call)->second;
+        Mode == DerivativeMode::ForwardMode
+            ? std::map<Argument *, bool>()
+            : uncacheable_args_map.find(&call)->second;
 
     IRBuilder<> BuilderZ(gutils->getNewFromOriginal(&call));
     BuilderZ.setFastMathFlags(getFast());
@@ -4983,6 +6163,43 @@ public:
 
     bool foreignFunction = called == nullptr;
 
+    // TODO consider reduction of int 0 args
+    FnTypeInfo nextTypeInfo(called);
+
+    if (called) {
+      std::map<Value *, std::set<int64_t>> intseen;
+
+      TypeTree IntPtr;
+      IntPtr.insert({-1, -1}, BaseType::Integer);
+      IntPtr.insert({-1}, BaseType::Pointer);
+
+      int argnum = 0;
+      for (auto &arg : called->args()) {
+        if (argnum <= 1) {
+          nextTypeInfo.Arguments.insert(
+              std::pair<Argument *, TypeTree>(&arg, IntPtr));
+          nextTypeInfo.KnownValues.insert(
+              std::pair<Argument *, std::set<int64_t>>(&arg, {0}));
+        } else {
+          nextTypeInfo.Arguments.insert(std::pair<Argument *, TypeTree>(
+              &arg, TR.query(call.getArgOperand(argnum - 2 + 3))));
+          nextTypeInfo.KnownValues.insert(
+              std::pair<Argument *, std::set<int64_t>>(
+                  &arg,
+                  TR.knownIntegralValues(call.getArgOperand(argnum - 2 + 3))));
+        }
+
+        ++argnum;
+      }
+      nextTypeInfo.Return = TR.query(&call);
+    }
+
+    if (Mode == DerivativeMode::ForwardMode ||
+        Mode == DerivativeMode::ForwardModeSplit) {
+      visitOMPForwardCall(call, called, nextTypeInfo, uncacheable_args);
+      return;
+    }
+
     SmallVector<Value *, 8> args = {0, 0, 0};
     SmallVector<Value *, 8> pre_args = {0, 0, 0};
     std::vector<DIFFE_TYPE> argsInverted = {DIFFE_TYPE::CONSTANT,
@@ -5049,36 +6266,6 @@ public:
     CallInst *augmentcall = nullptr;
     // Value *cachereplace = nullptr;
 
-    // TODO consider reduction of int 0 args
-    FnTypeInfo nextTypeInfo(called);
-
-    if (called) {
-      std::map<Value *, std::set<int64_t>> intseen;
-
-      TypeTree IntPtr;
-      IntPtr.insert({-1, -1}, BaseType::Integer);
-      IntPtr.insert({-1}, BaseType::Pointer);
-
-      int argnum = 0;
-      for (auto &arg : called->args()) {
-        if (argnum <= 1) {
-          nextTypeInfo.Arguments.insert(
-              std::pair<Argument *, TypeTree>(&arg, IntPtr));
-          nextTypeInfo.KnownValues.insert(
-              std::pair<Argument *, std::set<int64_t>>(&arg, {0}));
-        } else {
-          nextTypeInfo.Arguments.insert(std::pair<Argument *, TypeTree>(
-              &arg, TR.query(call.getArgOperand(argnum - 2 + 3))));
-          nextTypeInfo.KnownValues.insert(
-              std::pair<Argument *, std::set<int64_t>>(
-                  &arg,
-                  TR.knownIntegralValues(call.getArgOperand(argnum - 2 + 3))));
-        }
-
-        ++argnum;
-      }
-      nextTypeInfo.Return = TR.query(&call);
-    }
 
     // llvm::Optional<std::map<std::pair<Instruction*, std::string>, unsigned>>
     // sub_index_map;
@@ -5401,6 +6588,8 @@ public:
         auto ST = StructType::get(newcalled->getContext(), OutFPTypes);
         if (OutTypes.size()) {
           OutAlloc = IRBuilder<>(gutils->inversionAllocs).CreateAlloca(ST);
+          // Every thread atomically adds its partial adjoints into OutAlloc.
+          Builder2.CreateStore(Constant::getNullValue(ST), OutAlloc);
           args.push_back(OutAlloc);
 
           SmallVector<Type *, 3> MetaTypes;
@@ -5596,100 +6785,2260 @@ public:
       EmitFailure("CannotDeduceType", call.getDebugLoc(), &call,
                   "failed to deduce type of copy ", call);
 
-      TR.firstPointer(size, origArg, &call, /*errifnotfound*/ true,
-                      /*pointerIntSame*/ true);
-      llvm_unreachable("bad mti");
+      TR.firstPointer(size, origArg, &call, /*errifnotfound*/ true,
+                      /*pointerIntSame*/ true);
+      llvm_unreachable("bad mti");
+    }
+  knownF:;
+    unsigned start = 0;
+    while (1) {
+      unsigned nextStart = size;
+
+      auto dt = vd[{-1}];
+      for (size_t i = start; i < size; ++i) {
+        bool Legal = true;
+        dt.checkedOrIn(vd[{(int)i}], /*PointerIntSame*/ true, Legal);
+        if (!Legal) {
+          nextStart = i;
+          break;
+        }
+      }
+      if (!dt.isKnown()) {
+        TR.dump();
+        llvm::errs() << " vd:" << vd.str() << " start:" << start
+                     << " size: " << size << " dt:" << dt.str() << "\n";
+      }
+      assert(dt.isKnown());
+
+      Value *length = len_arg;
+      if (nextStart != size) {
+        length = ConstantInt::get(len_arg->getType(), nextStart);
+      }
+      if (start != 0)
+        length = Builder2.CreateSub(
+            length, ConstantInt::get(len_arg->getType(), start));
+
+      if (auto secretty = dt.isFloat()) {
+        auto offset = start;
+        if (dsto->getType()->isIntegerTy())
+          dsto = Builder2.CreateIntToPtr(
+              dsto, Type::getInt8PtrTy(dsto->getContext()));
+        unsigned dstaddr =
+            cast<PointerType>(dsto->getType())->getAddressSpace();
+        auto secretpt = PointerType::get(secretty, dstaddr);
+        if (offset != 0) {
+#if LLVM_VERSION_MAJOR > 7
+          dsto = Builder2.CreateConstInBoundsGEP1_64(
+              dsto->getType()->getPointerElementType(), dsto, offset);
+#else
+          dsto = Builder2.CreateConstInBoundsGEP1_64(dsto, offset);
+#endif
+        }
+        if (srco->getType()->isIntegerTy())
+          srco = Builder2.CreateIntToPtr(
+              srco, Type::getInt8PtrTy(dsto->getContext()));
+        unsigned srcaddr =
+            cast<PointerType>(srco->getType())->getAddressSpace();
+        secretpt = PointerType::get(secretty, srcaddr);
+
+        if (offset != 0) {
+#if LLVM_VERSION_MAJOR > 7
+          srco = Builder2.CreateConstInBoundsGEP1_64(
+              srco->getType()->getPointerElementType(), srco, offset);
+#else
+          srco = Builder2.CreateConstInBoundsGEP1_64(srco, offset);
+#endif
+        }
+        Value *args[3] = {
+            Builder2.CreatePointerCast(dsto, secretpt),
+            Builder2.CreatePointerCast(srco, secretpt),
+            Builder2.CreateUDiv(
+                length,
+
+                ConstantInt::get(length->getType(),
+                                 Builder2.GetInsertBlock()
+                                         ->getParent()
+                                         ->getParent()
+                                         ->getDataLayout()
+                                         .getTypeAllocSizeInBits(secretty) /
+                                     8))};
+
+        auto dmemcpy = getOrInsertDifferentialFloatMemcpy(
+            *Builder2.GetInsertBlock()->getParent()->getParent(), secretty,
+            /*dstalign*/ 1, /*srcalign*/ 1, dstaddr, srcaddr);
+
+        Builder2.CreateCall(dmemcpy, args, ReverseDefs);
+      }
+
+      if (nextStart == size)
+        break;
+      start = nextStart;
+    }
+  }
+
+  /// Calling convention of a call to a BLAS routine. The cblas_ routines take
+  /// scalars by value, flags as enumerators and (from level 2) a leading
+  /// layout. The Fortran-style ones take every operand by reference, flags as
+  /// characters, and possibly one trailing length per character operand.
+  struct BLASCall {
+    CallInst *call;
+    std::string prefix;
+    std::string suffix;
+    char fp;
+    Type *fpType;
+    IntegerType *intType;
+    bool cblas;
+    // Number of leading operands (the cblas layout) before the Fortran ones.
+    unsigned off;
+    // Whether trailing character lengths are passed.
+    bool lengths;
+  };
+
+  /// The flag operands of BLAS routines, each choosing between two options.
+  enum class BLASFlag { Trans, Uplo, Side, Diag };
+
+  /// Whether the loaded flag value selects the first option of kind
+  /// (no transpose, upper, left or non-unit respectively).
+  Value *isBLASFlagFirst(const BLASCall &blas, BLASFlag kind, Value *flag,
+                         IRBuilder<> &B) {
+    if (blas.cblas) {
+      unsigned first[] = {111, 121, 141, 131};
+      return B.CreateICmpEQ(
+          flag, ConstantInt::get(flag->getType(), first[(unsigned)kind]));
+    }
+    char first[] = {'N', 'U', 'L', 'N'};
+    char c = first[(unsigned)kind];
+    return B.CreateOr(
+        B.CreateICmpEQ(flag, ConstantInt::get(flag->getType(), c)),
+        B.CreateICmpEQ(flag, ConstantInt::get(flag->getType(), c - 'A' + 'a')));
+  }
+
+  /// Flag value of kind choosing its first option if isFirst holds.
+  Value *getBLASFlag(const BLASCall &blas, BLASFlag kind, Value *isFirst,
+                     IRBuilder<> &B) {
+    if (blas.cblas) {
+      unsigned first[] = {111, 121, 141, 131};
+      Type *T = blas.call->getArgOperand(0)->getType();
+      return B.CreateSelect(
+          isFirst, ConstantInt::get(T, first[(unsigned)kind]),
+          ConstantInt::get(T, first[(unsigned)kind] + 1));
+    }
+    char first[] = {'N', 'U', 'L', 'N'};
+    char second[] = {'T', 'L', 'R', 'U'};
+    Type *T = Type::getInt8Ty(isFirst->getContext());
+    return B.CreateSelect(isFirst, ConstantInt::get(T, first[(unsigned)kind]),
+                          ConstantInt::get(T, second[(unsigned)kind]));
+  }
+
+  /// Call the routine (e.g. "gemm") of the precision and convention of blas.
+  /// Scalar operands are given by value and passed by reference as needed,
+  /// nflags being the number of character flags among them.
+  CallInst *callBLAS(const BLASCall &blas, StringRef routine,
+                     ArrayRef<Value *> args, unsigned nflags,
+                     IRBuilder<> &B, Type *RetTy = nullptr) {
+    SmallVector<Value *, 16> vals;
+    SmallVector<Type *, 16> types;
+    for (auto arg : args) {
+      if (!blas.cblas && !arg->getType()->isPointerTy()) {
+        auto alloc = IRBuilder<>(gutils->inversionAllocs)
+                         .CreateAlloca(arg->getType());
+        B.CreateStore(arg, alloc);
+        arg = alloc;
+      }
+      vals.push_back(arg);
+    }
+    if (blas.lengths) {
+      Type *LT = blas.call->getArgOperand(blas.call->arg_size() - 1)->getType();
+      for (unsigned i = 0; i < nflags; i++)
+        vals.push_back(ConstantInt::get(LT, 1));
+    }
+    for (auto val : vals)
+      types.push_back(val->getType());
+    if (!RetTy)
+      RetTy = B.getVoidTy();
+    std::string name =
+        (blas.prefix + Twine(blas.fp) + routine + blas.suffix).str();
+    auto FT = FunctionType::get(RetTy, types, false);
+    return B.CreateCall(
+        gutils->newFunc->getParent()->getOrInsertFunction(name, FT), vals);
+  }
+
+  /// Derivatives of the BLAS routines axpy, scal, gemv, gemm, syrk and trsm,
+  /// expressed as further BLAS calls in the convention of the original. Only
+  /// the input vectors and matrices the derivative needs are cached, and only
+  /// if they may be overwritten before the reverse pass.
+  bool handleBLASKernel(CallInst &call, StringRef funcName, StringRef prefix,
+                        StringRef suffix,
+                        const std::map<Argument *, bool> &uncacheable_args) {
+    Function *called = call.getCalledFunction();
+    if (!called || prefix == "cublas_")
+      return false;
+    if (Mode == DerivativeMode::ForwardModeSplit)
+      return false;
+
+    StringRef routine = funcName.drop_front(1);
+    bool level1 = routine == "axpy" || routine == "scal";
+
+    // Operand positions follow the Fortran routines, after off.
+    BLASCall blas;
+    blas.call = &call;
+    blas.prefix = prefix.str();
+    blas.suffix = suffix.str();
+    blas.fp = funcName[0];
+    blas.fpType = funcName[0] == 'd' ? Type::getDoubleTy(call.getContext())
+                                     : Type::getFloatTy(call.getContext());
+    blas.cblas = prefix == "cblas_";
+    blas.off = (blas.cblas && !level1) ? 1 : 0;
+
+    unsigned numArgs = StringSwitch<unsigned>(routine)
+                           .Case("axpy", 6)
+                           .Case("scal", 4)
+                           .Case("gemv", 11)
+                           .Case("gemm", 13)
+                           .Case("syrk", 10)
+                           .Case("trsm", 11);
+    unsigned numFlags = StringSwitch<unsigned>(routine)
+                            .Case("gemv", 1)
+                            .Case("gemm", 2)
+                            .Case("syrk", 2)
+                            .Case("trsm", 4)
+                            .Default(0);
+    if (call.arg_size() != blas.off + numArgs &&
+        (blas.cblas || numFlags == 0 ||
+         call.arg_size() != blas.off + numArgs + numFlags))
+      return false;
+    blas.lengths = call.arg_size() != blas.off + numArgs;
+
+    // The operands by role: the flag, integer, floating point scalar and
+    // array operands.
+    SmallVector<unsigned, 6> flags;
+    SmallVector<unsigned, 6> ints;
+    SmallVector<unsigned, 6> fps;
+    SmallVector<unsigned, 6> arrays;
+    if (routine == "axpy") {
+      ints = {0, 3, 5};
+      fps = {1};
+      arrays = {2, 4};
+    } else if (routine == "scal") {
+      ints = {0, 3};
+      fps = {1};
+      arrays = {2};
+    } else if (routine == "gemv") {
+      flags = {0};
+      ints = {1, 2, 5, 7, 10};
+      fps = {3, 8};
+      arrays = {4, 6, 9};
+    } else if (routine == "gemm") {
+      flags = {0, 1};
+      ints = {2, 3, 4, 7, 9, 12};
+      fps = {5, 10};
+      arrays = {6, 8, 11};
+    } else if (routine == "syrk") {
+      flags = {0, 1};
+      ints = {2, 3, 6, 9};
+      fps = {4, 7};
+      arrays = {5, 8};
+    } else {
+      flags = {0, 1, 2, 3};
+      ints = {4, 5, 8, 10};
+      fps = {6};
+      arrays = {7, 9};
+    }
+
+    auto orig = [&](unsigned i) { return call.getArgOperand(blas.off + i); };
+    bool byRef = orig(ints[0])->getType()->isPointerTy();
+    if (byRef == blas.cblas)
+      return false;
+    if (byRef)
+      blas.intType = IntegerType::get(call.getContext(),
+                                      suffix.contains("64") ? 64 : 32);
+    else if (!(blas.intType = dyn_cast<IntegerType>(orig(ints[0])->getType())))
+      return false;
+
+    auto active = [&](unsigned i) { return !gutils->isConstantValue(orig(i)); };
+    // The operand written by the routine.
+    unsigned out = arrays.back();
+
+    // Only the level 1 scaling factors may be active.
+    if (!level1) {
+      for (auto i : fps)
+        if (active(i)) {
+          EmitFailure("NoDerivative", call.getDebugLoc(), &call,
+                      "unsupported active scaling factor in ", call);
+          return true;
+        }
+    }
+
+    CallInst *const newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    IRBuilder<> BuilderZ(newCall);
+    BuilderZ.setFastMathFlags(getFast());
+
+    if (gutils->isConstantInstruction(&call) || !active(out)) {
+      if (Mode == DerivativeMode::ReverseModeGradient) {
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      } else {
+        eraseIfUnused(call);
+      }
+      return true;
+    }
+
+    Type *fpPtrTy = PointerType::getUnqual(blas.fpType);
+    auto scalarType = [&](unsigned i) -> Type * {
+      if (llvm::is_contained(fps, i))
+        return blas.fpType;
+      if (llvm::is_contained(ints, i))
+        return blas.intType;
+      return blas.cblas ? orig(i)->getType()
+                        : Type::getInt8Ty(call.getContext());
+    };
+    // The value of the scalar operand, or the array operand as a pointer, of
+    // the new call v at B.
+    auto operandValue = [&](unsigned i, Value *v, IRBuilder<> &B) -> Value * {
+      if (v->getType()->isIntegerTy() &&
+          (byRef || llvm::is_contained(arrays, i)))
+        v = B.CreateIntToPtr(v, fpPtrTy);
+      if (llvm::is_contained(arrays, i))
+        return B.CreatePointerCast(v, fpPtrTy);
+      if (!byRef)
+        return v;
+      Type *T = scalarType(i);
+      v = B.CreatePointerCast(v, PointerType::getUnqual(T));
+#if LLVM_VERSION_MAJOR > 7
+      return B.CreateLoad(T, v);
+#else
+      return B.CreateLoad(v);
+#endif
+    };
+    auto isRowMajor = [&](auto getLayout, IRBuilder<> &B) -> Value * {
+      if (!blas.off)
+        return ConstantInt::getFalse(call.getContext());
+      Value *layout = getLayout();
+      return B.CreateICmpEQ(layout, ConstantInt::get(layout->getType(), 101));
+    };
+    // Extent of the contiguous runs, and their number, of the rows x cols
+    // matrix.
+    auto matrixShape = [&](Value *rowMajor, Value *rows, Value *cols,
+                           IRBuilder<> &B) {
+      return std::make_pair(B.CreateSelect(rowMajor, cols, rows),
+                            B.CreateSelect(rowMajor, rows, cols));
+    };
+    // Which elements of a matrix the triangle flag selects, as taken by
+    // getOrInsertScaleMat, excluding the diagonal if strict.
+    auto triangle = [&](Value *rowMajor, Value *upper, Value *strict,
+                        IRBuilder<> &B) {
+      Type *T = blas.intType;
+      Value *colUpper = B.CreateXor(upper, rowMajor);
+      Value *tri = B.CreateSelect(colUpper, ConstantInt::get(T, 1),
+                                  ConstantInt::get(T, 2));
+      return B.CreateSelect(strict, B.CreateAdd(tri, ConstantInt::get(T, 2)),
+                            tri);
+    };
+    auto fpConst = [&](double v) { return ConstantFP::get(blas.fpType, v); };
+
+    // Primal operands of the call in the forward pass, loaded before it.
+    std::map<unsigned, Value *> fwd;
+    IRBuilder<> BuilderPre(newCall);
+    auto fwdOperand = [&](unsigned i) {
+      auto found = fwd.find(i);
+      if (found != fwd.end())
+        return found->second;
+      return fwd[i] = operandValue(i, gutils->getNewFromOriginal(orig(i)),
+                                   BuilderPre);
+    };
+    auto fwdLayout = [&]() {
+      return gutils->getNewFromOriginal(call.getArgOperand(0));
+    };
+
+    // The shape (rows, cols) of the matrix array operand i from the scalar
+    // operands get.
+    auto arrayShape = [&](unsigned i, std::function<Value *(unsigned)> get,
+                          IRBuilder<> &B) -> std::pair<Value *, Value *> {
+      if (routine == "gemv") {
+        return {get(1), get(2)};
+      }
+      if (routine == "gemm") {
+        Value *m = get(2), *n = get(3), *k = get(4);
+        Value *isN = isBLASFlagFirst(blas, BLASFlag::Trans,
+                                     get(i == 6 ? 0 : 1), B);
+        if (i == 6)
+          return {B.CreateSelect(isN, m, k), B.CreateSelect(isN, k, m)};
+        return {B.CreateSelect(isN, k, n), B.CreateSelect(isN, n, k)};
+      }
+      if (routine == "syrk") {
+        Value *n = get(2), *k = get(3);
+        Value *isN = isBLASFlagFirst(blas, BLASFlag::Trans, get(1), B);
+        return {B.CreateSelect(isN, n, k), B.CreateSelect(isN, k, n)};
+      }
+      assert(routine == "trsm");
+      Value *m = get(4), *n = get(5);
+      if (i == 9)
+        return {m, n};
+      Value *dim = B.CreateSelect(
+          isBLASFlagFirst(blas, BLASFlag::Side, get(0), B), m, n);
+      return {dim, dim};
+    };
+    // The stride or leading dimension operand of array operand i.
+    auto arrayStride = [&](unsigned i) { return i + 1; };
+
+    // The array operands needed by the reverse pass, with whether they are
+    // to be cached after the call (rather than before it).
+    SmallVector<std::pair<unsigned, bool>, 2> needed;
+    if (routine == "axpy") {
+      if (active(1))
+        needed.push_back({2, true});
+    } else if (routine == "scal") {
+      if (active(1))
+        needed.push_back({2, false});
+    } else if (routine == "gemv") {
+      if (active(6))
+        needed.push_back({4, true});
+      if (active(4))
+        needed.push_back({6, true});
+    } else if (routine == "gemm") {
+      if (active(8))
+        needed.push_back({6, true});
+      if (active(6))
+        needed.push_back({8, true});
+    } else if (routine == "syrk") {
+      if (active(5))
+        needed.push_back({5, true});
+    } else {
+      needed.push_back({7, true});
+      if (active(7))
+        needed.push_back({9, true});
+    }
+
+    auto uncacheable = [&](unsigned i) {
+      auto found = uncacheable_args.find(called->arg_begin() + blas.off + i);
+      return found == uncacheable_args.end() || found->second;
+    };
+    // Which of the needed arrays and by reference scalars are cached.
+    SmallVector<unsigned, 4> cachedArrays;
+    for (auto pair : needed)
+      if (uncacheable(pair.first) || !pair.second)
+        cachedArrays.push_back(pair.first);
+    SmallVector<unsigned, 8> cachedScalars;
+    if (byRef && Mode != DerivativeMode::ForwardMode) {
+      for (auto list : {&flags, &ints, &fps})
+        for (auto i : *list)
+          if (uncacheable(i))
+            cachedScalars.push_back(i);
+    }
+
+    SmallVector<Type *, 8> cacheTypes;
+    for (auto i : cachedScalars)
+      cacheTypes.push_back(scalarType(i));
+    for (size_t j = 0; j < cachedArrays.size(); j++)
+      cacheTypes.push_back(fpPtrTy);
+    if (Mode == DerivativeMode::ForwardMode)
+      cacheTypes.clear();
+    Type *cachetype = nullptr;
+    switch (cacheTypes.size()) {
+    case 0:
+      break;
+    case 1:
+      cachetype = cacheTypes[0];
+      break;
+    default:
+      cachetype = StructType::get(call.getContext(), cacheTypes);
+      break;
+    }
+
+    Value *cacheval = nullptr;
+    if ((Mode == DerivativeMode::ReverseModeCombined ||
+         Mode == DerivativeMode::ReverseModePrimal) &&
+        cachetype) {
+      SmallVector<Value *, 8> cacheValues;
+      for (auto i : cachedScalars)
+        cacheValues.push_back(fwdOperand(i));
+      auto scalar = [&](unsigned i) { return fwdOperand(i); };
+      Value *rowMajor = isRowMajor(fwdLayout, BuilderZ);
+      IRBuilder<> BuilderPost(newCall->getNextNode());
+      for (auto i : cachedArrays) {
+        bool after =
+            llvm::find(needed, std::make_pair(i, true)) != needed.end();
+        IRBuilder<> &BuilderZ = after ? BuilderPost : BuilderPre;
+        Value *src = fwdOperand(i);
+        Value *stride = scalar(arrayStride(i));
+        Value *copy;
+        if (level1 || (routine == "gemv" && i == 6)) {
+          Value *len =
+              level1
+                  ? scalar(0)
+                  : BuilderZ.CreateSelect(
+                        isBLASFlagFirst(blas, BLASFlag::Trans, scalar(0),
+                                        BuilderZ),
+                        scalar(2), scalar(1));
+          copy = BuilderZ.CreatePointerCast(
+              CreateAllocation(BuilderZ, blas.fpType, len), fpPtrTy);
+          Value *args[] = {copy, src, len, stride};
+          BuilderZ.CreateCall(getOrInsertMemcpyStrided(
+                                  *gutils->newFunc->getParent(),
+                                  cast<PointerType>(fpPtrTy), blas.intType, 0,
+                                  0),
+                              args);
+        } else {
+          auto shape = arrayShape(i, scalar, BuilderZ);
+          auto runs = matrixShape(rowMajor, shape.first, shape.second,
+                                  BuilderZ);
+          copy = BuilderZ.CreatePointerCast(
+              CreateAllocation(BuilderZ, blas.fpType,
+                               BuilderZ.CreateMul(runs.first, runs.second)),
+              fpPtrTy);
+          Value *args[] = {copy, src, runs.first, runs.second, stride};
+          BuilderZ.CreateCall(
+              getOrInsertMemcpyMat(*gutils->newFunc->getParent(),
+                                   cast<PointerType>(fpPtrTy), blas.intType),
+              args);
+        }
+        cacheValues.push_back(copy);
+      }
+      if (cacheValues.size() == 1)
+        cacheval = cacheValues[0];
+      else {
+        cacheval = UndefValue::get(cachetype);
+        for (auto tup : llvm::enumerate(cacheValues))
+          cacheval =
+              BuilderPost.CreateInsertValue(cacheval, tup.value(), tup.index());
+      }
+      gutils->cacheForReverse(BuilderPost, cacheval,
+                              getIndex(&call, CacheType::Tape));
+    }
+
+    if (Mode == DerivativeMode::ReverseModePrimal) {
+      eraseIfUnused(call);
+      return true;
+    }
+
+    if (Mode == DerivativeMode::ForwardMode) {
+      // The tangents are propagated before the call for scal, whose operand
+      // it overwrites, and after it for trsm, which needs the solution.
+      IRBuilder<> Builder2(newCall);
+      if (routine == "trsm")
+        Builder2.SetInsertPoint(newCall->getNextNode());
+      Builder2.setFastMathFlags(getFast());
+      auto scalar = [&](unsigned i) { return fwdOperand(i); };
+      auto shadow = [&](unsigned i) -> Value * {
+        return active(i) ? gutils->invertPointerM(orig(i), Builder2) : nullptr;
+      };
+      Value *dalpha = nullptr;
+      if (level1 && active(1))
+        dalpha = byRef ? gutils->invertPointerM(orig(1), Builder2)
+                       : diffe(orig(1), Builder2);
+      Value *layout = blas.off ? fwdLayout() : nullptr;
+      Value *rowMajor = isRowMajor(fwdLayout, Builder2);
+      auto dptr = [&](unsigned i, Value *d) {
+        return d ? operandValue(i, d, Builder2) : nullptr;
+      };
+      auto dscalar = [&](Value *d) -> Value * {
+        if (!byRef)
+          return d;
+        d = Builder2.CreatePointerCast(d, fpPtrTy);
+#if LLVM_VERSION_MAJOR > 7
+        return Builder2.CreateLoad(blas.fpType, d);
+#else
+        return Builder2.CreateLoad(d);
+#endif
+      };
+      auto withLayout = [&](std::initializer_list<Value *> args) {
+        SmallVector<Value *, 16> res;
+        if (layout)
+          res.push_back(layout);
+        res.append(args.begin(), args.end());
+        return res;
+      };
+      auto scaleMat = [&](Value *rows, Value *cols, Value *alpha, Value *A,
+                          Value *ld, Value *tri) {
+        auto runs = matrixShape(rowMajor, rows, cols, Builder2);
+        Value *args[] = {runs.first, runs.second, alpha, A, ld, tri};
+        Builder2.CreateCall(getOrInsertScaleMat(*gutils->newFunc->getParent(),
+                                                blas.fpType, blas.intType),
+                            args);
+      };
+      auto axpyMat = [&](Value *rows, Value *cols, Value *alpha, Value *X,
+                         Value *ldx, Value *Y, Value *ldy) {
+        auto runs = matrixShape(rowMajor, rows, cols, Builder2);
+        Value *zero = ConstantInt::get(blas.intType, 0);
+        Value *args[] = {runs.first, runs.second, alpha, X, ldx, Y,
+                         ldy,        zero,        zero};
+        Builder2.CreateCall(getOrInsertAxpyMat(*gutils->newFunc->getParent(),
+                                               blas.fpType, blas.intType),
+                            args);
+      };
+
+      if (routine == "axpy") {
+        applyChainRule(
+            Builder2,
+            [&](Value *dx, Value *dy, Value *da) {
+              dx = dptr(2, dx);
+              dy = dptr(4, dy);
+              if (dx)
+                callBLAS(blas, "axpy",
+                         {scalar(0), scalar(1), dx, scalar(3), dy, scalar(5)},
+                         0, Builder2);
+              if (da)
+                callBLAS(blas, "axpy",
+                         {scalar(0), dscalar(da), scalar(2), scalar(3), dy,
+                          scalar(5)},
+                         0, Builder2);
+            },
+            shadow(2), shadow(4), dalpha);
+      } else if (routine == "scal") {
+        applyChainRule(
+            Builder2,
+            [&](Value *dx, Value *da) {
+              dx = dptr(2, dx);
+              callBLAS(blas, "scal", {scalar(0), scalar(1), dx, scalar(3)}, 0,
+                       Builder2);
+              if (da)
+                callBLAS(blas, "axpy",
+                         {scalar(0), dscalar(da), scalar(2), scalar(3), dx,
+                          scalar(3)},
+                         0, Builder2);
+            },
+            shadow(2), dalpha);
+      } else if (routine == "gemv") {
+        applyChainRule(
+            Builder2,
+            [&](Value *dA, Value *dx, Value *dy) {
+              dA = dptr(4, dA);
+              dx = dptr(6, dx);
+              dy = dptr(9, dy);
+              Value *beta = scalar(8);
+              if (dA) {
+                callBLAS(blas, "gemv",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     dA, scalar(5), scalar(6), scalar(7), beta,
+                                     dy, scalar(10)}),
+                         1, Builder2);
+                beta = fpConst(1.0);
+              }
+              if (dx)
+                callBLAS(blas, "gemv",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     scalar(4), scalar(5), dx, scalar(7), beta,
+                                     dy, scalar(10)}),
+                         1, Builder2);
+              if (!dA && !dx) {
+                Value *len = Builder2.CreateSelect(
+                    isBLASFlagFirst(blas, BLASFlag::Trans, scalar(0),
+                                    Builder2),
+                    scalar(1), scalar(2));
+                callBLAS(blas, "scal", {len, beta, dy, scalar(10)}, 0,
+                         Builder2);
+              }
+            },
+            shadow(4), shadow(6), shadow(9));
+      } else if (routine == "gemm") {
+        applyChainRule(
+            Builder2,
+            [&](Value *dA, Value *dB, Value *dC) {
+              dA = dptr(6, dA);
+              dB = dptr(8, dB);
+              dC = dptr(11, dC);
+              Value *beta = scalar(10);
+              if (dA) {
+                callBLAS(blas, "gemm",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     scalar(4), scalar(5), dA, scalar(7),
+                                     scalar(8), scalar(9), beta, dC,
+                                     scalar(12)}),
+                         2, Builder2);
+                beta = fpConst(1.0);
+              }
+              if (dB)
+                callBLAS(blas, "gemm",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     scalar(4), scalar(5), scalar(6), scalar(7),
+                                     dB, scalar(9), beta, dC, scalar(12)}),
+                         2, Builder2);
+              if (!dA && !dB)
+                scaleMat(scalar(2), scalar(3), beta, dC, scalar(12),
+                         ConstantInt::get(blas.intType, 0));
+            },
+            shadow(6), shadow(8), shadow(11));
+      } else if (routine == "syrk") {
+        applyChainRule(
+            Builder2,
+            [&](Value *dA, Value *dC) {
+              dA = dptr(5, dA);
+              dC = dptr(8, dC);
+              if (dA)
+                callBLAS(blas, "syr2k",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     scalar(4), dA, scalar(6), scalar(5),
+                                     scalar(6), scalar(7), dC, scalar(9)}),
+                         2, Builder2);
+              else
+                scaleMat(scalar(2), scalar(2), scalar(7), dC, scalar(9),
+                         triangle(rowMajor,
+                                  isBLASFlagFirst(blas, BLASFlag::Uplo,
+                                                  scalar(0), Builder2),
+                                  ConstantInt::getFalse(call.getContext()),
+                                  Builder2));
+            },
+            shadow(5), shadow(8));
+      } else {
+        // d(op(A)) X is subtracted from the scaled tangent of B before it is
+        // solved for, where X is the solution now in B.
+        applyChainRule(
+            Builder2,
+            [&](Value *dA, Value *dB) {
+              dA = dptr(7, dA);
+              dB = dptr(9, dB);
+              Value *m = scalar(4), *n = scalar(5);
+              Value *zero = ConstantInt::get(blas.intType, 0);
+              if (dA) {
+                auto runs = matrixShape(rowMajor, m, n, Builder2);
+                Value *tmp = Builder2.CreatePointerCast(
+                    CreateAllocation(Builder2, blas.fpType,
+                                     Builder2.CreateMul(runs.first,
+                                                        runs.second)),
+                    fpPtrTy);
+                Value *args[] = {tmp, scalar(9), runs.first, runs.second,
+                                 scalar(10)};
+                Builder2.CreateCall(
+                    getOrInsertMemcpyMat(*gutils->newFunc->getParent(),
+                                         cast<PointerType>(fpPtrTy),
+                                         blas.intType),
+                    args);
+                callBLAS(blas, "trmm",
+                         withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                     m, n, fpConst(1.0), dA, scalar(8), tmp,
+                                     runs.first}),
+                         4, Builder2);
+                Value *isUnit = Builder2.CreateNot(isBLASFlagFirst(
+                    blas, BLASFlag::Diag, scalar(3), Builder2));
+                Value *alpha = Builder2.CreateSelect(isUnit, fpConst(-1.0),
+                                                     fpConst(0.0));
+                axpyMat(m, n, alpha, scalar(9), scalar(10), tmp, runs.first);
+                scaleMat(m, n, scalar(6), dB, scalar(10), zero);
+                axpyMat(m, n, fpConst(-1.0), tmp, runs.first, dB, scalar(10));
+                CreateDealloc(Builder2, tmp);
+              } else {
+                scaleMat(m, n, scalar(6), dB, scalar(10), zero);
+              }
+              callBLAS(blas, "trsm",
+                       withLayout({scalar(0), scalar(1), scalar(2), scalar(3),
+                                   m, n, fpConst(1.0), scalar(7), scalar(8), dB,
+                                   scalar(10)}),
+                       4, Builder2);
+            },
+            shadow(7), shadow(9));
+      }
+      eraseIfUnused(call);
+      return true;
+    }
+
+    IRBuilder<> Builder2(call.getParent());
+    getReverseBuilder(Builder2);
+
+    if (cachetype) {
+      if (Mode != DerivativeMode::ReverseModeCombined)
+        cacheval = BuilderZ.CreatePHI(cachetype, 0);
+      cacheval = gutils->cacheForReverse(BuilderZ, cacheval,
+                                         getIndex(&call, CacheType::Tape));
+      cacheval = lookup(cacheval, Builder2);
+    }
+    auto cached = [&](unsigned idx) {
+      return cacheTypes.size() == 1
+                 ? cacheval
+                 : Builder2.CreateExtractValue(cacheval, {idx});
+    };
+
+    // Primal operands of the call, and the strides of the cached arrays, at
+    // Builder2 in the reverse pass.
+    std::map<unsigned, Value *> rev;
+    for (auto tup : llvm::enumerate(cachedScalars))
+      rev[tup.value()] = cached(tup.index());
+    auto scalar = [&](unsigned i) -> Value * {
+      auto found = rev.find(i);
+      if (found != rev.end())
+        return found->second;
+      return rev[i] = operandValue(
+                 i, lookup(gutils->getNewFromOriginal(orig(i)), Builder2),
+                 Builder2);
+    };
+    Value *layout =
+        blas.off ? lookup(gutils->getNewFromOriginal(call.getArgOperand(0)),
+                          Builder2)
+                 : nullptr;
+    Value *rowMajor = isRowMajor([&]() { return layout; }, Builder2);
+    // The strides of the arrays as they are in memory, which the cached
+    // copies no longer have.
+    std::map<unsigned, Value *> memStrides;
+    SmallVector<Value *, 2> toFree;
+    for (auto tup : llvm::enumerate(cachedArrays)) {
+      unsigned i = tup.value();
+      Value *copy = cached(cachedScalars.size() + tup.index());
+      toFree.push_back(copy);
+      memStrides[i] = scalar(arrayStride(i));
+      rev[i] = copy;
+      if (level1 || (routine == "gemv" && i == 6))
+        rev[arrayStride(i)] = ConstantInt::get(blas.intType, 1);
+      else {
+        auto shape = arrayShape(i, scalar, Builder2);
+        rev[arrayStride(i)] =
+            matrixShape(rowMajor, shape.first, shape.second, Builder2).first;
+      }
+    }
+    auto memStride = [&](unsigned i) {
+      auto found = memStrides.find(i);
+      if (found != memStrides.end())
+        return found->second;
+      return scalar(arrayStride(i));
+    };
+
+    auto shadow = [&](unsigned i) -> Value * {
+      if (!active(i))
+        return nullptr;
+      return lookup(gutils->invertPointerM(orig(i), Builder2), Builder2);
+    };
+    auto dptr = [&](unsigned i, Value *d) {
+      return d ? operandValue(i, d, Builder2) : nullptr;
+    };
+    auto withLayout = [&](std::initializer_list<Value *> args) {
+      SmallVector<Value *, 16> res;
+      if (layout)
+        res.push_back(layout);
+      res.append(args.begin(), args.end());
+      return res;
+    };
+    auto scaleMat = [&](Value *rows, Value *cols, Value *alpha, Value *A,
+                        Value *ld, Value *tri) {
+      auto runs = matrixShape(rowMajor, rows, cols, Builder2);
+      Value *args[] = {runs.first, runs.second, alpha, A, ld, tri};
+      Builder2.CreateCall(getOrInsertScaleMat(*gutils->newFunc->getParent(),
+                                              blas.fpType, blas.intType),
+                          args);
+    };
+    Value *dalpha = nullptr;
+    if (level1 && active(1)) {
+      if (byRef)
+        dalpha = shadow(1);
+    }
+
+    if (routine == "axpy" || routine == "scal") {
+      unsigned y = routine == "axpy" ? 4 : 2;
+      Value *dots = applyChainRule(
+          blas.fpType, Builder2,
+          [&](Value *dx, Value *dy, Value *da) -> Value * {
+            dx = dptr(2, dx);
+            dy = dptr(y, dy);
+            Value *dot = nullptr;
+            if (active(1)) {
+              dot = callBLAS(blas, "dot",
+                             {scalar(0), scalar(2), scalar(3), dy,
+                              memStride(y)},
+                             0, Builder2, blas.fpType);
+              if (da) {
+                da = Builder2.CreatePointerCast(da, fpPtrTy);
+#if LLVM_VERSION_MAJOR > 7
+                Value *prev = Builder2.CreateLoad(blas.fpType, da);
+#else
+                Value *prev = Builder2.CreateLoad(da);
+#endif
+                Builder2.CreateStore(Builder2.CreateFAdd(prev, dot), da);
+              }
+            }
+            if (routine == "axpy") {
+              if (dx)
+                callBLAS(blas, "axpy",
+                         {scalar(0), scalar(1), dy, memStride(y), dx,
+                          memStride(2)},
+                         0, Builder2);
+            } else {
+              callBLAS(blas, "scal", {scalar(0), scalar(1), dy, memStride(2)},
+                       0, Builder2);
+            }
+            return dot ? dot : fpConst(0.0);
+          },
+          routine == "axpy" ? shadow(2) : nullptr, shadow(y), dalpha);
+      if (active(1) && !byRef)
+        addToDiffe(orig(1), dots, Builder2, blas.fpType);
+    } else if (routine == "gemv") {
+      applyChainRule(
+          Builder2,
+          [&](Value *dA, Value *dx, Value *dy) {
+            dA = dptr(4, dA);
+            dx = dptr(6, dx);
+            dy = dptr(9, dy);
+            Value *isN =
+                isBLASFlagFirst(blas, BLASFlag::Trans, scalar(0), Builder2);
+            if (dA)
+              callBLAS(blas, "ger",
+                       withLayout({scalar(1), scalar(2), scalar(3),
+                                   Builder2.CreateSelect(isN, dy, scalar(6)),
+                                   Builder2.CreateSelect(isN, scalar(10),
+                                                         scalar(7)),
+                                   Builder2.CreateSelect(isN, scalar(6), dy),
+                                   Builder2.CreateSelect(isN, scalar(7),
+                                                         scalar(10)),
+                                   dA, memStride(4)}),
+                       0, Builder2);
+            if (dx)
+              callBLAS(blas, "gemv",
+                       withLayout({getBLASFlag(blas, BLASFlag::Trans,
+                                               Builder2.CreateNot(isN),
+                                               Builder2),
+                                   scalar(1), scalar(2), scalar(3), scalar(4),
+                                   scalar(5), dy, scalar(10), fpConst(1.0), dx,
+                                   memStride(6)}),
+                       1, Builder2);
+            callBLAS(blas, "scal",
+                     {Builder2.CreateSelect(isN, scalar(1), scalar(2)),
+                      scalar(8), dy, scalar(10)},
+                     0, Builder2);
+          },
+          shadow(4), shadow(6), shadow(9));
+    } else if (routine == "gemm") {
+      applyChainRule(
+          Builder2,
+          [&](Value *dA, Value *dB, Value *dC) {
+            dA = dptr(6, dA);
+            dB = dptr(8, dB);
+            dC = dptr(11, dC);
+            Value *m = scalar(2), *n = scalar(3), *k = scalar(4);
+            Value *isNA =
+                isBLASFlagFirst(blas, BLASFlag::Trans, scalar(0), Builder2);
+            Value *isNB =
+                isBLASFlagFirst(blas, BLASFlag::Trans, scalar(1), Builder2);
+            auto flag = [&](Value *isN) {
+              return getBLASFlag(blas, BLASFlag::Trans, isN, Builder2);
+            };
+            auto sel = [&](Value *c, Value *a, Value *b) {
+              return Builder2.CreateSelect(c, a, b);
+            };
+            // dA += alpha dC op(B)^T, or alpha op(B) dC^T if A is transposed.
+            if (dA)
+              callBLAS(
+                  blas, "gemm",
+                  withLayout({flag(Builder2.CreateOr(isNA, isNB)),
+                              flag(Builder2.CreateAnd(
+                                  isNA, Builder2.CreateNot(isNB))),
+                              sel(isNA, m, k), sel(isNA, k, m), n, scalar(5),
+                              sel(isNA, dC, scalar(8)),
+                              sel(isNA, scalar(12), scalar(9)),
+                              sel(isNA, scalar(8), dC),
+                              sel(isNA, scalar(9), scalar(12)), fpConst(1.0),
+                              dA, memStride(6)}),
+                  2, Builder2);
+            // dB += alpha op(A)^T dC, or alpha dC^T op(A) if B is transposed.
+            if (dB)
+              callBLAS(
+                  blas, "gemm",
+                  withLayout({flag(Builder2.CreateAnd(
+                                  isNB, Builder2.CreateNot(isNA))),
+                              flag(Builder2.CreateOr(isNB, isNA)),
+                              sel(isNB, k, n), sel(isNB, n, k), m, scalar(5),
+                              sel(isNB, scalar(6), dC),
+                              sel(isNB, scalar(7), scalar(12)),
+                              sel(isNB, dC, scalar(6)),
+                              sel(isNB, scalar(12), scalar(7)), fpConst(1.0),
+                              dB, memStride(8)}),
+                  2, Builder2);
+            scaleMat(m, n, scalar(10), dC, scalar(12),
+                     ConstantInt::get(blas.intType, 0));
+          },
+          shadow(6), shadow(8), shadow(11));
+    } else if (routine == "syrk") {
+      applyChainRule(
+          Builder2,
+          [&](Value *dA, Value *dC) {
+            dA = dptr(5, dA);
+            dC = dptr(8, dC);
+            Value *n = scalar(2), *k = scalar(3);
+            Value *upper =
+                isBLASFlagFirst(blas, BLASFlag::Uplo, scalar(0), Builder2);
+            // dA += alpha (T + T^T) op(A), T being the updated triangle of
+            // dC, that is symm with the diagonal of dC doubled.
+            if (dA) {
+              Value *diagInc = Builder2.CreateAdd(
+                  scalar(9), ConstantInt::get(blas.intType, 1));
+              callBLAS(blas, "scal", {n, fpConst(2.0), dC, diagInc}, 0,
+                       Builder2);
+              Value *isN =
+                  isBLASFlagFirst(blas, BLASFlag::Trans, scalar(1), Builder2);
+              callBLAS(blas, "symm",
+                       withLayout({getBLASFlag(blas, BLASFlag::Side, isN,
+                                               Builder2),
+                                   scalar(0), Builder2.CreateSelect(isN, n, k),
+                                   Builder2.CreateSelect(isN, k, n), scalar(4),
+                                   dC, scalar(9), scalar(5), scalar(6),
+                                   fpConst(1.0), dA, memStride(5)}),
+                       2, Builder2);
+              callBLAS(blas, "scal", {n, fpConst(0.5), dC, diagInc}, 0,
+                       Builder2);
+            }
+            scaleMat(n, n, scalar(7), dC, scalar(9),
+                     triangle(rowMajor, upper,
+                              ConstantInt::getFalse(call.getContext()),
+                              Builder2));
+          },
+          shadow(5), shadow(8));
+    } else {
+      applyChainRule(
+          Builder2,
+          [&](Value *dA, Value *dB) {
+            dA = dptr(7, dA);
+            dB = dptr(9, dB);
+            Value *m = scalar(4), *n = scalar(5);
+            Value *isN =
+                isBLASFlagFirst(blas, BLASFlag::Trans, scalar(2), Builder2);
+            // G = op(A)^-T dX, in place of dX.
+            callBLAS(blas, "trsm",
+                     withLayout({scalar(0), scalar(1),
+                                 getBLASFlag(blas, BLASFlag::Trans,
+                                             Builder2.CreateNot(isN),
+                                             Builder2),
+                                 scalar(3), m, n, fpConst(1.0), scalar(7),
+                                 scalar(8), dB, memStride(9)}),
+                     4, Builder2);
+            // d(op(A)) = -G X^T for a left solve and -X^T G for a right one,
+            // of which the referenced triangle of dA takes its part.
+            if (dA) {
+              Value *isL =
+                  isBLASFlagFirst(blas, BLASFlag::Side, scalar(0), Builder2);
+              Value *dim = Builder2.CreateSelect(isL, m, n);
+              Value *tmp = Builder2.CreatePointerCast(
+                  CreateAllocation(Builder2, blas.fpType,
+                                   Builder2.CreateMul(dim, dim)),
+                  fpPtrTy);
+              Value *X = scalar(9), *ldX = scalar(10);
+              Value *GFirst = Builder2.CreateXor(isL, Builder2.CreateNot(isN));
+              callBLAS(blas, "gemm",
+                       withLayout({getBLASFlag(blas, BLASFlag::Trans, isL,
+                                               Builder2),
+                                   getBLASFlag(blas, BLASFlag::Trans,
+                                               Builder2.CreateNot(isL),
+                                               Builder2),
+                                   dim, dim, Builder2.CreateSelect(isL, n, m),
+                                   fpConst(-1.0),
+                                   Builder2.CreateSelect(GFirst, dB, X),
+                                   Builder2.CreateSelect(GFirst, memStride(9),
+                                                         ldX),
+                                   Builder2.CreateSelect(GFirst, X, dB),
+                                   Builder2.CreateSelect(GFirst, ldX,
+                                                         memStride(9)),
+                                   fpConst(0.0), tmp, dim}),
+                       2, Builder2);
+              Value *upper =
+                  isBLASFlagFirst(blas, BLASFlag::Uplo, scalar(1), Builder2);
+              Value *unit = Builder2.CreateNot(
+                  isBLASFlagFirst(blas, BLASFlag::Diag, scalar(3), Builder2));
+              Value *args[] = {dim,
+                               dim,
+                               fpConst(1.0),
+                               tmp,
+                               dim,
+                               dA,
+                               memStride(7),
+                               triangle(rowMajor, upper, unit, Builder2),
+                               ConstantInt::get(blas.intType, 0)};
+              Builder2.CreateCall(
+                  getOrInsertAxpyMat(*gutils->newFunc->getParent(),
+                                     blas.fpType, blas.intType),
+                  args);
+              CreateDealloc(Builder2, tmp);
+            }
+            scaleMat(m, n, scalar(6), dB, memStride(9),
+                     ConstantInt::get(blas.intType, 0));
+          },
+          shadow(7), shadow(9));
+    }
+
+    if (shouldFree())
+      for (auto copy : toFree)
+        CreateDealloc(Builder2, copy);
+
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+    } else {
+      eraseIfUnused(call);
+    }
+    return true;
+  }
+
+  /// Reverse mode derivatives of the LAPACK drivers potrf, potrs, getrf,
+  /// getrs, gesv and syev (the latter computing eigenvectors). The adjoints
+  /// reuse the factorization computed by the forward pass: that of a solve
+  /// is a solve with the transposed system and that of a factorization a
+  /// closed form update, both through further BLAS and LAPACK calls.
+  bool handleLAPACK(CallInst &call, StringRef funcName, StringRef prefix,
+                    StringRef suffix,
+                    const std::map<Argument *, bool> &uncacheable_args) {
+    Function *called = call.getCalledFunction();
+    if (!called || prefix.size())
+      return false;
+    if (Mode == DerivativeMode::ForwardMode ||
+        Mode == DerivativeMode::ForwardModeSplit)
+      return false;
+
+    StringRef routine = funcName.drop_front(1);
+    BLASCall blas;
+    blas.call = &call;
+    blas.suffix = suffix.str();
+    blas.fp = funcName[0];
+    blas.fpType = funcName[0] == 'd' ? Type::getDoubleTy(call.getContext())
+                                     : Type::getFloatTy(call.getContext());
+    blas.intType =
+        IntegerType::get(call.getContext(), suffix.contains("64") ? 64 : 32);
+    blas.cblas = false;
+    blas.off = 0;
+
+    unsigned numArgs = StringSwitch<unsigned>(routine)
+                           .Case("potrf", 5)
+                           .Case("potrs", 8)
+                           .Case("getrf", 6)
+                           .Case("getrs", 9)
+                           .Case("gesv", 8)
+                           .Case("syev", 9);
+    unsigned numFlags = StringSwitch<unsigned>(routine)
+                            .Case("potrf", 1)
+                            .Case("potrs", 1)
+                            .Case("getrs", 1)
+                            .Case("syev", 2)
+                            .Default(0);
+    if (call.arg_size() != numArgs && call.arg_size() != numArgs + numFlags)
+      return false;
+    blas.lengths = call.arg_size() != numArgs;
+    for (unsigned i = 0; i < numArgs; i++)
+      if (!call.getArgOperand(i)->getType()->isPointerTy())
+        return false;
+
+    // Positions of the operands: the flags, the dimension n of the (square)
+    // matrix A factorized or solved with, its pivots, and the nrhs right hand
+    // sides B, or eigenvalues w.
+    int uplo = -1, trans = -1, n, nrhs = -1, A, lda, ipiv = -1, B = -1,
+        ldb = -1, w = -1, lwork = -1;
+    if (routine == "potrf") {
+      uplo = 0, n = 1, A = 2, lda = 3;
+    } else if (routine == "potrs") {
+      uplo = 0, n = 1, nrhs = 2, A = 3, lda = 4, B = 5, ldb = 6;
+    } else if (routine == "getrf") {
+      n = 1, A = 2, lda = 3, ipiv = 4;
+      // Only square factorizations, as used by solves, are handled.
+      if (call.getArgOperand(0) != call.getArgOperand(1))
+        return false;
+    } else if (routine == "getrs") {
+      trans = 0, n = 1, nrhs = 2, A = 3, lda = 4, ipiv = 5, B = 6, ldb = 7;
+    } else if (routine == "gesv") {
+      n = 0, nrhs = 1, A = 2, lda = 3, ipiv = 4, B = 5, ldb = 6;
+    } else {
+      uplo = 1, n = 2, A = 3, lda = 4, w = 5, lwork = 7;
+      // Without eigenvectors the adjoint could not be formed.
+      StringRef jobz;
+      if (!getConstantStringInfo(call.getArgOperand(0), jobz) ||
+          (!jobz.startswith("V") && !jobz.startswith("v")))
+        return false;
+    }
+
+    auto orig = [&](int i) { return call.getArgOperand(i); };
+    auto active = [&](int i) {
+      return i >= 0 && !gutils->isConstantValue(orig(i));
+    };
+    bool activeA = active(A);
+    // Whether derivatives flow out of the overwritten operands.
+    bool activeOut = (routine == "potrf" || routine == "getrf")
+                         ? activeA
+                         : (active(B) || active(w) ||
+                            (activeA && (routine == "gesv" ||
+                                         routine == "syev")));
+
+    CallInst *const newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    IRBuilder<> BuilderZ(newCall);
+    BuilderZ.setFastMathFlags(getFast());
+
+    if (gutils->isConstantInstruction(&call) || !activeOut) {
+      if (Mode == DerivativeMode::ReverseModeGradient) {
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      } else {
+        eraseIfUnused(call);
+      }
+      return true;
+    }
+
+    Type *fpPtrTy = PointerType::getUnqual(blas.fpType);
+    Type *intPtrTy = PointerType::getUnqual(blas.intType);
+    auto isArray = [&](int i) { return i == A || i == B || i == w; };
+    // The value of the scalar operand, or the array operand as a pointer, of
+    // the new call v at Bld.
+    auto operandValue = [&](int i, Value *v, IRBuilder<> &Bld) -> Value * {
+      if (v->getType()->isIntegerTy())
+        v = Bld.CreateIntToPtr(v, fpPtrTy);
+      if (i == ipiv)
+        return Bld.CreatePointerCast(v, intPtrTy);
+      if (isArray(i))
+        return Bld.CreatePointerCast(v, fpPtrTy);
+      Type *T = (i == uplo || i == trans) ? Type::getInt8Ty(call.getContext())
+                                          : blas.intType;
+      v = Bld.CreatePointerCast(v, PointerType::getUnqual(T));
+#if LLVM_VERSION_MAJOR > 7
+      return Bld.CreateLoad(T, v);
+#else
+      return Bld.CreateLoad(v);
+#endif
+    };
+
+    // The arrays needed by the reverse pass, as they are after the call,
+    // with the operands giving their rows and columns (-1 for vectors).
+    SmallVector<std::tuple<int, int, int>, 3> needed;
+    needed.push_back(std::make_tuple(A, n, n));
+    if (ipiv != -1)
+      needed.push_back(std::make_tuple(ipiv, n, -1));
+    if (B != -1 && activeA)
+      needed.push_back(std::make_tuple(B, n, nrhs));
+    if (w != -1)
+      needed.push_back(std::make_tuple(w, n, -1));
+    auto stride = [&](int i) { return i == A ? lda : i == B ? ldb : -1; };
+
+    auto uncacheable = [&](int i) {
+      auto found = uncacheable_args.find(called->arg_begin() + i);
+      return found == uncacheable_args.end() || found->second;
+    };
+    SmallVector<std::tuple<int, int, int>, 3> cachedArrays;
+    for (auto tup : needed)
+      if (uncacheable(std::get<0>(tup)))
+        cachedArrays.push_back(tup);
+    SmallVector<int, 8> cachedScalars;
+    for (int i : {uplo, trans, n, nrhs, lda, ldb, lwork})
+      if (i != -1 && uncacheable(i))
+        cachedScalars.push_back(i);
+
+    SmallVector<Type *, 8> cacheTypes;
+    for (auto i : cachedScalars)
+      cacheTypes.push_back((i == uplo || i == trans)
+                               ? Type::getInt8Ty(call.getContext())
+                               : (Type *)blas.intType);
+    for (auto tup : cachedArrays)
+      cacheTypes.push_back(std::get<0>(tup) == ipiv ? intPtrTy : fpPtrTy);
+    Type *cachetype = nullptr;
+    if (cacheTypes.size() == 1)
+      cachetype = cacheTypes[0];
+    else if (cacheTypes.size() > 1)
+      cachetype = StructType::get(call.getContext(), cacheTypes);
+
+    Value *cacheval = nullptr;
+    if ((Mode == DerivativeMode::ReverseModeCombined ||
+         Mode == DerivativeMode::ReverseModePrimal) &&
+        cachetype) {
+      // Scalars are read before the call, the arrays copied after it.
+      IRBuilder<> BuilderPost(newCall->getNextNode());
+      std::map<int, Value *> fwd;
+      auto scalar = [&](int i) {
+        auto found = fwd.find(i);
+        if (found != fwd.end())
+          return found->second;
+        return fwd[i] = operandValue(i, gutils->getNewFromOriginal(orig(i)),
+                                     BuilderZ);
+      };
+      SmallVector<Value *, 8> cacheValues;
+      for (auto i : cachedScalars)
+        cacheValues.push_back(scalar(i));
+      for (auto tup : cachedArrays) {
+        int i = std::get<0>(tup);
+        Value *src =
+            operandValue(i, gutils->getNewFromOriginal(orig(i)), BuilderPost);
+        Value *rows = scalar(std::get<1>(tup));
+        Value *copy;
+        if (i == ipiv) {
+          copy = BuilderPost.CreatePointerCast(
+              CreateAllocation(BuilderPost, blas.intType, rows), intPtrTy);
+          Value *size = BuilderPost.CreateMul(
+              rows, ConstantInt::get(blas.intType,
+                                     blas.intType->getBitWidth() / 8));
+#if LLVM_VERSION_MAJOR >= 10
+          BuilderPost.CreateMemCpy(copy, MaybeAlign(), src, MaybeAlign(), size);
+#else
+          BuilderPost.CreateMemCpy(copy, 1, src, 1, size);
+#endif
+        } else if (std::get<2>(tup) == -1) {
+          copy = BuilderPost.CreatePointerCast(
+              CreateAllocation(BuilderPost, blas.fpType, rows), fpPtrTy);
+          Value *args[] = {copy, src, rows, ConstantInt::get(blas.intType, 1)};
+          BuilderPost.CreateCall(
+              getOrInsertMemcpyStrided(*gutils->newFunc->getParent(),
+                                       cast<PointerType>(fpPtrTy),
+                                       blas.intType, 0, 0),
+              args);
+        } else {
+          Value *cols = scalar(std::get<2>(tup));
+          copy = BuilderPost.CreatePointerCast(
+              CreateAllocation(BuilderPost, blas.fpType,
+                               BuilderPost.CreateMul(rows, cols)),
+              fpPtrTy);
+          Value *args[] = {copy, src, rows, cols, scalar(stride(i))};
+          BuilderPost.CreateCall(
+              getOrInsertMemcpyMat(*gutils->newFunc->getParent(),
+                                   cast<PointerType>(fpPtrTy), blas.intType),
+              args);
+        }
+        cacheValues.push_back(copy);
+      }
+      if (cacheValues.size() == 1)
+        cacheval = cacheValues[0];
+      else {
+        cacheval = UndefValue::get(cachetype);
+        for (auto tup : llvm::enumerate(cacheValues))
+          cacheval =
+              BuilderPost.CreateInsertValue(cacheval, tup.value(), tup.index());
+      }
+      gutils->cacheForReverse(BuilderPost, cacheval,
+                              getIndex(&call, CacheType::Tape));
+    }
+
+    if (Mode == DerivativeMode::ReverseModePrimal) {
+      eraseIfUnused(call);
+      return true;
+    }
+
+    IRBuilder<> Builder2(call.getParent());
+    getReverseBuilder(Builder2);
+
+    if (cachetype) {
+      if (Mode != DerivativeMode::ReverseModeCombined)
+        cacheval = BuilderZ.CreatePHI(cachetype, 0);
+      cacheval = gutils->cacheForReverse(BuilderZ, cacheval,
+                                         getIndex(&call, CacheType::Tape));
+      cacheval = lookup(cacheval, Builder2);
+    }
+    auto cached = [&](unsigned idx) {
+      return cacheTypes.size() == 1
+                 ? cacheval
+                 : Builder2.CreateExtractValue(cacheval, {idx});
+    };
+
+    // Operands of the call in the reverse pass, and the leading dimensions of
+    // the arrays as they are in memory, which their cached copies no longer
+    // have.
+    std::map<int, Value *> rev;
+    for (auto tup : llvm::enumerate(cachedScalars))
+      rev[tup.value()] = cached(tup.index());
+    auto scalar = [&](int i) -> Value * {
+      auto found = rev.find(i);
+      if (found != rev.end())
+        return found->second;
+      return rev[i] = operandValue(
+                 i, lookup(gutils->getNewFromOriginal(orig(i)), Builder2),
+                 Builder2);
+    };
+    std::map<int, Value *> memStrides;
+    SmallVector<Value *, 3> toFree;
+    for (auto tup : llvm::enumerate(cachedArrays)) {
+      int i = std::get<0>(tup.value());
+      Value *copy = cached(cachedScalars.size() + tup.index());
+      toFree.push_back(copy);
+      if (stride(i) != -1) {
+        memStrides[i] = scalar(stride(i));
+        rev[stride(i)] = scalar(std::get<1>(tup.value()));
+      }
+      rev[i] = copy;
+    }
+    auto memStride = [&](int i) {
+      auto found = memStrides.find(i);
+      if (found != memStrides.end())
+        return found->second;
+      return scalar(stride(i));
+    };
+
+    Value *dim = scalar(n);
+    Value *one = ConstantInt::get(blas.intType, 1);
+    auto fpConst = [&](double v) { return ConstantFP::get(blas.fpType, v); };
+    auto flag = [&](BLASFlag kind, Value *isFirst) {
+      return getBLASFlag(blas, kind, isFirst, Builder2);
+    };
+    auto constFlag = [&](BLASFlag kind, bool isFirst) {
+      return flag(kind, ConstantInt::get(Type::getInt1Ty(call.getContext()),
+                                         isFirst));
+    };
+    auto newMat = [&](Value *cols) {
+      return Builder2.CreatePointerCast(
+          CreateAllocation(Builder2, blas.fpType,
+                           Builder2.CreateMul(dim, cols)),
+          fpPtrTy);
+    };
+    auto copyMat = [&](Value *dst, Value *src, Value *ld) {
+      Value *args[] = {dst, src, dim, dim, ld};
+      Builder2.CreateCall(getOrInsertMemcpyMat(*gutils->newFunc->getParent(),
+                                               cast<PointerType>(fpPtrTy),
+                                               blas.intType),
+                          args);
+    };
+    // Scale, or add to Y, the triangle (as selected by getOrInsertScaleMat) of
+    // the n x n matrices.
+    auto scaleMat = [&](double alpha, Value *X, Value *ld, unsigned tri) {
+      Value *args[] = {dim, dim, fpConst(alpha), X, ld,
+                       ConstantInt::get(blas.intType, tri)};
+      Builder2.CreateCall(getOrInsertScaleMat(*gutils->newFunc->getParent(),
+                                              blas.fpType, blas.intType),
+                          args);
+    };
+    auto axpyMat = [&](Value *X, Value *ldx, Value *Y, Value *ldy, Value *tri,
+                       bool transX) {
+      Value *args[] = {dim, dim, fpConst(1.0), X, ldx, Y, ldy, tri,
+                       ConstantInt::get(blas.intType, transX)};
+      Builder2.CreateCall(getOrInsertAxpyMat(*gutils->newFunc->getParent(),
+                                             blas.fpType, blas.intType),
+                          args);
+    };
+    auto triConst = [&](unsigned tri) {
+      return ConstantInt::get(blas.intType, tri);
+    };
+    // The triangle of the symmetric matrix referenced by uplo, and its strict
+    // version, together with the opposite strict triangle.
+    Value *upper = nullptr, *uploTri = nullptr, *uploStrict = nullptr,
+          *otherStrict = nullptr;
+    if (uplo != -1) {
+      upper = isBLASFlagFirst(blas, BLASFlag::Uplo, scalar(uplo), Builder2);
+      uploTri = Builder2.CreateSelect(upper, triConst(1), triConst(2));
+      uploStrict = Builder2.CreateSelect(upper, triConst(3), triConst(4));
+      otherStrict = Builder2.CreateSelect(upper, triConst(4), triConst(3));
+    }
+    auto scaleTri = [&](double alpha, Value *X, Value *ld, Value *tri) {
+      Value *args[] = {dim, dim, fpConst(alpha), X, ld, tri};
+      Builder2.CreateCall(getOrInsertScaleMat(*gutils->newFunc->getParent(),
+                                              blas.fpType, blas.intType),
+                          args);
+    };
+    auto side = [&](Value *isLeft) { return flag(BLASFlag::Side, isLeft); };
+    Value *N = constFlag(BLASFlag::Trans, true);
+    Value *T = constFlag(BLASFlag::Trans, false);
+    Value *nonUnit = constFlag(BLASFlag::Diag, true);
+    Value *unit = constFlag(BLASFlag::Diag, false);
+    Value *lower = constFlag(BLASFlag::Uplo, false);
+    Value *upperFlag = constFlag(BLASFlag::Uplo, true);
+    Value *left = constFlag(BLASFlag::Side, true);
+    Value *right = constFlag(BLASFlag::Side, false);
+
+    // dA, the adjoint of the factors P L U in A, becomes that of the
+    // factorized matrix: P L^-T (tril(L^T dL, -1) + triu(dU U^T)) U^-T.
+    auto getrfAdjoint = [&](Value *dA) {
+      Value *LU = scalar(A), *ldLU = scalar(lda), *ld = memStride(A);
+      Value *W1 = newMat(dim), *W2 = newMat(dim);
+      copyMat(W1, dA, ld);
+      copyMat(W2, dA, ld);
+      scaleMat(0.0, W1, dim, 1);
+      callBLAS(blas, "trmm",
+               {left, lower, T, unit, dim, dim, fpConst(1.0), LU, ldLU, W1,
+                dim},
+               4, Builder2);
+      scaleMat(0.0, W1, dim, 1);
+      scaleMat(0.0, W2, dim, 4);
+      callBLAS(blas, "trmm",
+               {right, upperFlag, T, nonUnit, dim, dim, fpConst(1.0), LU, ldLU,
+                W2, dim},
+               4, Builder2);
+      axpyMat(W2, dim, W1, dim, triConst(1), false);
+      callBLAS(blas, "trsm",
+               {left, lower, T, unit, dim, dim, fpConst(1.0), LU, ldLU, W1,
+                dim},
+               4, Builder2);
+      callBLAS(blas, "trsm",
+               {right, upperFlag, T, nonUnit, dim, dim, fpConst(1.0), LU, ldLU,
+                W1, dim},
+               4, Builder2);
+      callBLAS(blas, "laswp",
+               {dim, W1, dim, one, dim, scalar(ipiv),
+                ConstantInt::get(blas.intType, -1)},
+               0, Builder2);
+      scaleMat(0.0, dA, ld, 0);
+      axpyMat(W1, dim, dA, ld, triConst(0), false);
+      CreateDealloc(Builder2, W1);
+      CreateDealloc(Builder2, W2);
+    };
+    // Add to dA the adjoint of the factors P L U in A, given the adjoint W
+    // (which is overwritten) of the matrix they factorize.
+    auto luFactorsAdjoint = [&](Value *W, Value *dA) {
+      Value *LU = scalar(A), *ldLU = scalar(lda), *ld = memStride(A);
+      callBLAS(blas, "laswp", {dim, W, dim, one, dim, scalar(ipiv), one}, 0,
+               Builder2);
+      Value *W2 = newMat(dim);
+      copyMat(W2, W, dim);
+      callBLAS(blas, "trmm",
+               {right, upperFlag, T, nonUnit, dim, dim, fpConst(1.0), LU, ldLU,
+                W, dim},
+               4, Builder2);
+      callBLAS(blas, "trmm",
+               {left, lower, T, unit, dim, dim, fpConst(1.0), LU, ldLU, W2,
+                dim},
+               4, Builder2);
+      axpyMat(W, dim, dA, ld, triConst(4), false);
+      axpyMat(W2, dim, dA, ld, triConst(1), false);
+      CreateDealloc(Builder2, W2);
+    };
+    // The adjoint -G X^T (or -X G^T if transposed) of the matrix of a solve
+    // with solution X, given G, the solution for its adjoint of the
+    // transposed system.
+    auto solveAdjoint = [&](Value *G, Value *ldG, Value *isN) {
+      Value *X = scalar(B), *ldX = scalar(ldb);
+      Value *W = newMat(dim);
+      callBLAS(blas, "gemm",
+               {N, T, dim, dim, scalar(nrhs), fpConst(-1.0),
+                Builder2.CreateSelect(isN, G, X),
+                Builder2.CreateSelect(isN, ldG, ldX),
+                Builder2.CreateSelect(isN, X, G),
+                Builder2.CreateSelect(isN, ldX, ldG), fpConst(0.0), W, dim},
+               2, Builder2);
+      return W;
+    };
+    Value *info = ConstantInt::get(blas.intType, 0);
+
+    auto rule = [&](Value *dA, Value *dB) {
+      if (dA)
+        dA = operandValue(A, dA, Builder2);
+      if (dB)
+        dB = operandValue(B != -1 ? B : w, dB, Builder2);
+      Value *F = scalar(A), *ldF = scalar(lda);
+      if (routine == "potrf") {
+        // With A = L L^T, L^-T Phi(L^T dL) L^-1 where Phi takes the lower
+        // triangle with half its diagonal, whose lower triangle plus the
+        // transpose of its strict upper one is the adjoint of that of A.
+        // The upper case is the transpose of this.
+        Value *ld = memStride(A);
+        Value *W = newMat(dim);
+        copyMat(W, dA, ld);
+        scaleTri(0.0, W, dim, otherStrict);
+        callBLAS(blas, "trmm",
+                 {side(Builder2.CreateNot(upper)), scalar(uplo), T, nonUnit,
+                  dim, dim, fpConst(1.0), F, ldF, W, dim},
+                 4, Builder2);
+        scaleTri(0.0, W, dim, otherStrict);
+        callBLAS(blas, "scal",
+                 {dim, fpConst(0.5), W, Builder2.CreateAdd(dim, one)}, 0,
+                 Builder2);
+        callBLAS(blas, "trsm",
+                 {side(upper), scalar(uplo), N, nonUnit, dim, dim,
+                  fpConst(1.0), F, ldF, W, dim},
+                 4, Builder2);
+        callBLAS(blas, "trsm",
+                 {side(Builder2.CreateNot(upper)), scalar(uplo), T, nonUnit,
+                  dim, dim, fpConst(1.0), F, ldF, W, dim},
+                 4, Builder2);
+        scaleTri(0.0, dA, ld, uploTri);
+        axpyMat(W, dim, dA, ld, uploTri, false);
+        axpyMat(W, dim, dA, ld, uploStrict, true);
+        CreateDealloc(Builder2, W);
+      } else if (routine == "potrs") {
+        // G = A^-1 dX, then the adjoint of L is sym(-G X^T) L (and that of
+        // U, U sym(-G X^T)), with sym(S) = S + S^T.
+        Value *ldG = memStride(B);
+        callBLAS(blas, "potrs",
+                 {scalar(uplo), dim, scalar(nrhs), F, ldF, dB, ldG, info}, 1,
+                 Builder2);
+        if (dA) {
+          Value *X = scalar(B), *ldX = scalar(ldb);
+          Value *S = newMat(dim), *C = newMat(dim), *R = newMat(dim);
+          callBLAS(blas, "syr2k",
+                   {scalar(uplo), N, dim, scalar(nrhs), fpConst(-1.0), dB, ldG,
+                    X, ldX, fpConst(0.0), S, dim},
+                   2, Builder2);
+          copyMat(C, F, ldF);
+          scaleTri(0.0, C, dim, otherStrict);
+          callBLAS(blas, "symm",
+                   {side(Builder2.CreateNot(upper)), scalar(uplo), dim, dim,
+                    fpConst(1.0), S, dim, C, dim, fpConst(0.0), R, dim},
+                   2, Builder2);
+          axpyMat(R, dim, dA, memStride(A), uploTri, false);
+          CreateDealloc(Builder2, S);
+          CreateDealloc(Builder2, C);
+          CreateDealloc(Builder2, R);
+        }
+      } else if (routine == "getrf") {
+        getrfAdjoint(dA);
+      } else if (routine == "getrs" || routine == "gesv") {
+        Value *isN =
+            trans == -1
+                ? ConstantInt::getTrue(call.getContext())
+                : isBLASFlagFirst(blas, BLASFlag::Trans, scalar(trans),
+                                  Builder2);
+        Value *ldG = memStride(B);
+        if (dB) {
+          callBLAS(blas, "getrs",
+                   {flag(BLASFlag::Trans, Builder2.CreateNot(isN)), dim,
+                    scalar(nrhs), F, ldF, scalar(ipiv), dB, ldG, info},
+                   1, Builder2);
+          if (dA) {
+            Value *W = solveAdjoint(dB, ldG, isN);
+            luFactorsAdjoint(W, dA);
+            CreateDealloc(Builder2, W);
+          }
+        }
+        if (dA && routine == "gesv")
+          getrfAdjoint(dA);
+      } else {
+        // V (diag(dw) + F o (V^T dV)) V^T with F_ij = 1 / (w_j - w_i), of
+        // which the referenced triangle of A takes its part.
+        Value *V = F, *ldV = ldF, *ld = memStride(A);
+        Value *K = newMat(dim), *M = newMat(dim);
+        if (dA) {
+          callBLAS(blas, "gemm",
+                   {T, N, dim, dim, dim, fpConst(1.0), V, ldV, dA, ld,
+                    fpConst(0.0), K, dim},
+                   2, Builder2);
+          Value *args[] = {dim, dim, scalar(w), K, dim};
+          Builder2.CreateCall(getOrInsertEigenvectorAdjointMat(
+                                  *gutils->newFunc->getParent(), blas.fpType,
+                                  blas.intType),
+                              args);
+        } else {
+          scaleMat(0.0, K, dim, 0);
+        }
+        if (dB) {
+          callBLAS(blas, "axpy",
+                   {dim, fpConst(1.0), dB, one, K,
+                    Builder2.CreateAdd(dim, one)},
+                   0, Builder2);
+          Value *args[] = {dim, one, fpConst(0.0), dB, dim, triConst(0)};
+          Builder2.CreateCall(getOrInsertScaleMat(*gutils->newFunc->getParent(),
+                                                  blas.fpType, blas.intType),
+                              args);
+        }
+        callBLAS(blas, "gemm",
+                 {N, N, dim, dim, dim, fpConst(1.0), V, ldV, K, dim,
+                  fpConst(0.0), M, dim},
+                 2, Builder2);
+        callBLAS(blas, "gemm",
+                 {N, T, dim, dim, dim, fpConst(1.0), M, dim, V, ldV,
+                  fpConst(0.0), K, dim},
+                 2, Builder2);
+        if (dA) {
+          scaleMat(0.0, dA, ld, 0);
+          axpyMat(K, dim, dA, ld, uploTri, false);
+          axpyMat(K, dim, dA, ld, uploStrict, true);
+        }
+        CreateDealloc(Builder2, K);
+        CreateDealloc(Builder2, M);
+      }
+    };
+
+    Value *shadowA = activeA ? lookup(gutils->invertPointerM(orig(A), Builder2),
+                                      Builder2)
+                             : nullptr;
+    int out = B != -1 ? B : w;
+    Value *shadowB =
+        active(out)
+            ? lookup(gutils->invertPointerM(orig(out), Builder2), Builder2)
+            : nullptr;
+
+    if (lwork != -1) {
+      // Nothing is computed by a workspace query.
+      Value *query = Builder2.CreateICmpEQ(
+          scalar(lwork), ConstantInt::get(blas.intType, -1, true));
+      BasicBlock *currentBlock = Builder2.GetInsertBlock();
+      BasicBlock *adjointBlock = gutils->addReverseBlock(
+          currentBlock, currentBlock->getName() + "_lapack", gutils->newFunc);
+      BasicBlock *mergeBlock = gutils->addReverseBlock(
+          adjointBlock, currentBlock->getName() + "_lapack_post",
+          gutils->newFunc);
+      Builder2.CreateCondBr(query, mergeBlock, adjointBlock);
+      Builder2.SetInsertPoint(adjointBlock);
+      applyChainRule(Builder2, rule, shadowA, shadowB);
+      Builder2.CreateBr(mergeBlock);
+      Builder2.SetInsertPoint(mergeBlock);
+    } else {
+      applyChainRule(Builder2, rule, shadowA, shadowB);
+    }
+
+    if (shouldFree())
+      for (auto copy : toFree)
+        CreateDealloc(Builder2, copy);
+
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+    } else {
+      eraseIfUnused(call);
+    }
+    return true;
+  }
+
+  /// Derivatives of a call to the solver of getOrInsertFixedPoint, with
+  /// metadata md giving its step function, which leaves in x a fixed point
+  /// x = step(x, args...). By the implicit function theorem the tangent of x
+  /// then solves t = J_x t + J_args dargs, and its adjoint dx is propagated
+  /// to args as J_args^T w for the solution of w = dx + J_x^T w, after which
+  /// it is cleared as x no longer depends on its initial value. Both are
+  /// iterated like the fixed point itself with derivatives of a single step,
+  /// such that only x at the fixed point is cached. Returns false if the call
+  /// must be differentiated as usual.
+  bool handleFixedPoint(CallInst &call, MDNode *md,
+                        const std::map<Argument *, bool> &uncacheable_args) {
+    Function *called = call.getCalledFunction();
+    if (Mode == DerivativeMode::ForwardModeSplit || gutils->getWidth() != 1)
+      return false;
+    auto step =
+        cast<Function>(cast<ValueAsMetadata>(md->getOperand(0))->getValue());
+    auto orig = [&](unsigned i) { return call.getArgOperand(i); };
+    auto uncacheable = [&](unsigned i) {
+      auto found = uncacheable_args.find(called->arg_begin() + i);
+      return found == uncacheable_args.end() || found->second;
+    };
+    // The remaining arguments are read again by the reverse pass.
+    if (Mode != DerivativeMode::ForwardMode)
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        if (orig(i)->getType()->isPointerTy() && uncacheable(i))
+          return false;
+
+    CallInst *const newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    IRBuilder<> BuilderZ(newCall);
+    BuilderZ.setFastMathFlags(getFast());
+
+    if (gutils->isConstantInstruction(&call) ||
+        gutils->isConstantValue(orig(0))) {
+      if (Mode == DerivativeMode::ReverseModeGradient) {
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      } else {
+        eraseIfUnused(call);
+      }
+      return true;
+    }
+
+    Module &Mod = *gutils->newFunc->getParent();
+    auto &Ctx = call.getContext();
+    Type *PT = orig(0)->getType();
+    Type *T = PT->getPointerElementType();
+    Type *i64 = Type::getInt64Ty(Ctx);
+    Value *size =
+        ConstantInt::get(i64, Mod.getDataLayout().getTypeSizeInBits(T) / 8);
+    auto copy = [&](IRBuilder<> &B, Value *dst, Value *src, Value *n) {
+#if LLVM_VERSION_MAJOR >= 10
+      B.CreateMemCpy(dst, MaybeAlign(), src, MaybeAlign(),
+                     B.CreateMul(n, size));
+#else
+      B.CreateMemCpy(dst, 1, src, 1, B.CreateMul(n, size));
+#endif
+    };
+    auto memzero = [&](IRBuilder<> &B, Value *dst, Value *n) {
+#if LLVM_VERSION_MAJOR >= 10
+      B.CreateMemSet(dst, ConstantInt::get(Type::getInt8Ty(Ctx), 0),
+                     B.CreateMul(n, size), MaybeAlign());
+#else
+      B.CreateMemSet(dst, ConstantInt::get(Type::getInt8Ty(Ctx), 0),
+                     B.CreateMul(n, size), 1);
+#endif
+    };
+
+    // The step reads and writes shadows of x, and the remaining arguments
+    // have the activity they have at the call.
+    std::vector<DIFFE_TYPE> argTypes = {DIFFE_TYPE::DUP_ARG,
+                                        DIFFE_TYPE::DUP_ARG};
+    bool activeArgs = false;
+    for (unsigned i = 2; i < call.arg_size(); i++) {
+      auto ty = gutils->getDiffeType(orig(i), false);
+      if (ty == DIFFE_TYPE::DUP_NONEED)
+        ty = DIFFE_TYPE::DUP_ARG;
+      argTypes.push_back(ty);
+      activeArgs |= ty != DIFFE_TYPE::CONSTANT;
+    }
+
+    FnTypeInfo nextTypeInfo(step);
+    std::map<Argument *, bool> stepUncacheable;
+    for (auto &arg : step->args()) {
+      Value *op = orig(arg.getArgNo() < 2 ? 0 : arg.getArgNo());
+      nextTypeInfo.Arguments.insert(
+          std::pair<Argument *, TypeTree>(&arg, TR.query(op)));
+      nextTypeInfo.KnownValues.insert(std::pair<Argument *, std::set<int64_t>>(
+          &arg, TR.knownIntegralValues(op)));
+      stepUncacheable[&arg] = false;
+    }
+    nextTypeInfo.Return = TypeTree();
+
+    // Create the internal function iterating the derivative deriv of a step,
+    // which takes x at the fixed point, its shadow, its length, the remaining
+    // arguments and the shadows of those among them that are duplicated.
+    auto createIteration =
+        [&](Function *deriv, Type *RT,
+            function_ref<Value *(IRBuilder<> &, Value *, Value *, Value *,
+                                 ArrayRef<Value *>, ArrayRef<Value *>)>
+                Emit) {
+          std::string name = (deriv->getName() + "_fixed_point").str();
+          if (auto F = Mod.getFunction(name))
+            return F;
+          SmallVector<Type *, 8> types = {PT, PT, i64};
+          for (unsigned i = 2; i < call.arg_size(); i++)
+            types.push_back(orig(i)->getType());
+          for (unsigned i = 2; i < call.arg_size(); i++)
+            if (argTypes[i] == DIFFE_TYPE::DUP_ARG)
+              types.push_back(orig(i)->getType());
+          auto F = Function::Create(FunctionType::get(RT, types, false),
+                                    GlobalValue::InternalLinkage, name, &Mod);
+          IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+          SmallVector<Value *, 8> args;
+          for (auto &arg : F->args())
+            args.push_back(&arg);
+          args[0]->setName("x");
+          args[1]->setName("dx");
+          args[2]->setName("n");
+          unsigned nargs = call.arg_size() - 2;
+          Value *res = Emit(B, args[0], args[1], args[2],
+                            ArrayRef<Value *>(args).slice(3, nargs),
+                            ArrayRef<Value *>(args).drop_front(3 + nargs));
+          if (res)
+            B.CreateRet(res);
+          else
+            B.CreateRetVoid();
+          return F;
+        };
+    // The arguments of a derivative of the step given those of the
+    // iteration, with the remaining arguments constant unless active.
+    auto stepArgs = [&](Value *out, Value *dout, Value *in, Value *din,
+                        ArrayRef<Value *> rest, ArrayRef<Value *> shadows,
+                        bool active) {
+      SmallVector<Value *, 8> args = {out, dout, in, din};
+      auto shadow = shadows.begin();
+      for (auto tup : llvm::enumerate(rest)) {
+        args.push_back(tup.value());
+        if (argTypes[tup.index() + 2] == DIFFE_TYPE::DUP_ARG) {
+          if (active)
+            args.push_back(*shadow);
+          ++shadow;
+        }
+      }
+      return args;
+    };
+
+    if (Mode == DerivativeMode::ForwardMode) {
+      IRBuilder<> After(newCall->getNextNode());
+      After.setFastMathFlags(getFast());
+      Value *dx = gutils->invertPointerM(orig(0), After);
+      Value *n = gutils->getNewFromOriginal(orig(1));
+      if (!activeArgs) {
+        memzero(After, dx, n);
+        return true;
+      }
+      auto fwd = gutils->Logic.CreateForwardDiff(
+          step, DIFFE_TYPE::CONSTANT, argTypes, TR.analyzer.interprocedural,
+          /*returnValue*/ false, Mode, /*freeMemory*/ true, /*width*/ 1,
+          /*additionalArg*/ nullptr, nextTypeInfo, stepUncacheable,
+          /*augmented*/ nullptr);
+      auto W = createIteration(
+          fwd, Type::getVoidTy(Ctx),
+          [&](IRBuilder<> &B, Value *xs, Value *dx, Value *n,
+              ArrayRef<Value *> rest, ArrayRef<Value *> shadows) -> Value * {
+            Value *tmp =
+                B.CreatePointerCast(CreateAllocation(B, T, n, "tmp"), PT);
+            createFixedPointLoop(B, T, dx, nullptr, n,
+                                 [&](IRBuilder<> &B, Value *out) {
+                                   B.CreateCall(fwd, stepArgs(tmp, out, xs, dx,
+                                                              rest, shadows,
+                                                              true));
+                                 });
+            CreateDealloc(B, tmp);
+            return nullptr;
+          });
+      SmallVector<Value *, 8> args = {gutils->getNewFromOriginal(orig(0)), dx,
+                                      n};
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        args.push_back(gutils->getNewFromOriginal(orig(i)));
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        if (argTypes[i] == DIFFE_TYPE::DUP_ARG)
+          args.push_back(gutils->invertPointerM(orig(i), After));
+      auto CI = After.CreateCall(W, args);
+      CI->setDebugLoc(gutils->getNewFromOriginal(call.getDebugLoc()));
+      return true;
+    }
+
+    // x at the fixed point is copied if it may be overwritten after the call.
+    bool cacheX = activeArgs && uncacheable(0);
+    Value *xs = nullptr;
+    if ((Mode == DerivativeMode::ReverseModeCombined ||
+         Mode == DerivativeMode::ReverseModePrimal) &&
+        cacheX) {
+      IRBuilder<> After(newCall->getNextNode());
+      Value *n = gutils->getNewFromOriginal(orig(1));
+      xs = After.CreatePointerCast(CreateAllocation(After, T, n, "fixedpoint"),
+                                   PT);
+      copy(After, xs, gutils->getNewFromOriginal(orig(0)), n);
+      xs = gutils->cacheForReverse(After, xs, getIndex(&call, CacheType::Tape));
+    }
+
+    if (Mode == DerivativeMode::ReverseModePrimal) {
+      eraseIfUnused(call);
+      return true;
+    }
+
+    if (Mode == DerivativeMode::ReverseModeGradient && cacheX) {
+      xs = BuilderZ.CreatePHI(PT, 0, "fixedpoint");
+      xs = gutils->cacheForReverse(BuilderZ, xs,
+                                   getIndex(&call, CacheType::Tape));
+    }
+
+    IRBuilder<> Builder2(call.getParent());
+    getReverseBuilder(Builder2);
+    auto op = [&](unsigned i) {
+      return lookup(gutils->getNewFromOriginal(orig(i)), Builder2);
+    };
+    Value *dx = lookup(gutils->invertPointerM(orig(0), Builder2), Builder2);
+
+    if (!activeArgs) {
+      memzero(Builder2, dx, op(1));
+    } else {
+      xs = cacheX ? lookup(xs, Builder2) : op(0);
+      auto gradient = [&](ArrayRef<DIFFE_TYPE> constant_args) {
+        return gutils->Logic.CreatePrimalAndGradient(
+            (ReverseCacheKey){.todiff = step,
+                              .retType = DIFFE_TYPE::CONSTANT,
+                              .constant_args = constant_args,
+                              .uncacheable_args = stepUncacheable,
+                              .returnUsed = false,
+                              .shadowReturnUsed = false,
+                              .mode = DerivativeMode::ReverseModeCombined,
+                              .width = 1,
+                              .freeMemory = true,
+                              .AtomicAdd = false,
+                              .additionalType = nullptr,
+                              .typeInfo = nextTypeInfo},
+            TR.analyzer.interprocedural, /*augmented*/ nullptr);
+      };
+      std::vector<DIFFE_TYPE> iterTypes(argTypes.size(),
+                                        DIFFE_TYPE::CONSTANT);
+      iterTypes[0] = iterTypes[1] = DIFFE_TYPE::DUP_ARG;
+      auto iter = gradient(iterTypes);
+      auto full = gradient(argTypes);
+
+      auto W = createIteration(
+          full, full->getReturnType(),
+          [&](IRBuilder<> &B, Value *xs, Value *dx, Value *n,
+              ArrayRef<Value *> rest, ArrayRef<Value *> shadows) -> Value * {
+            Value *w = B.CreatePointerCast(CreateAllocation(B, T, n, "w"), PT);
+            Value *tmp =
+                B.CreatePointerCast(CreateAllocation(B, T, n, "tmp"), PT);
+            Value *dtmp =
+                B.CreatePointerCast(CreateAllocation(B, T, n, "dtmp"), PT);
+            copy(B, w, dx, n);
+            createFixedPointLoop(
+                B, T, w, dx, n, [&](IRBuilder<> &B, Value *out) {
+                  copy(B, dtmp, w, n);
+                  memzero(B, out, n);
+                  B.CreateCall(iter, stepArgs(tmp, dtmp, xs, out, rest,
+                                              shadows, false));
+                });
+            // The adjoint of x on entry, accumulated into w, is unused.
+            copy(B, dtmp, w, n);
+            Value *res = B.CreateCall(
+                full, stepArgs(tmp, dtmp, xs, w, rest, shadows, true));
+            memzero(B, dx, n);
+            for (auto ptr : {w, tmp, dtmp})
+              CreateDealloc(B, ptr);
+            return res->getType()->isVoidTy() ? nullptr : res;
+          });
+      SmallVector<Value *, 8> args = {xs, dx, op(1)};
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        args.push_back(op(i));
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        if (argTypes[i] == DIFFE_TYPE::DUP_ARG)
+          args.push_back(
+              lookup(gutils->invertPointerM(orig(i), Builder2), Builder2));
+      auto CI = Builder2.CreateCall(W, args);
+      CI->setDebugLoc(gutils->getNewFromOriginal(call.getDebugLoc()));
+
+      unsigned structidx = 0;
+      for (unsigned i = 2; i < call.arg_size(); i++)
+        if (argTypes[i] == DIFFE_TYPE::OUT_DIFF)
+          addToDiffe(orig(i), Builder2.CreateExtractValue(CI, {structidx++}),
+                     Builder2, orig(i)->getType());
+
+      if (cacheX && shouldFree())
+        CreateDealloc(Builder2, xs);
+    }
+
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+    } else {
+      eraseIfUnused(call);
+    }
+    return true;
+  }
+
+  /// Derivatives of a call to a function registered with
+  /// __enzyme_register_linear, with metadata md giving its adjoint and the
+  /// arguments that are parameters of the operator. Its tangent is the
+  /// function applied to the shadows of the other pointer arguments, and its
+  /// reverse pass the adjoint applied to them, such that nothing is cached.
+  /// Returns false if one of those is inactive, or if a parameter may be
+  /// overwritten before the reverse pass, as the call must then be
+  /// differentiated as usual.
+  bool handleLinearCall(CallInst &call, MDNode *md,
+                        const std::map<Argument *, bool> &uncacheable_args) {
+    Function *called = call.getCalledFunction();
+    if (Mode == DerivativeMode::ForwardModeSplit ||
+        gutils->isConstantInstruction(&call))
+      return false;
+    auto adjoint =
+        cast<Function>(cast<ValueAsMetadata>(md->getOperand(0))->getValue());
+    SmallSet<unsigned, 2> params;
+    for (auto &op : llvm::drop_begin(md->operands()))
+      params.insert(mdconst::extract<ConstantInt>(op)->getZExtValue());
+    auto uncacheable = [&](unsigned i) {
+      auto found = uncacheable_args.find(called->arg_begin() + i);
+      return found == uncacheable_args.end() || found->second;
+    };
+    // The parameters are read again by the adjoint in the reverse pass.
+    if (Mode != DerivativeMode::ForwardMode)
+      for (auto i : params)
+        if (i < call.arg_size() &&
+            call.getArgOperand(i)->getType()->isPointerTy() && uncacheable(i))
+          return false;
+    SmallVector<unsigned, 4> operands;
+    for (unsigned i = 0; i < call.arg_size(); i++) {
+      if (!call.getArgOperand(i)->getType()->isPointerTy() || params.count(i))
+        continue;
+      if (gutils->isConstantValue(call.getArgOperand(i)))
+        return false;
+      operands.push_back(i);
+    }
+
+    CallInst *const newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    IRBuilder<> BuilderZ(newCall);
+    BuilderZ.setFastMathFlags(getFast());
+
+    // Call the function F on the shadows of the operands, given in place of
+    // those in the arguments args of the call at Bld.
+    auto callOnShadows = [&](IRBuilder<> &Bld, Function *F,
+                             SmallVectorImpl<Value *> &args) {
+      SmallVector<Value *, 4> shadows;
+      for (auto i : operands)
+        shadows.push_back(args[i]);
+      for (unsigned j = 0; j < gutils->getWidth(); j++) {
+        for (auto tup : llvm::zip(operands, shadows))
+          args[std::get<0>(tup)] =
+              gutils->getWidth() > 1
+                  ? GradientUtils::extractMeta(Bld, std::get<1>(tup), j)
+                  : std::get<1>(tup);
+        auto cal = Bld.CreateCall(F, args);
+        cal->setCallingConv(F->getCallingConv());
+        cal->setDebugLoc(gutils->getNewFromOriginal(call.getDebugLoc()));
+      }
+    };
+
+    if (Mode == DerivativeMode::ForwardMode) {
+      SmallVector<Value *, 4> args;
+      for (unsigned i = 0; i < call.arg_size(); i++)
+        args.push_back(gutils->getNewFromOriginal(call.getArgOperand(i)));
+      for (auto i : operands)
+        args[i] = gutils->invertPointerM(call.getArgOperand(i), BuilderZ);
+      callOnShadows(BuilderZ, called, args);
+      return true;
+    }
+
+    if (Mode == DerivativeMode::ReverseModeCombined ||
+        Mode == DerivativeMode::ReverseModeGradient) {
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      SmallVector<Value *, 4> args;
+      for (unsigned i = 0; i < call.arg_size(); i++)
+        args.push_back(lookup(
+            gutils->getNewFromOriginal(call.getArgOperand(i)), Builder2));
+      for (auto i : operands)
+        args[i] = lookup(
+            gutils->invertPointerM(call.getArgOperand(i), Builder2), Builder2);
+      callOnShadows(Builder2, adjoint, args);
+    }
+
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+    } else {
+      eraseIfUnused(call);
     }
-  knownF:;
-    unsigned start = 0;
-    while (1) {
-      unsigned nextStart = size;
+    return true;
+  }
 
-      auto dt = vd[{-1}];
-      for (size_t i = start; i < size; ++i) {
-        bool Legal = true;
-        dt.checkedOrIn(vd[{(int)i}], /*PointerIntSame*/ true, Legal);
-        if (!Legal) {
-          nextStart = i;
-          break;
-        }
-      }
-      if (!dt.isKnown()) {
-        TR.dump();
-        llvm::errs() << " vd:" << vd.str() << " start:" << start
-                     << " size: " << size << " dt:" << dt.str() << "\n";
+  /// Derivatives of the matrix product kernel of getOrInsertMatmul,
+  /// C = beta C + A B, as further products: the tangent of C is
+  /// beta dC + dA B + A dB, whereas in reverse the adjoints of A and B are
+  /// increased by dC B^T and A^T dC, after which that of C is scaled by beta.
+  bool handleMatmul(CallInst &call,
+                    const std::map<Argument *, bool> &uncacheable_args) {
+    Function *called = call.getCalledFunction();
+    if (Mode == DerivativeMode::ForwardModeSplit)
+      return false;
+    auto orig = [&](unsigned i) { return call.getArgOperand(i); };
+    enum { M = 0, N, K, A, sam, sak, B, sbk, sbn, C, scm, scn, beta };
+
+    CallInst *const newCall = cast<CallInst>(gutils->getNewFromOriginal(&call));
+    IRBuilder<> BuilderZ(newCall);
+    BuilderZ.setFastMathFlags(getFast());
+
+    if (gutils->isConstantInstruction(&call) ||
+        gutils->isConstantValue(orig(C))) {
+      if (Mode == DerivativeMode::ReverseModeGradient) {
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      } else {
+        eraseIfUnused(call);
       }
-      assert(dt.isKnown());
+      return true;
+    }
 
-      Value *length = len_arg;
-      if (nextStart != size) {
-        length = ConstantInt::get(len_arg->getType(), nextStart);
+    Module &Mod = *gutils->newFunc->getParent();
+    Type *fpType = orig(A)->getType()->getPointerElementType();
+    Type *fpPtrTy = orig(A)->getType();
+    Type *i64 = Type::getInt64Ty(call.getContext());
+    Function *matmul = getOrInsertMatmul(Mod, fpType);
+    Value *zero = ConstantInt::get(i64, 0);
+    Value *one = ConstantInt::get(i64, 1);
+    bool activeA = !gutils->isConstantValue(orig(A));
+    bool activeB = !gutils->isConstantValue(orig(B));
+
+    if (Mode == DerivativeMode::ForwardMode) {
+      auto op = [&](unsigned i) { return gutils->getNewFromOriginal(orig(i)); };
+      auto rule = [&](Value *dA, Value *dB, Value *dC) {
+        // Without active factors the tangent is only scaled.
+        Value *scale = op(beta);
+        auto product = [&](Value *K, Value *X, Value *Y) {
+          Value *args[] = {op(M), op(N),   K,       X,     op(sam),
+                           op(sak), Y,     op(sbk), op(sbn), dC,
+                           op(scm), op(scn), scale};
+          BuilderZ.CreateCall(matmul, args);
+          scale = one;
+        };
+        if (dA)
+          product(op(K), dA, op(B));
+        if (dB)
+          product(op(K), op(A), dB);
+        if (!dA && !dB)
+          product(zero, dC, dC);
+      };
+      auto shadow = [&](bool active, unsigned i) {
+        return active ? gutils->invertPointerM(orig(i), BuilderZ) : nullptr;
+      };
+      applyChainRule(BuilderZ, rule, shadow(activeA, A), shadow(activeB, B),
+                     gutils->invertPointerM(orig(C), BuilderZ));
+      return true;
+    }
+
+    // The factors needed by the reverse pass are packed into contiguous
+    // column-major copies if they may be overwritten after the call.
+    auto uncacheable = [&](unsigned i) {
+      auto found = uncacheable_args.find(called->arg_begin() + i);
+      return found == uncacheable_args.end() || found->second;
+    };
+    bool cacheA = activeB && uncacheable(A);
+    bool cacheB = activeA && uncacheable(B);
+    Type *cachetype = nullptr;
+    if (cacheA && cacheB)
+      cachetype = StructType::get(call.getContext(), {fpPtrTy, fpPtrTy});
+    else if (cacheA || cacheB)
+      cachetype = fpPtrTy;
+
+    Value *cacheval = nullptr;
+    if ((Mode == DerivativeMode::ReverseModeCombined ||
+         Mode == DerivativeMode::ReverseModePrimal) &&
+        cachetype) {
+      auto op = [&](unsigned i) { return gutils->getNewFromOriginal(orig(i)); };
+      auto pack = [&](unsigned X, unsigned rows, unsigned cols, unsigned sr,
+                      unsigned sc) {
+        Value *copy = BuilderZ.CreatePointerCast(
+            CreateAllocation(BuilderZ, fpType,
+                             BuilderZ.CreateMul(op(rows), op(cols))),
+            fpPtrTy);
+        Value *args[] = {op(rows), op(cols), op(X), op(sr), op(sc), copy};
+        BuilderZ.CreateCall(getOrInsertMatmulPack(Mod, fpType), args);
+        return copy;
+      };
+      SmallVector<Value *, 2> copies;
+      if (cacheA)
+        copies.push_back(pack(A, M, K, sam, sak));
+      if (cacheB)
+        copies.push_back(pack(B, K, N, sbk, sbn));
+      if (copies.size() == 1)
+        cacheval = copies[0];
+      else {
+        cacheval = UndefValue::get(cachetype);
+        for (auto tup : llvm::enumerate(copies))
+          cacheval =
+              BuilderZ.CreateInsertValue(cacheval, tup.value(), tup.index());
       }
-      if (start != 0)
-        length = Builder2.CreateSub(
-            length, ConstantInt::get(len_arg->getType(), start));
+      gutils->cacheForReverse(BuilderZ, cacheval,
+                              getIndex(&call, CacheType::Tape));
+    }
 
-      if (auto secretty = dt.isFloat()) {
-        auto offset = start;
-        if (dsto->getType()->isIntegerTy())
-          dsto = Builder2.CreateIntToPtr(
-              dsto, Type::getInt8PtrTy(dsto->getContext()));
-        unsigned dstaddr =
-            cast<PointerType>(dsto->getType())->getAddressSpace();
-        auto secretpt = PointerType::get(secretty, dstaddr);
-        if (offset != 0) {
-#if LLVM_VERSION_MAJOR > 7
-          dsto = Builder2.CreateConstInBoundsGEP1_64(
-              dsto->getType()->getPointerElementType(), dsto, offset);
-#else
-          dsto = Builder2.CreateConstInBoundsGEP1_64(dsto, offset);
-#endif
-        }
-        if (srco->getType()->isIntegerTy())
-          srco = Builder2.CreateIntToPtr(
-              srco, Type::getInt8PtrTy(dsto->getContext()));
-        unsigned srcaddr =
-            cast<PointerType>(srco->getType())->getAddressSpace();
-        secretpt = PointerType::get(secretty, srcaddr);
+    if (Mode == DerivativeMode::ReverseModePrimal) {
+      eraseIfUnused(call);
+      return true;
+    }
 
-        if (offset != 0) {
-#if LLVM_VERSION_MAJOR > 7
-          srco = Builder2.CreateConstInBoundsGEP1_64(
-              srco->getType()->getPointerElementType(), srco, offset);
-#else
-          srco = Builder2.CreateConstInBoundsGEP1_64(srco, offset);
-#endif
-        }
-        Value *args[3] = {
-            Builder2.CreatePointerCast(dsto, secretpt),
-            Builder2.CreatePointerCast(srco, secretpt),
-            Builder2.CreateUDiv(
-                length,
+    IRBuilder<> Builder2(call.getParent());
+    getReverseBuilder(Builder2);
 
-                ConstantInt::get(length->getType(),
-                                 Builder2.GetInsertBlock()
-                                         ->getParent()
-                                         ->getParent()
-                                         ->getDataLayout()
-                                         .getTypeAllocSizeInBits(secretty) /
-                                     8))};
+    if (cachetype) {
+      if (Mode != DerivativeMode::ReverseModeCombined)
+        cacheval = BuilderZ.CreatePHI(cachetype, 0);
+      cacheval = gutils->cacheForReverse(BuilderZ, cacheval,
+                                         getIndex(&call, CacheType::Tape));
+      cacheval = lookup(cacheval, Builder2);
+    }
 
-        auto dmemcpy = getOrInsertDifferentialFloatMemcpy(
-            *Builder2.GetInsertBlock()->getParent()->getParent(), secretty,
-            /*dstalign*/ 1, /*srcalign*/ 1, dstaddr, srcaddr);
+    auto op = [&](unsigned i) {
+      return lookup(gutils->getNewFromOriginal(orig(i)), Builder2);
+    };
+    Value *size = ConstantInt::get(
+        i64, Mod.getDataLayout().getTypeSizeInBits(fpType) / 8);
+    // The factors as read by the reverse pass, with their strides.
+    SmallVector<Value *, 2> toFree;
+    Value *primalA = op(A), *strideAM = op(sam), *strideAK = op(sak);
+    Value *primalB = op(B), *strideBK = op(sbk), *strideBN = op(sbn);
+    if (cacheA) {
+      primalA = cacheB ? Builder2.CreateExtractValue(cacheval, {0}) : cacheval;
+      strideAM = size;
+      strideAK = Builder2.CreateMul(op(M), size);
+      toFree.push_back(primalA);
+    }
+    if (cacheB) {
+      primalB = cacheA ? Builder2.CreateExtractValue(cacheval, {1}) : cacheval;
+      strideBK = size;
+      strideBN = Builder2.CreateMul(op(K), size);
+      toFree.push_back(primalB);
+    }
 
-        Builder2.CreateCall(dmemcpy, args, ReverseDefs);
+    auto rule = [&](Value *dA, Value *dB, Value *dC) {
+      if (dA) {
+        Value *args[] = {op(M),    op(K),    op(N),   dC,      op(scm),
+                         op(scn),  primalB,  strideBN, strideBK, dA,
+                         op(sam),  op(sak),  one};
+        Builder2.CreateCall(matmul, args);
+      }
+      if (dB) {
+        Value *args[] = {op(K),    op(N),   op(M),   primalA, strideAK,
+                         strideAM, dC,      op(scm), op(scn), dB,
+                         op(sbk),  op(sbn), one};
+        Builder2.CreateCall(matmul, args);
       }
+      // Scaling dC by beta, which unless it is one clears it.
+      auto constBeta = dyn_cast<ConstantInt>(orig(beta));
+      if (!constBeta || !constBeta->isOne()) {
+        Value *args[] = {op(M),   op(N), zero, dC,      zero,    zero, dC,
+                         zero,    zero,  dC,   op(scm), op(scn), op(beta)};
+        Builder2.CreateCall(matmul, args);
+      }
+    };
+    auto shadow = [&](bool active, unsigned i) {
+      return active ? lookup(gutils->invertPointerM(orig(i), Builder2),
+                             Builder2)
+                    : nullptr;
+    };
+    applyChainRule(Builder2, rule, shadow(activeA, A), shadow(activeB, B),
+                   shadow(true, C));
+
+    if (shouldFree())
+      for (auto copy : toFree)
+        CreateDealloc(Builder2, copy);
 
-      if (nextStart == size)
-        break;
-      start = nextStart;
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+    } else {
+      eraseIfUnused(call);
     }
+    return true;
   }
 
   std::string extractBLAS(StringRef in, std::string &prefix,
                           std::string &suffix) {
-    std::string extractable[] = {"ddot", "sdot", "dnrm2", "snrm2"};
+    std::string extractable[] = {"ddot",  "sdot",  "dnrm2", "snrm2",
+                                 "daxpy", "saxpy", "dscal", "sscal",
+                                 "dgemv", "sgemv", "dgemm", "sgemm",
+                                 "dsyrk", "ssyrk", "dtrsm", "strsm",
+                                 "dpotrf", "spotrf", "dpotrs", "spotrs",
+                                 "dgetrf", "sgetrf", "dgetrs", "sgetrs",
+                                 "dgesv",  "sgesv",  "dsyev",  "ssyev"};
     std::string prefixes[] = {"", "cblas_", "cublas_"};
     std::string suffixes[] = {"", "_", "_64_"};
     for (auto ex : extractable) {
@@ -5715,6 +9064,16 @@ public:
     IRBuilder<> allocationBuilder(gutils->inversionAllocs);
     allocationBuilder.setFastMathFlags(getFast());
 
+    StringRef routine = funcName.drop_front(1);
+    if (routine == "potrf" || routine == "potrs" || routine == "getrf" ||
+        routine == "getrs" || routine == "gesv" || routine == "syev")
+      return handleLAPACK(call, funcName, prefix, suffix, uncacheable_args);
+
+    if (funcName != "ddot" && funcName != "sdot" && funcName != "dnrm2" &&
+        funcName != "snrm2")
+      return handleBLASKernel(call, funcName, prefix, suffix,
+                              uncacheable_args);
+
     if (funcName == "dnrm2" || funcName == "snrm2") {
       if (!gutils->isConstantInstruction(&call)) {
 
@@ -6418,6 +9777,393 @@ public:
     return false;
   }
 
+  /// Returns whether the MPI_Op is a (OpenMPI or MPICH) sum.
+  static bool isMPISumOp(Value *op) {
+    if (Constant *C = dyn_cast<Constant>(op)) {
+      while (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+        C = CE->getOperand(0);
+      }
+      if (auto GV = dyn_cast<GlobalVariable>(C)) {
+        if (GV->getName() == "ompi_mpi_op_sum") {
+          return true;
+        }
+      }
+      // MPICH
+      if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
+        if (CI->getValue() == 1476395011) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /// Shadow of an MPI buffer operand, usable at the builder's position.
+  Value *getMPIShadowBuffer(Value *orig, IRBuilder<> &Builder2) {
+    Value *shadow = gutils->invertPointerM(orig, Builder2);
+    if (Mode != DerivativeMode::ForwardMode)
+      shadow = lookup(shadow, Builder2);
+    if (shadow->getType()->isIntegerTy())
+      shadow = Builder2.CreateIntToPtr(shadow,
+                                       Type::getInt8PtrTy(orig->getContext()));
+    return shadow;
+  }
+
+  /// Primal MPI operand, usable at the builder's position.
+  Value *getMPIOperand(Value *orig, IRBuilder<> &Builder2) {
+    Value *val = gutils->getNewFromOriginal(orig);
+    if (Mode != DerivativeMode::ForwardMode)
+      val = lookup(val, Builder2);
+    return val;
+  }
+
+  /// Number of bytes held by count elements of tysize bytes each.
+  Value *getMPIByteLength(Value *count, Value *tysize, IRBuilder<> &Builder2) {
+    Type *i64 = Type::getInt64Ty(count->getContext());
+    return Builder2.CreateMul(Builder2.CreateZExtOrTrunc(count, i64),
+                              Builder2.CreateZExtOrTrunc(tysize, i64), "",
+                              true, true);
+  }
+
+  /// Emit a call to the MPI function name, declared from the argument types.
+  CallInst *createMPICall(CallInst &call, StringRef name,
+                          ArrayRef<Value *> args, IRBuilder<> &Builder2,
+                          ArrayRef<OperandBundleDef> Defs) {
+    SmallVector<Type *, 12> types;
+    for (auto arg : args)
+      types.push_back(arg->getType());
+    FunctionType *FT = FunctionType::get(call.getType(), types, false);
+    return Builder2.CreateCall(
+        gutils->newFunc->getParent()->getOrInsertFunction(name, FT), args,
+        Defs);
+  }
+
+  /// Zero len bytes of the MPI buffer buf.
+  void zeroMPIBuffer(Value *buf, Value *len, IRBuilder<> &Builder2,
+                     ArrayRef<OperandBundleDef> Defs) {
+    auto val_arg = ConstantInt::get(Type::getInt8Ty(buf->getContext()), 0);
+    auto volatile_arg = ConstantInt::getFalse(buf->getContext());
+    Value *args[] = {buf, val_arg, len, volatile_arg};
+    Type *tys[] = {args[0]->getType(), args[2]->getType()};
+    auto memset = cast<CallInst>(Builder2.CreateCall(
+        Intrinsic::getDeclaration(gutils->newFunc->getParent(),
+                                  Intrinsic::memset, tys),
+        args, Defs));
+    memset->addParamAttr(0, Attribute::NonNull);
+  }
+
+  /// Type of an MPI_Status, from the module's declarations of the calls which
+  /// return one. A status passed as a byte pointer says nothing of its size.
+  Type *getMPIStatusType(Module &M) {
+    for (auto name : {"MPI_Recv", "PMPI_Recv", "MPI_Wait", "PMPI_Wait"})
+      if (Function *F = M.getFunction(name)) {
+        auto statusArg = F->arg_end();
+        statusArg--;
+        if (auto PT = dyn_cast<PointerType>(statusArg->getType()))
+          if (isa<StructType>(PT->getPointerElementType()) &&
+              PT->getPointerElementType()->isSized())
+            return PT->getPointerElementType();
+      }
+    llvm::errs() << " warning could not automatically determine mpi "
+                    "status type, assuming [24 x i8]\n";
+    return ArrayType::get(Type::getInt8Ty(M.getContext()), 24);
+  }
+
+  /// Type of an MPI_Request, from the module's declarations of the
+  /// nonblocking calls, defaulting to a pointer as in OpenMPI.
+  Type *getMPIRequestType(Module &M) {
+    for (auto name : {"MPI_Wait", "PMPI_Wait"})
+      if (Function *F = M.getFunction(name))
+        if (auto PT = dyn_cast<PointerType>(F->arg_begin()->getType()))
+          if (PT->getPointerElementType()->isSized())
+            return PT->getPointerElementType();
+    for (auto name : {"MPI_Isend", "PMPI_Isend", "MPI_Irecv", "PMPI_Irecv"})
+      if (Function *F = M.getFunction(name)) {
+        auto reqArg = F->arg_end();
+        reqArg--;
+        if (auto PT = dyn_cast<PointerType>(reqArg->getType()))
+          if (PT->getPointerElementType()->isSized())
+            return PT->getPointerElementType();
+      }
+    return Type::getInt8PtrTy(M.getContext());
+  }
+
+  /// Completion of an adjoint MPI communication posted as a nonblocking call
+  /// (see EnzymeMPIOverlap). It is emitted into the reverse of block just
+  /// before the adjoint of consumer, or at the end of it if consumer is null.
+  struct DeferredMPICompletion {
+    BasicBlock *block;
+    Instruction *consumer;
+    std::function<void(IRBuilder<> &)> complete;
+  };
+  SmallVector<DeferredMPICompletion, 2> deferredMPICompletions;
+
+  /// The instruction preceding call in its block whose adjoint may access
+  /// the shadows of bufs, or null if there is none.
+  Instruction *findMPIAdjointConsumer(CallInst &call, ArrayRef<Value *> bufs) {
+    auto &AA = gutils->OrigAA;
+    auto mayAccess = [&](Instruction *J, Value *buf) {
+      if (!buf->getType()->isPointerTy())
+        return J->mayReadOrWriteMemory();
+#if LLVM_VERSION_MAJOR >= 12
+      auto obj = getUnderlyingObject(buf, 100);
+#else
+      auto obj = GetUnderlyingObject(
+          buf, gutils->oldFunc->getParent()->getDataLayout(), 100);
+#endif
+      if (obj == J)
+        return true;
+      if (!J->mayReadOrWriteMemory())
+        return false;
+      // The MPI calls only access memory through their pointer arguments,
+      // which the declarations need not say.
+      if (auto CI = dyn_cast<CallInst>(J)) {
+        auto name = getFuncNameFromCall(CI);
+        if (name.startswith("MPI_") || name.startswith("PMPI_")) {
+          for (auto &arg : CI->args())
+            if (arg->getType()->isPointerTy() &&
+                !AA.isNoAlias(arg, buf))
+              return true;
+          return false;
+        }
+      }
+#if LLVM_VERSION_MAJOR >= 12
+      auto AARes = AA.getModRefInfo(
+          J, MemoryLocation(buf, LocationSize::beforeOrAfterPointer()));
+#elif LLVM_VERSION_MAJOR >= 9
+      auto AARes =
+          AA.getModRefInfo(J, MemoryLocation(buf, LocationSize::unknown()));
+#else
+      auto AARes = AA.getModRefInfo(
+          J, MemoryLocation(buf, MemoryLocation::UnknownSize));
+#endif
+      return isModOrRefSet(AARes);
+    };
+    for (Instruction *J = call.getPrevNode(); J; J = J->getPrevNode())
+      for (auto buf : bufs)
+        if (mayAccess(J, buf))
+          return J;
+    return nullptr;
+  }
+
+  /// Defer complete, the completion of the nonblocking adjoint communication
+  /// of call on the shadows of bufs, to the latest point in the reverse of
+  /// call's block that precedes any other adjoint access to those shadows.
+  void deferMPICompletion(CallInst &call, ArrayRef<Value *> bufs,
+                          std::function<void(IRBuilder<> &)> complete) {
+    deferredMPICompletions.push_back(DeferredMPICompletion{
+        call.getParent(), findMPIAdjointConsumer(call, bufs), complete});
+  }
+
+  /// Emit the deferred MPI completions which must precede the adjoint of I in
+  /// the reverse of BB, or all of those remaining for BB if I is null.
+  void completeDeferredMPI(BasicBlock *BB, Instruction *I) {
+    for (size_t i = 0; i < deferredMPICompletions.size();) {
+      auto &D = deferredMPICompletions[i];
+      if (D.block != BB || (I && D.consumer != I)) {
+        i++;
+        continue;
+      }
+      auto complete = D.complete;
+      deferredMPICompletions.erase(deferredMPICompletions.begin() + i);
+      IRBuilder<> Builder2(BB);
+      getReverseBuilder(Builder2);
+      complete(Builder2);
+    }
+  }
+
+  /// Storage for the request of an adjoint nonblocking MPI call.
+  Value *createMPIRequest(CallInst &call) {
+    return IRBuilder<>(gutils->inversionAllocs)
+        .CreateAlloca(getMPIRequestType(*call.getModule()), nullptr,
+                      "mpi_adjoint_req");
+  }
+
+  /// Wait for the adjoint nonblocking MPI call with request req.
+  void waitMPIRequest(CallInst &call, Value *req, IRBuilder<> &Builder2) {
+    Value *status = IRBuilder<>(gutils->inversionAllocs)
+                        .CreateAlloca(getMPIStatusType(*call.getModule()));
+    auto fcall = createMPICall(call, "MPI_Wait", {req, status}, Builder2, {});
+    fcall->setCallingConv(call.getCallingConv());
+  }
+
+  /// Forward mode of a linear MPI collective is the same collective on the
+  /// shadows of the buffer operands.
+  void forwardMPIShadowCall(CallInst &call, ArrayRef<unsigned> buffers) {
+    IRBuilder<> Builder2(&call);
+    getForwardBuilder(Builder2);
+
+    SmallVector<Value *, 12> args;
+    SmallVector<ValueType, 12> types;
+    for (unsigned i = 0; i < call.arg_size(); i++) {
+      if (llvm::is_contained(buffers, i)) {
+        Value *shadow = gutils->invertPointerM(call.getArgOperand(i), Builder2);
+        args.push_back(shadow);
+        types.push_back(ValueType::Shadow);
+      } else {
+        args.push_back(gutils->getNewFromOriginal(call.getArgOperand(i)));
+        types.push_back(ValueType::Primal);
+      }
+    }
+
+    auto Defs =
+        gutils->getInvertedBundles(&call, types, Builder2, /*lookup*/ false);
+
+#if LLVM_VERSION_MAJOR >= 11
+    auto callval = call.getCalledOperand();
+#else
+    auto callval = call.getCalledValue();
+#endif
+
+#if LLVM_VERSION_MAJOR > 7
+    Builder2.CreateCall(call.getFunctionType(), callval, args, Defs);
+#else
+    Builder2.CreateCall(callval, args, Defs);
+#endif
+  }
+
+  /// Save the (counts, displs) array pairs of a vector MPI collective in the
+  /// forward pass, and return the cache at Builder2 in the reverse pass (null
+  /// if there is none). Each pair occupies one block laid out as by
+  /// getOrInsertMPIVectorCountsSave, with one entry per rank of the
+  /// communicator, or none off the root for rooted collectives.
+  Value *cacheMPIVectorCounts(CallInst &call, IRBuilder<> &BuilderZ,
+                              IRBuilder<> *Builder2,
+                              ArrayRef<std::pair<Value *, Value *>> arrays,
+                              Value *orig_comm, Value *orig_root = nullptr) {
+    Type *intTy = call.getType();
+    Type *intPtrTy = PointerType::getUnqual(intTy);
+    Value *cache = nullptr;
+    if (Mode == DerivativeMode::ReverseModePrimal ||
+        Mode == DerivativeMode::ReverseModeCombined) {
+      auto i64 = Type::getInt64Ty(call.getContext());
+      Value *comm = gutils->getNewFromOriginal(orig_comm);
+      Value *n = MPI_COMM_SIZE(comm, BuilderZ, intTy);
+      if (orig_root) {
+        Value *root = gutils->getNewFromOriginal(orig_root);
+        n = BuilderZ.CreateSelect(
+            BuilderZ.CreateICmpEQ(MPI_COMM_RANK(comm, BuilderZ, root->getType()),
+                                  root),
+            n, ConstantInt::get(intTy, 0));
+      }
+      Value *blockLen = BuilderZ.CreateAdd(
+          BuilderZ.CreateMul(BuilderZ.CreateZExtOrTrunc(n, i64),
+                             ConstantInt::get(i64, 3)),
+          ConstantInt::get(i64, 2));
+      cache = CreateAllocation(
+          BuilderZ, intTy,
+          BuilderZ.CreateMul(blockLen, ConstantInt::get(i64, arrays.size())),
+          "mpicounts_malloccache");
+      BuilderZ.SetInsertPoint(gutils->getNewFromOriginal(&call));
+      Function *save = getOrInsertMPIVectorCountsSave(
+          *gutils->newFunc->getParent(), intTy);
+      for (size_t i = 0; i < arrays.size(); i++) {
+        Value *counts = gutils->getNewFromOriginal(arrays[i].first);
+        Value *displs =
+            arrays[i].second ? gutils->getNewFromOriginal(arrays[i].second)
+                             : ConstantPointerNull::get(cast<PointerType>(
+                                   intPtrTy));
+        if (counts->getType()->isIntegerTy())
+          counts = BuilderZ.CreateIntToPtr(counts, intPtrTy);
+        if (displs->getType()->isIntegerTy())
+          displs = BuilderZ.CreateIntToPtr(displs, intPtrTy);
+#if LLVM_VERSION_MAJOR > 7
+        Value *block = BuilderZ.CreateInBoundsGEP(
+            intTy, cache, BuilderZ.CreateMul(blockLen, ConstantInt::get(i64, i)));
+#else
+        Value *block = BuilderZ.CreateInBoundsGEP(
+            cache, BuilderZ.CreateMul(blockLen, ConstantInt::get(i64, i)));
+#endif
+        Value *args[] = {block, BuilderZ.CreatePointerCast(counts, intPtrTy),
+                         BuilderZ.CreatePointerCast(displs, intPtrTy),
+                         BuilderZ.CreateZExtOrTrunc(n, intTy)};
+        BuilderZ.CreateCall(save, args);
+      }
+      if (auto I = dyn_cast<Instruction>(cache))
+        gutils->TapesToPreventRecomputation.insert(I);
+      cache = gutils->cacheForReverse(BuilderZ, cache,
+                                      getIndex(&call, CacheType::Tape));
+    }
+    if (!Builder2)
+      return nullptr;
+    if (Mode == DerivativeMode::ReverseModeGradient) {
+      cache = BuilderZ.CreatePHI(intPtrTy, 0);
+      cache = gutils->cacheForReverse(BuilderZ, cache,
+                                      getIndex(&call, CacheType::Tape));
+    }
+    assert(cache);
+    return lookup(cache, *Builder2);
+  }
+
+  /// Pointer to a field of the given block of a cacheMPIVectorCounts cache:
+  /// 0 for the block itself, 1 for the total count, 2 for counts, 3 for
+  /// displs and 4 for the contiguous displacements.
+  Value *getMPIVectorCountsPtr(Type *intTy, Value *cache, unsigned block,
+                               unsigned field, IRBuilder<> &Builder2) {
+    Type *i64 = Type::getInt64Ty(cache->getContext());
+#if LLVM_VERSION_MAJOR > 7
+    Value *n = Builder2.CreateLoad(intTy, cache);
+#else
+    Value *n = Builder2.CreateLoad(cache);
+#endif
+    n = Builder2.CreateZExt(n, i64);
+    // [n, total, counts[n], displs[n], packed[n]]
+    Value *blockLen =
+        Builder2.CreateAdd(Builder2.CreateMul(n, ConstantInt::get(i64, 3)),
+                           ConstantInt::get(i64, 2));
+    Value *idx = Builder2.CreateMul(blockLen, ConstantInt::get(i64, block));
+    if (field <= 1)
+      idx = Builder2.CreateAdd(idx, ConstantInt::get(i64, field));
+    else
+      idx = Builder2.CreateAdd(
+          idx, Builder2.CreateAdd(Builder2.CreateMul(
+                                      n, ConstantInt::get(i64, field - 2)),
+                                  ConstantInt::get(i64, 2)));
+#if LLVM_VERSION_MAJOR > 7
+    return Builder2.CreateInBoundsGEP(intTy, cache, idx);
+#else
+    return Builder2.CreateInBoundsGEP(cache, idx);
+#endif
+  }
+
+  /// Total count of the given block of a cacheMPIVectorCounts cache.
+  Value *getMPIVectorTotal(Type *intTy, Value *cache, unsigned block,
+                           IRBuilder<> &Builder2) {
+    Value *ptr = getMPIVectorCountsPtr(intTy, cache, block, 1, Builder2);
+#if LLVM_VERSION_MAJOR > 7
+    return Builder2.CreateLoad(intTy, ptr);
+#else
+    return Builder2.CreateLoad(ptr);
+#endif
+  }
+
+  /// Pack the segments of the displaced shadow buffer described by a block of
+  /// a cacheMPIVectorCounts cache into packed, zeroing them. If accumulate is
+  /// set, add the packed segments into the displaced ones instead.
+  void moveMPISegments(CallInst &call, Value *orig_buf, Value *packed,
+                       Value *displaced, Value *cache, unsigned block,
+                       Value *tysize, bool accumulate, IRBuilder<> &Builder2,
+                       ArrayRef<OperandBundleDef> Defs) {
+    Type *elementType = nullptr;
+    if (accumulate) {
+      ConcreteType CT = TR.firstPointer(1, orig_buf, &call);
+      elementType = CT.isFloat();
+      // Integer data carries no derivative.
+      if (!elementType)
+        return;
+    }
+    Type *intTy = call.getType();
+    Function *F = getOrInsertMPIVectorSegments(*gutils->newFunc->getParent(),
+                                               intTy, elementType);
+    Type *i8p = Type::getInt8PtrTy(call.getContext());
+    Value *args[] = {
+        Builder2.CreatePointerCast(packed, i8p),
+        Builder2.CreatePointerCast(displaced, i8p),
+        getMPIVectorCountsPtr(intTy, cache, block, 0, Builder2),
+        Builder2.CreateZExtOrTrunc(tysize, intTy)};
+    Builder2.CreateCall(F, args, Defs);
+  }
+
   void handleMPI(llvm::CallInst &call, Function *called, StringRef funcName) {
     assert(called);
     assert(gutils->getWidth() == 1);
@@ -7177,25 +10923,6 @@ public:
           shadow = Builder2.CreateIntToPtr(
               shadow, Type::getInt8PtrTy(call.getContext()));
 
-        Type *statusType = nullptr;
-        if (Function *recvfn = called->getParent()->getFunction("MPI_Recv")) {
-          auto statusArg = recvfn->arg_end();
-          statusArg--;
-          if (auto PT = dyn_cast<PointerType>(statusArg->getType()))
-            statusType = PT->getPointerElementType();
-        } else if (Function *recvfn =
-                       called->getParent()->getFunction("PMPI_Recv")) {
-          auto statusArg = recvfn->arg_end();
-          statusArg--;
-          if (auto PT = dyn_cast<PointerType>(statusArg->getType()))
-            statusType = PT->getPointerElementType();
-        }
-        if (statusType == nullptr) {
-          statusType = ArrayType::get(Type::getInt8Ty(call.getContext()), 24);
-          llvm::errs() << " warning could not automatically determine mpi "
-                          "status type, assuming [24 x i8]\n";
-        }
-
         Value *count = gutils->getNewFromOriginal(call.getOperand(1));
         if (!forwardMode)
           count = lookup(count, Builder2);
@@ -7246,20 +10973,15 @@ public:
           return;
         }
 
-        Value *args[] = {
-            /*buf*/ NULL,
-            /*count*/ count,
-            /*datatype*/ datatype,
-            /*src*/ src,
-            /*tag*/ tag,
-            /*comm*/ comm,
-            /*status*/
-            IRBuilder<>(gutils->inversionAllocs).CreateAlloca(statusType)};
+        Value *status = nullptr;
+        if (!EnzymeMPIOverlap)
+          status = IRBuilder<>(gutils->inversionAllocs)
+                       .CreateAlloca(getMPIStatusType(*call.getModule()));
 
         Value *tysize = MPI_TYPE_SIZE(datatype, Builder2, call.getType());
 
-        auto len_arg = Builder2.CreateZExtOrTrunc(
-            args[1], Type::getInt64Ty(call.getContext()));
+        Value *len_arg = Builder2.CreateZExtOrTrunc(
+            count, Type::getInt64Ty(call.getContext()));
         len_arg =
             Builder2.CreateMul(len_arg,
                                Builder2.CreateZExtOrTrunc(
@@ -7269,15 +10991,59 @@ public:
         Value *firstallocation =
             CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
                              len_arg, "mpirecv_malloccache");
-        args[0] = firstallocation;
+
+        Builder2.SetInsertPoint(Builder2.GetInsertBlock());
+
+        if (EnzymeMPIOverlap) {
+          Value *req = createMPIRequest(call);
+          Value *args[] = {
+              /*buf*/ firstallocation,
+              /*count*/ count,
+              /*datatype*/ datatype,
+              /*src*/ src,
+              /*tag*/ tag,
+              /*comm*/ comm,
+              /*request*/ req,
+          };
+          auto fcall = createMPICall(call, "MPI_Irecv", args, Builder2, {});
+          fcall->setCallingConv(call.getCallingConv());
+
+          deferMPICompletion(
+              call, {call.getOperand(0)},
+              [this, &call, req, firstallocation, shadow,
+               len_arg](IRBuilder<> &Builder2) {
+                waitMPIRequest(call, req, Builder2);
+                auto BufferDefs = gutils->getInvertedBundles(
+                    &call,
+                    {ValueType::Shadow, ValueType::None, ValueType::None,
+                     ValueType::None, ValueType::None, ValueType::None},
+                    Builder2, /*lookup*/ true);
+                DifferentiableMemCopyFloats(call, call.getOperand(0),
+                                            firstallocation, shadow, len_arg,
+                                            Builder2, BufferDefs);
+                if (shouldFree()) {
+                  CreateDealloc(Builder2, firstallocation);
+                }
+              });
+          if (Mode == DerivativeMode::ReverseModeGradient)
+            eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+          return;
+        }
+
+        Value *args[] = {
+            /*buf*/ firstallocation,
+            /*count*/ count,
+            /*datatype*/ datatype,
+            /*src*/ src,
+            /*tag*/ tag,
+            /*comm*/ comm,
+            /*status*/ status};
 
         Type *types[sizeof(args) / sizeof(*args)];
         for (size_t i = 0; i < sizeof(args) / sizeof(*args); i++)
           types[i] = args[i]->getType();
         FunctionType *FT = FunctionType::get(call.getType(), types, false);
 
-        Builder2.SetInsertPoint(Builder2.GetInsertBlock());
-
         auto BufferDefs = gutils->getInvertedBundles(
             &call,
             {ValueType::Shadow, ValueType::None, ValueType::None,
@@ -7367,6 +11133,26 @@ public:
           return;
         }
 
+        if (EnzymeMPIOverlap) {
+          Value *req = createMPIRequest(call);
+          Value *iargs[] = {shadow, count, datatype, source, tag, comm, req};
+          auto fcall = createMPICall(call, "MPI_Isend", iargs, Builder2, Defs);
+          fcall->setCallingConv(call.getCallingConv());
+
+          Value *len_arg = getMPIByteLength(
+              count, MPI_TYPE_SIZE(datatype, Builder2, call.getType()),
+              Builder2);
+          deferMPICompletion(call, {call.getOperand(0)},
+                             [this, &call, req, shadow,
+                              len_arg](IRBuilder<> &Builder2) {
+                               waitMPIRequest(call, req, Builder2);
+                               zeroMPIBuffer(shadow, len_arg, Builder2, {});
+                             });
+          if (Mode == DerivativeMode::ReverseModeGradient)
+            eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+          return;
+        }
+
         Type *types[sizeof(args) / sizeof(*args)];
         for (size_t i = 0; i < sizeof(args) / sizeof(*args); i++)
           types[i] = args[i]->getType();
@@ -7657,24 +11443,7 @@ public:
         Value *orig_root = call.getOperand(5);
         Value *orig_comm = call.getOperand(6);
 
-        bool isSum = false;
-        if (Constant *C = dyn_cast<Constant>(orig_op)) {
-          while (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
-            C = CE->getOperand(0);
-          }
-          if (auto GV = dyn_cast<GlobalVariable>(C)) {
-            if (GV->getName() == "ompi_mpi_op_sum") {
-              isSum = true;
-            }
-          }
-          // MPICH
-          if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
-            if (CI->getValue() == 1476395011) {
-              isSum = true;
-            }
-          }
-        }
-        if (!isSum) {
+        if (!isMPISumOp(orig_op)) {
           std::string s;
           llvm::raw_string_ostream ss(s);
           ss << *gutils->oldFunc << "\n";
@@ -7912,24 +11681,7 @@ public:
         Value *orig_op = call.getOperand(4);
         Value *orig_comm = call.getOperand(5);
 
-        bool isSum = false;
-        if (Constant *C = dyn_cast<Constant>(orig_op)) {
-          while (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
-            C = CE->getOperand(0);
-          }
-          if (auto GV = dyn_cast<GlobalVariable>(C)) {
-            if (GV->getName() == "ompi_mpi_op_sum") {
-              isSum = true;
-            }
-          }
-          // MPICH
-          if (ConstantInt *CI = dyn_cast<ConstantInt>(C)) {
-            if (CI->getValue() == 1476395011) {
-              isSum = true;
-            }
-          }
-        }
-        if (!isSum) {
+        if (!isMPISumOp(orig_op)) {
           std::string s;
           llvm::raw_string_ostream ss(s);
           ss << *gutils->oldFunc << "\n";
@@ -8023,6 +11775,42 @@ public:
             CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
                              len_arg, "mpireduce_malloccache");
 
+        if (EnzymeMPIOverlap) {
+          Value *req = createMPIRequest(call);
+          Value *args[] = {
+              /*sendbuf*/ shadow_recvbuf,
+              /*recvbuf*/ buf,
+              /*count*/ count,
+              /*datatype*/ datatype,
+              /*op*/ op,
+              /*comm*/ comm,
+              /*request*/ req,
+          };
+          createMPICall(call, "MPI_Iallreduce", args, Builder2, BufferDefs);
+
+          deferMPICompletion(
+              call, {orig_sendbuf, orig_recvbuf},
+              [this, &call, req, buf, shadow_sendbuf, shadow_recvbuf,
+               len_arg](IRBuilder<> &Builder2) {
+                waitMPIRequest(call, req, Builder2);
+                auto BufferDefs = gutils->getInvertedBundles(
+                    &call,
+                    {ValueType::Shadow, ValueType::Shadow, ValueType::Primal,
+                     ValueType::Primal, ValueType::Primal, ValueType::Primal},
+                    Builder2, /*lookup*/ true);
+                zeroMPIBuffer(shadow_recvbuf, len_arg, Builder2, BufferDefs);
+                DifferentiableMemCopyFloats(call, call.getOperand(0), buf,
+                                            shadow_sendbuf, len_arg, Builder2,
+                                            BufferDefs);
+                if (shouldFree()) {
+                  CreateDealloc(Builder2, buf);
+                }
+              });
+          if (Mode == DerivativeMode::ReverseModeGradient)
+            eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+          return;
+        }
+
         // 2. MPI_Allreduce (sum) of diff(recvbuffer) to intermediate
         {
           // int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
@@ -8584,144 +12372,602 @@ public:
         if (!forwardMode)
           recvcount = lookup(recvcount, Builder2);
 
-        Value *recvtype = gutils->getNewFromOriginal(orig_recvtype);
-        if (!forwardMode)
-          recvtype = lookup(recvtype, Builder2);
+        Value *recvtype = gutils->getNewFromOriginal(orig_recvtype);
+        if (!forwardMode)
+          recvtype = lookup(recvtype, Builder2);
+
+        Value *sendcount = gutils->getNewFromOriginal(orig_sendcount);
+        if (!forwardMode)
+          sendcount = lookup(sendcount, Builder2);
+
+        Value *sendtype = gutils->getNewFromOriginal(orig_sendtype);
+        if (!forwardMode)
+          sendtype = lookup(sendtype, Builder2);
+
+        Value *comm = gutils->getNewFromOriginal(orig_comm);
+        if (!forwardMode)
+          comm = lookup(comm, Builder2);
+
+        Value *tysize = MPI_TYPE_SIZE(sendtype, Builder2, call.getType());
+
+        if (forwardMode) {
+          Value *args[] = {
+              /*sendbuf*/ shadow_sendbuf,
+              /*sendcount*/ sendcount,
+              /*sendtype*/ sendtype,
+              /*recvbuf*/ shadow_recvbuf,
+              /*recvcount*/ recvcount,
+              /*recvtype*/ recvtype,
+              /*comm*/ comm,
+          };
+
+          auto Defs = gutils->getInvertedBundles(
+              &call,
+              {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+               ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+               ValueType::Primal},
+              Builder2, /*lookup*/ false);
+
+#if LLVM_VERSION_MAJOR >= 11
+          auto callval = call.getCalledOperand();
+#else
+          auto callval = call.getCalledValue();
+#endif
+
+#if LLVM_VERSION_MAJOR > 7
+          Builder2.CreateCall(call.getFunctionType(), callval, args, Defs);
+#else
+          Builder2.CreateCall(callval, args, Defs);
+#endif
+
+          return;
+        }
+        // Get the length for the allocation of the intermediate buffer
+        auto sendlen_arg = Builder2.CreateZExtOrTrunc(
+            sendcount, Type::getInt64Ty(call.getContext()));
+        sendlen_arg =
+            Builder2.CreateMul(sendlen_arg,
+                               Builder2.CreateZExtOrTrunc(
+                                   tysize, Type::getInt64Ty(call.getContext())),
+                               "", true, true);
+
+        // Need to preserve the shadow send/recv buffers.
+        auto BufferDefs = gutils->getInvertedBundles(
+            &call,
+            {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+             ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+             ValueType::Primal},
+            Builder2, /*lookup*/ true);
+
+        // 1. Alloc intermediate buffer
+        Value *buf =
+            CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                             sendlen_arg, "mpireduce_malloccache");
+
+        ConcreteType CT = TR.firstPointer(1, orig_sendbuf, &call);
+        Type *MPI_OP_Ptr_type =
+            PointerType::getUnqual(Type::getInt8PtrTy(call.getContext()));
+
+        // 2. reduce diff(recvbuffer) then scatter to corresponding input node's
+        // intermediate buffer
+        {
+          // int MPI_Reduce_scatter_block(const void* send_buffer,
+          //                    void* receive_buffer,
+          //                    int count,
+          //                    MPI_Datatype datatype,
+          //                    MPI_Op operation,
+          //                    MPI_Comm communicator);
+          Value *args[] = {
+              /*sendbuf*/ shadow_recvbuf,
+              /*recvbuf*/ buf,
+              /*recvcount*/ sendcount,
+              /*recvtype*/ sendtype,
+              /*op (MPI_SUM)*/
+              getOrInsertOpFloatSum(*gutils->newFunc->getParent(),
+                                    MPI_OP_Ptr_type, CT, call.getType(),
+                                    Builder2),
+              /*comm*/ comm,
+          };
+          Type *types[sizeof(args) / sizeof(*args)];
+          for (size_t i = 0; i < sizeof(args) / sizeof(*args); i++)
+            types[i] = args[i]->getType();
+
+          FunctionType *FT = FunctionType::get(call.getType(), types, false);
+          Builder2.CreateCall(called->getParent()->getOrInsertFunction(
+                                  "MPI_Reduce_scatter_block", FT),
+                              args, BufferDefs);
+        }
+
+        // 3. zero diff(recvbuffer) [memset to 0]
+        {
+          auto recvlen_arg = Builder2.CreateZExtOrTrunc(
+              recvcount, Type::getInt64Ty(call.getContext()));
+          recvlen_arg = Builder2.CreateMul(
+              recvlen_arg,
+              Builder2.CreateZExtOrTrunc(tysize,
+                                         Type::getInt64Ty(call.getContext())),
+              "", true, true);
+          recvlen_arg = Builder2.CreateMul(
+              recvlen_arg,
+              Builder2.CreateZExtOrTrunc(
+                  MPI_COMM_SIZE(comm, Builder2, call.getType()),
+                  Type::getInt64Ty(call.getContext())),
+              "", true, true);
+          auto val_arg =
+              ConstantInt::get(Type::getInt8Ty(call.getContext()), 0);
+          auto volatile_arg = ConstantInt::getFalse(call.getContext());
+          Value *args[] = {shadow_recvbuf, val_arg, recvlen_arg, volatile_arg};
+          Type *tys[] = {args[0]->getType(), args[2]->getType()};
+          auto memset = cast<CallInst>(Builder2.CreateCall(
+              Intrinsic::getDeclaration(gutils->newFunc->getParent(),
+                                        Intrinsic::memset, tys),
+              args, BufferDefs));
+          memset->addParamAttr(0, Attribute::NonNull);
+        }
+
+        // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+        DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                    sendlen_arg, Builder2, BufferDefs);
+
+        // Free up intermediate buffer
+        if (shouldFree()) {
+          CreateDealloc(Builder2, buf);
+        }
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Alltoall is an alltoall of the received derivatives in
+    // the opposite direction:
+    // 1. Alloc intermediate buffer
+    // 2. alltoall diff(recvbuffer) to the intermediate buffer
+    // 3. zero diff(recvbuffer) [memset to 0]
+    // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 5. free intermediate buffer
+
+    // int MPI_Alltoall(const void *sendbuf, int sendcount,
+    //                  MPI_Datatype sendtype, void *recvbuf, int recvcount,
+    //                  MPI_Datatype recvtype, MPI_Comm comm)
+    if (funcName == "MPI_Alltoall") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 3});
+        return;
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient ||
+          Mode == DerivativeMode::ReverseModeCombined) {
+        IRBuilder<> Builder2(call.getParent());
+        getReverseBuilder(Builder2);
+
+        Value *orig_sendbuf = call.getOperand(0);
+        Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+        Value *sendcount = getMPIOperand(call.getOperand(1), Builder2);
+        Value *sendtype = getMPIOperand(call.getOperand(2), Builder2);
+        Value *shadow_recvbuf =
+            getMPIShadowBuffer(call.getOperand(3), Builder2);
+        Value *recvcount = getMPIOperand(call.getOperand(4), Builder2);
+        Value *recvtype = getMPIOperand(call.getOperand(5), Builder2);
+        Value *comm = getMPIOperand(call.getOperand(6), Builder2);
+
+        Value *nranks = Builder2.CreateZExtOrTrunc(
+            MPI_COMM_SIZE(comm, Builder2, call.getType()),
+            Type::getInt64Ty(call.getContext()));
+        Value *sendlen = Builder2.CreateMul(
+            getMPIByteLength(sendcount,
+                             MPI_TYPE_SIZE(sendtype, Builder2, call.getType()),
+                             Builder2),
+            nranks, "", true, true);
+        Value *recvlen = Builder2.CreateMul(
+            getMPIByteLength(recvcount,
+                             MPI_TYPE_SIZE(recvtype, Builder2, call.getType()),
+                             Builder2),
+            nranks, "", true, true);
+
+        // Need to preserve the shadow send/recv buffers.
+        auto BufferDefs = gutils->getInvertedBundles(
+            &call,
+            {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+             ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+             ValueType::Primal},
+            Builder2, /*lookup*/ true);
+
+        Value *buf =
+            CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                             sendlen, "mpialltoall_malloccache");
+
+        Value *args[] = {
+            /*sendbuf*/ shadow_recvbuf,
+            /*sendcount*/ recvcount,
+            /*sendtype*/ recvtype,
+            /*recvbuf*/ buf,
+            /*recvcount*/ sendcount,
+            /*recvtype*/ sendtype,
+            /*comm*/ comm,
+        };
+        createMPICall(call, "MPI_Alltoall", args, Builder2, BufferDefs);
+
+        zeroMPIBuffer(shadow_recvbuf, recvlen, Builder2, BufferDefs);
+
+        DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                    sendlen, Builder2, BufferDefs);
+
+        if (shouldFree()) {
+          CreateDealloc(Builder2, buf);
+        }
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Alltoallv is an alltoallv of the received derivatives in
+    // the opposite direction. The derivative segments are packed
+    // contiguously, which keeps the adjoint correct for overlapping send
+    // segments:
+    // 1. pack (and zero) the diff(recvbuffer) segments
+    // 2. alltoallv the packed buffer to a packed intermediate buffer
+    // 3. diff(sendbuffer) segments += intermediate buffer segments
+    // 4. free the buffers and cached counts
+
+    // int MPI_Alltoallv(const void *sendbuf, const int sendcounts[],
+    //                   const int sdispls[], MPI_Datatype sendtype,
+    //                   void *recvbuf, const int recvcounts[],
+    //                   const int rdispls[], MPI_Datatype recvtype,
+    //                   MPI_Comm comm)
+    if (funcName == "MPI_Alltoallv") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 4});
+        return;
+      }
+      std::pair<Value *, Value *> arrays[] = {
+          {call.getOperand(1), call.getOperand(2)},
+          {call.getOperand(5), call.getOperand(6)}};
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        cacheMPIVectorCounts(call, BuilderZ, nullptr, arrays,
+                             call.getOperand(8));
+        return;
+      }
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      Value *cache = cacheMPIVectorCounts(call, BuilderZ, &Builder2, arrays,
+                                          call.getOperand(8));
+
+      Type *intTy = call.getType();
+      Value *orig_sendbuf = call.getOperand(0);
+      Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+      Value *sendtype = getMPIOperand(call.getOperand(3), Builder2);
+      Value *orig_recvbuf = call.getOperand(4);
+      Value *shadow_recvbuf = getMPIShadowBuffer(orig_recvbuf, Builder2);
+      Value *recvtype = getMPIOperand(call.getOperand(7), Builder2);
+      Value *comm = getMPIOperand(call.getOperand(8), Builder2);
+
+      Value *sendtysize = MPI_TYPE_SIZE(sendtype, Builder2, intTy);
+      Value *recvtysize = MPI_TYPE_SIZE(recvtype, Builder2, intTy);
+
+      auto BufferDefs = gutils->getInvertedBundles(
+          &call,
+          {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Primal, ValueType::Shadow, ValueType::Primal,
+           ValueType::Primal, ValueType::Primal, ValueType::Primal},
+          Builder2, /*lookup*/ true);
+
+      Value *packed = CreateAllocation(
+          Builder2, Type::getInt8Ty(call.getContext()),
+          getMPIByteLength(getMPIVectorTotal(intTy, cache, 1, Builder2),
+                           recvtysize, Builder2),
+          "mpialltoallv_malloccache");
+      moveMPISegments(call, orig_recvbuf, packed, shadow_recvbuf, cache,
+                      /*block*/ 1, recvtysize, /*accumulate*/ false, Builder2,
+                      BufferDefs);
+
+      Value *buf = CreateAllocation(
+          Builder2, Type::getInt8Ty(call.getContext()),
+          getMPIByteLength(getMPIVectorTotal(intTy, cache, 0, Builder2),
+                           sendtysize, Builder2),
+          "mpialltoallv_malloccache");
+
+      Value *args[] = {
+          /*sendbuf*/ packed,
+          /*sendcounts*/ getMPIVectorCountsPtr(intTy, cache, 1, 2, Builder2),
+          /*sdispls*/ getMPIVectorCountsPtr(intTy, cache, 1, 4, Builder2),
+          /*sendtype*/ recvtype,
+          /*recvbuf*/ buf,
+          /*recvcounts*/ getMPIVectorCountsPtr(intTy, cache, 0, 2, Builder2),
+          /*rdispls*/ getMPIVectorCountsPtr(intTy, cache, 0, 4, Builder2),
+          /*recvtype*/ sendtype,
+          /*comm*/ comm,
+      };
+      createMPICall(call, "MPI_Alltoallv", args, Builder2, BufferDefs);
+
+      moveMPISegments(call, orig_sendbuf, buf, shadow_sendbuf, cache,
+                      /*block*/ 0, sendtysize, /*accumulate*/ true, Builder2,
+                      BufferDefs);
+
+      if (shouldFree()) {
+        CreateDealloc(Builder2, packed);
+        CreateDealloc(Builder2, buf);
+        CreateDealloc(Builder2, cache);
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Reduce_scatter_block (with sum) is an allgather of the
+    // received derivatives:
+    // 1. Alloc intermediate buffer
+    // 2. allgather diff(recvbuffer) to the intermediate buffer
+    // 3. zero diff(recvbuffer) [memset to 0]
+    // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 5. free intermediate buffer
+
+    // int MPI_Reduce_scatter_block(const void *sendbuf, void *recvbuf,
+    //                              int recvcount, MPI_Datatype datatype,
+    //                              MPI_Op op, MPI_Comm comm)
+    if (funcName == "MPI_Reduce_scatter_block" ||
+        funcName == "MPI_Reduce_scatter") {
+      Value *orig_op = call.getOperand(4);
+      if (!isMPISumOp(orig_op)) {
+        std::string s;
+        llvm::raw_string_ostream ss(s);
+        ss << *gutils->oldFunc << "\n";
+        ss << *gutils->newFunc << "\n";
+        ss << " call: " << call << "\n";
+        ss << " unhandled " << funcName << " op: " << *orig_op << "\n";
+        if (CustomErrorHandler) {
+          CustomErrorHandler(ss.str().c_str(), wrap(&call),
+                             ErrorType::NoDerivative, nullptr);
+        }
+        llvm::errs() << ss.str() << "\n";
+        report_fatal_error("unhandled mpi_reduce_scatter op");
+      }
+    }
+    if (funcName == "MPI_Reduce_scatter_block") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 1});
+        return;
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient ||
+          Mode == DerivativeMode::ReverseModeCombined) {
+        IRBuilder<> Builder2(call.getParent());
+        getReverseBuilder(Builder2);
+
+        Value *orig_sendbuf = call.getOperand(0);
+        Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+        Value *shadow_recvbuf =
+            getMPIShadowBuffer(call.getOperand(1), Builder2);
+        Value *recvcount = getMPIOperand(call.getOperand(2), Builder2);
+        Value *datatype = getMPIOperand(call.getOperand(3), Builder2);
+        Value *comm = getMPIOperand(call.getOperand(5), Builder2);
+
+        Value *recvlen = getMPIByteLength(
+            recvcount, MPI_TYPE_SIZE(datatype, Builder2, call.getType()),
+            Builder2);
+        Value *sendlen = Builder2.CreateMul(
+            recvlen,
+            Builder2.CreateZExtOrTrunc(
+                MPI_COMM_SIZE(comm, Builder2, call.getType()),
+                Type::getInt64Ty(call.getContext())),
+            "", true, true);
 
-        Value *sendcount = gutils->getNewFromOriginal(orig_sendcount);
-        if (!forwardMode)
-          sendcount = lookup(sendcount, Builder2);
+        // Need to preserve the shadow send/recv buffers.
+        auto BufferDefs = gutils->getInvertedBundles(
+            &call,
+            {ValueType::Shadow, ValueType::Shadow, ValueType::Primal,
+             ValueType::Primal, ValueType::Primal, ValueType::Primal},
+            Builder2, /*lookup*/ true);
 
-        Value *sendtype = gutils->getNewFromOriginal(orig_sendtype);
-        if (!forwardMode)
-          sendtype = lookup(sendtype, Builder2);
+        Value *buf =
+            CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                             sendlen, "mpireducescatter_malloccache");
 
-        Value *comm = gutils->getNewFromOriginal(orig_comm);
-        if (!forwardMode)
-          comm = lookup(comm, Builder2);
+        Value *args[] = {
+            /*sendbuf*/ shadow_recvbuf,
+            /*sendcount*/ recvcount,
+            /*sendtype*/ datatype,
+            /*recvbuf*/ buf,
+            /*recvcount*/ recvcount,
+            /*recvtype*/ datatype,
+            /*comm*/ comm,
+        };
+        createMPICall(call, "MPI_Allgather", args, Builder2, BufferDefs);
 
-        Value *tysize = MPI_TYPE_SIZE(sendtype, Builder2, call.getType());
+        zeroMPIBuffer(shadow_recvbuf, recvlen, Builder2, BufferDefs);
 
-        if (forwardMode) {
-          Value *args[] = {
-              /*sendbuf*/ shadow_sendbuf,
-              /*sendcount*/ sendcount,
-              /*sendtype*/ sendtype,
-              /*recvbuf*/ shadow_recvbuf,
-              /*recvcount*/ recvcount,
-              /*recvtype*/ recvtype,
-              /*comm*/ comm,
-          };
+        DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                    sendlen, Builder2, BufferDefs);
 
-          auto Defs = gutils->getInvertedBundles(
-              &call,
-              {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
-               ValueType::Shadow, ValueType::Primal, ValueType::Primal,
-               ValueType::Primal},
-              Builder2, /*lookup*/ false);
+        if (shouldFree()) {
+          CreateDealloc(Builder2, buf);
+        }
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
 
-#if LLVM_VERSION_MAJOR >= 11
-          auto callval = call.getCalledOperand();
-#else
-          auto callval = call.getCalledValue();
-#endif
+    // Adjoint of MPI_Reduce_scatter (with sum) is an allgatherv of the
+    // received derivatives, using the cached recvcounts:
+    // 1. Alloc intermediate buffer
+    // 2. allgatherv diff(recvbuffer) to the intermediate buffer
+    // 3. zero diff(recvbuffer) [memset to 0]
+    // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 5. free intermediate buffer and cached counts
 
+    // int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf,
+    //                        const int recvcounts[], MPI_Datatype datatype,
+    //                        MPI_Op op, MPI_Comm comm)
+    if (funcName == "MPI_Reduce_scatter") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 1});
+        return;
+      }
+      std::pair<Value *, Value *> arrays[] = {{call.getOperand(2), nullptr}};
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        cacheMPIVectorCounts(call, BuilderZ, nullptr, arrays,
+                             call.getOperand(5));
+        return;
+      }
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      Value *cache = cacheMPIVectorCounts(call, BuilderZ, &Builder2, arrays,
+                                          call.getOperand(5));
+
+      Type *intTy = call.getType();
+      Value *orig_sendbuf = call.getOperand(0);
+      Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+      Value *shadow_recvbuf = getMPIShadowBuffer(call.getOperand(1), Builder2);
+      Value *datatype = getMPIOperand(call.getOperand(3), Builder2);
+      Value *comm = getMPIOperand(call.getOperand(5), Builder2);
+
+      Value *tysize = MPI_TYPE_SIZE(datatype, Builder2, intTy);
+      Value *counts = getMPIVectorCountsPtr(intTy, cache, 0, 2, Builder2);
 #if LLVM_VERSION_MAJOR > 7
-          Builder2.CreateCall(call.getFunctionType(), callval, args, Defs);
+      Value *recvcount = Builder2.CreateLoad(
+          intTy, Builder2.CreateInBoundsGEP(
+                     intTy, counts, MPI_COMM_RANK(comm, Builder2, intTy)));
 #else
-          Builder2.CreateCall(callval, args, Defs);
+      Value *recvcount = Builder2.CreateLoad(Builder2.CreateInBoundsGEP(
+          counts, MPI_COMM_RANK(comm, Builder2, intTy)));
 #endif
+      Value *sendlen = getMPIByteLength(
+          getMPIVectorTotal(intTy, cache, 0, Builder2), tysize, Builder2);
+
+      auto BufferDefs = gutils->getInvertedBundles(
+          &call,
+          {ValueType::Shadow, ValueType::Shadow, ValueType::Primal,
+           ValueType::Primal, ValueType::Primal, ValueType::Primal},
+          Builder2, /*lookup*/ true);
+
+      Value *buf =
+          CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                           sendlen, "mpireducescatter_malloccache");
+
+      Value *args[] = {
+          /*sendbuf*/ shadow_recvbuf,
+          /*sendcount*/ recvcount,
+          /*sendtype*/ datatype,
+          /*recvbuf*/ buf,
+          /*recvcounts*/ counts,
+          /*displs*/ getMPIVectorCountsPtr(intTy, cache, 0, 4, Builder2),
+          /*recvtype*/ datatype,
+          /*comm*/ comm,
+      };
+      createMPICall(call, "MPI_Allgatherv", args, Builder2, BufferDefs);
 
-          return;
-        }
-        // Get the length for the allocation of the intermediate buffer
-        auto sendlen_arg = Builder2.CreateZExtOrTrunc(
-            sendcount, Type::getInt64Ty(call.getContext()));
-        sendlen_arg =
-            Builder2.CreateMul(sendlen_arg,
-                               Builder2.CreateZExtOrTrunc(
-                                   tysize, Type::getInt64Ty(call.getContext())),
-                               "", true, true);
+      zeroMPIBuffer(shadow_recvbuf,
+                    getMPIByteLength(recvcount, tysize, Builder2), Builder2,
+                    BufferDefs);
+
+      DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                  sendlen, Builder2, BufferDefs);
+
+      if (shouldFree()) {
+        CreateDealloc(Builder2, buf);
+        CreateDealloc(Builder2, cache);
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Sendrecv is a sendrecv of the received derivative back
+    // to its source, receiving the derivative of what was sent from its
+    // destination. Wildcard (MPI_ANY_SOURCE / MPI_ANY_TAG) receives are not
+    // supported, as the reverse message needs an explicit peer and tag.
+    // 1. Alloc intermediate buffer
+    // 2. sendrecv diff(recvbuffer) to source, intermediate buffer from dest
+    // 3. zero diff(recvbuffer) [memset to 0]
+    // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 5. free intermediate buffer
+
+    // int MPI_Sendrecv(const void *sendbuf, int sendcount,
+    //                  MPI_Datatype sendtype, int dest, int sendtag,
+    //                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+    //                  int source, int recvtag, MPI_Comm comm,
+    //                  MPI_Status *status)
+    if (funcName == "MPI_Sendrecv") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 5});
+        return;
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient ||
+          Mode == DerivativeMode::ReverseModeCombined) {
+        IRBuilder<> Builder2(call.getParent());
+        getReverseBuilder(Builder2);
+
+        Value *orig_sendbuf = call.getOperand(0);
+        Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+        Value *sendcount = getMPIOperand(call.getOperand(1), Builder2);
+        Value *sendtype = getMPIOperand(call.getOperand(2), Builder2);
+        Value *dest = getMPIOperand(call.getOperand(3), Builder2);
+        Value *sendtag = getMPIOperand(call.getOperand(4), Builder2);
+        Value *shadow_recvbuf =
+            getMPIShadowBuffer(call.getOperand(5), Builder2);
+        Value *recvcount = getMPIOperand(call.getOperand(6), Builder2);
+        Value *recvtype = getMPIOperand(call.getOperand(7), Builder2);
+        Value *source = getMPIOperand(call.getOperand(8), Builder2);
+        Value *recvtag = getMPIOperand(call.getOperand(9), Builder2);
+        Value *comm = getMPIOperand(call.getOperand(10), Builder2);
+
+        // The status of the adjoint exchange is not used. As the value of
+        // MPI_STATUS_IGNORE differs across MPI libraries, it is received into
+        // a scratch status instead.
+        Type *statusTy = call.getOperand(11)->getType();
+        Type *scratchTy = ArrayType::get(Type::getInt8Ty(call.getContext()), 24);
+        if (auto PT = dyn_cast<PointerType>(statusTy))
+          if (isa<StructType>(PT->getPointerElementType()) &&
+              PT->getPointerElementType()->isSized())
+            scratchTy = PT->getPointerElementType();
+        Value *status =
+            IRBuilder<>(gutils->inversionAllocs).CreateAlloca(scratchTy);
+        if (statusTy->isIntegerTy())
+          status = Builder2.CreatePtrToInt(status, statusTy);
+        else
+          status = Builder2.CreatePointerCast(status, statusTy);
+
+        Value *sendlen = getMPIByteLength(
+            sendcount, MPI_TYPE_SIZE(sendtype, Builder2, call.getType()),
+            Builder2);
+        Value *recvlen = getMPIByteLength(
+            recvcount, MPI_TYPE_SIZE(recvtype, Builder2, call.getType()),
+            Builder2);
 
         // Need to preserve the shadow send/recv buffers.
         auto BufferDefs = gutils->getInvertedBundles(
             &call,
             {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
-             ValueType::Shadow, ValueType::Primal, ValueType::Primal,
-             ValueType::Primal},
+             ValueType::Primal, ValueType::Primal, ValueType::Shadow,
+             ValueType::Primal, ValueType::Primal, ValueType::Primal,
+             ValueType::Primal, ValueType::Primal, ValueType::None},
             Builder2, /*lookup*/ true);
 
-        // 1. Alloc intermediate buffer
         Value *buf =
             CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
-                             sendlen_arg, "mpireduce_malloccache");
-
-        ConcreteType CT = TR.firstPointer(1, orig_sendbuf, &call);
-        Type *MPI_OP_Ptr_type =
-            PointerType::getUnqual(Type::getInt8PtrTy(call.getContext()));
-
-        // 2. reduce diff(recvbuffer) then scatter to corresponding input node's
-        // intermediate buffer
-        {
-          // int MPI_Reduce_scatter_block(const void* send_buffer,
-          //                    void* receive_buffer,
-          //                    int count,
-          //                    MPI_Datatype datatype,
-          //                    MPI_Op operation,
-          //                    MPI_Comm communicator);
-          Value *args[] = {
-              /*sendbuf*/ shadow_recvbuf,
-              /*recvbuf*/ buf,
-              /*recvcount*/ sendcount,
-              /*recvtype*/ sendtype,
-              /*op (MPI_SUM)*/
-              getOrInsertOpFloatSum(*gutils->newFunc->getParent(),
-                                    MPI_OP_Ptr_type, CT, call.getType(),
-                                    Builder2),
-              /*comm*/ comm,
-          };
-          Type *types[sizeof(args) / sizeof(*args)];
-          for (size_t i = 0; i < sizeof(args) / sizeof(*args); i++)
-            types[i] = args[i]->getType();
+                             sendlen, "mpisendrecv_malloccache");
 
-          FunctionType *FT = FunctionType::get(call.getType(), types, false);
-          Builder2.CreateCall(called->getParent()->getOrInsertFunction(
-                                  "MPI_Reduce_scatter_block", FT),
-                              args, BufferDefs);
-        }
+        Value *args[] = {
+            /*sendbuf*/ shadow_recvbuf,
+            /*sendcount*/ recvcount,
+            /*sendtype*/ recvtype,
+            /*dest*/ source,
+            /*sendtag*/ recvtag,
+            /*recvbuf*/ buf,
+            /*recvcount*/ sendcount,
+            /*recvtype*/ sendtype,
+            /*source*/ dest,
+            /*recvtag*/ sendtag,
+            /*comm*/ comm,
+            /*status*/ status,
+        };
+        createMPICall(call, "MPI_Sendrecv", args, Builder2, BufferDefs);
 
-        // 3. zero diff(recvbuffer) [memset to 0]
-        {
-          auto recvlen_arg = Builder2.CreateZExtOrTrunc(
-              recvcount, Type::getInt64Ty(call.getContext()));
-          recvlen_arg = Builder2.CreateMul(
-              recvlen_arg,
-              Builder2.CreateZExtOrTrunc(tysize,
-                                         Type::getInt64Ty(call.getContext())),
-              "", true, true);
-          recvlen_arg = Builder2.CreateMul(
-              recvlen_arg,
-              Builder2.CreateZExtOrTrunc(
-                  MPI_COMM_SIZE(comm, Builder2, call.getType()),
-                  Type::getInt64Ty(call.getContext())),
-              "", true, true);
-          auto val_arg =
-              ConstantInt::get(Type::getInt8Ty(call.getContext()), 0);
-          auto volatile_arg = ConstantInt::getFalse(call.getContext());
-          Value *args[] = {shadow_recvbuf, val_arg, recvlen_arg, volatile_arg};
-          Type *tys[] = {args[0]->getType(), args[2]->getType()};
-          auto memset = cast<CallInst>(Builder2.CreateCall(
-              Intrinsic::getDeclaration(gutils->newFunc->getParent(),
-                                        Intrinsic::memset, tys),
-              args, BufferDefs));
-          memset->addParamAttr(0, Attribute::NonNull);
-        }
+        zeroMPIBuffer(shadow_recvbuf, recvlen, Builder2, BufferDefs);
 
-        // 4. diff(sendbuffer) += intermediate buffer (diffmemcopy)
         DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
-                                    sendlen_arg, Builder2, BufferDefs);
+                                    sendlen, Builder2, BufferDefs);
 
-        // Free up intermediate buffer
         if (shouldFree()) {
           CreateDealloc(Builder2, buf);
         }
@@ -8731,6 +12977,275 @@ public:
       return;
     }
 
+    // Adjoint of MPI_Allgatherv is a (sum) reduce_scatter of the packed
+    // received derivatives, using the cached recvcounts and displs:
+    // 1. pack (and zero) the diff(recvbuffer) segments
+    // 2. reduce_scatter the packed buffer to an intermediate buffer
+    // 3. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 4. free the buffers and cached counts
+
+    // int MPI_Allgatherv(const void *sendbuf, int sendcount,
+    //                    MPI_Datatype sendtype, void *recvbuf,
+    //                    const int recvcounts[], const int displs[],
+    //                    MPI_Datatype recvtype, MPI_Comm comm)
+    if (funcName == "MPI_Allgatherv") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 3});
+        return;
+      }
+      std::pair<Value *, Value *> arrays[] = {
+          {call.getOperand(4), call.getOperand(5)}};
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        cacheMPIVectorCounts(call, BuilderZ, nullptr, arrays,
+                             call.getOperand(7));
+        return;
+      }
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      Value *cache = cacheMPIVectorCounts(call, BuilderZ, &Builder2, arrays,
+                                          call.getOperand(7));
+
+      Type *intTy = call.getType();
+      Value *orig_sendbuf = call.getOperand(0);
+      Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+      Value *sendcount = getMPIOperand(call.getOperand(1), Builder2);
+      Value *sendtype = getMPIOperand(call.getOperand(2), Builder2);
+      Value *orig_recvbuf = call.getOperand(3);
+      Value *shadow_recvbuf = getMPIShadowBuffer(orig_recvbuf, Builder2);
+      Value *recvtype = getMPIOperand(call.getOperand(6), Builder2);
+      Value *comm = getMPIOperand(call.getOperand(7), Builder2);
+
+      Value *recvtysize = MPI_TYPE_SIZE(recvtype, Builder2, intTy);
+      Value *sendlen = getMPIByteLength(
+          sendcount, MPI_TYPE_SIZE(sendtype, Builder2, intTy), Builder2);
+
+      auto BufferDefs = gutils->getInvertedBundles(
+          &call,
+          {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Primal, ValueType::Primal},
+          Builder2, /*lookup*/ true);
+
+      Value *packed = CreateAllocation(
+          Builder2, Type::getInt8Ty(call.getContext()),
+          getMPIByteLength(getMPIVectorTotal(intTy, cache, 0, Builder2),
+                           recvtysize, Builder2),
+          "mpiallgatherv_malloccache");
+      moveMPISegments(call, orig_recvbuf, packed, shadow_recvbuf, cache,
+                      /*block*/ 0, recvtysize, /*accumulate*/ false, Builder2,
+                      BufferDefs);
+
+      Value *buf =
+          CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                           sendlen, "mpiallgatherv_malloccache");
+
+      ConcreteType CT = TR.firstPointer(1, orig_sendbuf, &call);
+      Type *MPI_OP_Ptr_type =
+          PointerType::getUnqual(Type::getInt8PtrTy(call.getContext()));
+
+      Value *args[] = {
+          /*sendbuf*/ packed,
+          /*recvbuf*/ buf,
+          /*recvcounts*/ getMPIVectorCountsPtr(intTy, cache, 0, 2, Builder2),
+          /*datatype*/ recvtype,
+          /*op (MPI_SUM)*/
+          getOrInsertOpFloatSum(*gutils->newFunc->getParent(), MPI_OP_Ptr_type,
+                                CT, intTy, Builder2),
+          /*comm*/ comm,
+      };
+      createMPICall(call, "MPI_Reduce_scatter", args, Builder2, BufferDefs);
+
+      DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                  sendlen, Builder2, BufferDefs);
+
+      if (shouldFree()) {
+        CreateDealloc(Builder2, packed);
+        CreateDealloc(Builder2, buf);
+        CreateDealloc(Builder2, cache);
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Gatherv is a scatterv of the packed received
+    // derivatives from the root, using the counts and displs cached at root:
+    // 1. pack (and zero) the diff(recvbuffer) segments [root]
+    // 2. scatterv the packed buffer to an intermediate buffer
+    // 3. diff(sendbuffer) += intermediate buffer (diffmemcopy)
+    // 4. free the buffers and cached counts
+
+    // int MPI_Gatherv(const void *sendbuf, int sendcount,
+    //                 MPI_Datatype sendtype, void *recvbuf,
+    //                 const int recvcounts[], const int displs[],
+    //                 MPI_Datatype recvtype, int root, MPI_Comm comm)
+    if (funcName == "MPI_Gatherv") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 3});
+        return;
+      }
+      std::pair<Value *, Value *> arrays[] = {
+          {call.getOperand(4), call.getOperand(5)}};
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        cacheMPIVectorCounts(call, BuilderZ, nullptr, arrays,
+                             call.getOperand(8), call.getOperand(7));
+        return;
+      }
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      Value *cache = cacheMPIVectorCounts(call, BuilderZ, &Builder2, arrays,
+                                          call.getOperand(8),
+                                          call.getOperand(7));
+
+      Type *intTy = call.getType();
+      Value *orig_sendbuf = call.getOperand(0);
+      Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+      Value *sendcount = getMPIOperand(call.getOperand(1), Builder2);
+      Value *sendtype = getMPIOperand(call.getOperand(2), Builder2);
+      Value *orig_recvbuf = call.getOperand(3);
+      Value *shadow_recvbuf = getMPIShadowBuffer(orig_recvbuf, Builder2);
+      Value *recvtype = getMPIOperand(call.getOperand(6), Builder2);
+      Value *root = getMPIOperand(call.getOperand(7), Builder2);
+      Value *comm = getMPIOperand(call.getOperand(8), Builder2);
+
+      Value *recvtysize = MPI_TYPE_SIZE(recvtype, Builder2, intTy);
+      Value *sendlen = getMPIByteLength(
+          sendcount, MPI_TYPE_SIZE(sendtype, Builder2, intTy), Builder2);
+
+      auto BufferDefs = gutils->getInvertedBundles(
+          &call,
+          {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Primal, ValueType::Primal, ValueType::Primal},
+          Builder2, /*lookup*/ true);
+
+      // Off the root no counts were cached, so nothing is packed.
+      Value *packed = CreateAllocation(
+          Builder2, Type::getInt8Ty(call.getContext()),
+          getMPIByteLength(getMPIVectorTotal(intTy, cache, 0, Builder2),
+                           recvtysize, Builder2),
+          "mpigatherv_malloccache");
+      moveMPISegments(call, orig_recvbuf, packed, shadow_recvbuf, cache,
+                      /*block*/ 0, recvtysize, /*accumulate*/ false, Builder2,
+                      BufferDefs);
+
+      Value *buf =
+          CreateAllocation(Builder2, Type::getInt8Ty(call.getContext()),
+                           sendlen, "mpigatherv_malloccache");
+
+      Value *args[] = {
+          /*sendbuf*/ packed,
+          /*sendcounts*/ getMPIVectorCountsPtr(intTy, cache, 0, 2, Builder2),
+          /*displs*/ getMPIVectorCountsPtr(intTy, cache, 0, 4, Builder2),
+          /*sendtype*/ recvtype,
+          /*recvbuf*/ buf,
+          /*recvcount*/ sendcount,
+          /*recvtype*/ sendtype,
+          /*root*/ root,
+          /*comm*/ comm,
+      };
+      createMPICall(call, "MPI_Scatterv", args, Builder2, BufferDefs);
+
+      DifferentiableMemCopyFloats(call, orig_sendbuf, buf, shadow_sendbuf,
+                                  sendlen, Builder2, BufferDefs);
+
+      if (shouldFree()) {
+        CreateDealloc(Builder2, packed);
+        CreateDealloc(Builder2, buf);
+        CreateDealloc(Builder2, cache);
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
+    // Adjoint of MPI_Scatterv is a gatherv of the received derivatives to
+    // the root, using the counts and displs cached at root:
+    // 1. Alloc packed intermediate buffer [sized zero off the root]
+    // 2. gatherv diff(recvbuffer) to the intermediate buffer
+    // 3. zero diff(recvbuffer) [memset to 0]
+    // 4. diff(sendbuffer) segments += intermediate buffer segments [root]
+    // 5. free the buffer and cached counts
+
+    // int MPI_Scatterv(const void *sendbuf, const int sendcounts[],
+    //                  const int displs[], MPI_Datatype sendtype,
+    //                  void *recvbuf, int recvcount, MPI_Datatype recvtype,
+    //                  int root, MPI_Comm comm)
+    if (funcName == "MPI_Scatterv") {
+      if (Mode == DerivativeMode::ForwardMode) {
+        forwardMPIShadowCall(call, {0, 4});
+        return;
+      }
+      std::pair<Value *, Value *> arrays[] = {
+          {call.getOperand(1), call.getOperand(2)}};
+      if (Mode == DerivativeMode::ReverseModePrimal) {
+        cacheMPIVectorCounts(call, BuilderZ, nullptr, arrays,
+                             call.getOperand(8), call.getOperand(7));
+        return;
+      }
+      IRBuilder<> Builder2(call.getParent());
+      getReverseBuilder(Builder2);
+      Value *cache = cacheMPIVectorCounts(call, BuilderZ, &Builder2, arrays,
+                                          call.getOperand(8),
+                                          call.getOperand(7));
+
+      Type *intTy = call.getType();
+      Value *orig_sendbuf = call.getOperand(0);
+      Value *shadow_sendbuf = getMPIShadowBuffer(orig_sendbuf, Builder2);
+      Value *sendtype = getMPIOperand(call.getOperand(3), Builder2);
+      Value *shadow_recvbuf = getMPIShadowBuffer(call.getOperand(4), Builder2);
+      Value *recvcount = getMPIOperand(call.getOperand(5), Builder2);
+      Value *recvtype = getMPIOperand(call.getOperand(6), Builder2);
+      Value *root = getMPIOperand(call.getOperand(7), Builder2);
+      Value *comm = getMPIOperand(call.getOperand(8), Builder2);
+
+      Value *sendtysize = MPI_TYPE_SIZE(sendtype, Builder2, intTy);
+
+      auto BufferDefs = gutils->getInvertedBundles(
+          &call,
+          {ValueType::Shadow, ValueType::Primal, ValueType::Primal,
+           ValueType::Primal, ValueType::Shadow, ValueType::Primal,
+           ValueType::Primal, ValueType::Primal, ValueType::Primal},
+          Builder2, /*lookup*/ true);
+
+      Value *buf = CreateAllocation(
+          Builder2, Type::getInt8Ty(call.getContext()),
+          getMPIByteLength(getMPIVectorTotal(intTy, cache, 0, Builder2),
+                           sendtysize, Builder2),
+          "mpiscatterv_malloccache");
+
+      Value *args[] = {
+          /*sendbuf*/ shadow_recvbuf,
+          /*sendcount*/ recvcount,
+          /*sendtype*/ recvtype,
+          /*recvbuf*/ buf,
+          /*recvcounts*/ getMPIVectorCountsPtr(intTy, cache, 0, 2, Builder2),
+          /*displs*/ getMPIVectorCountsPtr(intTy, cache, 0, 4, Builder2),
+          /*recvtype*/ sendtype,
+          /*root*/ root,
+          /*comm*/ comm,
+      };
+      createMPICall(call, "MPI_Gatherv", args, Builder2, BufferDefs);
+
+      zeroMPIBuffer(shadow_recvbuf,
+                    getMPIByteLength(
+                        recvcount, MPI_TYPE_SIZE(recvtype, Builder2, intTy),
+                        Builder2),
+                    Builder2, BufferDefs);
+
+      moveMPISegments(call, orig_sendbuf, buf, shadow_sendbuf, cache,
+                      /*block*/ 0, sendtysize, /*accumulate*/ true, Builder2,
+                      BufferDefs);
+
+      if (shouldFree()) {
+        CreateDealloc(Builder2, buf);
+        CreateDealloc(Builder2, cache);
+      }
+      if (Mode == DerivativeMode::ReverseModeGradient)
+        eraseIfUnused(call, /*erase*/ true, /*check*/ false);
+      return;
+    }
+
     // Adjoint of barrier is to place a barrier at the corresponding
     // location in the reverse.
     if (funcName == "MPI_Barrier") {
@@ -8988,7 +13503,9 @@ public:
       }
     }
 
-    if (Mode != DerivativeMode::ReverseModePrimal && called) {
+    if ((Mode == DerivativeMode::ReverseModeGradient ||
+         Mode == DerivativeMode::ReverseModeCombined) &&
+        called) {
       if (funcName == "__kmpc_for_static_init_4" ||
           funcName == "__kmpc_for_static_init_4u" ||
           funcName == "__kmpc_for_static_init_8" ||
@@ -9040,6 +13557,10 @@ public:
       eraseIfUnused(*orig, /*erase*/ true, /*check*/ false);
       return;
     }
+    // Loop windows are read from the marker when caching, which is erased
+    // once differentiation is done.
+    if (called && called->getName().contains("__enzyme_truncate"))
+      return;
 
     // Handle lgamma, safe to recompute so no store/change to forward
     if (called) {
@@ -9048,11 +13569,31 @@ public:
         return;
       }
 
+      if (called->getMetadata("enzyme_parallel_for") &&
+          !(gutils->isConstantInstruction(orig) &&
+            gutils->isConstantValue(orig))) {
+        visitParallelForCall(call);
+        return;
+      }
+
+      if (called->getMetadata("enzyme_matmul") &&
+          handleMatmul(call, uncacheable_args))
+        return;
+
+      if (auto md = called->getMetadata("enzyme_linear"))
+        if (handleLinearCall(call, md, uncacheable_args))
+          return;
+
+      if (auto md = called->getMetadata("enzyme_fixed_point"))
+        if (handleFixedPoint(call, md, uncacheable_args))
+          return;
+
       if (funcName == "__kmpc_for_static_init_4" ||
           funcName == "__kmpc_for_static_init_4u" ||
           funcName == "__kmpc_for_static_init_8" ||
           funcName == "__kmpc_for_static_init_8u") {
-        if (Mode != DerivativeMode::ReverseModePrimal) {
+        if (Mode == DerivativeMode::ReverseModeGradient ||
+            Mode == DerivativeMode::ReverseModeCombined) {
           IRBuilder<> Builder2(call.getParent());
           getReverseBuilder(Builder2);
           auto fini =
@@ -9069,7 +13610,8 @@ public:
         return;
       }
       if (funcName == "__kmpc_for_static_fini") {
-        if (Mode != DerivativeMode::ReverseModePrimal) {
+        if (Mode == DerivativeMode::ReverseModeGradient ||
+            Mode == DerivativeMode::ReverseModeCombined) {
           eraseIfUnused(call, /*erase*/ true, /*check*/ false);
         }
         return;
@@ -9095,7 +13637,8 @@ public:
         return;
       }
       if (funcName == "__kmpc_critical") {
-        if (Mode != DerivativeMode::ReverseModePrimal) {
+        if (Mode == DerivativeMode::ReverseModeGradient ||
+            Mode == DerivativeMode::ReverseModeCombined) {
           IRBuilder<> Builder2(call.getParent());
           getReverseBuilder(Builder2);
           auto crit2 = called->getParent()->getFunction("__kmpc_end_critical");
@@ -9114,7 +13657,8 @@ public:
         return;
       }
       if (funcName == "__kmpc_end_critical") {
-        if (Mode != DerivativeMode::ReverseModePrimal) {
+        if (Mode == DerivativeMode::ReverseModeGradient ||
+            Mode == DerivativeMode::ReverseModeCombined) {
           IRBuilder<> Builder2(call.getParent());
           getReverseBuilder(Builder2);
           auto crit2 = called->getParent()->getFunction("__kmpc_critical");
@@ -9133,6 +13677,23 @@ public:
         return;
       }
 
+      // Dynamically scheduled loops and reductions run unchanged in the
+      // primal of forward mode, and the tangents of a reduction are combined
+      // alongside the primal values.
+      if (Mode == DerivativeMode::ForwardMode) {
+        if (funcName.startswith("__kmpc_dispatch_init_") ||
+            funcName.startswith("__kmpc_dispatch_next_") ||
+            funcName.startswith("__kmpc_dispatch_fini_") ||
+            funcName == "__kmpc_end_reduce" ||
+            funcName == "__kmpc_end_reduce_nowait")
+          return;
+        if (funcName == "__kmpc_reduce" ||
+            funcName == "__kmpc_reduce_nowait") {
+          visitOMPReduceForwardCall(call);
+          return;
+        }
+      }
+
       if (funcName.startswith("__kmpc") &&
           funcName != "__kmpc_global_thread_num") {
         llvm::errs() << *gutils->oldFunc << "\n";
@@ -10215,18 +14776,8 @@ public:
             getForwardBuilder(Builder2);
 
             Value *vdiff = diffe(orig->getArgOperand(0), Builder2);
-            Value *x = gutils->getNewFromOriginal(orig->getArgOperand(0));
-            Value *args[] = {x};
-
-            Type *tys[] = {orig->getOperand(0)->getType()};
-            CallInst *dsin = cast<CallInst>(Builder2.CreateCall(
-                Intrinsic::getDeclaration(gutils->oldFunc->getParent(),
-                                          Intrinsic::cos, tys),
-                args));
-            CallInst *dcos = cast<CallInst>(Builder2.CreateCall(
-                Intrinsic::getDeclaration(gutils->oldFunc->getParent(),
-                                          Intrinsic::sin, tys),
-                args));
+            Value *dsin = Builder2.CreateExtractValue(newCall, {1});
+            Value *dcos = Builder2.CreateExtractValue(newCall, {0});
 
             auto rule = [&](Value *vdiff) {
               Value *res = UndefValue::get(orig->getType());
@@ -10246,20 +14797,11 @@ public:
             IRBuilder<> Builder2(call.getParent());
             getReverseBuilder(Builder2);
 
-            Value *x = lookup(
-                gutils->getNewFromOriginal(orig->getArgOperand(0)), Builder2);
-
-            Value *args[] = {x};
-
-            Type *tys[] = {orig->getOperand(0)->getType()};
-            CallInst *dsin = cast<CallInst>(Builder2.CreateCall(
-                Intrinsic::getDeclaration(gutils->oldFunc->getParent(),
-                                          Intrinsic::cos, tys),
-                args));
-            CallInst *dcos = cast<CallInst>(Builder2.CreateCall(
-                Intrinsic::getDeclaration(gutils->oldFunc->getParent(),
-                                          Intrinsic::sin, tys),
-                args));
+            // The fused primal result {sin(x), cos(x)} is reused, see
+            // derivativeReusesResult.
+            Value *sincos = lookup(newCall, Builder2);
+            Value *dsin = Builder2.CreateExtractValue(sincos, {1});
+            Value *dcos = Builder2.CreateExtractValue(sincos, {0});
             auto rule = [&](Value *vdiff) {
               return Builder2.CreateFSub(
                   Builder2.CreateFMul(Builder2.CreateExtractValue(vdiff, {0}),
@@ -10274,7 +14816,8 @@ public:
                 orig,
                 Constant::getNullValue(gutils->getShadowType(orig->getType())),
                 Builder2);
-            addToDiffe(orig->getArgOperand(0), dif0, Builder2, x->getType());
+            addToDiffe(orig->getArgOperand(0), dif0, Builder2,
+                       orig->getArgOperand(0)->getType());
             return;
           }
           case DerivativeMode::ReverseModePrimal: {
@@ -501,6 +501,7 @@ bool CacheUtility::getContext(BasicBlock *BB, LoopContext &loopContext,
 
   loopContexts[L].offset = nullptr;
   loopContexts[L].allocLimit = nullptr;
+  loopContexts[L].window = nullptr;
   // A precisely matching canonical IV shouldve been run during preprocessing.
   auto pair = FindCanonicalIV(L, Type::getInt64Ty(BB->getContext()));
   PHINode *CanonicalIV = pair.first;
@@ -759,10 +760,73 @@ bool CacheUtility::getContext(BasicBlock *BB, LoopContext &loopContext,
         Exp.expandCodeFor(MaxIterations, CanonicalIV->getType(),
                           loopContexts[L].preheader->getTerminator());
   }
+  if (!loopContexts[L].dynamic)
+    loopContexts[L].window = getLoopWindow(L);
   loopContext = loopContexts.find(L)->second;
   return true;
 }
 
+/// The window of a loop marked by a call __enzyme_truncate(K) in its body,
+/// outside of inner loops, or null if it is not marked. The window must be a
+/// nonzero constant or an argument and the iteration counts of inner loops
+/// known before the loop, such that every iteration caches the same amount.
+/// An argument window of zero is treated as one.
+Value *CacheUtility::getLoopWindow(Loop *L) {
+  CallInst *marker = nullptr;
+  for (BasicBlock *BB : L->blocks()) {
+    if (LI.getLoopFor(BB) != L)
+      continue;
+    for (Instruction &I : *BB)
+      if (auto CI = dyn_cast<CallInst>(&I))
+        if (auto F = CI->getCalledFunction())
+          if (F->getName().contains("__enzyme_truncate"))
+            marker = CI;
+  }
+  if (!marker)
+    return nullptr;
+
+  Type *T = Type::getInt64Ty(marker->getContext());
+  Value *K = marker->getArgOperand(0);
+  bool legal = K->getType()->isIntegerTy() &&
+               (isa<ConstantInt>(K) || isa<Argument>(K));
+  if (auto CK = dyn_cast<ConstantInt>(K))
+    if (CK->isZero())
+      legal = false;
+  for (Loop *SL : L->getLoopsInPreorder()) {
+    if (SL == L)
+      continue;
+    const SCEV *BE = SE.getBackedgeTakenCount(SL);
+    if (isa<SCEVCouldNotCompute>(BE) || !SE.isLoopInvariant(BE, L))
+      legal = false;
+  }
+  if (!legal) {
+    EmitWarning("NoTruncate", *marker,
+                "Ignoring __enzyme_truncate of loop ",
+                L->getHeader()->getName(),
+                ", whose window must be a nonzero constant or argument and "
+                "whose inner loops must have iteration counts known before it, ",
+                *marker);
+    return nullptr;
+  }
+  if (auto CK = dyn_cast<ConstantInt>(K))
+    return ConstantInt::get(T, CK->getZExtValue());
+  IRBuilder<> B(&*newFunc->getEntryBlock().getFirstInsertionPt());
+  Value *W = B.CreateZExtOrTrunc(K, T);
+  return B.CreateSelect(B.CreateICmpEQ(W, ConstantInt::get(T, 0)),
+                        ConstantInt::get(T, 1), W, K->getName() + "_window");
+}
+
+bool CacheUtility::isWindowed(LimitContext ctx) {
+  if (!ctx.Block)
+    return false;
+  for (Loop *L = LI.getLoopFor(ctx.Block); L; L = L->getParentLoop()) {
+    auto found = loopContexts.find(L);
+    if (found != loopContexts.end() && found->second.window)
+      return true;
+  }
+  return false;
+}
+
 /// Caching mechanism: creates a cache of type T in a scope given by ctx
 /// (where if ctx is in a loop there will be a corresponding number of slots)
 AllocaInst *CacheUtility::createCacheForScope(LimitContext ctx, Type *T,
@@ -1064,6 +1128,9 @@ Value *CacheUtility::computeIndexOfChunk(
       var = v.CreateAdd(var, lookupM(idx.offset, v), "", /*NUW*/ true,
                         /*NSW*/ true);
     }
+    // Truncated loops cache their last iterations in a ring buffer.
+    if (idx.window)
+      var = v.CreateURem(var, idx.window);
 
     indices.push_back(var);
     Value *lim = pair.second;
@@ -1127,6 +1194,7 @@ CacheUtility::SubLimitType CacheUtility::getSubLimits(bool inForwardPass,
     idx.exitBlocks = {};
     idx.offset = nullptr;
     idx.allocLimit = nullptr;
+    idx.window = nullptr;
     contexts.push_back(idx);
   }
 
@@ -1279,6 +1347,11 @@ CacheUtility::SubLimitType CacheUtility::getSubLimits(bool inForwardPass,
         assert(lim);
         limits[i] = RB->CreateNUWAdd(lim, ConstantInt::get(lim->getType(), 1));
       }
+      if (Value *window = contexts[i].window) {
+        IRBuilder<> &B = inForwardPass ? allocationBuilder : *RB;
+        limits[i] = B.CreateSelect(B.CreateICmpULT(limits[i], window),
+                                   limits[i], window);
+      }
     }
   }
 
@@ -1422,7 +1495,7 @@ void CacheUtility::storeInstructionInCache(LimitContext ctx,
 
   // If the value stored doesnt change (per efficient bool cache),
   // mark it as invariant
-  if (tostore == val) {
+  if (tostore == val && !isWindowed(ctx)) {
     if (ValueInvariantGroups.find(cache) == ValueInvariantGroups.end()) {
       MDNode *invgroup = MDNode::getDistinct(cache->getContext(), {});
       ValueInvariantGroups[cache] = invgroup;
@@ -1657,6 +1730,9 @@ Value *CacheUtility::lookupValueFromCache(
   }
 
   Value *result = loadFromCachePointer(T, BuilderM, cptr, cache);
+  if (isWindowed(ctx))
+    cast<LoadInst>(result)->setMetadata(LLVMContext::MD_invariant_group,
+                                        nullptr);
 
   // If using the efficient bool cache, do the corresponding
   // mask and shift to retrieve the actual value
@@ -79,6 +79,10 @@ struct LoopContext {
   /// An overriding allocation limit size.
   AssertingReplacingVH allocLimit;
 
+  /// For a loop marked by __enzyme_truncate(K), the number K of last
+  /// iterations that are cached, in a ring buffer, and differentiated.
+  AssertingReplacingVH window;
+
   /// All blocks this loop exits too
   llvm::SmallPtrSet<llvm::BasicBlock *, 8> exitBlocks;
 
@@ -185,6 +189,8 @@ public:
   llvm::AllocaInst *getDynamicLoopLimit(llvm::Loop *L,
                                         bool ReverseLimit = true);
 
+  llvm::Value *getLoopWindow(llvm::Loop *L);
+
   /// Print out all currently cached values
   void dumpScope() {
     llvm::errs() << "scope:\n";
@@ -247,6 +253,10 @@ public:
   SubLimitType getSubLimits(bool inForwardPass, llvm::IRBuilder<> *RB,
                             LimitContext ctx, llvm::Value *extraSize = nullptr);
 
+  /// Whether a cache in the given scope is indexed by a truncated loop, whose
+  /// ring buffer is overwritten and thus not invariant
+  bool isWindowed(LimitContext ctx);
+
 private:
   /// Internal data structure used by getSubLimit to avoid computing the same
   /// loop limit multiple times if possible. Map's a desired limitMinus1 (see
@@ -24,6 +24,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 
 #include "../Enzyme.h"
@@ -33,6 +34,8 @@
 
 using namespace llvm;
 
+extern llvm::cl::opt<bool> EnzymeLate;
+
 // This function is of type PassManagerBuilder::ExtensionFn
 static void loadPass(const PassManagerBuilder &Builder,
                      legacy::PassManagerBase &PM) {
@@ -48,6 +51,19 @@ static void loadPass(const PassManagerBuilder &Builder,
   // PM.add(SimplifyCFGPass());
 }
 
+// Both extension points are registered, the option picks the one in use.
+static void loadPassEarly(const PassManagerBuilder &Builder,
+                          legacy::PassManagerBase &PM) {
+  if (!EnzymeLate)
+    loadPass(Builder, PM);
+}
+
+static void loadPassLate(const PassManagerBuilder &Builder,
+                         legacy::PassManagerBase &PM) {
+  if (EnzymeLate)
+    loadPass(Builder, PM);
+}
+
 static void loadNVVMPass(const PassManagerBuilder &Builder,
                          legacy::PassManagerBase &PM) {
   PM.add(createPreserveNVVMPass(/*Begin=*/true));
@@ -55,7 +71,9 @@ static void loadNVVMPass(const PassManagerBuilder &Builder,
 
 // These constructors add our pass to a list of global extensions.
 static RegisterStandardPasses
-    clangtoolLoader_Ox(PassManagerBuilder::EP_VectorizerStart, loadPass);
+    clangtoolLoader_Ox(PassManagerBuilder::EP_VectorizerStart, loadPassEarly);
+static RegisterStandardPasses
+    clangtoolLoader_OLate(PassManagerBuilder::EP_OptimizerLast, loadPassLate);
 static RegisterStandardPasses
     clangtoolLoader_O0(PassManagerBuilder::EP_EnabledOnOptLevel0, loadPass);
 static RegisterStandardPasses
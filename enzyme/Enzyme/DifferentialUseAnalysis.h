@@ -362,6 +362,11 @@ static inline bool is_use_directly_needed_in_reverse(
     if (funcName == "MPI_Waitall" || funcName == "PMPI_Waitall")
       if (val != CI->getArgOperand(0) || val != CI->getOperand(1))
         return false;
+
+    // The adjoint is computed from the primal result alone
+    if (derivativeOnlyUsesResult(CI))
+      return false;
+
     // Since adjoint of barrier is another barrier in reverse
     // we still need even if instruction is inactive
     if (funcName == "__kmpc_barrier" || funcName == "MPI_Barrier") {
@@ -457,6 +462,49 @@ static inline bool is_value_needed_in_reverse(
         }
       }
     }
+    if (auto CI = dyn_cast<CallInst>(inst)) {
+      bool forward = mode == DerivativeMode::ForwardMode ||
+                     mode == DerivativeMode::ForwardModeSplit;
+      const char *reason = nullptr;
+      const CallInst *companionOf = nullptr;
+      if (!gutils->isConstantInstruction(const_cast<CallInst *>(CI)) &&
+          derivativeReusesResult(CI))
+        reason = "as its derivative reuses it";
+      // Companions are only reused by the reverse pass.
+      if (!reason && !forward)
+        for (auto &I : *CI->getParent()) {
+          auto C = dyn_cast<CallInst>(&I);
+          if (C && C != CI &&
+              !gutils->isConstantInstruction(const_cast<CallInst *>(C)) &&
+              findDerivativeCompanion(C) == CI) {
+            reason = "as companion of";
+            companionOf = C;
+            break;
+          }
+        }
+      // Within a loop, the reverse pass rematerializes the result rather than
+      // reusing it from the forward sweep if its operands are recomputable.
+      if (reason && !forward && gutils->can_modref_map &&
+          gutils->OrigLI.getLoopFor(CI->getParent())) {
+        ValueToValueMapTy available;
+        bool recomputable = true;
+        for (auto &op : CI->args())
+          if (!gutils->legalRecompute(op, available, nullptr))
+            recomputable = false;
+        if (recomputable)
+          reason = nullptr;
+      }
+      if (reason) {
+        if (EnzymePrintDiffUse) {
+          llvm::errs() << " Need: " << to_string(VT) << " of " << *inst
+                       << " in reverse " << reason;
+          if (companionOf)
+            llvm::errs() << " " << *companionOf;
+          llvm::errs() << "\n";
+        }
+        return seen[idx] = true;
+      }
+    }
   }
 
   if (auto CI = dyn_cast<CallInst>(inst)) {
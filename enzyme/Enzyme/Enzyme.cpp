@@ -29,10 +29,12 @@
 #include <llvm/Config/llvm-config.h>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSwitch.h"
 #include "llvm/Passes/PassBuilder.h"
 
 #include "llvm/IR/BasicBlock.h"
@@ -91,6 +93,22 @@ llvm::cl::opt<bool> EnzymeAttributor("enzyme-attributor", cl::init(false),
 llvm::cl::opt<bool> EnzymeOMPOpt("enzyme-omp-opt", cl::init(false), cl::Hidden,
                                  cl::desc("Whether to enable openmp opt"));
 
+llvm::cl::opt<bool>
+    EnzymeLate("enzyme-late", cl::init(false), cl::Hidden,
+               cl::desc("Run Enzyme at the end of the optimization pipeline, "
+                        "differentiating already vectorized code"));
+
+llvm::cl::opt<unsigned> EnzymeVectorStripWidth(
+    "enzyme-vector-strip-width", cl::init(0), cl::Hidden,
+    cl::desc("Compute vector forward mode derivatives wider than this by "
+             "looping over blocks of this many directions (0 to disable)"));
+
+llvm::cl::opt<unsigned> EnzymeJacobianWidth(
+    "enzyme-jacobian-width", cl::init(4), cl::Hidden,
+    cl::desc("Vector width of the derivative calls computing blocks of "
+             "columns or rows of the Jacobian for __enzyme_jacobian, and of "
+             "the Hessian for __enzyme_hessian"));
+
 #if LLVM_VERSION_MAJOR >= 14
 #define addAttribute addAttributeAtIndex
 #endif
@@ -313,6 +331,171 @@ handleCustomDerivative(llvm::Module &M, llvm::GlobalVariable &g,
   globalsToErase.push_back(&g);
 }
 
+/// Mark the functions referenced by a __enzyme_register_parallel_for global
+/// as parallel-for runtimes, whose calls are differentiated by scheduling the
+/// derivative of the loop body through the same runtime.
+static void
+handleParallelFor(llvm::Module &M, llvm::GlobalVariable &g,
+                  SmallVectorImpl<GlobalVariable *> &globalsToErase) {
+  constexpr static const char handlername[] = "__enzyme_register_parallel_for";
+  if (!g.hasInitializer()) {
+    llvm::errs() << M << "\n";
+    llvm::errs() << "Use of " << handlername
+                 << " must be a constant function array " << g << "\n";
+    llvm_unreachable(handlername);
+  }
+  SmallVector<Value *, 1> vals;
+  if (auto CA = dyn_cast<ConstantAggregate>(g.getInitializer()))
+    vals.append(CA->op_begin(), CA->op_end());
+  else
+    vals.push_back(g.getInitializer());
+  for (Value *V : vals) {
+    while (auto CE = dyn_cast<ConstantExpr>(V)) {
+      V = CE->getOperand(0);
+    }
+    auto F = dyn_cast<Function>(V);
+    if (!F || F->arg_size() != 4) {
+      llvm::errs() << M << "\n";
+      llvm::errs() << "Param of " << handlername
+                   << " must be a function of the form "
+                      "(begin, end, body, closure) "
+                   << g << "\n"
+                   << *V << "\n";
+      llvm_unreachable(handlername);
+    }
+    F->setMetadata("enzyme_parallel_for", MDTuple::get(F->getContext(), {}));
+  }
+  globalsToErase.push_back(&g);
+}
+
+/// Register the functions of a __enzyme_register_linear global,
+/// {fn, adj, "param_<n>"...}, declaring the void function fn linear in its
+/// pointer arguments, other than those listed as parameters of the operator,
+/// with adjoint adj of the same type. Calls to fn are then differentiated
+/// without any tape: the tangent of fn is fn itself applied to the shadows of
+/// those arguments, and its reverse pass is adj applied to them.
+static void handleLinear(llvm::Module &M, llvm::GlobalVariable &g,
+                         SmallVectorImpl<GlobalVariable *> &globalsToErase) {
+  constexpr static const char handlername[] = "__enzyme_register_linear";
+  auto CA = g.hasInitializer() ? dyn_cast<ConstantAggregate>(g.getInitializer())
+                               : nullptr;
+  if (!CA || CA->getNumOperands() < 2) {
+    llvm::errs() << M << "\n";
+    llvm::errs() << "Use of " << handlername
+                 << " must be a constant array of a function and its adjoint "
+                 << g << "\n";
+    llvm_unreachable(handlername);
+  }
+  Function *Fs[2];
+  for (size_t i = 0; i < 2; i++) {
+    Value *V = CA->getOperand(i);
+    while (auto CE = dyn_cast<ConstantExpr>(V)) {
+      V = CE->getOperand(0);
+    }
+    Fs[i] = dyn_cast<Function>(V);
+    if (!Fs[i]) {
+      llvm::errs() << M << "\n";
+      llvm::errs() << "Param of " << handlername << " must be a function " << g
+                   << "\n"
+                   << *V << "\n";
+      llvm_unreachable(handlername);
+    }
+  }
+  Function *F = Fs[0], *Adj = Fs[1];
+  if (F->getFunctionType() != Adj->getFunctionType() ||
+      !F->getReturnType()->isVoidTy()) {
+    llvm::errs() << M << "\n";
+    llvm::errs() << "Use of " << handlername
+                 << " must be of a void function and an adjoint of the same "
+                    "type "
+                 << g << "\n";
+    llvm_unreachable(handlername);
+  }
+
+  SmallVector<Metadata *, 2> mds = {llvm::ValueAsMetadata::get(Adj)};
+  for (size_t i = 2; i < CA->getNumOperands(); i++) {
+    Value *V = CA->getOperand(i);
+    while (auto CE = dyn_cast<ConstantExpr>(V)) {
+      V = CE->getOperand(0);
+    }
+    StringRef str;
+    size_t argnum;
+    if (!getConstantStringInfo(V, str) || !str.consume_front("param_") ||
+        str.getAsInteger(10, argnum) || argnum >= F->arg_size() ||
+        !F->getArg(argnum)->getType()->isPointerTy()) {
+      llvm::errs() << M << "\n";
+      llvm::errs() << "Use of " << handlername
+                   << " possible post args include 'param_<n>' for pointer "
+                      "arguments "
+                   << g << "\n";
+      llvm_unreachable(handlername);
+    }
+    mds.push_back(llvm::ConstantAsMetadata::get(
+        ConstantInt::get(Type::getInt64Ty(M.getContext()), argnum)));
+  }
+  F->setMetadata("enzyme_linear", llvm::MDTuple::get(F->getContext(), mds));
+  globalsToErase.push_back(&g);
+}
+
+/// Replace a call __enzyme_fixed_point(step, x, n, args...), for a step
+/// function void(T *out, T *in, args...), by one to the solver iterating
+/// step from the n elements of x until they are a fixed point. Returns false
+/// if the call is malformed.
+static bool lowerFixedPointCall(CallInst *CI) {
+  Value *fn = CI->getArgOperand(0);
+  while (auto CE = dyn_cast<ConstantExpr>(fn)) {
+    fn = CE->getOperand(0);
+  }
+  auto step = dyn_cast<Function>(fn);
+  FunctionType *FT = step ? step->getFunctionType() : nullptr;
+  if (!step || !FT->getReturnType()->isVoidTy() || FT->getNumParams() < 2 ||
+      FT->getParamType(0) != FT->getParamType(1) ||
+      !FT->getParamType(0)->isPointerTy() ||
+      !FT->getParamType(0)->getPointerElementType()->isFloatingPointTy()) {
+    EmitFailure("IllegalFixedPoint", CI->getDebugLoc(), CI,
+                "__enzyme_fixed_point requires a step function "
+                "void(T *out, T *in, args...) of floating point T, found ",
+                *fn);
+    return false;
+  }
+#if LLVM_VERSION_MAJOR >= 14
+  unsigned numArgs = CI->arg_size();
+#else
+  unsigned numArgs = CI->getNumArgOperands();
+#endif
+  if (numArgs != FT->getNumParams() + 1) {
+    EmitFailure("IllegalFixedPoint", CI->getDebugLoc(), CI,
+                "__enzyme_fixed_point takes the step function, x, the length "
+                "of x and the remaining arguments of step, found ",
+                *CI);
+    return false;
+  }
+
+  Function *solver = getOrInsertFixedPoint(*CI->getModule(), step);
+  IRBuilder<> B(CI);
+  SmallVector<Value *, 4> args;
+  for (unsigned i = 1; i < numArgs; i++) {
+    Value *arg = CI->getArgOperand(i);
+    Type *PTy = solver->getFunctionType()->getParamType(i - 1);
+    if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+      arg = B.CreatePointerCast(arg, PTy);
+    else if (arg->getType()->isIntegerTy() && PTy->isIntegerTy())
+      arg = B.CreateIntCast(arg, PTy, /*isSigned*/ false);
+    else if (arg->getType() != PTy) {
+      EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                  "Cannot cast __enzyme_fixed_point argument ", i, ", found ",
+                  *arg, ", type ", *arg->getType(), " - to ", *PTy);
+      return false;
+    }
+    args.push_back(arg);
+  }
+  auto call = B.CreateCall(solver, args);
+  call->setDebugLoc(CI->getDebugLoc());
+  if (!CI->getType()->isVoidTy())
+    CI->replaceAllUsesWith(UndefValue::get(CI->getType()));
+  return true;
+}
+
 static void handleKnownFunctions(llvm::Function &F) {
   if (F.getName() == "memcmp") {
     F.addFnAttr(Attribute::ReadOnly);
@@ -558,6 +741,613 @@ static Optional<StringRef> getMetadataName(llvm::Value *res) {
   }
 }
 
+/// Find the sparsity pattern of the m x n Jacobian of fn(y, x, args...), for
+/// which bit j of rows[i] is set if y[i] may depend on x[j]. This requires x
+/// and y to be accessed only by loads and stores of single elements at
+/// constant offsets, and values depending on x to reach memory only by stores
+/// to y. Returns false if the pattern cannot be found this way.
+static bool detectJacobianSparsity(Function *fn, uint64_t m, uint64_t n,
+                                   SmallVectorImpl<BitVector> &rows) {
+  if (fn->empty())
+    return false;
+  auto &DL = fn->getParent()->getDataLayout();
+  Argument *y = fn->arg_begin();
+  Argument *x = y + 1;
+  Type *T = x->getType()->getPointerElementType();
+  uint64_t size = DL.getTypeAllocSize(T);
+
+  // The element of the len elements at base addressed by ptr, if constant.
+  auto element = [&](Value *ptr, Value *base,
+                     uint64_t len) -> Optional<uint64_t> {
+    APInt off(DL.getPointerSizeInBits(
+                  cast<PointerType>(ptr->getType())->getAddressSpace()),
+              0);
+    if (ptr->stripAndAccumulateInBoundsConstantOffsets(DL, off) != base ||
+        off.isNegative() || off.getZExtValue() % size != 0 ||
+        off.getZExtValue() / size >= len)
+      return Optional<uint64_t>();
+    return off.getZExtValue() / size;
+  };
+
+  std::map<Instruction *, uint64_t> loads, stores;
+  for (auto pair : {std::make_pair(x, n), std::make_pair(y, m)}) {
+    SmallVector<Value *, 4> todo = {pair.first};
+    while (todo.size()) {
+      Value *V = todo.pop_back_val();
+      for (User *U : V->users()) {
+        Optional<uint64_t> idx;
+        if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) {
+          todo.push_back(U);
+          continue;
+        } else if (auto LI = dyn_cast<LoadInst>(U)) {
+          if (pair.first == x && LI->getType() == T)
+            idx = element(V, x, n);
+          if (!idx)
+            return false;
+          loads[LI] = *idx;
+        } else if (auto SI = dyn_cast<StoreInst>(U)) {
+          if (pair.first == y && SI->getPointerOperand() == V &&
+              SI->getValueOperand()->getType() == T)
+            idx = element(V, y, m);
+          if (!idx)
+            return false;
+          stores[SI] = *idx;
+        } else {
+          return false;
+        }
+      }
+    }
+  }
+
+  // Propagate the elements of x each value depends on to a fixed point, since
+  // phis may carry them around loops.
+  std::map<Value *, BitVector> deps;
+  rows.assign(m, BitVector(n));
+  auto merge = [](BitVector &into, const BitVector &from) {
+    BitVector next = into;
+    next |= from;
+    if (next == into)
+      return false;
+    into = next;
+    return true;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (BasicBlock &BB : *fn) {
+      for (Instruction &I : BB) {
+        BitVector cur(n);
+        if (loads.count(&I)) {
+          cur.set(loads[&I]);
+        } else if (isa<LoadInst>(&I)) {
+          continue;
+        } else if (isa<InvokeInst>(&I)) {
+          return false;
+        } else {
+          for (Value *op : I.operands())
+            if (deps.count(op))
+              cur |= deps[op];
+        }
+        if (cur.none())
+          continue;
+        if (auto SI = dyn_cast<StoreInst>(&I)) {
+          if (!stores.count(SI))
+            return false;
+          changed |= merge(rows[stores[SI]], cur);
+          continue;
+        }
+        if (isa<CallInst>(&I) ? !cast<CallInst>(&I)->onlyReadsMemory()
+                              : I.mayWriteToMemory())
+          return false;
+        auto found = deps.find(&I);
+        if (found == deps.end())
+          found = deps.emplace(&I, BitVector(n)).first;
+        changed |= merge(found->second, cur);
+      }
+    }
+  }
+  return true;
+}
+
+/// Emit at B the address of element i of the array of T at base.
+static Value *arrayElement(IRBuilder<> &B, Type *T, Value *base, Value *i) {
+#if LLVM_VERSION_MAJOR > 7
+  return B.CreateGEP(T, base, i);
+#else
+  return B.CreateGEP(base, i);
+#endif
+}
+
+static Value *loadElement(IRBuilder<> &B, Type *T, Value *base, Value *i) {
+#if LLVM_VERSION_MAJOR > 7
+  return B.CreateLoad(T, arrayElement(B, T, base, i));
+#else
+  return B.CreateLoad(arrayElement(B, T, base, i));
+#endif
+}
+
+/// Emit at B the zeroing of count elements of T at ptr.
+static void zeroElements(IRBuilder<> &B, Type *T, Value *ptr, Value *count) {
+  auto &DL = B.GetInsertBlock()->getModule()->getDataLayout();
+  Value *size =
+      B.CreateMul(count, ConstantInt::get(count->getType(),
+                                          DL.getTypeAllocSize(T)));
+#if LLVM_VERSION_MAJOR >= 10
+  B.CreateMemSet(ptr, B.getInt8(0), size, MaybeAlign(1));
+#else
+  B.CreateMemSet(ptr, B.getInt8(0), size, 1);
+#endif
+}
+
+static Value *allocElements(IRBuilder<> &B, Type *T, Value *count,
+                            const Twine &name) {
+  return B.CreatePointerCast(CreateAllocation(B, T, count, name),
+                             PointerType::getUnqual(T));
+}
+
+/// Emit at B the computation of the m x n matrix jac from its products with
+/// seeds, each the sum of the unit vectors of one color. If fwd, the seeds
+/// are over the n columns, else over the m rows. colors gives the color of
+/// each seed index, or is null if each has its own. Blocks of up to
+/// EnzymeJacobianWidth colors are seeded at once. For each block,
+/// derive(B, seed, res, width) computes into res the products with the
+/// width seed vectors laid out one after another in seed, which are then
+/// scattered into jac. jac is dense and row-major if denseOut, and otherwise
+/// holds the nonzeros of the CSR sparsity pattern rowptr, colidx, which is
+/// needed whenever colors is given.
+static void createSeedSweep(
+    IRBuilder<> &B, Type *T, Value *jac, Value *m, Value *n, Value *rowptr,
+    Value *colidx, bool denseOut, Value *colors, Value *numColors, bool fwd,
+    function_ref<void(IRBuilder<> &, Value *, Value *, uint64_t)> derive) {
+  Function *F = B.GetInsertBlock()->getParent();
+  auto &Ctx = F->getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Value *zero = ConstantInt::get(i64, 0);
+  Value *one = ConstantInt::get(i64, 1);
+  Value *seedLen = fwd ? n : m;
+  Value *resLen = fwd ? m : n;
+  uint64_t width = std::max(1u, (unsigned)EnzymeJacobianWidth);
+  if (auto C = dyn_cast<ConstantInt>(seedLen))
+    width = std::max<uint64_t>(1, std::min(width, C->getZExtValue()));
+  Value *W = ConstantInt::get(i64, width);
+  Value *seed = allocElements(B, T, B.CreateMul(W, seedLen), "jac.seed");
+  Value *res = allocElements(B, T, B.CreateMul(W, resLen), "jac.res");
+
+  // Run body if lane is one of the W lanes of the block.
+  auto ifLane = [&](IRBuilder<> &B, Value *lane,
+                    function_ref<void(IRBuilder<> &)> body) {
+    BasicBlock *then = BasicBlock::Create(Ctx, "jac.color", F);
+    BasicBlock *cont = BasicBlock::Create(Ctx, "jac.color.end", F);
+    B.CreateCondBr(B.CreateICmpULT(lane, W), then, cont);
+    B.SetInsertPoint(then);
+    body(B);
+    B.CreateBr(cont);
+    B.SetInsertPoint(cont);
+  };
+
+  // Evaluate the function even if there is nothing to differentiate.
+  Value *numBlocks =
+      B.CreateSelect(B.CreateICmpSGT(numColors, zero), numColors, one);
+  createCountedLoop(B, zero, numBlocks, width, "jac.block", [&](IRBuilder<>
+                                                                    &B,
+                                                                Value *c0) {
+    zeroElements(B, T, seed, B.CreateMul(W, seedLen));
+    zeroElements(B, T, res, B.CreateMul(W, resLen));
+    Value *rem = B.CreateSub(seedLen, c0);
+    Value *lanes = B.CreateSelect(B.CreateICmpSLT(rem, W), rem, W);
+    Constant *oneT = ConstantFP::get(T, 1.0);
+    if (colors)
+      createCountedLoop(B, zero, seedLen, 1, "jac.seed",
+                        [&](IRBuilder<> &B, Value *s) {
+                          Value *lane =
+                              B.CreateSub(loadElement(B, i64, colors, s), c0);
+                          ifLane(B, lane, [&](IRBuilder<> &B) {
+                            Value *idx =
+                                B.CreateAdd(B.CreateMul(lane, seedLen), s);
+                            B.CreateStore(oneT,
+                                          arrayElement(B, T, seed, idx));
+                          });
+                        });
+    else
+      createCountedLoop(B, zero, lanes, 1, "jac.seed",
+                        [&](IRBuilder<> &B, Value *k) {
+                          Value *idx = B.CreateAdd(B.CreateMul(k, seedLen),
+                                                   B.CreateAdd(c0, k));
+                          B.CreateStore(oneT, arrayElement(B, T, seed, idx));
+                        });
+
+    derive(B, seed, res, width);
+
+    if (colors)
+      createCountedLoop(B, zero, m, 1, "jac.row", [&](IRBuilder<> &B,
+                                                       Value *i) {
+        createCountedLoop(
+            B, loadElement(B, i64, rowptr, i),
+            loadElement(B, i64, rowptr, B.CreateNSWAdd(i, one)), 1, "jac.nz",
+            [&](IRBuilder<> &B, Value *p) {
+              Value *j = loadElement(B, i64, colidx, p);
+              Value *lane =
+                  B.CreateSub(loadElement(B, i64, colors, fwd ? j : i), c0);
+              ifLane(B, lane, [&](IRBuilder<> &B) {
+                Value *val = loadElement(
+                    B, T, res,
+                    B.CreateAdd(B.CreateMul(lane, resLen), fwd ? i : j));
+                Value *idx = denseOut ? B.CreateAdd(B.CreateMul(i, n), j) : p;
+                B.CreateStore(val, arrayElement(B, T, jac, idx));
+              });
+            });
+      });
+    else
+      createCountedLoop(B, zero, lanes, 1, "jac.lane", [&](IRBuilder<> &B,
+                                                            Value *k) {
+        Value *s = B.CreateAdd(c0, k);
+        createCountedLoop(B, zero, resLen, 1, "jac.out",
+                          [&](IRBuilder<> &B, Value *r) {
+                            Value *i = fwd ? r : s;
+                            Value *j = fwd ? s : r;
+                            Value *val = loadElement(
+                                B, T, res,
+                                B.CreateAdd(B.CreateMul(k, resLen), r));
+                            Value *idx = B.CreateAdd(B.CreateMul(i, n), j);
+                            B.CreateStore(val, arrayElement(B, T, jac, idx));
+                          });
+      });
+  });
+  CreateDealloc(B, seed);
+  CreateDealloc(B, res);
+}
+
+/// Replace a call __enzyme_jacobian(fn, jac, y, m, x, n, args...), for fn
+/// void(T *y, T *x, args...), by loops computing y = fn(x, args...) and the
+/// m x n row-major Jacobian jac of y with respect to x. Blocks of
+/// EnzymeJacobianWidth columns are computed by vector forward mode if n <= m,
+/// and blocks of rows by vector reverse mode otherwise. If n is followed by
+/// enzyme_sparsity and the CSR sparsity pattern rowptr, colidx, jac instead
+/// receives the nonzeros of the pattern. The columns, or the rows, are then
+/// merged by a coloring of the pattern, using the mode needing fewer colors.
+/// For a dense jac of constant size, a pattern found by
+/// detectJacobianSparsity is used alike. Returns false if the call is
+/// malformed.
+static bool lowerJacobianCall(CallInst *CI) {
+  Module &M = *CI->getModule();
+  auto &Ctx = M.getContext();
+  Value *fnv = CI->getArgOperand(0);
+  while (auto CE = dyn_cast<ConstantExpr>(fnv)) {
+    fnv = CE->getOperand(0);
+  }
+  auto fn = dyn_cast<Function>(fnv);
+  FunctionType *FT = fn ? fn->getFunctionType() : nullptr;
+  if (!fn || !FT->getReturnType()->isVoidTy() || FT->getNumParams() < 2 ||
+      FT->getParamType(0) != FT->getParamType(1) ||
+      !FT->getParamType(0)->isPointerTy() ||
+      !FT->getParamType(0)->getPointerElementType()->isFloatingPointTy()) {
+    EmitFailure("IllegalJacobian", CI->getDebugLoc(), CI,
+                "__enzyme_jacobian requires a function "
+                "void(T *y, T *x, args...) of floating point T, found ",
+                *fnv);
+    return false;
+  }
+#if LLVM_VERSION_MAJOR >= 14
+  unsigned numArgs = CI->arg_size();
+#else
+  unsigned numArgs = CI->getNumArgOperands();
+#endif
+  unsigned numFixed = 6;
+  bool sparse = false;
+  if (numArgs > numFixed) {
+    auto metaString = getMetadataName(CI->getArgOperand(numFixed));
+    sparse = metaString && *metaString == "enzyme_sparsity";
+  }
+  if (sparse)
+    numFixed += 3;
+  if (numArgs != numFixed + FT->getNumParams() - 2) {
+    EmitFailure("IllegalJacobian", CI->getDebugLoc(), CI,
+                "__enzyme_jacobian takes fn, jac, y, m, x, n, optionally "
+                "enzyme_sparsity, rowptr and colidx, and the remaining "
+                "arguments of fn, found ",
+                *CI);
+    return false;
+  }
+
+  Type *PT = FT->getParamType(0);
+  Type *T = PT->getPointerElementType();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PI = PointerType::getUnqual(i64);
+  IRBuilder<> B(CI);
+  auto getArg = [&](unsigned i, Type *PTy) -> Value * {
+    Value *arg = CI->getArgOperand(i);
+    if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+      return B.CreatePointerCast(arg, PTy);
+    if (arg->getType()->isIntegerTy() && PTy->isIntegerTy())
+      return B.CreateIntCast(arg, PTy, /*isSigned*/ false);
+    if (arg->getType() != PTy) {
+      EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                  "Cannot cast __enzyme_jacobian argument ", i, ", found ",
+                  *arg, ", type ", *arg->getType(), " - to ", *PTy);
+      return nullptr;
+    }
+    return arg;
+  };
+  Value *jac = getArg(1, PT);
+  Value *y = getArg(2, PT);
+  Value *m = getArg(3, i64);
+  Value *x = getArg(4, PT);
+  Value *n = getArg(5, i64);
+  Value *rowptr = sparse ? getArg(7, PI) : nullptr;
+  Value *colidx = sparse ? getArg(8, PI) : nullptr;
+  SmallVector<Value *, 4> rest;
+  for (unsigned i = numFixed; i < numArgs; i++)
+    rest.push_back(getArg(i, FT->getParamType(i - numFixed + 2)));
+  if (!jac || !y || !m || !x || !n || (sparse && (!rowptr || !colidx)) ||
+      llvm::is_contained(rest, nullptr))
+    return false;
+
+  bool denseOut = !sparse;
+  SmallVector<BitVector, 4> rows;
+  if (!sparse && isa<ConstantInt>(m) && isa<ConstantInt>(n) &&
+      detectJacobianSparsity(fn, cast<ConstantInt>(m)->getZExtValue(),
+                             cast<ConstantInt>(n)->getZExtValue(), rows)) {
+    SmallVector<uint64_t, 8> ptrs = {0}, idxs;
+    for (auto &row : rows) {
+      for (auto j : row.set_bits())
+        idxs.push_back(j);
+      ptrs.push_back(idxs.size());
+    }
+    if (idxs.size() < rows.size() * cast<ConstantInt>(n)->getZExtValue()) {
+      auto global = [&](ArrayRef<uint64_t> vals, const Twine &name) {
+        Constant *init = ConstantDataArray::get(Ctx, vals);
+        auto GV = new GlobalVariable(M, init->getType(), /*isConstant*/ true,
+                                     GlobalValue::PrivateLinkage, init, name);
+        GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        return ConstantExpr::getPointerCast(GV, PI);
+      };
+      rowptr = global(ptrs, "__enzyme_jacobian_rowptr");
+      colidx = global(idxs, "__enzyme_jacobian_colidx");
+      sparse = true;
+    }
+  }
+
+  BasicBlock *entry = CI->getParent();
+  BasicBlock *end = entry->splitBasicBlock(CI, "jacobian.end");
+  entry->getTerminator()->eraseFromParent();
+  B.SetInsertPoint(entry);
+  Function *F = entry->getParent();
+
+  // Color the columns and rows of the pattern, preferring forward mode on a
+  // tie as it needs no tape.
+  SmallVector<Value *, 4> toFree;
+  Value *colColors = nullptr, *numColColors = n;
+  Value *rowColors = nullptr, *numRowColors = m;
+  if (sparse) {
+    if (denseOut)
+      zeroElements(B, T, jac, B.CreateMul(m, n));
+    Value *colptr = allocElements(B, i64, B.CreateNSWAdd(n, B.getInt64(1)),
+                                  "jac.colptr");
+    Value *rowidx =
+        allocElements(B, i64, loadElement(B, i64, rowptr, m), "jac.rowidx");
+    B.CreateCall(getOrInsertSparsityTranspose(M),
+                 {m, n, rowptr, colidx, colptr, rowidx});
+    colColors = allocElements(B, i64, n, "jac.colcolors");
+    numColColors = B.CreateCall(getOrInsertSparsityColoring(M),
+                                {n, colptr, rowidx, rowptr, colidx, colColors});
+    rowColors = allocElements(B, i64, m, "jac.rowcolors");
+    numRowColors = B.CreateCall(getOrInsertSparsityColoring(M),
+                                {m, rowptr, colidx, colptr, rowidx, rowColors});
+    toFree.append({colptr, rowidx, colColors, rowColors});
+  }
+  Value *forward = B.CreateICmpSLE(numColColors, numRowColors);
+
+  auto md = [&](StringRef name) {
+    return MetadataAsValue::get(Ctx, MDString::get(Ctx, name));
+  };
+  auto emit = [&](IRBuilder<> &B, bool fwd) {
+    createSeedSweep(
+        B, T, jac, m, n, rowptr, colidx, denseOut,
+        fwd ? colColors : rowColors, fwd ? numColColors : numRowColors, fwd,
+        [&](IRBuilder<> &B, Value *seed, Value *res, uint64_t width) {
+          SmallVector<Value *, 16> args = {fn};
+          if (width > 1)
+            args.append({md("enzyme_width"), B.getInt64(width)});
+          for (auto pair : {std::make_tuple(y, fwd ? res : seed, m),
+                            std::make_tuple(x, fwd ? seed : res, n)}) {
+            args.append({md("enzyme_dup"), std::get<0>(pair)});
+            for (uint64_t k = 0; k < width; k++)
+              args.push_back(arrayElement(
+                  B, T, std::get<1>(pair),
+                  B.CreateMul(B.getInt64(k), std::get<2>(pair))));
+          }
+          for (Value *arg : rest)
+            args.append({md("enzyme_const"), arg});
+          auto diff = M.getOrInsertFunction(
+              fwd ? "__enzyme_fwddiff_jacobian" : "__enzyme_autodiff_jacobian",
+              FunctionType::get(Type::getVoidTy(Ctx), {}, true));
+          B.CreateCall(diff, args);
+        });
+  };
+
+  if (auto C = dyn_cast<ConstantInt>(forward)) {
+    emit(B, !C->isZero());
+  } else {
+    BasicBlock *fwdBB = BasicBlock::Create(Ctx, "jacobian.fwd", F);
+    BasicBlock *revBB = BasicBlock::Create(Ctx, "jacobian.rev", F);
+    BasicBlock *join = BasicBlock::Create(Ctx, "jacobian.join", F);
+    B.CreateCondBr(forward, fwdBB, revBB);
+    B.SetInsertPoint(fwdBB);
+    emit(B, true);
+    B.CreateBr(join);
+    B.SetInsertPoint(revBB);
+    emit(B, false);
+    B.CreateBr(join);
+    B.SetInsertPoint(join);
+  }
+  for (Value *V : toFree)
+    CreateDealloc(B, V);
+  B.CreateBr(end);
+  return true;
+}
+
+/// Replace a call __enzyme_hessian(fn, hess, x, n, args...), for fn
+/// T(T *x, args...), by loops computing the n x n row-major Hessian hess of
+/// fn with respect to x, from blocks of EnzymeJacobianWidth Hessian-vector
+/// products. If n is followed by enzyme_sparsity and the symmetric CSR
+/// sparsity pattern rowptr, colidx, hess instead receives the nonzeros of
+/// the pattern, and the products are taken with the sums of the columns of
+/// each color of a distance-2 coloring of the pattern. Returns false if the
+/// call is malformed.
+static bool lowerHessianCall(CallInst *CI) {
+  Module &M = *CI->getModule();
+  auto &Ctx = M.getContext();
+  Value *fnv = CI->getArgOperand(0);
+  while (auto CE = dyn_cast<ConstantExpr>(fnv)) {
+    fnv = CE->getOperand(0);
+  }
+  auto fn = dyn_cast<Function>(fnv);
+  FunctionType *FT = fn ? fn->getFunctionType() : nullptr;
+  if (!fn || !FT->getReturnType()->isFloatingPointTy() ||
+      FT->getNumParams() < 1 ||
+      FT->getParamType(0) != PointerType::getUnqual(FT->getReturnType())) {
+    EmitFailure("IllegalHessian", CI->getDebugLoc(), CI,
+                "__enzyme_hessian requires a function T(T *x, args...) of "
+                "floating point T, found ",
+                *fnv);
+    return false;
+  }
+#if LLVM_VERSION_MAJOR >= 14
+  unsigned numArgs = CI->arg_size();
+#else
+  unsigned numArgs = CI->getNumArgOperands();
+#endif
+  unsigned numFixed = 4;
+  bool sparse = false;
+  if (numArgs > numFixed) {
+    auto metaString = getMetadataName(CI->getArgOperand(numFixed));
+    sparse = metaString && *metaString == "enzyme_sparsity";
+  }
+  if (sparse)
+    numFixed += 3;
+  if (numArgs != numFixed + FT->getNumParams() - 1) {
+    EmitFailure("IllegalHessian", CI->getDebugLoc(), CI,
+                "__enzyme_hessian takes fn, hess, x, n, optionally "
+                "enzyme_sparsity, rowptr and colidx, and the remaining "
+                "arguments of fn, found ",
+                *CI);
+    return false;
+  }
+
+  Type *PT = FT->getParamType(0);
+  Type *T = FT->getReturnType();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PI = PointerType::getUnqual(i64);
+  IRBuilder<> B(CI);
+  auto getArg = [&](unsigned i, Type *PTy) -> Value * {
+    Value *arg = CI->getArgOperand(i);
+    if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+      return B.CreatePointerCast(arg, PTy);
+    if (arg->getType()->isIntegerTy() && PTy->isIntegerTy())
+      return B.CreateIntCast(arg, PTy, /*isSigned*/ false);
+    if (arg->getType() != PTy) {
+      EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                  "Cannot cast __enzyme_hessian argument ", i, ", found ",
+                  *arg, ", type ", *arg->getType(), " - to ", *PTy);
+      return nullptr;
+    }
+    return arg;
+  };
+  Value *hess = getArg(1, PT);
+  Value *x = getArg(2, PT);
+  Value *n = getArg(3, i64);
+  Value *rowptr = sparse ? getArg(5, PI) : nullptr;
+  Value *colidx = sparse ? getArg(6, PI) : nullptr;
+  SmallVector<Value *, 4> rest;
+  for (unsigned i = numFixed; i < numArgs; i++)
+    rest.push_back(getArg(i, FT->getParamType(i - numFixed + 1)));
+  if (!hess || !x || !n || (sparse && (!rowptr || !colidx)) ||
+      llvm::is_contained(rest, nullptr))
+    return false;
+
+  BasicBlock *entry = CI->getParent();
+  BasicBlock *end = entry->splitBasicBlock(CI, "hessian.end");
+  entry->getTerminator()->eraseFromParent();
+  B.SetInsertPoint(entry);
+
+  // The gradient computed alongside each product is not needed.
+  Value *grad = allocElements(B, T, n, "hess.grad");
+  zeroElements(B, T, grad, n);
+
+  // A symmetric pattern is its own transpose, so the columns can be colored
+  // without forming it.
+  Value *colors = nullptr, *numColors = n;
+  if (sparse) {
+    colors = allocElements(B, i64, n, "hess.colors");
+    numColors = B.CreateCall(getOrInsertSparsityColoring(M),
+                             {n, rowptr, colidx, rowptr, colidx, colors});
+  }
+
+  auto md = [&](StringRef name) {
+    return MetadataAsValue::get(Ctx, MDString::get(Ctx, name));
+  };
+  createSeedSweep(
+      B, T, hess, n, n, rowptr, colidx, /*denseOut*/ !sparse, colors,
+      numColors, /*fwd*/ true,
+      [&](IRBuilder<> &B, Value *seed, Value *res, uint64_t width) {
+        SmallVector<Value *, 16> args = {fn};
+        if (width > 1)
+          args.append({md("enzyme_width"), B.getInt64(width)});
+        args.push_back(x);
+        for (uint64_t k = 0; k < width; k++)
+          args.push_back(
+              arrayElement(B, T, seed, B.CreateMul(B.getInt64(k), n)));
+        args.push_back(grad);
+        for (uint64_t k = 0; k < width; k++)
+          args.push_back(
+              arrayElement(B, T, res, B.CreateMul(B.getInt64(k), n)));
+        for (Value *arg : rest)
+          args.append({md("enzyme_const"), arg});
+        auto hvp = M.getOrInsertFunction(
+            "__enzyme_hvp_hessian",
+            FunctionType::get(Type::getVoidTy(Ctx), {}, true));
+        B.CreateCall(hvp, args);
+      });
+  CreateDealloc(B, grad);
+  if (colors)
+    CreateDealloc(B, colors);
+  B.CreateBr(end);
+  return true;
+}
+
+/// The type info of a call to fn derived from the types of its arguments.
+static FnTypeInfo getArgumentTypeInfo(Function *fn) {
+  FnTypeInfo type_args(fn);
+  for (auto &a : type_args.Function->args()) {
+    TypeTree dt;
+    if (a.getType()->isFPOrFPVectorTy()) {
+      dt = ConcreteType(a.getType()->getScalarType());
+    } else if (a.getType()->isPointerTy()) {
+#if LLVM_VERSION_MAJOR >= 15
+      if (a.getContext().supportsTypedPointers()) {
+#endif
+        auto et = a.getType()->getPointerElementType();
+        if (et->isFPOrFPVectorTy()) {
+          dt = TypeTree(ConcreteType(et->getScalarType())).Only(-1, nullptr);
+        } else if (et->isPointerTy()) {
+          dt = TypeTree(ConcreteType(BaseType::Pointer)).Only(-1, nullptr);
+        }
+#if LLVM_VERSION_MAJOR >= 15
+      }
+#endif
+      dt.insert({}, BaseType::Pointer);
+    } else if (a.getType()->isIntOrIntVectorTy()) {
+      dt = ConcreteType(BaseType::Integer);
+    }
+    type_args.Arguments.insert(
+        std::pair<Argument *, TypeTree>(&a, dt.Only(-1, nullptr)));
+    // TODO note that here we do NOT propagate constants in type info (and
+    // should consider whether we should)
+    type_args.KnownValues.insert(
+        std::pair<Argument *, std::set<int64_t>>(&a, {}));
+  }
+  return type_args;
+}
+
 static Value *adaptReturnedVector(CallInst *CI, Value *diffret,
                                   IRBuilder<> &Builder, unsigned width) {
   /// Actual return type (including struct return)
@@ -590,6 +1380,111 @@ static Value *adaptReturnedVector(CallInst *CI, Value *diffret,
   return diffret;
 }
 
+/// Computes a width-wide forward mode derivative by calling fn, the
+/// derivative of width stripWidth, on successive slices of the shadow
+/// arguments args[shadowArgs] in a runtime loop, and remFn on the remaining
+/// directions. Returns the calls made and sets result to the width-wide
+/// shadow return, if any.
+static SmallVector<CallInst *, 2>
+stripMineForwardCall(IRBuilder<> &Builder, CallInst *CI, Function *fn,
+                     Function *remFn, ArrayRef<Value *> args,
+                     const std::set<unsigned> &shadowArgs, unsigned width,
+                     unsigned stripWidth, Value *&result) {
+  auto &Ctx = CI->getContext();
+  Function *F = CI->getParent()->getParent();
+  IRBuilder<> EB(&F->getEntryBlock().front());
+  Type *I64 = Type::getInt64Ty(Ctx);
+
+  SmallVector<AllocaInst *, 4> spills(args.size(), nullptr);
+  for (auto idx : shadowArgs) {
+    spills[idx] = EB.CreateAlloca(args[idx]->getType());
+    Builder.CreateStore(args[idx], spills[idx]);
+  }
+
+  // A single direction is passed unwrapped rather than as a [1 x T].
+  auto shadowTy = [](Type *T, unsigned n) -> Type * {
+    return n == 1 ? T : ArrayType::get(T, n);
+  };
+
+  AllocaInst *resAlloc = nullptr;
+  Type *retTy = fn->getReturnType();
+  if (!retTy->isVoidTy() && !retTy->isEmptyTy())
+    resAlloc = EB.CreateAlloca(ArrayType::get(
+        stripWidth == 1 ? retTy : cast<ArrayType>(retTy)->getElementType(),
+        width));
+
+  // Pointer to the n directions of the width-wide array in alloc starting at
+  // direction start.
+  auto slice = [&](IRBuilder<> &B, AllocaInst *alloc, Value *start,
+                   unsigned n) -> Value * {
+    auto AT = cast<ArrayType>(alloc->getAllocatedType());
+    Value *idxs[] = {ConstantInt::get(I64, 0), start};
+    Value *ptr = B.CreateInBoundsGEP(AT, alloc, idxs);
+    return B.CreatePointerCast(
+        ptr, PointerType::get(shadowTy(AT->getElementType(), n),
+                              alloc->getType()->getPointerAddressSpace()));
+  };
+
+  SmallVector<CallInst *, 2> calls;
+  auto emitCall = [&](IRBuilder<> &B, Function *callee, Value *start,
+                      unsigned n) {
+    SmallVector<Value *, 4> sargs(args.begin(), args.end());
+    for (auto idx : shadowArgs) {
+      auto AT = cast<ArrayType>(args[idx]->getType());
+#if LLVM_VERSION_MAJOR > 7
+      sargs[idx] = B.CreateLoad(shadowTy(AT->getElementType(), n),
+                                slice(B, spills[idx], start, n));
+#else
+      sargs[idx] = B.CreateLoad(slice(B, spills[idx], start, n));
+#endif
+    }
+    CallInst *call = B.CreateCall(callee, sargs);
+    call->setCallingConv(CI->getCallingConv());
+    call->setDebugLoc(CI->getDebugLoc());
+    if (resAlloc)
+      B.CreateStore(call, slice(B, resAlloc, start, n));
+    calls.push_back(call);
+  };
+
+  BasicBlock *pre = CI->getParent();
+  BasicBlock *post = pre->splitBasicBlock(CI, pre->getName() + ".strip.end");
+  pre->getTerminator()->eraseFromParent();
+  BasicBlock *loop =
+      BasicBlock::Create(Ctx, pre->getName() + ".strip", F, post);
+  IRBuilder<> LB(pre);
+  LB.CreateBr(loop);
+
+  LB.SetInsertPoint(loop);
+  LB.setFastMathFlags(Builder.getFastMathFlags());
+  PHINode *iv = LB.CreatePHI(I64, 2, "strip.iv");
+  iv->addIncoming(ConstantInt::get(I64, 0), pre);
+  Value *start = LB.CreateMul(iv, ConstantInt::get(I64, stripWidth), "",
+                              /*NUW*/ true, /*NSW*/ true);
+  emitCall(LB, fn, start, stripWidth);
+  Value *next = LB.CreateAdd(iv, ConstantInt::get(I64, 1), "strip.iv.next",
+                             /*NUW*/ true, /*NSW*/ true);
+  iv->addIncoming(next, loop);
+  LB.CreateCondBr(
+      LB.CreateICmpEQ(next, ConstantInt::get(I64, width / stripWidth)), post,
+      loop);
+
+  Builder.SetInsertPoint(CI);
+  if (remFn)
+    emitCall(Builder, remFn,
+             ConstantInt::get(I64, width - width % stripWidth),
+             width % stripWidth);
+
+  if (resAlloc)
+#if LLVM_VERSION_MAJOR > 7
+    result = Builder.CreateLoad(resAlloc->getAllocatedType(), resAlloc);
+#else
+    result = Builder.CreateLoad(resAlloc);
+#endif
+  else
+    result = calls[0];
+  return calls;
+}
+
 static bool replaceOriginalCall(CallInst *CI, Function *fn, Value *diffret,
                                 IRBuilder<> &Builder, DerivativeMode mode) {
   StructType *CIsty = dyn_cast<StructType>(CI->getType());
@@ -966,6 +1861,462 @@ public:
     return true;
   }
 
+  /// Lower a call __enzyme_batch_autodiff(fn, enzyme_width, width, args...)
+  /// to the gradient of fn for width samples at once, computed by a single
+  /// batched function. Each argument is given once per sample, unless marked
+  /// enzyme_scalar if the same in all of them. Pointer arguments not marked
+  /// enzyme_const are followed by a shadow per sample, into which the
+  /// gradient of that sample is accumulated. A floating point return is
+  /// seeded with 1 in every sample.
+  bool HandleBatchAutoDiff(CallInst *CI) {
+    Function *fn;
+    auto parsedFunction = parseFunctionParameter(CI);
+    if (parsedFunction.hasValue()) {
+      fn = parsedFunction.getValue();
+    } else {
+      return false;
+    }
+    unsigned width;
+    auto parsedWidth = parseWidthParameter(CI);
+    if (parsedWidth.hasValue()) {
+      width = parsedWidth.getValue();
+    } else {
+      return false;
+    }
+
+    FunctionType *FT = fn->getFunctionType();
+    Type *RetTy = FT->getReturnType();
+    if (!RetTy->isVoidTy() && !RetTy->isFloatingPointTy()) {
+      EmitFailure("IllegalReturnType", CI->getDebugLoc(), CI,
+                  "__enzyme_batch_autodiff does not support returning ",
+                  *RetTy);
+      return false;
+    }
+#if LLVM_VERSION_MAJOR >= 14
+    unsigned numArgs = CI->arg_size();
+#else
+    unsigned numArgs = CI->getNumArgOperands();
+#endif
+    IRBuilder<> Builder(CI);
+    auto getArg = [&](unsigned i, Type *PTy) -> Value * {
+      if (i >= numArgs) {
+        EmitFailure("MissingArg", CI->getDebugLoc(), CI,
+                    "__enzyme_batch_autodiff missing argument at index ", i,
+                    ", need argument of type ", *PTy, " at call ", *CI);
+        return nullptr;
+      }
+      Value *arg = CI->getArgOperand(i);
+      if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+        return Builder.CreatePointerCast(arg, PTy);
+      if (arg->getType() != PTy) {
+        EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                    "Cannot cast __enzyme_batch_autodiff argument ", i,
+                    ", found ", *arg, ", type ", *arg->getType(), " - to ",
+                    *PTy);
+        return nullptr;
+      }
+      return arg;
+    };
+    // The width arguments from index i on, as an array if width > 1.
+    auto getLanes = [&](unsigned &i, Type *PTy) -> Value * {
+      Value *res = width > 1
+                       ? UndefValue::get(ArrayType::get(PTy, width))
+                       : nullptr;
+      for (unsigned v = 0; v < width; ++v) {
+        Value *element = getArg(v == 0 ? i : ++i, PTy);
+        if (!element)
+          return nullptr;
+        res = width > 1 ? Builder.CreateInsertValue(res, element, {v})
+                        : element;
+      }
+      return res;
+    };
+
+    SmallVector<Value *, 8> args;
+    std::vector<DIFFE_TYPE> constants;
+    SmallVector<BATCH_TYPE, 4> arg_types;
+    unsigned truei = 0;
+    for (unsigned i = 1; i < numArgs; ++i) {
+      bool constant = false;
+      bool scalar = false;
+      Optional<StringRef> metaString = getMetadataName(CI->getArgOperand(i));
+      if (metaString && *metaString == "enzyme_width") {
+        ++i;
+        continue;
+      }
+      while (metaString && metaString.getValue().startswith("enzyme_")) {
+        if (*metaString == "enzyme_const") {
+          constant = true;
+        } else if (*metaString == "enzyme_scalar") {
+          scalar = true;
+        } else if (*metaString != "enzyme_dup") {
+          EmitFailure("IllegalDiffeType", CI->getDebugLoc(), CI,
+                      "illegal enzyme metadata classification ", *CI,
+                      *metaString);
+          return false;
+        }
+        if (++i >= numArgs)
+          break;
+        metaString = getMetadataName(CI->getArgOperand(i));
+      }
+      if (truei >= FT->getNumParams()) {
+        EmitFailure("TooManyArgs", CI->getDebugLoc(), CI,
+                    "Had too many arguments to __enzyme_batch_autodiff", *CI);
+        return false;
+      }
+      Type *PTy = FT->getParamType(truei);
+      if (!PTy->isPointerTy())
+        constant = true;
+      Value *arg = scalar ? getArg(i, PTy) : getLanes(i, PTy);
+      if (!arg)
+        return false;
+      args.push_back(arg);
+      if (!constant) {
+        ++i;
+        Value *shadow = getLanes(i, PTy);
+        if (!shadow)
+          return false;
+        args.push_back(shadow);
+      }
+      constants.push_back(constant ? DIFFE_TYPE::CONSTANT
+                                   : DIFFE_TYPE::DUP_ARG);
+      arg_types.push_back(scalar ? BATCH_TYPE::SCALAR : BATCH_TYPE::VECTOR);
+      ++truei;
+    }
+    unsigned numParams = FT->getNumParams();
+    if (truei < numParams) {
+      EmitFailure(
+          "EnzymeInsufficientArgs", CI->getDebugLoc(), CI,
+          "Insufficient number of args passed to derivative call required ",
+          numParams, " primal args, found ", truei);
+      return false;
+    }
+
+    // Arguments are not overwritten between the two sweeps of the combined
+    // gradient.
+    std::map<Argument *, bool> uncacheable_args;
+    for (auto &arg : fn->args())
+      uncacheable_args[&arg] = false;
+    TypeAnalysis TA(Logic.PPC.FAM);
+    FnTypeInfo type_args =
+        TA.analyzeFunction(getArgumentTypeInfo(fn)).getAnalyzedTypeInfo();
+    DIFFE_TYPE retType =
+        RetTy->isVoidTy() ? DIFFE_TYPE::CONSTANT : DIFFE_TYPE::OUT_DIFF;
+    Function *newFunc = Logic.CreateBatchedGradient(
+        (ReverseCacheKey){.todiff = fn,
+                          .retType = retType,
+                          .constant_args = constants,
+                          .uncacheable_args = uncacheable_args,
+                          .returnUsed = false,
+                          .shadowReturnUsed = false,
+                          .mode = DerivativeMode::ReverseModeCombined,
+                          .width = 1,
+                          .freeMemory = true,
+                          .AtomicAdd = false,
+                          .additionalType = nullptr,
+                          .typeInfo = type_args},
+        TA, width, arg_types);
+    if (!newFunc)
+      return false;
+    if (retType == DIFFE_TYPE::OUT_DIFF)
+      args.push_back(ConstantFP::get(RetTy, 1.0));
+    CallInst *call = Builder.CreateCall(newFunc, args);
+    call->setCallingConv(CI->getCallingConv());
+    call->setDebugLoc(CI->getDebugLoc());
+    if (!CI->getType()->isVoidTy())
+      CI->replaceAllUsesWith(UndefValue::get(CI->getType()));
+    CI->eraseFromParent();
+    return true;
+  }
+
+  /// Lower a call __enzyme_taylor(fn, order, args...) to one of the Taylor
+  /// mode counterpart of fn, propagating truncated Taylor series of the
+  /// constant degree order. If fn returns a floating point scalar, order is
+  /// followed by a pointer receiving its coefficients of order 0 to order,
+  /// and the call returns the primal result. Each floating point or pointer
+  /// argument not marked enzyme_const is followed by its coefficients of
+  /// order 1 to order, as values for a scalar and as pointers to memory of
+  /// the coefficients for a pointer.
+  bool HandleTaylor(CallInst *CI) {
+    Function *fn;
+    auto parsedFunction = parseFunctionParameter(CI);
+    if (parsedFunction.hasValue()) {
+      fn = parsedFunction.getValue();
+    } else {
+      return false;
+    }
+#if LLVM_VERSION_MAJOR >= 14
+    unsigned numArgs = CI->arg_size();
+#else
+    unsigned numArgs = CI->getNumArgOperands();
+#endif
+    auto orderArg =
+        numArgs > 1 ? dyn_cast<ConstantInt>(CI->getArgOperand(1)) : nullptr;
+    if (!orderArg || orderArg->isZero() || orderArg->getZExtValue() > 64) {
+      EmitFailure("IllegalTaylorOrder", CI->getDebugLoc(), CI,
+                  "__enzyme_taylor requires a constant order between 1 and "
+                  "64 following the function, found ",
+                  *CI);
+      return false;
+    }
+    unsigned order = orderArg->getZExtValue();
+
+    FunctionType *FT = fn->getFunctionType();
+    Type *RetTy = FT->getReturnType();
+    bool hasOut = RetTy->isFloatingPointTy();
+    if (RetTy->isFPOrFPVectorTy() && !hasOut) {
+      EmitFailure("IllegalTaylor", CI->getDebugLoc(), CI,
+                  "__enzyme_taylor does not support returning ", *RetTy);
+      return false;
+    }
+    IRBuilder<> Builder(CI);
+    auto getArg = [&](unsigned i, Type *PTy) -> Value * {
+      if (i >= numArgs) {
+        EmitFailure("MissingArg", CI->getDebugLoc(), CI,
+                    "__enzyme_taylor missing argument at index ", i,
+                    ", need argument of type ", *PTy, " at call ", *CI);
+        return nullptr;
+      }
+      Value *arg = CI->getArgOperand(i);
+      if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+        return Builder.CreatePointerCast(arg, PTy);
+      if (arg->getType()->isIntegerTy() && PTy->isIntegerTy())
+        return Builder.CreateIntCast(arg, PTy, /*isSigned*/ false);
+      if (arg->getType() != PTy) {
+        EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                    "Cannot cast __enzyme_taylor argument ", i, ", found ",
+                    *arg, ", type ", *arg->getType(), " - to ", *PTy);
+        return nullptr;
+      }
+      return arg;
+    };
+
+    unsigned i = 2;
+    Value *out = nullptr;
+    if (hasOut && !(out = getArg(i++, PointerType::getUnqual(RetTy))))
+      return false;
+
+    SmallVector<Value *, 8> args;
+    std::vector<DIFFE_TYPE> constants;
+    unsigned truei = 0;
+    for (; i < numArgs; ++i) {
+      Value *res = CI->getArgOperand(i);
+      bool constant = false;
+      Optional<StringRef> metaString = getMetadataName(res);
+      if (metaString && metaString.getValue().startswith("enzyme_")) {
+        if (*metaString == "enzyme_const") {
+          constant = true;
+        } else if (*metaString != "enzyme_dup") {
+          EmitFailure("IllegalDiffeType", CI->getDebugLoc(), CI,
+                      "illegal enzyme metadata classification ", *CI,
+                      *metaString);
+          return false;
+        }
+        ++i;
+      }
+      if (truei >= FT->getNumParams()) {
+        EmitFailure("TooManyArgs", CI->getDebugLoc(), CI,
+                    "Had too many arguments to __enzyme_taylor", *CI);
+        return false;
+      }
+      Type *PTy = FT->getParamType(truei);
+      if (!PTy->isFloatingPointTy() && !PTy->isPointerTy())
+        constant = true;
+      Value *arg = getArg(i, PTy);
+      if (!arg)
+        return false;
+      args.push_back(arg);
+      if (!constant) {
+        Value *coeffs = order > 1
+                            ? UndefValue::get(ArrayType::get(PTy, order))
+                            : nullptr;
+        for (unsigned k = 0; k < order; ++k) {
+          Value *coeff = getArg(++i, PTy);
+          if (!coeff)
+            return false;
+          coeffs = order > 1 ? Builder.CreateInsertValue(coeffs, coeff, {k})
+                             : coeff;
+        }
+        args.push_back(coeffs);
+      }
+      constants.push_back(constant ? DIFFE_TYPE::CONSTANT
+                                   : DIFFE_TYPE::DUP_ARG);
+      ++truei;
+    }
+    unsigned numParams = FT->getNumParams();
+    if (truei < numParams) {
+      EmitFailure(
+          "EnzymeInsufficientArgs", CI->getDebugLoc(), CI,
+          "Insufficient number of args passed to derivative call required ",
+          numParams, " primal args, found ", truei);
+      return false;
+    }
+
+    Function *newFunc = Logic.CreateTaylor(fn, constants, order);
+    if (!newFunc)
+      return false;
+    CallInst *call = Builder.CreateCall(newFunc, args);
+    call->setCallingConv(CI->getCallingConv());
+    call->setDebugLoc(CI->getDebugLoc());
+    Value *primal = call;
+    if (hasOut) {
+      for (unsigned k = 0; k <= order; ++k) {
+        Value *coeff = Builder.CreateExtractValue(call, {k});
+        if (k == 0)
+          primal = coeff;
+#if LLVM_VERSION_MAJOR > 7
+        Builder.CreateStore(
+            coeff, Builder.CreateConstInBoundsGEP1_64(RetTy, out, k));
+#else
+        Builder.CreateStore(coeff, Builder.CreateConstInBoundsGEP1_64(out, k));
+#endif
+      }
+    }
+    if (!CI->getType()->isVoidTy())
+      CI->replaceAllUsesWith(primal->getType() == CI->getType()
+                                 ? primal
+                                 : UndefValue::get(CI->getType()));
+    CI->eraseFromParent();
+    return true;
+  }
+
+  /// Lower a call __enzyme_hvp(fn, args...), for fn returning a floating
+  /// point scalar, to one of the Hessian-vector product of fn. Each pointer
+  /// argument is passed as x, the direction(s) v, the gradient g and the
+  /// product(s) Hv, the latter two being accumulated into, unless marked
+  /// enzyme_const. Other arguments are constant.
+  bool HandleHVP(CallInst *CI) {
+    Function *fn;
+    auto parsedFunction = parseFunctionParameter(CI);
+    if (parsedFunction.hasValue()) {
+      fn = parsedFunction.getValue();
+    } else {
+      return false;
+    }
+    unsigned width;
+    auto parsedWidth = parseWidthParameter(CI);
+    if (parsedWidth.hasValue()) {
+      width = parsedWidth.getValue();
+    } else {
+      return false;
+    }
+
+    FunctionType *FT = fn->getFunctionType();
+    if (!FT->getReturnType()->isFloatingPointTy()) {
+      EmitFailure("IllegalHVP", CI->getDebugLoc(), CI,
+                  "__enzyme_hvp requires a function returning a floating "
+                  "point scalar, found ",
+                  *fn);
+      return false;
+    }
+#if LLVM_VERSION_MAJOR >= 14
+    unsigned numArgs = CI->arg_size();
+#else
+    unsigned numArgs = CI->getNumArgOperands();
+#endif
+    IRBuilder<> Builder(CI);
+    auto getArg = [&](unsigned i, Type *PTy) -> Value * {
+      if (i >= numArgs) {
+        EmitFailure("MissingArg", CI->getDebugLoc(), CI,
+                    "__enzyme_hvp missing argument at index ", i,
+                    ", need argument of type ", *PTy, " at call ", *CI);
+        return nullptr;
+      }
+      Value *arg = CI->getArgOperand(i);
+      if (arg->getType()->isPointerTy() && PTy->isPointerTy())
+        return Builder.CreatePointerCast(arg, PTy);
+      if (arg->getType() != PTy) {
+        EmitFailure("IllegalArgCast", CI->getDebugLoc(), CI,
+                    "Cannot cast __enzyme_hvp argument ", i, ", found ",
+                    *arg, ", type ", *arg->getType(), " - to ", *PTy);
+        return nullptr;
+      }
+      return arg;
+    };
+    // The width arguments following index i, as an array if width > 1.
+    auto getShadow = [&](unsigned &i, Type *PTy) -> Value * {
+      Value *res = width > 1
+                       ? UndefValue::get(ArrayType::get(PTy, width))
+                       : nullptr;
+      for (unsigned v = 0; v < width; ++v) {
+        Value *element = getArg(++i, PTy);
+        if (!element)
+          return nullptr;
+        res = width > 1 ? Builder.CreateInsertValue(res, element, {v})
+                        : element;
+      }
+      return res;
+    };
+
+    SmallVector<Value *, 8> args;
+    std::vector<DIFFE_TYPE> constants;
+    unsigned truei = 0;
+    for (unsigned i = 1; i < numArgs; ++i) {
+      Value *res = CI->getArgOperand(i);
+      bool constant = false;
+      Optional<StringRef> metaString = getMetadataName(res);
+      if (metaString && metaString.getValue().startswith("enzyme_")) {
+        if (*metaString == "enzyme_width") {
+          ++i;
+          continue;
+        } else if (*metaString == "enzyme_const") {
+          constant = true;
+        } else if (*metaString != "enzyme_dup") {
+          EmitFailure("IllegalDiffeType", CI->getDebugLoc(), CI,
+                      "illegal enzyme metadata classification ", *CI,
+                      *metaString);
+          return false;
+        }
+        ++i;
+      }
+      if (truei >= FT->getNumParams()) {
+        EmitFailure("TooManyArgs", CI->getDebugLoc(), CI,
+                    "Had too many arguments to __enzyme_hvp", *CI);
+        return false;
+      }
+      Type *PTy = FT->getParamType(truei);
+      if (!PTy->isPointerTy())
+        constant = true;
+      Value *arg = getArg(i, PTy);
+      if (!arg)
+        return false;
+      args.push_back(arg);
+      if (!constant) {
+        Value *dir = getShadow(i, PTy);
+        Value *grad = dir ? getArg(++i, PTy) : nullptr;
+        Value *prod = grad ? getShadow(i, PTy) : nullptr;
+        if (!prod)
+          return false;
+        args.append({dir, grad, prod});
+      }
+      constants.push_back(constant ? DIFFE_TYPE::CONSTANT
+                                   : DIFFE_TYPE::DUP_ARG);
+      ++truei;
+    }
+    unsigned numParams = FT->getNumParams();
+    if (truei < numParams) {
+      EmitFailure(
+          "EnzymeInsufficientArgs", CI->getDebugLoc(), CI,
+          "Insufficient number of args passed to derivative call required ",
+          numParams, " primal args, found ", truei);
+      return false;
+    }
+
+    TypeAnalysis TA(Logic.PPC.FAM);
+    FnTypeInfo type_args =
+        TA.analyzeFunction(getArgumentTypeInfo(fn)).getAnalyzedTypeInfo();
+    Function *newFunc =
+        Logic.CreateHessianVectorProduct(fn, constants, TA, type_args, width);
+    args.push_back(ConstantFP::get(FT->getReturnType(), 1.0));
+    CallInst *call = Builder.CreateCall(newFunc, args);
+    call->setCallingConv(CI->getCallingConv());
+    call->setDebugLoc(CI->getDebugLoc());
+    if (!CI->getType()->isVoidTy())
+      CI->replaceAllUsesWith(UndefValue::get(CI->getType()));
+    CI->eraseFromParent();
+    return true;
+  }
+
   /// Return whether successful
   bool HandleAutoDiff(CallInst *CI, DerivativeMode mode, bool sizeOnly) {
 
@@ -985,6 +2336,8 @@ public:
     unsigned truei = 0;
     unsigned width = 1;
     std::map<unsigned, Value *> batchOffset;
+    // Indices into args of the [width x T] shadow arguments.
+    std::set<unsigned> shadowArgs;
     bool returnUsed =
         !fn->getReturnType()->isVoidTy() && !fn->getReturnType()->isEmptyTy();
 
@@ -1062,6 +2415,9 @@ public:
       }
 
       args.push_back(primal);
+      if (width > 1 && (mode == DerivativeMode::ForwardMode ||
+                        mode == DerivativeMode::ForwardModeSplit))
+        shadowArgs.insert(args.size());
       args.push_back(shadow);
       constants.push_back(DIFFE_TYPE::DUP_ARG);
     }
@@ -1229,9 +2585,13 @@ public:
       }
 
       if (truei >= FT->getNumParams()) {
+        // The seed of the return may also be given in combined mode, e.g.
+        // to differentiate several cotangents of it at once.
         if (!isa<MetadataAsValue>(res) &&
             (mode == DerivativeMode::ReverseModeGradient ||
-             mode == DerivativeMode::ForwardModeSplit)) {
+             mode == DerivativeMode::ForwardModeSplit ||
+             (mode == DerivativeMode::ReverseModeCombined &&
+              differentialReturn && differet == nullptr))) {
           if (differentialReturn && differet == nullptr) {
             differet = res;
             if (CI->paramHasAttr(i, Attribute::ByVal)) {
@@ -1242,9 +2602,33 @@ public:
               differet = Builder.CreateLoad(differet);
 #endif
             }
-            if (differet->getType() != fn->getReturnType())
+            Type *seedTy =
+                GradientUtils::getShadowType(fn->getReturnType(), width);
+            // With a width, the seeds may also be given one per lane.
+            if (width > 1 && differet->getType() == fn->getReturnType()) {
+              Value *seeds = UndefValue::get(seedTy);
+              seeds = Builder.CreateInsertValue(seeds, differet, {0});
+              for (unsigned v = 1; v < width; ++v) {
+                ++i;
+#if LLVM_VERSION_MAJOR >= 14
+                if (i >= CI->arg_size() ||
+#else
+                if (i >= CI->getNumArgOperands() ||
+#endif
+                    CI->getArgOperand(i)->getType() != fn->getReturnType()) {
+                  EmitFailure("BadDiffRet", CI->getDebugLoc(), CI,
+                              "Expected ", width, " seeds of type ",
+                              *fn->getReturnType(), " in ", *CI);
+                  return false;
+                }
+                seeds =
+                    Builder.CreateInsertValue(seeds, CI->getArgOperand(i), {v});
+              }
+              differet = seeds;
+            }
+            if (differet->getType() != seedTy)
               if (auto ST0 = dyn_cast<StructType>(differet->getType()))
-                if (auto ST1 = dyn_cast<StructType>(fn->getReturnType()))
+                if (auto ST1 = dyn_cast<StructType>(seedTy))
                   if (ST0->isLayoutIdentical(ST1)) {
                     IRBuilder<> B(&Builder.GetInsertBlock()
                                        ->getParent()
@@ -1261,10 +2645,10 @@ public:
 #endif
                   }
 
-            if (differet->getType() != fn->getReturnType()) {
+            if (differet->getType() != seedTy) {
               EmitFailure("BadDiffRet", CI->getDebugLoc(), CI,
                           "Bad DiffRet type ", *differet, " expected ",
-                          *fn->getReturnType());
+                          *seedTy);
               return false;
             }
             continue;
@@ -1414,6 +2798,8 @@ public:
           }
         }
 
+        if (width > 1)
+          shadowArgs.insert(args.size());
         args.push_back(res);
       }
 
@@ -1429,51 +2815,37 @@ public:
     }
 
     std::map<Argument *, bool> volatile_args;
-    FnTypeInfo type_args(fn);
-    for (auto &a : type_args.Function->args()) {
+    for (auto &a : fn->args())
       volatile_args[&a] = !(mode == DerivativeMode::ReverseModeCombined);
-      TypeTree dt;
-      if (a.getType()->isFPOrFPVectorTy()) {
-        dt = ConcreteType(a.getType()->getScalarType());
-      } else if (a.getType()->isPointerTy()) {
-#if LLVM_VERSION_MAJOR >= 15
-        if (a.getContext().supportsTypedPointers()) {
-#endif
-          auto et = a.getType()->getPointerElementType();
-          if (et->isFPOrFPVectorTy()) {
-            dt = TypeTree(ConcreteType(et->getScalarType())).Only(-1, nullptr);
-          } else if (et->isPointerTy()) {
-            dt = TypeTree(ConcreteType(BaseType::Pointer)).Only(-1, nullptr);
-          }
-#if LLVM_VERSION_MAJOR >= 15
-        }
-#endif
-        dt.insert({}, BaseType::Pointer);
-      } else if (a.getType()->isIntOrIntVectorTy()) {
-        dt = ConcreteType(BaseType::Integer);
-      }
-      type_args.Arguments.insert(
-          std::pair<Argument *, TypeTree>(&a, dt.Only(-1, nullptr)));
-      // TODO note that here we do NOT propagate constants in type info (and
-      // should consider whether we should)
-      type_args.KnownValues.insert(
-          std::pair<Argument *, std::set<int64_t>>(&a, {}));
-    }
+    FnTypeInfo type_args = getArgumentTypeInfo(fn);
 
     TypeAnalysis TA(Logic.PPC.FAM);
     type_args = TA.analyzeFunction(type_args).getAnalyzedTypeInfo();
 
     // differentiate fn
     Function *newFunc = nullptr;
+    // Derivative of the remaining width % EnzymeVectorStripWidth directions,
+    // when strip mining a wide forward mode derivative.
+    Function *remFunc = nullptr;
+    bool stripMine = false;
     Type *tapeType = nullptr;
     const AugmentedReturn *aug;
     switch (mode) {
     case DerivativeMode::ForwardMode:
+      stripMine = EnzymeVectorStripWidth > 0 && width > EnzymeVectorStripWidth;
       newFunc = Logic.CreateForwardDiff(
           fn, retType, constants, TA,
-          /*should return*/ false, mode, freeMemory, width,
+          /*should return*/ false, mode, freeMemory,
+          stripMine ? (unsigned)EnzymeVectorStripWidth : width,
           /*addedType*/ nullptr, type_args, volatile_args,
           /*augmented*/ nullptr);
+      if (stripMine && width % EnzymeVectorStripWidth != 0)
+        remFunc = Logic.CreateForwardDiff(
+            fn, retType, constants, TA,
+            /*should return*/ false, mode, freeMemory,
+            width % EnzymeVectorStripWidth,
+            /*addedType*/ nullptr, type_args, volatile_args,
+            /*augmented*/ nullptr);
       break;
     case DerivativeMode::ForwardModeSplit: {
       bool forceAnonymousTape = !sizeOnly && allocatedTapeSize == -1;
@@ -1678,17 +3050,29 @@ public:
       return false;
     }
     assert(args.size() == newFunc->getFunctionType()->getNumParams());
-    CallInst *diffretc = cast<CallInst>(Builder.CreateCall(newFunc, args));
-    diffretc->setCallingConv(CI->getCallingConv());
-    diffretc->setDebugLoc(CI->getDebugLoc());
-#if LLVM_VERSION_MAJOR >= 9
-    for (auto pair : byVal) {
-      diffretc->addParamAttr(
-          pair.first,
-          Attribute::getWithByValType(diffretc->getContext(), pair.second));
+    CallInst *diffretc;
+    Value *diffret;
+    SmallVector<CallInst *, 2> diffcalls;
+    if (stripMine) {
+      diffcalls =
+          stripMineForwardCall(Builder, CI, newFunc, remFunc, args, shadowArgs,
+                               width, EnzymeVectorStripWidth, diffret);
+      diffretc = diffcalls[0];
+    } else {
+      diffretc = cast<CallInst>(Builder.CreateCall(newFunc, args));
+      diffretc->setCallingConv(CI->getCallingConv());
+      diffretc->setDebugLoc(CI->getDebugLoc());
+      diffcalls.push_back(diffretc);
+      diffret = diffretc;
     }
+#if LLVM_VERSION_MAJOR >= 9
+    for (auto call : diffcalls)
+      for (auto pair : byVal) {
+        call->addParamAttr(
+            pair.first,
+            Attribute::getWithByValType(call->getContext(), pair.second));
+      }
 #endif
-    Value *diffret = diffretc;
     if (mode == DerivativeMode::ReverseModePrimal && tape) {
       if (aug->returns.find(AugmentedStruct::Tape) != aug->returns.end()) {
         auto tapeIdx = aug->returns.find(AugmentedStruct::Tape)->second;
@@ -1838,7 +3222,9 @@ public:
               Fn->getName().contains("__enzyme_augmentfwd") ||
               Fn->getName().contains("__enzyme_augmentsize") ||
               Fn->getName().contains("__enzyme_reverse") ||
-              Fn->getName().contains("__enzyme_batch")))
+              Fn->getName().contains("__enzyme_batch") ||
+              Fn->getName().contains("__enzyme_hvp") ||
+              Fn->getName().contains("__enzyme_taylor")))
           continue;
 
         SmallVector<Value *, 16> CallArgs(II->arg_begin(), II->arg_end());
@@ -1875,6 +3261,9 @@ public:
     MapVector<CallInst *, DerivativeMode> toVirtual;
     MapVector<CallInst *, DerivativeMode> toSize;
     SmallVector<CallInst *, 4> toBatch;
+    SmallVector<CallInst *, 4> toBatchAutoDiff;
+    SmallVector<CallInst *, 4> toHVP;
+    SmallVector<CallInst *, 4> toTaylor;
     SetVector<CallInst *> InactiveCalls;
     SetVector<CallInst *> IterCalls;
   retry:;
@@ -1971,6 +3360,29 @@ public:
           CI->addParamAttr(3, Attribute::ReadOnly);
           CI->addParamAttr(3, Attribute::NoCapture);
         }
+        // The array operands of the other cblas routines with derivative
+        // rules, all of which are only read except the one written.
+        if (Fn->getName().startswith("cblas_") && Fn->isDeclaration()) {
+          int written = StringSwitch<int>(Fn->getName().substr(7))
+                            .Case("axpy", 4)
+                            .Case("scal", 2)
+                            .Case("gemv", 10)
+                            .Case("gemm", 12)
+                            .Case("syrk", 9)
+                            .Case("trsm", 10)
+                            .Default(-1);
+          char fp = Fn->getName()[6];
+          if (written != -1 && (fp == 'd' || fp == 's')) {
+            Fn->addFnAttr(Attribute::ArgMemOnly);
+            for (auto &arg : Fn->args()) {
+              if (!arg.getType()->isPointerTy())
+                continue;
+              CI->addParamAttr(arg.getArgNo(), Attribute::NoCapture);
+              if ((int)arg.getArgNo() != written)
+                CI->addParamAttr(arg.getArgNo(), Attribute::ReadOnly);
+            }
+          }
+        }
         if (Fn->getName() == "frexp" || Fn->getName() == "frexpf" ||
             Fn->getName() == "frexpl") {
           CI->addAttribute(AttributeList::FunctionIndex, Attribute::ArgMemOnly);
@@ -2094,6 +3506,9 @@ public:
         bool virtualCall = false;
         bool sizeOnly = false;
         bool batch = false;
+        bool batchAutoDiff = false;
+        bool hvp = false;
+        bool taylor = false;
         DerivativeMode mode;
         if (Fn->getName().contains("__enzyme_autodiff")) {
           enableEnzyme = true;
@@ -2118,9 +3533,18 @@ public:
           enableEnzyme = true;
           virtualCall = true;
           mode = DerivativeMode::ReverseModeCombined;
+        } else if (Fn->getName().contains("__enzyme_batch_autodiff")) {
+          enableEnzyme = true;
+          batchAutoDiff = true;
         } else if (Fn->getName().contains("__enzyme_batch")) {
           enableEnzyme = true;
           batch = true;
+        } else if (Fn->getName().contains("__enzyme_hvp")) {
+          enableEnzyme = true;
+          hvp = true;
+        } else if (Fn->getName().contains("__enzyme_taylor")) {
+          enableEnzyme = true;
+          taylor = true;
         }
 
         if (enableEnzyme) {
@@ -2166,6 +3590,12 @@ public:
             toSize[CI] = mode;
           else if (batch)
             toBatch.push_back(CI);
+          else if (batchAutoDiff)
+            toBatchAutoDiff.push_back(CI);
+          else if (hvp)
+            toHVP.push_back(CI);
+          else if (taylor)
+            toTaylor.push_back(CI);
           else
             toLower[CI] = mode;
 
@@ -2254,6 +3684,24 @@ public:
       HandleBatch(call);
     }
 
+    for (auto call : toBatchAutoDiff) {
+      Changed = true;
+      if (!HandleBatchAutoDiff(call))
+        break;
+    }
+
+    for (auto call : toHVP) {
+      Changed = true;
+      if (!HandleHVP(call))
+        break;
+    }
+
+    for (auto call : toTaylor) {
+      Changed = true;
+      if (!HandleTaylor(call))
+        break;
+    }
+
     if (Changed && EnzymeAttributor) {
       // TODO consider enabling when attributor does not delete
       // dead internal functions, which invalidates Enzyme's cache
@@ -2336,6 +3784,10 @@ public:
         handleCustomDerivative<splitderivative_handler_name,
                                DerivativeMode::ForwardModeSplit, 3>(
             M, g, globalsToErase);
+      } else if (g.getName().contains("__enzyme_register_parallel_for")) {
+        handleParallelFor(M, g, globalsToErase);
+      } else if (g.getName().contains("__enzyme_register_linear")) {
+        handleLinear(M, g, globalsToErase);
       }
     }
     for (auto g : globalsToErase) {
@@ -2347,6 +3799,7 @@ public:
       if (F.empty())
         continue;
       SmallVector<Instruction *, 4> toErase;
+      SmallVector<CallInst *, 1> jacobianCalls;
       for (BasicBlock &BB : F) {
         for (Instruction &I : BB) {
           if (auto CI = dyn_cast<CallInst>(&I)) {
@@ -2362,6 +3815,18 @@ public:
                   F = fn;
                 }
             }
+            if (F && F->empty() &&
+                F->getName().contains("__enzyme_fixed_point")) {
+              if (lowerFixedPointCall(CI))
+                toErase.push_back(CI);
+              continue;
+            }
+            if (F && F->empty() &&
+                (F->getName().contains("__enzyme_jacobian") ||
+                 F->getName().contains("__enzyme_hessian"))) {
+              jacobianCalls.push_back(CI);
+              continue;
+            }
             if (F && F->getName() == "f90_mzero8") {
               toErase.push_back(CI);
               IRBuilder<> B(CI);
@@ -2387,6 +3852,12 @@ public:
           }
         }
       }
+      // Lowering splits blocks, so is done once F has been walked.
+      for (CallInst *CI : jacobianCalls)
+        if (getFunctionFromCall(CI)->getName().contains("__enzyme_jacobian")
+                ? lowerJacobianCall(CI)
+                : lowerHessianCall(CI))
+          toErase.push_back(CI);
       for (Instruction *I : toErase) {
         I->eraseFromParent();
       }
@@ -2436,7 +3907,8 @@ public:
               if (F->getName().contains("__enzyme_float") ||
                   F->getName().contains("__enzyme_double") ||
                   F->getName().contains("__enzyme_integer") ||
-                  F->getName().contains("__enzyme_pointer")) {
+                  F->getName().contains("__enzyme_pointer") ||
+                  F->getName().contains("__enzyme_truncate")) {
                 toErase.push_back(CI);
               }
               if (F->getName() == "__enzyme_iter") {
@@ -2607,10 +4079,20 @@ llvmGetPassPluginInfo() {
               MPM.addPass(GlobalOptPass());
             };
 // TODO need for perf reasons to move Enzyme pass to the pre vectorization.
+            if (EnzymeLate)
+#if LLVM_VERSION_MAJOR >= 12
+              PB.registerOptimizerLastEPCallback(loadPass);
+#else
+              PB.registerOptimizerLastEPCallback(
+                  [=](ModulePassManager &MPM, OptimizationLevel) {
+                    loadPass(MPM);
+                  });
+#endif
+            else
 #if LLVM_VERSION_MAJOR >= 12
-            PB.registerPipelineEarlySimplificationEPCallback(loadPass);
+              PB.registerPipelineEarlySimplificationEPCallback(loadPass);
 #else
-            PB.registerPipelineStartEPCallback(loadPass);
+              PB.registerPipelineStartEPCallback(loadPass);
 #endif
 
 #if LLVM_VERSION_MAJOR >= 12
@@ -32,6 +32,7 @@
 #include "SCEV/ScalarEvolution.h"
 #include "SCEV/ScalarEvolutionExpander.h"
 
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
 #include <deque>
 
@@ -60,6 +61,7 @@
 #include "GradientUtils.h"
 #include "InstructionBatcher.h"
 #include "LibraryFuncs.h"
+#include "TaylorGenerator.h"
 #include "Utils.h"
 
 #if LLVM_VERSION_MAJOR >= 14
@@ -87,6 +89,17 @@ cl::opt<bool> nonmarkedglobals_inactiveloads(
     "enzyme_nonmarkedglobals_inactiveloads", cl::init(true), cl::Hidden,
     cl::desc("Consider loads of nonmarked globals to be inactive"));
 
+cl::opt<bool> EnzymeMPIOverlap(
+    "enzyme-mpi-overlap", cl::init(false), cl::Hidden,
+    cl::desc("Post adjoint MPI communication in the reverse pass as "
+             "nonblocking calls, completed where the adjoint buffers are "
+             "next used"));
+
+cl::opt<bool> EnzymeBatchSIMD(
+    "enzyme-batch-simd", cl::init(false), cl::Hidden,
+    cl::desc("Batch scalar values as LLVM vectors and their memory accesses "
+             "as vector loads and stores or gathers and scatters"));
+
 cl::opt<bool> EnzymeJuliaAddrLoad(
     "enzyme-julia-addr-load", cl::init(false), cl::Hidden,
     cl::desc("Mark all loads resulting in an addr(13)* to be legal to redo"));
@@ -394,6 +407,9 @@ struct CacheAnalysis {
           can_modref_map[inst] = false;
           break;
         case Intrinsic::masked_load:
+#if LLVM_VERSION_MAJOR >= 14
+        case Intrinsic::vp_load:
+#endif
           can_modref_map[inst] = is_load_uncacheable(*II);
           break;
         default:
@@ -3204,7 +3220,20 @@ void createInvertedTerminator(DiffeGradientUtils *gutils,
 #endif
     Value *phi =
         phibuilder.CreateICmpEQ(av, Constant::getNullValue(av->getType()));
-    Value *nphi = phibuilder.CreateNot(phi);
+    Value *exit = phi;
+    // A truncated loop leaves its reverse after the last window iterations,
+    // propagating nothing into the iterations before them.
+    if (Value *window = loopContext.window) {
+      Value *iters = phibuilder.CreateNUWAdd(
+          gutils->lookupM(loopContext.trueLimit, phibuilder),
+          ConstantInt::get(av->getType(), 1));
+      Value *first = phibuilder.CreateSelect(
+          phibuilder.CreateICmpUGT(iters, window),
+          phibuilder.CreateSub(iters, window),
+          Constant::getNullValue(av->getType()));
+      exit = phibuilder.CreateICmpULE(av, first);
+    }
+    Value *nphi = phibuilder.CreateNot(exit);
 
     for (auto pair : replacePHIs) {
       Value *replaceWith = nullptr;
@@ -3222,7 +3251,7 @@ void createInvertedTerminator(DiffeGradientUtils *gutils,
     Builder.SetInsertPoint(BB2);
 
     Builder.CreateCondBr(
-        phi, gutils->getReverseOrLatchMerge(loopContext.preheader, BB),
+        exit, gutils->getReverseOrLatchMerge(loopContext.preheader, BB),
         targetToPreds.begin()->first);
 
   } else {
@@ -3971,9 +4000,11 @@ Function *EnzymeLogic::CreatePrimalAndGradient(
     BasicBlock::reverse_iterator I = oBB.rbegin(), E = oBB.rend();
     ++I;
     for (; I != E; ++I) {
+      maker.completeDeferredMPI(&oBB, &*I);
       maker.visit(&*I);
       assert(oBB.rend() == E);
     }
+    maker.completeDeferredMPI(&oBB, nullptr);
 
     createInvertedTerminator(gutils, key.constant_args, &oBB, retAlloca,
                              dretAlloca,
@@ -4548,77 +4579,98 @@ Function *EnzymeLogic::CreateForwardDiff(
   return nf;
 }
 
-llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
-                                         ArrayRef<BATCH_TYPE> arg_types,
-                                         BATCH_TYPE ret_type) {
-
-  BatchCacheKey tup = std::make_tuple(tobatch, width, arg_types, ret_type);
-  if (BatchCachedFunctions.find(tup) != BatchCachedFunctions.end()) {
-    return BatchCachedFunctions.find(tup)->second;
+Function *EnzymeLogic::CreateHessianVectorProduct(
+    Function *todiff, ArrayRef<DIFFE_TYPE> constant_args, TypeAnalysis &TA,
+    const FnTypeInfo &typeInfo, unsigned width) {
+  assert(todiff->getReturnType()->isFloatingPointTy());
+  HVPCacheKey tup = std::make_tuple(
+      todiff,
+      std::vector<DIFFE_TYPE>(constant_args.begin(), constant_args.end()),
+      width, typeInfo);
+  if (HVPCachedFunctions.find(tup) != HVPCachedFunctions.end()) {
+    return HVPCachedFunctions.find(tup)->second;
   }
 
-  FunctionType *orig_FTy = tobatch->getFunctionType();
-  SmallVector<Type *, 4> params;
-  unsigned long numVecParams =
-      std::count(arg_types.begin(), arg_types.end(), BATCH_TYPE::VECTOR);
-
-  for (unsigned i = 0; i < orig_FTy->getNumParams(); ++i) {
-    if (arg_types[i] == BATCH_TYPE::VECTOR) {
-      Type *ty = GradientUtils::getShadowType(orig_FTy->getParamType(i), width);
-      params.push_back(ty);
-    } else {
-      params.push_back(orig_FTy->getParamType(i));
+  // Arguments are not overwritten between the two sweeps of the combined
+  // gradient, and it is only called from the derivative below.
+  std::map<Argument *, bool> uncacheable_args;
+  for (auto &arg : todiff->args())
+    uncacheable_args[&arg] = false;
+  Function *grad = CreatePrimalAndGradient(
+      (ReverseCacheKey){.todiff = todiff,
+                        .retType = DIFFE_TYPE::OUT_DIFF,
+                        .constant_args = std::get<1>(tup),
+                        .uncacheable_args = uncacheable_args,
+                        .returnUsed = false,
+                        .shadowReturnUsed = false,
+                        .mode = DerivativeMode::ReverseModeCombined,
+                        .width = 1,
+                        .freeMemory = true,
+                        .AtomicAdd = false,
+                        .additionalType = nullptr,
+                        .typeInfo = typeInfo},
+      TA, /*augmented*/ nullptr);
+
+  // The gradient takes each argument, followed by its shadow if duplicated,
+  // and then the seed of the return. Rather than analyzing the gradient from
+  // scratch, give each shadow the type of its primal, and differentiate both
+  // primal and shadow.
+  FnTypeInfo gradTypeInfo(grad);
+  std::vector<DIFFE_TYPE> gradConstants;
+  std::map<Argument *, bool> gradUncacheable;
+  auto gradArg = grad->arg_begin();
+  for (auto pair : llvm::zip(todiff->args(), constant_args)) {
+    Argument *arg = &std::get<0>(pair);
+    assert(std::get<1>(pair) == DIFFE_TYPE::DUP_ARG ||
+           std::get<1>(pair) == DIFFE_TYPE::CONSTANT);
+    unsigned copies = std::get<1>(pair) == DIFFE_TYPE::DUP_ARG ? 2 : 1;
+    for (unsigned i = 0; i < copies; ++i, ++gradArg) {
+      gradTypeInfo.Arguments.insert(std::pair<Argument *, TypeTree>(
+          gradArg, typeInfo.Arguments.find(arg)->second));
+      gradTypeInfo.KnownValues.insert(std::pair<Argument *, std::set<int64_t>>(
+          gradArg, i == 0 ? typeInfo.KnownValues.find(arg)->second
+                          : std::set<int64_t>()));
+      gradConstants.push_back(std::get<1>(pair));
+      gradUncacheable[gradArg] = false;
     }
   }
+  assert(gradArg != grad->arg_end() &&
+         gradArg->getType() == todiff->getReturnType());
+  gradTypeInfo.Arguments.insert(std::pair<Argument *, TypeTree>(
+      gradArg, TypeTree(ConcreteType(gradArg->getType())).Only(-1, nullptr)));
+  gradTypeInfo.KnownValues.insert(
+      std::pair<Argument *, std::set<int64_t>>(gradArg, {}));
+  gradConstants.push_back(DIFFE_TYPE::CONSTANT);
+  gradUncacheable[gradArg] = false;
+
+  Function *hvp = CreateForwardDiff(
+      grad, DIFFE_TYPE::CONSTANT, gradConstants, TA, /*returnUsed*/ false,
+      DerivativeMode::ForwardMode, /*freeMemory*/ true, width,
+      /*additionalArg*/ nullptr, gradTypeInfo, gradUncacheable,
+      /*augmented*/ nullptr);
+  return HVPCachedFunctions[tup] = hvp;
+}
 
-  Type *NewTy = GradientUtils::getShadowType(tobatch->getReturnType(), width);
-
-  FunctionType *FTy = FunctionType::get(NewTy, params, tobatch->isVarArg());
-  Function *NewF =
-      Function::Create(FTy, tobatch->getLinkage(),
-                       "batch_" + tobatch->getName(), tobatch->getParent());
-
-  NewF->setLinkage(Function::LinkageTypes::InternalLinkage);
-
-  ValueToValueMapTy originalToNewFn;
-
-  // Create placeholder for the old arguments
-  BasicBlock *placeholderBB =
-      BasicBlock::Create(NewF->getContext(), "placeholders", NewF);
-
-  IRBuilder<> PlaceholderBuilder(placeholderBB);
-  PlaceholderBuilder.SetCurrentDebugLocation(DebugLoc());
-  ValueToValueMapTy vmap;
-  auto DestArg = NewF->arg_begin();
-  auto SrcArg = tobatch->arg_begin();
-
-  for (unsigned i = 0; i < orig_FTy->getNumParams(); ++i) {
-    Argument *arg = SrcArg;
-    if (arg_types[i] == BATCH_TYPE::VECTOR) {
-      auto placeholder = PlaceholderBuilder.CreatePHI(
-          arg->getType(), 0, "placeholder." + arg->getName());
-      vmap[arg] = placeholder;
-    } else {
-      vmap[arg] = DestArg;
-    }
-    DestArg->setName(arg->getName());
-    DestArg++;
-    SrcArg++;
-  }
-
-  SmallVector<ReturnInst *, 4> Returns;
-#if LLVM_VERSION_MAJOR >= 13
-  CloneFunctionInto(NewF, tobatch, vmap,
-                    CloneFunctionChangeType::LocalChangesOnly, Returns, "",
-                    nullptr);
-#else
-  CloneFunctionInto(NewF, tobatch, vmap, true, Returns, "", nullptr);
-#endif
-
-  NewF->setLinkage(Function::LinkageTypes::InternalLinkage);
+/// Run I only if Cond holds, making its result undef otherwise.
+static void guardInstruction(Instruction *I, Value *Cond) {
+  BasicBlock *Head = I->getParent();
+  Instruction *Then = SplitBlockAndInsertIfThen(Cond, I, /*Unreachable*/ false);
+  BasicBlock *Tail = I->getParent();
+  I->moveBefore(Then);
+  if (I->getType()->isVoidTy())
+    return;
+  PHINode *PN = PHINode::Create(I->getType(), 2, "", &Tail->front());
+  I->replaceAllUsesWith(PN);
+  PN->addIncoming(I, Then->getParent());
+  PN->addIncoming(UndefValue::get(I->getType()), Head);
+  PN->takeName(I);
+}
 
+/// Find the values of tobatch which differ between lanes of its batch.
+static void findBatchedValues(Function *tobatch, ArrayRef<BATCH_TYPE> arg_types,
+                              BATCH_TYPE ret_type,
+                              SmallPtrSetImpl<Value *> &toVectorize) {
   // find instructions to vectorize (going up / overestimation)
-  SmallPtrSet<Value *, 32> toVectorize;
   SetVector<llvm::Value *, std::deque<llvm::Value *>> refinelist;
 
   for (unsigned i = 0; i < tobatch->getFunctionType()->getNumParams(); i++) {
@@ -4696,6 +4748,136 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
             refinelist.insert(user);
     }
   }
+}
+
+llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
+                                         ArrayRef<BATCH_TYPE> arg_types,
+                                         BATCH_TYPE ret_type, bool masked) {
+
+  BatchCacheKey tup =
+      std::make_tuple(tobatch, width, arg_types, ret_type, masked);
+  if (BatchCachedFunctions.find(tup) != BatchCachedFunctions.end()) {
+    return BatchCachedFunctions.find(tup)->second;
+  }
+
+  SmallPtrSet<Value *, 32> toVectorize;
+  findBatchedValues(tobatch, arg_types, ret_type, toVectorize);
+
+  // If lanes may take different paths through the function, batch a copy of
+  // it with linearized control flow instead, where every lane runs all blocks
+  // masked to the ones it would have run. A masked batch takes the lanes to
+  // run in as an additional argument of the copy.
+  Function *linearized = nullptr;
+  std::map<Instruction *, Value *> masks;
+  SmallPtrSet<BranchInst *, 4> anyBranches;
+  std::vector<BATCH_TYPE> src_types(arg_types.begin(), arg_types.end());
+  if (masked || llvm::any_of(toVectorize, [](Value *V) {
+        return isa<BranchInst>(V) || isa<SwitchInst>(V);
+      })) {
+    ValueToValueMapTy VMap;
+    Value *entryMask = nullptr;
+    if (masked) {
+      SmallVector<Type *, 4> params(
+          tobatch->getFunctionType()->param_begin(),
+          tobatch->getFunctionType()->param_end());
+      params.push_back(Type::getInt1Ty(tobatch->getContext()));
+      FunctionType *MTy = FunctionType::get(tobatch->getReturnType(), params,
+                                            tobatch->isVarArg());
+      linearized =
+          Function::Create(MTy, Function::LinkageTypes::InternalLinkage,
+                           tobatch->getName(), tobatch->getParent());
+      auto DestArg = linearized->arg_begin();
+      for (Argument &arg : tobatch->args()) {
+        DestArg->setName(arg.getName());
+        VMap[&arg] = DestArg++;
+      }
+      DestArg->setName("mask");
+      entryMask = DestArg;
+      src_types.push_back(BATCH_TYPE::VECTOR);
+      SmallVector<ReturnInst *, 4> Returns;
+#if LLVM_VERSION_MAJOR >= 13
+      CloneFunctionInto(linearized, tobatch, VMap,
+                        CloneFunctionChangeType::LocalChangesOnly, Returns);
+#else
+      CloneFunctionInto(linearized, tobatch, VMap, true, Returns);
+#endif
+    } else {
+      linearized = CloneFunction(tobatch, VMap);
+    }
+    if (!LinearizeControlFlow(linearized, PPC.FAM, masks, anyBranches,
+                              entryMask)) {
+      PPC.FAM.invalidate(*linearized, PreservedAnalyses::none());
+      linearized->eraseFromParent();
+      return BatchCachedFunctions[tup] = nullptr;
+    }
+    toVectorize.clear();
+    findBatchedValues(linearized, src_types, ret_type, toVectorize);
+  }
+  Function *src = linearized ? linearized : tobatch;
+
+  FunctionType *orig_FTy = src->getFunctionType();
+  SmallVector<Type *, 4> params;
+  unsigned long numVecParams =
+      std::count(src_types.begin(), src_types.end(), BATCH_TYPE::VECTOR);
+
+  for (unsigned i = 0; i < orig_FTy->getNumParams(); ++i) {
+    if (src_types[i] == BATCH_TYPE::VECTOR) {
+      Type *ty = GradientUtils::getShadowType(orig_FTy->getParamType(i), width);
+      params.push_back(ty);
+    } else {
+      params.push_back(orig_FTy->getParamType(i));
+    }
+  }
+
+  Type *NewTy = GradientUtils::getShadowType(tobatch->getReturnType(), width);
+
+  FunctionType *FTy = FunctionType::get(NewTy, params, tobatch->isVarArg());
+  Function *NewF = Function::Create(
+      FTy, tobatch->getLinkage(),
+      (masked ? "batch_masked_" : "batch_") + tobatch->getName(),
+      tobatch->getParent());
+
+  NewF->setLinkage(Function::LinkageTypes::InternalLinkage);
+
+  // Recursive calls batch to the function being created.
+  BatchCachedFunctions[tup] = NewF;
+
+  ValueToValueMapTy originalToNewFn;
+
+  // Create placeholder for the old arguments
+  BasicBlock *placeholderBB =
+      BasicBlock::Create(NewF->getContext(), "placeholders", NewF);
+
+  IRBuilder<> PlaceholderBuilder(placeholderBB);
+  PlaceholderBuilder.SetCurrentDebugLocation(DebugLoc());
+  ValueToValueMapTy vmap;
+  auto DestArg = NewF->arg_begin();
+  auto SrcArg = src->arg_begin();
+
+  for (unsigned i = 0; i < orig_FTy->getNumParams(); ++i) {
+    Argument *arg = SrcArg;
+    if (src_types[i] == BATCH_TYPE::VECTOR) {
+      auto placeholder = PlaceholderBuilder.CreatePHI(
+          arg->getType(), 0, "placeholder." + arg->getName());
+      vmap[arg] = placeholder;
+    } else {
+      vmap[arg] = DestArg;
+    }
+    DestArg->setName(arg->getName());
+    DestArg++;
+    SrcArg++;
+  }
+
+  SmallVector<ReturnInst *, 4> Returns;
+#if LLVM_VERSION_MAJOR >= 13
+  CloneFunctionInto(NewF, src, vmap,
+                    CloneFunctionChangeType::LocalChangesOnly, Returns, "",
+                    nullptr);
+#else
+  CloneFunctionInto(NewF, src, vmap, true, Returns, "", nullptr);
+#endif
+
+  NewF->setLinkage(Function::LinkageTypes::InternalLinkage);
 
   // unwrap arguments
   ValueMap<const Value *, std::vector<Value *>> vectorizedValues;
@@ -4703,11 +4885,11 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
   IRBuilder<> Builder2(entry->getFirstNonPHI());
   Builder2.SetCurrentDebugLocation(DebugLoc());
   for (unsigned i = 0; i < FTy->getNumParams(); ++i) {
-    Argument *orig_arg = tobatch->arg_begin() + i;
+    Argument *orig_arg = src->arg_begin() + i;
     Argument *arg = NewF->arg_begin() + i;
 
-    if (arg_types[i] == BATCH_TYPE::SCALAR) {
-      originalToNewFn[tobatch->arg_begin() + i] = arg;
+    if (src_types[i] == BATCH_TYPE::SCALAR) {
+      originalToNewFn[src->arg_begin() + i] = arg;
       continue;
     }
 
@@ -4731,8 +4913,8 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
   placeholderBB->eraseFromParent();
 
   // update mapping with cloned basic blocks
-  for (auto i = tobatch->begin(), j = NewF->begin();
-       i != tobatch->end() && j != NewF->end(); ++i, ++j) {
+  for (auto i = src->begin(), j = NewF->begin();
+       i != src->end() && j != NewF->end(); ++i, ++j) {
     originalToNewFn[&*i] = &*j;
   }
 
@@ -4740,8 +4922,8 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
   auto J = inst_begin(NewF);
   // skip the unwrapped vector params
   std::advance(J, width * numVecParams);
-  for (auto I = inst_begin(tobatch);
-       I != inst_end(tobatch) && J != inst_end(NewF); ++I) {
+  for (auto I = inst_begin(src);
+       I != inst_end(src) && J != inst_end(NewF); ++I) {
     if (toVectorize.count(&*I) != 0) {
       vectorizedValues[&*I].push_back(&*J);
       ++J;
@@ -4752,7 +4934,7 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
   }
 
   // create placeholders for vector instructions 1..<n
-  for (BasicBlock &BB : *tobatch) {
+  for (BasicBlock &BB : *src) {
     for (Instruction &I : BB) {
       if (I.getType()->isVoidTy())
         continue;
@@ -4776,35 +4958,290 @@ llvm::Function *EnzymeLogic::CreateBatch(Function *tobatch, unsigned width,
     }
   }
 
-  InstructionBatcher *batcher =
-      new InstructionBatcher(tobatch, NewF, width, vectorizedValues,
-                             originalToNewFn, toVectorize, *this);
+  InstructionBatcher *batcher = new InstructionBatcher(
+      src, NewF, width, vectorizedValues, originalToNewFn, toVectorize, masks,
+      anyBranches, *this);
 
-  for (auto val : toVectorize) {
-    if (auto inst = dyn_cast<Instruction>(val)) {
-      batcher->visit(inst);
-      if (batcher->hasError)
-        break;
-    }
+  for (Instruction &I : instructions(src)) {
+    if (toVectorize.count(&I) == 0)
+      continue;
+    batcher->visit(I);
+    if (batcher->hasError)
+      break;
   }
+  if (!batcher->hasError)
+    batcher->finalize();
 
   if (batcher->hasError) {
     delete batcher;
-    NewF->eraseFromParent();
+    // Functions batched while this one was in progress, e.g. mutually
+    // recursive callees, may call it and so fail with it.
+    SmallPtrSet<Function *, 4> batched;
+    for (auto &pair : BatchCachedFunctions)
+      if (pair.second)
+        batched.insert(pair.second);
+    SmallVector<Function *, 4> failed = {NewF};
+    SmallPtrSet<Function *, 4> seen = {NewF};
+    for (unsigned i = 0; i < failed.size(); i++)
+      for (User *U : failed[i]->users())
+        if (auto I = dyn_cast<Instruction>(U)) {
+          Function *F = I->getFunction();
+          if (batched.count(F) && seen.insert(F).second)
+            failed.push_back(F);
+        }
+    for (auto &pair : BatchCachedFunctions)
+      if (seen.count(pair.second))
+        pair.second = nullptr;
+    for (Function *F : failed)
+      F->dropAllReferences();
+    for (Function *F : failed) {
+      F->replaceAllUsesWith(UndefValue::get(F->getType()));
+      PPC.FAM.invalidate(*F, PreservedAnalyses::none());
+      F->eraseFromParent();
+    }
+    if (linearized) {
+      PPC.FAM.invalidate(*linearized, PreservedAnalyses::none());
+      linearized->eraseFromParent();
+    }
     return BatchCachedFunctions[tup] = nullptr;
   }
 
+  // Run masked instructions only in the lanes whose mask holds.
+  auto getLane = [&](Value *V, unsigned i) -> Value * {
+    if (toVectorize.count(V))
+      return vectorizedValues[V][i];
+    if (isa<Constant>(V))
+      return V;
+    return originalToNewFn[V];
+  };
+  for (BasicBlock &BB : *src)
+    for (Instruction &I : BB) {
+      auto found = masks.find(&I);
+      if (found == masks.end())
+        continue;
+      Value *mask = found->second;
+      if (batcher->maskedAccesses.count(&I))
+        continue;
+
+      // Scalar instructions, and calls batched as a whole, run once if any
+      // lane would run them.
+      Instruction *once = nullptr;
+      if (toVectorize.count(&I) == 0)
+        once = cast<Instruction>(originalToNewFn[&I]);
+      else if (auto CI = dyn_cast<CallInst>(&I)) {
+        auto found = batcher->batchedCalls.find(CI);
+        if (found != batcher->batchedCalls.end())
+          once = found->second;
+      }
+      if (once) {
+        IRBuilder<> B(once);
+        Value *any = getLane(mask, 0);
+        if (toVectorize.count(mask))
+          for (unsigned i = 1; i < width; ++i)
+            any = B.CreateOr(any, getLane(mask, i));
+        guardInstruction(once, any);
+        continue;
+      }
+
+      auto &lanes = vectorizedValues[&I];
+      for (unsigned i = 0; i < width; ++i)
+        guardInstruction(cast<Instruction>(lanes[i]), getLane(mask, i));
+    }
+
   if (llvm::verifyFunction(*NewF, &llvm::errs())) {
-    llvm::errs() << *tobatch << "\n";
+    llvm::errs() << *src << "\n";
     llvm::errs() << *NewF << "\n";
     report_fatal_error("function failed verification (4)");
   }
 
   delete batcher;
+  if (linearized) {
+    PPC.FAM.invalidate(*linearized, PreservedAnalyses::none());
+    linearized->eraseFromParent();
+  }
 
   return BatchCachedFunctions[tup] = NewF;
 };
 
+Function *EnzymeLogic::CreateBatchedGradient(const ReverseCacheKey &&key,
+                                             TypeAnalysis &TA, unsigned width,
+                                             ArrayRef<BATCH_TYPE> arg_types) {
+  assert(key.mode == DerivativeMode::ReverseModeCombined);
+  assert(arg_types.size() == key.constant_args.size());
+  BatchGradientCacheKey tup = std::make_tuple(
+      key, width, std::vector<BATCH_TYPE>(arg_types.begin(), arg_types.end()));
+  if (BatchGradientCachedFunctions.find(tup) !=
+      BatchGradientCachedFunctions.end()) {
+    return BatchGradientCachedFunctions.find(tup)->second;
+  }
+
+  Function *grad =
+      CreatePrimalAndGradient(ReverseCacheKey(key), TA, /*augmented*/ nullptr);
+  if (!grad)
+    return BatchGradientCachedFunctions[tup] = nullptr;
+
+  // The gradient takes each argument, followed by its shadow if duplicated,
+  // and then the seed of the return.
+  std::vector<BATCH_TYPE> gradTypes;
+  for (auto pair : llvm::zip(arg_types, key.constant_args)) {
+    gradTypes.push_back(std::get<0>(pair));
+    if (std::get<1>(pair) == DIFFE_TYPE::DUP_ARG ||
+        std::get<1>(pair) == DIFFE_TYPE::DUP_NONEED)
+      gradTypes.push_back(BATCH_TYPE::VECTOR);
+  }
+  if (key.retType == DIFFE_TYPE::OUT_DIFF)
+    gradTypes.push_back(BATCH_TYPE::SCALAR);
+  assert(gradTypes.size() == grad->getFunctionType()->getNumParams());
+
+  BATCH_TYPE ret_type = grad->getReturnType()->isVoidTy() ? BATCH_TYPE::SCALAR
+                                                          : BATCH_TYPE::VECTOR;
+  return BatchGradientCachedFunctions[tup] =
+             CreateBatch(grad, width, gradTypes, ret_type);
+}
+
+/// Whether memory of type T holds floating point values.
+static bool holdsFloat(Type *T) {
+  if (T->isFPOrFPVectorTy())
+    return true;
+  if (auto AT = dyn_cast<ArrayType>(T))
+    return holdsFloat(AT->getElementType());
+  if (auto ST = dyn_cast<StructType>(T))
+    return llvm::any_of(ST->elements(), holdsFloat);
+  return false;
+}
+
+llvm::Function *EnzymeLogic::CreateTaylor(Function *todiff,
+                                          ArrayRef<DIFFE_TYPE> constant_args,
+                                          unsigned order) {
+  TaylorCacheKey tup = std::make_tuple(
+      todiff, std::vector<DIFFE_TYPE>(constant_args.begin(),
+                                      constant_args.end()),
+      order);
+  if (TaylorCachedFunctions.find(tup) != TaylorCachedFunctions.end()) {
+    return TaylorCachedFunctions.find(tup)->second;
+  }
+
+  Function *F = PPC.preprocessForClone(todiff, DerivativeMode::ForwardMode);
+  FunctionType *orig_FTy = F->getFunctionType();
+  SmallVector<Type *, 4> params;
+  for (unsigned i = 0; i < orig_FTy->getNumParams(); ++i) {
+    params.push_back(orig_FTy->getParamType(i));
+    if (constant_args[i] == DIFFE_TYPE::DUP_ARG)
+      params.push_back(
+          GradientUtils::getShadowType(orig_FTy->getParamType(i), order));
+  }
+  Type *RetTy = F->getReturnType();
+  if (RetTy->isFPOrFPVectorTy())
+    RetTy = ArrayType::get(RetTy, order + 1);
+  FunctionType *FTy = FunctionType::get(RetTy, params, F->isVarArg());
+  Function *NewF = Function::Create(
+      FTy, Function::LinkageTypes::InternalLinkage,
+      "taylor" + Twine(order) + todiff->getName(), todiff->getParent());
+
+  // Clone the primal, mapping each argument to the first of its parameters.
+  ValueToValueMapTy originalToNewFn;
+  SmallPtrSet<Value *, 16> active;
+  auto DestArg = NewF->arg_begin();
+  for (auto &arg : F->args()) {
+    DestArg->setName(arg.getName());
+    originalToNewFn[&arg] = DestArg++;
+    if (constant_args[arg.getArgNo()] == DIFFE_TYPE::DUP_ARG) {
+      DestArg->setName(arg.getName() + "'t");
+      ++DestArg;
+      active.insert(&arg);
+    }
+  }
+  SmallVector<ReturnInst *, 4> Returns;
+#if LLVM_VERSION_MAJOR >= 13
+  CloneFunctionInto(NewF, F, originalToNewFn,
+                    CloneFunctionChangeType::LocalChangesOnly, Returns, "",
+                    nullptr);
+#else
+  CloneFunctionInto(NewF, F, originalToNewFn, F->getSubprogram() != nullptr,
+                    Returns, "", nullptr);
+#endif
+  NewF->setLinkage(Function::LinkageTypes::InternalLinkage);
+
+  // A value is active if its coefficients may be nonzero. Floating point
+  // values derived from active values, and pointers derived from active
+  // pointers, are active. Loads are active if they read floating point
+  // values through an active pointer, and local memory holding floating
+  // point values is always given shadow memory.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Instruction &I : instructions(F)) {
+      if (active.count(&I))
+        continue;
+      bool act;
+      if (auto AI = dyn_cast<AllocaInst>(&I))
+        act = holdsFloat(AI->getAllocatedType());
+      else if (auto LI = dyn_cast<LoadInst>(&I))
+        act = LI->getType()->isFPOrFPVectorTy() &&
+              active.count(LI->getPointerOperand());
+      else if (isa<CallInst>(&I))
+        act = I.getType()->isFPOrFPVectorTy() &&
+              llvm::any_of(I.operands(),
+                           [&](Value *op) { return active.count(op) != 0; });
+      else
+        act = (I.getType()->isFPOrFPVectorTy() ||
+               I.getType()->isPointerTy()) &&
+              llvm::any_of(I.operands(),
+                           [&](Value *op) { return active.count(op) != 0; });
+      if (act) {
+        active.insert(&I);
+        changed = true;
+      }
+    }
+  }
+
+  // Unpack the coefficients of the arguments.
+  ValueMap<const Value *, std::vector<Value *>> coefficients;
+  IRBuilder<> Builder(&*NewF->getEntryBlock().getFirstInsertionPt());
+  Builder.SetCurrentDebugLocation(DebugLoc());
+  DestArg = NewF->arg_begin();
+  for (auto &arg : F->args()) {
+    ++DestArg;
+    if (constant_args[arg.getArgNo()] != DIFFE_TYPE::DUP_ARG)
+      continue;
+    Argument *coeffs = DestArg++;
+    for (unsigned k = 0; k < order; ++k)
+      coefficients[&arg].push_back(
+          order == 1 ? (Value *)coeffs
+                     : Builder.CreateExtractValue(
+                           coeffs, {k},
+                           arg.getName() + "'t" + Twine(k + 1)));
+  }
+
+  TaylorGenerator generator(NewF, order, originalToNewFn, coefficients,
+                            active, *this);
+  ReversePostOrderTraversal<Function *> RPOT(F);
+  for (BasicBlock *BB : RPOT) {
+    for (Instruction &I : *BB) {
+      generator.visit(&I);
+      if (generator.hasError)
+        break;
+    }
+    if (generator.hasError)
+      break;
+  }
+  if (!generator.hasError)
+    generator.finalizePHIs();
+
+  if (generator.hasError) {
+    NewF->eraseFromParent();
+    return TaylorCachedFunctions[tup] = nullptr;
+  }
+
+  if (llvm::verifyFunction(*NewF, &llvm::errs())) {
+    llvm::errs() << *F << "\n";
+    llvm::errs() << *NewF << "\n";
+    report_fatal_error("function failed verification (5)");
+  }
+
+  return TaylorCachedFunctions[tup] = NewF;
+}
+
 llvm::Value *EnzymeLogic::CreateNoFree(llvm::Value *todiff) {
   if (auto F = dyn_cast<Function>(todiff))
     return CreateNoFree(F);
@@ -5017,4 +5454,6 @@ void EnzymeLogic::clear() {
   NoFreeCachedFunctions.clear();
   ForwardCachedFunctions.clear();
   BatchCachedFunctions.clear();
+  HVPCachedFunctions.clear();
+  TaylorCachedFunctions.clear();
 }
@@ -53,6 +53,7 @@
 
 extern "C" {
 extern llvm::cl::opt<bool> EnzymePrint;
+extern llvm::cl::opt<bool> EnzymeBatchSIMD;
 }
 
 enum class AugmentedStruct { Tape, Return, DifferentialReturn };
@@ -429,7 +430,7 @@ public:
   std::map<ForwardCacheKey, llvm::Function *> ForwardCachedFunctions;
 
   using BatchCacheKey = std::tuple<llvm::Function *, unsigned,
-                                   std::vector<BATCH_TYPE>, BATCH_TYPE>;
+                                   std::vector<BATCH_TYPE>, BATCH_TYPE, bool>;
   std::map<BatchCacheKey, llvm::Function *> BatchCachedFunctions;
 
   /// Create the derivative function itself.
@@ -459,9 +460,68 @@ public:
                     const std::map<llvm::Argument *, bool> _uncacheable_args,
                     const AugmentedReturn *augmented, bool omp = false);
 
+  using HVPCacheKey = std::tuple<llvm::Function *, std::vector<DIFFE_TYPE>,
+                                 unsigned, FnTypeInfo>;
+  std::map<HVPCacheKey, llvm::Function *> HVPCachedFunctions;
+
+  /// Create the Hessian-vector product of a function returning a scalar, as
+  /// the forward derivative of its combined gradient.
+  ///  \p todiff is the function to differentiate
+  ///  \p constant_args is the activity info of the arguments, each either
+  ///  DUP_ARG or CONSTANT
+  ///  \p typeInfo is the type info information about the calling context,
+  ///  also used for the arguments of the gradient
+  ///  \p width is the number of directions
+  /// Each duplicated argument x is passed as x, the direction(s) v, the
+  /// gradient g and the product(s) Hv, into which the gradient and the
+  /// products are accumulated. The seed of the return comes last.
+  llvm::Function *CreateHessianVectorProduct(
+      llvm::Function *todiff, llvm::ArrayRef<DIFFE_TYPE> constant_args,
+      TypeAnalysis &TA, const FnTypeInfo &typeInfo, unsigned width);
+
+  /// Create the batched counterpart of a function, running width lanes.
+  ///  \p arg_types is whether each argument is the same in all lanes
+  ///  \p ret_type is whether the return is batched
+  ///  \p masked is whether the batched function takes an additional
+  ///  [width x i1] argument of the lanes to run, outside of which it has no
+  ///  side effects
   llvm::Function *CreateBatch(llvm::Function *tobatch, unsigned width,
                               llvm::ArrayRef<BATCH_TYPE> arg_types,
-                              BATCH_TYPE ret_type);
+                              BATCH_TYPE ret_type, bool masked = false);
+
+  using BatchGradientCacheKey =
+      std::tuple<ReverseCacheKey, unsigned, std::vector<BATCH_TYPE>>;
+  std::map<BatchGradientCacheKey, llvm::Function *>
+      BatchGradientCachedFunctions;
+
+  /// Create the combined gradient of a function for width samples at once,
+  /// as the batch of its gradient.
+  ///  \p key describes the gradient of a single sample, in combined mode
+  ///  \p arg_types is whether each argument of the function differs between
+  ///  samples. Shadows of duplicated arguments always do, so that the gradient
+  ///  of each sample is accumulated separately, while the seed of the return
+  ///  is the same for all samples.
+  llvm::Function *CreateBatchedGradient(const ReverseCacheKey &&key,
+                                        TypeAnalysis &TA, unsigned width,
+                                        llvm::ArrayRef<BATCH_TYPE> arg_types);
+
+  using TaylorCacheKey =
+      std::tuple<llvm::Function *, std::vector<DIFFE_TYPE>, unsigned>;
+  std::map<TaylorCacheKey, llvm::Function *> TaylorCachedFunctions;
+
+  /// Create the Taylor mode counterpart of a function, propagating truncated
+  /// Taylor series of degree \p order through it.
+  ///  \p todiff is the function to differentiate
+  ///  \p constant_args is the activity info of the arguments, each either
+  ///  DUP_ARG or CONSTANT
+  /// Each duplicated argument is followed by its coefficients of order 1 to
+  /// \p order, as an array unless \p order is 1. For a pointer these point
+  /// to shadow memory holding the coefficients of the memory it points to. A
+  /// floating point return becomes an array of the coefficients of order 0 to
+  /// \p order. Returns null if some active value has no Taylor rule.
+  llvm::Function *CreateTaylor(llvm::Function *todiff,
+                               llvm::ArrayRef<DIFFE_TYPE> constant_args,
+                               unsigned order);
 
   void clear();
 };
@@ -469,6 +529,7 @@ public:
 extern "C" {
 extern llvm::cl::opt<bool> looseTypeAnalysis;
 extern llvm::cl::opt<bool> nonmarkedglobals_inactiveloads;
+extern llvm::cl::opt<bool> EnzymeMPIOverlap;
 };
 
 class GradientUtils;
@@ -28,6 +28,7 @@
 #include "GradientUtils.h"
 #include "LibraryFuncs.h"
 
+#include "llvm/ADT/SetVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -58,6 +59,7 @@
 #include "llvm/Analysis/PhiValues.h"
 #endif
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/ScopedNoAliasAA.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 
@@ -146,6 +148,16 @@ cl::opt<bool>
 
 cl::opt<bool> EnzymeSelectOpt("enzyme-select-opt", cl::init(true), cl::Hidden,
                               cl::desc("Run Enzyme select optimization"));
+
+cl::opt<bool> EnzymeParallelReverseLoops(
+    "enzyme-parallel-reverse-loops", cl::init(false), cl::Hidden,
+    cl::desc("Outline loops without loop-carried dependencies into OpenMP "
+             "parallel regions so that their reverse pass runs in parallel"));
+
+cl::opt<bool> EnzymeMatmulIdiom(
+    "enzyme-matmul-idiom", cl::init(false), cl::Hidden,
+    cl::desc("Replace loop nests computing matrix products by a blocked "
+             "kernel whose derivative is computed as a whole"));
 }
 
 /// Is the use of value val as an argument of call CI potentially captured
@@ -1135,6 +1147,1020 @@ void RemoveRedundantPHI(Function *F, FunctionAnalysisManager &FAM) {
   }
 }
 
+/// Whether F is the outlined body of an OpenMP parallel region, i.e. it is
+/// passed (possibly through a cast) to __kmpc_fork_call.
+static bool isOpenMPOutlined(Function *F) {
+  SmallVector<Value *, 4> todo(F->user_begin(), F->user_end());
+  while (todo.size()) {
+    auto V = todo.pop_back_val();
+    if (auto CE = dyn_cast<ConstantExpr>(V)) {
+      if (CE->isCast())
+        todo.append(CE->user_begin(), CE->user_end());
+      continue;
+    }
+    if (auto CI = dyn_cast<CallInst>(V))
+      if (auto Fn = CI->getCalledFunction())
+        if (Fn->getName() == "__kmpc_fork_call")
+          return true;
+  }
+  return false;
+}
+
+namespace {
+/// A memory access within a loop considered for parallelization. On iteration
+/// i of the loop the access touches bytes [Start + Stride * i + Lo,
+/// Start + Stride * i + Hi), where Start is invariant in the loop. Accesses
+/// from subloops have their inner recurrences folded into [Lo, Hi).
+struct ParallelLoopAccess {
+  Instruction *I;
+  Value *Obj;
+  bool Write;
+  const SCEV *Start;
+  int64_t Stride;
+  int64_t Lo;
+  int64_t Hi;
+};
+} // namespace
+
+static bool getParallelLoopAccess(Loop *L, Instruction *I, Value *Ptr,
+                                  Type *ValTy, bool Write, ScalarEvolution &SE,
+                                  ParallelLoopAccess &Acc) {
+  auto &DL = I->getModule()->getDataLayout();
+  Acc.I = I;
+  Acc.Write = Write;
+#if LLVM_VERSION_MAJOR >= 12
+  Acc.Obj = getUnderlyingObject(Ptr, 100);
+#else
+  Acc.Obj = GetUnderlyingObject(Ptr, DL, 100);
+#endif
+  Acc.Lo = 0;
+  Acc.Hi = (DL.getTypeSizeInBits(ValTy) + 7) / 8;
+  const SCEV *S = SE.getSCEV(Ptr);
+  while (auto AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (AR->getLoop() == L)
+      break;
+    if (!L->contains(AR->getLoop()) || !AR->isAffine())
+      return false;
+    auto Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    auto Max = dyn_cast<SCEVConstant>(
+        SE.getConstantMaxBackedgeTakenCount(AR->getLoop()));
+    if (!Step || !Max || Step->getAPInt().getMinSignedBits() > 32 ||
+        Max->getAPInt().getActiveBits() > 31)
+      return false;
+    int64_t Ext = Step->getAPInt().getSExtValue() *
+                  (int64_t)Max->getAPInt().getZExtValue();
+    if (Ext < 0)
+      Acc.Lo += Ext;
+    else
+      Acc.Hi += Ext;
+    S = AR->getStart();
+  }
+  if (auto AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (!AR->isAffine())
+      return false;
+    auto Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+    if (!Step || Step->getAPInt().getMinSignedBits() > 32)
+      return false;
+    Acc.Start = AR->getStart();
+    Acc.Stride = Step->getAPInt().getSExtValue();
+    return SE.isLoopInvariant(Acc.Start, L);
+  }
+  if (!SE.isLoopInvariant(S, L))
+    return false;
+  Acc.Start = S;
+  Acc.Stride = 0;
+  return true;
+}
+
+/// Whether two accesses may touch the same byte on different iterations of
+/// the loop.
+static bool mayConflictAcrossIterations(const ParallelLoopAccess &A,
+                                        const ParallelLoopAccess &B,
+                                        ScalarEvolution &SE, AAResults &AA) {
+#if LLVM_VERSION_MAJOR >= 12
+  if (AA.isNoAlias(MemoryLocation::getBeforeOrAfter(A.Obj),
+                   MemoryLocation::getBeforeOrAfter(B.Obj)))
+    return false;
+#else
+  if (AA.isNoAlias(MemoryLocation(A.Obj, MemoryLocation::UnknownSize),
+                   MemoryLocation(B.Obj, MemoryLocation::UnknownSize)))
+    return false;
+#endif
+  if (A.Stride == 0 || A.Stride != B.Stride)
+    return true;
+  auto Delta = dyn_cast<SCEVConstant>(SE.getMinusSCEV(B.Start, A.Start));
+  if (!Delta || Delta->getAPInt().getMinSignedBits() > 32)
+    return true;
+  // B on iteration i + k overlaps A on iteration i iff
+  //   A.Lo - B.Hi < Delta + Stride * k < A.Hi - B.Lo
+  int64_t D = Delta->getAPInt().getSExtValue();
+  int64_t Stride = A.Stride < 0 ? -A.Stride : A.Stride;
+  int64_t Lower = A.Lo - B.Hi - D, Upper = A.Hi - B.Lo - D;
+  int64_t First = Lower / Stride - 1, Last = Upper / Stride + 1;
+  for (int64_t k = First; k <= Last; k++) {
+    if (k == 0)
+      continue;
+    if (Lower < Stride * k && Stride * k < Upper)
+      return true;
+  }
+  return false;
+}
+
+/// Whether no iteration of loop L depends upon another, such that its
+/// iterations (and therefore those of its reverse) may be run concurrently.
+/// The loop must be in simplified form with a canonical induction variable,
+/// exit only from its latch, have no values live out of the loop, not call
+/// any function which may access memory, and every pair of memory accesses
+/// must be provably disjoint across different iterations. Loads whose
+/// location no other iteration accesses, and therefore whose shadow only
+/// their own iteration accumulates into, are added to PrivateLoads.
+static bool isIterationIndependent(Loop *L, ScalarEvolution &SE,
+                                   AAResults &AA,
+                                   SmallVectorImpl<LoadInst *> &PrivateLoads) {
+  if (!L->getLoopPreheader() || !L->getLoopLatch() || !L->getExitBlock() ||
+      L->getExitingBlock() != L->getLoopLatch())
+    return false;
+  auto CanonicalIV = L->getCanonicalInductionVariable();
+  if (!CanonicalIV || !CanonicalIV->getType()->isIntegerTy(64))
+    return false;
+  // Any other header phi is a loop-carried recurrence (e.g. a reduction).
+  for (auto &PN : L->getHeader()->phis())
+    if (&PN != CanonicalIV)
+      return false;
+  auto Latch = dyn_cast<BranchInst>(L->getLoopLatch()->getTerminator());
+  if (!Latch || !Latch->isConditional())
+    return false;
+  if (isa<SCEVCouldNotCompute>(SE.getBackedgeTakenCount(L)))
+    return false;
+  if (!L->getExitBlock()->phis().empty())
+    return false;
+
+  SmallVector<ParallelLoopAccess, 8> Accesses;
+  for (auto BB : L->blocks()) {
+    if (isa<InvokeInst>(BB->getTerminator()))
+      return false;
+    for (auto &I : *BB) {
+      for (auto U : I.users())
+        if (!L->contains(cast<Instruction>(U)))
+          return false;
+      if (isa<AllocaInst>(&I) || I.isAtomic())
+        return false;
+      if (auto LI = dyn_cast<LoadInst>(&I)) {
+        ParallelLoopAccess Acc;
+        if (!LI->isSimple() ||
+            !getParallelLoopAccess(L, LI, LI->getPointerOperand(),
+                                   LI->getType(), /*Write*/ false, SE, Acc))
+          return false;
+        Accesses.push_back(Acc);
+        continue;
+      }
+      if (auto SI = dyn_cast<StoreInst>(&I)) {
+        ParallelLoopAccess Acc;
+        if (!SI->isSimple() ||
+            !getParallelLoopAccess(L, SI, SI->getPointerOperand(),
+                                   SI->getValueOperand()->getType(),
+                                   /*Write*/ true, SE, Acc))
+          return false;
+        // A store to the same location on every iteration.
+        if (Acc.Stride == 0)
+          return false;
+        Accesses.push_back(Acc);
+        continue;
+      }
+      if (isa<DbgInfoIntrinsic>(&I))
+        continue;
+      if (auto CI = dyn_cast<CallInst>(&I)) {
+        if (!CI->doesNotAccessMemory() || !CI->doesNotThrow())
+          return false;
+        continue;
+      }
+      if (I.mayReadOrWriteMemory() || I.mayHaveSideEffects())
+        return false;
+    }
+  }
+
+  for (size_t i = 0; i < Accesses.size(); i++)
+    for (size_t j = 0; j < Accesses.size(); j++) {
+      if (!Accesses[i].Write)
+        continue;
+      if (mayConflictAcrossIterations(Accesses[i], Accesses[j], SE, AA))
+        return false;
+    }
+
+  for (auto &A : Accesses) {
+    if (A.Write || A.Stride == 0)
+      continue;
+    if (llvm::none_of(Accesses, [&](const ParallelLoopAccess &B) {
+          return mayConflictAcrossIterations(A, B, SE, AA);
+        }))
+      PrivateLoads.push_back(cast<LoadInst>(A.I));
+  }
+  return true;
+}
+
+/// Outline the iteration-independent loop L of F into an OpenMP parallel
+/// region with a static schedule, mirroring the code clang emits for
+/// `#pragma omp parallel for`. The reverse pass of the resulting region is
+/// then generated by the existing OpenMP support and runs in parallel, with
+/// shadow accumulation into shared memory performed atomically unless the
+/// load is marked enzyme_noatomic.
+static void outlineParallelLoop(Function *F, Loop *L, ScalarEvolution &SE) {
+  Module &M = *F->getParent();
+  LLVMContext &Ctx = F->getContext();
+  auto i32 = Type::getInt32Ty(Ctx);
+  auto i64 = Type::getInt64Ty(Ctx);
+  auto i8p = Type::getInt8PtrTy(Ctx);
+
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exit = L->getExitBlock();
+  PHINode *CanonicalIV = L->getCanonicalInductionVariable();
+  auto Increment =
+      cast<Instruction>(CanonicalIV->getIncomingValueForBlock(Latch));
+
+#if LLVM_VERSION_MAJOR >= 12
+  auto IdentTy = StructType::getTypeByName(Ctx, "struct.ident_t");
+#else
+  auto IdentTy = M.getTypeByName("struct.ident_t");
+#endif
+  if (!IdentTy)
+    IdentTy = StructType::create({i32, i32, i32, i32, i8p}, "struct.ident_t");
+  auto getIdent = [&](int Flags) -> Constant * {
+    std::string Name = "enzyme_omp_ident." + std::to_string(Flags);
+    if (auto GV = M.getNamedGlobal(Name))
+      return GV;
+    auto StrGV = M.getNamedGlobal("enzyme_omp_loc");
+    if (!StrGV) {
+      auto Str = ConstantDataArray::getString(Ctx, ";unknown;unknown;0;0;;");
+      StrGV = new GlobalVariable(M, Str->getType(), /*isConstant*/ true,
+                                 GlobalValue::PrivateLinkage, Str,
+                                 "enzyme_omp_loc");
+      StrGV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    }
+    auto Init = ConstantStruct::get(
+        IdentTy, {ConstantInt::get(i32, 0), ConstantInt::get(i32, Flags),
+                  ConstantInt::get(i32, 0), ConstantInt::get(i32, 0),
+                  ConstantExpr::getPointerCast(StrGV, i8p)});
+    auto GV = new GlobalVariable(M, IdentTy, /*isConstant*/ true,
+                                 GlobalValue::PrivateLinkage, Init, Name);
+    GV->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    return GV;
+  };
+  auto IdentPtr = PointerType::getUnqual(IdentTy);
+  auto MicroTy = FunctionType::get(Type::getVoidTy(Ctx),
+                                   {PointerType::getUnqual(i32),
+                                    PointerType::getUnqual(i32)},
+                                   /*isVarArg*/ true);
+  auto ForkCall = M.getOrInsertFunction(
+      "__kmpc_fork_call",
+      FunctionType::get(Type::getVoidTy(Ctx),
+                        {IdentPtr, i32, PointerType::getUnqual(MicroTy)},
+                        /*isVarArg*/ true));
+  auto i64p = PointerType::getUnqual(i64);
+  auto StaticInit = M.getOrInsertFunction(
+      "__kmpc_for_static_init_8u",
+      FunctionType::get(Type::getVoidTy(Ctx),
+                        {IdentPtr, i32, i32, PointerType::getUnqual(i32), i64p,
+                         i64p, i64p, i64, i64},
+                        false));
+  auto StaticFini = M.getOrInsertFunction(
+      "__kmpc_for_static_fini",
+      FunctionType::get(Type::getVoidTy(Ctx), {IdentPtr, i32}, false));
+  auto castArgs = [](FunctionCallee Fn, MutableArrayRef<Value *> Args,
+                     IRBuilder<> &B) {
+    for (unsigned i = 0; i < Args.size(); i++)
+      if (i < Fn.getFunctionType()->getNumParams())
+        Args[i] = B.CreateBitOrPointerCast(
+            Args[i], Fn.getFunctionType()->getParamType(i));
+  };
+
+  // Values defined outside of the loop become arguments of the outlined
+  // body. OpenMP passes these as pointer-sized values, so integers are
+  // widened and floating point values are passed as the integer holding their
+  // bits, as clang does for captures by copy.
+  SetVector<Value *> Inputs;
+  for (auto BB : L->blocks())
+    for (auto &I : *BB)
+      for (auto &Op : I.operands()) {
+        if (isa<Argument>(Op))
+          Inputs.insert(Op);
+        else if (auto OI = dyn_cast<Instruction>(Op))
+          if (!L->contains(OI))
+            Inputs.insert(Op);
+      }
+
+  SmallVector<Type *, 8> Params = {PointerType::getUnqual(i32),
+                                   PointerType::getUnqual(i32), i64};
+  for (auto V : Inputs) {
+    if (V->getType()->isIntegerTy() || V->getType()->isFloatingPointTy())
+      Params.push_back(i64);
+    else
+      Params.push_back(V->getType());
+  }
+  auto Outlined = Function::Create(
+      FunctionType::get(Type::getVoidTy(Ctx), Params, false),
+      GlobalValue::InternalLinkage, F->getName() + ".omp_outlined", M);
+  Outlined->addFnAttr(Attribute::NoUnwind);
+  Outlined->addFnAttr(Attribute::NoRecurse);
+  Outlined->addParamAttr(0, Attribute::NoAlias);
+  Outlined->addParamAttr(1, Attribute::NoAlias);
+
+  auto Entry = BasicBlock::Create(Ctx, "omp.entry", Outlined);
+  auto Body = BasicBlock::Create(Ctx, "omp.precond.then", Outlined);
+  auto Fini = BasicBlock::Create(Ctx, "omp.loop.exit", Outlined);
+
+  IRBuilder<> B(Entry);
+  auto LB = B.CreateAlloca(i64, nullptr, ".omp.lb");
+  auto UB = B.CreateAlloca(i64, nullptr, ".omp.ub");
+  auto Stride = B.CreateAlloca(i64, nullptr, ".omp.stride");
+  auto IsLast = B.CreateAlloca(i32, nullptr, ".omp.is_last");
+  auto Arg = Outlined->arg_begin();
+  Value *GTidPtr = Arg++;
+  Arg++;
+  Value *TripCount = Arg++;
+  ValueToValueMapTy VMap;
+  for (auto V : Inputs) {
+    Value *NV = Arg;
+    Arg->setName(V->getName());
+    if (V->getType()->isIntegerTy())
+      NV = B.CreateTrunc(NV, V->getType());
+    else if (V->getType()->isFloatingPointTy())
+      NV = B.CreateBitCast(
+          B.CreateTrunc(NV, B.getIntNTy(V->getType()->getPrimitiveSizeInBits())),
+          V->getType());
+    VMap[V] = NV;
+    Arg++;
+  }
+  auto Last = B.CreateSub(TripCount, ConstantInt::get(i64, 1));
+  B.CreateStore(ConstantInt::get(i64, 0), LB);
+  B.CreateStore(Last, UB);
+  B.CreateStore(ConstantInt::get(i64, 1), Stride);
+  B.CreateStore(ConstantInt::get(i32, 0), IsLast);
+#if LLVM_VERSION_MAJOR > 7
+  Value *GTid = B.CreateLoad(i32, GTidPtr);
+#else
+  Value *GTid = B.CreateLoad(GTidPtr);
+#endif
+  Value *InitArgs[] = {getIdent(514),
+                       GTid,
+                       ConstantInt::get(i32, 34),
+                       IsLast,
+                       LB,
+                       UB,
+                       Stride,
+                       ConstantInt::get(i64, 1),
+                       ConstantInt::get(i64, 1)};
+  castArgs(StaticInit, InitArgs, B);
+  B.CreateCall(StaticInit, InitArgs);
+#if LLVM_VERSION_MAJOR > 7
+  Value *UBV = B.CreateLoad(i64, UB);
+#else
+  Value *UBV = B.CreateLoad(UB);
+#endif
+  UBV = B.CreateSelect(B.CreateICmpUGT(UBV, Last), Last, UBV);
+  B.CreateStore(UBV, UB);
+#if LLVM_VERSION_MAJOR > 7
+  Value *LBV = B.CreateLoad(i64, LB);
+#else
+  Value *LBV = B.CreateLoad(LB);
+#endif
+  auto End = B.CreateAdd(UBV, ConstantInt::get(i64, 1));
+  B.CreateCondBr(B.CreateICmpULT(LBV, End), Body, Fini);
+  B.SetInsertPoint(Body);
+  B.CreateBr(Header);
+  B.SetInsertPoint(Fini);
+  Value *FiniArgs[] = {getIdent(514), GTid};
+  castArgs(StaticFini, FiniArgs, B);
+  B.CreateCall(StaticFini, FiniArgs);
+  B.CreateRetVoid();
+
+  // Replace the loop in F with the fork of the parallel region.
+  B.SetInsertPoint(Preheader->getTerminator());
+  auto &DL = M.getDataLayout();
+  const SCEV *Count = SE.getAddExpr(
+      SE.getTruncateOrZeroExtend(SE.getBackedgeTakenCount(L), i64),
+      SE.getOne(i64));
+  Value *TC;
+  {
+#if LLVM_VERSION_MAJOR >= 12
+    SCEVExpander Exp(SE, DL, "enzyme");
+#else
+    fake::SCEVExpander Exp(SE, DL, "enzyme");
+#endif
+    TC = Exp.expandCodeFor(Count, i64, Preheader->getTerminator());
+  }
+  SmallVector<Value *, 8> ForkArgs = {
+      getIdent(2), ConstantInt::get(i32, Params.size() - 2),
+      ConstantExpr::getPointerCast(Outlined, PointerType::getUnqual(MicroTy)),
+      TC};
+  for (auto V : Inputs) {
+    if (V->getType()->isIntegerTy())
+      ForkArgs.push_back(B.CreateZExt(V, i64));
+    else if (V->getType()->isFloatingPointTy())
+      ForkArgs.push_back(B.CreateZExt(
+          B.CreateBitCast(
+              V, B.getIntNTy(V->getType()->getPrimitiveSizeInBits())),
+          i64));
+    else
+      ForkArgs.push_back(V);
+  }
+  castArgs(ForkCall, ForkArgs, B);
+  B.CreateCall(ForkCall, ForkArgs);
+  B.CreateBr(Exit);
+  Preheader->getTerminator()->eraseFromParent();
+
+  // Move the loop into the outlined body, iterating over [lb, ub] as
+  // assigned by the runtime.
+  SmallVector<BasicBlock *, 8> Blocks;
+  for (auto &BB : *F)
+    if (L->contains(&BB))
+      Blocks.push_back(&BB);
+  for (auto BB : Blocks) {
+    BB->removeFromParent();
+    BB->insertInto(Outlined, Fini);
+  }
+  for (auto BB : Blocks)
+    for (auto &I : *BB) {
+      for (auto &Op : I.operands()) {
+        auto found = VMap.find(Op);
+        if (found != VMap.end())
+          Op.set(found->second);
+      }
+      I.setDebugLoc(DebugLoc());
+    }
+  for (auto BB : Blocks)
+    for (auto II = BB->begin(); II != BB->end();) {
+      auto &I = *II++;
+      if (isa<DbgInfoIntrinsic>(&I))
+        I.eraseFromParent();
+    }
+
+  CanonicalIV->setIncomingBlock(CanonicalIV->getBasicBlockIndex(Preheader),
+                                Body);
+  CanonicalIV->setIncomingValue(CanonicalIV->getBasicBlockIndex(Body), LBV);
+  auto Br = cast<BranchInst>(Latch->getTerminator());
+  auto OldCond = dyn_cast<Instruction>(Br->getCondition());
+  B.SetInsertPoint(Br);
+  if (Br->getSuccessor(0) == Header) {
+    Br->setCondition(B.CreateICmpULT(Increment, End));
+    Br->setSuccessor(1, Fini);
+  } else {
+    Br->setCondition(B.CreateICmpUGE(Increment, End));
+    Br->setSuccessor(0, Fini);
+  }
+  if (OldCond && OldCond->use_empty())
+    OldCond->eraseFromParent();
+}
+
+/// Outline loops of F whose iterations are independent into OpenMP parallel
+/// regions, such that their reverse pass is parallelized.
+static void ParallelizeIndependentLoops(Function *F,
+                                        FunctionAnalysisManager &FAM) {
+  while (true) {
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(*F);
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+    AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(*F);
+    TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(*F);
+    AAResults &AA = FAM.getResult<AAManager>(*F);
+    MustExitScalarEvolution SE(*F, TLI, AC, DT, LI);
+    Loop *Candidate = nullptr;
+    SmallVector<LoadInst *, 4> PrivateLoads;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      PrivateLoads.clear();
+      if (isIterationIndependent(L, SE, AA, PrivateLoads)) {
+        Candidate = L;
+        break;
+      }
+    }
+    if (!Candidate)
+      return;
+    for (auto Load : PrivateLoads)
+      Load->setMetadata("enzyme_noatomic",
+                        MDNode::get(Load->getContext(), {}));
+    outlineParallelLoop(F, Candidate, SE);
+    FAM.invalidate(*F, PreservedAnalyses::none());
+  }
+}
+
+namespace {
+/// A loop nest computing C = beta C + A B, with beta 0 or 1, on the strided
+/// M x K, K x N and M x N matrices A, B and C, as found by matchMatmulNest.
+/// Element (i, j) of each lies Stride[0] * i + Stride[1] * j bytes past its
+/// Base. The loop giving each of M, N and K may be entered only under the
+/// condition of Guard (on its successor GuardEnters), in which case the loop
+/// is considered to run no times otherwise. Fused is set if the nest
+/// accumulates its products with llvm.fmuladd.
+struct MatmulNest {
+  Loop *Outer;
+  Type *T;
+  const SCEV *Base[3];
+  const SCEV *Stride[3][2];
+  const SCEV *Count[3];
+  BranchInst *Guard[3];
+  unsigned GuardEnters[3];
+  bool Accumulate;
+  bool Fused;
+};
+} // namespace
+
+/// The number of times the body of loop L within the nest rooted at Outer
+/// runs each time L is entered, with the branch Guard conditionally entering
+/// it set if needed, or null if unknown or not invariant in the nest.
+static const SCEV *getMatmulTripCount(Loop *L, Loop *Outer, ScalarEvolution &SE,
+                                      DominatorTree &DT, BranchInst *&Guard,
+                                      unsigned &GuardEnters) {
+  Guard = nullptr;
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Exiting = L->getExitingBlock();
+  if (!Preheader || !Latch || !Exiting || !L->getExitBlock() ||
+      (Exiting != Latch && Exiting != L->getHeader()))
+    return nullptr;
+  if (!L->getCanonicalInductionVariable())
+    return nullptr;
+  const SCEV *BTC = SE.getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BTC) || !SE.isLoopInvariant(BTC, Outer))
+    return nullptr;
+  Type *i64 = Type::getInt64Ty(L->getHeader()->getContext());
+  const SCEV *Count = SE.getTruncateOrZeroExtend(BTC, i64);
+  // The body of a loop exiting from its header runs once fewer than it.
+  if (Exiting == Latch)
+    Count = SE.getAddExpr(Count, SE.getOne(i64));
+  if (L == Outer)
+    return Count;
+
+  BasicBlock *ParentLatch = L->getParentLoop()->getLoopLatch();
+  if (DT.dominates(Preheader, ParentLatch))
+    return Count;
+  // A rotated loop runs at least once, so must be skipped by a guard whose
+  // condition does not vary within the nest.
+  BasicBlock *Pred = Preheader->getSinglePredecessor();
+  if (Exiting != Latch || !Pred || !DT.dominates(Pred, ParentLatch))
+    return nullptr;
+  auto BI = dyn_cast<BranchInst>(Pred->getTerminator());
+  if (!BI || !BI->isConditional())
+    return nullptr;
+  auto Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp)
+    return nullptr;
+  if (Outer->contains(Cmp))
+    for (auto Op : Cmp->operand_values())
+      if (!SE.isSCEVable(Op->getType()) ||
+          !SE.isLoopInvariant(SE.getSCEV(Op), Outer))
+        return nullptr;
+  Guard = BI;
+  GuardEnters = BI->getSuccessor(0) == Preheader ? 0 : 1;
+  return Count;
+}
+
+/// Split the address S of an access within the nest Loops into its base,
+/// invariant in the nest, and its stride in bytes along each loop, or return
+/// null if it is not affine in the nest.
+static const SCEV *getMatmulAccess(const SCEV *S, ArrayRef<Loop *> Loops,
+                                   ScalarEvolution &SE,
+                                   SmallVectorImpl<const SCEV *> &Strides) {
+  Type *i64 = Type::getInt64Ty(Loops[0]->getHeader()->getContext());
+  Strides.assign(Loops.size(), SE.getZero(i64));
+  while (auto AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    auto found = llvm::find(Loops, AR->getLoop());
+    if (found == Loops.end() || !AR->isAffine())
+      return nullptr;
+    const SCEV *Step = AR->getStepRecurrence(SE);
+    if (!SE.isLoopInvariant(Step, Loops[0]))
+      return nullptr;
+    Strides[found - Loops.begin()] = SE.getTruncateOrSignExtend(Step, i64);
+    S = AR->getStart();
+  }
+  if (!SE.isLoopInvariant(S, Loops[0]))
+    return nullptr;
+  return S;
+}
+
+/// Whether the loop nest rooted at Outer computes a matrix product, filling
+/// in MN if so. The nest must consist of one or two loops over the elements
+/// of C, each carrying only its canonical induction variable, around an
+/// innermost loop accumulating C[i, j] += A[i, k] * B[k, j], either in a
+/// reduction variable stored after the loop or directly in memory. The
+/// accumulation must start from zero or from C[i, j], and the product must
+/// be the only memory effect of the nest. Each element of C is computed
+/// once, the addresses it is stored to being provably distinct, and C may
+/// not alias A or B, such that the product computes the same values in the
+/// same order.
+static bool matchMatmulNest(Loop *Outer, ScalarEvolution &SE,
+                            DominatorTree &DT, AAResults &AA,
+                            MatmulNest &MN) {
+  SmallVector<Loop *, 3> Loops = {Outer};
+  while (Loops.size() <= 3 && Loops.back()->getSubLoops().size() == 1)
+    Loops.push_back(Loops.back()->getSubLoops()[0]);
+  if (Loops.size() < 2 || Loops.size() > 3 ||
+      !Loops.back()->getSubLoops().empty())
+    return false;
+  Loop *Red = Loops.back();
+  Loop *Parent = Red->getParentLoop();
+  unsigned Last = Loops.size() - 1;
+
+  const SCEV *Counts[3];
+  BranchInst *Guards[3];
+  unsigned GuardEnters[3];
+  for (unsigned i = 0; i < Loops.size(); i++) {
+    Counts[i] = getMatmulTripCount(Loops[i], Outer, SE, DT, Guards[i],
+                                   GuardEnters[i]);
+    if (!Counts[i])
+      return false;
+  }
+  for (auto L : ArrayRef<Loop *>(Loops).drop_back())
+    for (auto &PN : L->getHeader()->phis())
+      if (&PN != L->getCanonicalInductionVariable())
+        return false;
+  PHINode *Acc = nullptr;
+  for (auto &PN : Red->getHeader()->phis()) {
+    if (&PN == Red->getCanonicalInductionVariable())
+      continue;
+    if (Acc || !PN.getType()->isFloatingPointTy())
+      return false;
+    Acc = &PN;
+  }
+
+  SmallPtrSet<LoadInst *, 4> Loads;
+  SmallPtrSet<StoreInst *, 2> Stores;
+  for (auto BB : Outer->blocks()) {
+    if (isa<InvokeInst>(BB->getTerminator()))
+      return false;
+    for (auto &I : *BB) {
+      for (auto U : I.users())
+        if (!Outer->contains(cast<Instruction>(U)))
+          return false;
+      if (auto LI = dyn_cast<LoadInst>(&I)) {
+        if (!LI->isSimple())
+          return false;
+        Loads.insert(LI);
+        continue;
+      }
+      if (auto SI = dyn_cast<StoreInst>(&I)) {
+        if (!SI->isSimple())
+          return false;
+        Stores.insert(SI);
+        continue;
+      }
+      if (isa<DbgInfoIntrinsic>(&I))
+        continue;
+      if (auto II = dyn_cast<IntrinsicInst>(&I))
+        if (II->getIntrinsicID() == Intrinsic::fmuladd)
+          continue;
+      if (isa<CallInst>(&I) || I.mayReadOrWriteMemory() ||
+          I.mayHaveSideEffects())
+        return false;
+    }
+  }
+
+  // Whether U computes Sum + X * Y for loads X and Y of the reduction loop,
+  // used nowhere else, and whether it does so with llvm.fmuladd.
+  LoadInst *X = nullptr, *Y = nullptr;
+  bool Fused = false;
+  auto matchProduct = [&](Value *U, Value *Sum) {
+    Value *Factors[2];
+    if (auto II = dyn_cast<IntrinsicInst>(U)) {
+      if (II->getIntrinsicID() != Intrinsic::fmuladd ||
+          II->getArgOperand(2) != Sum)
+        return false;
+      Factors[0] = II->getArgOperand(0);
+      Factors[1] = II->getArgOperand(1);
+      Fused = true;
+    } else {
+      auto Add = dyn_cast<BinaryOperator>(U);
+      if (!Add || Add->getOpcode() != Instruction::FAdd)
+        return false;
+      Value *Prod = Add->getOperand(0) == Sum ? Add->getOperand(1)
+                                               : Add->getOperand(0);
+      if (Add->getOperand(0) != Sum && Add->getOperand(1) != Sum)
+        return false;
+      auto Mul = dyn_cast<BinaryOperator>(Prod);
+      if (!Mul || Mul->getOpcode() != Instruction::FMul || !Mul->hasOneUse())
+        return false;
+      Factors[0] = Mul->getOperand(0);
+      Factors[1] = Mul->getOperand(1);
+    }
+    X = dyn_cast<LoadInst>(Factors[0]);
+    Y = dyn_cast<LoadInst>(Factors[1]);
+    return X && Y && X != Y && Red->contains(X) && Red->contains(Y) &&
+           X->hasOneUse() && Y->hasOneUse();
+  };
+  auto isZero = [](Value *V) {
+    auto CFP = dyn_cast<ConstantFP>(V);
+    return CFP && CFP->isZero() && !CFP->isNegative();
+  };
+  auto samePointer = [&](Value *P, Value *Q) {
+    return SE.getSCEV(P) == SE.getSCEV(Q);
+  };
+
+  StoreInst *Store = nullptr;
+  LoadInst *Init = nullptr;
+  bool Accumulate;
+  if (Acc) {
+    // s = init; for k: s += A[i, k] * B[k, j]; C[i, j] = s
+    if (Stores.size() != 1)
+      return false;
+    Store = *Stores.begin();
+    if (Red->contains(Store) ||
+        !DT.dominates(Store->getParent(), Parent->getLoopLatch()))
+      return false;
+    Value *U = Acc->getIncomingValueForBlock(Red->getLoopLatch());
+    if (!matchProduct(U, Acc))
+      return false;
+    Value *Exit = Red->getExitingBlock() == Red->getLoopLatch()
+                      ? U
+                      : static_cast<Value *>(Acc);
+    Value *Start = Acc->getIncomingValueForBlock(Red->getLoopPreheader());
+    for (auto V : {static_cast<Value *>(Acc), U})
+      for (auto User : V->users())
+        if (User != Acc && User != U && V != Exit)
+          return false;
+
+    // The value stored must be that of the reduction, or its start if the
+    // guard of the reduction loop skipped it.
+    SmallVector<Value *, 4> Todo = {Exit};
+    SmallPtrSet<Value *, 4> Seen;
+    bool Merged = false;
+    while (Todo.size()) {
+      Value *V = Todo.pop_back_val();
+      if (!Seen.insert(V).second)
+        continue;
+      for (auto User : V->users()) {
+        if (V == Exit && Red->contains(cast<Instruction>(User)))
+          continue;
+        if (User == Store && Store->getValueOperand() == V)
+          continue;
+        auto PN = dyn_cast<PHINode>(User);
+        if (!PN)
+          return false;
+        if (PN->getNumIncomingValues() != 1) {
+          BranchInst *Guard = Guards[Last];
+          if (!Guard || PN->getNumIncomingValues() != 2)
+            return false;
+          for (unsigned i = 0; i < 2; i++)
+            if (PN->getIncomingBlock(i) == Guard->getParent()) {
+              if (PN->getIncomingValue(i) != Start)
+                return false;
+            } else if (!Seen.count(PN->getIncomingValue(i)))
+              return false;
+          Merged = true;
+        }
+        Todo.push_back(PN);
+      }
+    }
+    if (!Seen.count(Store->getValueOperand()) || (Guards[Last] && !Merged))
+      return false;
+
+    if (isZero(Start)) {
+      Accumulate = false;
+    } else {
+      Init = dyn_cast<LoadInst>(Start);
+      if (!Init || Red->contains(Init) ||
+          !samePointer(Init->getPointerOperand(), Store->getPointerOperand()))
+        return false;
+      for (auto User : Init->users())
+        if (User != Acc && !Seen.count(User))
+          return false;
+      Accumulate = true;
+    }
+    if (Loads.size() != (Init ? 3 : 2))
+      return false;
+  } else {
+    // [C[i, j] = 0;] for k: C[i, j] += A[i, k] * B[k, j]
+    StoreInst *Clear = nullptr;
+    for (auto SI : Stores) {
+      if (Red->contains(SI)) {
+        if (Store)
+          return false;
+        Store = SI;
+      } else {
+        if (Clear)
+          return false;
+        Clear = SI;
+      }
+    }
+    if (!Store || !DT.dominates(Store->getParent(), Red->getLoopLatch()) ||
+        !SE.isLoopInvariant(SE.getSCEV(Store->getPointerOperand()), Red))
+      return false;
+    LoadInst *Sum = nullptr;
+    Value *U = Store->getValueOperand();
+    if (auto I = dyn_cast<Instruction>(U)) {
+      if (!I->hasOneUse())
+        return false;
+      for (auto &Op : I->operands())
+        if (auto LI = dyn_cast<LoadInst>(Op))
+          if (Red->contains(LI) &&
+              samePointer(LI->getPointerOperand(), Store->getPointerOperand()))
+            Sum = LI;
+    }
+    if (!Sum || !Sum->hasOneUse() || !matchProduct(U, Sum))
+      return false;
+    if (Clear) {
+      BasicBlock *Entry = Guards[Last] ? Guards[Last]->getParent()
+                                       : Red->getLoopPreheader();
+      if (!isZero(Clear->getValueOperand()) ||
+          !samePointer(Clear->getPointerOperand(),
+                       Store->getPointerOperand()) ||
+          !DT.dominates(Clear, Entry->getTerminator()) ||
+          !DT.dominates(Clear->getParent(), Parent->getLoopLatch()))
+        return false;
+    }
+    Accumulate = !Clear;
+    if (Loads.size() != 3)
+      return false;
+  }
+  Type *T = X->getType();
+  if (!T->isFloatingPointTy() || Y->getType() != T ||
+      Store->getValueOperand()->getType() != T)
+    return false;
+
+  SmallVector<const SCEV *, 3> SX, SY, SC;
+  const SCEV *BX = getMatmulAccess(SE.getSCEV(X->getPointerOperand()), Loops,
+                                   SE, SX);
+  const SCEV *BY = getMatmulAccess(SE.getSCEV(Y->getPointerOperand()), Loops,
+                                   SE, SY);
+  const SCEV *BC = getMatmulAccess(SE.getSCEV(Store->getPointerOperand()),
+                                   Loops, SE, SC);
+  if (!BX || !BY || !BC || !SC[Last]->isZero())
+    return false;
+  // Each loop over elements of C moves along exactly one factor, which
+  // decides whether it runs over the rows or the columns.
+  int Rows = -1, Cols = -1;
+  for (unsigned i = 0; i < Last; i++) {
+    bool AlongX = !SX[i]->isZero(), AlongY = !SY[i]->isZero();
+    if (AlongX == AlongY)
+      return false;
+    int &Dim = AlongX ? Rows : Cols;
+    if (Dim != -1)
+      return false;
+    Dim = i;
+  }
+
+  auto &DL = Outer->getHeader()->getModule()->getDataLayout();
+  Type *i64 = Type::getInt64Ty(T->getContext());
+  const SCEV *Zero = SE.getZero(i64);
+  MN.Outer = Outer;
+  MN.T = T;
+  MN.Accumulate = Accumulate;
+  MN.Fused = Fused;
+  MN.Base[0] = BX;
+  MN.Base[1] = BY;
+  MN.Base[2] = BC;
+  MN.Stride[0][0] = Rows == -1 ? Zero : SX[Rows];
+  MN.Stride[0][1] = SX[Last];
+  MN.Stride[1][0] = SY[Last];
+  MN.Stride[1][1] = Cols == -1 ? Zero : SY[Cols];
+  MN.Stride[2][0] = Rows == -1 ? Zero : SC[Rows];
+  MN.Stride[2][1] = Cols == -1 ? Zero : SC[Cols];
+  int Dims[3] = {Rows, Cols, (int)Last};
+  for (unsigned i = 0; i < 3; i++) {
+    MN.Count[i] = Dims[i] == -1 ? SE.getOne(i64) : Counts[Dims[i]];
+    MN.Guard[i] = Dims[i] == -1 ? nullptr : Guards[Dims[i]];
+    MN.GuardEnters[i] = Dims[i] == -1 ? 0 : GuardEnters[Dims[i]];
+  }
+
+  // Distinct elements of C must lie at distinct addresses.
+  const SCEV *Size = SE.getConstant(i64, DL.getTypeStoreSize(T));
+  auto atLeast = [&](const SCEV *S, const SCEV *Bound) {
+    return SE.isKnownPredicate(ICmpInst::ICMP_SGE, S, Bound);
+  };
+  // Only counts of loops that run matter, for which n smax 0 is n.
+  auto running = [](const SCEV *Count) {
+    if (auto Max = dyn_cast<SCEVSMaxExpr>(Count))
+      if (Max->getNumOperands() == 2 && Max->getOperand(0)->isZero())
+        return Max->getOperand(1);
+    return Count;
+  };
+  const SCEV *SCM = MN.Stride[2][0], *SCN = MN.Stride[2][1];
+  if (Rows != -1 && Cols != -1) {
+    if (!(atLeast(SCN, Size) &&
+          atLeast(SCM, SE.getMulExpr(SCN, running(MN.Count[1])))) &&
+        !(atLeast(SCM, Size) &&
+          atLeast(SCN, SE.getMulExpr(SCM, running(MN.Count[0])))))
+      return false;
+  } else if (Rows != -1) {
+    if (!atLeast(SCM, Size))
+      return false;
+  } else if (Cols != -1) {
+    if (!atLeast(SCN, Size))
+      return false;
+  }
+
+  // The product is only reordered if C does not alias its factors.
+  auto getObj = [&](Value *Ptr) {
+#if LLVM_VERSION_MAJOR >= 12
+    return getUnderlyingObject(Ptr, 100);
+#else
+    return GetUnderlyingObject(Ptr, DL, 100);
+#endif
+  };
+  Value *ObjC = getObj(Store->getPointerOperand());
+  for (auto LI : {X, Y}) {
+    Value *Obj = getObj(LI->getPointerOperand());
+#if LLVM_VERSION_MAJOR >= 12
+    if (!AA.isNoAlias(MemoryLocation::getBeforeOrAfter(ObjC),
+                      MemoryLocation::getBeforeOrAfter(Obj)))
+      return false;
+#else
+    if (!AA.isNoAlias(MemoryLocation(ObjC, MemoryLocation::UnknownSize),
+                      MemoryLocation(Obj, MemoryLocation::UnknownSize)))
+      return false;
+#endif
+  }
+  return true;
+}
+
+/// Replace the loop nest MN by a call to the matrix product kernel, whose
+/// derivative is computed as a whole by further blocked products.
+static void replaceMatmulNest(const MatmulNest &MN, ScalarEvolution &SE) {
+  Loop *Outer = MN.Outer;
+  BasicBlock *Preheader = Outer->getLoopPreheader();
+  BasicBlock *Exit = Outer->getExitBlock();
+  BasicBlock *Exiting = Outer->getExitingBlock();
+  Instruction *InsertPt = Preheader->getTerminator();
+  Module &M = *Preheader->getModule();
+  auto &DL = M.getDataLayout();
+  Type *i64 = Type::getInt64Ty(M.getContext());
+  Type *PT = PointerType::getUnqual(MN.T);
+
+  IRBuilder<> B(InsertPt);
+  SmallVector<Value *, 13> Args;
+  {
+#if LLVM_VERSION_MAJOR >= 12
+    SCEVExpander Exp(SE, DL, "enzyme");
+#else
+    fake::SCEVExpander Exp(SE, DL, "enzyme");
+#endif
+    for (unsigned i = 0; i < 3; i++) {
+      Value *Count = Exp.expandCodeFor(MN.Count[i], i64, InsertPt);
+      if (auto Guard = MN.Guard[i]) {
+        auto Cmp = cast<ICmpInst>(Guard->getCondition());
+        Value *Cond = Cmp;
+        if (Outer->contains(Cmp)) {
+          Value *LHS = Exp.expandCodeFor(SE.getSCEV(Cmp->getOperand(0)),
+                                         Cmp->getOperand(0)->getType(),
+                                         InsertPt);
+          Value *RHS = Exp.expandCodeFor(SE.getSCEV(Cmp->getOperand(1)),
+                                         Cmp->getOperand(1)->getType(),
+                                         InsertPt);
+          Cond = B.CreateICmp(Cmp->getPredicate(), LHS, RHS);
+        }
+        Value *None = ConstantInt::get(i64, 0);
+        Count = MN.GuardEnters[i] == 0 ? B.CreateSelect(Cond, Count, None)
+                                       : B.CreateSelect(Cond, None, Count);
+      }
+      Args.push_back(Count);
+    }
+    for (unsigned i = 0; i < 3; i++) {
+      Args.push_back(Exp.expandCodeFor(MN.Base[i], PT, InsertPt));
+      Args.push_back(Exp.expandCodeFor(MN.Stride[i][0], i64, InsertPt));
+      Args.push_back(Exp.expandCodeFor(MN.Stride[i][1], i64, InsertPt));
+    }
+  }
+  Args.push_back(ConstantInt::get(i64, MN.Accumulate));
+  B.CreateCall(getOrInsertMatmul(M, MN.T, MN.Fused), Args);
+  B.CreateBr(Exit);
+  InsertPt->eraseFromParent();
+
+  // The exit is dedicated to the nest, whose values are not used outside.
+  for (auto &PN : Exit->phis())
+    for (unsigned i = 0; i < PN.getNumIncomingValues(); i++)
+      if (PN.getIncomingBlock(i) == Exiting)
+        PN.setIncomingBlock(i, Preheader);
+  SmallVector<BasicBlock *, 8> Blocks(Outer->block_begin(),
+                                      Outer->block_end());
+  for (auto BB : Blocks)
+    BB->dropAllReferences();
+  for (auto BB : Blocks)
+    BB->eraseFromParent();
+}
+
+/// Replace loop nests of F computing matrix products by calls to a blocked
+/// kernel, which is differentiated as a whole rather than element by element.
+static void RecognizeMatmulLoops(Function *F, FunctionAnalysisManager &FAM) {
+  while (true) {
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(*F);
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+    AssumptionCache &AC = FAM.getResult<AssumptionAnalysis>(*F);
+    TargetLibraryInfo &TLI = FAM.getResult<TargetLibraryAnalysis>(*F);
+    AAResults &AA = FAM.getResult<AAManager>(*F);
+    MustExitScalarEvolution SE(*F, TLI, AC, DT, LI);
+    MatmulNest MN = {};
+    bool Found = false;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+      if (matchMatmulNest(L, SE, DT, AA, MN)) {
+        Found = true;
+        break;
+      }
+    }
+    if (!Found)
+      return;
+    replaceMatmulNest(MN, SE);
+    FAM.invalidate(*F, PreservedAnalyses::none());
+  }
+}
+
 PreProcessCache::PreProcessCache() {
   FAM.registerPass([] { return AssumptionAnalysis(); });
   FAM.registerPass([] { return TargetLibraryAnalysis(); });
@@ -1748,6 +2774,18 @@ Function *PreProcessCache::preprocessForClone(Function *F,
     FAM.invalidate(*NewF, PA);
   }
 
+  if (EnzymeMatmulIdiom)
+    RecognizeMatmulLoops(NewF, FAM);
+
+  // Split forward mode shares this preprocessing with the augmented forward
+  // pass, so the outlined regions are also differentiated in that mode.
+  if (EnzymeParallelReverseLoops && !isOpenMPOutlined(F) &&
+      (mode == DerivativeMode::ReverseModePrimal ||
+       mode == DerivativeMode::ReverseModeCombined)) {
+    ParallelizeIndependentLoops(NewF, FAM);
+    FAM.invalidate(*NewF, PreservedAnalyses::none());
+  }
+
   {
     SmallVector<Instruction *, 4> ToErase;
     for (auto &BB : *NewF) {
@@ -2367,3 +3405,380 @@ void PreProcessCache::clear() {
   MAM.clear();
   cache.clear();
 }
+
+namespace {
+/// Replaces the control flow of a function by straight-line code predicated
+/// on i1 masks, see LinearizeControlFlow. Loops are linearized as a unit
+/// within their parent, and their bodies are linearized in turn.
+class ControlFlowLinearizer {
+public:
+  ControlFlowLinearizer(Function *F, LoopInfo &LI,
+                        std::map<Instruction *, Value *> &masks,
+                        SmallPtrSetImpl<BranchInst *> &anyBranches)
+      : F(F), LI(LI), masks(masks), anyBranches(anyBranches) {}
+
+  bool run(Value *entryMask);
+
+private:
+  Function *F;
+  LoopInfo &LI;
+  std::map<Instruction *, Value *> &masks;
+  SmallPtrSetImpl<BranchInst *> &anyBranches;
+
+  typedef std::pair<BasicBlock *, BasicBlock *> Edge;
+
+  /// The lanes running each block, in the current iteration of its loop.
+  std::map<BasicBlock *, Value *> blockMask;
+  /// The lanes taking each edge. For edges leaving a loop, the lanes which
+  /// took it in any iteration, available after the loop.
+  std::map<Edge, Value *> edgeMask;
+  /// Incoming values of phis along edges leaving a loop, available after the
+  /// loop, in the lanes which took the edge.
+  std::map<std::pair<PHINode *, BasicBlock *>, Value *> edgeValue;
+  /// Blocks in the order they run once linearized.
+  SmallVector<BasicBlock *, 16> order;
+  SmallVector<BasicBlock *, 4> returns;
+  /// Each linearized loop and the lanes iterating it again, by latch.
+  std::map<BasicBlock *, std::pair<Loop *, Value *>> latches;
+
+  /// The node of region L (a loop, or null for the whole function) holding
+  /// BB: either BB or the header of the loop in L holding it. Returns null if
+  /// BB lies outside of L.
+  BasicBlock *nodeFor(Loop *L, BasicBlock *BB) {
+    Loop *Sub = LI.getLoopFor(BB);
+    if (Sub == L)
+      return BB;
+    while (Sub && Sub->getParentLoop() != L)
+      Sub = Sub->getParentLoop();
+    return Sub ? Sub->getHeader() : nullptr;
+  }
+
+  /// The loop in region L that node N stands for, if any.
+  Loop *loopFor(Loop *L, BasicBlock *N) {
+    Loop *Sub = LI.getLoopFor(N);
+    return Sub != L ? Sub : nullptr;
+  }
+
+  /// The distinct CFG edges leaving node N of region L.
+  void nodeEdges(Loop *L, BasicBlock *N, SmallVectorImpl<Edge> &edges) {
+    auto add = [&](BasicBlock *X, BasicBlock *Y) {
+      if (!llvm::is_contained(edges, Edge(X, Y)))
+        edges.push_back(Edge(X, Y));
+    };
+    if (Loop *Sub = loopFor(L, N)) {
+      for (BasicBlock *X : Sub->blocks())
+        for (BasicBlock *Y : successors(X))
+          if (!Sub->contains(Y))
+            add(X, Y);
+    } else {
+      for (BasicBlock *Y : successors(N))
+        add(N, Y);
+    }
+  }
+
+  /// The lanes in mask for which cond holds.
+  static Value *maskAnd(IRBuilder<> &B, Value *cond, Value *mask) {
+    if (auto C = dyn_cast<ConstantInt>(mask))
+      return C->isOne() ? cond : mask;
+    return B.CreateAnd(cond, mask);
+  }
+
+  bool linearizeRegion(Loop *L, Value *entryMask);
+  void linearizeBlock(BasicBlock *BB, bool isHeader, Value *knownMask);
+  bool linearizeLoop(Loop *L);
+  bool fail(Instruction *I, StringRef reason) {
+    EmitFailure("CannotLinearize", I->getDebugLoc(), I,
+                "cannot batch divergent control flow: ", reason, " ", *I);
+    return false;
+  }
+};
+} // namespace
+
+bool ControlFlowLinearizer::linearizeRegion(Loop *L, Value *entryMask) {
+  BasicBlock *Entry = L ? L->getHeader() : &F->getEntryBlock();
+
+  // Order the nodes of the region, ignoring the backedge to its header.
+  SmallVector<BasicBlock *, 16> nodes;
+  {
+    SmallPtrSet<BasicBlock *, 16> seen;
+    SmallVector<std::pair<BasicBlock *, unsigned>, 16> stack;
+    std::map<BasicBlock *, SmallVector<Edge, 4>> succs;
+    seen.insert(Entry);
+    stack.emplace_back(Entry, 0);
+    nodeEdges(L, Entry, succs[Entry]);
+    std::reverse(succs[Entry].begin(), succs[Entry].end());
+    while (!stack.empty()) {
+      auto &top = stack.back();
+      auto &edges = succs[top.first];
+      if (top.second == edges.size()) {
+        nodes.push_back(top.first);
+        stack.pop_back();
+        continue;
+      }
+      BasicBlock *next = nodeFor(L, edges[top.second++].second);
+      if (next && next != Entry && seen.insert(next).second) {
+        nodeEdges(L, next, succs[next]);
+        std::reverse(succs[next].begin(), succs[next].end());
+        stack.emplace_back(next, 0);
+      }
+    }
+    std::reverse(nodes.begin(), nodes.end());
+  }
+
+  std::map<BasicBlock *, unsigned> position;
+  for (auto N : nodes)
+    position[N] = position.size();
+
+  // Edges from earlier nodes not yet reached. A node reached by all of them
+  // runs in every lane running the region.
+  unsigned open = 0;
+  std::map<BasicBlock *, unsigned> incoming;
+  for (BasicBlock *N : nodes) {
+    bool full = incoming[N] == open;
+    open -= incoming[N];
+
+    if (Loop *Sub = loopFor(L, N)) {
+      if (!linearizeLoop(Sub))
+        return false;
+    } else {
+      linearizeBlock(N, N == Entry && L, full ? entryMask : nullptr);
+      Instruction *T = N->getTerminator();
+      if (!isa<BranchInst>(T) && !isa<SwitchInst>(T) && !isa<ReturnInst>(T) &&
+          !isa<UnreachableInst>(T))
+        return fail(T, "unsupported terminator");
+      if (isa<ReturnInst>(T))
+        returns.push_back(N);
+      if (succ_empty(N))
+        open++;
+    }
+
+    SmallVector<Edge, 4> edges;
+    nodeEdges(L, N, edges);
+    for (auto E : edges) {
+      BasicBlock *next = nodeFor(L, E.second);
+      if (next && next != Entry) {
+        if (position[next] <= position[N])
+          return fail(N->getTerminator(), "irreducible control flow");
+        incoming[next]++;
+      } else if (next == Entry && (!L || E.first != L->getLoopLatch())) {
+        return fail(E.first->getTerminator(), "irreducible control flow");
+      }
+      open++;
+    }
+  }
+  return true;
+}
+
+void ControlFlowLinearizer::linearizeBlock(BasicBlock *BB, bool isHeader,
+                                           Value *knownMask) {
+  IRBuilder<> B(BB, BB->getFirstInsertionPt());
+  LLVMContext &Ctx = BB->getContext();
+
+  Value *mask = knownMask;
+  if (!mask) {
+    SmallPtrSet<BasicBlock *, 4> seen;
+    for (BasicBlock *P : predecessors(BB))
+      if (seen.insert(P).second) {
+        Value *em = edgeMask.at(Edge(P, BB));
+        mask = mask ? B.CreateOr(em, mask) : em;
+      }
+  }
+  blockMask[BB] = mask;
+
+  // Every block now falls through to the next, so merges become selects on
+  // the lanes entering along each edge. Header phis stay, to carry values
+  // across iterations.
+  if (!isHeader) {
+    for (PHINode &phi : make_early_inc_range(BB->phis())) {
+      Value *merged = nullptr;
+      SmallPtrSet<BasicBlock *, 4> seen;
+      for (unsigned i = 0; i < phi.getNumIncomingValues(); ++i) {
+        BasicBlock *P = phi.getIncomingBlock(i);
+        if (!seen.insert(P).second)
+          continue;
+        auto found = edgeValue.find(std::make_pair(&phi, P));
+        Value *val = found != edgeValue.end() ? found->second
+                                              : phi.getIncomingValue(i);
+        merged = merged ? B.CreateSelect(edgeMask.at(Edge(P, BB)), val,
+                                         merged, phi.getName())
+                        : val;
+      }
+      phi.replaceAllUsesWith(merged);
+      phi.eraseFromParent();
+    }
+  }
+
+  // Side effects and traps must only happen in the lanes running the block.
+  auto C = dyn_cast<ConstantInt>(mask);
+  if (!C || !C->isOne()) {
+    for (Instruction &I : *BB) {
+      if (I.isTerminator() || isa<AllocaInst>(&I) ||
+          isa<DbgInfoIntrinsic>(&I))
+        continue;
+      if (auto II = dyn_cast<IntrinsicInst>(&I))
+        if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
+            II->getIntrinsicID() == Intrinsic::lifetime_end)
+          continue;
+      if (I.mayReadOrWriteMemory()) {
+        masks[&I] = mask;
+      } else if (I.getOpcode() == Instruction::UDiv ||
+                 I.getOpcode() == Instruction::SDiv ||
+                 I.getOpcode() == Instruction::URem ||
+                 I.getOpcode() == Instruction::SRem) {
+        IRBuilder<> DB(&I);
+        I.setOperand(1, DB.CreateSelect(mask, I.getOperand(1),
+                                        ConstantInt::get(I.getType(), 1)));
+      }
+    }
+  }
+
+  IRBuilder<> TB(BB->getTerminator());
+  if (auto BI = dyn_cast<BranchInst>(BB->getTerminator())) {
+    if (BI->isUnconditional() ||
+        BI->getSuccessor(0) == BI->getSuccessor(1)) {
+      edgeMask[Edge(BB, BI->getSuccessor(0))] = mask;
+    } else {
+      Value *cond = BI->getCondition();
+      edgeMask[Edge(BB, BI->getSuccessor(0))] = maskAnd(TB, cond, mask);
+      edgeMask[Edge(BB, BI->getSuccessor(1))] =
+          maskAnd(TB, TB.CreateNot(cond), mask);
+    }
+  } else if (auto SI = dyn_cast<SwitchInst>(BB->getTerminator())) {
+    std::map<BasicBlock *, Value *> taken;
+    Value *anyCase = ConstantInt::getFalse(Ctx);
+    for (auto Case : SI->cases()) {
+      Value *eq = TB.CreateICmpEQ(SI->getCondition(), Case.getCaseValue());
+      Value *&cur = taken[Case.getCaseSuccessor()];
+      cur = cur ? TB.CreateOr(eq, cur) : eq;
+      anyCase = TB.CreateOr(eq, anyCase);
+    }
+    Value *&def = taken[SI->getDefaultDest()];
+    def = def ? TB.CreateOr(TB.CreateNot(anyCase), def)
+              : TB.CreateNot(anyCase);
+    SmallPtrSet<BasicBlock *, 4> seen;
+    for (BasicBlock *S : successors(BB))
+      if (seen.insert(S).second)
+        edgeMask[Edge(BB, S)] = maskAnd(TB, taken[S], mask);
+  }
+  order.push_back(BB);
+}
+
+bool ControlFlowLinearizer::linearizeLoop(Loop *L) {
+  BasicBlock *H = L->getHeader();
+  BasicBlock *P = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!P || !Latch)
+    return fail(H->getTerminator(), "loop not in simplified form");
+
+  // The loop runs while any lane is active. Lanes leaving it keep the values
+  // of the iteration they left in.
+  IRBuilder<> HB(H, H->begin());
+  Type *BoolTy = Type::getInt1Ty(H->getContext());
+  PHINode *active = HB.CreatePHI(BoolTy, 2, "active");
+  active->addIncoming(edgeMask.at(Edge(P, H)), P);
+
+  SmallVector<Edge, 4> exits;
+  nodeEdges(L->getParentLoop(), H, exits);
+  SmallVector<PHINode *, 4> exited;
+  SmallVector<std::pair<PHINode *, PHINode *>, 4> exitValues;
+  for (unsigned i = 0; i < exits.size(); ++i) {
+    PHINode *acc = HB.CreatePHI(BoolTy, 2, "exited");
+    acc->addIncoming(ConstantInt::getFalse(H->getContext()), P);
+    exited.push_back(acc);
+  }
+
+  if (!linearizeRegion(L, active))
+    return false;
+
+  IRBuilder<> LB(Latch->getTerminator());
+  Value *again = edgeMask.at(Edge(Latch, H));
+  active->addIncoming(again, Latch);
+  for (auto pair : llvm::zip(exits, exited)) {
+    Edge E = std::get<0>(pair);
+    PHINode *acc = std::get<1>(pair);
+    Value *em = edgeMask.at(E);
+    for (PHINode &phi : E.second->phis()) {
+      int idx = phi.getBasicBlockIndex(E.first);
+      if (idx < 0)
+        continue;
+      auto key = std::make_pair(&phi, E.first);
+      auto found = edgeValue.find(key);
+      Value *val = found != edgeValue.end() ? found->second
+                                            : phi.getIncomingValue(idx);
+      PHINode *vacc = HB.CreatePHI(phi.getType(), 2, phi.getName() + ".exit");
+      vacc->addIncoming(UndefValue::get(phi.getType()), P);
+      Value *next = LB.CreateSelect(em, val, vacc);
+      vacc->addIncoming(next, Latch);
+      edgeValue[key] = next;
+    }
+    Value *next = LB.CreateOr(em, acc);
+    acc->addIncoming(next, Latch);
+    edgeMask[E] = next;
+  }
+  latches[Latch] = std::make_pair(L, again);
+  return true;
+}
+
+bool ControlFlowLinearizer::run(Value *entryMask) {
+  LLVMContext &Ctx = F->getContext();
+  if (!linearizeRegion(nullptr, entryMask))
+    return false;
+
+  // The result is that of the return each lane reached.
+  BasicBlock *End = BasicBlock::Create(Ctx, "linearized.end", F);
+  IRBuilder<> EB(End);
+  Value *ret = nullptr;
+  for (BasicBlock *R : returns)
+    if (Value *val = cast<ReturnInst>(R->getTerminator())->getReturnValue())
+      ret = ret ? EB.CreateSelect(blockMask[R], val, ret) : val;
+  if (F->getReturnType()->isVoidTy())
+    EB.CreateRetVoid();
+  else
+    EB.CreateRet(ret ? ret : UndefValue::get(F->getReturnType()));
+
+  for (unsigned i = 0; i < order.size(); ++i) {
+    BasicBlock *BB = order[i];
+    BasicBlock *next = i + 1 < order.size() ? order[i + 1] : End;
+    if (i > 0)
+      BB->moveAfter(order[i - 1]);
+    BB->getTerminator()->eraseFromParent();
+    auto found = latches.find(BB);
+    if (found == latches.end()) {
+      BranchInst::Create(next, BB);
+      continue;
+    }
+    // Header phis now enter from whichever block precedes the loop.
+    Loop *L = found->second.first;
+    BasicBlock *H = L->getHeader();
+    BasicBlock *pre = order[std::find(order.begin(), order.end(), H) -
+                            order.begin() - 1];
+    for (PHINode &phi : H->phis())
+      for (unsigned j = 0; j < phi.getNumIncomingValues(); ++j)
+        if (phi.getIncomingBlock(j) == L->getLoopPreheader())
+          phi.setIncomingBlock(j, pre);
+    anyBranches.insert(BranchInst::Create(H, next, found->second.second, BB));
+  }
+  return true;
+}
+
+bool LinearizeControlFlow(Function *F, FunctionAnalysisManager &FAM,
+                          std::map<Instruction *, Value *> &masks,
+                          SmallPtrSetImpl<BranchInst *> &anyBranches,
+                          Value *entryMask) {
+  removeUnreachableBlocks(*F);
+  {
+    auto PA = LoopSimplifyPass().run(*F, FAM);
+    FAM.invalidate(*F, PA);
+  }
+  {
+    auto PA = LCSSAPass().run(*F, FAM);
+    FAM.invalidate(*F, PA);
+  }
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+  if (!entryMask)
+    entryMask = ConstantInt::getTrue(F->getContext());
+  bool success =
+      ControlFlowLinearizer(F, LI, masks, anyBranches).run(entryMask);
+  FAM.invalidate(*F, PreservedAnalyses::none());
+  return success;
+}
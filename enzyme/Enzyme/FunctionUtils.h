@@ -364,6 +364,19 @@ void ReplaceFunctionImplementation(llvm::Module &M);
 /// Is the use of value val as an argument of call CI potentially captured
 bool couldFunctionArgumentCapture(llvm::CallInst *CI, llvm::Value *val);
 
+/// Replace the control flow of F by straight-line code where every block runs,
+/// so that lanes of a batch may take different paths through it. Instructions
+/// which must only run in some lanes are mapped to the i1 mask of those lanes
+/// in masks. Loops instead branch back while their mask is true in any lane,
+/// on the branches added to anyBranches. If given, entryMask holds in the
+/// lanes running F at all. Returns false, emitting a failure, if the control
+/// flow cannot be linearized.
+bool LinearizeControlFlow(
+    llvm::Function *F, llvm::FunctionAnalysisManager &FAM,
+    std::map<llvm::Instruction *, llvm::Value *> &masks,
+    llvm::SmallPtrSetImpl<llvm::BranchInst *> &anyBranches,
+    llvm::Value *entryMask = nullptr);
+
 llvm::FunctionType *getFunctionTypeForClone(
     llvm::FunctionType *FTy, DerivativeMode mode, unsigned width,
     llvm::Type *additionalArg, llvm::ArrayRef<DIFFE_TYPE> constant_args,
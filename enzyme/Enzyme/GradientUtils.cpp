@@ -110,6 +110,11 @@ llvm::cl::opt<bool>
     EnzymeVectorSplitPhi("enzyme-vector-split-phi", cl::init(true), cl::Hidden,
                          cl::desc("Split phis according to vector size"));
 
+llvm::cl::opt<bool> EnzymeVectorShadows(
+    "enzyme-vector-shadows", cl::init(false), cl::Hidden,
+    cl::desc("Compute vector mode tangents and adjoints of scalar floating "
+             "point values as LLVM vectors rather than lane by lane"));
+
 llvm::cl::opt<bool>
     EnzymePrintDiffUse("enzyme-print-diffuse", cl::init(false), cl::Hidden,
                        cl::desc("Print differential use analysis"));
@@ -4882,6 +4887,7 @@ Value *GradientUtils::invertPointerM(Value *const oval, IRBuilder<> &BuilderM,
           },
           invertPointerM(II->getArgOperand(0), bb));
     case Intrinsic::masked_load:
+    case Intrinsic::masked_gather:
       return applyChainRule(
           II->getType(), bb,
           [&](Value *ptr, Value *defaultV) {
@@ -4897,6 +4903,25 @@ Value *GradientUtils::invertPointerM(Value *const oval, IRBuilder<> &BuilderM,
           },
           invertPointerM(II->getArgOperand(0), bb),
           invertPointerM(II->getArgOperand(3), bb, nullShadow));
+#if LLVM_VERSION_MAJOR >= 14
+    case Intrinsic::vp_load:
+    case Intrinsic::vp_gather:
+      return applyChainRule(
+          II->getType(), bb,
+          [&](Value *ptr) {
+            SmallVector<Value *, 3> args = {ptr};
+            for (unsigned i = 1; i < II->arg_size(); ++i)
+              args.push_back(getNewFromOriginal(II->getArgOperand(i)));
+            llvm::SmallVector<unsigned int, 9> ToCopy2(MD_ToCopy);
+            ToCopy2.push_back(LLVMContext::MD_noalias);
+            auto li = bb.CreateCall(II->getCalledFunction(), args);
+            li->setAttributes(II->getAttributes());
+            li->copyMetadata(*II, ToCopy2);
+            li->setDebugLoc(getNewFromOriginal(II->getDebugLoc()));
+            return li;
+          },
+          invertPointerM(II->getArgOperand(0), bb));
+#endif
     }
     }
   } else if (auto phi = dyn_cast<PHINode>(oval)) {
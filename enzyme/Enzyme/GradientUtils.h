@@ -102,6 +102,7 @@ extern llvm::cl::opt<bool> EnzymeRuntimeActivityCheck;
 extern llvm::cl::opt<bool> EnzymeInactiveDynamic;
 extern llvm::cl::opt<bool> EnzymeFreeInternalAllocations;
 extern llvm::cl::opt<bool> EnzymeRematerialize;
+extern llvm::cl::opt<bool> EnzymeVectorShadows;
 }
 extern llvm::SmallVector<unsigned int, 9> MD_ToCopy;
 
@@ -823,7 +824,7 @@ public:
                                  Logic.PPC.getAAResultsFromFunction(oldFunc_),
                                  notForAnalysis, TLI_, constantvalues_,
                                  activevals_, ReturnActivity)),
-        tid(nullptr), numThreads(nullptr),
+        can_modref_map(nullptr), tid(nullptr), numThreads(nullptr),
         OrigAA(Logic.PPC.getAAResultsFromFunction(oldFunc_)), TA(TA_), TR(TR_),
         omp(omp), width(width), ArgDiffeTypes(ArgDiffeTypes_) {
     if (oldFunc_->getSubprogram()) {
@@ -1591,6 +1592,89 @@ public:
       return rule(diffs);
     }
   }
+
+  /// Whether vector mode tangents of type ty are computed as a single
+  /// <width x ty> LLVM vector by applyVectorChainRule.
+  bool isVectorShadow(Type *ty) const {
+    return EnzymeVectorShadows && width > 1 && ty->isFloatingPointTy();
+  }
+
+  /// Converts a [width x T] shadow into a <width x T> vector, reusing the
+  /// vector it was unpacked from where possible.
+  Value *packShadow(IRBuilder<> &Builder, Value *shadow) {
+    auto AT = cast<ArrayType>(shadow->getType());
+    assert(AT->getNumElements() == width);
+#if LLVM_VERSION_MAJOR >= 11
+    auto VT = VectorType::get(AT->getElementType(), width, false);
+#else
+    auto VT = VectorType::get(AT->getElementType(), width);
+#endif
+    if (auto C = dyn_cast<Constant>(shadow))
+      if (C->isNullValue())
+        return Constant::getNullValue(VT);
+
+    Value *src = nullptr;
+    SmallVector<bool, 4> seen(width, false);
+    Value *agg = shadow;
+    while (auto IVI = dyn_cast<InsertValueInst>(agg)) {
+      if (IVI->getNumIndices() != 1)
+        break;
+      unsigned idx = IVI->getIndices()[0];
+      auto EEI = dyn_cast<ExtractElementInst>(IVI->getInsertedValueOperand());
+      if (!EEI || EEI->getVectorOperandType() != VT ||
+          (src && src != EEI->getVectorOperand()))
+        break;
+      auto CI = dyn_cast<ConstantInt>(EEI->getIndexOperand());
+      if (!CI || CI->getZExtValue() != idx)
+        break;
+      src = EEI->getVectorOperand();
+      seen[idx] = true;
+      agg = IVI->getAggregateOperand();
+    }
+    if (src && llvm::all_of(seen, [](bool b) { return b; }))
+      return src;
+
+    Value *res = UndefValue::get(VT);
+    for (unsigned i = 0; i < width; ++i)
+      res = Builder.CreateInsertElement(res, extractMeta(Builder, shadow, i),
+                                        i);
+    return res;
+  }
+
+  /// Converts a <width x T> vector tangent back into its [width x T] shadow.
+  Value *unpackShadow(IRBuilder<> &Builder, Value *vec) {
+    auto VT = cast<VectorType>(vec->getType());
+    Value *res = UndefValue::get(ArrayType::get(VT->getElementType(), width));
+    for (unsigned i = 0; i < width; ++i)
+      res = Builder.CreateInsertValue(res, Builder.CreateExtractElement(vec, i),
+                                      {i});
+    return res;
+  }
+
+  /// Broadcasts a primal operand of a vector chain rule to the type of the
+  /// tangent it is combined with.
+  static Value *splatLike(IRBuilder<> &Builder, Value *primal, Value *diff) {
+    if (primal->getType() == diff->getType())
+      return primal;
+    auto VT = cast<VectorType>(diff->getType());
+#if LLVM_VERSION_MAJOR >= 12
+    return Builder.CreateVectorSplat(VT->getElementCount(), primal);
+#else
+    return Builder.CreateVectorSplat(VT->getNumElements(), primal);
+#endif
+  }
+
+  /// Like applyChainRule, but when isVectorShadow(diffType) applies rule once
+  /// to all lanes packed as LLVM vectors. Primal values used by rule must be
+  /// combined with its arguments through splatLike.
+  template <typename Func, typename... Args>
+  Value *applyVectorChainRule(Type *diffType, IRBuilder<> &Builder, Func rule,
+                              Args... args) {
+    if (!isVectorShadow(diffType))
+      return applyChainRule(diffType, Builder, rule, args...);
+    Value *res = rule((args ? packShadow(Builder, args) : nullptr)...);
+    return unpackShadow(Builder, res);
+  }
 };
 
 class DiffeGradientUtils final : public GradientUtils {
@@ -1790,6 +1874,20 @@ public:
 
     Value *ptr = getDifferential(val);
 
+    // Accumulate all lanes of a vector adjoint at once.
+    if (idxs.size() == 0 && !mask && isVectorShadow(val->getType()) &&
+        dif->getType() == getShadowType(val->getType())) {
+#if LLVM_VERSION_MAJOR > 7
+      Value *old = BuilderM.CreateLoad(dif->getType(), ptr);
+#else
+      Value *old = BuilderM.CreateLoad(ptr);
+#endif
+      Value *res = BuilderM.CreateFAdd(packShadow(BuilderM, old),
+                                       packShadow(BuilderM, dif));
+      BuilderM.CreateStore(unpackShadow(BuilderM, res), ptr);
+      return addedSelects;
+    }
+
     if (idxs.size() != 0) {
       SmallVector<Value *, 4> sv = {
           ConstantInt::get(Type::getInt32Ty(val->getContext()), 0)};
@@ -2229,6 +2327,10 @@ public:
     // all additional parallelism in this function is outlined.
     if (backwardsOnlyShadows.find(TmpOrig) != backwardsOnlyShadows.end())
       Atomic = false;
+    // Nor on a shadow location that no other iteration of an outlined
+    // parallel loop accumulates into.
+    if (orig && hasMetadata(orig, "enzyme_noatomic"))
+      Atomic = false;
 
     if (Atomic) {
       // For amdgcn constant AS is 4 and if the primal is in it we need to cast
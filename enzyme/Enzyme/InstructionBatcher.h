@@ -31,6 +31,8 @@
 
 #include "llvm/Support/Casting.h"
 
+#include "llvm/Analysis/TargetLibraryInfo.h"
+
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Value.h"
@@ -50,17 +52,46 @@ public:
       Function *oldFunc, Function *newFunc, unsigned width,
       ValueMap<const Value *, std::vector<Value *>> &vectorizedValues,
       ValueToValueMapTy &originalToNewFn, SmallPtrSetImpl<Value *> &toVectorize,
-      EnzymeLogic &Logic)
+      const std::map<Instruction *, Value *> &masks,
+      const SmallPtrSetImpl<BranchInst *> &anyBranches, EnzymeLogic &Logic)
       : hasError(false), vectorizedValues(vectorizedValues),
         originalToNewFn(originalToNewFn), toVectorize(toVectorize),
-        width(width), Logic(Logic) {}
+        masks(masks), anyBranches(anyBranches), newFunc(newFunc),
+        width(width), Logic(Logic),
+        TLI(Logic.PPC.FAM.getResult<TargetLibraryAnalysis>(*oldFunc)) {}
+
+  /// Calls made once for all lanes, by the call of the original function.
+  std::map<const CallInst *, CallInst *> batchedCalls;
+
+  /// Memory accesses lowered to masked vector intrinsics, which already run
+  /// only in the lanes of their mask.
+  SmallPtrSet<const Instruction *, 4> maskedAccesses;
 
 private:
   ValueMap<const Value *, std::vector<Value *>> &vectorizedValues;
   ValueToValueMapTy &originalToNewFn;
   SmallPtrSetImpl<Value *> &toVectorize;
+  /// Instructions of linearized control flow and the mask of lanes they run
+  /// in, see LinearizeControlFlow.
+  const std::map<Instruction *, Value *> &masks;
+  /// Branches of linearized loops, taken if taken in any lane.
+  const SmallPtrSetImpl<BranchInst *> &anyBranches;
+  Function *newFunc;
   unsigned width;
   EnzymeLogic &Logic;
+  TargetLibraryInfo &TLI;
+
+  /// With EnzymeBatchSIMD, all lanes of a batched value as one <width x T>
+  /// vector.
+  ValueMap<const Value *, Value *> packedValues;
+  /// Vector phis, whose incoming values are added by finalize.
+  SmallVector<std::pair<const PHINode *, PHINode *>, 4> vectorPhis;
+  /// Gathers and scatters, with their mask if any, which finalize replaces
+  /// by vector loads and stores where the lanes are consecutive in memory.
+  SmallVector<std::tuple<const Instruction *, CallInst *, Value *>, 4>
+      gathers;
+  /// Whether the lanes of a pointer are consecutive for elements of a size.
+  std::map<std::pair<const Value *, uint64_t>, Value *> consecutive;
 
 private:
   Value *getNewOperand(unsigned int i, llvm::Value *op) {
@@ -76,8 +107,9 @@ private:
       return op;
     } else if (isa<Function>(op)) {
       return op;
-    } else if (isa<GlobalValue>(op)) {
-      // TODO: !!!
+    } else if (isa<Constant>(op)) {
+      // Globals are the same in all lanes.
+      return op;
     } else if (toVectorize.count(op) != 0) {
       auto found = vectorizedValues.find(op);
       assert(found != vectorizedValues.end());
@@ -89,8 +121,305 @@ private:
     }
   }
 
+#if LLVM_VERSION_MAJOR >= 11
+  static bool isSIMDType(Type *T) {
+    return T->isIntegerTy() || T->isFloatingPointTy();
+  }
+
+  VectorType *getVectorType(Type *T) {
+    return VectorType::get(T, width, false);
+  }
+
+  static Type *getAccessType(const Instruction *I) {
+    if (auto SI = dyn_cast<StoreInst>(I))
+      return SI->getValueOperand()->getType();
+    return I->getType();
+  }
+
+  static Align getAccessAlign(const Instruction *I) {
+    if (auto SI = dyn_cast<StoreInst>(I))
+      return SI->getAlign();
+    return cast<LoadInst>(I)->getAlign();
+  }
+
+  /// The instruction before which to insert code using V in newFunc.
+  Instruction *getInsertionPointAfter(Value *V) {
+    auto I = dyn_cast<Instruction>(V);
+    if (!I)
+      return &*newFunc->getEntryBlock().getFirstInsertionPt();
+    Instruction *pt = I->getNextNode();
+    while (isa<PHINode>(pt))
+      pt = pt->getNextNode();
+    return pt;
+  }
+
+  /// All lanes of orig, inserted into a vector after they are computed.
+  Value *getPacked(Value *orig) {
+    auto found = packedValues.find(orig);
+    if (found != packedValues.end())
+      return found->second;
+
+    auto VT = getVectorType(orig->getType());
+    if (auto C = dyn_cast<Constant>(orig))
+#if LLVM_VERSION_MAJOR >= 12
+      return ConstantVector::getSplat(VT->getElementCount(), C);
+#else
+      return ConstantVector::getSplat(ElementCount(width, false), C);
+#endif
+
+    Value *res;
+    if (toVectorize.count(orig) == 0) {
+      Value *scalar = getNewOperand(0, orig);
+      IRBuilder<> B(getInsertionPointAfter(scalar));
+      B.SetCurrentDebugLocation(DebugLoc());
+      res = B.CreateVectorSplat(width, scalar);
+    } else {
+      auto &lanes = vectorizedValues[orig];
+      IRBuilder<> B(getInsertionPointAfter(lanes.back()));
+      B.SetCurrentDebugLocation(DebugLoc());
+      res = UndefValue::get(VT);
+      for (unsigned i = 0; i < width; ++i)
+        res = B.CreateInsertElement(res, lanes[i], i);
+    }
+    return packedValues[orig] = res;
+  }
+
+  /// Replaces the lanes of orig by the elements of vec.
+  void unpack(Instruction &orig, Value *vec) {
+    auto &lanes = vectorizedValues[&orig];
+    for (unsigned i = 0; i < width; ++i) {
+      auto lane = ExtractElementInst::Create(
+          vec, ConstantInt::get(Type::getInt32Ty(orig.getContext()), i));
+      ReplaceInstWithInst(cast<Instruction>(lanes[i]), lane);
+      if (orig.hasName())
+        lane->setName(orig.getName() + Twine(i));
+      lanes[i] = lane;
+    }
+    packedValues[&orig] = vec;
+  }
+
+  static bool isSIMDIntrinsic(Intrinsic::ID ID) {
+    switch (ID) {
+    case Intrinsic::sqrt:
+    case Intrinsic::fabs:
+    case Intrinsic::exp:
+    case Intrinsic::exp2:
+    case Intrinsic::log:
+    case Intrinsic::log2:
+    case Intrinsic::log10:
+    case Intrinsic::sin:
+    case Intrinsic::cos:
+    case Intrinsic::pow:
+    case Intrinsic::fma:
+    case Intrinsic::fmuladd:
+    case Intrinsic::minnum:
+    case Intrinsic::maxnum:
+    case Intrinsic::floor:
+    case Intrinsic::ceil:
+    case Intrinsic::trunc:
+    case Intrinsic::round:
+    case Intrinsic::copysign:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  /// Batches inst as one instruction on <width x T> vectors, returning false
+  /// if it cannot be.
+  bool visitSIMD(Instruction &inst) {
+    if (isa<LoadInst>(inst) || isa<StoreInst>(inst))
+      return visitSIMDAccess(inst);
+
+    if (!isSIMDType(inst.getType()))
+      return false;
+    auto II = dyn_cast<IntrinsicInst>(&inst);
+    if (II && !isSIMDIntrinsic(II->getIntrinsicID()))
+      return false;
+    if (!II && !isa<BinaryOperator>(inst) && !isa<UnaryOperator>(inst) &&
+        !isa<CmpInst>(inst) && !isa<SelectInst>(inst) &&
+        !(isa<CastInst>(inst) && isSIMDType(inst.getOperand(0)->getType())))
+      return false;
+
+    IRBuilder<> B(cast<Instruction>(vectorizedValues[&inst][0]));
+    B.SetCurrentDebugLocation(inst.getDebugLoc());
+    Value *vec;
+    if (II) {
+      SmallVector<Value *, 3> args;
+      for (auto &arg : II->args())
+        args.push_back(getPacked(arg));
+      Function *F = Intrinsic::getDeclaration(
+          newFunc->getParent(), II->getIntrinsicID(),
+          {getVectorType(inst.getType())});
+      auto CI = B.CreateCall(F, args);
+      if (isa<FPMathOperator>(II))
+        CI->copyFastMathFlags(II);
+      vec = CI;
+    } else {
+      Instruction *vinst = inst.clone();
+      vinst->mutateType(getVectorType(inst.getType()));
+      for (unsigned j = 0; j < inst.getNumOperands(); ++j)
+        vinst->setOperand(j, getPacked(inst.getOperand(j)));
+      B.Insert(vinst);
+      vec = vinst;
+    }
+    if (inst.hasName())
+      vec->setName(inst.getName() + ".vec");
+    unpack(inst, vec);
+    return true;
+  }
+
+  /// Batches a load or store through a batched pointer as a masked gather or
+  /// scatter, returning false if it cannot be.
+  bool visitSIMDAccess(Instruction &inst) {
+    Value *ptr = getLoadStorePointerOperand(&inst);
+    Type *T = getAccessType(&inst);
+    if (!isSIMDType(T) || toVectorize.count(ptr) == 0)
+      return false;
+    if (auto LI = dyn_cast<LoadInst>(&inst))
+      if (!LI->isSimple())
+        return false;
+    if (auto SI = dyn_cast<StoreInst>(&inst))
+      if (!SI->isSimple())
+        return false;
+
+    Value *mask = nullptr;
+    auto found = masks.find(&inst);
+    if (found != masks.end())
+      mask = getPacked(found->second);
+
+    Instruction *placeholder = cast<Instruction>(vectorizedValues[&inst][0]);
+    IRBuilder<> B(placeholder);
+    B.SetCurrentDebugLocation(inst.getDebugLoc());
+    Value *ptrs = getPacked(ptr);
+    Align align = getAccessAlign(&inst);
+    CallInst *access;
+    if (isa<LoadInst>(inst)) {
+#if LLVM_VERSION_MAJOR >= 13
+      access = B.CreateMaskedGather(getVectorType(T), ptrs, align, mask);
+#else
+      access = B.CreateMaskedGather(ptrs, align, mask);
+#endif
+      if (inst.hasName())
+        access->setName(inst.getName() + ".vec");
+      unpack(inst, access);
+    } else {
+      Value *vals = getPacked(cast<StoreInst>(inst).getValueOperand());
+      access = B.CreateMaskedScatter(vals, ptrs, align, mask);
+      placeholder->eraseFromParent();
+      vectorizedValues[&inst][0] = access;
+    }
+    gathers.emplace_back(&inst, access, mask);
+    maskedAccesses.insert(&inst);
+    return true;
+  }
+
+  /// Whether the lanes of orig, a batched pointer, point to consecutive
+  /// elements of the given size.
+  Value *getConsecutive(Value *orig, uint64_t size) {
+    auto found = consecutive.find(std::make_pair(orig, size));
+    if (found != consecutive.end())
+      return found->second;
+
+    // Offsetting all lanes by the same amount keeps them consecutive.
+    if (auto GEP = dyn_cast<GetElementPtrInst>(orig))
+      if (toVectorize.count(GEP->getPointerOperand()) &&
+          llvm::none_of(GEP->indices(),
+                        [&](Value *V) { return toVectorize.count(V); }))
+        return getConsecutive(GEP->getPointerOperand(), size);
+    if (auto BC = dyn_cast<BitCastInst>(orig))
+      if (toVectorize.count(BC->getOperand(0)))
+        return getConsecutive(BC->getOperand(0), size);
+
+    auto &lanes = vectorizedValues[orig];
+    IRBuilder<> B(getInsertionPointAfter(lanes.back()));
+    B.SetCurrentDebugLocation(DebugLoc());
+    auto &DL = newFunc->getParent()->getDataLayout();
+    Type *intPtrTy = DL.getIntPtrType(orig->getType());
+    Value *first = B.CreatePtrToInt(lanes[0], intPtrTy);
+    Value *res = nullptr;
+    for (unsigned i = 1; i < width; ++i) {
+      Value *diff = B.CreateSub(B.CreatePtrToInt(lanes[i], intPtrTy), first);
+      Value *eq = B.CreateICmpEQ(diff, ConstantInt::get(intPtrTy, i * size));
+      res = res ? B.CreateAnd(res, eq) : eq;
+    }
+    // Lanes masked off may hold poison pointers.
+    res = B.CreateFreeze(res, "consecutive");
+    return consecutive[std::make_pair(orig, size)] = res;
+  }
+
+  /// Runs access as a vector load or store from its first lane where all of
+  /// the lanes are consecutive in memory.
+  void versionAccess(const Instruction &orig, CallInst *access, Value *mask) {
+    auto &DL = newFunc->getParent()->getDataLayout();
+    Type *T = getAccessType(&orig);
+    uint64_t size = DL.getTypeStoreSize(T);
+    if (!DL.typeSizeEqualsStoreSize(T) || DL.getTypeAllocSize(T) != size)
+      return;
+    Value *ptr = getLoadStorePointerOperand(const_cast<Instruction *>(&orig));
+    Value *cond = getConsecutive(ptr, size);
+
+    Instruction *ThenTerm, *ElseTerm;
+    SplitBlockAndInsertIfThenElse(cond, access, &ThenTerm, &ElseTerm);
+    BasicBlock *tail = access->getParent();
+    access->moveBefore(ElseTerm);
+
+    IRBuilder<> B(ThenTerm);
+    B.SetCurrentDebugLocation(access->getDebugLoc());
+    auto VT = getVectorType(T);
+    unsigned AS = cast<PointerType>(ptr->getType())->getAddressSpace();
+    Value *base = B.CreatePointerCast(getNewOperand(0, ptr),
+                                      PointerType::get(VT, AS));
+    Align align = getAccessAlign(&orig);
+    if (isa<LoadInst>(orig)) {
+      Value *load;
+      if (mask)
+#if LLVM_VERSION_MAJOR >= 13
+        load = B.CreateMaskedLoad(VT, base, align, mask);
+#else
+        load = B.CreateMaskedLoad(base, align, mask);
+#endif
+      else
+        load = B.CreateAlignedLoad(VT, base, align);
+      PHINode *phi = PHINode::Create(VT, 2, "", &tail->front());
+      access->replaceAllUsesWith(phi);
+      phi->addIncoming(load, ThenTerm->getParent());
+      phi->addIncoming(access, ElseTerm->getParent());
+      phi->takeName(access);
+      if (packedValues[&orig] == access)
+        packedValues[&orig] = phi;
+    } else {
+      Value *vals = access->getArgOperand(0);
+      if (mask)
+        B.CreateMaskedStore(vals, base, align, mask);
+      else
+        B.CreateAlignedStore(vals, base, align);
+    }
+  }
+#endif
+
 public:
+  /// Completes code left by visiting all instructions in the batched function.
+  void finalize() {
+#if LLVM_VERSION_MAJOR >= 11
+    for (auto &pair : vectorPhis) {
+      const PHINode *phi = pair.first;
+      for (unsigned j = 0; j < phi->getNumIncomingValues(); ++j)
+        pair.second->addIncoming(
+            getPacked(phi->getIncomingValue(j)),
+            cast<BasicBlock>(originalToNewFn[phi->getIncomingBlock(j)]));
+    }
+    for (auto &access : gathers)
+      versionAccess(*std::get<0>(access), std::get<1>(access),
+                    std::get<2>(access));
+#endif
+  }
+
   void visitInstruction(llvm::Instruction &inst) {
+#if LLVM_VERSION_MAJOR >= 11
+    if (EnzymeBatchSIMD && visitSIMD(inst))
+      return;
+#endif
     auto found = vectorizedValues.find(&inst);
     assert(found != vectorizedValues.end());
     auto placeholders = found->second;
@@ -155,6 +484,31 @@ public:
   void visitPHINode(PHINode &phi) {
     PHINode *placeholder = cast<PHINode>(vectorizedValues[&phi][0]);
 
+#if LLVM_VERSION_MAJOR >= 11
+    if (EnzymeBatchSIMD && isSIMDType(phi.getType())) {
+      BasicBlock *BB = placeholder->getParent();
+      PHINode *vphi =
+          PHINode::Create(getVectorType(phi.getType()),
+                          phi.getNumIncomingValues(), "", &BB->front());
+      if (phi.hasName())
+        vphi->setName(phi.getName() + ".vec");
+      IRBuilder<> B(&*BB->getFirstInsertionPt());
+      B.SetCurrentDebugLocation(DebugLoc());
+      auto &lanes = vectorizedValues[&phi];
+      for (unsigned i = 0; i < width; ++i) {
+        Value *lane = B.CreateExtractElement(vphi, i);
+        lanes[i]->replaceAllUsesWith(lane);
+        cast<Instruction>(lanes[i])->eraseFromParent();
+        if (phi.hasName())
+          lane->setName(phi.getName() + Twine(i));
+        lanes[i] = lane;
+      }
+      packedValues[&phi] = vphi;
+      vectorPhis.emplace_back(&phi, vphi);
+      return;
+    }
+#endif
+
     for (unsigned i = 1; i < width; ++i) {
       ValueToValueMapTy vmap;
       Instruction *new_phi = placeholder->clone();
@@ -187,6 +541,18 @@ public:
   }
 
   void visitBranchInst(llvm::BranchInst &branch) {
+    if (anyBranches.count(&branch)) {
+      BranchInst *placeholder =
+          cast<BranchInst>(vectorizedValues[&branch].front());
+      IRBuilder<> Builder2(placeholder);
+      Builder2.SetCurrentDebugLocation(DebugLoc());
+      Value *any = getNewOperand(0, branch.getCondition());
+      for (unsigned i = 1; i < width; ++i)
+        any = Builder2.CreateOr(any, getNewOperand(i, branch.getCondition()));
+      placeholder->setCondition(any);
+      return;
+    }
+
     // TODO: runtime check
     hasError = true;
     EmitFailure("BranchConditionCannotBeVectorized", branch.getDebugLoc(),
@@ -218,6 +584,102 @@ public:
     }
   }
 
+  static unsigned numArgs(const CallInst *CI) {
+#if LLVM_VERSION_MAJOR >= 14
+    return CI->arg_size();
+#else
+    return CI->getNumArgOperands();
+#endif
+  }
+
+  /// Whether I only runs in some lanes, see LinearizeControlFlow.
+  bool isDivergent(const Instruction *I) {
+    auto found = masks.find(const_cast<Instruction *>(I));
+    return found != masks.end() && toVectorize.count(found->second) != 0;
+  }
+
+  /// Whether call allocates memory of the same size in all lanes, which can
+  /// then be allocated once for all of them: each lane's part is only
+  /// accessed through, or freed directly, in all lanes at once.
+  bool isBatchableAllocation(const Value *V) {
+    auto call = dyn_cast<CallInst>(V);
+    if (!call || numArgs(call) != 1 || isDivergent(call))
+      return false;
+    Function *F = getFunctionFromCall(const_cast<CallInst *>(call));
+    if (!F || !isAllocationFunction(F->getName(), TLI))
+      return false;
+    Value *size = call->getArgOperand(0);
+    if (!size->getType()->isIntegerTy() || toVectorize.count(size) != 0)
+      return false;
+
+    SmallVector<const Value *, 4> todo = {call};
+    SmallPtrSet<const Value *, 4> seen;
+    while (!todo.empty()) {
+      const Value *cur = todo.pop_back_val();
+      if (!seen.insert(cur).second)
+        continue;
+      for (const User *U : cur->users()) {
+        if (isa<BitCastInst>(U) || isa<GetElementPtrInst>(U)) {
+          if (U->getOperand(0) != cur)
+            return false;
+          todo.push_back(U);
+        } else if (auto SI = dyn_cast<StoreInst>(U)) {
+          if (SI->getValueOperand() == cur)
+            return false;
+        } else if (auto CI = dyn_cast<CallInst>(U)) {
+          Function *callee = getFunctionFromCall(const_cast<CallInst *>(CI));
+          if (isa<MemIntrinsic>(CI))
+            continue;
+          if (!callee || !isDeallocationFunction(callee->getName(), TLI) ||
+              numArgs(CI) != 1 ||
+              CI->getArgOperand(0)->stripPointerCasts() != call ||
+              isDivergent(CI))
+            return false;
+        } else if (!isa<LoadInst>(U) && !isa<ICmpInst>(U)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /// Allocates memory for all lanes of call at once, with the part of each
+  /// lane aligned as the allocation itself.
+  void visitAllocation(CallInst &call) {
+    auto &lanes = vectorizedValues[&call];
+    auto alloc = cast<CallInst>(lanes[0]);
+    IRBuilder<> Builder2(alloc);
+    Builder2.SetCurrentDebugLocation(DebugLoc());
+    Value *size = alloc->getArgOperand(0);
+    Value *stride = Builder2.CreateAnd(
+        Builder2.CreateAdd(size, ConstantInt::get(size->getType(), 15)),
+        ConstantInt::get(size->getType(), -16));
+    Value *total =
+        Builder2.CreateMul(stride, ConstantInt::get(size->getType(), width));
+    alloc->setArgOperand(0, total);
+    batchedCalls[&call] = alloc;
+
+    for (unsigned i = 1; i < width; ++i) {
+      auto placeholder = cast<Instruction>(lanes[i]);
+      Builder2.SetInsertPoint(placeholder);
+      Value *base = Builder2.CreatePointerCast(
+          alloc, Type::getInt8PtrTy(call.getContext(),
+                                    call.getType()->getPointerAddressSpace()));
+      Value *offset =
+          i == 1 ? stride
+                 : Builder2.CreateMul(stride,
+                                      ConstantInt::get(size->getType(), i));
+      Value *lane = Builder2.CreateInBoundsGEP(
+          Type::getInt8Ty(call.getContext()), base, offset);
+      lane = Builder2.CreatePointerCast(lane, call.getType());
+      placeholder->replaceAllUsesWith(lane);
+      placeholder->eraseFromParent();
+      if (call.hasName())
+        lane->setName(call.getName() + Twine(i));
+      lanes[i] = lane;
+    }
+  }
+
   void visitCallInst(llvm::CallInst &call) {
     auto found = vectorizedValues.find(&call);
     assert(found != vectorizedValues.end());
@@ -226,11 +688,25 @@ public:
     IRBuilder<> Builder2(placeholder);
     Builder2.SetCurrentDebugLocation(DebugLoc());
     Function *orig_func = getFunctionFromCall(&call);
+    if (!orig_func)
+      return visitInstruction(call);
+
+    if (orig_func->isDeclaration()) {
+      if (isBatchableAllocation(&call))
+        return visitAllocation(call);
 
-    bool isDefined = !orig_func->isDeclaration();
+      // The lanes of a batched allocation are freed with the first one.
+      if (numArgs(&call) == 1 &&
+          isBatchableAllocation(call.getArgOperand(0)->stripPointerCasts())) {
+        batchedCalls[&call] = cast<CallInst>(placeholder);
+        return;
+      }
 
-    if (!isDefined)
       return visitInstruction(call);
+    }
+
+    // Where only some lanes run the call, the batched function is told which.
+    bool divergent = isDivergent(&call);
 
     SmallVector<Value *, 4> args;
     SmallVector<BATCH_TYPE, 4> arg_types;
@@ -248,11 +724,11 @@ public:
           auto found = vectorizedValues.find(op);
           assert(found != vectorizedValues.end());
           Value *new_op = found->second[i];
-          Builder2.CreateInsertValue(agg, new_op, {i});
+          agg = Builder2.CreateInsertValue(agg, new_op, {i});
         }
         args.push_back(agg);
         arg_types.push_back(BATCH_TYPE::VECTOR);
-      } else if (isa<ConstantData>(op)) {
+      } else if (isa<Constant>(op)) {
         args.push_back(op);
         arg_types.push_back(BATCH_TYPE::SCALAR);
       } else {
@@ -264,16 +740,30 @@ public:
       }
     }
 
+    if (divergent) {
+      Value *mask = masks.find(&call)->second;
+      Value *agg = UndefValue::get(
+          ArrayType::get(Type::getInt1Ty(call.getContext()), width));
+      for (unsigned i = 0; i < width; i++)
+        agg = Builder2.CreateInsertValue(agg, getNewOperand(i, mask), {i});
+      args.push_back(agg);
+    }
+
     BATCH_TYPE ret_type = orig_func->getReturnType()->isVoidTy()
                               ? BATCH_TYPE::SCALAR
                               : BATCH_TYPE::VECTOR;
 
     Function *new_func =
-        Logic.CreateBatch(orig_func, width, arg_types, ret_type);
+        Logic.CreateBatch(orig_func, width, arg_types, ret_type, divergent);
+    if (!new_func) {
+      hasError = true;
+      return;
+    }
     CallInst *new_call = Builder2.CreateCall(new_func->getFunctionType(),
                                              new_func, args, call.getName());
 
     new_call->setDebugLoc(placeholder->getDebugLoc());
+    batchedCalls[&call] = new_call;
 
     if (!call.getType()->isVoidTy()) {
       for (unsigned i = 0; i < width; ++i) {
@@ -287,6 +777,7 @@ public:
     } else {
       placeholder->replaceAllUsesWith(new_call);
       placeholder->eraseFromParent();
+      vectorizedValues[&call][0] = new_call;
     }
   }
 };
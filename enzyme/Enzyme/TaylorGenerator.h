@@ -0,0 +1,729 @@
+//===- TaylorGenerator.h - Truncated Taylor series propagation -----------===//
+//
+//                             Enzyme Project
+//
+// Part of the Enzyme Project, under the Apache License v2.0 with LLVM
+// Exceptions. See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// If using this code in an academic setting, please cite the following:
+// @incollection{enzymeNeurips,
+// title = {Instead of Rewriting Foreign Code for Machine Learning,
+//          Automatically Synthesize Fast Gradients},
+// author = {Moses, William S. and Churavy, Valentin},
+// booktitle = {Advances in Neural Information Processing Systems 33},
+// year = {2020},
+// note = {To appear in},
+// }
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains an instruction visitor TaylorGenerator that propagates
+// the Taylor coefficients of order 1 to K of all active values of a function,
+// as used by Taylor mode differentiation. A coefficient of a floating point
+// value is a value of the same type, and a coefficient of an active pointer
+// is a pointer to shadow memory holding the corresponding coefficients of the
+// memory it points to. Coefficients known to be zero are held as null.
+//
+// Each rule uses the standard recurrences on truncated series, so that
+// propagating K coefficients through any operation takes O(K^2) work.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/InstVisitor.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include "llvm/Support/Casting.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Value.h"
+
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <cmath>
+
+#include "GradientUtils.h"
+
+using namespace llvm;
+
+class TaylorGenerator final : public llvm::InstVisitor<TaylorGenerator> {
+public:
+  bool hasError;
+  TaylorGenerator(Function *newFunc, unsigned order,
+                  ValueToValueMapTy &originalToNewFn,
+                  ValueMap<const Value *, std::vector<Value *>> &coefficients,
+                  const SmallPtrSetImpl<Value *> &active, EnzymeLogic &Logic)
+      : hasError(false), order(order), originalToNewFn(originalToNewFn),
+        coefficients(coefficients), active(active), Logic(Logic),
+        Builder(newFunc->getContext()) {}
+
+  /// Set the incoming coefficients of the phis, once all values have them.
+  void finalizePHIs() {
+    for (PHINode *phi : phis) {
+      auto &coeffs = coefficients[phi];
+      for (unsigned j = 0; j < phi->getNumIncomingValues(); ++j) {
+        Value *orig_val = phi->getIncomingValue(j);
+        BasicBlock *new_block =
+            cast<BasicBlock>(originalToNewFn[phi->getIncomingBlock(j)]);
+        if (phi->getType()->isPointerTy() && !active.count(orig_val)) {
+          fail(*phi, "phi of a pointer with and without shadow memory");
+          return;
+        }
+        for (unsigned k = 1; k <= order; ++k) {
+          Value *coeff = getCoefficient(orig_val, k);
+          if (!coeff)
+            coeff = Constant::getNullValue(phi->getType());
+          cast<PHINode>(coeffs[k - 1])->addIncoming(coeff, new_block);
+        }
+      }
+    }
+  }
+
+private:
+  using Series = SmallVector<Value *, 8>;
+
+  unsigned order;
+  ValueToValueMapTy &originalToNewFn;
+  ValueMap<const Value *, std::vector<Value *>> &coefficients;
+  const SmallPtrSetImpl<Value *> &active;
+  EnzymeLogic &Logic;
+  IRBuilder<> Builder;
+  SmallVector<PHINode *, 4> phis;
+
+  void fail(Instruction &inst, const Twine &why) {
+    hasError = true;
+    std::string reason = why.str();
+    EmitFailure("NoTaylor", inst.getDebugLoc(), &inst,
+                "cannot propagate Taylor coefficients through ", inst, ": ",
+                reason);
+  }
+
+  Value *getNewOperand(Value *op) {
+    if (isa<Constant>(op) || isa<MetadataAsValue>(op))
+      return op;
+    auto found = originalToNewFn.find(op);
+    assert(found != originalToNewFn.end());
+    return found->second;
+  }
+
+  /// The coefficient of order k of op, or null if it is zero.
+  Value *getCoefficient(Value *op, unsigned k) {
+    if (k == 0)
+      return getNewOperand(op);
+    if (!active.count(op))
+      return nullptr;
+    auto found = coefficients.find(op);
+    assert(found != coefficients.end());
+    return found->second[k - 1];
+  }
+
+  Series getSeries(Value *op) {
+    Series res;
+    for (unsigned k = 0; k <= order; ++k)
+      res.push_back(getCoefficient(op, k));
+    return res;
+  }
+
+  void setSeries(Instruction &inst, ArrayRef<Value *> series) {
+    coefficients[&inst] = std::vector<Value *>(series.begin() + 1,
+                                               series.end());
+  }
+
+  /// Position the builder just after the clone of inst.
+  void setInsertAfter(Instruction &inst) {
+    auto newInst = cast<Instruction>(getNewOperand(&inst));
+    Builder.SetInsertPoint(newInst->getNextNode());
+    Builder.SetCurrentDebugLocation(newInst->getDebugLoc());
+  }
+
+  Value *add(Value *a, Value *b) {
+    if (!a)
+      return b;
+    if (!b)
+      return a;
+    return Builder.CreateFAdd(a, b);
+  }
+
+  Value *sub(Value *a, Value *b) {
+    if (!b)
+      return a;
+    if (!a)
+      return Builder.CreateFNeg(b);
+    return Builder.CreateFSub(a, b);
+  }
+
+  Value *mul(Value *a, Value *b) {
+    if (!a || !b)
+      return nullptr;
+    return Builder.CreateFMul(a, b);
+  }
+
+  Value *div(Value *a, Value *b) {
+    if (!a)
+      return nullptr;
+    return Builder.CreateFDiv(a, b);
+  }
+
+  Value *scale(Value *a, double c) {
+    if (!a || c == 1.0)
+      return a;
+    return Builder.CreateFMul(a, ConstantFP::get(a->getType(), c));
+  }
+
+  /// c = a * b
+  Series mulSeries(ArrayRef<Value *> a, ArrayRef<Value *> b, Value *c0) {
+    Series c = {c0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = nullptr;
+      for (unsigned j = 0; j <= k; ++j)
+        sum = add(sum, mul(a[j], b[k - j]));
+      c.push_back(sum);
+    }
+    return c;
+  }
+
+  /// c = a / b, from b_0 c_k = a_k - sum_{j<k} c_j b_{k-j}
+  Series divSeries(ArrayRef<Value *> a, ArrayRef<Value *> b, Value *c0) {
+    Series c = {c0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = a[k];
+      for (unsigned j = 0; j < k; ++j)
+        sum = sub(sum, mul(c[j], b[k - j]));
+      c.push_back(div(sum, b[0]));
+    }
+    return c;
+  }
+
+  /// c = sqrt(a), from 2 c_0 c_k = a_k - sum_{0<j<k} c_j c_{k-j}
+  Series sqrtSeries(ArrayRef<Value *> a, Value *c0) {
+    Series c = {c0};
+    Value *twice = Builder.CreateFAdd(c0, c0);
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = a[k];
+      for (unsigned j = 1; j < k; ++j)
+        sum = sub(sum, mul(c[j], c[k - j]));
+      c.push_back(div(sum, twice));
+    }
+    return c;
+  }
+
+  /// c = exp(s a), from k c_k = s sum_{0<j<=k} j a_j c_{k-j}
+  Series expSeries(ArrayRef<Value *> a, Value *c0, double s = 1.0) {
+    Series c = {c0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = nullptr;
+      for (unsigned j = 1; j <= k; ++j)
+        sum = add(sum, scale(mul(a[j], c[k - j]), s * j / k));
+      c.push_back(sum);
+    }
+    return c;
+  }
+
+  /// c = log(a) / s, from a_0 c_k = a_k - sum_{0<j<k} j/k c_j a_{k-j} for
+  /// the natural logarithm
+  Series logSeries(ArrayRef<Value *> a, Value *c0, double s = 1.0) {
+    Series c = {c0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = a[k];
+      for (unsigned j = 1; j < k; ++j)
+        sum = sub(sum, scale(mul(c[j], a[k - j]), (double)j / k));
+      c.push_back(div(sum, a[0]));
+    }
+    for (unsigned k = 1; k <= order; ++k)
+      c[k] = scale(c[k], 1.0 / s);
+    return c;
+  }
+
+  /// s = sin(a) and c = cos(a), from k s_k = sum_{0<j<=k} j a_j c_{k-j} and
+  /// k c_k = -sum_{0<j<=k} j a_j s_{k-j}
+  std::pair<Series, Series> sinCosSeries(ArrayRef<Value *> a, Value *s0,
+                                         Value *c0) {
+    Series s = {s0}, c = {c0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *ssum = nullptr, *csum = nullptr;
+      for (unsigned j = 1; j <= k; ++j) {
+        ssum = add(ssum, scale(mul(a[j], c[k - j]), (double)j / k));
+        csum = add(csum, scale(mul(a[j], s[k - j]), -(double)j / k));
+      }
+      s.push_back(ssum);
+      c.push_back(csum);
+    }
+    return {s, c};
+  }
+
+  /// p = a^r for constant r, from
+  /// k a_0 p_k = sum_{j<k} (r (k-j) - j) a_{k-j} p_j
+  Series powSeries(ArrayRef<Value *> a, Value *r, Value *p0) {
+    Series p = {p0};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *sum = nullptr;
+      for (unsigned j = 0; j < k; ++j) {
+        Value *factor =
+            Builder.CreateFMul(r, ConstantFP::get(r->getType(), k - j));
+        if (j != 0)
+          factor =
+              Builder.CreateFSub(factor, ConstantFP::get(r->getType(), j));
+        sum = add(sum, mul(factor, mul(a[k - j], p[j])));
+      }
+      if (sum)
+        sum = Builder.CreateFDiv(
+            sum, Builder.CreateFMul(a[0], ConstantFP::get(a[0]->getType(), k)));
+      p.push_back(sum);
+    }
+    return p;
+  }
+
+  Value *callIntrinsic(Intrinsic::ID ID, Value *arg) {
+    Module *M = Builder.GetInsertBlock()->getModule();
+    return Builder.CreateCall(
+        Intrinsic::getDeclaration(M, ID, {arg->getType()}), {arg});
+  }
+
+  /// Store the coefficients of val, or zero, to the shadows of ptr.
+  void storeSeries(StoreInst &store, Value *val, Value *ptr) {
+    Type *T = val->getType();
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *coeff = getCoefficient(val, k);
+      if (!coeff)
+        coeff = Constant::getNullValue(T);
+      auto st = Builder.CreateStore(coeff, getCoefficient(ptr, k),
+                                    store.isVolatile());
+#if LLVM_VERSION_MAJOR >= 10
+      st->setAlignment(store.getAlign());
+#else
+      st->setAlignment(store.getAlignment());
+#endif
+    }
+  }
+
+public:
+  void visitInstruction(llvm::Instruction &inst) {
+    if (active.count(&inst) ||
+        llvm::any_of(inst.operands(),
+                     [&](Value *op) { return active.count(op) != 0; }))
+      fail(inst, "unsupported instruction");
+  }
+
+  void visitCmpInst(llvm::CmpInst &inst) {}
+  void visitBranchInst(llvm::BranchInst &inst) {}
+  void visitSwitchInst(llvm::SwitchInst &inst) {}
+  void visitUnreachableInst(llvm::UnreachableInst &inst) {}
+
+  void visitAllocaInst(llvm::AllocaInst &inst) {
+    if (!active.count(&inst))
+      return;
+    setInsertAfter(inst);
+    auto newInst = cast<AllocaInst>(getNewOperand(&inst));
+    Series shadow = {newInst};
+    for (unsigned k = 1; k <= order; ++k) {
+      auto alloc = cast<AllocaInst>(newInst->clone());
+      alloc->setName(inst.getName() + "'t" + Twine(k));
+      Builder.Insert(alloc);
+      shadow.push_back(alloc);
+    }
+    setSeries(inst, shadow);
+  }
+
+  void visitUnaryOperator(llvm::UnaryOperator &inst) {
+    if (!active.count(&inst))
+      return;
+    if (inst.getOpcode() != Instruction::FNeg)
+      return visitInstruction(inst);
+    setInsertAfter(inst);
+    Series a = getSeries(inst.getOperand(0));
+    for (unsigned k = 1; k <= order; ++k)
+      a[k] = sub(nullptr, a[k]);
+    setSeries(inst, a);
+  }
+
+  void visitBinaryOperator(llvm::BinaryOperator &inst) {
+    if (!active.count(&inst))
+      return;
+    setInsertAfter(inst);
+    Value *c0 = getNewOperand(&inst);
+    Series a = getSeries(inst.getOperand(0));
+    Series b = getSeries(inst.getOperand(1));
+    Series c = {c0};
+    switch (inst.getOpcode()) {
+    case Instruction::FAdd:
+      for (unsigned k = 1; k <= order; ++k)
+        c.push_back(add(a[k], b[k]));
+      break;
+    case Instruction::FSub:
+      for (unsigned k = 1; k <= order; ++k)
+        c.push_back(sub(a[k], b[k]));
+      break;
+    case Instruction::FMul:
+      c = mulSeries(a, b, c0);
+      break;
+    case Instruction::FDiv:
+      c = divSeries(a, b, c0);
+      break;
+    default:
+      return visitInstruction(inst);
+    }
+    setSeries(inst, c);
+  }
+
+  void visitCastInst(llvm::CastInst &inst) {
+    if (!active.count(&inst)) {
+      // Truncating an active value to an integer has no derivative.
+      if (inst.getOpcode() == Instruction::FPToSI ||
+          inst.getOpcode() == Instruction::FPToUI ||
+          inst.getOpcode() == Instruction::PtrToInt)
+        return;
+      return visitInstruction(inst);
+    }
+    switch (inst.getOpcode()) {
+    case Instruction::FPExt:
+    case Instruction::FPTrunc:
+    case Instruction::BitCast:
+    case Instruction::AddrSpaceCast:
+      break;
+    default:
+      return visitInstruction(inst);
+    }
+    if (inst.getOpcode() == Instruction::BitCast &&
+        !inst.getType()->isPointerTy())
+      return visitInstruction(inst);
+    setInsertAfter(inst);
+    Series c = getSeries(inst.getOperand(0));
+    for (unsigned k = 1; k <= order; ++k)
+      if (c[k])
+        c[k] = Builder.CreateCast(inst.getOpcode(), c[k], inst.getType());
+    setSeries(inst, c);
+  }
+
+  void visitGetElementPtrInst(llvm::GetElementPtrInst &inst) {
+    if (!active.count(&inst))
+      return;
+    setInsertAfter(inst);
+    auto newInst = cast<GetElementPtrInst>(getNewOperand(&inst));
+    Series c = {newInst};
+    for (unsigned k = 1; k <= order; ++k) {
+      auto gep = cast<GetElementPtrInst>(newInst->clone());
+      gep->setOperand(gep->getPointerOperandIndex(),
+                      getCoefficient(inst.getPointerOperand(), k));
+      gep->setName(inst.getName() + "'t" + Twine(k));
+      Builder.Insert(gep);
+      c.push_back(gep);
+    }
+    setSeries(inst, c);
+  }
+
+  void visitPHINode(llvm::PHINode &phi) {
+    if (!active.count(&phi))
+      return;
+    auto newPhi = cast<PHINode>(getNewOperand(&phi));
+    Series c = {newPhi};
+    IRBuilder<> PhiBuilder(newPhi->getNextNode());
+    for (unsigned k = 1; k <= order; ++k)
+      c.push_back(PhiBuilder.CreatePHI(phi.getType(),
+                                       phi.getNumIncomingValues(),
+                                       phi.getName() + "'t" + Twine(k)));
+    setSeries(phi, c);
+    phis.push_back(&phi);
+  }
+
+  void visitSelectInst(llvm::SelectInst &inst) {
+    if (!active.count(&inst))
+      return;
+    if (inst.getType()->isPointerTy() &&
+        (!active.count(inst.getTrueValue()) ||
+         !active.count(inst.getFalseValue())))
+      return fail(inst, "select of a pointer with and without shadow memory");
+    setInsertAfter(inst);
+    Value *cond = getNewOperand(inst.getCondition());
+    Series a = getSeries(inst.getTrueValue());
+    Series b = getSeries(inst.getFalseValue());
+    Series c = {getNewOperand(&inst)};
+    Constant *zero = Constant::getNullValue(inst.getType());
+    for (unsigned k = 1; k <= order; ++k)
+      c.push_back(a[k] || b[k] ? Builder.CreateSelect(cond, a[k] ? a[k] : zero,
+                                                      b[k] ? b[k] : zero)
+                               : nullptr);
+    setSeries(inst, c);
+  }
+
+  void visitLoadInst(llvm::LoadInst &inst) {
+    if (!active.count(&inst))
+      return;
+    setInsertAfter(inst);
+    Series c = {getNewOperand(&inst)};
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *ptr = getCoefficient(inst.getPointerOperand(), k);
+#if LLVM_VERSION_MAJOR > 7
+      auto load = Builder.CreateLoad(inst.getType(), ptr, inst.isVolatile(),
+                                     inst.getName() + "'t" + Twine(k));
+#else
+      auto load = Builder.CreateLoad(ptr, inst.isVolatile(),
+                                     inst.getName() + "'t" + Twine(k));
+#endif
+#if LLVM_VERSION_MAJOR >= 10
+      load->setAlignment(inst.getAlign());
+#else
+      load->setAlignment(inst.getAlignment());
+#endif
+      c.push_back(load);
+    }
+    setSeries(inst, c);
+  }
+
+  void visitStoreInst(llvm::StoreInst &inst) {
+    Value *val = inst.getValueOperand();
+    Value *ptr = inst.getPointerOperand();
+    if (!active.count(ptr)) {
+      if (active.count(val))
+        fail(inst, "store of an active value to memory without shadow");
+      return;
+    }
+    // Only floating point memory carries coefficients.
+    if (!val->getType()->isFPOrFPVectorTy())
+      return;
+    setInsertAfter(inst);
+    storeSeries(inst, val, ptr);
+  }
+
+  void visitMemSetInst(llvm::MemSetInst &inst) {
+    if (!active.count(inst.getDest()))
+      return;
+    setInsertAfter(inst);
+    auto newInst = cast<MemSetInst>(getNewOperand(&inst));
+    for (unsigned k = 1; k <= order; ++k) {
+      auto set = cast<MemSetInst>(newInst->clone());
+      set->setDest(getCoefficient(inst.getDest(), k));
+      set->setValue(Builder.getInt8(0));
+      Builder.Insert(set);
+    }
+  }
+
+  void visitMemTransferInst(llvm::MemTransferInst &inst) {
+    bool activeDest = active.count(inst.getDest());
+    bool activeSrc = active.count(inst.getSource());
+    if (!activeDest) {
+      if (activeSrc)
+        fail(inst, "copy of active memory to memory without shadow");
+      return;
+    }
+    setInsertAfter(inst);
+    auto newInst = cast<MemTransferInst>(getNewOperand(&inst));
+    for (unsigned k = 1; k <= order; ++k) {
+      Value *dest = getCoefficient(inst.getDest(), k);
+      if (activeSrc) {
+        auto copy = cast<MemTransferInst>(newInst->clone());
+        copy->setDest(dest);
+        copy->setSource(getCoefficient(inst.getSource(), k));
+        Builder.Insert(copy);
+      } else {
+#if LLVM_VERSION_MAJOR >= 10
+        Builder.CreateMemSet(dest, Builder.getInt8(0), newInst->getLength(),
+                             inst.getDestAlign(), inst.isVolatile());
+#else
+        Builder.CreateMemSet(dest, Builder.getInt8(0), newInst->getLength(),
+                             inst.getDestAlignment(), inst.isVolatile());
+#endif
+      }
+    }
+  }
+
+  void visitCallInst(llvm::CallInst &call) {
+    bool anyActive = false;
+#if LLVM_VERSION_MAJOR >= 14
+    for (auto &arg : call.args())
+#else
+    for (auto &arg : call.arg_operands())
+#endif
+      anyActive |= active.count(arg) != 0;
+    if (!anyActive || isa<DbgInfoIntrinsic>(call))
+      return;
+    if (auto II = dyn_cast<IntrinsicInst>(&call)) {
+      switch (II->getIntrinsicID()) {
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+        return;
+      case Intrinsic::memset:
+        return visitMemSetInst(cast<MemSetInst>(call));
+      case Intrinsic::memcpy:
+      case Intrinsic::memmove:
+        return visitMemTransferInst(cast<MemTransferInst>(call));
+      default:
+        break;
+      }
+    }
+
+    Function *called = getFunctionFromCall(&call);
+    if (!called)
+      return fail(call, "indirect call");
+    Intrinsic::ID ID = called->getIntrinsicID();
+    if (ID == Intrinsic::not_intrinsic)
+      isMemFreeLibMFunction(called->getName(), &ID);
+    if (ID == Intrinsic::not_intrinsic) {
+      if (called->empty())
+        return fail(call, "unknown function " + called->getName());
+      return visitDefinedCall(call, called);
+    }
+    if (!active.count(&call))
+      return fail(call, "active argument of a call without derivative");
+
+    setInsertAfter(call);
+    Value *c0 = getNewOperand(&call);
+    Series a = getSeries(call.getArgOperand(0));
+    Series c;
+    switch (ID) {
+    case Intrinsic::sqrt:
+      c = sqrtSeries(a, c0);
+      break;
+    case Intrinsic::exp:
+      c = expSeries(a, c0);
+      break;
+    case Intrinsic::exp2:
+      c = expSeries(a, c0, std::log(2.0));
+      break;
+    case Intrinsic::log:
+      c = logSeries(a, c0);
+      break;
+    case Intrinsic::log2:
+      c = logSeries(a, c0, std::log(2.0));
+      break;
+    case Intrinsic::log10:
+      c = logSeries(a, c0, std::log(10.0));
+      break;
+    case Intrinsic::sin:
+      c = sinCosSeries(a, c0, callIntrinsic(Intrinsic::cos, a[0])).first;
+      break;
+    case Intrinsic::cos:
+      c = sinCosSeries(a, callIntrinsic(Intrinsic::sin, a[0]), c0).second;
+      break;
+    case Intrinsic::fabs: {
+      Value *sign = Builder.CreateSelect(
+          Builder.CreateFCmpOLT(a[0], Constant::getNullValue(c0->getType())),
+          ConstantFP::get(c0->getType(), -1.0),
+          ConstantFP::get(c0->getType(), 1.0));
+      c = {c0};
+      for (unsigned k = 1; k <= order; ++k)
+        c.push_back(mul(sign, a[k]));
+      break;
+    }
+    case Intrinsic::powi: {
+      Value *r = Builder.CreateSIToFP(getNewOperand(call.getArgOperand(1)),
+                                      c0->getType());
+      c = powSeries(a, r, c0);
+      break;
+    }
+    case Intrinsic::pow: {
+      Series b = getSeries(call.getArgOperand(1));
+      if (!active.count(call.getArgOperand(1))) {
+        c = powSeries(a, b[0], c0);
+        break;
+      }
+      // a^b = exp(b log a)
+      Series l = logSeries(a, callIntrinsic(Intrinsic::log, a[0]));
+      c = expSeries(mulSeries(b, l, Builder.CreateFMul(b[0], l[0])), c0);
+      break;
+    }
+    case Intrinsic::fma:
+    case Intrinsic::fmuladd: {
+      Series b = getSeries(call.getArgOperand(1));
+      Series d = getSeries(call.getArgOperand(2));
+      c = mulSeries(a, b, c0);
+      for (unsigned k = 1; k <= order; ++k)
+        c[k] = add(c[k], d[k]);
+      break;
+    }
+    case Intrinsic::minnum:
+    case Intrinsic::maxnum: {
+      Series b = getSeries(call.getArgOperand(1));
+      Value *cond = ID == Intrinsic::minnum
+                        ? Builder.CreateFCmpOLT(a[0], b[0])
+                        : Builder.CreateFCmpOGT(a[0], b[0]);
+      Constant *zero = Constant::getNullValue(c0->getType());
+      c = {c0};
+      for (unsigned k = 1; k <= order; ++k)
+        c.push_back(a[k] || b[k]
+                        ? Builder.CreateSelect(cond, a[k] ? a[k] : zero,
+                                               b[k] ? b[k] : zero)
+                        : nullptr);
+      break;
+    }
+    default:
+      return fail(call, "no Taylor rule for " + called->getName());
+    }
+    setSeries(call, c);
+  }
+
+  /// Replace a call with active arguments to a defined function by a call to
+  /// its Taylor mode counterpart.
+  void visitDefinedCall(llvm::CallInst &call, Function *called) {
+    auto newCall = cast<CallInst>(getNewOperand(&call));
+    IRBuilder<> Builder2(newCall);
+    Builder2.SetCurrentDebugLocation(newCall->getDebugLoc());
+    SmallVector<Value *, 8> args;
+    std::vector<DIFFE_TYPE> constants;
+#if LLVM_VERSION_MAJOR >= 14
+    for (auto &arg : call.args()) {
+#else
+    for (auto &arg : call.arg_operands()) {
+#endif
+      args.push_back(getNewOperand(arg));
+      if (!active.count(arg)) {
+        constants.push_back(DIFFE_TYPE::CONSTANT);
+        continue;
+      }
+      constants.push_back(DIFFE_TYPE::DUP_ARG);
+      Type *T = arg->getType();
+      Value *coeffs = order == 1 ? nullptr
+                                 : UndefValue::get(ArrayType::get(T, order));
+      for (unsigned k = 1; k <= order; ++k) {
+        Value *coeff = getCoefficient(arg, k);
+        if (!coeff)
+          coeff = Constant::getNullValue(T);
+        coeffs = order == 1 ? coeff
+                            : Builder2.CreateInsertValue(coeffs, coeff, k - 1);
+      }
+      args.push_back(coeffs);
+    }
+    Function *newFunc = Logic.CreateTaylor(called, constants, order);
+    if (!newFunc) {
+      hasError = true;
+      return;
+    }
+    CallInst *taylor = Builder2.CreateCall(newFunc, args);
+    taylor->setCallingConv(newCall->getCallingConv());
+    if (!called->getReturnType()->isFPOrFPVectorTy()) {
+      taylor->takeName(newCall);
+      newCall->replaceAllUsesWith(taylor);
+      newCall->eraseFromParent();
+      originalToNewFn[&call] = taylor;
+      return;
+    }
+    Series c;
+    for (unsigned k = 0; k <= order; ++k)
+      c.push_back(Builder2.CreateExtractValue(taylor, k));
+    taylor->takeName(newCall);
+    newCall->replaceAllUsesWith(c[0]);
+    newCall->eraseFromParent();
+    originalToNewFn[&call] = c[0];
+    if (active.count(&call))
+      setSeries(call, c);
+  }
+
+  void visitReturnInst(llvm::ReturnInst &ret) {
+    auto newRet = cast<ReturnInst>(getNewOperand(&ret));
+    Value *val = ret.getReturnValue();
+    if (!val || !val->getType()->isFPOrFPVectorTy())
+      return visitInstruction(ret);
+    IRBuilder<> Builder2(newRet);
+    Builder2.SetCurrentDebugLocation(newRet->getDebugLoc());
+    SmallVector<Value *, 8> rets;
+    for (unsigned k = 0; k <= order; ++k) {
+      Value *coeff = getCoefficient(val, k);
+      rets.push_back(coeff ? coeff : Constant::getNullValue(val->getType()));
+    }
+    Builder2.CreateAggregateRet(rets.data(), rets.size());
+    newRet->eraseFromParent();
+  }
+};
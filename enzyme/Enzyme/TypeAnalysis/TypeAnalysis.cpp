@@ -3145,6 +3145,10 @@ void TypeAnalyzer::visitIntrinsicInst(llvm::IntrinsicInst &I) {
   case Intrinsic::nvvm_fabs_d:
   case Intrinsic::nvvm_fabs_ftz_f:
   case Intrinsic::fabs:
+#if LLVM_VERSION_MAJOR >= 12
+  case Intrinsic::vector_reduce_fmax:
+  case Intrinsic::vector_reduce_fmin:
+#endif
     // No direction check as always valid
     updateAnalysis(
         &I, TypeTree(ConcreteType(I.getType()->getScalarType())).Only(-1, &I),
@@ -3199,18 +3203,38 @@ void TypeAnalyzer::visitIntrinsicInst(llvm::IntrinsicInst &I) {
                    &I);
     return;
 
-#if LLVM_VERSION_MAJOR < 10
   case Intrinsic::x86_sse_max_ss:
   case Intrinsic::x86_sse_max_ps:
   case Intrinsic::x86_sse_min_ss:
   case Intrinsic::x86_sse_min_ps:
-#endif
+  case Intrinsic::x86_sse2_max_sd:
+  case Intrinsic::x86_sse2_max_pd:
+  case Intrinsic::x86_sse2_min_sd:
+  case Intrinsic::x86_sse2_min_pd:
+  case Intrinsic::x86_avx_max_ps_256:
+  case Intrinsic::x86_avx_max_pd_256:
+  case Intrinsic::x86_avx_min_ps_256:
+  case Intrinsic::x86_avx_min_pd_256:
+  // The blend mask only contributes its sign bits, leave its type unconstrained
+  case Intrinsic::x86_sse41_blendvps:
+  case Intrinsic::x86_sse41_blendvpd:
+  case Intrinsic::x86_avx_blendv_ps_256:
+  case Intrinsic::x86_avx_blendv_pd_256:
 #if LLVM_VERSION_MAJOR >= 12
   case Intrinsic::vector_reduce_fadd:
   case Intrinsic::vector_reduce_fmul:
 #elif LLVM_VERSION_MAJOR >= 9
   case Intrinsic::experimental_vector_reduce_v2_fadd:
   case Intrinsic::experimental_vector_reduce_v2_fmul:
+#endif
+#if LLVM_VERSION_MAJOR >= 14
+  case Intrinsic::vp_fadd:
+  case Intrinsic::vp_fsub:
+  case Intrinsic::vp_fmul:
+  case Intrinsic::vp_fdiv:
+  case Intrinsic::vp_reduce_fadd:
+  case Intrinsic::vp_reduce_fmax:
+  case Intrinsic::vp_reduce_fmin:
 #endif
   case Intrinsic::copysign:
   case Intrinsic::maxnum:
@@ -3963,8 +3987,6 @@ void TypeAnalyzer::visitCallInst(CallInst &call) {
                      TypeTree(BaseType::Pointer).Only(-1, &call), &call);
       updateAnalysis(call.getOperand(6),
                      TypeTree(BaseType::Integer).Only(-1, &call), &call);
-      updateAnalysis(call.getOperand(7),
-                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
       updateAnalysis(call.getOperand(8),
                      TypeTree(BaseType::Integer).Only(-1, &call), &call);
       updateAnalysis(call.getOperand(9),
@@ -4000,6 +4022,67 @@ void TypeAnalyzer::visitCallInst(CallInst &call) {
       updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
       return;
     }
+    if (funcName == "MPI_Alltoall") {
+      updateAnalysis(call.getOperand(0),
+                     TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(1),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(3),
+                     TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(4),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
+    if (funcName == "MPI_Alltoallv") {
+      for (int i : {0, 1, 2, 4, 5, 6})
+        updateAnalysis(call.getOperand(i),
+                       TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
+    if (funcName == "MPI_Reduce_scatter_block") {
+      updateAnalysis(call.getOperand(0),
+                     TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(1),
+                     TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(2),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
+    if (funcName == "MPI_Reduce_scatter") {
+      for (int i : {0, 1, 2})
+        updateAnalysis(call.getOperand(i),
+                       TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
+    if (funcName == "MPI_Allgatherv" || funcName == "MPI_Gatherv") {
+      updateAnalysis(call.getOperand(0),
+                     TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(1),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      for (int i : {3, 4, 5})
+        updateAnalysis(call.getOperand(i),
+                       TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      if (funcName == "MPI_Gatherv")
+        updateAnalysis(call.getOperand(7),
+                       TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
+    if (funcName == "MPI_Scatterv") {
+      for (int i : {0, 1, 2, 4})
+        updateAnalysis(call.getOperand(i),
+                       TypeTree(BaseType::Pointer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(5),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(call.getOperand(7),
+                     TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      updateAnalysis(&call, TypeTree(BaseType::Integer).Only(-1, &call), &call);
+      return;
+    }
     /// END MPI
     if (funcName == "memcpy" || funcName == "memmove") {
       // TODO have this call common mem transfer to copy data
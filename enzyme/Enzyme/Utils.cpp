@@ -741,6 +741,884 @@ Function *getOrInsertMemcpyStrided(Module &M, PointerType *T, Type *IT,
   return F;
 }
 
+Function *getOrInsertMemcpyMat(Module &M, PointerType *T, IntegerType *IT) {
+  Type *elementType = T->getPointerElementType();
+  assert(elementType->isFloatingPointTy());
+  std::string name = "__enzyme_memcpy_" + tofltstr(elementType) + "_mat_" +
+                     std::to_string(IT->getBitWidth());
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(M.getContext()),
+                                       {T, T, IT, IT, IT}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(0, Attribute::NoCapture);
+  F->addParamAttr(1, Attribute::NoCapture);
+  F->addParamAttr(0, Attribute::WriteOnly);
+  F->addParamAttr(1, Attribute::ReadOnly);
+
+  BasicBlock *entry = BasicBlock::Create(M.getContext(), "entry", F);
+  BasicBlock *body = BasicBlock::Create(M.getContext(), "for.body", F);
+  BasicBlock *end = BasicBlock::Create(M.getContext(), "for.end", F);
+
+  auto dst = F->arg_begin();
+  dst->setName("dst");
+  auto src = dst + 1;
+  src->setName("src");
+  auto rows = src + 1;
+  rows->setName("rows");
+  auto cols = rows + 1;
+  cols->setName("cols");
+  auto ld = cols + 1;
+  ld->setName("ld");
+
+  Type *i64 = Type::getInt64Ty(M.getContext());
+  Value *size;
+  {
+    IRBuilder<> B(entry);
+    size = B.CreateMul(
+        B.CreateSExt(rows, i64),
+        ConstantInt::get(i64,
+                         M.getDataLayout().getTypeSizeInBits(elementType) / 8),
+        "size", true, true);
+    B.CreateCondBr(B.CreateOr(B.CreateICmpSLE(rows, ConstantInt::get(IT, 0)),
+                              B.CreateICmpSLE(cols, ConstantInt::get(IT, 0))),
+                   end, body);
+  }
+
+  {
+    // Each of the cols contiguous runs of rows elements is copied whole.
+    IRBuilder<> B(body);
+    PHINode *idx = B.CreatePHI(i64, 2, "idx");
+    idx->addIncoming(ConstantInt::get(i64, 0), entry);
+
+#if LLVM_VERSION_MAJOR > 7
+    Value *dsti = B.CreateInBoundsGEP(
+        elementType, dst, B.CreateMul(idx, B.CreateSExt(rows, i64)), "dst.i");
+    Value *srci = B.CreateInBoundsGEP(
+        elementType, src, B.CreateMul(idx, B.CreateSExt(ld, i64)), "src.i");
+#else
+    Value *dsti =
+        B.CreateInBoundsGEP(dst, B.CreateMul(idx, B.CreateSExt(rows, i64)),
+                            "dst.i");
+    Value *srci =
+        B.CreateInBoundsGEP(src, B.CreateMul(idx, B.CreateSExt(ld, i64)),
+                            "src.i");
+#endif
+#if LLVM_VERSION_MAJOR >= 10
+    B.CreateMemCpy(dsti, MaybeAlign(1), srci, MaybeAlign(1), size);
+#else
+    B.CreateMemCpy(dsti, 1, srci, 1, size);
+#endif
+
+    Value *next = B.CreateNUWAdd(idx, ConstantInt::get(i64, 1), "idx.next");
+    idx->addIncoming(next, body);
+    B.CreateCondBr(B.CreateICmpEQ(B.CreateSExt(cols, i64), next), end, body);
+  }
+
+  {
+    IRBuilder<> B(end);
+    B.CreateRetVoid();
+  }
+
+  return F;
+}
+
+/// Fill F, whose leading arguments are (rows, cols), with a loop over the
+/// elements of a rows x cols matrix restricted to the part selected by the
+/// tri argument (see getOrInsertScaleMat). Element (i, j) is at i + j * ld.
+static void
+createMatLoop(Function *F, Value *tri,
+              function_ref<void(IRBuilder<> &, Value *, Value *)> body) {
+  auto &Ctx = F->getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  BasicBlock *entry = BasicBlock::Create(Ctx, "entry", F);
+  BasicBlock *outer = BasicBlock::Create(Ctx, "for.cols", F);
+  BasicBlock *inner = BasicBlock::Create(Ctx, "for.rows", F);
+  BasicBlock *latch = BasicBlock::Create(Ctx, "for.cols.latch", F);
+  BasicBlock *end = BasicBlock::Create(Ctx, "for.end", F);
+
+  Value *rows;
+  Value *cols;
+  {
+    IRBuilder<> B(entry);
+    rows = B.CreateSExt(F->arg_begin(), i64, "rows");
+    cols = B.CreateSExt(F->arg_begin() + 1, i64, "cols");
+    B.CreateCondBr(B.CreateOr(B.CreateICmpSLE(rows, ConstantInt::get(i64, 0)),
+                              B.CreateICmpSLE(cols, ConstantInt::get(i64, 0))),
+                   end, outer);
+  }
+
+  PHINode *j;
+  PHINode *i;
+  Value *hi;
+  {
+    IRBuilder<> B(outer);
+    j = B.CreatePHI(i64, 2, "j");
+    j->addIncoming(ConstantInt::get(i64, 0), entry);
+    auto triIs = [&](unsigned v) {
+      return B.CreateICmpEQ(tri, ConstantInt::get(tri->getType(), v));
+    };
+    Value *j1 = B.CreateNUWAdd(j, ConstantInt::get(i64, 1));
+    Value *lo = B.CreateSelect(
+        triIs(2), j, B.CreateSelect(triIs(4), j1, ConstantInt::get(i64, 0)));
+    hi = B.CreateSelect(triIs(1), j1, B.CreateSelect(triIs(3), j, rows));
+    lo = B.CreateSelect(B.CreateICmpSLT(lo, rows), lo, rows, "lo");
+    hi = B.CreateSelect(B.CreateICmpSLT(hi, rows), hi, rows, "hi");
+    B.CreateCondBr(B.CreateICmpSLT(lo, hi), inner, latch);
+
+    IRBuilder<> BI(inner);
+    i = BI.CreatePHI(i64, 2, "i");
+    i->addIncoming(lo, outer);
+  }
+
+  {
+    IRBuilder<> B(inner);
+    B.setFastMathFlags(getFast());
+    body(B, i, j);
+    Value *next = B.CreateNUWAdd(i, ConstantInt::get(i64, 1), "i.next");
+    i->addIncoming(next, B.GetInsertBlock());
+    B.CreateCondBr(B.CreateICmpEQ(next, hi), latch, inner);
+  }
+
+  {
+    IRBuilder<> B(latch);
+    Value *next = B.CreateNUWAdd(j, ConstantInt::get(i64, 1), "j.next");
+    j->addIncoming(next, latch);
+    B.CreateCondBr(B.CreateICmpEQ(next, cols), end, outer);
+  }
+
+  {
+    IRBuilder<> B(end);
+    B.CreateRetVoid();
+  }
+}
+
+Function *getOrInsertScaleMat(Module &M, Type *T, IntegerType *IT) {
+  assert(T->isFloatingPointTy());
+  std::string name = "__enzyme_scal_" + tofltstr(T) + "_mat_" +
+                     std::to_string(IT->getBitWidth());
+  Type *PT = PointerType::getUnqual(T);
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(M.getContext()),
+                                       {IT, IT, T, PT, IT, IT}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(3, Attribute::NoCapture);
+
+  auto alpha = F->arg_begin() + 2;
+  alpha->setName("alpha");
+  auto A = F->arg_begin() + 3;
+  A->setName("A");
+  auto ld = F->arg_begin() + 4;
+  ld->setName("ld");
+  auto tri = F->arg_begin() + 5;
+  tri->setName("tri");
+
+  createMatLoop(F, tri, [&](IRBuilder<> &B, Value *i, Value *j) {
+    Value *idx =
+        B.CreateAdd(i, B.CreateMul(j, B.CreateSExt(ld, i->getType())));
+#if LLVM_VERSION_MAJOR > 7
+    Value *Ai = B.CreateInBoundsGEP(T, A, idx, "A.i");
+    Value *val = B.CreateLoad(T, Ai);
+#else
+    Value *Ai = B.CreateInBoundsGEP(A, idx, "A.i");
+    Value *val = B.CreateLoad(Ai);
+#endif
+    // As in BLAS, a zero factor clears rather than scales.
+    val = B.CreateSelect(B.CreateFCmpOEQ(alpha, ConstantFP::get(T, 0.0)),
+                         ConstantFP::get(T, 0.0), B.CreateFMul(alpha, val));
+    B.CreateStore(val, Ai);
+  });
+  return F;
+}
+
+Function *getOrInsertAxpyMat(Module &M, Type *T, IntegerType *IT) {
+  assert(T->isFloatingPointTy());
+  std::string name = "__enzyme_axpy_" + tofltstr(T) + "_mat_" +
+                     std::to_string(IT->getBitWidth());
+  Type *PT = PointerType::getUnqual(T);
+  FunctionType *FT = FunctionType::get(
+      Type::getVoidTy(M.getContext()), {IT, IT, T, PT, IT, PT, IT, IT, IT},
+      false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(3, Attribute::NoCapture);
+  F->addParamAttr(3, Attribute::ReadOnly);
+  F->addParamAttr(5, Attribute::NoCapture);
+
+  auto alpha = F->arg_begin() + 2;
+  alpha->setName("alpha");
+  auto X = F->arg_begin() + 3;
+  X->setName("X");
+  auto ldx = F->arg_begin() + 4;
+  ldx->setName("ldx");
+  auto Y = F->arg_begin() + 5;
+  Y->setName("Y");
+  auto ldy = F->arg_begin() + 6;
+  ldy->setName("ldy");
+  auto tri = F->arg_begin() + 7;
+  tri->setName("tri");
+  auto trans = F->arg_begin() + 8;
+  trans->setName("trans");
+
+  createMatLoop(F, tri, [&](IRBuilder<> &B, Value *i, Value *j) {
+    Type *i64 = i->getType();
+    Value *isTrans =
+        B.CreateICmpNE(trans, ConstantInt::get(trans->getType(), 0));
+    Value *xi = B.CreateSelect(isTrans, j, i);
+    Value *xj = B.CreateSelect(isTrans, i, j);
+    Value *xidx = B.CreateAdd(xi, B.CreateMul(xj, B.CreateSExt(ldx, i64)));
+    Value *yidx = B.CreateAdd(i, B.CreateMul(j, B.CreateSExt(ldy, i64)));
+#if LLVM_VERSION_MAJOR > 7
+    Value *Xi = B.CreateInBoundsGEP(T, X, xidx, "X.i");
+    Value *Yi = B.CreateInBoundsGEP(T, Y, yidx, "Y.i");
+    Value *xval = B.CreateLoad(T, Xi);
+    Value *yval = B.CreateLoad(T, Yi);
+#else
+    Value *Xi = B.CreateInBoundsGEP(X, xidx, "X.i");
+    Value *Yi = B.CreateInBoundsGEP(Y, yidx, "Y.i");
+    Value *xval = B.CreateLoad(Xi);
+    Value *yval = B.CreateLoad(Yi);
+#endif
+    B.CreateStore(B.CreateFAdd(yval, B.CreateFMul(alpha, xval)), Yi);
+  });
+  return F;
+}
+
+Function *getOrInsertEigenvectorAdjointMat(Module &M, Type *T,
+                                           IntegerType *IT) {
+  assert(T->isFloatingPointTy());
+  std::string name = "__enzyme_eigvec_adjoint_" + tofltstr(T) + "_mat_" +
+                     std::to_string(IT->getBitWidth());
+  Type *PT = PointerType::getUnqual(T);
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(M.getContext()),
+                                       {IT, IT, PT, PT, IT}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(2, Attribute::NoCapture);
+  F->addParamAttr(2, Attribute::ReadOnly);
+  F->addParamAttr(3, Attribute::NoCapture);
+
+  auto w = F->arg_begin() + 2;
+  w->setName("w");
+  auto K = F->arg_begin() + 3;
+  K->setName("K");
+  auto ld = F->arg_begin() + 4;
+  ld->setName("ld");
+
+  createMatLoop(F, ConstantInt::get(IT, 0),
+                [&](IRBuilder<> &B, Value *i, Value *j) {
+                  Value *idx = B.CreateAdd(
+                      i, B.CreateMul(j, B.CreateSExt(ld, i->getType())));
+#if LLVM_VERSION_MAJOR > 7
+                  Value *Ki = B.CreateInBoundsGEP(T, K, idx, "K.i");
+                  Value *val = B.CreateLoad(T, Ki);
+                  Value *wi = B.CreateLoad(T, B.CreateInBoundsGEP(T, w, i));
+                  Value *wj = B.CreateLoad(T, B.CreateInBoundsGEP(T, w, j));
+#else
+                  Value *Ki = B.CreateInBoundsGEP(K, idx, "K.i");
+                  Value *val = B.CreateLoad(Ki);
+                  Value *wi = B.CreateLoad(B.CreateInBoundsGEP(w, i));
+                  Value *wj = B.CreateLoad(B.CreateInBoundsGEP(w, j));
+#endif
+                  // Pairs of equal eigenvalues, including each with itself,
+                  // do not contribute.
+                  Value *diff = B.CreateFSub(wj, wi);
+                  val = B.CreateSelect(
+                      B.CreateFCmpOEQ(diff, ConstantFP::get(T, 0.0)),
+                      ConstantFP::get(T, 0.0), B.CreateFDiv(val, diff));
+                  B.CreateStore(val, Ki);
+                });
+  return F;
+}
+
+/// Emit at B a loop running body(B, idx) for idx in [lo, hi) by step, leaving
+/// B at its exit.
+void createCountedLoop(IRBuilder<> &B, Value *lo, Value *hi, uint64_t step,
+                       const Twine &name,
+                       function_ref<void(IRBuilder<> &, Value *)> body) {
+  Function *F = B.GetInsertBlock()->getParent();
+  auto &Ctx = F->getContext();
+  BasicBlock *preheader = B.GetInsertBlock();
+  BasicBlock *loop = BasicBlock::Create(Ctx, name, F);
+  BasicBlock *end = BasicBlock::Create(Ctx, name + ".end", F);
+  B.CreateCondBr(B.CreateICmpSLT(lo, hi), loop, end);
+
+  B.SetInsertPoint(loop);
+  PHINode *idx = B.CreatePHI(lo->getType(), 2, name);
+  idx->addIncoming(lo, preheader);
+  body(B, idx);
+  Value *next =
+      B.CreateNSWAdd(idx, ConstantInt::get(lo->getType(), step),
+                     name + ".next");
+  idx->addIncoming(next, B.GetInsertBlock());
+  B.CreateCondBr(B.CreateICmpSLT(next, hi), loop, end);
+  B.SetInsertPoint(end);
+}
+
+/// The address of element (i, j) of the strided matrix at base.
+static Value *stridedElement(IRBuilder<> &B, Type *T, Value *base, Value *i,
+                             Value *si, Value *j, Value *sj) {
+  Type *i8 = Type::getInt8Ty(B.getContext());
+  Value *off = B.CreateAdd(B.CreateMul(i, si), B.CreateMul(j, sj));
+  base = B.CreatePointerCast(base, PointerType::getUnqual(i8));
+#if LLVM_VERSION_MAJOR > 7
+  Value *ptr = B.CreateGEP(i8, base, off);
+#else
+  Value *ptr = B.CreateGEP(base, off);
+#endif
+  return B.CreatePointerCast(ptr, PointerType::getUnqual(T));
+}
+
+Function *getOrInsertMatmul(Module &M, Type *T, bool Fused) {
+  assert(T->isFloatingPointTy());
+  std::string name =
+      (Fused ? "__enzyme_matmul_fmuladd_" : "__enzyme_matmul_") + tofltstr(T);
+  auto &Ctx = M.getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PT = PointerType::getUnqual(T);
+  FunctionType *FT = FunctionType::get(
+      Type::getVoidTy(Ctx),
+      {i64, i64, i64, PT, i64, i64, PT, i64, i64, PT, i64, i64, i64}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::NoRecurse);
+  F->addParamAttr(3, Attribute::NoCapture);
+  F->addParamAttr(3, Attribute::ReadOnly);
+  F->addParamAttr(6, Attribute::NoCapture);
+  F->addParamAttr(6, Attribute::ReadOnly);
+  F->addParamAttr(9, Attribute::NoCapture);
+  F->setMetadata("enzyme_matmul", MDTuple::get(Ctx, {}));
+
+  const char *names[] = {"M",   "N",   "K", "A",   "sam", "sak",  "B",
+                         "sbk", "sbn", "C", "scm", "scn", "beta"};
+  SmallVector<Value *, 13> args;
+  for (auto &arg : F->args()) {
+    arg.setName(names[args.size()]);
+    args.push_back(&arg);
+  }
+  Value *Mv = args[0], *Nv = args[1], *Kv = args[2], *A = args[3],
+        *sam = args[4], *sak = args[5], *Bv = args[6], *sbk = args[7],
+        *sbn = args[8], *C = args[9], *scm = args[10], *scn = args[11],
+        *beta = args[12];
+
+  BasicBlock *entry = BasicBlock::Create(Ctx, "entry", F);
+  BasicBlock *clear = BasicBlock::Create(Ctx, "clear", F);
+  BasicBlock *tiles = BasicBlock::Create(Ctx, "tiles", F);
+  IRBuilder<> B(entry);
+  Value *zero = ConstantInt::get(i64, 0);
+  B.CreateCondBr(B.CreateICmpEQ(beta, zero), clear, tiles);
+
+  B.SetInsertPoint(clear);
+  createCountedLoop(B, zero, Mv, 1, "clear.i", [&](IRBuilder<> &B, Value *i) {
+    createCountedLoop(B, zero, Nv, 1, "clear.j",
+                      [&](IRBuilder<> &B, Value *j) {
+                        B.CreateStore(ConstantFP::get(T, 0.0),
+                                      stridedElement(B, T, C, i, scm, j, scn));
+                      });
+  });
+  B.CreateBr(tiles);
+
+  // C += A B over tiles of block x block x block elements. Every element of
+  // C accumulates its products in order of k, and fused if requested, as the
+  // loop nest it replaces did.
+  const uint64_t block = 64;
+  B.SetInsertPoint(tiles);
+  auto tileEnd = [&](IRBuilder<> &B, Value *start, Value *bound) {
+    Value *end = B.CreateAdd(start, ConstantInt::get(i64, block));
+    return B.CreateSelect(B.CreateICmpSLT(end, bound), end, bound);
+  };
+  createCountedLoop(B, zero, Mv, block, "i0", [&](IRBuilder<> &B, Value *i0) {
+    Value *i1 = tileEnd(B, i0, Mv);
+    createCountedLoop(B, zero, Kv, block, "k0", [&](IRBuilder<> &B,
+                                                    Value *k0) {
+      Value *k1 = tileEnd(B, k0, Kv);
+      createCountedLoop(B, zero, Nv, block, "j0", [&](IRBuilder<> &B,
+                                                      Value *j0) {
+        Value *j1 = tileEnd(B, j0, Nv);
+        createCountedLoop(B, i0, i1, 1, "i", [&](IRBuilder<> &B, Value *i) {
+          createCountedLoop(B, k0, k1, 1, "k", [&](IRBuilder<> &B, Value *k) {
+#if LLVM_VERSION_MAJOR > 7
+            Value *a = B.CreateLoad(T, stridedElement(B, T, A, i, sam, k, sak));
+#else
+            Value *a = B.CreateLoad(stridedElement(B, T, A, i, sam, k, sak));
+#endif
+            createCountedLoop(B, j0, j1, 1, "j", [&](IRBuilder<> &B, Value *j) {
+              Value *Bkj = stridedElement(B, T, Bv, k, sbk, j, sbn);
+              Value *Cij = stridedElement(B, T, C, i, scm, j, scn);
+#if LLVM_VERSION_MAJOR > 7
+              Value *b = B.CreateLoad(T, Bkj);
+              Value *c = B.CreateLoad(T, Cij);
+#else
+              Value *b = B.CreateLoad(Bkj);
+              Value *c = B.CreateLoad(Cij);
+#endif
+              Value *sum;
+              if (Fused)
+                sum = B.CreateCall(
+                    Intrinsic::getDeclaration(&M, Intrinsic::fmuladd, {T}),
+                    {a, b, c});
+              else
+                sum = B.CreateFAdd(c, B.CreateFMul(a, b));
+              B.CreateStore(sum, Cij);
+            });
+          });
+        });
+      });
+    });
+  });
+  B.CreateRetVoid();
+  return F;
+}
+
+Function *getOrInsertMatmulPack(Module &M, Type *T) {
+  assert(T->isFloatingPointTy());
+  std::string name = "__enzyme_matmul_pack_" + tofltstr(T);
+  auto &Ctx = M.getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PT = PointerType::getUnqual(T);
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(Ctx),
+                                       {i64, i64, PT, i64, i64, PT}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(2, Attribute::NoCapture);
+  F->addParamAttr(2, Attribute::ReadOnly);
+  F->addParamAttr(5, Attribute::NoCapture);
+  F->addParamAttr(5, Attribute::WriteOnly);
+
+  auto rows = F->arg_begin();
+  rows->setName("rows");
+  auto cols = rows + 1;
+  cols->setName("cols");
+  auto src = cols + 1;
+  src->setName("src");
+  auto sr = src + 1;
+  sr->setName("sr");
+  auto sc = sr + 1;
+  sc->setName("sc");
+  auto dst = sc + 1;
+  dst->setName("dst");
+
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  Value *zero = ConstantInt::get(i64, 0);
+  Value *size =
+      ConstantInt::get(i64, M.getDataLayout().getTypeSizeInBits(T) / 8);
+  createCountedLoop(B, zero, cols, 1, "j", [&](IRBuilder<> &B, Value *j) {
+    createCountedLoop(B, zero, rows, 1, "i", [&](IRBuilder<> &B, Value *i) {
+#if LLVM_VERSION_MAJOR > 7
+      Value *val = B.CreateLoad(T, stridedElement(B, T, src, i, sr, j, sc));
+#else
+      Value *val = B.CreateLoad(stridedElement(B, T, src, i, sr, j, sc));
+#endif
+      B.CreateStore(val,
+                    stridedElement(B, T, dst, i, size, j,
+                                   B.CreateMul(rows, size)));
+    });
+  });
+  B.CreateRetVoid();
+  return F;
+}
+
+static cl::opt<double> EnzymeFixedPointTol(
+    "enzyme-fixed-point-tol", cl::init(1e-12), cl::Hidden,
+    cl::desc("Relative tolerance to which __enzyme_fixed_point and its "
+             "derivatives are iterated"));
+
+static cl::opt<unsigned> EnzymeFixedPointMaxIter(
+    "enzyme-fixed-point-max-iter", cl::init(1000), cl::Hidden,
+    cl::desc("Maximal number of iterations of __enzyme_fixed_point and of "
+             "its derivatives"));
+
+void createFixedPointLoop(IRBuilder<> &B, Type *T, Value *y, Value *b,
+                          Value *n,
+                          function_ref<void(IRBuilder<> &, Value *)> apply) {
+  Function *F = B.GetInsertBlock()->getParent();
+  auto &Ctx = F->getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PT = PointerType::getUnqual(T);
+  Value *zero = ConstantInt::get(i64, 0);
+  Function *fabsF =
+      Intrinsic::getDeclaration(F->getParent(), Intrinsic::fabs, {T});
+  auto load = [&](IRBuilder<> &B, Value *base, Value *i) {
+#if LLVM_VERSION_MAJOR > 7
+    return B.CreateLoad(T, B.CreateGEP(T, base, i));
+#else
+    return B.CreateLoad(B.CreateGEP(base, i));
+#endif
+  };
+
+  // The largest update and element of the current iteration.
+  IRBuilder<> EB(&F->getEntryBlock(), F->getEntryBlock().begin());
+  Value *err = EB.CreateAlloca(T, nullptr, "fp.err");
+  Value *scale = EB.CreateAlloca(T, nullptr, "fp.scale");
+  Value *out = B.CreatePointerCast(CreateAllocation(B, T, n, "fp.out"), PT);
+
+  BasicBlock *preheader = B.GetInsertBlock();
+  BasicBlock *iter = BasicBlock::Create(Ctx, "fp.iter", F);
+  BasicBlock *end = BasicBlock::Create(Ctx, "fp.end", F);
+  B.CreateBr(iter);
+  B.SetInsertPoint(iter);
+  PHINode *it = B.CreatePHI(i64, 2, "fp.it");
+  it->addIncoming(zero, preheader);
+  B.CreateStore(ConstantFP::get(T, 0.0), err);
+  B.CreateStore(ConstantFP::get(T, 0.0), scale);
+  apply(B, out);
+  createCountedLoop(B, zero, n, 1, "fp.i", [&](IRBuilder<> &B, Value *i) {
+    Value *next = load(B, out, i);
+    if (b)
+      next = B.CreateFAdd(load(B, b, i), next);
+    // Unordered comparisons keep a NaN, which is then never converged.
+    auto max = [&](Value *acc, Value *val) {
+#if LLVM_VERSION_MAJOR > 7
+      Value *prev = B.CreateLoad(T, acc);
+#else
+      Value *prev = B.CreateLoad(acc);
+#endif
+      val = B.CreateCall(fabsF, {val});
+      B.CreateStore(B.CreateSelect(B.CreateFCmpUGT(val, prev), val, prev),
+                    acc);
+    };
+    max(err, B.CreateFSub(next, load(B, y, i)));
+    max(scale, next);
+#if LLVM_VERSION_MAJOR > 7
+    B.CreateStore(next, B.CreateGEP(T, y, i));
+#else
+    B.CreateStore(next, B.CreateGEP(y, i));
+#endif
+  });
+#if LLVM_VERSION_MAJOR > 7
+  Value *errv = B.CreateLoad(T, err);
+  Value *scalev = B.CreateLoad(T, scale);
+#else
+  Value *errv = B.CreateLoad(err);
+  Value *scalev = B.CreateLoad(scale);
+#endif
+  Value *converged = B.CreateFCmpOLE(
+      errv,
+      B.CreateFMul(scalev, ConstantFP::get(T, (double)EnzymeFixedPointTol)));
+  Value *next = B.CreateNUWAdd(it, ConstantInt::get(i64, 1), "fp.it.next");
+  it->addIncoming(next, B.GetInsertBlock());
+  Value *more = B.CreateICmpULT(
+      next, ConstantInt::get(i64, (unsigned)EnzymeFixedPointMaxIter));
+  B.CreateCondBr(B.CreateAnd(B.CreateNot(converged), more), iter, end);
+  B.SetInsertPoint(end);
+  CreateDealloc(B, out);
+}
+
+Function *getOrInsertFixedPoint(Module &M, Function *step) {
+  auto &Ctx = M.getContext();
+  FunctionType *stepTy = step->getFunctionType();
+  assert(stepTy->getNumParams() >= 2);
+  Type *PT = stepTy->getParamType(0);
+  Type *T = PT->getPointerElementType();
+  assert(T->isFloatingPointTy());
+  Type *i64 = Type::getInt64Ty(Ctx);
+  SmallVector<Type *, 4> types = {PT, i64};
+  types.append(stepTy->param_begin() + 2, stepTy->param_end());
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(Ctx), types, false);
+  std::string name = ("__enzyme_fixed_point_" + step->getName()).str();
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->setMetadata("enzyme_fixed_point",
+                 MDTuple::get(Ctx, {ValueAsMetadata::get(step)}));
+
+  auto x = F->arg_begin();
+  x->setName("x");
+  auto n = x + 1;
+  n->setName("n");
+
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  createFixedPointLoop(B, T, x, nullptr, n, [&](IRBuilder<> &B, Value *out) {
+    SmallVector<Value *, 4> args = {out, x};
+    for (auto &arg : llvm::drop_begin(F->args(), 2))
+      args.push_back(&arg);
+    auto CI = B.CreateCall(step, args);
+    CI->setCallingConv(step->getCallingConv());
+  });
+  B.CreateRetVoid();
+  return F;
+}
+
+/// Load and store element i of the i64 array at base.
+static Value *loadIndex(IRBuilder<> &B, Value *base, Value *i) {
+  Type *i64 = Type::getInt64Ty(B.getContext());
+#if LLVM_VERSION_MAJOR > 7
+  return B.CreateLoad(i64, B.CreateGEP(i64, base, i));
+#else
+  return B.CreateLoad(B.CreateGEP(base, i));
+#endif
+}
+
+static void storeIndex(IRBuilder<> &B, Value *val, Value *base, Value *i) {
+#if LLVM_VERSION_MAJOR > 7
+  B.CreateStore(val, B.CreateGEP(val->getType(), base, i));
+#else
+  B.CreateStore(val, B.CreateGEP(base, i));
+#endif
+}
+
+/// Emit at B a loop over the indices [ptr[i], ptr[i + 1]) of the compressed
+/// pattern ptr, idx, running body(B, idx[p]) for each, leaving B at its
+/// exit.
+static void
+createPatternLoop(IRBuilder<> &B, Value *ptr, Value *idx, Value *i,
+                  const Twine &name,
+                  function_ref<void(IRBuilder<> &, Value *)> body) {
+  Value *next = B.CreateNSWAdd(i, ConstantInt::get(i->getType(), 1));
+  createCountedLoop(B, loadIndex(B, ptr, i), loadIndex(B, ptr, next), 1, name,
+                    [&](IRBuilder<> &B, Value *p) {
+                      body(B, loadIndex(B, idx, p));
+                    });
+}
+
+Function *getOrInsertSparsityTranspose(Module &M) {
+  auto &Ctx = M.getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PT = PointerType::getUnqual(i64);
+  FunctionType *FT = FunctionType::get(Type::getVoidTy(Ctx),
+                                       {i64, i64, PT, PT, PT, PT}, false);
+  std::string name = "__enzyme_sparsity_transpose";
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::NoUnwind);
+
+  auto m = F->arg_begin();
+  m->setName("m");
+  auto n = m + 1;
+  n->setName("n");
+  auto rowptr = n + 1;
+  rowptr->setName("rowptr");
+  auto colidx = rowptr + 1;
+  colidx->setName("colidx");
+  auto colptr = colidx + 1;
+  colptr->setName("colptr");
+  auto rowidx = colptr + 1;
+  rowidx->setName("rowidx");
+
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  Value *zero = ConstantInt::get(i64, 0);
+  Value *one = ConstantInt::get(i64, 1);
+  Value *eight = ConstantInt::get(i64, 8);
+  Value *np1 = B.CreateNSWAdd(n, one);
+#if LLVM_VERSION_MAJOR >= 10
+  B.CreateMemSet(colptr, B.getInt8(0), B.CreateMul(np1, eight), MaybeAlign(8));
+#else
+  B.CreateMemSet(colptr, B.getInt8(0), B.CreateMul(np1, eight), 8);
+#endif
+
+  // Count the entries of each column, then turn the counts into offsets.
+  createCountedLoop(B, zero, m, 1, "count", [&](IRBuilder<> &B, Value *i) {
+    createPatternLoop(B, rowptr, colidx, i, "count.p",
+                      [&](IRBuilder<> &B, Value *j) {
+                        Value *j1 = B.CreateNSWAdd(j, one);
+                        Value *count = loadIndex(B, colptr, j1);
+                        storeIndex(B, B.CreateNSWAdd(count, one), colptr, j1);
+                      });
+  });
+  createCountedLoop(B, zero, n, 1, "sum", [&](IRBuilder<> &B, Value *j) {
+    Value *j1 = B.CreateNSWAdd(j, one);
+    storeIndex(B,
+               B.CreateNSWAdd(loadIndex(B, colptr, j1),
+                              loadIndex(B, colptr, j)),
+               colptr, j1);
+  });
+
+  // Fill the rows of each column in order, fill[j] being the next free slot.
+  Value *fill = B.CreatePointerCast(CreateAllocation(B, i64, n, "fill"), PT);
+#if LLVM_VERSION_MAJOR >= 10
+  B.CreateMemCpy(fill, MaybeAlign(8), colptr, MaybeAlign(8),
+                 B.CreateMul(n, eight));
+#else
+  B.CreateMemCpy(fill, 8, colptr, 8, B.CreateMul(n, eight));
+#endif
+  createCountedLoop(B, zero, m, 1, "fill", [&](IRBuilder<> &B, Value *i) {
+    createPatternLoop(B, rowptr, colidx, i, "fill.p",
+                      [&](IRBuilder<> &B, Value *j) {
+                        Value *q = loadIndex(B, fill, j);
+                        storeIndex(B, i, rowidx, q);
+                        storeIndex(B, B.CreateNSWAdd(q, one), fill, j);
+                      });
+  });
+  CreateDealloc(B, fill);
+  B.CreateRetVoid();
+  return F;
+}
+
+Function *getOrInsertSparsityColoring(Module &M) {
+  auto &Ctx = M.getContext();
+  Type *i64 = Type::getInt64Ty(Ctx);
+  Type *PT = PointerType::getUnqual(i64);
+  FunctionType *FT = FunctionType::get(i64, {i64, PT, PT, PT, PT, PT}, false);
+  std::string name = "__enzyme_sparsity_coloring";
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::NoUnwind);
+
+  auto na = F->arg_begin();
+  na->setName("na");
+  auto aptr = na + 1;
+  aptr->setName("aptr");
+  auto aidx = aptr + 1;
+  aidx->setName("aidx");
+  auto bptr = aidx + 1;
+  bptr->setName("bptr");
+  auto bidx = bptr + 1;
+  bidx->setName("bidx");
+  auto colors = bidx + 1;
+  colors->setName("colors");
+
+  IRBuilder<> B(BasicBlock::Create(Ctx, "entry", F));
+  Value *zero = ConstantInt::get(i64, 0);
+  Value *one = ConstantInt::get(i64, 1);
+  Value *ncolors = B.CreateAlloca(i64, nullptr, "ncolors");
+  B.CreateStore(zero, ncolors);
+
+  // mark[c] == a if color c is taken by a vertex sharing a neighbour with a.
+  Value *mark = B.CreatePointerCast(CreateAllocation(B, i64, na, "mark"), PT);
+  createCountedLoop(B, zero, na, 1, "init", [&](IRBuilder<> &B, Value *a) {
+    storeIndex(B, ConstantInt::get(i64, -1), mark, a);
+  });
+  createCountedLoop(B, zero, na, 1, "color", [&](IRBuilder<> &B, Value *a) {
+    createPatternLoop(B, aptr, aidx, a, "color.b", [&](IRBuilder<> &B,
+                                                        Value *b) {
+      createPatternLoop(B, bptr, bidx, b, "color.a", [&](IRBuilder<> &B,
+                                                          Value *a2) {
+        BasicBlock *taken = BasicBlock::Create(Ctx, "taken", F);
+        BasicBlock *cont = BasicBlock::Create(Ctx, "taken.end", F);
+        B.CreateCondBr(B.CreateICmpSLT(a2, a), taken, cont);
+        B.SetInsertPoint(taken);
+        storeIndex(B, a, mark, loadIndex(B, colors, a2));
+        B.CreateBr(cont);
+        B.SetInsertPoint(cont);
+      });
+    });
+
+    // Take the smallest color not marked for a.
+    BasicBlock *preheader = B.GetInsertBlock();
+    BasicBlock *search = BasicBlock::Create(Ctx, "search", F);
+    BasicBlock *found = BasicBlock::Create(Ctx, "found", F);
+    B.CreateBr(search);
+    B.SetInsertPoint(search);
+    PHINode *c = B.CreatePHI(i64, 2, "c");
+    c->addIncoming(zero, preheader);
+    Value *next = B.CreateNSWAdd(c, one, "c.next");
+    c->addIncoming(next, search);
+    B.CreateCondBr(B.CreateICmpEQ(loadIndex(B, mark, c), a), search, found);
+    B.SetInsertPoint(found);
+    storeIndex(B, c, colors, a);
+#if LLVM_VERSION_MAJOR > 7
+    Value *prev = B.CreateLoad(i64, ncolors);
+#else
+    Value *prev = B.CreateLoad(ncolors);
+#endif
+    B.CreateStore(B.CreateSelect(B.CreateICmpSLT(prev, next), next, prev),
+                  ncolors);
+  });
+  CreateDealloc(B, mark);
+#if LLVM_VERSION_MAJOR > 7
+  B.CreateRet(B.CreateLoad(i64, ncolors));
+#else
+  B.CreateRet(B.CreateLoad(ncolors));
+#endif
+  return F;
+}
+
 // TODO implement differential memmove
 Function *getOrInsertDifferentialFloatMemmove(Module &M, Type *T,
                                               unsigned dstalign,
@@ -856,6 +1734,187 @@ llvm::Value *nextPowerOfTwo(llvm::IRBuilder<> &B, llvm::Value *V) {
   return V;
 }
 
+/// Rotate the N lanes of V down by r, such that lane i holds lane (i + r) % N
+static Value *rotateLanes(IRBuilder<> &B, Value *V, unsigned N, unsigned r) {
+  SmallVector<Constant *, 8> idxs;
+  for (unsigned i = 0; i < N; ++i)
+    idxs.push_back(B.getInt32((i + r) % N));
+  return B.CreateShuffleVector(V, UndefValue::get(V->getType()),
+                               ConstantVector::get(idxs));
+}
+
+static unsigned getNumLanes(Type *T) {
+#if LLVM_VERSION_MAJOR >= 11
+  if (isa<ScalableVectorType>(T)) {
+    llvm::errs() << "unhandled lanes of scalable vector " << *T << "\n";
+    llvm_unreachable("unhandled lanes of scalable vector");
+  }
+  return cast<FixedVectorType>(T)->getNumElements();
+#else
+  return cast<VectorType>(T)->getNumElements();
+#endif
+}
+
+llvm::Value *sumDuplicateLanes(llvm::IRBuilder<> &B, llvm::Value *ptrs,
+                               llvm::Value *mask, llvm::Value *vals) {
+  unsigned N = getNumLanes(ptrs->getType());
+  Value *zero = Constant::getNullValue(vals->getType());
+  Value *active = B.CreateSelect(mask, vals, zero);
+  Value *sum = active;
+  for (unsigned r = 1; r < N; ++r) {
+    Value *same = B.CreateICmpEQ(ptrs, rotateLanes(B, ptrs, N, r));
+    sum = B.CreateFAdd(
+        sum, B.CreateSelect(same, rotateLanes(B, active, N, r), zero));
+  }
+  return sum;
+}
+
+llvm::Value *lastWriterLanes(llvm::IRBuilder<> &B, llvm::Value *ptrs,
+                             llvm::Value *mask) {
+  unsigned N = getNumLanes(ptrs->getType());
+  Value *overwritten = Constant::getNullValue(mask->getType());
+  for (unsigned r = 1; r < N; ++r) {
+    // Lane i is overwritten if lane i + r exists, is active and aliases it.
+    SmallVector<Constant *, 8> later;
+    for (unsigned i = 0; i < N; ++i)
+      later.push_back(B.getInt1(i + r < N));
+    Value *same = B.CreateICmpEQ(ptrs, rotateLanes(B, ptrs, N, r));
+    same = B.CreateAnd(same, rotateLanes(B, mask, N, r));
+    same = B.CreateAnd(same, ConstantVector::get(later));
+    overwritten = B.CreateOr(overwritten, same);
+  }
+  return B.CreateAnd(mask, B.CreateNot(overwritten));
+}
+
+llvm::Value *firstActiveLane(llvm::IRBuilder<> &B, llvm::Value *mask) {
+  unsigned N = getNumLanes(mask->getType());
+  Value *preceded = Constant::getNullValue(mask->getType());
+  for (unsigned r = 1; r < N; ++r) {
+    // Lane i is preceded if lane i - r exists and is active. This works on
+    // lanes rather than on the bits of the mask, whose order depends on the
+    // endianness of the target.
+    SmallVector<Constant *, 8> earlier;
+    for (unsigned i = 0; i < N; ++i)
+      earlier.push_back(B.getInt1(i >= r));
+    Value *prev = rotateLanes(B, mask, N, N - r);
+    preceded = B.CreateOr(preceded,
+                          B.CreateAnd(prev, ConstantVector::get(earlier)));
+  }
+  return B.CreateAnd(mask, B.CreateNot(preceded));
+}
+
+#define GET_DERIVATIVE_REUSE
+#include "InstructionDerivatives.inc"
+
+static Intrinsic::ID getLibMIntrinsic(const CallInst *CI) {
+  if (auto II = dyn_cast<IntrinsicInst>(CI))
+    return II->getIntrinsicID();
+  Intrinsic::ID ID = Intrinsic::not_intrinsic;
+  isMemFreeLibMFunction(getFuncNameFromCall(const_cast<CallInst *>(CI)), &ID);
+  return ID;
+}
+
+bool derivativeReusesResult(const CallInst *CI) {
+  switch (getLibMIntrinsic(CI)) {
+  case Intrinsic::exp:
+  case Intrinsic::exp2:
+  case Intrinsic::sqrt:
+  case Intrinsic::nvvm_sqrt_rn_d:
+    return true;
+  default:
+    break;
+  }
+  auto funcName = getFuncNameFromCall(const_cast<CallInst *>(CI));
+  return funcName == "__fd_sincos_1" || derivativeUsesPrimalResult(funcName);
+}
+
+bool derivativeOnlyUsesResult(const CallInst *CI) {
+  switch (getLibMIntrinsic(CI)) {
+  case Intrinsic::exp:
+  case Intrinsic::exp2:
+  case Intrinsic::sqrt:
+  case Intrinsic::nvvm_sqrt_rn_d:
+    return true;
+  default:
+    break;
+  }
+  return getFuncNameFromCall(const_cast<CallInst *>(CI)) == "__fd_sincos_1";
+}
+
+CallInst *findDerivativeCompanion(const CallInst *CI) {
+  Intrinsic::ID ID = getLibMIntrinsic(CI);
+  Intrinsic::ID companionID = Intrinsic::not_intrinsic;
+  StringRef companionName;
+  if (ID == Intrinsic::sin)
+    companionID = Intrinsic::cos;
+  else if (ID == Intrinsic::cos)
+    companionID = Intrinsic::sin;
+  else
+    companionName = derivativeCompanionName(
+        getFuncNameFromCall(const_cast<CallInst *>(CI)));
+  if (companionID == Intrinsic::not_intrinsic && companionName.empty())
+    return nullptr;
+
+  for (auto &I : *CI->getParent()) {
+    auto C = dyn_cast<CallInst>(&I);
+    if (!C || C == CI || C->getType() != CI->getType() ||
+        C->getNumOperands() != CI->getNumOperands())
+      continue;
+    if (!std::equal(C->arg_begin(), C->arg_end(), CI->arg_begin()))
+      continue;
+    if (companionID != Intrinsic::not_intrinsic
+            ? getLibMIntrinsic(C) == companionID
+            : getFuncNameFromCall(C) == companionName)
+      return const_cast<CallInst *>(C);
+  }
+  return nullptr;
+}
+
+llvm::Value *x86SelectsFirstOperand(llvm::IRBuilder<> &B, Intrinsic::ID ID,
+                                    ArrayRef<Value *> ops) {
+  Value *op0 = ops[0];
+  Value *op1 = ops[1];
+  switch (ID) {
+  // The SSE/AVX max and min return the second operand unless the first one
+  // compares strictly greater (less), in particular for NaNs and equal values.
+  // The scalar variants pass the upper lanes of the first operand through.
+  case Intrinsic::x86_sse_max_ps:
+  case Intrinsic::x86_sse2_max_pd:
+  case Intrinsic::x86_avx_max_ps_256:
+  case Intrinsic::x86_avx_max_pd_256:
+    return B.CreateFCmpOGT(op0, op1);
+  case Intrinsic::x86_sse_min_ps:
+  case Intrinsic::x86_sse2_min_pd:
+  case Intrinsic::x86_avx_min_ps_256:
+  case Intrinsic::x86_avx_min_pd_256:
+    return B.CreateFCmpOLT(op0, op1);
+  case Intrinsic::x86_sse_max_ss:
+  case Intrinsic::x86_sse2_max_sd:
+  case Intrinsic::x86_sse_min_ss:
+  case Intrinsic::x86_sse2_min_sd: {
+    bool isMax = ID == Intrinsic::x86_sse_max_ss ||
+                 ID == Intrinsic::x86_sse2_max_sd;
+    Value *cmp = isMax ? B.CreateFCmpOGT(op0, op1) : B.CreateFCmpOLT(op0, op1);
+    unsigned N = getNumLanes(op0->getType());
+    SmallVector<Constant *, 4> upper(N, B.getTrue());
+    upper[0] = B.getFalse();
+    return B.CreateOr(cmp, ConstantVector::get(upper));
+  }
+  // The blends take the second operand where the sign bit of the mask is set.
+  case Intrinsic::x86_sse41_blendvps:
+  case Intrinsic::x86_sse41_blendvpd:
+  case Intrinsic::x86_avx_blendv_ps_256:
+  case Intrinsic::x86_avx_blendv_pd_256: {
+    Value *bits = B.CreateBitCast(
+        ops[2], VectorType::getInteger(cast<VectorType>(ops[2]->getType())));
+    return B.CreateICmpSGE(bits, Constant::getNullValue(bits->getType()));
+  }
+  default:
+    llvm::errs() << "unknown x86 select intrinsic " << ID << "\n";
+    llvm_unreachable("unknown x86 select intrinsic");
+  }
+}
+
 llvm::Function *getOrInsertDifferentialWaitallSave(llvm::Module &M,
                                                    ArrayRef<llvm::Type *> T,
                                                    PointerType *reqType) {
@@ -1063,6 +2122,246 @@ llvm::Function *getOrInsertDifferentialMPI_Wait(llvm::Module &M,
   return F;
 }
 
+/// Create function that saves the counts and displacements of a vector MPI
+/// collective into cache, laid out as [n, total, counts[n], displs[n],
+/// packed[n]]. packed holds the displacements the segments would have if
+/// stored contiguously, and total the sum of all counts. A null displs
+/// denotes a contiguous layout.
+llvm::Function *getOrInsertMPIVectorCountsSave(llvm::Module &M,
+                                               llvm::Type *intType) {
+  std::string name = "__enzyme_mpi_save_counts_" +
+                     std::to_string(cast<IntegerType>(intType)->getBitWidth());
+  Type *intPtr = PointerType::getUnqual(intType);
+  FunctionType *FT =
+      FunctionType::get(Type::getVoidTy(M.getContext()),
+                        {intPtr, intPtr, intPtr, intType}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(0, Attribute::NoCapture);
+  F->addParamAttr(1, Attribute::NoCapture);
+  F->addParamAttr(2, Attribute::NoCapture);
+  F->addParamAttr(0, Attribute::WriteOnly);
+  F->addParamAttr(1, Attribute::ReadOnly);
+  F->addParamAttr(2, Attribute::ReadOnly);
+
+  BasicBlock *entry = BasicBlock::Create(M.getContext(), "entry", F);
+  BasicBlock *body = BasicBlock::Create(M.getContext(), "for.body", F);
+  BasicBlock *end = BasicBlock::Create(M.getContext(), "for.end", F);
+
+  auto cache = F->arg_begin();
+  cache->setName("cache");
+  Value *counts = cache + 1;
+  counts->setName("counts");
+  Value *displs = cache + 2;
+  displs->setName("displs");
+  Value *n = cache + 3;
+  n->setName("n");
+
+  Type *i64 = Type::getInt64Ty(M.getContext());
+  auto gep = [&](IRBuilder<> &B, Value *ptr, Value *idx) -> Value * {
+#if LLVM_VERSION_MAJOR > 7
+    return B.CreateInBoundsGEP(intType, ptr, idx);
+#else
+    return B.CreateInBoundsGEP(ptr, idx);
+#endif
+  };
+  auto load = [&](IRBuilder<> &B, Value *ptr) -> Value * {
+#if LLVM_VERSION_MAJOR > 7
+    return B.CreateLoad(intType, ptr);
+#else
+    return B.CreateLoad(ptr);
+#endif
+  };
+
+  Value *len;
+  {
+    IRBuilder<> B(entry);
+    len = B.CreateZExt(n, i64, "len");
+    B.CreateStore(n, cache);
+    B.CreateCondBr(B.CreateICmpEQ(n, ConstantInt::get(intType, 0)), end,
+                   body);
+  }
+
+  PHINode *acc;
+  Value *nacc;
+  {
+    IRBuilder<> B(body);
+    PHINode *idx = B.CreatePHI(i64, 2, "idx");
+    idx->addIncoming(ConstantInt::get(i64, 0), entry);
+    acc = B.CreatePHI(intType, 2, "acc");
+    acc->addIncoming(ConstantInt::get(intType, 0), entry);
+
+    Value *count = load(B, gep(B, counts, idx));
+    Value *isNull =
+        B.CreateICmpEQ(displs, Constant::getNullValue(displs->getType()));
+    Value *displ =
+        load(B, gep(B, B.CreateSelect(isNull, counts, displs), idx));
+    displ = B.CreateSelect(isNull, acc, displ);
+
+    Value *off = B.CreateAdd(idx, ConstantInt::get(i64, 2));
+    B.CreateStore(count, gep(B, cache, off));
+    off = B.CreateAdd(off, len);
+    B.CreateStore(displ, gep(B, cache, off));
+    off = B.CreateAdd(off, len);
+    B.CreateStore(acc, gep(B, cache, off));
+
+    nacc = B.CreateAdd(acc, count, "acc.next");
+    acc->addIncoming(nacc, body);
+    Value *next = B.CreateNUWAdd(idx, ConstantInt::get(i64, 1), "idx.next");
+    idx->addIncoming(next, body);
+    B.CreateCondBr(B.CreateICmpEQ(len, next), end, body);
+  }
+
+  {
+    IRBuilder<> B(end);
+    PHINode *total = B.CreatePHI(intType, 2, "total");
+    total->addIncoming(ConstantInt::get(intType, 0), entry);
+    total->addIncoming(nacc, body);
+    B.CreateStore(total, gep(B, cache, ConstantInt::get(i64, 1)));
+    B.CreateRetVoid();
+  }
+  return F;
+}
+
+/// Create function that moves the segments of a vector MPI buffer, as
+/// described by a cache from getOrInsertMPIVectorCountsSave, between their
+/// displaced and contiguous layouts; packed, displaced, cache, typesize.
+/// Without an element type the displaced segments are copied into the
+/// contiguous buffer and zeroed. Otherwise the contiguous segments are added
+/// into the displaced ones as floats of that type.
+llvm::Function *getOrInsertMPIVectorSegments(llvm::Module &M,
+                                             llvm::Type *intType,
+                                             llvm::Type *elementType) {
+  std::string name =
+      elementType ? "__enzyme_mpi_add_segments_" + tofltstr(elementType)
+                  : "__enzyme_mpi_pack_segments";
+  name += "_" + std::to_string(cast<IntegerType>(intType)->getBitWidth());
+  Type *i8p = Type::getInt8PtrTy(M.getContext());
+  FunctionType *FT = FunctionType::get(
+      Type::getVoidTy(M.getContext()),
+      {i8p, i8p, PointerType::getUnqual(intType), intType}, false);
+
+#if LLVM_VERSION_MAJOR >= 9
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT).getCallee());
+#else
+  Function *F = cast<Function>(M.getOrInsertFunction(name, FT));
+#endif
+
+  if (!F->empty())
+    return F;
+
+  F->setLinkage(Function::LinkageTypes::InternalLinkage);
+  F->addFnAttr(Attribute::ArgMemOnly);
+  F->addFnAttr(Attribute::NoUnwind);
+  F->addFnAttr(Attribute::AlwaysInline);
+  F->addParamAttr(0, Attribute::NoCapture);
+  F->addParamAttr(1, Attribute::NoCapture);
+  F->addParamAttr(2, Attribute::NoCapture);
+  F->addParamAttr(2, Attribute::ReadOnly);
+
+  BasicBlock *entry = BasicBlock::Create(M.getContext(), "entry", F);
+  BasicBlock *body = BasicBlock::Create(M.getContext(), "for.body", F);
+  BasicBlock *end = BasicBlock::Create(M.getContext(), "for.end", F);
+
+  auto packed = F->arg_begin();
+  packed->setName("packed");
+  Value *displaced = packed + 1;
+  displaced->setName("displaced");
+  Value *cache = packed + 2;
+  cache->setName("cache");
+  Value *tysize = packed + 3;
+  tysize->setName("tysize");
+
+  Type *i64 = Type::getInt64Ty(M.getContext());
+  Type *i8 = Type::getInt8Ty(M.getContext());
+  auto load = [&](IRBuilder<> &B, Value *idx) -> Value * {
+#if LLVM_VERSION_MAJOR > 7
+    return B.CreateSExt(
+        B.CreateLoad(intType, B.CreateInBoundsGEP(intType, cache, idx)), i64);
+#else
+    return B.CreateSExt(B.CreateLoad(B.CreateInBoundsGEP(cache, idx)), i64);
+#endif
+  };
+
+  Value *len;
+  Value *size;
+  {
+    IRBuilder<> B(entry);
+    len = load(B, ConstantInt::get(i64, 0));
+    size = B.CreateZExt(tysize, i64, "size");
+    B.CreateCondBr(B.CreateICmpEQ(len, ConstantInt::get(i64, 0)), end, body);
+  }
+
+  {
+    IRBuilder<> B(body);
+    PHINode *idx = B.CreatePHI(i64, 2, "idx");
+    idx->addIncoming(ConstantInt::get(i64, 0), entry);
+
+    Value *off = B.CreateAdd(idx, ConstantInt::get(i64, 2));
+    Value *count = B.CreateMul(load(B, off), size, "seg.len");
+    off = B.CreateAdd(off, len);
+    Value *displ = B.CreateMul(load(B, off), size);
+    off = B.CreateAdd(off, len);
+    Value *pdispl = B.CreateMul(load(B, off), size);
+
+#if LLVM_VERSION_MAJOR > 7
+    Value *dseg = B.CreateInBoundsGEP(i8, displaced, displ, "dseg");
+    Value *pseg = B.CreateInBoundsGEP(i8, packed, pdispl, "pseg");
+#else
+    Value *dseg = B.CreateInBoundsGEP(displaced, displ, "dseg");
+    Value *pseg = B.CreateInBoundsGEP(packed, pdispl, "pseg");
+#endif
+
+    if (elementType) {
+      auto &DL = M.getDataLayout();
+      Value *num = B.CreateUDiv(
+          count,
+          ConstantInt::get(i64, DL.getTypeSizeInBits(elementType) / 8));
+      // Adds pseg into dseg, zeroing pseg.
+      Function *memcpyadd = getOrInsertDifferentialFloatMemcpy(
+          M, elementType, /*dstalign*/ 1, /*srcalign*/ 1, /*dstaddr*/ 0,
+          /*srcaddr*/ 0);
+      Value *args[] = {
+          B.CreatePointerCast(pseg, PointerType::getUnqual(elementType)),
+          B.CreatePointerCast(dseg, PointerType::getUnqual(elementType)),
+          num};
+      B.CreateCall(memcpyadd, args);
+    } else {
+      Type *cpytys[] = {i8p, i8p, i64};
+      Value *cpyargs[] = {pseg, dseg, count, ConstantInt::getFalse(M.getContext())};
+      B.CreateCall(Intrinsic::getDeclaration(&M, Intrinsic::memcpy, cpytys),
+                   cpyargs);
+      Type *settys[] = {i8p, i64};
+      Value *setargs[] = {dseg, ConstantInt::get(i8, 0), count,
+                          ConstantInt::getFalse(M.getContext())};
+      B.CreateCall(Intrinsic::getDeclaration(&M, Intrinsic::memset, settys),
+                   setargs);
+    }
+
+    Value *next = B.CreateNUWAdd(idx, ConstantInt::get(i64, 1), "idx.next");
+    idx->addIncoming(next, body);
+    B.CreateCondBr(B.CreateICmpEQ(len, next), end, body);
+  }
+
+  {
+    IRBuilder<> B(end);
+    B.CreateRetVoid();
+  }
+  return F;
+}
+
 llvm::Value *getOrInsertOpFloatSum(llvm::Module &M, llvm::Type *OpPtr,
                                    ConcreteType CT, llvm::Type *intType,
                                    IRBuilder<> &B2) {
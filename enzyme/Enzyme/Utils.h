@@ -51,6 +51,7 @@
 #if LLVM_VERSION_MAJOR >= 10
 #include "llvm/IR/IntrinsicsAMDGPU.h"
 #include "llvm/IR/IntrinsicsNVPTX.h"
+#include "llvm/IR/IntrinsicsX86.h"
 #endif
 
 #include <map>
@@ -607,6 +608,73 @@ llvm::Function *getOrInsertMemcpyStrided(llvm::Module &M, llvm::PointerType *T,
                                          llvm::Type *IT, unsigned dstalign,
                                          unsigned srcalign);
 
+/// Create function for type that packs a rows x cols matrix with leading
+/// dimension ld, storing it with leading dimension rows
+llvm::Function *getOrInsertMemcpyMat(llvm::Module &M, llvm::PointerType *T,
+                                     llvm::IntegerType *IT);
+
+/// Create function for type that scales part of a rows x cols matrix by
+/// alpha. The part is selected by tri: 0 for all elements (i, j), and
+/// 1, 2, 3 and 4 for those with i <= j, i >= j, i < j and i > j respectively
+llvm::Function *getOrInsertScaleMat(llvm::Module &M, llvm::Type *T,
+                                    llvm::IntegerType *IT);
+
+/// Create function for type that adds alpha times part of a rows x cols
+/// matrix X, or of the transpose of X if trans is nonzero, to Y, the part
+/// being selected as by getOrInsertScaleMat
+llvm::Function *getOrInsertAxpyMat(llvm::Module &M, llvm::Type *T,
+                                   llvm::IntegerType *IT);
+
+/// Create function for type that turns V^T dV, for eigenvectors V with
+/// eigenvalues w, into the matrix with elements (V^T dV)_ij / (w_j - w_i)
+/// as needed by the adjoint of a symmetric eigendecomposition
+llvm::Function *getOrInsertEigenvectorAdjointMat(llvm::Module &M,
+                                                 llvm::Type *T,
+                                                 llvm::IntegerType *IT);
+
+/// Create function for type computing C = beta C + A B for strided M x K,
+/// K x N and M x N matrices, element (i, j) of which lies i * s_i + j * s_j
+/// bytes past their base, and beta either 0 or 1, accumulating with
+/// llvm.fmuladd if Fused. Calls to it are differentiated as a whole matrix
+/// product
+llvm::Function *getOrInsertMatmul(llvm::Module &M, llvm::Type *T,
+                                  bool Fused = false);
+
+/// Create function for type that packs a strided rows x cols matrix, as
+/// taken by getOrInsertMatmul, into a contiguous column-major one
+llvm::Function *getOrInsertMatmulPack(llvm::Module &M, llvm::Type *T);
+
+/// Emit at B a loop running body(B, idx) for idx in [lo, hi) by step, leaving
+/// B at its exit.
+void createCountedLoop(
+    llvm::IRBuilder<> &B, llvm::Value *lo, llvm::Value *hi, uint64_t step,
+    const llvm::Twine &name,
+    llvm::function_ref<void(llvm::IRBuilder<> &, llvm::Value *)> body);
+
+/// Emit at B the iteration y = b + f(y) over the n elements of type T of y,
+/// or y = f(y) if b is null, until the largest update is within the tolerance
+/// of __enzyme_fixed_point relative to the largest element of y, leaving B at
+/// its exit. apply(B, out) writes f(y) to out.
+void createFixedPointLoop(
+    llvm::IRBuilder<> &B, llvm::Type *T, llvm::Value *y, llvm::Value *b,
+    llvm::Value *n,
+    llvm::function_ref<void(llvm::IRBuilder<> &, llvm::Value *)> apply);
+
+/// Create the solver called in place of __enzyme_fixed_point(step, x, n,
+/// args...), which iterates step(out, x, args...), x = out, until x is a fixed
+/// point of step. Calls to it are differentiated at the fixed point alone
+llvm::Function *getOrInsertFixedPoint(llvm::Module &M, llvm::Function *step);
+
+/// Create function that computes the CSC pattern colptr, rowidx of the m x n
+/// CSR sparsity pattern rowptr, colidx
+llvm::Function *getOrInsertSparsityTranspose(llvm::Module &M);
+
+/// Create function that greedily colors the na vertices of one side of the
+/// bipartite graph given by the adjacency aptr, aidx and its transpose bptr,
+/// bidx, such that vertices sharing a neighbour differ in color. The colors are
+/// written to colors and their number returned
+llvm::Function *getOrInsertSparsityColoring(llvm::Module &M);
+
 /// Create function for type that performs the derivative memmove on floating
 /// point memory
 llvm::Function *
@@ -622,9 +690,54 @@ llvm::Function *getOrInsertDifferentialMPI_Wait(llvm::Module &M,
                                                 llvm::ArrayRef<llvm::Type *> T,
                                                 llvm::Type *reqType);
 
+/// Create function that saves the counts and displacements of a vector MPI
+/// collective for the reverse pass
+llvm::Function *getOrInsertMPIVectorCountsSave(llvm::Module &M,
+                                               llvm::Type *intType);
+
+/// Create function that packs the segments of a vector MPI buffer, or adds
+/// them back into their displaced layout if elementType is given
+llvm::Function *getOrInsertMPIVectorSegments(llvm::Module &M,
+                                             llvm::Type *intType,
+                                             llvm::Type *elementType);
+
 /// Create function to computer nearest power of two
 llvm::Value *nextPowerOfTwo(llvm::IRBuilder<> &B, llvm::Value *V);
 
+/// Given a vector of pointers and a mask, return for every active lane the sum
+/// of vals over all active lanes of the same address, such that a masked
+/// scatter of the result accumulates correctly in spite of duplicate addresses
+llvm::Value *sumDuplicateLanes(llvm::IRBuilder<> &B, llvm::Value *ptrs,
+                               llvm::Value *mask, llvm::Value *vals);
+
+/// Given a vector of pointers and a mask, return the active lanes whose store
+/// in a masked scatter is not overwritten by a later lane of the same address
+llvm::Value *lastWriterLanes(llvm::IRBuilder<> &B, llvm::Value *ptrs,
+                             llvm::Value *mask);
+
+/// Given a mask, return the mask of its first active lane
+llvm::Value *firstActiveLane(llvm::IRBuilder<> &B, llvm::Value *mask);
+
+/// Return whether the derivative of the given call reuses its primal result,
+/// which is then needed in the reverse pass
+bool derivativeReusesResult(const llvm::CallInst *CI);
+
+/// Return whether the derivative of the given call is computed from its
+/// primal result alone, without needing its operands
+bool derivativeOnlyUsesResult(const llvm::CallInst *CI);
+
+/// Return the call in the same block which computes the companion function
+/// required by the derivative of the given call (e.g. cos for sin) on the
+/// same operands, if any. The reverse pass then reuses its primal result.
+llvm::CallInst *findDerivativeCompanion(const llvm::CallInst *CI);
+
+/// Given an x86 SIMD max/min/blendv intrinsic and its operands, return the
+/// mask of result lanes taken from the first operand (all others are taken
+/// from the second operand)
+llvm::Value *x86SelectsFirstOperand(llvm::IRBuilder<> &B,
+                                    llvm::Intrinsic::ID ID,
+                                    llvm::ArrayRef<llvm::Value *> ops);
+
 /// Insert into a map
 template <typename K, typename V>
 static inline typename std::map<K, V>::iterator
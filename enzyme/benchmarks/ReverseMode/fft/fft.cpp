@@ -24,6 +24,43 @@ void foobar(double* data, unsigned len) {
   ifft(data, len);
 }
 
+// The transforms are linear, the adjoint of each being the unnormalized
+// transform of opposite sign, such that Enzyme needs no tape for them.
+__attribute__((noinline))
+static void fft_linear(double* data, unsigned len) {
+  fft(data, len);
+}
+
+__attribute__((noinline))
+static void ifft_linear(double* data, unsigned len) {
+  ifft(data, len);
+}
+
+static void fft_adjoint(double* data, unsigned len) {
+  scramble(data, len);
+  recursiveApply(data, -1, len);
+}
+
+static void ifft_adjoint(double* data, unsigned len) {
+  fft(data, len);
+  rescale(data, len);
+}
+
+void* __enzyme_register_linear_fft[] = {
+  (void*)fft_linear,
+  (void*)fft_adjoint,
+};
+
+void* __enzyme_register_linear_ifft[] = {
+  (void*)ifft_linear,
+  (void*)ifft_adjoint,
+};
+
+void foobar_linear(double* data, unsigned len) {
+  fft_linear(data, len);
+  ifft_linear(data, len);
+}
+
 void afoobar(aVector& data, unsigned len) {
   fft(data, len);
   ifft(data, len);
@@ -45,6 +82,18 @@ static double foobar_and_gradient(unsigned len) {
     return res;
 }
 
+static double foobar_linear_and_gradient(unsigned len) {
+    double *inp = new double[2*len];
+    for(int i=0; i<2*len; i++) inp[i] = 2.0;
+    double *dinp = new double[2*len];
+    for(int i=0; i<2*len; i++) dinp[i] = 1.0;
+    __enzyme_autodiff<void>(foobar_linear, enzyme_dupnoneed, inp, dinp, len);
+    double res = dinp[0];
+    delete[] dinp;
+    delete[] inp;
+    return res;
+}
+
 static double afoobar_and_gradient(unsigned len) {
     adept::Stack stack;
 
@@ -200,6 +249,16 @@ static void enzyme_sincos(double inp, unsigned len) {
   gettimeofday(&end, NULL);
   printf("Enzyme combined %0.6f res'=%f\n", tdiff(&start, &end), res2);
   }
+
+  {
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+
+  double res2 = foobar_linear_and_gradient(len);
+
+  gettimeofday(&end, NULL);
+  printf("Enzyme linear combined %0.6f res'=%f\n", tdiff(&start, &end), res2);
+  }
 }
 
 
@@ -16,6 +16,7 @@ using adept::aVector;
 using adept::Vector;
 
 extern int enzyme_const;
+extern int enzyme_width;
 template<typename Return, typename... T>
 Return __enzyme_autodiff(T...);
 
@@ -264,6 +265,41 @@ static void enzyme_sincos(double *input, double *inputp, unsigned long n, unsign
   gettimeofday(&end, NULL);
   printf("enzyme forward and reverse %0.6f res'=%f\n", tdiff(&start, &end), sum(inputp, n));
   }
+
+  // Several cotangents of the result: one reverse pass per seed, versus a
+  // single batched pass that shares the forward sweep and tape. Adjoints are
+  // only accumulated as one vector per instruction when built with
+  // -enzyme-vector-shadows, and then only for fmul, fsub and fdiv.
+  double *batchp = new double[4*n];
+  {
+  struct timeval start, end;
+  memset(batchp, 0, sizeof(double)*4*n);
+
+  gettimeofday(&start, NULL);
+
+  for(int i=0; i<repeat; i++) {
+    for(int k=0; k<4; k++)
+      __enzyme_autodiff<void>(logsumexp, input, batchp + k*n, n, (double)(k+1));
+  }
+
+  gettimeofday(&end, NULL);
+  printf("enzyme 4 seeds, separate %0.6f res'=%f\n", tdiff(&start, &end), sum(batchp, 4*n));
+  }
+  {
+  struct timeval start, end;
+  memset(batchp, 0, sizeof(double)*4*n);
+
+  gettimeofday(&start, NULL);
+
+  for(int i=0; i<repeat; i++) {
+    __enzyme_autodiff<void>(logsumexp, enzyme_width, 4, input, batchp, batchp + n,
+                            batchp + 2*n, batchp + 3*n, n, 1.0, 2.0, 3.0, 4.0);
+  }
+
+  gettimeofday(&end, NULL);
+  printf("enzyme 4 seeds, batched %0.6f res'=%f\n", tdiff(&start, &end), sum(batchp, 4*n));
+  }
+  delete[] batchp;
 }
 static void tapenade_sincos(double *input, double *inputp, unsigned long n, unsigned long repeat) {
     double realinput = input[0];
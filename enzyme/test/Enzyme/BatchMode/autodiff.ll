@@ -0,0 +1,45 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -S | FileCheck %s
+; RUN: %opt < %s %newLoadEnzyme -passes="enzyme,function(mem2reg)" -enzyme-preopt=false -S | FileCheck %s
+
+define double @loss(double* %w, double %x) {
+entry:
+  %w0 = load double, double* %w
+  %m = fmul double %w0, %x
+  %r = fmul double %m, %x
+  ret double %r
+}
+
+declare void @__enzyme_batch_autodiff(...)
+
+define void @grads(double* %w, double %x1, double %x2, double* %dw1, double* %dw2) {
+entry:
+  call void (...) @__enzyme_batch_autodiff(double (double*, double)* @loss, metadata !"enzyme_width", i64 2, metadata !"enzyme_scalar", double* %w, double* %dw1, double* %dw2, double %x1, double %x2)
+  ret void
+}
+
+; CHECK: define void @grads(double* %w, double %x1, double %x2, double* %dw1, double* %dw2)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = insertvalue [2 x double*] undef, double* %dw1, 0
+; CHECK-NEXT:   %1 = insertvalue [2 x double*] %0, double* %dw2, 1
+; CHECK-NEXT:   %2 = insertvalue [2 x double] undef, double %x1, 0
+; CHECK-NEXT:   %3 = insertvalue [2 x double] %2, double %x2, 1
+; CHECK-NEXT:   call void @batch_diffeloss(double* %w, [2 x double*] %1, [2 x double] %3, double 1.000000e+00)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @batch_diffeloss(double* %w, [2 x double*] %"w'", [2 x double] %x, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"unwrap.w'0" = extractvalue [2 x double*] %"w'", 0
+; CHECK-NEXT:   %"unwrap.w'1" = extractvalue [2 x double*] %"w'", 1
+; CHECK-NEXT:   %unwrap.x0 = extractvalue [2 x double] %x, 0
+; CHECK-NEXT:   %unwrap.x1 = extractvalue [2 x double] %x, 1
+; CHECK:   %m0diffem0 = fmul fast double %differeturn, %unwrap.x0
+; CHECK-NEXT:   %m0diffem1 = fmul fast double %differeturn, %unwrap.x1
+; CHECK:   %[[l0:.+]] = load double, double* %"unwrap.w'0"
+; CHECK-NEXT:   %[[l1:.+]] = load double, double* %"unwrap.w'1"
+; CHECK-NEXT:   %[[a0:.+]] = fadd fast double %[[l0]]
+; CHECK-NEXT:   %[[a1:.+]] = fadd fast double %[[l1]]
+; CHECK-NEXT:   store double %[[a0]], double* %"unwrap.w'0"
+; CHECK-NEXT:   store double %[[a1]], double* %"unwrap.w'1"
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -0,0 +1,84 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -S | FileCheck %s
+; RUN: %opt < %s %newLoadEnzyme -passes="enzyme,function(mem2reg)" -enzyme-preopt=false -S | FileCheck %s
+
+define double @powi(double* %out, double %x, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %acc = phi double [ 1.000000e+00, %entry ], [ %mul, %loop ]
+  %mul = fmul double %acc, %x
+  store double %mul, double* %out
+  %inc = add i64 %i, 1
+  %cmp = icmp slt i64 %inc, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret double %mul
+}
+
+define [2 x double] @vecpowi(double* %out1, double* %out2, double %x, i64 %n1, i64 %n2) {
+entry:
+  %0 = tail call [2 x double] (...) @__enzyme_batch(double (double*, double, i64)* nonnull @powi, metadata !"enzyme_width", i64 2, metadata !"enzyme_vector", double* %out1, double* %out2, metadata !"enzyme_scalar", double %x, metadata !"enzyme_vector", i64 %n1, i64 %n2)
+  ret [2 x double] %0
+}
+
+declare [2 x double] @__enzyme_batch(...)
+
+; CHECK: define internal [2 x double] @batch_powi([2 x double*] %out, double %x, [2 x i64] %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %unwrap.out0 = extractvalue [2 x double*] %out, 0
+; CHECK-NEXT:   %unwrap.out1 = extractvalue [2 x double*] %out, 1
+; CHECK-NEXT:   %unwrap.n0 = extractvalue [2 x i64] %n, 0
+; CHECK-NEXT:   %unwrap.n1 = extractvalue [2 x i64] %n, 1
+; CHECK-NEXT:   br label %loop
+
+; CHECK: loop:
+; CHECK-NEXT:   %active0 = phi i1 [ true, %entry ], [ %4, %3 ]
+; CHECK-NEXT:   %active = phi i1 [ true, %entry ], [ %5, %3 ]
+; CHECK-NEXT:   %exited0 = phi i1 [ false, %entry ], [ %12, %3 ]
+; CHECK-NEXT:   %exited = phi i1 [ false, %entry ], [ %13, %3 ]
+; CHECK-NEXT:   %mul.lcssa.exit0 = phi double [ undef, %entry ], [ %10, %3 ]
+; CHECK-NEXT:   %mul.lcssa.exit = phi double [ undef, %entry ], [ %11, %3 ]
+; CHECK-NEXT:   %i = phi i64 [ 0, %entry ], [ %inc, %3 ]
+; CHECK-NEXT:   %acc = phi double [ 1.000000e+00, %entry ], [ %mul, %3 ]
+; CHECK-NEXT:   %mul = fmul double %acc, %x
+; CHECK-NEXT:   br i1 %active0, label %0, label %1
+
+; CHECK: 0:
+; CHECK-NEXT:   store double %mul, double* %unwrap.out0, align 8
+; CHECK-NEXT:   br label %1
+
+; CHECK: 1:
+; CHECK-NEXT:   br i1 %active, label %2, label %3
+
+; CHECK: 2:
+; CHECK-NEXT:   store double %mul, double* %unwrap.out1, align 8
+; CHECK-NEXT:   br label %3
+
+; CHECK: 3:
+; CHECK-NEXT:   %inc = add i64 %i, 1
+; CHECK-NEXT:   %cmp0 = icmp slt i64 %inc, %unwrap.n0
+; CHECK-NEXT:   %cmp1 = icmp slt i64 %inc, %unwrap.n1
+; CHECK-NEXT:   %4 = and i1 %cmp0, %active0
+; CHECK-NEXT:   %5 = and i1 %cmp1, %active
+; CHECK-NEXT:   %6 = xor i1 %cmp0, true
+; CHECK-NEXT:   %7 = xor i1 %cmp1, true
+; CHECK-NEXT:   %8 = and i1 %6, %active0
+; CHECK-NEXT:   %9 = and i1 %7, %active
+; CHECK-NEXT:   %10 = select i1 %8, double %mul, double %mul.lcssa.exit0
+; CHECK-NEXT:   %11 = select i1 %9, double %mul, double %mul.lcssa.exit
+; CHECK-NEXT:   %12 = or i1 %8, %exited0
+; CHECK-NEXT:   %13 = or i1 %9, %exited
+; CHECK-NEXT:   %14 = or i1 %4, %5
+; CHECK-NEXT:   br i1 %14, label %loop, label %exit
+
+; CHECK: exit:
+; CHECK-NEXT:   br label %linearized.end
+
+; CHECK: linearized.end:
+; CHECK-NEXT:   %mrv = insertvalue [2 x double] {{(undef|poison)?}}, double %10, 0
+; CHECK-NEXT:   %mrv1 = insertvalue [2 x double] %mrv, double %11, 1
+; CHECK-NEXT:   ret [2 x double] %mrv1
+; CHECK-NEXT: }
@@ -0,0 +1,49 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -S | FileCheck %s
+; RUN: %opt < %s %newLoadEnzyme -passes="enzyme,function(mem2reg)" -enzyme-preopt=false -S | FileCheck %s
+
+declare i8* @malloc(i64)
+declare void @free(i8*)
+
+define double @tmp(double %x, i64 %n) {
+entry:
+  %bytes = mul i64 %n, 8
+  %raw = call i8* @malloc(i64 %bytes)
+  %buf = bitcast i8* %raw to double*
+  %sq = fmul double %x, %x
+  store double %sq, double* %buf
+  %v = load double, double* %buf
+  call void @free(i8* %raw)
+  ret double %v
+}
+
+declare [2 x double] @__enzyme_batch(...)
+
+define [2 x double] @test(double %x1, double %x2, i64 %n) {
+entry:
+  %call = call [2 x double] (...) @__enzyme_batch(double (double, i64)* @tmp, metadata !"enzyme_width", i64 2, metadata !"enzyme_vector", double %x1, double %x2, metadata !"enzyme_scalar", i64 %n)
+  ret [2 x double] %call
+}
+
+; CHECK: define internal [2 x double] @batch_tmp([2 x double] %x, i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %unwrap.x0 = extractvalue [2 x double] %x, 0
+; CHECK-NEXT:   %unwrap.x1 = extractvalue [2 x double] %x, 1
+; CHECK-NEXT:   %bytes = mul i64 %n, 8
+; CHECK-NEXT:   %[[up:.+]] = add i64 %bytes, 15
+; CHECK-NEXT:   %[[stride:.+]] = and i64 %[[up]], -16
+; CHECK-NEXT:   %[[total:.+]] = mul i64 %[[stride]], 2
+; CHECK-NEXT:   %raw0 = call i8* @malloc(i64 %[[total]])
+; CHECK-NEXT:   %raw1 = getelementptr inbounds i8, i8* %raw0, i64 %[[stride]]
+; CHECK-NEXT:   %buf0 = bitcast i8* %raw0 to double*
+; CHECK-NEXT:   %buf1 = bitcast i8* %raw1 to double*
+; CHECK-NEXT:   %sq0 = fmul double %unwrap.x0, %unwrap.x0
+; CHECK-NEXT:   %sq1 = fmul double %unwrap.x1, %unwrap.x1
+; CHECK-NEXT:   store double %sq0, double* %buf0, align 8
+; CHECK-NEXT:   store double %sq1, double* %buf1, align 8
+; CHECK-NEXT:   %v0 = load double, double* %buf0, align 8
+; CHECK-NEXT:   %v1 = load double, double* %buf1, align 8
+; CHECK-NEXT:   call void @free(i8* %raw0)
+; CHECK-NEXT:   %mrv = insertvalue [2 x double] {{(undef|poison)?}}, double %v0, 0
+; CHECK-NEXT:   %mrv1 = insertvalue [2 x double] %mrv, double %v1, 1
+; CHECK-NEXT:   ret [2 x double] %mrv1
+; CHECK-NEXT: }
@@ -0,0 +1,71 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -S | FileCheck %s
+; RUN: %opt < %s %newLoadEnzyme -passes="enzyme,function(mem2reg)" -enzyme-preopt=false -S | FileCheck %s
+
+define double @fib(i64 %n) {
+entry:
+  %small = icmp slt i64 %n, 2
+  br i1 %small, label %base, label %rec
+
+base:
+  %d = sitofp i64 %n to double
+  ret double %d
+
+rec:
+  %n1 = sub i64 %n, 1
+  %a = call double @fib(i64 %n1)
+  %n2 = sub i64 %n, 2
+  %b = call double @fib(i64 %n2)
+  %s = fadd double %a, %b
+  ret double %s
+}
+
+declare [2 x double] @__enzyme_batch(...)
+
+define [2 x double] @test(i64 %n1, i64 %n2) {
+entry:
+  %call = call [2 x double] (...) @__enzyme_batch(double (i64)* @fib, metadata !"enzyme_width", i64 2, metadata !"enzyme_vector", i64 %n1, i64 %n2)
+  ret [2 x double] %call
+}
+
+; CHECK: define internal [2 x double] @batch_fib([2 x i64] %n)
+; CHECK: rec:
+; CHECK-NEXT:   %n10 = sub i64 %unwrap.n0, 1
+; CHECK-NEXT:   %n11 = sub i64 %unwrap.n1, 1
+; CHECK-NEXT:   %[[a0:.+]] = insertvalue [2 x i64] undef, i64 %n10, 0
+; CHECK-NEXT:   %[[args:.+]] = insertvalue [2 x i64] %[[a0]], i64 %n11, 1
+; CHECK-NEXT:   %[[m0:.+]] = insertvalue [2 x i1] undef, i1 %[[rec0:.+]], 0
+; CHECK-NEXT:   %[[mask:.+]] = insertvalue [2 x i1] %[[m0]], i1 %[[rec1:.+]], 1
+; CHECK-NEXT:   %[[any:.+]] = or i1 %[[rec0]], %[[rec1]]
+; CHECK-NEXT:   br i1 %[[any]], label %[[callbb:.+]], label %[[after:.+]]
+
+; CHECK: [[callbb]]:
+; CHECK-NEXT:   %[[res:.+]] = call [2 x double] @batch_masked_fib([2 x i64] %[[args]], [2 x i1] %[[mask]])
+; CHECK-NEXT:   br label %[[after]]
+
+; CHECK: [[after]]:
+; CHECK-NEXT:   %a = phi [2 x double] [ %[[res]], %[[callbb]] ], [ undef, %rec ]
+
+; CHECK: define internal [2 x double] @batch_masked_fib([2 x i64] %n, [2 x i1] %mask)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %unwrap.n0 = extractvalue [2 x i64] %n, 0
+; CHECK-NEXT:   %unwrap.n1 = extractvalue [2 x i64] %n, 1
+; CHECK-NEXT:   %unwrap.mask0 = extractvalue [2 x i1] %mask, 0
+; CHECK-NEXT:   %unwrap.mask1 = extractvalue [2 x i1] %mask, 1
+; CHECK-NEXT:   %small0 = icmp slt i64 %unwrap.n0, 2
+; CHECK-NEXT:   %small1 = icmp slt i64 %unwrap.n1, 2
+; CHECK:   %[[not0:.+]] = xor i1 %small0, true
+; CHECK-NEXT:   %[[not1:.+]] = xor i1 %small1, true
+; CHECK-NEXT:   %[[rec0:.+]] = and i1 %[[not0]], %unwrap.mask0
+; CHECK-NEXT:   %[[rec1:.+]] = and i1 %[[not1]], %unwrap.mask1
+; CHECK: rec:
+; CHECK:   %[[m0:.+]] = insertvalue [2 x i1] undef, i1 %[[rec0]], 0
+; CHECK-NEXT:   %[[mask:.+]] = insertvalue [2 x i1] %[[m0]], i1 %[[rec1]], 1
+; CHECK-NEXT:   %[[any:.+]] = or i1 %[[rec0]], %[[rec1]]
+; CHECK-NEXT:   br i1 %[[any]], label %[[callbb:.+]], label %[[after:.+]]
+
+; CHECK: [[callbb]]:
+; CHECK-NEXT:   %[[res:.+]] = call [2 x double] @batch_masked_fib([2 x i64] %{{.+}}, [2 x i1] %[[mask]])
+
+; CHECK: linearized.end:
+; CHECK-NEXT:   %[[r0:.+]] = select i1 %[[rec0]], double %s0, double %d0
+; CHECK-NEXT:   %[[r1:.+]] = select i1 %[[rec1]], double %s1, double %d1
@@ -0,0 +1,89 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -enzyme-batch-simd -mem2reg -S | FileCheck %s
+; RUN: %opt < %s %newLoadEnzyme -passes="enzyme,function(mem2reg)" -enzyme-preopt=false -enzyme-batch-simd -S | FileCheck %s
+
+declare double @llvm.sqrt.f64(double)
+
+define void @axpy(double* %x, double* %y, double %a) {
+entry:
+  %xv = load double, double* %x
+  %r = call double @llvm.sqrt.f64(double %xv)
+  %m = fmul double %r, %a
+  %yv = load double, double* %y
+  %s = fadd double %m, %yv
+  store double %s, double* %y
+  ret void
+}
+
+declare void @__enzyme_batch(...)
+
+define void @test(double* %x1, double* %x2, double* %y1, double* %y2, double %a) {
+entry:
+  call void (...) @__enzyme_batch(void (double*, double*, double)* @axpy, metadata !"enzyme_width", i64 2, metadata !"enzyme_vector", double* %x1, double* %x2, metadata !"enzyme_vector", double* %y1, double* %y2, metadata !"enzyme_scalar", double %a)
+  ret void
+}
+
+; CHECK: define internal void @batch_axpy([2 x double*] %x, [2 x double*] %y, double %a)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %.splatinsert = insertelement <2 x double> poison, double %a, i32 0
+; CHECK-NEXT:   %.splat = shufflevector <2 x double> %.splatinsert, <2 x double> poison, <2 x i32> zeroinitializer
+; CHECK-NEXT:   %unwrap.x0 = extractvalue [2 x double*] %x, 0
+; CHECK-NEXT:   %unwrap.x1 = extractvalue [2 x double*] %x, 1
+; CHECK-NEXT:   %[[x0i:.+]] = ptrtoint double* %unwrap.x0 to i64
+; CHECK-NEXT:   %[[x1i:.+]] = ptrtoint double* %unwrap.x1 to i64
+; CHECK-NEXT:   %[[xd:.+]] = sub i64 %[[x1i]], %[[x0i]]
+; CHECK-NEXT:   %[[xeq:.+]] = icmp eq i64 %[[xd]], 8
+; CHECK-NEXT:   %consecutive = freeze i1 %[[xeq]]
+; CHECK-NEXT:   %[[xp0:.+]] = insertelement <2 x double*> undef, double* %unwrap.x0, i64 0
+; CHECK-NEXT:   %[[xps:.+]] = insertelement <2 x double*> %[[xp0]], double* %unwrap.x1, i64 1
+; CHECK-NEXT:   %unwrap.y0 = extractvalue [2 x double*] %y, 0
+; CHECK-NEXT:   %unwrap.y1 = extractvalue [2 x double*] %y, 1
+; CHECK-NEXT:   %[[y0i:.+]] = ptrtoint double* %unwrap.y0 to i64
+; CHECK-NEXT:   %[[y1i:.+]] = ptrtoint double* %unwrap.y1 to i64
+; CHECK-NEXT:   %[[yd:.+]] = sub i64 %[[y1i]], %[[y0i]]
+; CHECK-NEXT:   %[[yeq:.+]] = icmp eq i64 %[[yd]], 8
+; CHECK-NEXT:   %consecutive1 = freeze i1 %[[yeq]]
+; CHECK-NEXT:   %[[yp0:.+]] = insertelement <2 x double*> undef, double* %unwrap.y0, i64 0
+; CHECK-NEXT:   %[[yps:.+]] = insertelement <2 x double*> %[[yp0]], double* %unwrap.y1, i64 1
+; CHECK-NEXT:   br i1 %consecutive, label %[[xvl:.+]], label %[[xgl:.+]]
+
+; CHECK: [[xvl]]:
+; CHECK-NEXT:   %[[xvp:.+]] = bitcast double* %unwrap.x0 to <2 x double>*
+; CHECK-NEXT:   %[[xvv:.+]] = load <2 x double>, <2 x double>* %[[xvp]], align 8
+; CHECK-NEXT:   br label %[[xj:.+]]
+
+; CHECK: [[xgl]]:
+; CHECK-NEXT:   %[[xgv:.+]] = call <2 x double> @llvm.masked.gather.v2f64.v2p0f64(<2 x double*> %[[xps]], i32 8, <2 x i1> <i1 true, i1 true>, <2 x double> undef)
+; CHECK-NEXT:   br label %[[xj]]
+
+; CHECK: [[xj]]:
+; CHECK-NEXT:   %xv.vec = phi <2 x double> [ %[[xvv]], %[[xvl]] ], [ %[[xgv]], %[[xgl]] ]
+; CHECK:   %r.vec = call <2 x double> @llvm.sqrt.v2f64(<2 x double> %xv.vec)
+; CHECK:   %m.vec = fmul <2 x double> %r.vec, %.splat
+; CHECK:   br i1 %consecutive1, label %[[yvl:.+]], label %[[ygl:.+]]
+
+; CHECK: [[yvl]]:
+; CHECK-NEXT:   %[[yvp:.+]] = bitcast double* %unwrap.y0 to <2 x double>*
+; CHECK-NEXT:   %[[yvv:.+]] = load <2 x double>, <2 x double>* %[[yvp]], align 8
+; CHECK-NEXT:   br label %[[yj:.+]]
+
+; CHECK: [[ygl]]:
+; CHECK-NEXT:   %[[ygv:.+]] = call <2 x double> @llvm.masked.gather.v2f64.v2p0f64(<2 x double*> %[[yps]], i32 8, <2 x i1> <i1 true, i1 true>, <2 x double> undef)
+; CHECK-NEXT:   br label %[[yj]]
+
+; CHECK: [[yj]]:
+; CHECK-NEXT:   %yv.vec = phi <2 x double> [ %[[yvv]], %[[yvl]] ], [ %[[ygv]], %[[ygl]] ]
+; CHECK:   %s.vec = fadd <2 x double> %m.vec, %yv.vec
+; CHECK:   br i1 %consecutive1, label %[[svl:.+]], label %[[sgl:.+]]
+
+; CHECK: [[svl]]:
+; CHECK-NEXT:   %[[svp:.+]] = bitcast double* %unwrap.y0 to <2 x double>*
+; CHECK-NEXT:   store <2 x double> %s.vec, <2 x double>* %[[svp]], align 8
+; CHECK-NEXT:   br label %[[sj:.+]]
+
+; CHECK: [[sgl]]:
+; CHECK-NEXT:   call void @llvm.masked.scatter.v2f64.v2p0f64(<2 x double> %s.vec, <2 x double*> %[[yps]], i32 8, <2 x i1> <i1 true, i1 true>)
+; CHECK-NEXT:   br label %[[sj]]
+
+; CHECK: [[sj]]:
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -22,5 +22,40 @@ entry:
 
 declare [4 x double] @__enzyme_batch(...)
 
-; XFAIL: *
-; CHECK:  branch conditions have to be scalar values
+; CHECK: define internal [4 x double] @batch_relu([4 x double] %x, double %a)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %unwrap.x0 = extractvalue [4 x double] %x, 0
+; CHECK-NEXT:   %unwrap.x1 = extractvalue [4 x double] %x, 1
+; CHECK-NEXT:   %unwrap.x2 = extractvalue [4 x double] %x, 2
+; CHECK-NEXT:   %unwrap.x3 = extractvalue [4 x double] %x, 3
+; CHECK-NEXT:   %cmp0 = fcmp fast ogt double %unwrap.x0, 0.000000e+00
+; CHECK-NEXT:   %cmp1 = fcmp fast ogt double %unwrap.x1, 0.000000e+00
+; CHECK-NEXT:   %cmp2 = fcmp fast ogt double %unwrap.x2, 0.000000e+00
+; CHECK-NEXT:   %cmp3 = fcmp fast ogt double %unwrap.x3, 0.000000e+00
+; CHECK-NEXT:   %0 = xor i1 %cmp0, true
+; CHECK-NEXT:   %1 = xor i1 %cmp1, true
+; CHECK-NEXT:   %2 = xor i1 %cmp2, true
+; CHECK-NEXT:   %3 = xor i1 %cmp3, true
+; CHECK-NEXT:   br label %cond.true
+
+; CHECK: cond.true:
+; CHECK-NEXT:   %ax0 = fmul double %unwrap.x0, %a
+; CHECK-NEXT:   %ax1 = fmul double %unwrap.x1, %a
+; CHECK-NEXT:   %ax2 = fmul double %unwrap.x2, %a
+; CHECK-NEXT:   %ax3 = fmul double %unwrap.x3, %a
+; CHECK-NEXT:   br label %cond.end
+
+; CHECK: cond.end:
+; CHECK-NEXT:   br label %linearized.end
+
+; CHECK: linearized.end:
+; CHECK-NEXT:   %4 = select i1 %0, double %unwrap.x0, double %ax0
+; CHECK-NEXT:   %5 = select i1 %1, double %unwrap.x1, double %ax1
+; CHECK-NEXT:   %6 = select i1 %2, double %unwrap.x2, double %ax2
+; CHECK-NEXT:   %7 = select i1 %3, double %unwrap.x3, double %ax3
+; CHECK-NEXT:   %mrv = insertvalue [4 x double] {{(undef|poison)?}}, double %4, 0
+; CHECK-NEXT:   %mrv1 = insertvalue [4 x double] %mrv, double %5, 1
+; CHECK-NEXT:   %mrv2 = insertvalue [4 x double] %mrv1, double %6, 2
+; CHECK-NEXT:   %mrv3 = insertvalue [4 x double] %mrv2, double %7, 3
+; CHECK-NEXT:   ret [4 x double] %mrv3
+; CHECK-NEXT: }
@@ -35,10 +35,10 @@ entry:
 ; CHECK-NEXT:   %mul2 = fmul double %unwrap.x2, %unwrap.x2
 ; CHECK-NEXT:   %mul3 = fmul double %unwrap.x3, %unwrap.x3
 ; CHECK-NEXT:   %0 = insertvalue [4 x double] undef, double %mul0, 0
-; CHECK-NEXT:   %1 = insertvalue [4 x double] undef, double %mul1, 1
-; CHECK-NEXT:   %2 = insertvalue [4 x double] undef, double %mul2, 2
-; CHECK-NEXT:   %3 = insertvalue [4 x double] undef, double %mul3, 3
-; CHECK-NEXT:   %call = call [4 x double] @batch_add3([4 x double] undef, double %a)
+; CHECK-NEXT:   %1 = insertvalue [4 x double] %0, double %mul1, 1
+; CHECK-NEXT:   %2 = insertvalue [4 x double] %1, double %mul2, 2
+; CHECK-NEXT:   %3 = insertvalue [4 x double] %2, double %mul3, 3
+; CHECK-NEXT:   %call = call [4 x double] @batch_add3([4 x double] %3, double %a)
 ; CHECK-NEXT:   %unwrap.call0 = extractvalue [4 x double] %call, 0
 ; CHECK-NEXT:   %unwrap.call1 = extractvalue [4 x double] %call, 1
 ; CHECK-NEXT:   %unwrap.call2 = extractvalue [4 x double] %call, 2
@@ -0,0 +1,30 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define <4 x double> @f(<4 x double> %x, <4 x double> %y, <4 x double> %m) {
+entry:
+  %mx = call <4 x double> @llvm.x86.avx.max.pd.256(<4 x double> %x, <4 x double> %y)
+  %mn = call <4 x double> @llvm.x86.avx.min.pd.256(<4 x double> %x, <4 x double> %y)
+  %bl = call <4 x double> @llvm.x86.avx.blendv.pd.256(<4 x double> %mx, <4 x double> %mn, <4 x double> %m)
+  ret <4 x double> %bl
+}
+declare <4 x double> @llvm.x86.avx.max.pd.256(<4 x double>, <4 x double>)
+declare <4 x double> @llvm.x86.avx.min.pd.256(<4 x double>, <4 x double>)
+declare <4 x double> @llvm.x86.avx.blendv.pd.256(<4 x double>, <4 x double>, <4 x double>)
+define <4 x double> @test(<4 x double> %x, <4 x double> %dx, <4 x double> %y, <4 x double> %dy, <4 x double> %m) {
+entry:
+  %0 = call <4 x double> (...) @__enzyme_fwddiff(<4 x double> (<4 x double>, <4 x double>, <4 x double>)* @f, <4 x double> %x, <4 x double> %dx, <4 x double> %y, <4 x double> %dy, metadata !"enzyme_const", <4 x double> %m)
+  ret <4 x double> %0
+}
+declare <4 x double> @__enzyme_fwddiff(...)
+
+; CHECK: define internal <4 x double> @fwddiffef(<4 x double> %x, <4 x double> %"x'", <4 x double> %y, <4 x double> %"y'", <4 x double> %m)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = fcmp fast ogt <4 x double> %x, %y
+; CHECK-NEXT:   %1 = select fast <4 x i1> %0, <4 x double> %"x'", <4 x double> %"y'"
+; CHECK-NEXT:   %2 = fcmp fast olt <4 x double> %x, %y
+; CHECK-NEXT:   %3 = select fast <4 x i1> %2, <4 x double> %"x'", <4 x double> %"y'"
+; CHECK-NEXT:   %4 = bitcast <4 x double> %m to <4 x i64>
+; CHECK-NEXT:   %5 = icmp sge <4 x i64> %4, zeroinitializer
+; CHECK-NEXT:   %6 = select fast <4 x i1> %5, <4 x double> %1, <4 x double> %3
+; CHECK-NEXT:   ret <4 x double> %6
+; CHECK-NEXT: }
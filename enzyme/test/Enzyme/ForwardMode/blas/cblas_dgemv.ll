@@ -0,0 +1,59 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_fwddiff(...)
+
+declare void @cblas_dgemv(i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)
+
+define void @f(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* noalias %A, i32 %lda, double* noalias %x, i32 %incx, double %beta, double* noalias %y, i32 %incy) {
+entry:
+  call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* %A, i32 %lda, double* %x, i32 %incx, double %beta, double* %y, i32 %incy)
+  ret void
+}
+
+define void @active(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* %A, double* %dA, i32 %lda, double* %x, double* %dx, i32 %incx, double %beta, double* %y, double* %dy, i32 %incy) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @f, i32 %layout, i32 %trans, i32 %m, i32 %n, metadata !"enzyme_const", double %alpha, double* %A, double* %dA, i32 %lda, double* %x, double* %dx, i32 %incx, metadata !"enzyme_const", double %beta, double* %y, double* %dy, i32 %incy)
+  ret void
+}
+
+define void @inactiveA(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* %A, i32 %lda, double* %x, double* %dx, i32 %incx, double %beta, double* %y, double* %dy, i32 %incy) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @f, i32 %layout, i32 %trans, i32 %m, i32 %n, metadata !"enzyme_const", double %alpha, metadata !"enzyme_const", double* %A, i32 %lda, double* %x, double* %dx, i32 %incx, metadata !"enzyme_const", double %beta, double* %y, double* %dy, i32 %incy)
+  ret void
+}
+
+define void @vec(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* %A, double* %dA1, double* %dA2, i32 %lda, double* %x, i32 %incx, double %beta, double* %y, double* %dy1, double* %dy2, i32 %incy) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @f, metadata !"enzyme_width", i64 2, i32 %layout, i32 %trans, i32 %m, i32 %n, metadata !"enzyme_const", double %alpha, double* %A, double* %dA1, double* %dA2, i32 %lda, metadata !"enzyme_const", double* %x, i32 %incx, metadata !"enzyme_const", double %beta, double* %y, double* %dy1, double* %dy2, i32 %incy)
+  ret void
+}
+
+; CHECK: define internal void @fwddiffef(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* noalias %A, double* %"A'", i32 %lda, double* noalias %x, double* %"x'", i32 %incx, double %beta, double* noalias %y, double* %"y'", i32 %incy)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %"A'", i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %"y'", i32 %incy)
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %"x'", i32 %incx, double 1.000000e+00, double* nocapture %"y'", i32 %incy)
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %y, i32 %incy)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffef.1(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* noalias %A, i32 %lda, double* noalias %x, double* %"x'", i32 %incx, double %beta, double* noalias %y, double* %"y'", i32 %incy)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %"x'", i32 %incx, double %beta, double* nocapture %"y'", i32 %incy)
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %y, i32 %incy)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffe2f(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* noalias %A, [2 x double*] %"A'", i32 %lda, double* noalias %x, i32 %incx, double %beta, double* noalias %y, [2 x double*] %"y'", i32 %incy)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = extractvalue [2 x double*] %"A'", 0
+; CHECK-NEXT:   %1 = extractvalue [2 x double*] %"y'", 0
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %0, i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %1, i32 %incy)
+; CHECK-NEXT:   %2 = extractvalue [2 x double*] %"A'", 1
+; CHECK-NEXT:   %3 = extractvalue [2 x double*] %"y'", 1
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %2, i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %3, i32 %incy)
+; CHECK-NEXT:   call void @cblas_dgemv(i32 %layout, i32 %trans, i32 %m, i32 %n, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %x, i32 %incx, double %beta, double* nocapture %y, i32 %incy)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
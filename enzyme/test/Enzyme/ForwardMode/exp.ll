@@ -22,7 +22,7 @@ declare double @__enzyme_fwddiff(double (double)*, ...)
 
 ; CHECK: define internal double @fwddiffetester(double %x, double %"x'")
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @llvm.exp.f64(double %x)
+; CHECK-NEXT:   %0 = tail call fast double @llvm.exp.f64(double %x)
 ; CHECK-NEXT:   %1 = fmul fast double %"x'", %0
 ; CHECK-NEXT:   ret double %1
 ; CHECK-NEXT: }
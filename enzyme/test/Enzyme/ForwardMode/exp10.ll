@@ -21,7 +21,7 @@ declare double @__enzyme_fwddiff(double (double)*, ...)
 
 ; CHECK: define internal double @fwddiffetester(double %x, double %"x'")
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @exp10(double %x)
+; CHECK-NEXT:   %0 = tail call double @exp10(double %x)
 ; CHECK-NEXT:   %1 = fmul fast double %"x'", %0
 ; CHECK-NEXT:   %2 = fmul fast double %1, 0x40026BB1BBB55516
 ; CHECK-NEXT:   ret double %2
@@ -22,7 +22,7 @@ declare double @__enzyme_fwddiff(double (double)*, ...)
 
 ; CHECK: define internal double @fwddiffetester(double %x, double %"x'")
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @llvm.exp2.f64(double %x)
+; CHECK-NEXT:   %0 = tail call fast double @llvm.exp2.f64(double %x)
 ; CHECK-NEXT:   %1 = fmul fast double %"x'", %0
 ; CHECK-NEXT:   %2 = fmul fast double %1, 0x3FE62E42FEFA39EF
 ; CHECK-NEXT:   ret double %2
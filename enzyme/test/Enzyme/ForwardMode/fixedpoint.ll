@@ -0,0 +1,94 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+; out[i] = (in[i] + a[i] / in[i]) / 2, whose fixed point is sqrt(a[i])
+define void @babylon(double* %out, double* %in, double* %a, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %pin = getelementptr inbounds double, double* %in, i64 %i
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %pout = getelementptr inbounds double, double* %out, i64 %i
+  %vin = load double, double* %pin
+  %va = load double, double* %pa
+  %q = fdiv double %va, %vin
+  %s = fadd double %vin, %q
+  %h = fmul double %s, 5.000000e-01
+  store double %h, double* %pout
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; out[0] = (in[0] + c / in[0]) / 2
+define void @babylon1(double* %out, double* %in, double %c) {
+entry:
+  %vin = load double, double* %in
+  %q = fdiv double %c, %vin
+  %s = fadd double %vin, %q
+  %h = fmul double %s, 5.000000e-01
+  store double %h, double* %out
+  ret void
+}
+
+define double @f(double* noalias %x, double* noalias %a, i64 %n) {
+entry:
+  call void (...) @__enzyme_fixed_point(void (double*, double*, double*, i64)* @babylon, double* %x, i64 %n, double* %a, i64 %n)
+  %x0 = load double, double* %x
+  %p1 = getelementptr inbounds double, double* %x, i64 1
+  %x1 = load double, double* %p1
+  %r = fadd double %x0, %x1
+  store double 0.000000e+00, double* %x
+  ret double %r
+}
+
+define double @g(double* %x, double %c) {
+entry:
+  call void (...) @__enzyme_fixed_point(void (double*, double*, double)* @babylon1, double* %x, i32 1, double %c)
+  %x0 = load double, double* %x
+  ret double %x0
+}
+
+define double @fwdf(double* %x, double* %dx, double* %a, double* %da, i64 %n) {
+entry:
+  %0 = call double (...) @__enzyme_fwddiff(double (double*, double*, i64)* @f, double* %x, double* %dx, double* %a, double* %da, i64 %n)
+  ret double %0
+}
+
+define double @fwdg(double* %x, double* %dx, double %c, double %dc) {
+entry:
+  %0 = call double (...) @__enzyme_fwddiff(double (double*, double)* @g, double* %x, double* %dx, double %c, double %dc)
+  ret double %0
+}
+
+declare void @__enzyme_fixed_point(...)
+declare double @__enzyme_fwddiff(...)
+
+; CHECK: define internal double @fwddiffef(double* noalias %x, double* %"x'", double* noalias %a, double* %"a'", i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @__enzyme_fixed_point_babylon(double* %x, i64 %n, double* %a, i64 %n)
+; CHECK-NEXT:   call void @fwddiffebabylon_fixed_point(double* %x, double* %"x'", i64 %n, double* %a, i64 %n, double* %"a'")
+; CHECK-NEXT:   %"x0'ipl" = load double, double* %"x'", align 8
+; CHECK-NEXT:   %"p1'ipg" = getelementptr inbounds double, double* %"x'", i64 1
+; CHECK-NEXT:   %"x1'ipl" = load double, double* %"p1'ipg", align 8
+; CHECK-NEXT:   %0 = fadd fast double %"x0'ipl", %"x1'ipl"
+; CHECK-NEXT:   store double 0.000000e+00, double* %x, align 8
+; CHECK-NEXT:   store double 0.000000e+00, double* %"x'", align 8
+; CHECK-NEXT:   ret double %0
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffebabylon_fixed_point(double* %x, double* %dx, i64 %n, double* %0, i64 %1, double* %2)
+; CHECK: fp.iter:
+; CHECK:   call void @fwddiffebabylon(double* %{{.*}}, double* %{{.*}}, double* %x, double* %dx, double* %0, double* %2, i64 %1)
+
+; CHECK: define internal double @fwddiffeg(double* %x, double* %"x'", double %c, double %"c'")
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @__enzyme_fixed_point_babylon1(double* %x, i64 1, double %c)
+; CHECK-NEXT:   call void @fwddiffebabylon1_fixed_point(double* %x, double* %"x'", i64 1, double %c, double %"c'")
+; CHECK-NEXT:   %"x0'ipl" = load double, double* %"x'", align 8
+; CHECK-NEXT:   ret double %"x0'ipl"
+; CHECK-NEXT: }
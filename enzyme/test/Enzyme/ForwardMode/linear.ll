@@ -0,0 +1,79 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+; y = w * x elementwise, linear in x and y for a constant w
+define void @apply(double* %x, double* %y, double* %w, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %pw = getelementptr inbounds double, double* %w, i64 %i
+  %py = getelementptr inbounds double, double* %y, i64 %i
+  %vx = load double, double* %px
+  %vw = load double, double* %pw
+  %m = fmul double %vx, %vw
+  store double %m, double* %py
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; x' += w * y', y' = 0
+define void @apply_adjoint(double* %dx, double* %dy, double* %w, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %dx, i64 %i
+  %pw = getelementptr inbounds double, double* %w, i64 %i
+  %py = getelementptr inbounds double, double* %dy, i64 %i
+  %vy = load double, double* %py
+  %vw = load double, double* %pw
+  %m = fmul double %vy, %vw
+  %vx = load double, double* %px
+  %a = fadd double %vx, %m
+  store double %a, double* %px
+  store double 0.000000e+00, double* %py
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+@.param = private unnamed_addr constant [8 x i8] c"param_2\00"
+@__enzyme_register_linear_apply = global [3 x i8*] [i8* bitcast (void (double*, double*, double*, i64)* @apply to i8*), i8* bitcast (void (double*, double*, double*, i64)* @apply_adjoint to i8*), i8* getelementptr inbounds ([8 x i8], [8 x i8]* @.param, i32 0, i32 0)]
+
+define double @f(double* %x, double* %y, double* %w, i64 %n) {
+entry:
+  call void @apply(double* %x, double* %y, double* %w, i64 %n)
+  %v = load double, double* %y
+  %sq = fmul double %v, %v
+  ret double %sq
+}
+
+define double @fwdf(double* %x, double* %dx, double* %y, double* %dy, double* %w, i64 %n) {
+entry:
+  %0 = call double (...) @__enzyme_fwddiff(double (double*, double*, double*, i64)* @f, double* %x, double* %dx, double* %y, double* %dy, metadata !"enzyme_const", double* %w, i64 %n)
+  ret double %0
+}
+
+declare double @__enzyme_fwddiff(...)
+
+; CHECK: define internal double @fwddiffef(double* %x, double* %"x'", double* %y, double* %"y'", double* %w, i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @apply(double* %"x'", double* %"y'", double* %w, i64 %n)
+; CHECK-NEXT:   call void @apply(double* %x, double* %y, double* %w, i64 %n)
+; CHECK-NEXT:   %"v'ipl" = load double, double* %"y'", align 8
+; CHECK-NEXT:   %v = load double, double* %y, align 8
+; CHECK-NEXT:   %0 = fmul fast double %"v'ipl", %v
+; CHECK-NEXT:   %1 = fmul fast double %"v'ipl", %v
+; CHECK-NEXT:   %2 = fadd fast double %0, %1
+; CHECK-NEXT:   ret double %2
+; CHECK-NEXT: }
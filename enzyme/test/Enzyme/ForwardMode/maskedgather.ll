@@ -0,0 +1,33 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(double* %x, <4 x i64> %idx) {
+entry:
+  %ptrs = getelementptr inbounds double, double* %x, <4 x i64> %idx
+  %v = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+  %sq = fmul <4 x double> %v, %v
+  %r = call double @llvm.vector.reduce.fadd.v4f64(double -0.000000e+00, <4 x double> %sq)
+  ret double %r
+}
+
+define double @test_derivative(double* %x, double* %dx, <4 x i64> %idx) {
+entry:
+  %0 = call double (...) @__enzyme_fwddiff(double (double*, <4 x i64>)* @tester, double* %x, double* %dx, <4 x i64> %idx)
+  ret double %0
+}
+
+declare <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*>, i32, <4 x i1>, <4 x double>)
+declare double @llvm.vector.reduce.fadd.v4f64(double, <4 x double>)
+declare double @__enzyme_fwddiff(...)
+
+; CHECK: define internal double @fwddiffetester(double* %x, double* %"x'", <4 x i64> %idx)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"ptrs'ipg" = getelementptr inbounds double, double* %"x'", <4 x i64> %idx
+; CHECK-NEXT:   %ptrs = getelementptr inbounds double, double* %x, <4 x i64> %idx
+; CHECK-NEXT:   %0 = call fast <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %"ptrs'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %v = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %1 = fmul fast <4 x double> %0, %v
+; CHECK-NEXT:   %2 = fmul fast <4 x double> %0, %v
+; CHECK-NEXT:   %3 = fadd fast <4 x double> %1, %2
+; CHECK-NEXT:   %4 = call fast double @llvm.vector.reduce.fadd.v4f64(double 0.000000e+00, <4 x double> %3)
+; CHECK-NEXT:   ret double %4
+; CHECK-NEXT: }
@@ -0,0 +1,73 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -enzyme-matmul-idiom -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+; C[i][j] += sum_kk A[i][kk] * B[kk][j]
+define void @accum(double* noalias %A, double* noalias %B, double* noalias %C, i64 %m, i64 %n, i64 %k) {
+entry:
+  br label %for.i
+
+for.i:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.i.inc ]
+  %cmp.i = icmp slt i64 %i, %m
+  br i1 %cmp.i, label %for.j, label %exit
+
+for.j:
+  %j = phi i64 [ %j.next, %for.j.inc ], [ 0, %for.i ]
+  %cmp.j = icmp slt i64 %j, %n
+  br i1 %cmp.j, label %for.k, label %for.i.inc
+
+for.k:
+  %kk = phi i64 [ %kk.next, %for.k.body ], [ 0, %for.j ]
+  %cmp.k = icmp slt i64 %kk, %k
+  br i1 %cmp.k, label %for.k.body, label %for.j.inc
+
+for.k.body:
+  %ik0 = mul nsw i64 %i, %k
+  %ik = add nsw i64 %ik0, %kk
+  %a.ptr = getelementptr inbounds double, double* %A, i64 %ik
+  %a = load double, double* %a.ptr
+  %kn = mul nsw i64 %kk, %n
+  %kj = add nsw i64 %kn, %j
+  %b.ptr = getelementptr inbounds double, double* %B, i64 %kj
+  %b = load double, double* %b.ptr
+  %in = mul nsw i64 %i, %n
+  %ij = add nsw i64 %in, %j
+  %c.ptr = getelementptr inbounds double, double* %C, i64 %ij
+  %c = load double, double* %c.ptr
+  %mul = fmul double %a, %b
+  %add = fadd double %c, %mul
+  store double %add, double* %c.ptr
+  %kk.next = add nuw nsw i64 %kk, 1
+  br label %for.k
+
+for.j.inc:
+  %j.next = add nuw nsw i64 %j, 1
+  br label %for.j
+
+for.i.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  br label %for.i
+
+exit:
+  ret void
+}
+
+define void @dmatmul_fwd(double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %m, i64 %n, i64 %k) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (double*, double*, double*, i64, i64, i64)* @accum, double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %m, i64 %n, i64 %k)
+  ret void
+}
+
+declare void @__enzyme_fwddiff(...)
+
+; CHECK: define internal void @fwddiffeaccum(double* noalias %A, double* %"A'", double* noalias %B, double* %"B'", double* noalias %C, double* %"C'", i64 %m, i64 %n, i64 %k)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %smax = call i64 @llvm.smax.i64(i64 %m, i64 0)
+; CHECK-NEXT:   %smax5 = call i64 @llvm.smax.i64(i64 %n, i64 0)
+; CHECK-NEXT:   %smax6 = call i64 @llvm.smax.i64(i64 %k, i64 0)
+; CHECK-NEXT:   %0 = shl i64 %k, 3
+; CHECK-NEXT:   %1 = shl i64 %n, 3
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %smax5, i64 %smax6, double* %"A'", i64 %0, i64 8, double* %B, i64 %1, i64 8, double* %"C'", i64 %1, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %smax5, i64 %smax6, double* %A, i64 %0, i64 8, double* %"B'", i64 %1, i64 8, double* %"C'", i64 %1, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %smax5, i64 %smax6, double* %A, i64 %0, i64 8, double* %B, i64 %1, i64 8, double* %C, i64 %1, i64 8, i64 1)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
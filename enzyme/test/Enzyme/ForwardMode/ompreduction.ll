@@ -0,0 +1,215 @@
+; RUN: if [ %llvmver -ge 9 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+%struct.ident_t = type { i32, i32, i32, i32, i8* }
+
+@0 = private unnamed_addr constant [23 x i8] c";unknown;unknown;0;0;;\00", align 1
+@1 = private unnamed_addr constant %struct.ident_t { i32 0, i32 514, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@2 = private unnamed_addr constant %struct.ident_t { i32 0, i32 2, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@3 = private unnamed_addr constant %struct.ident_t { i32 0, i32 18, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@.gomp_critical_user_.reduction.var = common global [8 x i32] zeroinitializer, align 8
+
+define void @f(double* %x, double* %sum, i64 %n) {
+entry:
+  call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* nonnull @2, i32 2, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*)* @.omp_outlined. to void (i32*, i32*, ...)*), i64 %n, double* %x)
+  call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* nonnull @2, i32 3, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*)* @.omp_outlined..1 to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %sum)
+  ret void
+}
+
+define internal void @.omp_outlined.(i32* noalias nocapture readonly %.global_tid., i32* noalias nocapture readnone %.bound_tid., i64 %length, double* nocapture %tmp) {
+entry:
+  %.omp.lb = alloca i64, align 8
+  %.omp.ub = alloca i64, align 8
+  %.omp.stride = alloca i64, align 8
+  %.omp.is_last = alloca i32, align 4
+  %sub4 = add i64 %length, -1
+  %cmp.not = icmp eq i64 %length, 0
+  br i1 %cmp.not, label %omp.precond.end, label %omp.precond.then
+
+omp.precond.then:
+  store i64 0, i64* %.omp.lb, align 8
+  store i64 %sub4, i64* %.omp.ub, align 8
+  store i64 1, i64* %.omp.stride, align 8
+  store i32 0, i32* %.omp.is_last, align 4
+  %0 = load i32, i32* %.global_tid., align 4
+  call void @__kmpc_for_static_init_8u(%struct.ident_t* nonnull @1, i32 %0, i32 34, i32* nonnull %.omp.is_last, i64* nonnull %.omp.lb, i64* nonnull %.omp.ub, i64* nonnull %.omp.stride, i64 1, i64 1)
+  %1 = load i64, i64* %.omp.ub, align 8
+  %cmp6 = icmp ugt i64 %1, %sub4
+  %cond = select i1 %cmp6, i64 %sub4, i64 %1
+  store i64 %cond, i64* %.omp.ub, align 8
+  %2 = load i64, i64* %.omp.lb, align 8
+  %add29 = add i64 %cond, 1
+  %cmp730 = icmp ult i64 %2, %add29
+  br i1 %cmp730, label %omp.inner.for.body, label %omp.loop.exit
+
+omp.inner.for.body:
+  %.omp.iv.031 = phi i64 [ %add11, %omp.inner.for.body ], [ %2, %omp.precond.then ]
+  %arrayidx = getelementptr inbounds double, double* %tmp, i64 %.omp.iv.031
+  %3 = load double, double* %arrayidx, align 8
+  %call = call double @sqrt(double %3)
+  store double %call, double* %arrayidx, align 8
+  %add11 = add nuw i64 %.omp.iv.031, 1
+  %4 = load i64, i64* %.omp.ub, align 8
+  %add = add i64 %4, 1
+  %cmp7 = icmp ult i64 %add11, %add
+  br i1 %cmp7, label %omp.inner.for.body, label %omp.loop.exit
+
+omp.loop.exit:
+  call void @__kmpc_for_static_fini(%struct.ident_t* nonnull @1, i32 %0)
+  br label %omp.precond.end
+
+omp.precond.end:
+  ret void
+}
+
+define internal void @.omp_outlined..1(i32* noalias nocapture readonly %.global_tid., i32* noalias nocapture readnone %.bound_tid., i64 %length, double* nocapture readonly %x, double* nocapture %sum) {
+entry:
+  %sum.priv = alloca double, align 8
+  %.omp.lb = alloca i64, align 8
+  %.omp.ub = alloca i64, align 8
+  %.omp.stride = alloca i64, align 8
+  %.omp.is_last = alloca i32, align 4
+  %.omp.reduction.red_list = alloca [1 x i8*], align 8
+  store double 0.000000e+00, double* %sum.priv, align 8
+  %cmp.not = icmp eq i64 %length, 0
+  br i1 %cmp.not, label %omp.precond.end, label %omp.precond.then
+
+omp.precond.then:
+  %sub = add i64 %length, -1
+  store i64 0, i64* %.omp.lb, align 8
+  store i64 %sub, i64* %.omp.ub, align 8
+  store i64 1, i64* %.omp.stride, align 8
+  store i32 0, i32* %.omp.is_last, align 4
+  %0 = load i32, i32* %.global_tid., align 4
+  call void @__kmpc_dispatch_init_8u(%struct.ident_t* nonnull @1, i32 %0, i32 35, i64 0, i64 %sub, i64 1, i64 4)
+  br label %omp.dispatch.cond
+
+omp.dispatch.cond:
+  %1 = call i32 @__kmpc_dispatch_next_8u(%struct.ident_t* nonnull @1, i32 %0, i32* nonnull %.omp.is_last, i64* nonnull %.omp.lb, i64* nonnull %.omp.ub, i64* nonnull %.omp.stride)
+  %tobool.not = icmp eq i32 %1, 0
+  br i1 %tobool.not, label %omp.dispatch.end, label %omp.dispatch.body
+
+omp.dispatch.body:
+  %2 = load i64, i64* %.omp.lb, align 8
+  %3 = load i64, i64* %.omp.ub, align 8
+  br label %omp.inner.for.body
+
+omp.inner.for.body:
+  %iv = phi i64 [ %2, %omp.dispatch.body ], [ %iv.next, %omp.inner.for.body ]
+  %arrayidx = getelementptr inbounds double, double* %x, i64 %iv
+  %4 = load double, double* %arrayidx, align 8
+  %mul = fmul double %4, %4
+  %5 = load double, double* %sum.priv, align 8
+  %add = fadd double %5, %mul
+  store double %add, double* %sum.priv, align 8
+  %iv.next = add nuw i64 %iv, 1
+  %cmp = icmp ugt i64 %iv.next, %3
+  br i1 %cmp, label %omp.dispatch.cond, label %omp.inner.for.body
+
+omp.dispatch.end:
+  %6 = getelementptr inbounds [1 x i8*], [1 x i8*]* %.omp.reduction.red_list, i64 0, i64 0
+  %7 = bitcast double* %sum.priv to i8*
+  store i8* %7, i8** %6, align 8
+  %8 = bitcast [1 x i8*]* %.omp.reduction.red_list to i8*
+  %9 = call i32 @__kmpc_reduce_nowait(%struct.ident_t* nonnull @3, i32 %0, i32 1, i64 8, i8* nonnull %8, void (i8*, i8*)* nonnull @.omp.reduction.reduction_func, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+  switch i32 %9, label %omp.precond.end [
+    i32 1, label %.omp.reduction.case1
+    i32 2, label %.omp.reduction.case2
+  ]
+
+.omp.reduction.case1:
+  %10 = load double, double* %sum, align 8
+  %11 = load double, double* %sum.priv, align 8
+  %add7 = fadd double %10, %11
+  store double %add7, double* %sum, align 8
+  call void @__kmpc_end_reduce_nowait(%struct.ident_t* nonnull @3, i32 %0, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+  br label %omp.precond.end
+
+.omp.reduction.case2:
+  %12 = load double, double* %sum.priv, align 8
+  %13 = atomicrmw fadd double* %sum, double %12 monotonic, align 8
+  br label %omp.precond.end
+
+omp.precond.end:
+  ret void
+}
+
+define internal void @.omp.reduction.reduction_func(i8* %0, i8* %1) {
+entry:
+  %2 = bitcast i8* %0 to [1 x i8*]*
+  %3 = bitcast i8* %1 to [1 x i8*]*
+  %4 = getelementptr inbounds [1 x i8*], [1 x i8*]* %3, i64 0, i64 0
+  %5 = load i8*, i8** %4, align 8
+  %6 = bitcast i8* %5 to double*
+  %7 = getelementptr inbounds [1 x i8*], [1 x i8*]* %2, i64 0, i64 0
+  %8 = load i8*, i8** %7, align 8
+  %9 = bitcast i8* %8 to double*
+  %10 = load double, double* %9, align 8
+  %11 = load double, double* %6, align 8
+  %add = fadd double %10, %11
+  store double %add, double* %9, align 8
+  ret void
+}
+
+define void @df(double* %x, double* %dx, double* %sum, double* %dsum, i64 %n) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (double*, double*, i64)* @f, double* %x, double* %dx, double* %sum, double* %dsum, i64 %n)
+  ret void
+}
+
+
+declare void @__enzyme_fwddiff(...)
+declare double @sqrt(double)
+declare void @__kmpc_for_static_init_8u(%struct.ident_t*, i32, i32, i32*, i64*, i64*, i64*, i64, i64)
+declare void @__kmpc_for_static_fini(%struct.ident_t*, i32)
+declare void @__kmpc_dispatch_init_8u(%struct.ident_t*, i32, i32, i64, i64, i64, i64)
+declare i32 @__kmpc_dispatch_next_8u(%struct.ident_t*, i32, i32*, i64*, i64*, i64*)
+declare i32 @__kmpc_reduce_nowait(%struct.ident_t*, i32, i32, i64, i8*, void (i8*, i8*)*, [8 x i32]*)
+declare void @__kmpc_end_reduce_nowait(%struct.ident_t*, i32, [8 x i32]*)
+declare !callback !0 void @__kmpc_fork_call(%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...)
+
+!0 = !{!1}
+!1 = !{i64 2, i64 -1, i64 -1, i1 true}
+
+; CHECK: define internal void @fwddiffef(double* %x, double* %"x'", double* %sum, double* %"sum'", i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @2, i32 3, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*)* @fwddiffe.omp_outlined. to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %"x'")
+; CHECK-NEXT:   call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @2, i32 5, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, double*, double*)* @fwddiffe.omp_outlined..1 to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %"x'", double* %sum, double* %"sum'")
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffe.omp_outlined.(
+; CHECK:   call void @__kmpc_for_static_init_8u(
+; CHECK:   call void @__kmpc_for_static_fini(
+
+; CHECK: define internal void @fwddiffe.omp_outlined..1(i32* noalias nocapture readonly %.global_tid., i32* noalias nocapture readnone %.bound_tid., i64 %length, double* nocapture readonly %x, double* nocapture %"x'", double* nocapture %sum, double* nocapture %"sum'")
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %[[ext:.+]] = alloca [2 x i8*]
+; CHECK:   call void @__kmpc_dispatch_init_8u(
+; CHECK:   call i32 @__kmpc_dispatch_next_8u(
+; CHECK: omp.dispatch.end:
+; CHECK:   %[[pl:.+]] = load i8*, i8** %{{.*}}
+; CHECK-NEXT:   %[[p0:.+]] = getelementptr inbounds [2 x i8*], [2 x i8*]* %[[ext]], i32 0, i32 0
+; CHECK-NEXT:   store i8* %[[pl]], i8** %[[p0]]
+; CHECK-NEXT:   %[[sl:.+]] = bitcast i8* %"'ipc9" to i8**
+; CHECK-NEXT:   %[[dl:.+]] = load i8*, i8** %[[sl]]
+; CHECK-NEXT:   %[[p1:.+]] = getelementptr inbounds [2 x i8*], [2 x i8*]* %[[ext]], i32 0, i32 1
+; CHECK-NEXT:   store i8* %[[dl]], i8** %[[p1]]
+; CHECK-NEXT:   %[[el:.+]] = bitcast [2 x i8*]* %[[ext]] to i8*
+; CHECK-NEXT:   %[[res:.+]] = call i32 @__kmpc_reduce_nowait(%struct.ident_t* nonnull @3, i32 %{{.*}}, i32 2, i64 16, i8* nonnull %[[el]], void (i8*, i8*)* nonnull @fwddiffe.omp.reduction.reduction_func_omp, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+; CHECK: .omp.reduction.case1:
+; CHECK:   store double %{{.*}}, double* %"sum'"
+; CHECK-NEXT:   call void @__kmpc_end_reduce_nowait(
+; CHECK: .omp.reduction.case2:
+; CHECK:   atomicrmw fadd double* %"sum'", double %"'ipl12" monotonic
+
+; CHECK: define internal void @fwddiffe.omp.reduction.reduction_func_omp(i8* %0, i8* %1)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %2 = bitcast i8* %0 to i8**
+; CHECK-NEXT:   %3 = getelementptr inbounds i8*, i8** %2, i64 1
+; CHECK-NEXT:   %4 = bitcast i8** %3 to i8*
+; CHECK-NEXT:   %5 = bitcast i8* %1 to i8**
+; CHECK-NEXT:   %6 = getelementptr inbounds i8*, i8** %5, i64 1
+; CHECK-NEXT:   %7 = bitcast i8** %6 to i8*
+; CHECK-NEXT:   call void @fwddiffe.omp.reduction.reduction_func(i8* %0, i8* %4, i8* %1, i8* %7)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
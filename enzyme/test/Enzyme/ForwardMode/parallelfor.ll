@@ -0,0 +1,61 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.S = type { double*, double* }
+
+@__enzyme_register_parallel_for = global [1 x i8*] [i8* bitcast (void (i32, i32, void (i32, %struct.S*)*, %struct.S*)* @parallel_for to i8*)]
+
+declare void @parallel_for(i32, i32, void (i32, %struct.S*)*, %struct.S*)
+
+define internal void @body(i32 %i, %struct.S* %s) {
+entry:
+  %xp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 0
+  %x = load double*, double** %xp, align 8
+  %yp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 1
+  %y = load double*, double** %yp, align 8
+  %idx = sext i32 %i to i64
+  %xi.p = getelementptr inbounds double, double* %x, i64 %idx
+  %xi = load double, double* %xi.p, align 8
+  %sq = fmul double %xi, %xi
+  %yi.p = getelementptr inbounds double, double* %y, i64 %idx
+  store double %sq, double* %yi.p, align 8
+  ret void
+}
+
+define void @f(double* %x, double* %y, i32 %n) {
+entry:
+  %s = alloca %struct.S, align 8
+  %xp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 0
+  store double* %x, double** %xp, align 8
+  %yp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 1
+  store double* %y, double** %yp, align 8
+  call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @body, %struct.S* %s)
+  ret void
+}
+
+
+define void @fwdf(double* %x, double* %dx, double* %y, double* %dy, i32 %n) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (double*, double*, i32)* @f, double* %x, double* %dx, double* %y, double* %dy, i32 %n)
+  ret void
+}
+
+declare void @__enzyme_fwddiff(...)
+
+; CHECK: define internal void @fwddiffef(double* %x, double* %"x'", double* %y, double* %"y'", i32 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = alloca { %struct.S*, %struct.S* }
+; CHECK-NEXT:   %"s'ipa" = alloca %struct.S
+; CHECK:        %1 = getelementptr inbounds { %struct.S*, %struct.S* }, { %struct.S*, %struct.S* }* %0, i32 0, i32 0
+; CHECK-NEXT:   store %struct.S* %s, %struct.S** %1
+; CHECK-NEXT:   %2 = getelementptr inbounds { %struct.S*, %struct.S* }, { %struct.S*, %struct.S* }* %0, i32 0, i32 1
+; CHECK-NEXT:   store %struct.S* %"s'ipa", %struct.S** %2
+; CHECK-NEXT:   %3 = bitcast { %struct.S*, %struct.S* }* %0 to %struct.S*
+; CHECK-NEXT:   call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @fwddiffebody_parallel, %struct.S* %3)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffebody_parallel(i32 %0, %struct.S* %1)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %pack = bitcast %struct.S* %1 to { %struct.S*, %struct.S* }*
+; CHECK:        call void @fwddiffebody(i32 %0, %struct.S* %{{.*}}, %struct.S* %{{.*}})
+; CHECK-NEXT:   ret void
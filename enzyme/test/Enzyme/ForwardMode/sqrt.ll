@@ -22,10 +22,10 @@ declare double @__enzyme_fwddiff(double (double)*, ...)
 
 ; CHECK: define internal double @fwddiffetester(double %x, double %"x'")
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @llvm.sqrt.f64(double %x)
+; CHECK-NEXT:   %0 = tail call fast double @llvm.sqrt.f64(double %x)
 ; CHECK-NEXT:   %1 = fmul fast double 5.000000e-01, %"x'"
 ; CHECK-NEXT:   %2 = fdiv fast double %1, %0
-; CHECK-NEXT:   %3 = fcmp fast oeq double %x, 0.000000e+00
+; CHECK-NEXT:   %3 = fcmp fast oeq double %0, 0.000000e+00
 ; CHECK-NEXT:   %4 = select{{( fast)?}} i1 %3, double 0.000000e+00, double %2
 ; CHECK-NEXT:   ret double %4
 ; CHECK-NEXT: }
@@ -0,0 +1,62 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define double @square(double %x) {
+entry:
+  %m = fmul double %x, %x
+  %s = call double @llvm.sin.f64(double %m)
+  ret double %s
+}
+
+declare double @llvm.sin.f64(double)
+
+declare double @__enzyme_taylor(...)
+
+define double @test(double* %out, double %x, double %x1, double %x2) {
+entry:
+  %r = call double (...) @__enzyme_taylor(double (double)* @square, i32 2, double* %out, double %x, double %x1, double %x2)
+  ret double %r
+}
+
+; CHECK: define double @test(double* %out, double %x, double %x1, double %x2)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = insertvalue [2 x double] undef, double %x1, 0
+; CHECK-NEXT:   %1 = insertvalue [2 x double] %0, double %x2, 1
+; CHECK-NEXT:   %2 = call [3 x double] @taylor2square(double %x, [2 x double] %1)
+; CHECK-NEXT:   %3 = extractvalue [3 x double] %2, 0
+; CHECK-NEXT:   store double %3, double* %out, align 8
+; CHECK-NEXT:   %4 = extractvalue [3 x double] %2, 1
+; CHECK-NEXT:   %5 = getelementptr inbounds double, double* %out, i64 1
+; CHECK-NEXT:   store double %4, double* %5, align 8
+; CHECK-NEXT:   %6 = extractvalue [3 x double] %2, 2
+; CHECK-NEXT:   %7 = getelementptr inbounds double, double* %out, i64 2
+; CHECK-NEXT:   store double %6, double* %7, align 8
+; CHECK-NEXT:   ret double %3
+; CHECK-NEXT: }
+
+; CHECK: define internal [3 x double] @taylor2square(double %x, [2 x double] %"x't")
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"x't1" = extractvalue [2 x double] %"x't", 0
+; CHECK-NEXT:   %"x't2" = extractvalue [2 x double] %"x't", 1
+; CHECK-NEXT:   %m = fmul double %x, %x
+; CHECK-NEXT:   %0 = fmul double %x, %"x't1"
+; CHECK-NEXT:   %1 = fmul double %"x't1", %x
+; CHECK-NEXT:   %2 = fadd double %0, %1
+; CHECK-NEXT:   %3 = fmul double %x, %"x't2"
+; CHECK-NEXT:   %4 = fmul double %"x't1", %"x't1"
+; CHECK-NEXT:   %5 = fadd double %3, %4
+; CHECK-NEXT:   %6 = fmul double %"x't2", %x
+; CHECK-NEXT:   %7 = fadd double %5, %6
+; CHECK-NEXT:   %s = call double @llvm.sin.f64(double %m)
+; CHECK-NEXT:   %8 = call double @llvm.cos.f64(double %m)
+; CHECK-NEXT:   %9 = fmul double %2, %8
+; CHECK-NEXT:   %10 = fmul double %2, %s
+; CHECK-NEXT:   %11 = fmul double %10, -1.000000e+00
+; CHECK-NEXT:   %12 = fmul double %2, %11
+; CHECK-NEXT:   %13 = fmul double %12, 5.000000e-01
+; CHECK-NEXT:   %14 = fmul double %7, %8
+; CHECK-NEXT:   %15 = fadd double %13, %14
+; CHECK-NEXT:   %mrv = insertvalue [3 x double] undef, double %s, 0
+; CHECK-NEXT:   %mrv1 = insertvalue [3 x double] %mrv, double %9, 1
+; CHECK-NEXT:   %mrv2 = insertvalue [3 x double] %mrv1, double %15, 2
+; CHECK-NEXT:   ret [3 x double] %mrv2
+; CHECK-NEXT: }
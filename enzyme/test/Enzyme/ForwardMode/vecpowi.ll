@@ -0,0 +1,31 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define <2 x double> @tester(<2 x double> %x, i32 %y) {
+entry:
+  %0 = tail call fast <2 x double> @llvm.powi.v2f64.i32(<2 x double> %x, i32 %y)
+  ret <2 x double> %0
+}
+
+define <2 x double> @test_derivative(<2 x double> %x, <2 x double> %dx, i32 %y) {
+entry:
+  %0 = tail call <2 x double> (<2 x double> (<2 x double>, i32)*, ...) @__enzyme_fwddiff(<2 x double> (<2 x double>, i32)* nonnull @tester, <2 x double> %x, <2 x double> %dx, i32 %y)
+  ret <2 x double> %0
+}
+
+declare <2 x double> @llvm.powi.v2f64.i32(<2 x double>, i32)
+
+declare <2 x double> @__enzyme_fwddiff(<2 x double> (<2 x double>, i32)*, ...)
+
+; CHECK: define internal {{(dso_local )?}}<2 x double> @fwddiffetester(<2 x double> %x, <2 x double> %"x'", i32 %y)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = sub i32 %y, 1
+; CHECK-NEXT:   %1 = call fast <2 x double> @llvm.powi.v2f64{{(\.i32)?}}(<2 x double> %x, i32 %0)
+; CHECK-NEXT:   %2 = sitofp i32 %y to double
+; CHECK-NEXT:   %.splatinsert = insertelement <2 x double> {{(poison|undef)}}, double %2, i32 0
+; CHECK-NEXT:   %.splat = shufflevector <2 x double> %.splatinsert, <2 x double> {{(poison|undef)}}, <2 x i32> zeroinitializer
+; CHECK-NEXT:   %3 = icmp eq i32 0, %y
+; CHECK-NEXT:   %4 = fmul fast <2 x double> %"x'", %1
+; CHECK-NEXT:   %5 = fmul fast <2 x double> %4, %.splat
+; CHECK-NEXT:   %6 = select {{(fast )?}}i1 %3, <2 x double> zeroinitializer, <2 x double> %5
+; CHECK-NEXT:   ret <2 x double> %6
+; CHECK-NEXT: }
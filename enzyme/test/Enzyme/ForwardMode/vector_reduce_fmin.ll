@@ -0,0 +1,37 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(<4 x double> %v) {
+entry:
+  %r = call double @llvm.vector.reduce.fmin.v4f64(<4 x double> %v)
+  ret double %r
+}
+
+define double @test_derivative(<4 x double> %v, <4 x double> %dv) {
+entry:
+  %0 = call double (...) @__enzyme_fwddiff(double (<4 x double>)* @tester, <4 x double> %v, <4 x double> %dv)
+  ret double %0
+}
+
+declare double @llvm.vector.reduce.fmin.v4f64(<4 x double>)
+declare double @__enzyme_fwddiff(...)
+
+; CHECK: define internal double @fwddiffetester(<4 x double> %v, <4 x double> %"v'")
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = call fast double @llvm.vector.reduce.fmin.v4f64(<4 x double> %v)
+; CHECK-NEXT:   %.splatinsert = insertelement <4 x double> poison, double %0, i32 0
+; CHECK-NEXT:   %.splat = shufflevector <4 x double> %.splatinsert, <4 x double> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %1 = fcmp fast oeq <4 x double> %v, %.splat
+; CHECK-NEXT:   %2 = shufflevector <4 x i1> %1, <4 x i1> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+; CHECK-NEXT:   %3 = and <4 x i1> %2, <i1 false, i1 true, i1 true, i1 true>
+; CHECK-NEXT:   %4 = shufflevector <4 x i1> %1, <4 x i1> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %5 = and <4 x i1> %4, <i1 false, i1 false, i1 true, i1 true>
+; CHECK-NEXT:   %6 = or <4 x i1> %3, %5
+; CHECK-NEXT:   %7 = shufflevector <4 x i1> %1, <4 x i1> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %8 = and <4 x i1> %7, <i1 false, i1 false, i1 false, i1 true>
+; CHECK-NEXT:   %9 = or <4 x i1> %6, %8
+; CHECK-NEXT:   %10 = xor <4 x i1> %9, <i1 true, i1 true, i1 true, i1 true>
+; CHECK-NEXT:   %11 = and <4 x i1> %1, %10
+; CHECK-NEXT:   %12 = select fast <4 x i1> %11, <4 x double> %"v'", <4 x double> zeroinitializer
+; CHECK-NEXT:   %13 = call fast double @llvm.vector.reduce.fadd.v4f64(double -0.000000e+00, <4 x double> %12)
+; CHECK-NEXT:   ret double %13
+; CHECK-NEXT: }
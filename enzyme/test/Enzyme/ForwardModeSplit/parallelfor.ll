@@ -0,0 +1,38 @@
+; RUN: not %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -S 2>&1 | FileCheck %s
+
+%struct.S = type { double*, double* }
+
+@__enzyme_register_parallel_for = global [1 x i8*] [i8* bitcast (void (i32, i32, void (i32, %struct.S*)*, %struct.S*)* @parallel_for to i8*)]
+
+declare void @parallel_for(i32, i32, void (i32, %struct.S*)*, %struct.S*)
+
+define internal void @body(i32 %i, %struct.S* %s) {
+entry:
+  %xp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 0
+  %x = load double*, double** %xp, align 8
+  %yp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 1
+  %y = load double*, double** %yp, align 8
+  %idx = sext i32 %i to i64
+  %xi.p = getelementptr inbounds double, double* %x, i64 %idx
+  %xi = load double, double* %xi.p, align 8
+  %sq = fmul double %xi, %xi
+  %yi.p = getelementptr inbounds double, double* %y, i64 %idx
+  store double %sq, double* %yi.p, align 8
+  ret void
+}
+
+define void @f(%struct.S* %s, i32 %n) {
+entry:
+  call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @body, %struct.S* %s)
+  ret void
+}
+
+define void @fwdf(%struct.S* %s, %struct.S* %ds, i32 %n) {
+entry:
+  call void (...) @__enzyme_fwdsplit(void (%struct.S*, i32)* @f, %struct.S* %s, %struct.S* %ds, i32 %n, i8* null)
+  ret void
+}
+
+declare void @__enzyme_fwdsplit(...)
+
+; CHECK: error: {{.*}}Enzyme: unsupported split forward mode parallel_for call: call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @body, %struct.S* %s)
@@ -0,0 +1,48 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -enzyme-parallel-reverse-loops -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define void @f(double* noalias %x, double* noalias %out, double %a, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %v = load double, double* %px
+  %m = fadd double %v, %a
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  store double %m, double* %po
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @test(double* %x, double* %dx, double* %out, double* %dout, double %a, double %da, i64 %n) {
+entry:
+  call void (...) @__enzyme_fwdsplit(void (double*, double*, double, i64)* @f, double* %x, double* %dx, double* %out, double* %dout, double %a, double %da, i64 %n, i8* null)
+  ret void
+}
+
+declare void @__enzyme_fwdsplit(...)
+
+; CHECK: define internal void @fwddiffef(double* noalias %x, double* %"x'", double* noalias %out, double* %"out'", double %a, double %"a'", i64 %n, i8* %tapeArg)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %umax = call i64 @llvm.umax.i64(i64 %n, i64 1)
+; CHECK-NEXT:   %[[dabits:.+]] = bitcast double %"a'" to i64
+; CHECK-NEXT:   %[[abits:.+]] = bitcast double %a to i64
+; CHECK-NEXT:   call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @enzyme_omp_ident.2, i32 8, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, i64, i64, double*, double*, i64)* @fwddiffepreprocess_f.omp_outlined to void (i32*, i32*, ...)*), i64 %umax, double* %x, double* %"x'", i64 %[[abits]], i64 %[[dabits]], double* %out, double* %"out'", i64 %n)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffepreprocess_f.omp_outlined(i32* noalias %0, i32* noalias %1, i64 %2, double* %x, double* %"x'", i64 %a, i64 %"a'", double* %out, double* %"out'", i64 %n)
+; CHECK: %[[da:.+]] = bitcast i64 %"a'" to double
+; CHECK: call void @__kmpc_for_static_init_8u(
+; CHECK: loop:
+; CHECK: %"px'ipg" = getelementptr inbounds double, double* %"x'", i64 %[[idx:.+]]
+; CHECK-NEXT: %"v'ipl" = load double, double* %"px'ipg"
+; CHECK-NEXT: %[[dm:.+]] = fadd fast double %"v'ipl", %[[da]]
+; CHECK-NEXT: %"po'ipg" = getelementptr inbounds double, double* %"out'", i64 %[[idx]]
+; CHECK-NEXT: store double %[[dm]], double* %"po'ipg"
+; CHECK: call void @__kmpc_for_static_fini(
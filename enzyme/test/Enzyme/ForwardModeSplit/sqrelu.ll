@@ -62,7 +62,7 @@ attributes #3 = { nounwind }
 ; CHECK-NEXT:   %4 = call fast double @llvm.sqrt.f64(double %mul.i)
 ; CHECK-NEXT:   %5 = fmul fast double %3, 5.000000e-01
 ; CHECK-NEXT:   %6 = fdiv fast double %5, %4
-; CHECK-NEXT:   %7 = fcmp fast oeq double %mul.i, 0.000000e+00
+; CHECK-NEXT:   %7 = fcmp fast oeq double %4, 0.000000e+00
 ; CHECK-NEXT:   %8 = select  {{(fast )?}}i1 %7, double 0.000000e+00, double %6
 ; CHECK-NEXT:   br label %fwddiffesqrelu.exit
 
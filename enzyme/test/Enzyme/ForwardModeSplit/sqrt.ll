@@ -23,7 +23,7 @@ declare double @__enzyme_fwdsplit(double (double)*, ...)
 ; CHECK-NEXT: entry:
 ; CHECK-NEXT:   %0 = tail call fast double @llvm.sqrt.f64(double %x)
 ; CHECK-NEXT:   %1 = fdiv fast double 5.000000e-01, %0
-; CHECK-NEXT:   %2 = fcmp fast oeq double %x, 0.000000e+00
+; CHECK-NEXT:   %2 = fcmp fast oeq double %0, 0.000000e+00
 ; CHECK-NEXT:   %3 = select{{( fast)?}} i1 %2, double 0.000000e+00, double %1
 ; CHECK-NEXT:   ret double %3
 ; CHECK-NEXT: }
@@ -0,0 +1,80 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define double @cube(double* %x) {
+entry:
+  %a = load double, double* %x
+  %x1p = getelementptr inbounds double, double* %x, i64 1
+  %b = load double, double* %x1p
+  %aa = fmul double %a, %a
+  %r = fmul double %aa, %b
+  ret double %r
+}
+
+declare void @__enzyme_hvp(...)
+declare void @__enzyme_hessian(...)
+
+define void @hvp(double* %x, double* %v1, double* %v2, double* %g, double* %hv1, double* %hv2) {
+entry:
+  call void (...) @__enzyme_hvp(double (double*)* @cube, metadata !"enzyme_width", i64 2, double* %x, double* %v1, double* %v2, double* %g, double* %hv1, double* %hv2)
+  ret void
+}
+
+define void @hessian(double* %h, double* %x) {
+entry:
+  call void (...) @__enzyme_hessian(double (double*)* @cube, double* %h, double* %x, i64 2)
+  ret void
+}
+
+; CHECK: define void @hvp(double* %x, double* %v1, double* %v2, double* %g, double* %hv1, double* %hv2)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = insertvalue [2 x double*] undef, double* %v1, 0
+; CHECK-NEXT:   %1 = insertvalue [2 x double*] %0, double* %v2, 1
+; CHECK-NEXT:   %2 = insertvalue [2 x double*] undef, double* %hv1, 0
+; CHECK-NEXT:   %3 = insertvalue [2 x double*] %2, double* %hv2, 1
+; CHECK-NEXT:   call void @fwddiffe2diffecube(double* %x, [2 x double*] %1, double* %g, [2 x double*] %3, double 1.000000e+00)
+; CHECK-NEXT:   ret void
+
+; CHECK: define void @hessian(double* %h, double* %x)
+; CHECK: jac.seed.end:
+; CHECK:   call void @fwddiffe2diffecube(double* %x, [2 x double*] %{{.*}}, double* %0, [2 x double*] %{{.*}}, double 1.000000e+00)
+; CHECK: jac.out:
+; CHECK:   %[[idx:.+]] = getelementptr double, double* %h, i64 %{{.*}}
+; CHECK-NEXT:   store double %{{.*}}, double* %[[idx]], align 8
+
+; CHECK: define internal void @fwddiffe2diffecube(double* %x, [2 x double*] %"x'", double* %"x'1", [2 x double*] %"x''", double %differeturn)
+; CHECK:   %[[xs0:.+]] = extractvalue [2 x double*] %"x''", 0
+; CHECK-NEXT:   %"x1p'ipg'ipg" = getelementptr inbounds double, double* %[[xs0]], i64 1
+; CHECK-NEXT:   %[[xs1:.+]] = extractvalue [2 x double*] %"x''", 1
+; CHECK-NEXT:   %"x1p'ipg'ipg10" = getelementptr inbounds double, double* %[[xs1]], i64 1
+; CHECK:   %[[daa0:.+]] = fadd fast double %{{.*}}, %{{.*}}
+; CHECK:   %[[daa1:.+]] = fadd fast double %{{.*}}, %{{.*}}
+; CHECK:   %m0diffeaa = fmul fast double %differeturn, %b
+; CHECK-NEXT:   %[[db0:.+]] = fmul fast double %"b'ipl", %differeturn
+; CHECK-NEXT:   %[[db1:.+]] = fmul fast double %"b'ipl13", %differeturn
+; CHECK:   %[[hb0:.+]] = fmul fast double %[[daa0]], %differeturn
+; CHECK-NEXT:   %[[hb1:.+]] = fmul fast double %[[daa1]], %differeturn
+; CHECK:   %[[p00:.+]] = fmul fast double %[[db0]], %a
+; CHECK-NEXT:   %[[p01:.+]] = fmul fast double %"a'ipl", %m0diffeaa
+; CHECK-NEXT:   %[[ha0:.+]] = fadd fast double %[[p00]], %[[p01]]
+; CHECK-NEXT:   %[[p10:.+]] = fmul fast double %[[db1]], %a
+; CHECK-NEXT:   %[[p11:.+]] = fmul fast double %"a'ipl9", %m0diffeaa
+; CHECK-NEXT:   %[[ha1:.+]] = fadd fast double %[[p10]], %[[p11]]
+; CHECK:   %[[hsum0:.+]] = fadd fast double %[[ha0]], %{{.*}}
+; CHECK-NEXT:   %[[hsum1:.+]] = fadd fast double %[[ha1]], %{{.*}}
+; CHECK:   %[[old1b0:.+]] = load double, double* %"x1p'ipg'ipg"
+; CHECK-NEXT:   %[[old1b1:.+]] = load double, double* %"x1p'ipg'ipg10"
+; CHECK:   %[[new1b0:.+]] = fadd fast double %[[old1b0]], %[[hb0]]
+; CHECK-NEXT:   %[[new1b1:.+]] = fadd fast double %[[old1b1]], %[[hb1]]
+; CHECK:   store double %[[new1b0]], double* %"x1p'ipg'ipg"
+; CHECK-NEXT:   store double %[[new1b1]], double* %"x1p'ipg'ipg10"
+; CHECK:   %[[xa0:.+]] = extractvalue [2 x double*] %"x''", 0
+; CHECK-NEXT:   %[[old1a0:.+]] = load double, double* %[[xa0]]
+; CHECK-NEXT:   %[[xa1:.+]] = extractvalue [2 x double*] %"x''", 1
+; CHECK-NEXT:   %[[old1a1:.+]] = load double, double* %[[xa1]]
+; CHECK:   %[[new1a0:.+]] = fadd fast double %[[old1a0]], %[[hsum0]]
+; CHECK-NEXT:   %[[new1a1:.+]] = fadd fast double %[[old1a1]], %[[hsum1]]
+; CHECK:   %[[sa0:.+]] = extractvalue [2 x double*] %"x''", 0
+; CHECK-NEXT:   store double %[[new1a0]], double* %[[sa0]]
+; CHECK-NEXT:   %[[sa1:.+]] = extractvalue [2 x double*] %"x''", 1
+; CHECK-NEXT:   store double %[[new1a1]], double* %[[sa1]]
+; CHECK-NEXT:   ret void
@@ -28,51 +28,48 @@ declare %struct.Gradients @__enzyme_fwddiff(...)
 
 ; CHECK: define internal [3 x double] @fwddiffe3tester(double %x, [3 x double] %"x'", double %y, [3 x double] %"y'")
 ; CHECK-NEXT: entry:
+; CHECK-NEXT:   %call = call double @hypot(double %x, double %y)
 ; CHECK-NEXT:   %0 = extractvalue [3 x double] %"x'", 0
 ; CHECK-NEXT:   %1 = fmul fast double %0, %x
 ; CHECK-NEXT:   %2 = extractvalue [3 x double] %"x'", 1
 ; CHECK-NEXT:   %3 = fmul fast double %2, %x
 ; CHECK-NEXT:   %4 = extractvalue [3 x double] %"x'", 2
 ; CHECK-NEXT:   %5 = fmul fast double %4, %x
-; CHECK-NEXT:   %6 = call fast double @hypot(double %x, double %y)
-; CHECK-NEXT:   %7 = fdiv fast double %1, %6
-; CHECK-NEXT:   %8 = fdiv fast double %3, %6
-; CHECK-NEXT:   %9 = fdiv fast double %5, %6
-; CHECK-NEXT:   %10 = extractvalue [3 x double] %"y'", 0
-; CHECK-NEXT:   %11 = fmul fast double %10, %y
-; CHECK-NEXT:   %12 = extractvalue [3 x double] %"y'", 1
-; CHECK-NEXT:   %13 = fmul fast double %12, %y
-; CHECK-NEXT:   %14 = extractvalue [3 x double] %"y'", 2
-; CHECK-NEXT:   %15 = fmul fast double %14, %y
-; CHECK-NEXT:   %16 = call fast double @hypot(double %x, double %y)
-; CHECK-NEXT:   %17 = fdiv fast double %11, %16
-; CHECK-NEXT:   %18 = fdiv fast double %13, %16
-; CHECK-NEXT:   %19 = fdiv fast double %15, %16
-; CHECK-NEXT:   %20 = fadd fast double %7, %17
-; CHECK-NEXT:   %21 = insertvalue [3 x double] undef, double %20, 0
-; CHECK-NEXT:   %22 = fadd fast double %8, %18
-; CHECK-NEXT:   %23 = insertvalue [3 x double] %21, double %22, 1
-; CHECK-NEXT:   %24 = fadd fast double %9, %19
-; CHECK-NEXT:   %25 = insertvalue [3 x double] %23, double %24, 2
-; CHECK-NEXT:   ret [3 x double] %25
+; CHECK-NEXT:   %6 = fdiv fast double %1, %call
+; CHECK-NEXT:   %7 = fdiv fast double %3, %call
+; CHECK-NEXT:   %8 = fdiv fast double %5, %call
+; CHECK-NEXT:   %9 = extractvalue [3 x double] %"y'", 0
+; CHECK-NEXT:   %10 = fmul fast double %9, %y
+; CHECK-NEXT:   %11 = extractvalue [3 x double] %"y'", 1
+; CHECK-NEXT:   %12 = fmul fast double %11, %y
+; CHECK-NEXT:   %13 = extractvalue [3 x double] %"y'", 2
+; CHECK-NEXT:   %14 = fmul fast double %13, %y
+; CHECK-NEXT:   %15 = fdiv fast double %10, %call
+; CHECK-NEXT:   %16 = fdiv fast double %12, %call
+; CHECK-NEXT:   %17 = fdiv fast double %14, %call
+; CHECK-NEXT:   %18 = fadd fast double %6, %15
+; CHECK-NEXT:   %19 = insertvalue [3 x double] undef, double %18, 0
+; CHECK-NEXT:   %20 = fadd fast double %7, %16
+; CHECK-NEXT:   %21 = insertvalue [3 x double] %19, double %20, 1
+; CHECK-NEXT:   %22 = fadd fast double %8, %17
+; CHECK-NEXT:   %23 = insertvalue [3 x double] %21, double %22, 2
+; CHECK-NEXT:   ret [3 x double] %23
 ; CHECK-NEXT: }
 
 ; CHECK: define internal [3 x double] @fwddiffe3tester2(double %x, [3 x double] %"x'")
 ; CHECK-NEXT: entry:
+; CHECK-NEXT:   %call = call double @hypot(double %x, double 2.000000e+00)
 ; CHECK-NEXT:   %0 = extractvalue [3 x double] %"x'", 0
 ; CHECK-NEXT:   %1 = fmul fast double %0, %x
 ; CHECK-NEXT:   %2 = extractvalue [3 x double] %"x'", 1
 ; CHECK-NEXT:   %3 = fmul fast double %2, %x
 ; CHECK-NEXT:   %4 = extractvalue [3 x double] %"x'", 2
 ; CHECK-NEXT:   %5 = fmul fast double %4, %x
-; CHECK-NEXT:   %6 = call fast double @hypot(double %x, double 2.000000e+00)
-; CHECK-NEXT:   %7 = fdiv fast double %1, %6
-; CHECK-NEXT:   %8 = insertvalue [3 x double] undef, double %7, 0
-; CHECK-NEXT:   %9 = fdiv fast double %3, %6
-; CHECK-NEXT:   %10 = insertvalue [3 x double] %8, double %9, 1
-; CHECK-NEXT:   %11 = fdiv fast double %5, %6
-; CHECK-NEXT:   %12 = insertvalue [3 x double] %10, double %11, 2
-; CHECK-NEXT:   ret [3 x double] %12
+; CHECK-NEXT:   %6 = fdiv fast double %1, %call
+; CHECK-NEXT:   %7 = insertvalue [3 x double] undef, double %6, 0
+; CHECK-NEXT:   %8 = fdiv fast double %3, %call
+; CHECK-NEXT:   %9 = insertvalue [3 x double] %7, double %8, 1
+; CHECK-NEXT:   %10 = fdiv fast double %5, %call
+; CHECK-NEXT:   %11 = insertvalue [3 x double] %9, double %10, 2
+; CHECK-NEXT:   ret [3 x double] %11
 ; CHECK-NEXT: }
-
-
@@ -0,0 +1,73 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define void @square(double* %y, double* %x) {
+entry:
+  %x1p = getelementptr inbounds double, double* %x, i64 1
+  %x0 = load double, double* %x
+  %x1 = load double, double* %x1p
+  %m = fmul double %x0, %x1
+  store double %m, double* %y
+  %a = fadd double %x0, %x1
+  %y1p = getelementptr inbounds double, double* %y, i64 1
+  store double %a, double* %y1p
+  ret void
+}
+
+define void @diag(double* %y, double* %x) {
+entry:
+  %x1p = getelementptr inbounds double, double* %x, i64 1
+  %x0 = load double, double* %x
+  %x1 = load double, double* %x1p
+  %m = fmul double %x0, %x0
+  store double %m, double* %y
+  %a = fmul double %x1, %x1
+  %y1p = getelementptr inbounds double, double* %y, i64 1
+  store double %a, double* %y1p
+  ret void
+}
+
+define void @dense(double* %jac, double* %y, double* %x) {
+entry:
+  call void (...) @__enzyme_jacobian(void (double*, double*)* @square, double* %jac, double* %y, i64 2, double* %x, i64 2)
+  ret void
+}
+
+define void @sparse(double* %jac, double* %y, double* %x) {
+entry:
+  call void (...) @__enzyme_jacobian(void (double*, double*)* @diag, double* %jac, double* %y, i64 2, double* %x, i64 2)
+  ret void
+}
+
+declare void @__enzyme_jacobian(...)
+
+; CHECK: @__enzyme_jacobian_rowptr = private unnamed_addr constant [3 x i64] [i64 0, i64 1, i64 2]
+; CHECK: @__enzyme_jacobian_colidx = private unnamed_addr constant [2 x i64] [i64 0, i64 1]
+
+; The 2 x 2 Jacobian of square is dense, so both columns are computed by one
+; forward mode call of width 2.
+; CHECK: define void @dense(double* %jac, double* %y, double* %x)
+; CHECK: jac.seed.end:
+; CHECK-NEXT:   %[[dy1:.+]] = getelementptr double, double* %[[dy:.+]], i64 2
+; CHECK-NEXT:   %[[dx1:.+]] = getelementptr double, double* %[[dx:.+]], i64 2
+; CHECK-NEXT:   %[[a:.+]] = insertvalue [2 x double*] undef, double* %[[dy]], 0
+; CHECK-NEXT:   %[[b:.+]] = insertvalue [2 x double*] %[[a]], double* %[[dy1]], 1
+; CHECK-NEXT:   %[[c:.+]] = insertvalue [2 x double*] undef, double* %[[dx]], 0
+; CHECK-NEXT:   %[[d:.+]] = insertvalue [2 x double*] %[[c]], double* %[[dx1]], 1
+; CHECK-NEXT:   call void @fwddiffe2square(double* %y, [2 x double*] %[[b]], double* %x, [2 x double*] %[[d]])
+; CHECK: jac.out:
+; CHECK:   store double %{{.+}}, double* %{{.+}}, align 8
+; CHECK: }
+
+; The Jacobian of diag is found to be diagonal, so its columns and rows are
+; colored, and the mode needing fewer colors is used.
+; CHECK: define void @sparse(double* %jac, double* %y, double* %x)
+; CHECK:   call void @__enzyme_sparsity_transpose(i64 2, i64 2, i64* getelementptr inbounds ([3 x i64], [3 x i64]* @__enzyme_jacobian_rowptr, i32 0, i32 0), i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__enzyme_jacobian_colidx, i32 0, i32 0), i64* %[[colptr:.+]], i64* %[[rowidx:.+]])
+; CHECK:   %[[ncol:.+]] = call i64 @__enzyme_sparsity_coloring(i64 2, i64* %[[colptr]], i64* %[[rowidx]], i64* getelementptr inbounds ([3 x i64], [3 x i64]* @__enzyme_jacobian_rowptr, i32 0, i32 0), i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__enzyme_jacobian_colidx, i32 0, i32 0), i64* %[[colcolors:.+]])
+; CHECK:   %[[nrow:.+]] = call i64 @__enzyme_sparsity_coloring(i64 2, i64* getelementptr inbounds ([3 x i64], [3 x i64]* @__enzyme_jacobian_rowptr, i32 0, i32 0), i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__enzyme_jacobian_colidx, i32 0, i32 0), i64* %[[colptr]], i64* %[[rowidx]], i64* %[[rowcolors:.+]])
+; CHECK-NEXT:   %[[fwd:.+]] = icmp sle i64 %[[ncol]], %[[nrow]]
+; CHECK-NEXT:   br i1 %[[fwd]], label %jacobian.fwd, label %jacobian.rev
+; CHECK: call void @fwddiffe2diag(double* %y, [2 x double*] %{{.+}}, double* %x, [2 x double*] %{{.+}})
+; CHECK: call void @diffe2diag(double* %y, [2 x double*] %{{.+}}, double* %x, [2 x double*] %{{.+}})
+; CHECK: }
+
+; CHECK: define internal i64 @__enzyme_sparsity_coloring(i64 %na, i64* %aptr, i64* %aidx, i64* %bptr, i64* %bidx, i64* %colors)
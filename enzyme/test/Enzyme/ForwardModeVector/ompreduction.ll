@@ -0,0 +1,207 @@
+; RUN: if [ %llvmver -ge 9 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+%struct.ident_t = type { i32, i32, i32, i32, i8* }
+
+@0 = private unnamed_addr constant [23 x i8] c";unknown;unknown;0;0;;\00", align 1
+@1 = private unnamed_addr constant %struct.ident_t { i32 0, i32 514, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@2 = private unnamed_addr constant %struct.ident_t { i32 0, i32 2, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@3 = private unnamed_addr constant %struct.ident_t { i32 0, i32 18, i32 0, i32 0, i8* getelementptr inbounds ([23 x i8], [23 x i8]* @0, i32 0, i32 0) }, align 8
+@.gomp_critical_user_.reduction.var = common global [8 x i32] zeroinitializer, align 8
+
+define void @f(double* %x, double* %sum, i64 %n) {
+entry:
+  call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* nonnull @2, i32 2, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*)* @.omp_outlined. to void (i32*, i32*, ...)*), i64 %n, double* %x)
+  call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* nonnull @2, i32 3, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*)* @.omp_outlined..1 to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %sum)
+  ret void
+}
+
+define internal void @.omp_outlined.(i32* noalias nocapture readonly %.global_tid., i32* noalias nocapture readnone %.bound_tid., i64 %length, double* nocapture %tmp) {
+entry:
+  %.omp.lb = alloca i64, align 8
+  %.omp.ub = alloca i64, align 8
+  %.omp.stride = alloca i64, align 8
+  %.omp.is_last = alloca i32, align 4
+  %sub4 = add i64 %length, -1
+  %cmp.not = icmp eq i64 %length, 0
+  br i1 %cmp.not, label %omp.precond.end, label %omp.precond.then
+
+omp.precond.then:
+  store i64 0, i64* %.omp.lb, align 8
+  store i64 %sub4, i64* %.omp.ub, align 8
+  store i64 1, i64* %.omp.stride, align 8
+  store i32 0, i32* %.omp.is_last, align 4
+  %0 = load i32, i32* %.global_tid., align 4
+  call void @__kmpc_for_static_init_8u(%struct.ident_t* nonnull @1, i32 %0, i32 34, i32* nonnull %.omp.is_last, i64* nonnull %.omp.lb, i64* nonnull %.omp.ub, i64* nonnull %.omp.stride, i64 1, i64 1)
+  %1 = load i64, i64* %.omp.ub, align 8
+  %cmp6 = icmp ugt i64 %1, %sub4
+  %cond = select i1 %cmp6, i64 %sub4, i64 %1
+  store i64 %cond, i64* %.omp.ub, align 8
+  %2 = load i64, i64* %.omp.lb, align 8
+  %add29 = add i64 %cond, 1
+  %cmp730 = icmp ult i64 %2, %add29
+  br i1 %cmp730, label %omp.inner.for.body, label %omp.loop.exit
+
+omp.inner.for.body:
+  %.omp.iv.031 = phi i64 [ %add11, %omp.inner.for.body ], [ %2, %omp.precond.then ]
+  %arrayidx = getelementptr inbounds double, double* %tmp, i64 %.omp.iv.031
+  %3 = load double, double* %arrayidx, align 8
+  %call = call double @sqrt(double %3)
+  store double %call, double* %arrayidx, align 8
+  %add11 = add nuw i64 %.omp.iv.031, 1
+  %4 = load i64, i64* %.omp.ub, align 8
+  %add = add i64 %4, 1
+  %cmp7 = icmp ult i64 %add11, %add
+  br i1 %cmp7, label %omp.inner.for.body, label %omp.loop.exit
+
+omp.loop.exit:
+  call void @__kmpc_for_static_fini(%struct.ident_t* nonnull @1, i32 %0)
+  br label %omp.precond.end
+
+omp.precond.end:
+  ret void
+}
+
+define internal void @.omp_outlined..1(i32* noalias nocapture readonly %.global_tid., i32* noalias nocapture readnone %.bound_tid., i64 %length, double* nocapture readonly %x, double* nocapture %sum) {
+entry:
+  %sum.priv = alloca double, align 8
+  %.omp.lb = alloca i64, align 8
+  %.omp.ub = alloca i64, align 8
+  %.omp.stride = alloca i64, align 8
+  %.omp.is_last = alloca i32, align 4
+  %.omp.reduction.red_list = alloca [1 x i8*], align 8
+  store double 0.000000e+00, double* %sum.priv, align 8
+  %cmp.not = icmp eq i64 %length, 0
+  br i1 %cmp.not, label %omp.precond.end, label %omp.precond.then
+
+omp.precond.then:
+  %sub = add i64 %length, -1
+  store i64 0, i64* %.omp.lb, align 8
+  store i64 %sub, i64* %.omp.ub, align 8
+  store i64 1, i64* %.omp.stride, align 8
+  store i32 0, i32* %.omp.is_last, align 4
+  %0 = load i32, i32* %.global_tid., align 4
+  call void @__kmpc_dispatch_init_8u(%struct.ident_t* nonnull @1, i32 %0, i32 35, i64 0, i64 %sub, i64 1, i64 4)
+  br label %omp.dispatch.cond
+
+omp.dispatch.cond:
+  %1 = call i32 @__kmpc_dispatch_next_8u(%struct.ident_t* nonnull @1, i32 %0, i32* nonnull %.omp.is_last, i64* nonnull %.omp.lb, i64* nonnull %.omp.ub, i64* nonnull %.omp.stride)
+  %tobool.not = icmp eq i32 %1, 0
+  br i1 %tobool.not, label %omp.dispatch.end, label %omp.dispatch.body
+
+omp.dispatch.body:
+  %2 = load i64, i64* %.omp.lb, align 8
+  %3 = load i64, i64* %.omp.ub, align 8
+  br label %omp.inner.for.body
+
+omp.inner.for.body:
+  %iv = phi i64 [ %2, %omp.dispatch.body ], [ %iv.next, %omp.inner.for.body ]
+  %arrayidx = getelementptr inbounds double, double* %x, i64 %iv
+  %4 = load double, double* %arrayidx, align 8
+  %mul = fmul double %4, %4
+  %5 = load double, double* %sum.priv, align 8
+  %add = fadd double %5, %mul
+  store double %add, double* %sum.priv, align 8
+  %iv.next = add nuw i64 %iv, 1
+  %cmp = icmp ugt i64 %iv.next, %3
+  br i1 %cmp, label %omp.dispatch.cond, label %omp.inner.for.body
+
+omp.dispatch.end:
+  %6 = getelementptr inbounds [1 x i8*], [1 x i8*]* %.omp.reduction.red_list, i64 0, i64 0
+  %7 = bitcast double* %sum.priv to i8*
+  store i8* %7, i8** %6, align 8
+  %8 = bitcast [1 x i8*]* %.omp.reduction.red_list to i8*
+  %9 = call i32 @__kmpc_reduce_nowait(%struct.ident_t* nonnull @3, i32 %0, i32 1, i64 8, i8* nonnull %8, void (i8*, i8*)* nonnull @.omp.reduction.reduction_func, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+  switch i32 %9, label %omp.precond.end [
+    i32 1, label %.omp.reduction.case1
+    i32 2, label %.omp.reduction.case2
+  ]
+
+.omp.reduction.case1:
+  %10 = load double, double* %sum, align 8
+  %11 = load double, double* %sum.priv, align 8
+  %add7 = fadd double %10, %11
+  store double %add7, double* %sum, align 8
+  call void @__kmpc_end_reduce_nowait(%struct.ident_t* nonnull @3, i32 %0, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+  br label %omp.precond.end
+
+.omp.reduction.case2:
+  %12 = load double, double* %sum.priv, align 8
+  %13 = atomicrmw fadd double* %sum, double %12 monotonic, align 8
+  br label %omp.precond.end
+
+omp.precond.end:
+  ret void
+}
+
+define internal void @.omp.reduction.reduction_func(i8* %0, i8* %1) {
+entry:
+  %2 = bitcast i8* %0 to [1 x i8*]*
+  %3 = bitcast i8* %1 to [1 x i8*]*
+  %4 = getelementptr inbounds [1 x i8*], [1 x i8*]* %3, i64 0, i64 0
+  %5 = load i8*, i8** %4, align 8
+  %6 = bitcast i8* %5 to double*
+  %7 = getelementptr inbounds [1 x i8*], [1 x i8*]* %2, i64 0, i64 0
+  %8 = load i8*, i8** %7, align 8
+  %9 = bitcast i8* %8 to double*
+  %10 = load double, double* %9, align 8
+  %11 = load double, double* %6, align 8
+  %add = fadd double %10, %11
+  store double %add, double* %9, align 8
+  ret void
+}
+
+
+define void @vf(double* %x, double* %dx1, double* %dx2, double* %sum, double* %ds1, double* %ds2, i64 %n) {
+entry:
+  call void (...) @__enzyme_fwddiff(void (double*, double*, i64)* @f, metadata !"enzyme_width", i64 2, double* %x, double* %dx1, double* %dx2, double* %sum, double* %ds1, double* %ds2, i64 %n)
+  ret void
+}
+
+declare void @__enzyme_fwddiff(...)
+declare double @sqrt(double)
+declare void @__kmpc_for_static_init_8u(%struct.ident_t*, i32, i32, i32*, i64*, i64*, i64*, i64, i64)
+declare void @__kmpc_for_static_fini(%struct.ident_t*, i32)
+declare void @__kmpc_dispatch_init_8u(%struct.ident_t*, i32, i32, i64, i64, i64, i64)
+declare i32 @__kmpc_dispatch_next_8u(%struct.ident_t*, i32, i32*, i64*, i64*, i64*)
+declare i32 @__kmpc_reduce_nowait(%struct.ident_t*, i32, i32, i64, i8*, void (i8*, i8*)*, [8 x i32]*)
+declare void @__kmpc_end_reduce_nowait(%struct.ident_t*, i32, [8 x i32]*)
+declare !callback !0 void @__kmpc_fork_call(%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...)
+
+!0 = !{!1}
+!1 = !{i64 2, i64 -1, i64 -1, i1 true}
+
+; CHECK: define internal void @fwddiffe2f(double* %x, [2 x double*] %"x'", double* %sum, [2 x double*] %"sum'", i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = extractvalue [2 x double*] %"x'", 0
+; CHECK-NEXT:   %1 = extractvalue [2 x double*] %"x'", 1
+; CHECK-NEXT:   call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @2, i32 4, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, double*)* @fwddiffe2.omp_outlined._omp to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %0, double* %1)
+; CHECK-NEXT:   %2 = extractvalue [2 x double*] %"x'", 0
+; CHECK-NEXT:   %3 = extractvalue [2 x double*] %"x'", 1
+; CHECK-NEXT:   %4 = extractvalue [2 x double*] %"sum'", 0
+; CHECK-NEXT:   %5 = extractvalue [2 x double*] %"sum'", 1
+; CHECK-NEXT:   call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @2, i32 7, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, double*, double*, double*, double*)* @fwddiffe2.omp_outlined..1_omp to void (i32*, i32*, ...)*), i64 %n, double* %x, double* %2, double* %3, double* %sum, double* %4, double* %5)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @fwddiffe2.omp_outlined..1(
+; CHECK:   call i32 @__kmpc_reduce_nowait(%struct.ident_t* nonnull @3, i32 %{{.*}}, i32 3, i64 24, i8* nonnull %{{.*}}, void (i8*, i8*)* nonnull @fwddiffe2.omp.reduction.reduction_func_omp, [8 x i32]* nonnull @.gomp_critical_user_.reduction.var)
+
+; CHECK: define internal void @fwddiffe2.omp.reduction.reduction_func_omp(i8* %0, i8* %1)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %2 = bitcast i8* %0 to i8**
+; CHECK-NEXT:   %3 = getelementptr inbounds i8*, i8** %2, i64 1
+; CHECK-NEXT:   %4 = bitcast i8** %3 to i8*
+; CHECK-NEXT:   %5 = insertvalue [2 x i8*] undef, i8* %4, 0
+; CHECK-NEXT:   %6 = getelementptr inbounds i8*, i8** %2, i64 2
+; CHECK-NEXT:   %7 = bitcast i8** %6 to i8*
+; CHECK-NEXT:   %8 = insertvalue [2 x i8*] %5, i8* %7, 1
+
+; CHECK: define internal void @fwddiffe2.omp_outlined..1_omp(i32* %0, i32* %1, i64 %2, double* %3, double* %4, double* %5, double* %6, double* %7, double* %8)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %9 = insertvalue [2 x double*] undef, double* %4, 0
+; CHECK-NEXT:   %10 = insertvalue [2 x double*] %9, double* %5, 1
+; CHECK-NEXT:   %11 = insertvalue [2 x double*] undef, double* %7, 0
+; CHECK-NEXT:   %12 = insertvalue [2 x double*] %11, double* %8, 1
+; CHECK-NEXT:   call void @fwddiffe2.omp_outlined..1(i32* %0, i32* %1, i64 %2, double* %3, [2 x double*] %10, double* %6, [2 x double*] %12)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -0,0 +1,70 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-vector-strip-width=4 -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.Gradients = type { double, double, double, double, double, double }
+
+declare %struct.Gradients @__enzyme_fwddiff(double (double, double)*, ...)
+
+define double @tester(double %x, double %y) {
+entry:
+  %0 = fmul fast double %x, %y
+  ret double %0
+}
+
+define %struct.Gradients @test_derivative(double %x, double %y) {
+entry:
+  %0 = tail call %struct.Gradients (double (double, double)*, ...) @__enzyme_fwddiff(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 6, double %x, double 1.0, double 0.0, double 2.0, double 0.0, double 3.0, double 0.0, double %y, double 0.0, double 1.0, double 0.0, double 1.0, double 0.0, double 4.0)
+  ret %struct.Gradients %0
+}
+
+; CHECK: define %struct.Gradients @test_derivative(double %x, double %y) {
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = alloca [6 x double], align 8
+; CHECK-NEXT:   store [6 x double] [double 1.000000e+00, double 0.000000e+00, double 2.000000e+00, double 0.000000e+00, double 3.000000e+00, double 0.000000e+00], [6 x double]* %0, align 8
+; CHECK-NEXT:   %1 = alloca [6 x double], align 8
+; CHECK-NEXT:   store [6 x double] [double 0.000000e+00, double 1.000000e+00, double 0.000000e+00, double 1.000000e+00, double 0.000000e+00, double 4.000000e+00], [6 x double]* %1, align 8
+; CHECK-NEXT:   %2 = alloca [6 x double], align 8
+; CHECK-NEXT:   br label %entry.strip
+; CHECK: entry.strip:
+; CHECK-NEXT:   %strip.iv = phi i64 [ 0, %entry ], [ %strip.iv.next, %entry.strip ]
+; CHECK-NEXT:   %3 = mul nuw nsw i64 %strip.iv, 4
+; CHECK-NEXT:   %4 = getelementptr inbounds [6 x double], [6 x double]* %0, i64 0, i64 %3
+; CHECK-NEXT:   %5 = bitcast double* %4 to [4 x double]*
+; CHECK-NEXT:   %6 = load [4 x double], [4 x double]* %5, align 8
+; CHECK-NEXT:   %7 = getelementptr inbounds [6 x double], [6 x double]* %1, i64 0, i64 %3
+; CHECK-NEXT:   %8 = bitcast double* %7 to [4 x double]*
+; CHECK-NEXT:   %9 = load [4 x double], [4 x double]* %8, align 8
+; CHECK-NEXT:   %10 = call fast [4 x double] @fwddiffe4tester(double %x, [4 x double] %6, double %y, [4 x double] %9)
+; CHECK-NEXT:   %11 = getelementptr inbounds [6 x double], [6 x double]* %2, i64 0, i64 %3
+; CHECK-NEXT:   %12 = bitcast double* %11 to [4 x double]*
+; CHECK-NEXT:   store [4 x double] %10, [4 x double]* %12, align 8
+; CHECK-NEXT:   %strip.iv.next = add nuw nsw i64 %strip.iv, 1
+; CHECK-NEXT:   %13 = icmp eq i64 %strip.iv.next, 1
+; CHECK-NEXT:   br i1 %13, label %entry.strip.end, label %entry.strip
+; CHECK: entry.strip.end:
+; CHECK-NEXT:   %14 = getelementptr inbounds [6 x double], [6 x double]* %0, i64 0, i64 4
+; CHECK-NEXT:   %15 = bitcast double* %14 to [2 x double]*
+; CHECK-NEXT:   %16 = load [2 x double], [2 x double]* %15, align 8
+; CHECK-NEXT:   %17 = getelementptr inbounds [6 x double], [6 x double]* %1, i64 0, i64 4
+; CHECK-NEXT:   %18 = bitcast double* %17 to [2 x double]*
+; CHECK-NEXT:   %19 = load [2 x double], [2 x double]* %18, align 8
+; CHECK-NEXT:   %20 = call fast [2 x double] @fwddiffe2tester(double %x, [2 x double] %16, double %y, [2 x double] %19)
+; CHECK-NEXT:   %21 = getelementptr inbounds [6 x double], [6 x double]* %2, i64 0, i64 4
+; CHECK-NEXT:   %22 = bitcast double* %21 to [2 x double]*
+; CHECK-NEXT:   store [2 x double] %20, [2 x double]* %22, align 8
+; CHECK-NEXT:   %23 = load [6 x double], [6 x double]* %2, align 8
+; CHECK-NEXT:   %24 = extractvalue [6 x double] %23, 0
+; CHECK-NEXT:   %25 = insertvalue %struct.Gradients zeroinitializer, double %24, 0
+; CHECK-NEXT:   %26 = extractvalue [6 x double] %23, 1
+; CHECK-NEXT:   %27 = insertvalue %struct.Gradients %25, double %26, 1
+; CHECK-NEXT:   %28 = extractvalue [6 x double] %23, 2
+; CHECK-NEXT:   %29 = insertvalue %struct.Gradients %27, double %28, 2
+; CHECK-NEXT:   %30 = extractvalue [6 x double] %23, 3
+; CHECK-NEXT:   %31 = insertvalue %struct.Gradients %29, double %30, 3
+; CHECK-NEXT:   %32 = extractvalue [6 x double] %23, 4
+; CHECK-NEXT:   %33 = insertvalue %struct.Gradients %31, double %32, 4
+; CHECK-NEXT:   %34 = extractvalue [6 x double] %23, 5
+; CHECK-NEXT:   %35 = insertvalue %struct.Gradients %33, double %34, 5
+; CHECK-NEXT:   ret %struct.Gradients %35
+; CHECK-NEXT: }
+; CHECK: define internal {{(dso_local )?}}[4 x double] @fwddiffe4tester(double %x, [4 x double] %"x'", double %y, [4 x double] %"y'")
+; CHECK: define internal {{(dso_local )?}}[2 x double] @fwddiffe2tester(double %x, [2 x double] %"x'", double %y, [2 x double] %"y'")
@@ -0,0 +1,74 @@
+; RUN: if [ %llvmver -ge 13 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-vector-shadows -enzyme-preopt=false -mem2reg -early-cse -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+%struct.Gradients = type { double, double, double, double }
+
+declare %struct.Gradients @__enzyme_fwddiff(double (double, double)*, ...)
+
+declare double @llvm.sin.f64(double)
+
+define double @tester(double %x, double %y) {
+entry:
+  %0 = fmul fast double %x, %y
+  %1 = fdiv fast double %x, %y
+  %2 = fsub fast double %1, %0
+  %3 = call fast double @llvm.sin.f64(double %2)
+  %4 = fadd fast double %3, %0
+  ret double %4
+}
+
+define %struct.Gradients @test_derivative(double %x, double %y) {
+entry:
+  %0 = tail call %struct.Gradients (double (double, double)*, ...) @__enzyme_fwddiff(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 4, double %x, double 1.0, double 0.0, double 2.0, double 0.0, double %y, double 0.0, double 1.0, double 0.0, double 1.0)
+  ret %struct.Gradients %0
+}
+
+; CHECK: define internal {{(dso_local )?}}[4 x double] @fwddiffe4tester(double %x, [4 x double] %"x'", double %y, [4 x double] %"y'")
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = fmul fast double %x, %y
+; CHECK-NEXT:   %1 = extractvalue [4 x double] %"y'", 0
+; CHECK-NEXT:   %2 = insertelement <4 x double> undef, double %1, i64 0
+; CHECK-NEXT:   %3 = extractvalue [4 x double] %"y'", 1
+; CHECK-NEXT:   %4 = insertelement <4 x double> %2, double %3, i64 1
+; CHECK-NEXT:   %5 = extractvalue [4 x double] %"y'", 2
+; CHECK-NEXT:   %6 = insertelement <4 x double> %4, double %5, i64 2
+; CHECK-NEXT:   %7 = extractvalue [4 x double] %"y'", 3
+; CHECK-NEXT:   %8 = insertelement <4 x double> %6, double %7, i64 3
+; CHECK-NEXT:   %9 = extractvalue [4 x double] %"x'", 0
+; CHECK-NEXT:   %10 = insertelement <4 x double> undef, double %9, i64 0
+; CHECK-NEXT:   %11 = extractvalue [4 x double] %"x'", 1
+; CHECK-NEXT:   %12 = insertelement <4 x double> %10, double %11, i64 1
+; CHECK-NEXT:   %13 = extractvalue [4 x double] %"x'", 2
+; CHECK-NEXT:   %14 = insertelement <4 x double> %12, double %13, i64 2
+; CHECK-NEXT:   %15 = extractvalue [4 x double] %"x'", 3
+; CHECK-NEXT:   %16 = insertelement <4 x double> %14, double %15, i64 3
+; CHECK-NEXT:   %.splatinsert = insertelement <4 x double> {{(poison|undef)}}, double %y, i32 0
+; CHECK-NEXT:   %.splat = shufflevector <4 x double> %.splatinsert, <4 x double> {{(poison|undef)}}, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %17 = fmul fast <4 x double> %16, %.splat
+; CHECK-NEXT:   %.splatinsert5 = insertelement <4 x double> {{(poison|undef)}}, double %x, i32 0
+; CHECK-NEXT:   %.splat6 = shufflevector <4 x double> %.splatinsert5, <4 x double> {{(poison|undef)}}, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %18 = fmul fast <4 x double> %8, %.splat6
+; CHECK-NEXT:   %19 = fadd fast <4 x double> %17, %18
+; CHECK-NEXT:   %20 = fdiv fast double %x, %y
+; CHECK-NEXT:   %21 = fsub fast <4 x double> %17, %18
+; CHECK-NEXT:   %22 = fmul fast double %y, %y
+; CHECK-NEXT:   %.splatinsert11 = insertelement <4 x double> {{(poison|undef)}}, double %22, i32 0
+; CHECK-NEXT:   %.splat12 = shufflevector <4 x double> %.splatinsert11, <4 x double> {{(poison|undef)}}, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %23 = fdiv fast <4 x double> %21, %.splat12
+; CHECK-NEXT:   %24 = fsub fast double %20, %0
+; CHECK-NEXT:   %25 = fneg fast <4 x double> %19
+; CHECK-NEXT:   %26 = fadd fast <4 x double> %23, %25
+; CHECK-NEXT:   %27 = call fast double @llvm.cos.f64(double %24)
+; CHECK-NEXT:   %.splatinsert13 = insertelement <4 x double> {{(poison|undef)}}, double %27, i32 0
+; CHECK-NEXT:   %.splat14 = shufflevector <4 x double> %.splatinsert13, <4 x double> {{(poison|undef)}}, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %28 = fmul fast <4 x double> %26, %.splat14
+; CHECK-NEXT:   %29 = fadd fast <4 x double> %28, %19
+; CHECK-NEXT:   %30 = extractelement <4 x double> %29, i64 0
+; CHECK-NEXT:   %31 = insertvalue [4 x double] undef, double %30, 0
+; CHECK-NEXT:   %32 = extractelement <4 x double> %29, i64 1
+; CHECK-NEXT:   %33 = insertvalue [4 x double] %31, double %32, 1
+; CHECK-NEXT:   %34 = extractelement <4 x double> %29, i64 2
+; CHECK-NEXT:   %35 = insertvalue [4 x double] %33, double %34, 2
+; CHECK-NEXT:   %36 = extractelement <4 x double> %29, i64 3
+; CHECK-NEXT:   %37 = insertvalue [4 x double] %35, double %36, 3
+; CHECK-NEXT:   ret [4 x double] %37
+; CHECK-NEXT: }
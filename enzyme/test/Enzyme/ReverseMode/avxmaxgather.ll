@@ -0,0 +1,54 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @f(double* %x, <4 x i64> %idx) {
+entry:
+  %p = getelementptr inbounds double, double* %x, <4 x i64> %idx
+  %g = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %p, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x double> undef)
+  %s = shufflevector <4 x double> %g, <4 x double> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+  %m = call <4 x double> @llvm.x86.avx.max.pd.256(<4 x double> %g, <4 x double> %s)
+  %r = call double @llvm.vector.reduce.fadd.v4f64(double -0.0, <4 x double> %m)
+  ret double %r
+}
+declare <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*>, i32, <4 x i1>, <4 x double>)
+declare <4 x double> @llvm.x86.avx.max.pd.256(<4 x double>, <4 x double>)
+declare double @llvm.vector.reduce.fadd.v4f64(double, <4 x double>)
+define void @test(double* %x, double* %dx, <4 x i64> %idx) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double*, <4 x i64>)* @f, double* %x, double* %dx, <4 x i64> %idx)
+  ret void
+}
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffef(double* %x, double* %"x'", <4 x i64> %idx, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"p'ipg" = getelementptr inbounds double, double* %"x'", <4 x i64> %idx
+; CHECK-NEXT:   %p = getelementptr inbounds double, double* %x, <4 x i64> %idx
+; CHECK-NEXT:   %g = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %p, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x double> undef)
+; CHECK-NEXT:   %s = shufflevector <4 x double> %g, <4 x double> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %0 = insertelement <4 x double> undef, double %differeturn, i64 0
+; CHECK-NEXT:   %1 = shufflevector <4 x double> %0, <4 x double> undef, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %2 = fcmp fast ogt <4 x double> %g, %s
+; CHECK-NEXT:   %3 = select fast <4 x i1> %2, <4 x double> %1, <4 x double> zeroinitializer
+; CHECK-NEXT:   %4 = select fast <4 x i1> %2, <4 x double> zeroinitializer, <4 x double> %1
+; CHECK-NEXT:   %5 = shufflevector <4 x double> %4, <4 x double> zeroinitializer, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %6 = fadd fast <4 x double> %3, %5
+; CHECK-NEXT:   %7 = shufflevector <4 x double*> %"p'ipg", <4 x double*> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %8 = icmp eq <4 x double*> %"p'ipg", %7
+; CHECK-NEXT:   %9 = shufflevector <4 x double> %6, <4 x double> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %10 = select fast <4 x i1> %8, <4 x double> %9, <4 x double> zeroinitializer
+; CHECK-NEXT:   %11 = fadd fast <4 x double> %6, %10
+; CHECK-NEXT:   %12 = shufflevector <4 x double*> %"p'ipg", <4 x double*> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %13 = icmp eq <4 x double*> %"p'ipg", %12
+; CHECK-NEXT:   %14 = shufflevector <4 x double> %6, <4 x double> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %15 = select fast <4 x i1> %13, <4 x double> %14, <4 x double> zeroinitializer
+; CHECK-NEXT:   %16 = fadd fast <4 x double> %11, %15
+; CHECK-NEXT:   %17 = shufflevector <4 x double*> %"p'ipg", <4 x double*> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+; CHECK-NEXT:   %18 = icmp eq <4 x double*> %"p'ipg", %17
+; CHECK-NEXT:   %19 = shufflevector <4 x double> %6, <4 x double> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+; CHECK-NEXT:   %20 = select fast <4 x i1> %18, <4 x double> %19, <4 x double> zeroinitializer
+; CHECK-NEXT:   %21 = fadd fast <4 x double> %16, %20
+; CHECK-NEXT:   %22 = call fast <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %"p'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 true>, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %23 = fadd fast <4 x double> %22, %21
+; CHECK-NEXT:   call void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double> %23, <4 x double*> %"p'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 true>)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
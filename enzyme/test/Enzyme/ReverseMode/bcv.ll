@@ -27,12 +27,10 @@ entry:
 
 ; CHECK: define internal void @diffef(i64* %inp, i64* %"inp'", <2 x double> %differeturn)
 ; CHECK-NEXT: invert:
-; CHECK-NEXT:   %0 = extractelement <2 x double> %differeturn, i64 0
-; CHECK-NEXT:   %"bc'de.0.vec.insert" = insertelement <2 x double> zeroinitializer, double %0, i32 0
-; CHECK-NEXT:   %1 = extractelement <2 x double> %differeturn, i64 1
-; CHECK-NEXT:   %2 = fadd fast double %0, %1
-; CHECK-NEXT:   %"bc'de.0.vec.insert6" = insertelement <2 x double> %"bc'de.0.vec.insert", double %2, i32 0
-; CHECK-NEXT:   %3 = bitcast <2 x double> %"bc'de.0.vec.insert6" to <2 x i64>
+; CHECK-NEXT:   %0 = shufflevector <2 x double> %differeturn, <2 x double> zeroinitializer, <2 x i32> <i32 0, i32 2>
+; CHECK-NEXT:   %1 = shufflevector <2 x double> %differeturn, <2 x double> zeroinitializer, <2 x i32> <i32 1, i32 2>
+; CHECK-NEXT:   %2 = fadd fast <2 x double> %0, %1
+; CHECK-NEXT:   %3 = bitcast <2 x double> %2 to <2 x i64>
 ; CHECK-NEXT:   %4 = extractelement <2 x i64> %3, i32 0
 ; CHECK-NEXT:   %5 = bitcast i64* %"inp'" to double*
 ; CHECK-DAG:   %[[b6:.+]] = bitcast i64 %4 to double
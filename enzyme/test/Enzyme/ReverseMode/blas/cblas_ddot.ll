@@ -86,20 +86,20 @@ entry:
 
 ; CHECK: define internal void @[[active]](i32 %len, double* noalias %m, double* %"m'", i32 %incm, double* noalias %n, double* %"n'", i32 %incn, double %differeturn)
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %m, i32 %incm, double* %"n'", i32 %incn)
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %n, i32 %incn, double* %"m'", i32 %incm)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %m, i32 %incm, double* nocapture %"n'", i32 %incn)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %n, i32 %incn, double* nocapture %"m'", i32 %incm)
 ; CHECK-NEXT:   ret void
 ; CHECK-NEXT: }
 
 ; CHECK: define internal void @[[inactiveFirst]](i32 %len, double* noalias %m, i32 %incm, double* noalias %n, double* %"n'", i32 %incn, double %differeturn)
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %m, i32 %incm, double* %"n'", i32 %incn)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %m, i32 %incm, double* nocapture %"n'", i32 %incn)
 ; CHECK-NEXT:   ret void
 ; CHECK-NEXT: }
 
 ; CHECK: define internal void @[[inactiveSecond]](i32 %len, double* noalias %m, double* %"m'", i32 %incm, double* noalias %n, i32 %incn, double %differeturn)
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %n, i32 %incn, double* %"m'", i32 %incm)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %n, i32 %incn, double* nocapture %"m'", i32 %incm)
 ; CHECK-NEXT:   ret void
 ; CHECK-NEXT: }
 
@@ -159,8 +159,8 @@ entry:
 ; CHECK-NEXT: entry:
 ; CHECK-NEXT:   %1 = extractvalue { double*, double* } %0, 0
 ; CHECK-NEXT:   %2 = extractvalue { double*, double* } %0, 1
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %1, i32 1, double* %"n'", i32 %incn)
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %2, i32 1, double* %"m'", i32 %incm)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %1, i32 1, double* nocapture %"n'", i32 %incn)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %2, i32 1, double* nocapture %"m'", i32 %incm)
 ; CHECK-NEXT:   %3 = bitcast double* %1 to i8*
 ; CHECK-NEXT:   tail call void @free(i8* nonnull %3)
 ; CHECK-NEXT:   %4 = bitcast double* %2 to i8*
@@ -201,7 +201,7 @@ entry:
 
 ; CHECK: define internal void @[[revModFirst]](i32 %len, double* noalias %m, i32 %incm, double* noalias %n, double* %"n'", i32 %incn, double %differeturn, double*
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %0, i32 1, double* %"n'", i32 %incn)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %0, i32 1, double* nocapture %"n'", i32 %incn)
 ; CHECK-NEXT:   %1 = bitcast double* %0 to i8*
 ; CHECK-NEXT:   tail call void @free(i8* nonnull %1)
 ; CHECK-NEXT:   ret void
@@ -240,7 +240,7 @@ entry:
 
 ; CHECK: define internal void @[[revModSecond]](i32 %len, double* noalias %m, double* %"m'", i32 %incm, double* noalias %n, i32 %incn, double %differeturn, double*
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* %0, i32 1, double* %"m'", i32 %incm)
+; CHECK-NEXT:   call void @cblas_daxpy(i32 %len, double %differeturn, double* nocapture readonly %0, i32 1, double* nocapture %"m'", i32 %incm)
 ; CHECK-NEXT:   %1 = bitcast double* %0 to i8*
 ; CHECK-NEXT:   tail call void @free(i8* nonnull %1)
 ; CHECK-NEXT:   ret void
@@ -0,0 +1,102 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @cblas_dgemm(i32, i32, i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)
+
+define void @f(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, i32 %lda, double* noalias %B, i32 %ldb, double %beta, double* noalias %C, i32 %ldc) {
+entry:
+  call void @cblas_dgemm(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, i32 %lda, double* %B, i32 %ldb, double %beta, double* %C, i32 %ldc)
+  ret void
+}
+
+define void @modf(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, i32 %lda, double* noalias %B, i32 %ldb, double %beta, double* noalias %C, i32 %ldc) {
+entry:
+  call void @f(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, i32 %lda, double* %B, i32 %ldb, double %beta, double* %C, i32 %ldc)
+  store double 0.000000e+00, double* %B
+  ret void
+}
+
+define void @active(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, double %beta, double* %C, double* %dC, i32 %ldc) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i32, i32, i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @f, i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, metadata !"enzyme_const", double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, metadata !"enzyme_const", double %beta, double* %C, double* %dC, i32 %ldc)
+  ret void
+}
+
+define void @activeMod(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, double %beta, double* %C, double* %dC, i32 %ldc) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i32, i32, i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @modf, i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, metadata !"enzyme_const", double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, metadata !"enzyme_const", double %beta, double* %C, double* %dC, i32 %ldc)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, double* %"A'", i32 %lda, double* noalias %B, double* %"B'", i32 %ldb, double %beta, double* noalias %C, double* %"C'", i32 %ldc)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @cblas_dgemm(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %B, i32 %ldb, double %beta, double* nocapture %C, i32 %ldc)
+; CHECK-NEXT:   %0 = icmp eq i32 %layout, 101
+; CHECK-NEXT:   %1 = icmp eq i32 %transa, 111
+; CHECK-NEXT:   %2 = icmp eq i32 %transb, 111
+; CHECK-NEXT:   %3 = or i1 %1, %2
+; CHECK-NEXT:   %4 = select i1 %3, i32 111, i32 112
+; CHECK-NEXT:   %5 = xor i1 %2, true
+; CHECK-NEXT:   %6 = and i1 %1, %5
+; CHECK-NEXT:   %7 = select i1 %6, i32 111, i32 112
+; CHECK-NEXT:   %8 = select i1 %1, i32 %m, i32 %k
+; CHECK-NEXT:   %9 = select i1 %1, i32 %k, i32 %m
+; CHECK-NEXT:   %10 = select i1 %1, double* %"C'", double* %B
+; CHECK-NEXT:   %11 = select i1 %1, i32 %ldc, i32 %ldb
+; CHECK-NEXT:   %12 = select i1 %1, double* %B, double* %"C'"
+; CHECK-NEXT:   %13 = select i1 %1, i32 %ldb, i32 %ldc
+; CHECK-NEXT:   call void @cblas_dgemm(i32 %layout, i32 %4, i32 %7, i32 %8, i32 %9, i32 %n, double %alpha, double* nocapture readonly %10, i32 %11, double* nocapture readonly %12, i32 %13, double 1.000000e+00, double* nocapture %"A'", i32 %lda)
+; CHECK-NEXT:   %14 = xor i1 %1, true
+; CHECK-NEXT:   %15 = and i1 %2, %14
+; CHECK-NEXT:   %16 = select i1 %15, i32 111, i32 112
+; CHECK-NEXT:   %17 = or i1 %2, %1
+; CHECK-NEXT:   %18 = select i1 %17, i32 111, i32 112
+; CHECK-NEXT:   %19 = select i1 %2, i32 %k, i32 %n
+; CHECK-NEXT:   %20 = select i1 %2, i32 %n, i32 %k
+; CHECK-NEXT:   %21 = select i1 %2, double* %A, double* %"C'"
+; CHECK-NEXT:   %22 = select i1 %2, i32 %lda, i32 %ldc
+; CHECK-NEXT:   %23 = select i1 %2, double* %"C'", double* %A
+; CHECK-NEXT:   %24 = select i1 %2, i32 %ldc, i32 %lda
+; CHECK-NEXT:   call void @cblas_dgemm(i32 %layout, i32 %16, i32 %18, i32 %19, i32 %20, i32 %m, double %alpha, double* nocapture readonly %21, i32 %22, double* nocapture readonly %23, i32 %24, double 1.000000e+00, double* nocapture %"B'", i32 %ldb)
+; CHECK-NEXT:   %25 = select i1 %0, i32 %m, i32 %n
+; CHECK-NEXT:   %26 = select i1 %0, i32 %n, i32 %m
+; CHECK:   %A.i.i = getelementptr inbounds double, double* %"C'", i64 %{{.*}}
+; CHECK-NEXT:   %[[c:.+]] = load double, double* %A.i.i
+; CHECK-NEXT:   %[[s:.+]] = fmul fast double %beta, %[[c]]
+
+; CHECK: define internal double* @augmented_f(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, double* %"A'", i32 %lda, double* noalias %B, double* %"B'", i32 %ldb, double %beta, double* noalias %C, double* %"C'", i32 %ldc)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = icmp eq i32 %layout, 101
+; CHECK-NEXT:   call void @cblas_dgemm(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* nocapture readonly %A, i32 %lda, double* nocapture readonly %B, i32 %ldb, double %beta, double* nocapture %C, i32 %ldc)
+; CHECK-NEXT:   %1 = icmp eq i32 %transb, 111
+; CHECK-NEXT:   %2 = select i1 %1, i32 %k, i32 %n
+; CHECK-NEXT:   %3 = select i1 %1, i32 %n, i32 %k
+; CHECK-NEXT:   %4 = select i1 %0, i32 %2, i32 %3
+; CHECK-NEXT:   %5 = select i1 %0, i32 %3, i32 %2
+; CHECK-NEXT:   %6 = mul i32 %5, %4
+; CHECK-NEXT:   %mallocsize = mul nuw nsw i32 %6, 8
+; CHECK-NEXT:   %malloccall = tail call noalias nonnull i8* @malloc(i32 %mallocsize)
+; CHECK-NEXT:   %7 = bitcast i8* %malloccall to double*
+; CHECK:   call void @llvm.memcpy.p0i8.p0i8.i64(
+; CHECK:   ret double* %7
+
+; CHECK: define internal void @diffef.2(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, double* %"A'", i32 %lda, double* noalias %B, double* %"B'", i32 %ldb, double %beta, double* noalias %C, double* %"C'", i32 %ldc, double* %0)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %1 = icmp eq i32 %layout, 101
+; CHECK-NEXT:   %2 = icmp eq i32 %transb, 111
+; CHECK-NEXT:   %3 = select i1 %2, i32 %k, i32 %n
+; CHECK-NEXT:   %4 = select i1 %2, i32 %n, i32 %k
+; CHECK-NEXT:   %5 = select i1 %1, i32 %4, i32 %3
+; CHECK:   %15 = select i1 %6, double* %"C'", double* %0
+; CHECK-NEXT:   %16 = select i1 %6, i32 %ldc, i32 %5
+; CHECK-NEXT:   %17 = select i1 %6, double* %0, double* %"C'"
+; CHECK-NEXT:   %18 = select i1 %6, i32 %5, i32 %ldc
+; CHECK-NEXT:   call void @cblas_dgemm(i32 %layout, i32 %9, i32 %12, i32 %13, i32 %14, i32 %n, double %alpha, double* nocapture readonly %15, i32 %16, double* nocapture readonly %17, i32 %18, double 1.000000e+00, double* nocapture %"A'", i32 %lda)
+; CHECK:   call void @cblas_dgemm(i32 %layout, i32 %21, i32 %23, i32 %24, i32 %25, i32 %m, double %alpha, double* nocapture readonly %26, i32 %27, double* nocapture readonly %28, i32 %29, double 1.000000e+00, double* nocapture %"B'", i32 %ldb)
+; CHECK:   %[[fr:.+]] = bitcast double* %0 to i8*
+; CHECK-NEXT:   tail call void @free(i8* nonnull %[[fr]])
+; CHECK-NEXT:   ret void
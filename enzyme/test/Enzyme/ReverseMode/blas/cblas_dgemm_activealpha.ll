@@ -0,0 +1,19 @@
+;RUN: not %opt < %s %loadEnzyme -enzyme -S 2>&1 | FileCheck %s
+
+declare void @__enzyme_autodiff(...)
+
+declare void @cblas_dgemm(i32, i32, i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)
+
+define void @f(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* noalias %A, i32 %lda, double* noalias %B, i32 %ldb, double %beta, double* noalias %C, i32 %ldc) {
+entry:
+  call void @cblas_dgemm(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, i32 %lda, double* %B, i32 %ldb, double %beta, double* %C, i32 %ldc)
+  ret void
+}
+
+define void @active(i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, double %beta, double* %C, double* %dC, i32 %ldc) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i32, i32, i32, i32, i32, i32, double, double*, i32, double*, i32, double, double*, i32)* @f, i32 %layout, i32 %transa, i32 %transb, i32 %m, i32 %n, i32 %k, double %alpha, double* %A, double* %dA, i32 %lda, double* %B, double* %dB, i32 %ldb, metadata !"enzyme_const", double %beta, double* %C, double* %dC, i32 %ldc)
+  ret void
+}
+
+; CHECK: error: {{.*}}Enzyme: unsupported active scaling factor in   call void @cblas_dgemm(
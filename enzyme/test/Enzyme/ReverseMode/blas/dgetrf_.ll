@@ -0,0 +1,54 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dgetrf_(i32*, i32*, double*, i32*, i32*, i32*)
+
+define void @f(i32* %n, double* noalias %A, i32* %lda, i32* %ipiv, i32* %info) {
+entry:
+  call void @dgetrf_(i32* %n, i32* %n, double* %A, i32* %lda, i32* %ipiv, i32* %info)
+  ret void
+}
+
+define void @active(i32* %n, double* %A, double* %dA, i32* %lda, i32* %ipiv, i32* %info) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i32*, double*, i32*, i32*, i32*)* @f, metadata !"enzyme_const", i32* %n, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, metadata !"enzyme_const", i32* %ipiv, metadata !"enzyme_const", i32* %info)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i32* %n, double* noalias %A, double* %"A'", i32* %lda, i32* %ipiv, i32* %info)
+; CHECK:   call void @dgetrf_(i32* %n, i32* %n, double* %A, i32* %lda, i32* %ipiv, i32* %info)
+; CHECK:   %[[W1:.+]] = bitcast i8* %malloccall to double*
+; CHECK:   %[[W2:.+]] = bitcast i8* %malloccall2 to double*
+; CHECK:   store i8 76, i8* %[[side1:.+]], align 1
+; CHECK-NEXT:   store i8 76, i8* %[[uplo1:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr1:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[diag1:.+]], align 1
+; CHECK:   call void @dtrmm_(i8* %[[side1]], i8* %[[uplo1]], i8* %[[tr1]], i8* %[[diag1]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[W1]], i32* %{{.*}})
+; CHECK:   store i8 82, i8* %[[side2:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[uplo2:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr2:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag2:.+]], align 1
+; CHECK:   call void @dtrmm_(i8* %[[side2]], i8* %[[uplo2]], i8* %[[tr2]], i8* %[[diag2]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[W2]], i32* %{{.*}})
+; CHECK:   store i8 76, i8* %[[side3:.+]], align 1
+; CHECK-NEXT:   store i8 76, i8* %[[uplo3:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr3:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[diag3:.+]], align 1
+; CHECK:   call void @dtrsm_(i8* %[[side3]], i8* %[[uplo3]], i8* %[[tr3]], i8* %[[diag3]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[W1]], i32* %{{.*}})
+; CHECK-NEXT:   store i8 82, i8* %[[side4:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[uplo4:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr4:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag4:.+]], align 1
+; CHECK:   call void @dtrsm_(i8* %[[side4]], i8* %[[uplo4]], i8* %[[tr4]], i8* %[[diag4]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[W1]], i32* %{{.*}})
+; CHECK:   store i32 -1, i32* %[[incx:.+]], align 4
+; CHECK-NEXT:   call void @dlaswp_(i32* %{{.*}}, double* %[[W1]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, i32* %ipiv, i32* %[[incx]])
+; CHECK:   %[[z:.+]] = getelementptr inbounds double, double* %"A'", i64 %{{.*}}
+; CHECK-NEXT:   store double 0.000000e+00, double* %[[z]]
+; CHECK:   %[[x:.+]] = getelementptr inbounds double, double* %[[W1]], i64 %{{.*}}
+; CHECK-NEXT:   %[[y:.+]] = getelementptr inbounds double, double* %"A'", i64 %{{.*}}
+; CHECK:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall2)
+; CHECK-NEXT:   ret void
@@ -0,0 +1,52 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dgetrs_(i8*, i32*, i32*, double*, i32*, i32*, double*, i32*, i32*)
+
+define void @f(i8* %trans, i32* %n, i32* %nrhs, double* noalias %A, i32* %lda, i32* %ipiv, double* noalias %B, i32* %ldb, i32* %info) {
+entry:
+  call void @dgetrs_(i8* %trans, i32* %n, i32* %nrhs, double* %A, i32* %lda, i32* %ipiv, double* %B, i32* %ldb, i32* %info)
+  ret void
+}
+
+define void @active(i8* %trans, i32* %n, i32* %nrhs, double* %A, double* %dA, i32* %lda, i32* %ipiv, double* %B, double* %dB, i32* %ldb, i32* %info) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i8*, i32*, i32*, double*, i32*, i32*, double*, i32*, i32*)* @f, metadata !"enzyme_const", i8* %trans, metadata !"enzyme_const", i32* %n, metadata !"enzyme_const", i32* %nrhs, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, metadata !"enzyme_const", i32* %ipiv, double* %B, double* %dB, metadata !"enzyme_const", i32* %ldb, metadata !"enzyme_const", i32* %info)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i8* %trans, i32* %n, i32* %nrhs, double* noalias %A, double* %"A'", i32* %lda, i32* %ipiv, double* noalias %B, double* %"B'", i32* %ldb, i32* %info)
+; CHECK:   call void @dgetrs_(i8* %trans, i32* %n, i32* %nrhs, double* %A, i32* %lda, i32* %ipiv, double* %B, i32* %ldb, i32* %info)
+; CHECK:   %[[tr:.+]] = load i8, i8* %trans
+; CHECK-NEXT:   %[[isnl:.+]] = icmp eq i8 %[[tr]], 110
+; CHECK-NEXT:   %[[isnu:.+]] = icmp eq i8 %[[tr]], 78
+; CHECK-NEXT:   %[[isn:.+]] = or i1 %[[isnu]], %[[isnl]]
+; CHECK:   %[[ist:.+]] = xor i1 %[[isn]], true
+; CHECK-NEXT:   %[[fl:.+]] = select i1 %[[ist]], i8 78, i8 84
+; CHECK:   store i8 %[[fl]], i8* %[[flp:.+]], align 1
+; CHECK:   call void @dgetrs_(i8* %[[flp]], i32* %{{.*}}, i32* %{{.*}}, double* %A, i32* %{{.*}}, i32* %ipiv, double* %"B'", i32* %{{.*}}, i32* %{{.*}})
+; CHECK:   %[[X:.+]] = select i1 %[[isn]], double* %"B'", double* %B
+; CHECK-NEXT:   %[[Y:.+]] = select i1 %[[isn]], double* %B, double* %"B'"
+; CHECK-NEXT:   store i8 78, i8* %[[ta:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tb:.+]], align 1
+; CHECK:   call void @dgemm_(i8* %[[ta]], i8* %[[tb]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %[[X]], i32* %{{.*}}, double* %[[Y]], i32* %{{.*}}, double* %{{.*}}, double* %[[sbar:.+]], i32* %{{.*}})
+; CHECK:   call void @dlaswp_(i32* %{{.*}}, double* %[[sbar]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, i32* %ipiv, i32* %{{.*}})
+; CHECK:   store i8 82, i8* %[[side1:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[uplo1:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr1:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag1:.+]], align 1
+; CHECK:   call void @dtrmm_(i8* %[[side1]], i8* %[[uplo1]], i8* %[[tr1]], i8* %[[diag1]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[sbar]], i32* %{{.*}})
+; CHECK:   store i8 76, i8* %[[side2:.+]], align 1
+; CHECK-NEXT:   store i8 76, i8* %[[uplo2:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr2:.+]], align 1
+; CHECK-NEXT:   store i8 85, i8* %[[diag2:.+]], align 1
+; CHECK:   call void @dtrmm_(i8* %[[side2]], i8* %[[uplo2]], i8* %[[tr2]], i8* %[[diag2]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %{{.*}}, i32* %{{.*}})
+; CHECK:   getelementptr inbounds double, double* %"A'"
+; CHECK:   getelementptr inbounds double, double* %"A'"
+; CHECK:   tail call void @free(i8* nonnull %malloccall2)
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   ret void
@@ -0,0 +1,55 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dpotrf_(i8*, i32*, double*, i32*, i32*, i64)
+
+define void @f(i8* %uplo, i32* %n, double* noalias %A, i32* %lda, i32* %info) {
+entry:
+  call void @dpotrf_(i8* %uplo, i32* %n, double* %A, i32* %lda, i32* %info, i64 1)
+  ret void
+}
+
+define void @active(i8* %uplo, i32* %n, double* %A, double* %dA, i32* %lda, i32* %info) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i8*, i32*, double*, i32*, i32*)* @f, metadata !"enzyme_const", i8* %uplo, metadata !"enzyme_const", i32* %n, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, metadata !"enzyme_const", i32* %info)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i8* %uplo, i32* %n, double* noalias %A, double* %"A'", i32* %lda, i32* %info)
+; CHECK:   call void @dpotrf_(i8* %uplo, i32* %n, double* %A, i32* %lda, i32* %info, i64 1)
+; CHECK-NEXT:   %[[n:.+]] = load i32, i32* %n
+; CHECK-NEXT:   %[[uplo:.+]] = load i8, i8* %uplo
+; CHECK-NEXT:   %[[isul:.+]] = icmp eq i8 %[[uplo]], 117
+; CHECK-NEXT:   %[[isuu:.+]] = icmp eq i8 %[[uplo]], 85
+; CHECK-NEXT:   %[[isu:.+]] = or i1 %[[isuu]], %[[isul]]
+; CHECK:   %malloccall = tail call noalias nonnull i8* @malloc(i32 %mallocsize)
+; CHECK:   %[[notu:.+]] = xor i1 %[[isu]], true
+; CHECK-NEXT:   %[[side1:.+]] = select i1 %[[notu]], i8 76, i8 82
+; CHECK-NEXT:   store i8 %[[side1]], i8* %[[side1p:.+]], align 1
+; CHECK-NEXT:   store i8 %[[uplo]], i8* %[[uplo1p:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr1p:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag1p:.+]], align 1
+; CHECK:   call void @dtrmm_(i8* %[[side1p]], i8* %[[uplo1p]], i8* %[[tr1p]], i8* %[[diag1p]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[Phi:.+]], i32* %{{.*}}, i64 1, i64 1, i64 1, i64 1)
+; CHECK:   store double 5.000000e-01, double* %[[halfp:.+]], align 8
+; CHECK:   call void @dscal_(i32* %{{.*}}, double* %[[halfp]], double* %[[Phi]], i32* %{{.*}})
+; CHECK-NEXT:   %[[side2:.+]] = select i1 %[[isu]], i8 76, i8 82
+; CHECK-NEXT:   store i8 %[[side2]], i8* %[[side2p:.+]], align 1
+; CHECK-NEXT:   store i8 %[[uplo]], i8* %[[uplo2p:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[tr2p:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag2p:.+]], align 1
+; CHECK:   call void @dtrsm_(i8* %[[side2p]], i8* %[[uplo2p]], i8* %[[tr2p]], i8* %[[diag2p]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[Phi]], i32* %{{.*}}, i64 1, i64 1, i64 1, i64 1)
+; CHECK-NEXT:   %[[notu3:.+]] = xor i1 %[[isu]], true
+; CHECK-NEXT:   %[[side3:.+]] = select i1 %[[notu3]], i8 76, i8 82
+; CHECK-NEXT:   store i8 %[[side3]], i8* %[[side3p:.+]], align 1
+; CHECK-NEXT:   store i8 %[[uplo]], i8* %[[uplo3p:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tr3p:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[diag3p:.+]], align 1
+; CHECK:   call void @dtrsm_(i8* %[[side3p]], i8* %[[uplo3p]], i8* %[[tr3p]], i8* %[[diag3p]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[Phi]], i32* %{{.*}}, i64 1, i64 1, i64 1, i64 1)
+; CHECK:   %[[y:.+]] = getelementptr inbounds double, double* %"A'", i64 %{{.*}}
+; CHECK-NEXT:   store double 0.000000e+00, double* %[[y]]
+; CHECK:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   ret void
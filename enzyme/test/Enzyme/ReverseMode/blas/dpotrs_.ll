@@ -0,0 +1,45 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dpotrs_(i8*, i32*, i32*, double*, i32*, double*, i32*, i32*, i64)
+
+define void @f(i8* %uplo, i32* %n, i32* %nrhs, double* noalias %A, i32* %lda, double* noalias %B, i32* %ldb, i32* %info) {
+entry:
+  call void @dpotrs_(i8* %uplo, i32* %n, i32* %nrhs, double* %A, i32* %lda, double* %B, i32* %ldb, i32* %info, i64 1)
+  ret void
+}
+
+define void @active(i8* %uplo, i32* %n, i32* %nrhs, double* %A, double* %dA, i32* %lda, double* %B, double* %dB, i32* %ldb, i32* %info) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i8*, i32*, i32*, double*, i32*, double*, i32*, i32*)* @f, metadata !"enzyme_const", i8* %uplo, metadata !"enzyme_const", i32* %n, metadata !"enzyme_const", i32* %nrhs, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, double* %B, double* %dB, metadata !"enzyme_const", i32* %ldb, metadata !"enzyme_const", i32* %info)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i8* %uplo, i32* %n, i32* %nrhs, double* noalias %A, double* %"A'", i32* %lda, double* noalias %B, double* %"B'", i32* %ldb, i32* %info)
+; CHECK:   call void @dpotrs_(i8* %uplo, i32* %n, i32* %nrhs, double* %A, i32* %lda, double* %B, i32* %ldb, i32* %info, i64 1)
+; CHECK-NEXT:   %[[n:.+]] = load i32, i32* %n
+; CHECK-NEXT:   %[[uplo:.+]] = load i8, i8* %uplo
+; CHECK-NEXT:   %[[isul:.+]] = icmp eq i8 %[[uplo]], 117
+; CHECK-NEXT:   %[[isuu:.+]] = icmp eq i8 %[[uplo]], 85
+; CHECK-NEXT:   %[[isu:.+]] = or i1 %[[isuu]], %[[isul]]
+; CHECK:   store i8 %[[uplo]], i8* %[[uplo1p:.+]], align 1
+; CHECK:   call void @dpotrs_(i8* %[[uplo1p]], i32* %{{.*}}, i32* %{{.*}}, double* %A, i32* %{{.*}}, double* %"B'", i32* %{{.*}}, i32* %{{.*}}, i64 1)
+; CHECK:   store i8 %[[uplo]], i8* %[[uplo2p:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[tr2p:.+]], align 1
+; CHECK:   call void @dsyr2k_(i8* %[[uplo2p]], i8* %[[tr2p]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %"B'", i32* %{{.*}}, double* %B, i32* %{{.*}}, double* %{{.*}}, double* %[[S:.+]], i32* %{{.*}}, i64 1, i64 1)
+; CHECK:   getelementptr inbounds double, double* %A
+; CHECK:   %[[notu:.+]] = xor i1 %[[isu]], true
+; CHECK-NEXT:   %[[side:.+]] = select i1 %[[notu]], i8 76, i8 82
+; CHECK-NEXT:   store i8 %[[side]], i8* %[[side3p:.+]], align 1
+; CHECK-NEXT:   store i8 %[[uplo]], i8* %[[uplo3p:.+]], align 1
+; CHECK:   call void @dsymm_(i8* %[[side3p]], i8* %[[uplo3p]], i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %[[S]], i32* %{{.*}}, double* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %[[R:.+]], i32* %{{.*}}, i64 1, i64 1)
+; CHECK:   %[[x:.+]] = getelementptr inbounds double, double* %[[R]], i64 %{{.*}}
+; CHECK-NEXT:   %[[y:.+]] = getelementptr inbounds double, double* %"A'", i64 %{{.*}}
+; CHECK:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall2)
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall4)
+; CHECK-NEXT:   ret void
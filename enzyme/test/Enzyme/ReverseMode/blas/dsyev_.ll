@@ -0,0 +1,48 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@.str = private unnamed_addr constant [2 x i8] c"V\00"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dsyev_(i8*, i8*, i32*, double*, i32*, double*, double*, i32*, i32*, i64, i64)
+
+define void @f(i8* %uplo, i32* %n, double* %A, i32* %lda, double* %w, double* %work, i32* %lwork, i32* %info) {
+entry:
+  call void @dsyev_(i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.str, i64 0, i64 0), i8* %uplo, i32* %n, double* %A, i32* %lda, double* %w, double* %work, i32* %lwork, i32* %info, i64 1, i64 1)
+  ret void
+}
+
+define void @active(i8* %uplo, i32* %n, double* %A, double* %dA, i32* %lda, double* %w, double* %dw, double* %work, i32* %lwork, i32* %info) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i8*, i32*, double*, i32*, double*, double*, i32*, i32*)* @f, metadata !"enzyme_const", i8* %uplo, metadata !"enzyme_const", i32* %n, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, double* %w, double* %dw, metadata !"enzyme_const", double* %work, metadata !"enzyme_const", i32* %lwork, metadata !"enzyme_const", i32* %info)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i8* %uplo, i32* %n, double* %A, double* %"A'", i32* %lda, double* %w, double* %"w'", double* %work, i32* %lwork, i32* %info)
+; CHECK:   call void @dsyev_(i8* getelementptr inbounds ([2 x i8], [2 x i8]* @.str, i64 0, i64 0), i8* %uplo, i32* %n, double* %A, i32* %lda, double* %w, double* %work, i32* %lwork, i32* %info, i64 1, i64 1)
+; CHECK:   %[[lwork:.+]] = load i32, i32* %lwork
+; CHECK-NEXT:   %[[query:.+]] = icmp eq i32 %[[lwork]], -1
+; CHECK-NEXT:   br i1 %[[query]], label %invertentry_lapack_post, label %invertentry_lapack
+
+; CHECK: invertentry_lapack:
+; CHECK:   store i8 84, i8* %[[ta1:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[tb1:.+]], align 1
+; CHECK:   call void @dgemm_(i8* %[[ta1]], i8* %[[tb1]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %"A'", i32* %{{.*}}, double* %{{.*}}, double* %[[K:.+]], i32* %{{.*}}, i64 1, i64 1)
+; CHECK: __enzyme_eigvec_adjoint_double_mat_32.exit:
+; CHECK-NEXT:   %[[n1:.+]] = add i32 %{{.*}}, 1
+; CHECK:   call void @daxpy_(i32* %{{.*}}, double* %{{.*}}, double* %"w'", i32* %{{.*}}, double* %[[K]], i32* %{{.*}})
+; CHECK:   store i8 78, i8* %[[ta2:.+]], align 1
+; CHECK-NEXT:   store i8 78, i8* %[[tb2:.+]], align 1
+; CHECK:   call void @dgemm_(i8* %[[ta2]], i8* %[[tb2]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %A, i32* %{{.*}}, double* %[[K]], i32* %{{.*}}, double* %{{.*}}, double* %[[M:.+]], i32* %{{.*}}, i64 1, i64 1)
+; CHECK:   store i8 78, i8* %[[ta3:.+]], align 1
+; CHECK-NEXT:   store i8 84, i8* %[[tb3:.+]], align 1
+; CHECK:   call void @dgemm_(i8* %[[ta3]], i8* %[[tb3]], i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %[[M]], i32* %{{.*}}, double* %A, i32* %{{.*}}, double* %{{.*}}, double* %[[K]], i32* %{{.*}}, i64 1, i64 1)
+; CHECK:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall2)
+; CHECK-NEXT:   br label %invertentry_lapack_post
+
+; CHECK: invertentry_lapack_post:
+; CHECK-NEXT:   ret void
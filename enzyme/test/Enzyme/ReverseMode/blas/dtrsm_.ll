@@ -0,0 +1,52 @@
+;RUN: %opt < %s %loadEnzyme -enzyme -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare dso_local void @__enzyme_autodiff(...)
+
+declare void @dtrsm_(i8*, i8*, i8*, i8*, i32*, i32*, double*, double*, i32*, double*, i32*, i64, i64, i64, i64)
+
+define void @f(i8* %side, i8* %uplo, i8* %transa, i8* %diag, i32* %m, i32* %n, double* %alpha, double* noalias %A, i32* %lda, double* noalias %B, i32* %ldb) {
+entry:
+  call void @dtrsm_(i8* %side, i8* %uplo, i8* %transa, i8* %diag, i32* %m, i32* %n, double* %alpha, double* %A, i32* %lda, double* %B, i32* %ldb, i64 1, i64 1, i64 1, i64 1)
+  ret void
+}
+
+define void @active(i8* %side, i8* %uplo, i8* %transa, i8* %diag, i32* %m, i32* %n, double* %alpha, double* %A, double* %dA, i32* %lda, double* %B, double* %dB, i32* %ldb) {
+entry:
+  call void (...) @__enzyme_autodiff(void (i8*, i8*, i8*, i8*, i32*, i32*, double*, double*, i32*, double*, i32*)* @f, metadata !"enzyme_const", i8* %side, metadata !"enzyme_const", i8* %uplo, metadata !"enzyme_const", i8* %transa, metadata !"enzyme_const", i8* %diag, metadata !"enzyme_const", i32* %m, metadata !"enzyme_const", i32* %n, metadata !"enzyme_const", double* %alpha, double* %A, double* %dA, metadata !"enzyme_const", i32* %lda, double* %B, double* %dB, metadata !"enzyme_const", i32* %ldb)
+  ret void
+}
+
+; CHECK: define internal void @diffef(i8* %side, i8* %uplo, i8* %transa, i8* %diag, i32* %m, i32* %n, double* %alpha, double* noalias %A, double* %"A'", i32* %lda, double* noalias %B, double* %"B'", i32* %ldb)
+; CHECK:   call void @dtrsm_(i8* %side, i8* %uplo, i8* %transa, i8* %diag, i32* %m, i32* %n, double* %alpha, double* %A, i32* %lda, double* %B, i32* %ldb, i64 1, i64 1, i64 1, i64 1)
+; CHECK-NEXT:   %[[m:.+]] = load i32, i32* %m
+; CHECK-NEXT:   %[[n:.+]] = load i32, i32* %n
+; CHECK-NEXT:   %[[ta:.+]] = load i8, i8* %transa
+; CHECK-NEXT:   %[[isnl:.+]] = icmp eq i8 %[[ta]], 110
+; CHECK-NEXT:   %[[isnu:.+]] = icmp eq i8 %[[ta]], 78
+; CHECK-NEXT:   %[[isn:.+]] = or i1 %[[isnu]], %[[isnl]]
+; CHECK-NEXT:   %[[side:.+]] = load i8, i8* %side
+; CHECK-NEXT:   %[[uplo:.+]] = load i8, i8* %uplo
+; CHECK-NEXT:   %[[ist:.+]] = xor i1 %[[isn]], true
+; CHECK-NEXT:   %[[fl:.+]] = select i1 %[[ist]], i8 78, i8 84
+; CHECK-NEXT:   %[[diag:.+]] = load i8, i8* %diag
+; CHECK-NEXT:   %[[lda:.+]] = load i32, i32* %lda
+; CHECK-NEXT:   %[[ldb:.+]] = load i32, i32* %ldb
+; CHECK-NEXT:   store i8 %[[side]], i8* %[[sidep:.+]], align 1
+; CHECK-NEXT:   store i8 %[[uplo]], i8* %[[uplop:.+]], align 1
+; CHECK-NEXT:   store i8 %[[fl]], i8* %[[flp:.+]], align 1
+; CHECK-NEXT:   store i8 %[[diag]], i8* %[[diagp:.+]], align 1
+; CHECK-NEXT:   store i32 %[[m]], i32* %[[mp:.+]], align 4
+; CHECK-NEXT:   store i32 %[[n]], i32* %[[np:.+]], align 4
+; CHECK-NEXT:   store double 1.000000e+00, double* %[[onep:.+]], align 8
+; CHECK-NEXT:   store i32 %[[lda]], i32* %[[ldap:.+]], align 4
+; CHECK-NEXT:   store i32 %[[ldb]], i32* %[[ldbp:.+]], align 4
+; CHECK-NEXT:   call void @dtrsm_(i8* %[[sidep]], i8* %[[uplop]], i8* %[[flp]], i8* %[[diagp]], i32* %[[mp]], i32* %[[np]], double* %[[onep]], double* %A, i32* %[[ldap]], double* %"B'", i32* %[[ldbp]], i64 1, i64 1, i64 1, i64 1)
+; CHECK:   %malloccall = tail call noalias nonnull i8* @malloc(i32 %mallocsize)
+; CHECK:   call void @dgemm_(i8* %{{.*}}, i8* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, i32* %{{.*}}, double* %{{.*}}, double* %{{.*}}, i32* %{{.*}}, i64 1, i64 1)
+; CHECK:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   %[[alpha:.+]] = load double, double* %alpha
+; CHECK:   fmul fast double %[[alpha]], %{{.*}}
+; CHECK:   ret void
@@ -20,10 +20,10 @@ declare double @__enzyme_autodiff(double (double)*, ...)
 
 ; CHECK: define internal { double } @diffetester(double %x, double %differeturn)
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @cbrt(double %x)
+; CHECK-NEXT:   %call = call double @cbrt(double %x)
 ; CHECK-DAG:    [[REG1:%[0-9]+]] = fmul fast double 3.000000e+00, %x
-; CHECK-DAG:    [[REG2:%[0-9]+]] = fmul fast double %differeturn, %0
-; CHECK-NEXT:   %3 = fdiv fast double [[REG2]], [[REG1]]
-; CHECK-NEXT:   %4 = insertvalue { double } undef, double %3, 0
-; CHECK-NEXT:   ret { double } %4
+; CHECK-DAG:    [[REG2:%[0-9]+]] = fmul fast double %differeturn, %call
+; CHECK-NEXT:   %2 = fdiv fast double [[REG2]], [[REG1]]
+; CHECK-NEXT:   %3 = insertvalue { double } undef, double %2, 0
+; CHECK-NEXT:   ret { double } %3
 ; CHECK-NEXT: }
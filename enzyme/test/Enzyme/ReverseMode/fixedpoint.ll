@@ -0,0 +1,111 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+; out[i] = (in[i] + a[i] / in[i]) / 2, whose fixed point is sqrt(a[i])
+define void @babylon(double* %out, double* %in, double* %a, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %pin = getelementptr inbounds double, double* %in, i64 %i
+  %pa = getelementptr inbounds double, double* %a, i64 %i
+  %pout = getelementptr inbounds double, double* %out, i64 %i
+  %vin = load double, double* %pin
+  %va = load double, double* %pa
+  %q = fdiv double %va, %vin
+  %s = fadd double %vin, %q
+  %h = fmul double %s, 5.000000e-01
+  store double %h, double* %pout
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; out[0] = (in[0] + c / in[0]) / 2
+define void @babylon1(double* %out, double* %in, double %c) {
+entry:
+  %vin = load double, double* %in
+  %q = fdiv double %c, %vin
+  %s = fadd double %vin, %q
+  %h = fmul double %s, 5.000000e-01
+  store double %h, double* %out
+  ret void
+}
+
+define double @f(double* noalias %x, double* noalias %a, i64 %n) {
+entry:
+  call void (...) @__enzyme_fixed_point(void (double*, double*, double*, i64)* @babylon, double* %x, i64 %n, double* %a, i64 %n)
+  %x0 = load double, double* %x
+  %p1 = getelementptr inbounds double, double* %x, i64 1
+  %x1 = load double, double* %p1
+  %r = fadd double %x0, %x1
+  store double 0.000000e+00, double* %x
+  ret double %r
+}
+
+define double @g(double* %x, double %c) {
+entry:
+  call void (...) @__enzyme_fixed_point(void (double*, double*, double)* @babylon1, double* %x, i32 1, double %c)
+  %x0 = load double, double* %x
+  ret double %x0
+}
+
+define void @df(double* %x, double* %dx, double* %a, double* %da, i64 %n) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double*, double*, i64)* @f, double* %x, double* %dx, double* %a, double* %da, i64 %n)
+  ret void
+}
+
+define double @dg(double* %x, double* %dx, double %c) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double*, double)* @g, double* %x, double* %dx, double %c)
+  ret double %0
+}
+
+declare void @__enzyme_fixed_point(...)
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffef(double* noalias %x, double* %"x'", double* noalias %a, double* %"a'", i64 %n, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @__enzyme_fixed_point_babylon(double* %x, i64 %n, double* %a, i64 %n)
+; CHECK-NEXT:   %mallocsize = mul nuw nsw i64 %n, 8
+; CHECK-NEXT:   %malloccall = tail call noalias nonnull i8* @malloc(i64 %mallocsize)
+; CHECK-NEXT:   %fixedpoint = bitcast i8* %malloccall to double*
+; CHECK-NEXT:   %0 = mul i64 %n, 8
+; CHECK-NEXT:   %1 = bitcast double* %x to i8*
+; CHECK-NEXT:   call void @llvm.memcpy.p0i8.p0i8.i64(i8* %malloccall, i8* %1, i64 %0, i1 false)
+; CHECK-NEXT:   %"p1'ipg" = getelementptr inbounds double, double* %"x'", i64 1
+; CHECK-NEXT:   store double 0.000000e+00, double* %x, align 8
+; CHECK-NEXT:   store double 0.000000e+00, double* %"x'", align 8
+; CHECK-NEXT:   %2 = load double, double* %"p1'ipg", align 8
+; CHECK-NEXT:   %3 = fadd fast double %2, %differeturn
+; CHECK-NEXT:   store double %3, double* %"p1'ipg", align 8
+; CHECK-NEXT:   %4 = load double, double* %"x'", align 8
+; CHECK-NEXT:   %5 = fadd fast double %4, %differeturn
+; CHECK-NEXT:   store double %5, double* %"x'", align 8
+; CHECK-NEXT:   call void @diffebabylon.1_fixed_point(double* %fixedpoint, double* %"x'", i64 %n, double* %a, i64 %n, double* %"a'")
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @diffebabylon.1_fixed_point(double* %x, double* %dx, i64 %n, double* %0, i64 %1, double* %2)
+; CHECK: fp.iter:
+; CHECK:   call void @diffebabylon(double* %{{.*}}, double* %{{.*}}, double* %x, double* %{{.*}}, double* %0, i64 %1)
+; CHECK: fp.end:
+; CHECK:   call void @diffebabylon.1(double* %{{.*}}, double* %{{.*}}, double* %x, double* %{{.*}}, double* %0, double* %2, i64 %1)
+; CHECK-NEXT:   %[[size:.+]] = mul i64 %n, 8
+; CHECK-NEXT:   %[[dx:.+]] = bitcast double* %dx to i8*
+; CHECK-NEXT:   call void @llvm.memset.p0i8.i64(i8* %[[dx]], i8 0, i64 %[[size]], i1 false)
+
+; CHECK: define internal { double } @diffeg(double* %x, double* %"x'", double %c, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   call void @__enzyme_fixed_point_babylon1(double* %x, i64 1, double %c)
+; CHECK-NEXT:   %0 = load double, double* %"x'", align 8
+; CHECK-NEXT:   %1 = fadd fast double %0, %differeturn
+; CHECK-NEXT:   store double %1, double* %"x'", align 8
+; CHECK-NEXT:   %2 = call { double } @diffebabylon1.2_fixed_point(double* %x, double* %"x'", i64 1, double %c)
+; CHECK-NEXT:   ret { double } %2
+; CHECK-NEXT: }
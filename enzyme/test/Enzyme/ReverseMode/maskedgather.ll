@@ -0,0 +1,52 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(double* %x, <4 x i64> %idx) {
+entry:
+  %ptrs = getelementptr inbounds double, double* %x, <4 x i64> %idx
+  %v = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+  %sq = fmul <4 x double> %v, %v
+  %r = call double @llvm.vector.reduce.fadd.v4f64(double -0.000000e+00, <4 x double> %sq)
+  ret double %r
+}
+
+define void @test_derivative(double* %x, double* %dx, <4 x i64> %idx) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double*, <4 x i64>)* @tester, double* %x, double* %dx, <4 x i64> %idx)
+  ret void
+}
+
+declare <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*>, i32, <4 x i1>, <4 x double>)
+declare double @llvm.vector.reduce.fadd.v4f64(double, <4 x double>)
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffetester(double* %x, double* %"x'", <4 x i64> %idx, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"ptrs'ipg" = getelementptr inbounds double, double* %"x'", <4 x i64> %idx
+; CHECK-NEXT:   %ptrs = getelementptr inbounds double, double* %x, <4 x i64> %idx
+; CHECK-NEXT:   %v = call <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %0 = insertelement <4 x double> undef, double %differeturn, i64 0
+; CHECK-NEXT:   %1 = shufflevector <4 x double> %0, <4 x double> undef, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %m0diffev = fmul fast <4 x double> %1, %v
+; CHECK-NEXT:   %m1diffev = fmul fast <4 x double> %1, %v
+; CHECK-NEXT:   %2 = fadd fast <4 x double> %m0diffev, %m1diffev
+; CHECK-NEXT:   %3 = select fast <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> %2, <4 x double> zeroinitializer
+; CHECK-NEXT:   %4 = shufflevector <4 x double*> %"ptrs'ipg", <4 x double*> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %5 = icmp eq <4 x double*> %"ptrs'ipg", %4
+; CHECK-NEXT:   %6 = shufflevector <4 x double> %3, <4 x double> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %7 = select fast <4 x i1> %5, <4 x double> %6, <4 x double> zeroinitializer
+; CHECK-NEXT:   %8 = fadd fast <4 x double> %3, %7
+; CHECK-NEXT:   %9 = shufflevector <4 x double*> %"ptrs'ipg", <4 x double*> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %10 = icmp eq <4 x double*> %"ptrs'ipg", %9
+; CHECK-NEXT:   %11 = shufflevector <4 x double> %3, <4 x double> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %12 = select fast <4 x i1> %10, <4 x double> %11, <4 x double> zeroinitializer
+; CHECK-NEXT:   %13 = fadd fast <4 x double> %8, %12
+; CHECK-NEXT:   %14 = shufflevector <4 x double*> %"ptrs'ipg", <4 x double*> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+; CHECK-NEXT:   %15 = icmp eq <4 x double*> %"ptrs'ipg", %14
+; CHECK-NEXT:   %16 = shufflevector <4 x double> %3, <4 x double> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+; CHECK-NEXT:   %17 = select fast <4 x i1> %15, <4 x double> %16, <4 x double> zeroinitializer
+; CHECK-NEXT:   %18 = fadd fast <4 x double> %13, %17
+; CHECK-NEXT:   %19 = call fast <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %"ptrs'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %20 = fadd fast <4 x double> %19, %18
+; CHECK-NEXT:   call void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double> %20, <4 x double*> %"ptrs'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -0,0 +1,39 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define void @tester(<4 x double> %v, double* %y, <4 x i64> %idx) {
+entry:
+  %ptrs = getelementptr inbounds double, double* %y, <4 x i64> %idx
+  call void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double> %v, <4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>)
+  ret void
+}
+
+define <4 x double> @test_derivative(<4 x double> %v, double* %y, double* %dy, <4 x i64> %idx) {
+entry:
+  %0 = call <4 x double> (...) @__enzyme_autodiff(void (<4 x double>, double*, <4 x i64>)* @tester, <4 x double> %v, double* %y, double* %dy, <4 x i64> %idx)
+  ret <4 x double> %0
+}
+
+declare void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double>, <4 x double*>, i32, <4 x i1>)
+declare <4 x double> @__enzyme_autodiff(...)
+
+; CHECK: define internal { <4 x double> } @diffetester(<4 x double> %v, double* %y, double* %"y'", <4 x i64> %idx)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"ptrs'ipg" = getelementptr inbounds double, double* %"y'", <4 x i64> %idx
+; CHECK-NEXT:   %ptrs = getelementptr inbounds double, double* %y, <4 x i64> %idx
+; CHECK-NEXT:   call void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double> %v, <4 x double*> %ptrs, i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>)
+; CHECK-NEXT:   %0 = shufflevector <4 x double*> %"ptrs'ipg", <4 x double*> undef, <4 x i32> <i32 1, i32 2, i32 3, i32 0>
+; CHECK-NEXT:   %1 = icmp eq <4 x double*> %"ptrs'ipg", %0
+; CHECK-NEXT:   %2 = and <4 x i1> %1, <i1 true, i1 true, i1 false, i1 true>
+; CHECK-NEXT:   %3 = and <4 x i1> %2, <i1 true, i1 true, i1 true, i1 false>
+; CHECK-NEXT:   %4 = shufflevector <4 x double*> %"ptrs'ipg", <4 x double*> undef, <4 x i32> <i32 2, i32 3, i32 0, i32 1>
+; CHECK-NEXT:   %5 = icmp eq <4 x double*> %"ptrs'ipg", %4
+; CHECK-NEXT:   %6 = and <4 x i1> %5, <i1 true, i1 false, i1 true, i1 true>
+; CHECK-NEXT:   %7 = and <4 x i1> %6, <i1 true, i1 true, i1 false, i1 false>
+; CHECK-NEXT:   %8 = or <4 x i1> %3, %7
+; CHECK-NEXT:   %9 = xor <4 x i1> %8, <i1 true, i1 true, i1 true, i1 true>
+; CHECK-NEXT:   %10 = and <4 x i1> <i1 true, i1 true, i1 true, i1 false>, %9
+; CHECK-NEXT:   %11 = call fast <4 x double> @llvm.masked.gather.v4f64.v4p0f64(<4 x double*> %"ptrs'ipg", i32 8, <4 x i1> %10, <4 x double> zeroinitializer)
+; CHECK-NEXT:   call void @llvm.masked.scatter.v4f64.v4p0f64(<4 x double> zeroinitializer, <4 x double*> %"ptrs'ipg", i32 8, <4 x i1> <i1 true, i1 true, i1 true, i1 false>)
+; CHECK-NEXT:   %12 = insertvalue { <4 x double> } undef, <4 x double> %11, 0
+; CHECK-NEXT:   ret { <4 x double> } %12
+; CHECK-NEXT: }
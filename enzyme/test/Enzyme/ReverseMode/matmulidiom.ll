@@ -0,0 +1,144 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -enzyme-matmul-idiom -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+; C[i][j] = sum_k A[i][k] * B[k][j], row major with leading dimensions n
+define void @matmul(double* noalias %A, double* noalias %B, double* noalias %C, i64 %n) {
+entry:
+  br label %for.i
+
+for.i:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.i.inc ]
+  %cmp.i = icmp slt i64 %i, %n
+  br i1 %cmp.i, label %for.j, label %exit
+
+for.j:
+  %j = phi i64 [ %j.next, %for.j.inc ], [ 0, %for.i ]
+  %cmp.j = icmp slt i64 %j, %n
+  br i1 %cmp.j, label %for.k, label %for.i.inc
+
+for.k:
+  %k = phi i64 [ %k.next, %for.k.body ], [ 0, %for.j ]
+  %sum = phi double [ %add, %for.k.body ], [ 0.000000e+00, %for.j ]
+  %cmp.k = icmp slt i64 %k, %n
+  br i1 %cmp.k, label %for.k.body, label %for.j.inc
+
+for.k.body:
+  %in = mul nsw i64 %i, %n
+  %ik = add nsw i64 %in, %k
+  %a.ptr = getelementptr inbounds double, double* %A, i64 %ik
+  %a = load double, double* %a.ptr
+  %kn = mul nsw i64 %k, %n
+  %kj = add nsw i64 %kn, %j
+  %b.ptr = getelementptr inbounds double, double* %B, i64 %kj
+  %b = load double, double* %b.ptr
+  %mul = fmul double %a, %b
+  %add = fadd double %sum, %mul
+  %k.next = add nuw nsw i64 %k, 1
+  br label %for.k
+
+for.j.inc:
+  %in2 = mul nsw i64 %i, %n
+  %ij = add nsw i64 %in2, %j
+  %c.ptr = getelementptr inbounds double, double* %C, i64 %ij
+  store double %sum, double* %c.ptr
+  %j.next = add nuw nsw i64 %j, 1
+  br label %for.j
+
+for.i.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  br label %for.i
+
+exit:
+  ret void
+}
+
+define void @dmatmul(double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %n) {
+entry:
+  call void (...) @__enzyme_autodiff(void (double*, double*, double*, i64)* @matmul, double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %n)
+  ret void
+}
+
+; The same product accumulated with fmuladd
+define void @matmulfma(double* noalias %A, double* noalias %B, double* noalias %C, i64 %n) {
+entry:
+  br label %for.i
+
+for.i:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.i.inc ]
+  %cmp.i = icmp slt i64 %i, %n
+  br i1 %cmp.i, label %for.j, label %exit
+
+for.j:
+  %j = phi i64 [ %j.next, %for.j.inc ], [ 0, %for.i ]
+  %cmp.j = icmp slt i64 %j, %n
+  br i1 %cmp.j, label %for.k, label %for.i.inc
+
+for.k:
+  %k = phi i64 [ %k.next, %for.k.body ], [ 0, %for.j ]
+  %sum = phi double [ %add, %for.k.body ], [ 0.000000e+00, %for.j ]
+  %cmp.k = icmp slt i64 %k, %n
+  br i1 %cmp.k, label %for.k.body, label %for.j.inc
+
+for.k.body:
+  %in = mul nsw i64 %i, %n
+  %ik = add nsw i64 %in, %k
+  %a.ptr = getelementptr inbounds double, double* %A, i64 %ik
+  %a = load double, double* %a.ptr
+  %kn = mul nsw i64 %k, %n
+  %kj = add nsw i64 %kn, %j
+  %b.ptr = getelementptr inbounds double, double* %B, i64 %kj
+  %b = load double, double* %b.ptr
+  %add = call double @llvm.fmuladd.f64(double %a, double %b, double %sum)
+  %k.next = add nuw nsw i64 %k, 1
+  br label %for.k
+
+for.j.inc:
+  %in2 = mul nsw i64 %i, %n
+  %ij = add nsw i64 %in2, %j
+  %c.ptr = getelementptr inbounds double, double* %C, i64 %ij
+  store double %sum, double* %c.ptr
+  %j.next = add nuw nsw i64 %j, 1
+  br label %for.j
+
+for.i.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  br label %for.i
+
+exit:
+  ret void
+}
+
+define void @dmatmulfma(double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %n) {
+entry:
+  call void (...) @__enzyme_autodiff(void (double*, double*, double*, i64)* @matmulfma, double* %A, double* %dA, double* %B, double* %dB, double* %C, double* %dC, i64 %n)
+  ret void
+}
+
+declare double @llvm.fmuladd.f64(double, double, double)
+
+declare void @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffematmul(double* noalias %A, double* %"A'", double* noalias %B, double* %"B'", double* noalias %C, double* %"C'", i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %smax = call i64 @llvm.smax.i64(i64 %n, i64 0)
+; CHECK-NEXT:   %0 = shl i64 %n, 3
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %n, i64 %n, double* %A, i64 %0, i64 8, double* %B, i64 %0, i64 8, double* %C, i64 %0, i64 8, i64 0)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %n, i64 %n, double* %"C'", i64 %0, i64 8, double* %B, i64 8, i64 %0, double* %"A'", i64 %0, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %n, i64 %n, i64 %smax, double* %A, i64 8, i64 %0, double* %"C'", i64 %0, i64 8, double* %"B'", i64 %0, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %n, i64 0, double* %"C'", i64 0, i64 0, double* %"C'", i64 0, i64 0, double* %"C'", i64 %0, i64 8, i64 0)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @__enzyme_matmul_fmuladd_double(
+; CHECK-NOT: fmul
+; CHECK: call double @llvm.fmuladd.f64(
+; CHECK-NOT: fadd
+; CHECK: define internal void @diffematmulfma(double* noalias %A, double* %"A'", double* noalias %B, double* %"B'", double* noalias %C, double* %"C'", i64 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %smax = call i64 @llvm.smax.i64(i64 %n, i64 0)
+; CHECK-NEXT:   %0 = shl i64 %n, 3
+; CHECK-NEXT:   call void @__enzyme_matmul_fmuladd_double(i64 %smax, i64 %n, i64 %n, double* %A, i64 %0, i64 8, double* %B, i64 %0, i64 8, double* %C, i64 %0, i64 8, i64 0)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %n, i64 %n, double* %"C'", i64 %0, i64 8, double* %B, i64 8, i64 %0, double* %"A'", i64 %0, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %n, i64 %n, i64 %smax, double* %A, i64 8, i64 %0, double* %"C'", i64 %0, i64 8, double* %"B'", i64 %0, i64 8, i64 1)
+; CHECK-NEXT:   call void @__enzyme_matmul_double(i64 %smax, i64 %n, i64 0, double* %"C'", i64 0, i64 0, double* %"C'", i64 0, i64 0, double* %"C'", i64 %0, i64 8, i64 0)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -0,0 +1,70 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.ompi_predefined_datatype_t = type opaque
+%struct.ompi_predefined_communicator_t = type opaque
+%struct.ompi_datatype_t = type opaque
+%struct.ompi_communicator_t = type opaque
+
+@random_datatype = external dso_local global %struct.ompi_predefined_datatype_t, align 4
+@ompi_mpi_comm_world = external dso_local global %struct.ompi_predefined_communicator_t, align 4
+
+define void @mpi_alltoall_test(double* %b, i8* %recv_buf) {
+entry:
+  %i8buf = bitcast double* %b to i8*
+  %call = call i32 @MPI_Alltoall(i8* nonnull %i8buf, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %recv_buf, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+  ret void
+}
+
+declare i32 @MPI_Alltoall(i8*, i32, %struct.ompi_datatype_t*, i8*, i32, %struct.ompi_datatype_t*, %struct.ompi_communicator_t*) local_unnamed_addr
+
+define void @caller(double* %b, double* %db, double* %vla, double* %vla3) local_unnamed_addr  {
+entry:
+  call void (i8*, ...) @__enzyme_autodiff(i8* bitcast (void (double*, i8*)* @mpi_alltoall_test to i8*), metadata !"enzyme_dup", double* %b, double* %db, metadata !"enzyme_dup", double* %vla, double* %vla3)
+  ret void
+}
+
+declare void @__enzyme_autodiff(i8*, ...)
+
+; CHECK: define internal void @diffempi_alltoall_test(double* %b, double* %"b'", i8* %recv_buf, i8* %"recv_buf'") #0 {
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = alloca i32, align 4
+; CHECK-NEXT:   %1 = alloca i32, align 4
+; CHECK-NEXT:   %2 = alloca i32, align 4
+; CHECK-NEXT:   %i8buf = bitcast double* %b to i8*
+; CHECK-NEXT:   %call = call i32 @MPI_Alltoall(i8* nonnull %i8buf, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %recv_buf, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+; CHECK-NEXT:   %3 = call i32 @MPI_Comm_size(%struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i32* %0)
+; CHECK-NEXT:   %4 = load i32, i32* %0, align 4
+; CHECK-NEXT:   %5 = zext i32 %4 to i64
+; CHECK-NEXT:   %6 = call i32 @MPI_Type_size(i8* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to i8*), i32* %1)
+; CHECK-NEXT:   %7 = load i32, i32* %1, align 4
+; CHECK-NEXT:   %8 = zext i32 %7 to i64
+; CHECK-NEXT:   %9 = mul nuw nsw i64 %8, %5
+; CHECK-NEXT:   %10 = call i32 @MPI_Type_size(i8* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to i8*), i32* %2)
+; CHECK-NEXT:   %11 = load i32, i32* %2, align 4
+; CHECK-NEXT:   %12 = zext i32 %11 to i64
+; CHECK-NEXT:   %13 = mul nuw nsw i64 %12, %5
+; CHECK-NEXT:   %14 = tail call noalias nonnull i8* @malloc(i64 %9)
+; CHECK-NEXT:   %15 = call i32 @MPI_Alltoall(i8* %"recv_buf'", i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %14, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+; CHECK-NEXT:   call void @llvm.memset.p0i8.i64(i8* nonnull %"recv_buf'", i8 0, i64 %13, i1 false)
+; CHECK-NEXT:   %16 = bitcast i8* %14 to double*
+; CHECK-NEXT:   %17 = udiv i64 %9, 8
+; CHECK-NEXT:   %18 = icmp eq i64 %17, 0
+; CHECK-NEXT:   br i1 %18, label %__enzyme_memcpyadd_doubleda1sa1.exit, label %for.body.i
+
+; CHECK: for.body.i:                                       ; preds = %for.body.i, %entry
+; CHECK-NEXT:   %idx.i = phi i64 [ 0, %entry ], [ %idx.next.i, %for.body.i ]
+; CHECK-NEXT:   %dst.i.i = getelementptr inbounds double, double* %16, i64 %idx.i
+; CHECK-NEXT:   %dst.i.l.i = load double, double* %dst.i.i, align 1
+; CHECK-NEXT:   store double 0.000000e+00, double* %dst.i.i, align 1
+; CHECK-NEXT:   %src.i.i = getelementptr inbounds double, double* %"b'", i64 %idx.i
+; CHECK-NEXT:   %src.i.l.i = load double, double* %src.i.i, align 1
+; CHECK-NEXT:   %19 = fadd fast double %src.i.l.i, %dst.i.l.i
+; CHECK-NEXT:   store double %19, double* %src.i.i, align 1
+; CHECK-NEXT:   %idx.next.i = add nuw i64 %idx.i, 1
+; CHECK-NEXT:   %20 = icmp eq i64 %17, %idx.next.i
+; CHECK-NEXT:   br i1 %20, label %__enzyme_memcpyadd_doubleda1sa1.exit, label %for.body.i
+
+; CHECK: __enzyme_memcpyadd_doubleda1sa1.exit:             ; preds = %entry, %for.body.i
+; CHECK-NEXT:   tail call void @free(i8* nonnull %14)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
@@ -0,0 +1,46 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.ompi_predefined_datatype_t = type opaque
+%struct.ompi_predefined_communicator_t = type opaque
+%struct.ompi_datatype_t = type opaque
+%struct.ompi_communicator_t = type opaque
+
+@random_datatype = external dso_local global %struct.ompi_predefined_datatype_t, align 4
+@ompi_mpi_comm_world = external dso_local global %struct.ompi_predefined_communicator_t, align 4
+
+define void @mpi_alltoallv_test(double* %b, i8* %recv_buf, i32* %scounts, i32* %sdispls, i32* %rcounts, i32* %rdispls) {
+entry:
+  %i8buf = bitcast double* %b to i8*
+  %call = call i32 @MPI_Alltoallv(i8* nonnull %i8buf, i32* %scounts, i32* %sdispls, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %recv_buf, i32* %rcounts, i32* %rdispls, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+  ret void
+}
+
+declare i32 @MPI_Alltoallv(i8*, i32*, i32*, %struct.ompi_datatype_t*, i8*, i32*, i32*, %struct.ompi_datatype_t*, %struct.ompi_communicator_t*) local_unnamed_addr
+
+define void @caller(double* %b, double* %db, double* %vla, double* %vla3, i32* %sc, i32* %sd, i32* %rc, i32* %rd) local_unnamed_addr  {
+entry:
+  call void (i8*, ...) @__enzyme_autodiff(i8* bitcast (void (double*, i8*, i32*, i32*, i32*, i32*)* @mpi_alltoallv_test to i8*), metadata !"enzyme_dup", double* %b, double* %db, metadata !"enzyme_dup", double* %vla, double* %vla3, metadata !"enzyme_const", i32* %sc, metadata !"enzyme_const", i32* %sd, metadata !"enzyme_const", i32* %rc, metadata !"enzyme_const", i32* %rd)
+  ret void
+}
+
+declare void @__enzyme_autodiff(i8*, ...)
+
+; CHECK: define internal void @diffempi_alltoallv_test(double* %b, double* %"b'", i8* %recv_buf, i8* %"recv_buf'", i32* %scounts, i32* %sdispls, i32* %rcounts, i32* %rdispls)
+; CHECK: %mpicounts_malloccache = bitcast i8* %malloccall to i32*
+; CHECK: %[[scount:.+]] = getelementptr inbounds i32, i32* %scounts, i64 %idx.i
+; CHECK: %[[rcount:.+]] = getelementptr inbounds i32, i32* %rcounts, i64 %idx.i4
+; CHECK: %call = call i32 @MPI_Alltoallv(i8* nonnull %i8buf, i32* %scounts, i32* %sdispls, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %recv_buf, i32* %rcounts, i32* %rdispls, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+; CHECK: %[[packed:.+]] = tail call noalias nonnull i8* @malloc(i64
+; CHECK: %dseg.i = getelementptr inbounds i8, i8* %"recv_buf'", i64
+; CHECK-NEXT: %pseg.i = getelementptr inbounds i8, i8* %[[packed]], i64
+; CHECK-NEXT: call void @llvm.memcpy.p0i8.p0i8.i64(i8* %pseg.i, i8* %dseg.i, i64 %seg.len.i, i1 false)
+; CHECK-NEXT: call void @llvm.memset.p0i8.i64(i8* %dseg.i, i8 0, i64 %seg.len.i, i1 false)
+; CHECK: %[[buf:.+]] = tail call noalias nonnull i8* @malloc(i64
+; CHECK: call i32 @MPI_Alltoallv(i8* %[[packed]], i32* %{{.+}}, i32* %{{.+}}, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i8* %[[buf]], i32* %{{.+}}, i32* %{{.+}}, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+; CHECK: %dseg.i17 = getelementptr inbounds i8, i8* %"i8buf'ipc", i64
+; CHECK-NEXT: %pseg.i18 = getelementptr inbounds i8, i8* %[[buf]], i64
+; CHECK: call void @__enzyme_memcpyadd_doubleda1sa1(double* %{{.+}}, double* %{{.+}}, i64 %{{.+}})
+; CHECK: tail call void @free(i8* nonnull %[[packed]])
+; CHECK-NEXT: tail call void @free(i8* nonnull %[[buf]])
+; CHECK-NEXT: tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT: ret void
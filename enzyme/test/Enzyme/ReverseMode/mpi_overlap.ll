@@ -0,0 +1,79 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-mpi-overlap -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.ompi_predefined_datatype_t = type opaque
+%struct.ompi_predefined_communicator_t = type opaque
+%struct.ompi_predefined_op_t = type opaque
+%struct.ompi_datatype_t = type opaque
+%struct.ompi_communicator_t = type opaque
+%struct.ompi_op_t = type opaque
+
+@ompi_mpi_double = external dso_local global %struct.ompi_predefined_datatype_t, align 4
+@ompi_mpi_comm_world = external dso_local global %struct.ompi_predefined_communicator_t, align 4
+@ompi_mpi_op_sum = external dso_local global %struct.ompi_predefined_op_t, align 1
+
+define void @mpi_overlap_test(double* noalias %x, double* noalias %y, double* noalias %z, double* noalias %r, i32 %peer) {
+entry:
+  %x0 = load double, double* %x, align 8
+  %sq = fmul double %x0, %x0
+  %y0 = load double, double* %y, align 8
+  %y1 = fmul double %y0, %y0
+  store double %y1, double* %y, align 8
+  %xb = bitcast double* %x to i8*
+  %call = call i32 @MPI_Send(i8* %xb, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @ompi_mpi_double to %struct.ompi_datatype_t*), i32 %peer, i32 0, %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+  store double %sq, double* %z, align 8
+  %zb = bitcast double* %z to i8*
+  %rb = bitcast double* %r to i8*
+  %call2 = call i32 @MPI_Allreduce(i8* %zb, i8* %rb, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @ompi_mpi_double to %struct.ompi_datatype_t*), %struct.ompi_op_t* bitcast (%struct.ompi_predefined_op_t* @ompi_mpi_op_sum to %struct.ompi_op_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*))
+  ret void
+}
+
+declare i32 @MPI_Send(i8*, i32, %struct.ompi_datatype_t*, i32, i32, %struct.ompi_communicator_t*)
+
+declare i32 @MPI_Allreduce(i8*, i8*, i32, %struct.ompi_datatype_t*, %struct.ompi_op_t*, %struct.ompi_communicator_t*)
+
+define void @caller(double* %x, double* %dx, double* %y, double* %dy, double* %z, double* %dz, double* %r, double* %dr, i32 %peer) {
+entry:
+  call void (i8*, ...) @__enzyme_autodiff(i8* bitcast (void (double*, double*, double*, double*, i32)* @mpi_overlap_test to i8*), metadata !"enzyme_dup", double* %x, double* %dx, metadata !"enzyme_dup", double* %y, double* %dy, metadata !"enzyme_dup", double* %z, double* %dz, metadata !"enzyme_dup", double* %r, double* %dr, i32 %peer)
+  ret void
+}
+
+declare void @__enzyme_autodiff(i8*, ...)
+
+; CHECK: define internal void @diffempi_overlap_test(double* noalias %x, double* %"x'", double* noalias %y, double* %"y'", double* noalias %z, double* %"z'", double* noalias %r, double* %"r'", i32 %peer)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %mpi_adjoint_req = alloca i8*, align 8
+; CHECK-NEXT:   %0 = alloca [24 x i8], align 1
+; CHECK-NEXT:   %mpi_adjoint_req1 = alloca i8*, align 8
+; CHECK-NEXT:   %1 = alloca [24 x i8], align 1
+; CHECK:        %call2 = call i32 @MPI_Allreduce(i8* %zb, i8* %rb,
+; CHECK-NEXT:   %2 = tail call noalias nonnull dereferenceable(8) dereferenceable_or_null(8) i8* @malloc(i64 8)
+; CHECK-NEXT:   %3 = call i32 @MPI_Iallreduce(i8* %"rb'ipc", i8* %2, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @ompi_mpi_double to %struct.ompi_datatype_t*), %struct.ompi_op_t* bitcast (%struct.ompi_predefined_op_t* @ompi_mpi_op_sum to %struct.ompi_op_t*), %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i8** %mpi_adjoint_req)
+; CHECK-NEXT:   %4 = call i32 @MPI_Wait(i8** %mpi_adjoint_req, [24 x i8]* %0)
+; CHECK-NEXT:   call void @llvm.memset.p0i8.i64(i8* nonnull %"rb'ipc", i8 0, i64 8, i1 false)
+
+; CHECK: __enzyme_memcpyadd_doubleda1sa1.exit:
+; CHECK-NEXT:   tail call void @free(i8* nonnull %2)
+; CHECK-NEXT:   %8 = load double, double* %"z'", align 8
+; CHECK-NEXT:   store double 0.000000e+00, double* %"z'", align 8
+; CHECK-NEXT:   %9 = tail call noalias nonnull dereferenceable(8) dereferenceable_or_null(8) i8* @malloc(i64 8)
+; CHECK-NEXT:   %10 = call i32 @MPI_Irecv(i8* %9, i32 1, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @ompi_mpi_double to %struct.ompi_datatype_t*), i32 %peer, i32 0, %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i8** %mpi_adjoint_req1)
+; CHECK-NEXT:   %11 = load double, double* %"y'", align 8
+; CHECK-NEXT:   store double 0.000000e+00, double* %"y'", align 8
+; CHECK-NEXT:   %m0diffey0 = fmul fast double %11, %y0
+; CHECK-NEXT:   %m1diffey0 = fmul fast double %11, %y0
+; CHECK-NEXT:   %12 = fadd fast double %m0diffey0, %m1diffey0
+; CHECK-NEXT:   %13 = load double, double* %"y'", align 8
+; CHECK-NEXT:   %14 = fadd fast double %13, %12
+; CHECK-NEXT:   store double %14, double* %"y'", align 8
+; CHECK-NEXT:   %m0diffex0 = fmul fast double %8, %x0
+; CHECK-NEXT:   %m1diffex0 = fmul fast double %8, %x0
+; CHECK-NEXT:   %15 = fadd fast double %m0diffex0, %m1diffex0
+; CHECK-NEXT:   %16 = call i32 @MPI_Wait(i8** %mpi_adjoint_req1, [24 x i8]* %1)
+
+; CHECK: __enzyme_memcpyadd_doubleda1sa1.exit9:
+; CHECK-NEXT:   tail call void @free(i8* nonnull %9)
+; CHECK-NEXT:   %20 = load double, double* %"x'", align 8
+; CHECK-NEXT:   %21 = fadd fast double %20, %15
+; CHECK-NEXT:   store double %21, double* %"x'", align 8
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
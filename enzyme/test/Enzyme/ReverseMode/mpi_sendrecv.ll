@@ -0,0 +1,68 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.ompi_predefined_datatype_t = type opaque
+%struct.ompi_predefined_communicator_t = type opaque
+%struct.ompi_datatype_t = type opaque
+%struct.ompi_communicator_t = type opaque
+
+@random_datatype = external dso_local global %struct.ompi_predefined_datatype_t, align 4
+@ompi_mpi_comm_world = external dso_local global %struct.ompi_predefined_communicator_t, align 4
+
+define void @mpi_sendrecv_test(double* %b, i8* %recv_buf, i32 %dest, i32 %src, i8* %status) {
+entry:
+  %i8buf = bitcast double* %b to i8*
+  %call = call i32 @MPI_Sendrecv(i8* nonnull %i8buf, i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %dest, i32 3, i8* %recv_buf, i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %src, i32 4, %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i8* %status)
+  ret void
+}
+
+declare i32 @MPI_Sendrecv(i8*, i32, %struct.ompi_datatype_t*, i32, i32, i8*, i32, %struct.ompi_datatype_t*, i32, i32, %struct.ompi_communicator_t*, i8*) local_unnamed_addr
+
+define void @caller(double* %b, double* %db, double* %vla, double* %vla3, i32 %dest, i32 %src, i8* %status) local_unnamed_addr  {
+entry:
+  call void (i8*, ...) @__enzyme_autodiff(i8* bitcast (void (double*, i8*, i32, i32, i8*)* @mpi_sendrecv_test to i8*), metadata !"enzyme_dup", double* %b, double* %db, metadata !"enzyme_dup", double* %vla, double* %vla3, i32 %dest, i32 %src, metadata !"enzyme_const", i8* %status)
+  ret void
+}
+
+declare void @__enzyme_autodiff(i8*, ...)
+
+; CHECK: define internal void @diffempi_sendrecv_test(double* %b, double* %"b'", i8* %recv_buf, i8* %"recv_buf'", i32 %dest, i32 %src, i8* %status) #0 {
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %[[scratch:.+]] = alloca [24 x i8], align 1
+; CHECK-NEXT:   %[[s0:.+]] = alloca i32, align 4
+; CHECK-NEXT:   %[[s1:.+]] = alloca i32, align 4
+; CHECK-NEXT:   %i8buf = bitcast double* %b to i8*
+; CHECK-NEXT:   %call = call i32 @MPI_Sendrecv(i8* nonnull %i8buf, i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %dest, i32 3, i8* %recv_buf, i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %src, i32 4, %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i8* %status)
+; CHECK-NEXT:   %[[st:.+]] = bitcast [24 x i8]* %[[scratch]] to i8*
+; CHECK-NEXT:   %{{.+}} = call i32 @MPI_Type_size(i8* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to i8*), i32* %[[s0]])
+; CHECK-NEXT:   %[[ts0:.+]] = load i32, i32* %[[s0]], align 4
+; CHECK-NEXT:   %[[ts0e:.+]] = zext i32 %[[ts0]] to i64
+; CHECK-NEXT:   %[[sendlen:.+]] = mul nuw nsw i64 2, %[[ts0e]]
+; CHECK-NEXT:   %{{.+}} = call i32 @MPI_Type_size(i8* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to i8*), i32* %[[s1]])
+; CHECK-NEXT:   %[[ts1:.+]] = load i32, i32* %[[s1]], align 4
+; CHECK-NEXT:   %[[ts1e:.+]] = zext i32 %[[ts1]] to i64
+; CHECK-NEXT:   %[[recvlen:.+]] = mul nuw nsw i64 2, %[[ts1e]]
+; CHECK-NEXT:   %[[buf:.+]] = tail call noalias nonnull i8* @malloc(i64 %[[sendlen]])
+; CHECK-NEXT:   %{{.+}} = call i32 @MPI_Sendrecv(i8* %"recv_buf'", i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %src, i32 4, i8* %[[buf]], i32 2, %struct.ompi_datatype_t* bitcast (%struct.ompi_predefined_datatype_t* @random_datatype to %struct.ompi_datatype_t*), i32 %dest, i32 3, %struct.ompi_communicator_t* bitcast (%struct.ompi_predefined_communicator_t* @ompi_mpi_comm_world to %struct.ompi_communicator_t*), i8* %[[st]])
+; CHECK-NEXT:   call void @llvm.memset.p0i8.i64(i8* nonnull %"recv_buf'", i8 0, i64 %[[recvlen]], i1 false)
+; CHECK-NEXT:   %[[bufd:.+]] = bitcast i8* %[[buf]] to double*
+; CHECK-NEXT:   %[[n:.+]] = udiv i64 %[[sendlen]], 8
+; CHECK-NEXT:   %[[z:.+]] = icmp eq i64 %[[n]], 0
+; CHECK-NEXT:   br i1 %[[z]], label %__enzyme_memcpyadd_doubleda1sa1.exit, label %for.body.i
+
+; CHECK: for.body.i:                                       ; preds = %for.body.i, %entry
+; CHECK-NEXT:   %idx.i = phi i64 [ 0, %entry ], [ %idx.next.i, %for.body.i ]
+; CHECK-NEXT:   %dst.i.i = getelementptr inbounds double, double* %[[bufd]], i64 %idx.i
+; CHECK-NEXT:   %dst.i.l.i = load double, double* %dst.i.i, align 1
+; CHECK-NEXT:   store double 0.000000e+00, double* %dst.i.i, align 1
+; CHECK-NEXT:   %src.i.i = getelementptr inbounds double, double* %"b'", i64 %idx.i
+; CHECK-NEXT:   %src.i.l.i = load double, double* %src.i.i, align 1
+; CHECK-NEXT:   %[[sum:.+]] = fadd fast double %src.i.l.i, %dst.i.l.i
+; CHECK-NEXT:   store double %[[sum]], double* %src.i.i, align 1
+; CHECK-NEXT:   %idx.next.i = add nuw i64 %idx.i, 1
+; CHECK-NEXT:   %[[done:.+]] = icmp eq i64 %[[n]], %idx.next.i
+; CHECK-NEXT:   br i1 %[[done]], label %__enzyme_memcpyadd_doubleda1sa1.exit, label %for.body.i
+
+; CHECK: __enzyme_memcpyadd_doubleda1sa1.exit:             ; preds = %entry, %for.body.i
+; CHECK-NEXT:   tail call void @free(i8* nonnull %[[buf]])
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
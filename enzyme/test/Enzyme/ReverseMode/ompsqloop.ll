@@ -149,10 +149,10 @@ attributes #1 = { argmemonly }
 ; CHECK-NEXT:   %arrayidx = getelementptr inbounds double, double* %tmp, i64 %[[true1iv]]
 ; CHECK-NEXT:   %[[ld:.+]] = load double, double* %arrayidx, align 8, !tbaa !9
 ; CHECK-NEXT:   %call = call double @sqrt(double %[[ld]])
-; CHECK-NEXT:   store double %call, double* %arrayidx, align 8, !tbaa !9
 ; CHECK-NEXT:   %[[trueiv:.+]] = add nuw nsw i64 %iv, %[[lb]]
 ; CHECK-NEXT:   %[[loc:.+]] = getelementptr inbounds double, double* %0, i64 %[[trueiv]]
-; CHECK-NEXT:   store double %[[ld]], double* %[[loc]], align 8, !tbaa !9, !invariant.group !
+; CHECK-NEXT:   store double %call, double* %[[loc]], align 8, !invariant.group !
+; CHECK-NEXT:   store double %call, double* %arrayidx, align 8, !tbaa !9
 ; CHECK-NEXT:   %add11 = add nuw i64 %[[true1iv]], 1
 ; CHECK-NEXT:   %add = add nuw i64 %cond, 1
 ; CHECK-NEXT:   %cmp7 = icmp ult i64 %add11, %add
@@ -209,10 +209,9 @@ attributes #1 = { argmemonly }
 ; CHECK-NEXT:   store double 0.000000e+00, double* %"arrayidx'ipg_unwrap", align 8
 ; CHECK-NEXT:   %[[i9:.+]] = add nuw nsw i64 %"iv'ac.0", %_unwrap2
 ; CHECK-NEXT:   %[[i10:.+]] = getelementptr inbounds double, double* %truetape, i64 %[[i9]]
-; CHECK-NEXT:   %[[i11:.+]] = load double, double* %[[i10]], align 8, !tbaa !9, !invariant.group !
-; CHECK-NEXT:   %[[i12:.+]] = call fast double @sqrt(double %[[i11]])
+; CHECK-NEXT:   %[[i11:.+]] = load double, double* %[[i10]], align 8, !invariant.group !
 ; CHECK-NEXT:   %[[i13:.+]] = fmul fast double 5.000000e-01, %[[i8]]
-; CHECK-NEXT:   %[[i14:.+]] = fdiv fast double %[[i13]], %[[i12]]
+; CHECK-NEXT:   %[[i14:.+]] = fdiv fast double %[[i13]], %[[i11]]
 ; CHECK-NEXT:   %[[i15:.+]] = fcmp fast oeq double %[[i11]], 0.000000e+00
 ; CHECK-NEXT:   %[[i16:.+]] = select fast i1 %[[i15]], double 0.000000e+00, double %[[i14]]
 ; CHECK-NEXT:   %[[i17:.+]] = atomicrmw fadd double* %"arrayidx'ipg_unwrap", double %[[i16]] monotonic
@@ -0,0 +1,73 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+%struct.S = type { double*, double* }
+
+@__enzyme_register_parallel_for = global [1 x i8*] [i8* bitcast (void (i32, i32, void (i32, %struct.S*)*, %struct.S*)* @parallel_for to i8*)]
+
+declare void @parallel_for(i32, i32, void (i32, %struct.S*)*, %struct.S*)
+
+define internal void @body(i32 %i, %struct.S* %s) {
+entry:
+  %xp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 0
+  %x = load double*, double** %xp, align 8
+  %yp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 1
+  %y = load double*, double** %yp, align 8
+  %idx = sext i32 %i to i64
+  %xi.p = getelementptr inbounds double, double* %x, i64 %idx
+  %xi = load double, double* %xi.p, align 8
+  %sq = fmul double %xi, %xi
+  %yi.p = getelementptr inbounds double, double* %y, i64 %idx
+  store double %sq, double* %yi.p, align 8
+  ret void
+}
+
+define void @f(double* %x, double* %y, i32 %n) {
+entry:
+  %s = alloca %struct.S, align 8
+  %xp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 0
+  store double* %x, double** %xp, align 8
+  %yp = getelementptr inbounds %struct.S, %struct.S* %s, i64 0, i32 1
+  store double* %y, double** %yp, align 8
+  call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @body, %struct.S* %s)
+  ret void
+}
+
+define void @df(double* %x, double* %dx, double* %y, double* %dy, i32 %n) {
+entry:
+  call void (...) @__enzyme_autodiff(void (double*, double*, i32)* @f, double* %x, double* %dx, double* %y, double* %dy, i32 %n)
+  ret void
+}
+
+
+declare void @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffef(double* %x, double* %"x'", double* %y, double* %"y'", i32 %n)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = alloca { %struct.S*, %struct.S*, { double*, double*, double }*, i32 }
+; CHECK-NEXT:   %1 = alloca { %struct.S*, %struct.S*, { double*, double*, double }*, i32 }
+; CHECK-NEXT:   %"s'ipa" = alloca %struct.S
+; CHECK:        %mallocsize = mul nuw nsw i64 %{{.*}}, 24
+; CHECK-NEXT:   %malloccall = tail call noalias nonnull i8* @malloc(i64 %mallocsize)
+; CHECK-NEXT:   %tapes = bitcast i8* %malloccall to { double*, double*, double }*
+; CHECK:        call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @augmented_body_parallel, %struct.S* %{{.*}})
+; CHECK:        call void @parallel_for(i32 0, i32 %n, void (i32, %struct.S*)* @diffebody_parallel, %struct.S* %{{.*}})
+; CHECK-NEXT:   tail call void @free(i8* nonnull %malloccall)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
+
+; CHECK: define internal void @augmented_body_parallel(i32 %0, %struct.S* %1)
+; CHECK:        %[[aug:.+]] = call { double*, double*, double } @augmented_body(i32 %0, %struct.S* %{{.*}}, %struct.S* %{{.*}})
+; CHECK-NEXT:   %[[off:.+]] = sub i32 %0, %{{.*}}
+; CHECK-NEXT:   %[[slot:.+]] = getelementptr { double*, double*, double }, { double*, double*, double }* %{{.*}}, i32 %[[off]]
+; CHECK-NEXT:   store { double*, double*, double } %[[aug]], { double*, double*, double }* %[[slot]]
+; CHECK-NEXT:   ret void
+
+; CHECK: define internal void @diffebody(i32 %i, %struct.S* %s, %struct.S* %"s'", { double*, double*, double } %tapeArg)
+; CHECK:        atomicrmw fadd double* %"xi.p'ipg", double %{{.*}} monotonic
+
+; CHECK: define internal void @diffebody_parallel(i32 %0, %struct.S* %1)
+; CHECK:        %[[off:.+]] = sub i32 %0, %{{.*}}
+; CHECK-NEXT:   %[[slot:.+]] = getelementptr { double*, double*, double }, { double*, double*, double }* %{{.*}}, i32 %[[off]]
+; CHECK-NEXT:   %[[tape:.+]] = load { double*, double*, double }, { double*, double*, double }* %[[slot]]
+; CHECK-NEXT:   call void @diffebody(i32 %0, %struct.S* %{{.*}}, %struct.S* %{{.*}}, { double*, double*, double } %[[tape]])
+; CHECK-NEXT:   ret void
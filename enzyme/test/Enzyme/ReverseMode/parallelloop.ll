@@ -0,0 +1,150 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -enzyme-parallel-reverse-loops -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define void @f(double* noalias %x, double* noalias %out, double %a, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %v = load double, double* %px
+  %m = fmul double %v, %v
+  %m2 = fmul double %m, %a
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  store double %m2, double* %po
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define double @test(double* %x, double* %dx, double* %out, double* %dout, double %a, i64 %n) {
+entry:
+  %r = call double (...) @__enzyme_autodiff(void (double*, double*, double, i64)* @f, double* %x, double* %dx, double* %out, double* %dout, double %a, i64 %n)
+  ret double %r
+}
+
+; x[i + 1] is also read on the next iteration, so its shadow is shared.
+define void @g(double* noalias %x, double* noalias %out, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %v = load double, double* %px
+  %inc = add nuw nsw i64 %i, 1
+  %pn = getelementptr inbounds double, double* %x, i64 %inc
+  %w = load double, double* %pn
+  %m = fmul double %v, %w
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  store double %m, double* %po
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @testg(double* %x, double* %dx, double* %out, double* %dout, i64 %n) {
+entry:
+  call void (...) @__enzyme_autodiff_g(void (double*, double*, i64)* @g, double* %x, double* %dx, double* %out, double* %dout, i64 %n)
+  ret void
+}
+
+declare void @__enzyme_autodiff_g(...)
+
+; Only the inner loop is independent, so its reverse pass forks once per outer
+; iteration and the adjoint of a must be gathered afresh each time.
+define void @h(double* noalias %x, double* noalias %out, double %a, i64 %n, i64 %t) {
+entry:
+  br label %outer
+
+outer:
+  %j = phi i64 [ 0, %entry ], [ %jinc, %outer.latch ]
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %outer ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %v = load double, double* %px
+  %m = fmul double %v, %a
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  %o = load double, double* %po
+  %s = fadd double %o, %m
+  store double %s, double* %po
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %outer.latch
+
+outer.latch:
+  %jinc = add nuw nsw i64 %j, 1
+  %cj = icmp ult i64 %jinc, %t
+  br i1 %cj, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+define double @testh(double* %x, double* %dx, double* %out, double* %dout, double %a, i64 %n, i64 %t) {
+entry:
+  %r = call double (...) @__enzyme_autodiff_h(void (double*, double*, double, i64, i64)* @h, double* %x, double* %dx, double* %out, double* %dout, double %a, i64 %n, i64 %t)
+  ret double %r
+}
+
+declare double @__enzyme_autodiff_h(...)
+
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal { double } @diffef(double* noalias %x, double* %"x'", double* noalias %out, double* %"out'", double %a, i64 %n)
+; CHECK: %[[da:.+]] = alloca { i64 }
+; CHECK: %umax = call i64 @llvm.umax.i64(i64 %n, i64 1)
+; CHECK: %[[abits:.+]] = bitcast double %a to i64
+; CHECK: call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @enzyme_omp_ident.2, i32 8, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, i64, double*, double*, i64, double**)* @augmented_preprocess_f.omp_outlined{{.*}} to void (i32*, i32*, ...)*), i64 %umax, double* %x, double* %"x'", i64 %[[abits]], double* %out, double* %"out'", i64 %n, double** %{{.*}})
+; CHECK: store { i64 } zeroinitializer, { i64 }* %[[da]]
+; CHECK-NEXT: call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call(%struct.ident_t* @enzyme_omp_ident.2, i32 9, void (i32*, i32*, ...)* bitcast (void (i32*, i32*, i64, double*, double*, i64, double*, double*, i64, double**, { i64 }*)* @"diffepreprocess_f.omp_outlined#out" to void (i32*, i32*, ...)*), i64 %umax, double* %x, double* %"x'", i64 %[[abits]], double* %out, double* %"out'", i64 %n, double** %{{.*}}, { i64 }* %[[da]])
+; CHECK: %[[dap:.+]] = getelementptr inbounds { i64 }, { i64 }* %[[da]], i64 0, i32 0
+; CHECK-NEXT: %[[dai:.+]] = load i64, i64* %[[dap]]
+; CHECK: %[[daf:.+]] = bitcast i64 %[[dai]] to double
+; CHECK-NEXT: %[[res:.+]] = insertvalue { double } undef, double %[[daf]], 0
+; CHECK-NEXT: ret { double } %[[res]]
+
+; CHECK: define internal { i64 } @diffepreprocess_f.omp_outlined(i32* noalias %0, i32* noalias %1, i64 %2, double* %x, double* %"x'", i64 %a, double* %out, double* %"out'", i64 %n, double** %tapeArg)
+; CHECK: call void @__kmpc_for_static_init_8u(%struct.ident_t* @enzyme_omp_ident.514
+; CHECK: invertomp.entry:
+; CHECK-NEXT: %[[de:.+]] = phi double
+; CHECK-NEXT: call void @__kmpc_for_static_fini(%struct.ident_t* @enzyme_omp_ident.514
+; CHECK-NEXT: %[[debits:.+]] = bitcast double %[[de]] to i64
+; CHECK-NEXT: %[[ret:.+]] = insertvalue { i64 } undef, i64 %[[debits]], 0
+; CHECK-NEXT: ret { i64 } %[[ret]]
+; CHECK: invertloop:
+; CHECK: %"po'ipg_unwrap" = getelementptr inbounds double, double* %"out'", i64 %_unwrap
+; CHECK: %"px'ipg_unwrap" = getelementptr inbounds double, double* %"x'", i64 %_unwrap
+; CHECK-NOT: atomicrmw
+; CHECK-NEXT: %[[old:.+]] = load double, double* %"px'ipg_unwrap"
+; CHECK-NEXT: %[[new:.+]] = fadd fast double %[[old]], %{{.*}}
+; CHECK-NEXT: store double %[[new]], double* %"px'ipg_unwrap"
+
+; CHECK: define internal void @"diffepreprocess_f.omp_outlined#out"
+; CHECK: %[[sum:.+]] = call { i64 } @diffepreprocess_f.omp_outlined(
+; CHECK: atomicrmw fadd double* %{{.*}}, double %{{.*}} monotonic
+
+; CHECK: define internal void @diffepreprocess_g.omp_outlined(
+; CHECK: invertloop:
+; CHECK: %"pn'ipg_unwrap" = getelementptr inbounds double, double* %"x'", i64 %iv.next_unwrap
+; CHECK-NEXT: atomicrmw fadd double* %"pn'ipg_unwrap"
+; CHECK-NEXT: %"px'ipg_unwrap" = getelementptr inbounds double, double* %"x'", i64 %_unwrap
+; CHECK-NEXT: atomicrmw fadd double* %"px'ipg_unwrap"
+
+; CHECK: define internal { double } @diffeh(double* noalias %x, double* %"x'", double* noalias %out, double* %"out'", double %a, i64 %n, i64 %t)
+; CHECK: %[[dah:.+]] = alloca { i64 }
+; CHECK: invertouter.latch:
+; CHECK-NEXT: %[[acc:.+]] = phi double [ %[[next:.+]], %incinvertouter ], [ 0.000000e+00, %outer ]
+; CHECK: store { i64 } zeroinitializer, { i64 }* %[[dah]]
+; CHECK-NEXT: call void (%struct.ident_t*, i32, void (i32*, i32*, ...)*, ...) @__kmpc_fork_call({{.*}}@"diffepreprocess_h.omp_outlined#out"{{.*}}, { i64 }* %[[dah]])
+; CHECK-NEXT: %[[dahp:.+]] = getelementptr inbounds { i64 }, { i64 }* %[[dah]], i64 0, i32 0
+; CHECK-NEXT: %[[dahi:.+]] = load i64, i64* %[[dahp]]
+; CHECK: %[[dahf:.+]] = bitcast i64 %[[dahi]] to double
+; CHECK-NEXT: %[[next]] = fadd fast double %[[acc]], %[[dahf]]
@@ -0,0 +1,34 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define double @tester(double %x) {
+entry:
+  %0 = tail call fast double @llvm.sin.f64(double %x)
+  %1 = tail call fast double @llvm.cos.f64(double %x)
+  %2 = fmul fast double %0, %1
+  ret double %2
+}
+
+define double @test_derivative(double %x) {
+entry:
+  %0 = tail call double (double (double)*, ...) @__enzyme_autodiff(double (double)* nonnull @tester, double %x)
+  ret double %0
+}
+
+declare double @llvm.sin.f64(double)
+declare double @llvm.cos.f64(double)
+
+declare double @__enzyme_autodiff(double (double)*, ...)
+
+; CHECK: define internal { double } @diffetester(double %x, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = tail call fast double @llvm.sin.f64(double %x)
+; CHECK-NEXT:   %1 = tail call fast double @llvm.cos.f64(double %x)
+; CHECK-NEXT:   %m0diffe = fmul fast double %differeturn, %1
+; CHECK-NEXT:   %m1diffe = fmul fast double %differeturn, %0
+; CHECK-NEXT:   %2 = {{(fneg fast double %0|fsub fast double -0.000000e+00, %0)}}
+; CHECK-NEXT:   %3 = fmul fast double %m1diffe, %2
+; CHECK-NEXT:   %4 = fmul fast double %m0diffe, %1
+; CHECK-NEXT:   %5 = fadd fast double %3, %4
+; CHECK-NEXT:   %6 = insertvalue { double } undef, double %5, 0
+; CHECK-NEXT:   ret { double } %6
+; CHECK-NEXT: }
@@ -0,0 +1,41 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define double @tester(double %x) {
+entry:
+  %call = call double @sinh(double %x)
+  %call1 = call double @cosh(double %x)
+  %call2 = call double @tanh(double %x)
+  %add = fadd double %call, %call1
+  %mul = fmul double %add, %call2
+  ret double %mul
+}
+
+define double @test_derivative(double %x) {
+entry:
+  %0 = tail call double (double (double)*, ...) @__enzyme_autodiff(double (double)* nonnull @tester, double %x)
+  ret double %0
+}
+
+declare double @sinh(double)
+declare double @cosh(double)
+declare double @tanh(double)
+
+declare double @__enzyme_autodiff(double (double)*, ...)
+
+; CHECK: define internal { double } @diffetester(double %x, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %call = call double @sinh(double %x)
+; CHECK-NEXT:   %call1 = call double @cosh(double %x)
+; CHECK-NEXT:   %call2 = call double @tanh(double %x)
+; CHECK-NEXT:   %add = fadd double %call, %call1
+; CHECK-NEXT:   %m0diffeadd = fmul fast double %differeturn, %call2
+; CHECK-NEXT:   %m1diffecall2 = fmul fast double %differeturn, %add
+; CHECK-NEXT:   %0 = fmul fast double %call1, %call1
+; CHECK-NEXT:   %1 = fdiv fast double %m1diffecall2, %0
+; CHECK-NEXT:   %2 = fmul fast double %m0diffeadd, %call
+; CHECK-NEXT:   %3 = fadd fast double %1, %2
+; CHECK-NEXT:   %4 = fmul fast double %m0diffeadd, %call1
+; CHECK-NEXT:   %5 = fadd fast double %3, %4
+; CHECK-NEXT:   %6 = insertvalue { double } undef, double %5, 0
+; CHECK-NEXT:   ret { double } %6
+; CHECK-NEXT: }
@@ -59,7 +59,7 @@ attributes #3 = { nounwind }
 ; CHECK-NEXT:   %[[sqrt:.+]] = call fast double @llvm.sqrt.f64(double %[[mul]])
 ; CHECK-NEXT:   %[[div:.+]] = fdiv fast double 5.000000e-01, %[[sqrt]]
 
-; CHECK-NEXT:   %[[sqrtzero:.+]] = fcmp fast oeq double %mul_unwrap.i, 0.000000e+00
+; CHECK-NEXT:   %[[sqrtzero:.+]] = fcmp fast oeq double %[[sqrtv:.+]], 0.000000e+00
 ; CHECK-NEXT:   %[[dsqrt:.+]] = select{{( fast)?}} i1 %[[sqrtzero]], double 0.000000e+00, double %[[div]]
 
 ; CHECK-NEXT:   %[[dmul0:.+]] = fmul fast double %[[dsqrt]], %x
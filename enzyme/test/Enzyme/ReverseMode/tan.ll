@@ -21,7 +21,7 @@ declare double @__enzyme_autodiff(double (double)*, ...)
 
 ; CHECK: define internal { double } @diffetester(double %x, double %differeturn)
 ; CHECK-NEXT: entry:
-; CHECK-NEXT:   %0 = call fast double @tan(double %x) 
+; CHECK-NEXT:   %0 = tail call fast double @tan(double %x)
 ; CHECK-NEXT:   %1 = fmul fast double %0, %0
 ; CHECK-NEXT:   %2 = fadd fast double 1.000000e+00, %1
 ; CHECK-NEXT:   %3 = fmul fast double %differeturn, %2
@@ -0,0 +1,137 @@
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+; RUN: if [ %llvmver -ge 12 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -pass-remarks=enzyme -disable-output 2>&1 | FileCheck %s --check-prefix=REMARK; fi
+
+; h = sin(h * x) for n iterations, differentiating only the last two
+define double @f(double %x, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %h = phi double [ 1.000000e+00, %entry ], [ %s, %loop ]
+  call void @__enzyme_truncate(i64 2)
+  %m = fmul double %h, %x
+  %s = call double @llvm.sin.f64(double %m)
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret double %s
+}
+
+define double @df(double %x, i64 %n) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double, i64)* @f, double %x, i64 %n)
+  ret double %0
+}
+
+; The same with a window given at runtime, which may be zero
+define double @g(double %x, i64 %n, i64 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %h = phi double [ 1.000000e+00, %entry ], [ %s, %loop ]
+  call void @__enzyme_truncate(i64 %k)
+  %m = fmul double %h, %x
+  %s = call double @llvm.sin.f64(double %m)
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret double %s
+}
+
+define double @dg(double %x, i64 %n, i64 %k) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double, i64, i64)* @g, double %x, i64 %n, i64 %k)
+  ret double %0
+}
+
+; A window of zero is ignored
+define double @z(double %x, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %h = phi double [ 1.000000e+00, %entry ], [ %s, %loop ]
+  call void @__enzyme_truncate(i64 0)
+  %m = fmul double %h, %x
+  %s = call double @llvm.sin.f64(double %m)
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret double %s
+}
+
+define double @dz(double %x, i64 %n) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double, i64)* @z, double %x, i64 %n)
+  ret double %0
+}
+
+declare void @__enzyme_truncate(i64)
+declare double @llvm.sin.f64(double)
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal { double } @diffef(double %x, i64 %n, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = add i64 %n, -1
+; CHECK-NEXT:   %1 = icmp ult i64 %n, 2
+; CHECK-NEXT:   %2 = select i1 %1, i64 %n, i64 2
+; CHECK-NEXT:   %mallocsize = mul nuw nsw i64 %2, 8
+; CHECK-NEXT:   %malloccall = tail call noalias nonnull i8* @malloc(i64 %mallocsize)
+; CHECK-NEXT:   %h_malloccache = bitcast i8* %malloccall to double*
+; CHECK-NEXT:   br label %loop
+
+; CHECK: loop:
+; CHECK-NEXT:   %iv = phi i64 [ %iv.next, %loop ], [ 0, %entry ]
+; CHECK-NEXT:   %h = phi double [ 1.000000e+00, %entry ], [ %s, %loop ]
+; CHECK-NEXT:   %3 = urem i64 %iv, 2
+; CHECK-NEXT:   %4 = getelementptr inbounds double, double* %h_malloccache, i64 %3
+; CHECK-NEXT:   store double %h, double* %4, align 8
+; CHECK-NOT:    !invariant.group
+
+; CHECK: invertloop:
+; CHECK-NEXT:   %"x'de.0" = phi double [ %11, %incinvertloop ], [ 0.000000e+00, %loop ]
+; CHECK-NEXT:   %"s'de.0" = phi double [ %16, %incinvertloop ], [ %differeturn, %loop ]
+; CHECK-NEXT:   %"iv'ac.0" = phi i64 [ %17, %incinvertloop ], [ %0, %loop ]
+; CHECK-NEXT:   %6 = urem i64 %"iv'ac.0", 2
+; CHECK-NEXT:   %7 = getelementptr inbounds double, double* %h_malloccache, i64 %6
+; CHECK-NEXT:   %8 = load double, double* %7, align 8
+; CHECK-NEXT:   %m_unwrap = fmul double %8, %x
+; CHECK-NEXT:   %9 = call fast double @llvm.cos.f64(double %m_unwrap)
+; CHECK-NEXT:   %10 = fmul fast double %"s'de.0", %9
+; CHECK-NEXT:   %m0diffeh = fmul fast double %10, %x
+; CHECK-NEXT:   %m1diffex = fmul fast double %10, %8
+; CHECK-NEXT:   %11 = fadd fast double %"x'de.0", %m1diffex
+; CHECK-NEXT:   %12 = sub i64 %n, 2
+; CHECK-NEXT:   %13 = icmp ugt i64 %n, 2
+; CHECK-NEXT:   %14 = select i1 %13, i64 %12, i64 0
+; CHECK-NEXT:   %15 = icmp ule i64 %"iv'ac.0", %14
+; CHECK-NEXT:   %16 = select fast i1 %15, double 0.000000e+00, double %m0diffeh
+; CHECK-NEXT:   br i1 %15, label %invertentry, label %incinvertloop
+
+; CHECK: define internal { double } @diffeg(double %x, i64 %n, i64 %k, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %[[kz:.+]] = icmp eq i64 %k, 0
+; CHECK-NEXT:   %k_window = select i1 %[[kz]], i64 1, i64 %k
+; CHECK:        %[[lt:.+]] = icmp ult i64 %n, %k_window
+; CHECK-NEXT:   %[[slots:.+]] = select i1 %[[lt]], i64 %n, i64 %k_window
+; CHECK-NEXT:   %mallocsize = mul nuw nsw i64 %[[slots]], 8
+; CHECK:        urem i64 %iv, %k_window
+; CHECK:        urem i64 %"iv'ac.0", %k_window
+
+; CHECK: define internal { double } @diffez(double %x, i64 %n, double %differeturn)
+; CHECK-NOT:    urem
+; CHECK:        %mallocsize = mul nuw nsw i64 %n, 8
+; CHECK-NOT:    urem
+; CHECK: }
+
+; REMARK: Ignoring __enzyme_truncate of loop loop, whose window must be a nonzero constant or argument {{.*}} call void @__enzyme_truncate(i64 0)
@@ -0,0 +1,48 @@
+; REQUIRES: x86-registered-target
+; RUN: if [ %llvmver -ge 14 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -O2 -vector-library=SVML -mattr=+avx2 -S | FileCheck %s --check-prefix=SVML; fi
+; RUN: if [ %llvmver -ge 14 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -O2 -vector-library=LIBMVEC-X86 -mattr=+avx2 -S | FileCheck %s --check-prefix=LIBMVEC; fi
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @f(double* noalias %x, double* noalias %out, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %inc, %loop ]
+  %px = getelementptr inbounds double, double* %x, i64 %i
+  %v = load double, double* %px
+  %s = call fast double @llvm.sin.f64(double %v)
+  %po = getelementptr inbounds double, double* %out, i64 %i
+  store double %s, double* %po
+  %inc = add nuw nsw i64 %i, 1
+  %c = icmp ult i64 %inc, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @df(double* %x, double* %dx, double* %out, double* %dout, i64 %n) {
+entry:
+  call void (...) @__enzyme_autodiff(void (double*, double*, i64)* @f, double* %x, double* %dx, double* %out, double* %dout, i64 %n)
+  ret void
+}
+
+declare double @llvm.sin.f64(double)
+declare void @__enzyme_autodiff(...)
+
+; The derivative of sin is emitted as llvm.cos, which the loop vectorizer
+; maps onto the vector library in the reverse loop as it does llvm.sin in the
+; primal loop.
+
+; SVML: define void @df(
+; SVML: call fast <4 x double> @__svml_sin4(
+; SVML: call fast <4 x double> @__svml_cos4(
+; SVML: ret void
+
+; LIBMVEC: define void @df(
+; LIBMVEC: call fast <4 x double> @_ZGVdN4v_sin(
+; LIBMVEC: call fast <4 x double> @_ZGVdN4v_cos(
+; LIBMVEC: ret void
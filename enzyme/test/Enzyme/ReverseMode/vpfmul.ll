@@ -0,0 +1,47 @@
+; RUN: if [ %llvmver -ge 14 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(double* %x, <4 x double> %w, <4 x i1> %m, i32 %evl) {
+entry:
+  %xv = bitcast double* %x to <4 x double>*
+  %v = call <4 x double> @llvm.vp.load.v4f64.p0v4f64(<4 x double>* align 8 %xv, <4 x i1> %m, i32 %evl)
+  %p = call <4 x double> @llvm.vp.fmul.v4f64(<4 x double> %v, <4 x double> %w, <4 x i1> %m, i32 %evl)
+  %r = call double @llvm.vp.reduce.fadd.v4f64(double 0.000000e+00, <4 x double> %p, <4 x i1> %m, i32 %evl)
+  ret double %r
+}
+
+define void @test_derivative(double* %x, double* %dx, <4 x double> %w, <4 x i1> %m, i32 %evl) {
+entry:
+  %0 = call double (...) @__enzyme_autodiff(double (double*, <4 x double>, <4 x i1>, i32)* @tester, double* %x, double* %dx, metadata !"enzyme_const", <4 x double> %w, <4 x i1> %m, i32 %evl)
+  ret void
+}
+
+declare <4 x double> @llvm.vp.load.v4f64.p0v4f64(<4 x double>*, <4 x i1>, i32)
+declare <4 x double> @llvm.vp.fmul.v4f64(<4 x double>, <4 x double>, <4 x i1>, i32)
+declare double @llvm.vp.reduce.fadd.v4f64(double, <4 x double>, <4 x i1>, i32)
+declare double @__enzyme_autodiff(...)
+
+; CHECK: define internal void @diffetester(double* %x, double* %"x'", <4 x double> %w, <4 x i1> %m, i32 %evl, double %differeturn)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %"xv'ipc" = bitcast double* %"x'" to <4 x double>*
+; CHECK-NEXT:   %.splatinsert5 = insertelement <4 x i32> poison, i32 %evl, i32 0
+; CHECK-NEXT:   %.splat6 = shufflevector <4 x i32> %.splatinsert5, <4 x i32> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %0 = icmp ult <4 x i32> <i32 0, i32 1, i32 2, i32 3>, %.splat6
+; CHECK-NEXT:   %1 = and <4 x i1> %m, %0
+; CHECK-NEXT:   %.splatinsert = insertelement <4 x i32> poison, i32 %evl, i32 0
+; CHECK-NEXT:   %.splat = shufflevector <4 x i32> %.splatinsert, <4 x i32> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %2 = icmp ult <4 x i32> <i32 0, i32 1, i32 2, i32 3>, %.splat
+; CHECK-NEXT:   %3 = and <4 x i1> %m, %2
+; CHECK-NEXT:   %.splatinsert1 = insertelement <4 x double> poison, double %differeturn, i32 0
+; CHECK-NEXT:   %.splat2 = shufflevector <4 x double> %.splatinsert1, <4 x double> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %4 = select fast <4 x i1> %3, <4 x double> %.splat2, <4 x double> zeroinitializer
+; CHECK-NEXT:   %.splatinsert3 = insertelement <4 x i32> poison, i32 %evl, i32 0
+; CHECK-NEXT:   %.splat4 = shufflevector <4 x i32> %.splatinsert3, <4 x i32> poison, <4 x i32> zeroinitializer
+; CHECK-NEXT:   %5 = icmp ult <4 x i32> <i32 0, i32 1, i32 2, i32 3>, %.splat4
+; CHECK-NEXT:   %6 = and <4 x i1> %m, %5
+; CHECK-NEXT:   %7 = fmul fast <4 x double> %4, %w
+; CHECK-NEXT:   %8 = select fast <4 x i1> %6, <4 x double> %7, <4 x double> zeroinitializer
+; CHECK-NEXT:   %9 = call fast <4 x double> @llvm.masked.load.v4f64.p0v4f64(<4 x double>* %"xv'ipc", i32 8, <4 x i1> %1, <4 x double> zeroinitializer)
+; CHECK-NEXT:   %10 = fadd fast <4 x double> %9, %8
+; CHECK-NEXT:   call void @llvm.masked.store.v4f64.p0v4f64(<4 x double> %10, <4 x double>* %"xv'ipc", i32 8, <4 x i1> %1)
+; CHECK-NEXT:   ret void
+; CHECK-NEXT: }
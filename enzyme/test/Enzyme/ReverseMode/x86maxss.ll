@@ -0,0 +1,53 @@
+; RUN: %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -instsimplify -simplifycfg -S | FileCheck %s
+
+define void @f(<4 x float>* %a, <4 x float>* %b, <4 x float> %m) {
+entry:
+  %x = load <4 x float>, <4 x float>* %a
+  %y = load <4 x float>, <4 x float>* %b
+  %mx = call <4 x float> @llvm.x86.sse.max.ss(<4 x float> %x, <4 x float> %y)
+  %bl = call <4 x float> @llvm.x86.sse41.blendvps(<4 x float> %mx, <4 x float> %y, <4 x float> %m)
+  %s = shufflevector <4 x float> %bl, <4 x float> %x, <4 x i32> <i32 0, i32 0, i32 7, i32 undef>
+  store <4 x float> %s, <4 x float>* %a
+  ret void
+}
+declare <4 x float> @llvm.x86.sse.max.ss(<4 x float>, <4 x float>)
+declare <4 x float> @llvm.x86.sse41.blendvps(<4 x float>, <4 x float>, <4 x float>)
+define void @test(<4 x float>* %a, <4 x float>* %da, <4 x float>* %b, <4 x float>* %db, <4 x float> %m) {
+entry:
+  call void (...) @__enzyme_autodiff(void (<4 x float>*, <4 x float>*, <4 x float>)* @f, <4 x float>* %a, <4 x float>* %da, <4 x float>* %b, <4 x float>* %db, <4 x float> %m)
+  ret void
+}
+declare void @__enzyme_autodiff(...)
+
+; CHECK: define internal { <4 x float> } @diffef(<4 x float>* %a, <4 x float>* %"a'", <4 x float>* %b, <4 x float>* %"b'", <4 x float> %m)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %x = load <4 x float>, <4 x float>* %a, align 16
+; CHECK-NEXT:   %y = load <4 x float>, <4 x float>* %b, align 16
+; CHECK-NEXT:   %mx = call <4 x float> @llvm.x86.sse.max.ss(<4 x float> %x, <4 x float> %y)
+; CHECK-NEXT:   %bl = call <4 x float> @llvm.x86.sse41.blendvps(<4 x float> %mx, <4 x float> %y, <4 x float> %m)
+; CHECK-NEXT:   %s = shufflevector <4 x float> %bl, <4 x float> %x, <4 x i32> <i32 0, i32 0, i32 7, i32 undef>
+; CHECK-NEXT:   store <4 x float> %s, <4 x float>* %a, align 16
+; CHECK-NEXT:   %0 = load <4 x float>, <4 x float>* %"a'", align 16
+; CHECK-NEXT:   store <4 x float> zeroinitializer, <4 x float>* %"a'", align 16
+; CHECK-NEXT:   %1 = shufflevector <4 x float> %0, <4 x float> zeroinitializer, <4 x i32> <i32 0, i32 4, i32 4, i32 4>
+; CHECK-NEXT:   %2 = shufflevector <4 x float> %0, <4 x float> zeroinitializer, <4 x i32> <i32 1, i32 4, i32 4, i32 4>
+; CHECK-NEXT:   %3 = fadd fast <4 x float> %1, %2
+; CHECK-NEXT:   %4 = shufflevector <4 x float> %0, <4 x float> zeroinitializer, <4 x i32> <i32 4, i32 4, i32 4, i32 2>
+; CHECK-NEXT:   %5 = bitcast <4 x float> %m to <4 x i32>
+; CHECK-NEXT:   %6 = icmp sge <4 x i32> %5, zeroinitializer
+; CHECK-NEXT:   %7 = select fast <4 x i1> %6, <4 x float> %3, <4 x float> zeroinitializer
+; CHECK-NEXT:   %8 = select fast <4 x i1> %6, <4 x float> zeroinitializer, <4 x float> %3
+; CHECK-NEXT:   %9 = fcmp fast ogt <4 x float> %x, %y
+; CHECK-NEXT:   %10 = or <4 x i1> %9, <i1 false, i1 true, i1 true, i1 true>
+; CHECK-NEXT:   %11 = fadd fast <4 x float> %4, %7
+; CHECK-NEXT:   %12 = select fast <4 x i1> %10, <4 x float> %11, <4 x float> %4
+; CHECK-NEXT:   %13 = fadd fast <4 x float> %8, %7
+; CHECK-NEXT:   %14 = select fast <4 x i1> %10, <4 x float> %8, <4 x float> %13
+; CHECK-NEXT:   %15 = load <4 x float>, <4 x float>* %"b'", align 16
+; CHECK-NEXT:   %16 = fadd fast <4 x float> %15, %14
+; CHECK-NEXT:   store <4 x float> %16, <4 x float>* %"b'", align 16
+; CHECK-NEXT:   %17 = load <4 x float>, <4 x float>* %"a'", align 16
+; CHECK-NEXT:   %18 = fadd fast <4 x float> %17, %12
+; CHECK-NEXT:   store <4 x float> %18, <4 x float>* %"a'", align 16
+; CHECK-NEXT:   ret { <4 x float> } zeroinitializer
+; CHECK-NEXT: }
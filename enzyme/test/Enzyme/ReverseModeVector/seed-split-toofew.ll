@@ -0,0 +1,17 @@
+; RUN: if [ %llvmver -ge 13 ]; then not %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -S 2>&1 | FileCheck %s; fi
+
+define double @tester(double %x, double %y) {
+entry:
+  %m = fmul double %x, %y
+  ret double %m
+}
+
+define { [2 x double] } @test_derivative(double %x, double %y, double %seed, i8* %tape) {
+entry:
+  %0 = call { [2 x double] } (double (double, double)*, ...) @__enzyme_reverse(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 2, double %x, metadata !"enzyme_const", double %y, double %seed, i8* %tape)
+  ret { [2 x double] } %0
+}
+
+declare { [2 x double] } @__enzyme_reverse(double (double, double)*, ...)
+
+; CHECK: error: {{.*}}Enzyme: Expected 2 seeds of type double in {{.*}} = call { [2 x double] } {{.*}} @__enzyme_reverse(
@@ -0,0 +1,39 @@
+; RUN: if [ %llvmver -ge 13 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-preopt=false -mem2reg -early-cse -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(double %x, double %y) {
+entry:
+  %m = fmul double %x, %y
+  ret double %m
+}
+
+define { [2 x double] } @test_aggregate(double %x, double %y, [2 x double] %seed, i8* %tape) {
+entry:
+  %0 = call { [2 x double] } (double (double, double)*, ...) @__enzyme_reverse(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 2, double %x, metadata !"enzyme_const", double %y, [2 x double] %seed, i8* %tape)
+  ret { [2 x double] } %0
+}
+
+define { [2 x double] } @test_scalars(double %x, double %y, double %seed1, double %seed2, i8* %tape) {
+entry:
+  %0 = call { [2 x double] } (double (double, double)*, ...) @__enzyme_reverse(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 2, double %x, metadata !"enzyme_const", double %y, double %seed1, double %seed2, i8* %tape)
+  ret { [2 x double] } %0
+}
+
+declare { [2 x double] } @__enzyme_reverse(double (double, double)*, ...)
+
+; CHECK: define { [2 x double] } @test_aggregate(double %x, double %y, [2 x double] %seed, i8* %tape)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = call { [2 x double] } @diffe2tester(double %x, double %y, [2 x double] %seed, i8* %tape)
+; CHECK-NEXT:   ret { [2 x double] } %0
+
+; CHECK: define { [2 x double] } @test_scalars(double %x, double %y, double %seed1, double %seed2, i8* %tape)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %[[s0:.+]] = insertvalue [2 x double] undef, double %seed1, 0
+; CHECK-NEXT:   %[[s1:.+]] = insertvalue [2 x double] %[[s0]], double %seed2, 1
+; CHECK-NEXT:   %[[r:.+]] = call { [2 x double] } @diffe2tester(double %x, double %y, [2 x double] %[[s1]], i8* %tape)
+; CHECK-NEXT:   ret { [2 x double] } %[[r]]
+
+; CHECK: define internal { [2 x double] } @diffe2tester(double %x, double %y, [2 x double] %differeturn, i8* %tapeArg)
+; CHECK:   %[[d0:.+]] = extractvalue [2 x double] %differeturn, 0
+; CHECK-NEXT:   %m0diffex = fmul fast double %[[d0]], %y
+; CHECK-NEXT:   %[[d1:.+]] = extractvalue [2 x double] %differeturn, 1
+; CHECK-NEXT:   %m0diffex1 = fmul fast double %[[d1]], %y
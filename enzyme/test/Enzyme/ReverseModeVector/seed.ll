@@ -0,0 +1,35 @@
+; RUN: if [ %llvmver -ge 13 ]; then %opt < %s %loadEnzyme -enzyme -enzyme-vector-shadows -enzyme-preopt=false -mem2reg -early-cse -instsimplify -simplifycfg -S | FileCheck %s; fi
+
+define double @tester(double %x, double %y) {
+entry:
+  %m = fmul double %x, %y
+  %d = fdiv double %m, %y
+  %s = fsub double %d, %x
+  ret double %s
+}
+
+define [2 x double] @test_derivative(double %x, double %y, [2 x double] %seed) {
+entry:
+  %0 = tail call [2 x double] (double (double, double)*, ...) @__enzyme_autodiff(double (double, double)* nonnull @tester, metadata !"enzyme_width", i64 2, double %x, metadata !"enzyme_const", double %y, [2 x double] %seed)
+  ret [2 x double] %0
+}
+
+declare [2 x double] @__enzyme_autodiff(double (double, double)*, ...)
+
+; CHECK: define [2 x double] @test_derivative(double %x, double %y, [2 x double] %seed)
+; CHECK-NEXT: entry:
+; CHECK-NEXT:   %0 = call { [2 x double] } @diffe2tester(double %x, double %y, [2 x double] %seed)
+
+; CHECK: define internal { [2 x double] } @diffe2tester(double %x, double %y, [2 x double] %differeturn)
+; CHECK:   %[[seed:.+]] = insertelement <2 x double> %{{.+}}, double %{{.+}}, i64 1
+; CHECK-NEXT:   %[[neg:.+]] = fneg fast <2 x double> %[[seed]]
+; CHECK:   %.splat = shufflevector <2 x double> %.splatinsert, <2 x double> poison, <2 x i32> zeroinitializer
+; CHECK-NEXT:   %d0diffem = fdiv fast <2 x double> %[[seed]], %.splat
+; CHECK:   %m0diffex = fmul fast <2 x double> %{{.+}}, %.splat
+; CHECK:   %[[sum:.+]] = fadd fast <2 x double> %{{.+}}, %m0diffex
+; CHECK-NEXT:   %[[a:.+]] = extractelement <2 x double> %[[sum]], i64 0
+; CHECK-NEXT:   %[[r0:.+]] = insertvalue [2 x double] undef, double %[[a]], 0
+; CHECK-NEXT:   %[[b:.+]] = extractelement <2 x double> %[[sum]], i64 1
+; CHECK-NEXT:   %[[r1:.+]] = insertvalue [2 x double] %[[r0]], double %[[b]], 1
+; CHECK-NEXT:   %[[res:.+]] = insertvalue { [2 x double] } undef, [2 x double] %[[r1]], 0
+; CHECK-NEXT:   ret { [2 x double] } %[[res]]
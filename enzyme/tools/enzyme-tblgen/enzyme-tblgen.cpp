@@ -46,6 +46,37 @@ bool hasDiffeRet(Init *resultTree) {
   return false;
 }
 
+// Returns whether the derivative uses the primal result, bound by naming the
+// operator of the pattern to match.
+bool usesPrimalResult(Init *resultTree, StringRef resultName) {
+  if (DagInit *resultRoot = dyn_cast<DagInit>(resultTree)) {
+    for (auto zp :
+         llvm::zip(resultRoot->getArgs(), resultRoot->getArgNames())) {
+      if (isa<UnsetInit>(std::get<0>(zp)) && std::get<1>(zp) &&
+          std::get<1>(zp)->getAsUnquotedString() == resultName)
+        return true;
+      if (usesPrimalResult(std::get<0>(zp), resultName))
+        return true;
+    }
+  }
+  return false;
+}
+
+// Collects the names of the companion calls the derivative may reuse from the
+// primal.
+void getCompanions(Init *resultTree, SmallVectorImpl<std::string> &names) {
+  if (DagInit *resultRoot = dyn_cast<DagInit>(resultTree)) {
+    auto Def = cast<DefInit>(resultRoot->getOperator())->getDef();
+    if (Def->isSubClassOf("Companion")) {
+      auto func = cast<DagInit>(Def->getValueInit("func"));
+      auto funcDef = cast<DefInit>(func->getOperator())->getDef();
+      names.push_back(funcDef->getValueInit("name")->getAsString());
+    }
+    for (auto arg : resultRoot->getArgs())
+      getCompanions(arg, names);
+  }
+}
+
 void getFunction(raw_ostream &os, std::string callval, std::string FT,
                  std::string cconv, Init *func) {
   if (DagInit *resultRoot = dyn_cast<DagInit>(func)) {
@@ -163,7 +194,32 @@ bool handle(raw_ostream &os, Record *pattern, Init *resultTree,
       return true;
     }
 
+    bool isCompanion = Def->isSubClassOf("Companion");
     os << " ({\n";
+    os << " Value *res = nullptr;\n";
+    if (isCompanion) {
+      auto func = cast<DagInit>(Def->getValueInit("func"));
+      auto funcDef = cast<DefInit>(func->getOperator())->getDef();
+      if (!funcDef->isSubClassOf("SameTypesFunc"))
+        PrintFatalError(pattern->getLoc(),
+                        "companion must be a SameTypesFunc call");
+      DagInit *tree = pattern->getValueAsDag("PatternToMatch");
+      bool sameArgs = resultRoot->getNumArgs() == tree->getNumArgs();
+      for (unsigned i = 0; sameArgs && i < tree->getNumArgs(); i++)
+        sameArgs = isa<UnsetInit>(resultRoot->getArg(i)) &&
+                   resultRoot->getArgName(i) &&
+                   resultRoot->getArgNameStr(i) == tree->getArgNameStr(i);
+      if (!sameArgs)
+        PrintFatalError(pattern->getLoc(),
+                        "companion must be called on the matched operands");
+      // The reverse pass reuses a companion call of the primal, if present.
+      if (lookup) {
+        os << " if (auto companion = findDerivativeCompanion(orig))\n";
+        os << "   res = lookup(gutils->getNewFromOriginal(companion), "
+           << builder << ");\n";
+        os << " else {\n";
+      }
+    }
     os << "    Value* args[" << resultRoot->getArgs().size() << "];\n";
 
     SmallVector<bool, 1> vectorValued;
@@ -228,8 +284,6 @@ bool handle(raw_ostream &os, Record *pattern, Init *resultTree,
                    nameToOrdinal);
     }
 
-    os << " Value *res = nullptr;\n";
-
     if (anyVector) {
       os << " if (gutils->getWidth() == 1) { \n";
     }
@@ -330,6 +384,8 @@ bool handle(raw_ostream &os, Record *pattern, Init *resultTree,
       os << "   res = " << builder << ".CreateInsertValue(res, V, {idx});\n";
       os << " }\n }\n";
     }
+    if (isCompanion && lookup)
+      os << " }\n";
     os << " res; })";
     return anyVector;
   }
@@ -337,11 +393,59 @@ bool handle(raw_ostream &os, Record *pattern, Init *resultTree,
   PrintFatalError(pattern->getLoc(), Twine("unknown dag"));
 }
 
+// Emits the functions describing which primal values the derivatives of the
+// patterns reuse, included from the section guarded by GET_DERIVATIVE_REUSE.
+static void emitDerivativeReuse(const std::vector<Record *> &patterns,
+                                raw_ostream &os) {
+  std::vector<std::string> usesResult;
+  std::vector<std::pair<std::string, std::string>> companions;
+  for (Record *pattern : patterns) {
+    DagInit *tree = pattern->getValueAsDag("PatternToMatch");
+    ListInit *argOps = pattern->getValueAsListInit("ArgDerivatives");
+    bool reuse = false;
+    SmallVector<std::string, 1> companionNames;
+    for (auto argOp : *argOps) {
+      if (tree->getNameStr().size() &&
+          usesPrimalResult(argOp, tree->getNameStr()))
+        reuse = true;
+      getCompanions(argOp, companionNames);
+    }
+    for (auto &name : companionNames)
+      if (name != companionNames[0])
+        PrintFatalError(pattern->getLoc(), "only one companion supported");
+    for (auto *nameI : *cast<ListInit>(pattern->getValueAsListInit("names"))) {
+      auto funcName = cast<StringInit>(nameI)->getAsString();
+      if (reuse)
+        usesResult.push_back(funcName);
+      if (companionNames.size())
+        companions.emplace_back(funcName, companionNames[0]);
+    }
+  }
+
+  os << "static inline bool derivativeUsesPrimalResult(llvm::StringRef "
+        "funcName) {\n";
+  for (auto &funcName : usesResult)
+    os << "  if (funcName == " << funcName << ")\n    return true;\n";
+  os << "  return false;\n}\n";
+
+  os << "static inline llvm::StringRef derivativeCompanionName(llvm::StringRef "
+        "funcName) {\n";
+  for (auto &pair : companions)
+    os << "  if (funcName == " << pair.first << ")\n    return "
+       << pair.second << ";\n";
+  os << "  return \"\";\n}\n";
+}
+
 static void emitDerivatives(const RecordKeeper &recordKeeper, raw_ostream &os) {
   emitSourceFileHeader("Rewriters", os);
   const auto &patterns = recordKeeper.getAllDerivedDefinitions("CallPattern");
   Record *attrClass = recordKeeper.getClass("Attr");
 
+  os << "#ifdef GET_DERIVATIVE_REUSE\n";
+  emitDerivativeReuse(patterns, os);
+  os << "#undef GET_DERIVATIVE_REUSE\n";
+  os << "#else\n";
+
   // Ensure unique patterns simply by appending unique suffix.
   unsigned rewritePatternCount = 0;
   std::string baseRewriteName = "GeneratedConvert";
@@ -508,6 +612,7 @@ static void emitDerivatives(const RecordKeeper &recordKeeper, raw_ostream &os) {
 
     os << "    return;\n  }\n";
   }
+  os << "#endif\n";
 }
 
 static bool EnzymeTableGenMain(raw_ostream &os, RecordKeeper &records) {